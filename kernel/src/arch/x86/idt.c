@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include <arch/x86/include/idt.h>
 #include <arch/x86/include/gdt.h>
+#include <arch/x86/include/lapic.h>
 #include <kernel/io.h>
 #include <lib/minstd.h>
 
@@ -32,6 +33,12 @@ static struct idt_ptr idt_ptr;
 /* Exception handler table */
 static exception_handler exception_handlers[IDT_VECTOR_COUNT] = {0};
 
+/* Device interrupt handlers */
+static struct {
+    irq_handler handler;
+    void *data;
+} irq_handlers[IDT_VECTOR_COUNT];
+
 /* External interrupt handler stubs defined in idt_asm.asm */
 extern void* interrupt_stubs[];
 
@@ -70,6 +77,30 @@ void idt_register_handler(uint8_t vector, exception_handler handler) {
     }
 }
 
+/* Allocate a device interrupt vector; returns the vector, or -1 if none are free */
+int idt_alloc_vector(irq_handler handler, void *data) {
+    if (!handler) {
+        return -1;
+    }
+
+    for (int vector = IDT_IRQ_VECTOR_BASE; vector < IDT_SPURIOUS_VECTOR; vector++) {
+        if (!irq_handlers[vector].handler) {
+            irq_handlers[vector].data = data;
+            irq_handlers[vector].handler = handler;
+            return vector;
+        }
+    }
+
+    kerr("IDT: Out of interrupt vectors\n");
+    return -1;
+}
+
+/* Release a vector returned by idt_alloc_vector */
+void idt_free_vector(uint8_t vector) {
+    irq_handlers[vector].handler = NULL;
+    irq_handlers[vector].data = NULL;
+}
+
 /* Initialize the IDT */
 void idt_init(void) {
     kprintf("\nIDT: Initializing Interrupt Descriptor Table...\n");
@@ -87,6 +118,12 @@ void idt_init(void) {
                       IDT_FLAGS_PRESENT | IDT_FLAGS_INTERRUPT_GATE | IDT_FLAGS_RING0);
         idt_register_handler(i, NULL); /* Use default handler */
     }
+
+    /* Set interrupt gates for the legacy PIC range and device vectors */
+    for (int i = 32; i < IDT_VECTOR_COUNT; i++) {
+        idt_set_entry(i, interrupt_stubs[i],
+                      IDT_FLAGS_PRESENT | IDT_FLAGS_INTERRUPT_GATE | IDT_FLAGS_RING0);
+    }
     
     /* Load the IDT */
     idt_load(&idt_ptr);
@@ -96,6 +133,28 @@ void idt_init(void) {
 
 /* Error handler for exceptions */
 void exception_handler_wrapper(uint64_t vector, uint64_t error_code) {
+    /* The spurious vector must not be acknowledged */
+    if (vector == IDT_SPURIOUS_VECTOR) {
+        return;
+    }
+
+    /* Device interrupts delivered through the local APIC */
+    if (vector >= IDT_IRQ_VECTOR_BASE) {
+        if (irq_handlers[vector].handler) {
+            irq_handlers[vector].handler((uint8_t)vector, irq_handlers[vector].data);
+        }
+        lapic_eoi();
+        return;
+    }
+
+    /* Legacy PIC interrupts; their handlers acknowledge the PIC themselves */
+    if (vector >= 32) {
+        if (exception_handlers[vector]) {
+            exception_handlers[vector]();
+        }
+        return;
+    }
+
     kprintf("Exception %llu occurred! Error code: %llu\n", vector, error_code);
     
     /* Call registered handler or default handler */
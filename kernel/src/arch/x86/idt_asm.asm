@@ -134,6 +134,17 @@ INTERRUPT_STUB_NO_ERROR_CODE 29    ; VMM Communication Exception
 INTERRUPT_STUB_ERROR_CODE    30    ; Security Exception
 INTERRUPT_STUB_NO_ERROR_CODE 31    ; Reserved
 
+; Device interrupts and spurious vector (32-255)
+%assign vector 32
+%rep 224
+global interrupt_stub_%+vector
+interrupt_stub_%+vector:
+    push 0
+    push vector
+    jmp interrupt_common_stub
+%assign vector vector + 1
+%endrep
+
 ; Create an array of interrupt stub pointers
 section .data
 global interrupt_stubs
@@ -169,4 +180,9 @@ interrupt_stubs:
     dq interrupt_stub_28
     dq interrupt_stub_29
     dq interrupt_stub_30
-    dq interrupt_stub_31
\ No newline at end of file
+    dq interrupt_stub_31
+%assign vector 32
+%rep 224
+    dq interrupt_stub_%+vector
+%assign vector vector + 1
+%endrep
\ No newline at end of file
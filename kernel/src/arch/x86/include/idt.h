@@ -31,6 +31,10 @@
 /* Total number of interrupt vectors */
 #define IDT_VECTOR_COUNT 256
 
+/* Vectors 0x20-0x2F belong to the legacy PIC; device interrupts start above */
+#define IDT_IRQ_VECTOR_BASE      0x30
+#define IDT_SPURIOUS_VECTOR      0xFF
+
 /* IDT entry structure for 64-bit mode */
 struct idt_entry {
     uint16_t offset_low;       /* Offset bits 0-15 */
@@ -58,4 +62,13 @@ typedef void (*exception_handler)(void);
 /* Register an exception handler for a specific vector */
 void idt_register_handler(uint8_t vector, exception_handler handler);
 
+/* Device interrupt handler function type */
+typedef void (*irq_handler)(uint8_t vector, void *data);
+
+/* Allocate a device interrupt vector; returns the vector, or -1 if none are free */
+int idt_alloc_vector(irq_handler handler, void *data);
+
+/* Release a vector returned by idt_alloc_vector */
+void idt_free_vector(uint8_t vector);
+
 #endif /* _ASM_X86_IDT_H */
\ No newline at end of file
@@ -0,0 +1,65 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ASM_X86_LAPIC_H
+#define _ASM_X86_LAPIC_H
+
+#include <stdint.h>
+
+/* Local APIC base MSR */
+#define LAPIC_BASE_MSR          0x1B
+#define LAPIC_BASE_ENABLE       0x800
+
+/* Local APIC registers (offset from base) */
+#define LAPIC_REG_ID            0x020
+#define LAPIC_REG_TPR           0x080
+#define LAPIC_REG_EOI           0x0B0
+#define LAPIC_REG_SVR           0x0F0
+#define LAPIC_REG_LVT_TIMER     0x320
+#define LAPIC_REG_TIMER_INIT    0x380
+#define LAPIC_REG_TIMER_CUR     0x390
+#define LAPIC_REG_TIMER_DIV     0x3E0
+
+/* Spurious vector register bits */
+#define LAPIC_SVR_ENABLE        0x100
+
+/* Local vector table bits */
+#define LAPIC_LVT_MASKED        0x10000
+
+/* Timer divide configuration: divide the bus clock by 16 */
+#define LAPIC_TIMER_DIV_16      0x3
+
+/* MSI message address window */
+#define LAPIC_MSI_ADDRESS       0xFEE00000
+
+/* Initialize the local APIC of the current CPU */
+int lapic_init(void);
+
+/* Get the APIC ID of the current CPU */
+uint32_t lapic_id(void);
+
+/* Signal end of interrupt */
+void lapic_eoi(void);
+
+/* Arm the one-shot timer to interrupt after ns nanoseconds; -1 if there is no timer */
+int lapic_timer_oneshot(uint64_t ns);
+
+/* Disarm the one-shot timer */
+void lapic_timer_cancel(void);
+
+#endif /* _ASM_X86_LAPIC_H */
\ No newline at end of file
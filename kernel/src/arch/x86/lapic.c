@@ -0,0 +1,153 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <arch/x86/include/lapic.h>
+#include <arch/x86/include/idt.h>
+#include <kernel/io.h>
+#include <kernel/time.h>
+#include <mm/vmm.h>
+
+/* How long the timer runs against the TSC to measure its frequency */
+#define LAPIC_TIMER_CALIBRATION_US  10000
+
+/* Mapped local APIC registers */
+static volatile uint32_t *lapic_base = NULL;
+
+/* One-shot timer, used to sleep until a deadline */
+static uint64_t lapic_timer_hz = 0;
+static int lapic_timer_vector = -1;
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic_base[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic_base[reg / 4] = value;
+}
+
+/* The timer interrupt only has to wake the CPU from hlt */
+static void lapic_timer_irq(uint8_t vector, void *data) {
+    (void)vector;
+    (void)data;
+}
+
+/* Measure the timer frequency against the calibrated TSC */
+static void lapic_timer_init(void) {
+    int vector = idt_alloc_vector(lapic_timer_irq, NULL);
+    if (vector < 0) {
+        kerr("LAPIC: No vector for the timer\n");
+        return;
+    }
+
+    lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | (uint32_t)vector);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+    time_delay_us(LAPIC_TIMER_CALIBRATION_US);
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CUR);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+
+    if (elapsed == 0) {
+        kerr("LAPIC: Timer calibration failed\n");
+        return;
+    }
+
+    lapic_timer_hz = (uint64_t)elapsed * (1000000 / LAPIC_TIMER_CALIBRATION_US);
+    lapic_timer_vector = vector;
+    kprintf("LAPIC: Timer running at %lu kHz\n", lapic_timer_hz / 1000);
+}
+
+/* Initialize the local APIC of the current CPU */
+int lapic_init(void) {
+    uint64_t base = rdmsr(LAPIC_BASE_MSR);
+
+    /* Make sure the APIC is globally enabled */
+    if (!(base & LAPIC_BASE_ENABLE)) {
+        base |= LAPIC_BASE_ENABLE;
+        wrmsr(LAPIC_BASE_MSR, base);
+    }
+
+    lapic_base = (volatile uint32_t *)vmm_map_mmio(base & 0xFFFFF000, 0x1000);
+    if (!lapic_base) {
+        kerr("LAPIC: Failed to map registers\n");
+        return -1;
+    }
+
+    /* Accept all priorities and software-enable with the spurious vector */
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | IDT_SPURIOUS_VECTOR);
+
+    kprintf("LAPIC: ID %u at 0x%lx\n", lapic_id(), base & 0xFFFFF000);
+
+    lapic_timer_init();
+    return 0;
+}
+
+/* Get the APIC ID of the current CPU */
+uint32_t lapic_id(void) {
+    if (!lapic_base) {
+        return 0;
+    }
+    return lapic_read(LAPIC_REG_ID) >> 24;
+}
+
+/* Signal end of interrupt */
+void lapic_eoi(void) {
+    if (lapic_base) {
+        lapic_write(LAPIC_REG_EOI, 0);
+    }
+}
+
+/* Arm the one-shot timer to interrupt after ns nanoseconds; -1 if there is no timer */
+int lapic_timer_oneshot(uint64_t ns) {
+    if (lapic_timer_vector < 0) {
+        return -1;
+    }
+
+    uint64_t ticks = (uint64_t)(((unsigned __int128)ns * lapic_timer_hz) / 1000000000ULL);
+    if (ticks == 0) {
+        ticks = 1;
+    } else if (ticks > 0xFFFFFFFF) {
+        ticks = 0xFFFFFFFF;
+    }
+
+    /* One-shot mode: the count runs down once and raises the vector */
+    lapic_write(LAPIC_REG_LVT_TIMER, (uint32_t)lapic_timer_vector);
+    lapic_write(LAPIC_REG_TIMER_INIT, (uint32_t)ticks);
+    return 0;
+}
+
+/* Disarm the one-shot timer */
+void lapic_timer_cancel(void) {
+    if (lapic_timer_vector < 0) {
+        return;
+    }
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | (uint32_t)lapic_timer_vector);
+}
\ No newline at end of file
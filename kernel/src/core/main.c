@@ -29,8 +29,31 @@
 #include <arch/x86/include/keyboard.h>
 #include <arch/x86/include/mouse.h>
 #include <fs/vfs.h>
+#include <fs/dcache.h>
+#include <fs/icache.h>
 #include <fs/ext4/ext4.h>
+#include <fs/virtiofs/virtiofs.h>
+#include <fs/9p/v9fs.h>
 #include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+#include <mm/page_cache.h>
+#include <mm/writeback.h>
+#include <kernel/time.h>
+#include <drivers/pci/pci.h>
+#include <drivers/block/block.h>
+#include <drivers/block/blk_stat.h>
+#include <drivers/block/virtio_blk.h>
+#include <drivers/block/nvme.h>
+#include <drivers/block/ahci.h>
+#include <drivers/block/ramdisk.h>
+#include <drivers/block/dm.h>
+#include <drivers/block/zram.h>
+#include <drivers/video/fbcon.h>
+#include <drivers/usb/xhci.h>
+#include <drivers/input/input.h>
+#include <drivers/char/virtio_console.h>
+#include <arch/x86/include/lapic.h>
 
 #ifdef __x86_64__
 #include <arch/x86/include/serial.h>
@@ -52,6 +75,30 @@ static volatile struct limine_bootloader_info_request bootloader_info_request =
     .revision = 0
 };
 
+__attribute__((used, section(".limine_requests")))
+static volatile struct limine_hhdm_request hhdm_request = {
+    .id = LIMINE_HHDM_REQUEST,
+    .revision = 0
+};
+
+__attribute__((used, section(".limine_requests")))
+static volatile struct limine_memmap_request memmap_request = {
+    .id = LIMINE_MEMMAP_REQUEST,
+    .revision = 0
+};
+
+__attribute__((used, section(".limine_requests")))
+static volatile struct limine_kernel_address_request kernel_address_request = {
+    .id = LIMINE_KERNEL_ADDRESS_REQUEST,
+    .revision = 0
+};
+
+__attribute__((used, section(".limine_requests")))
+static volatile struct limine_module_request module_request = {
+    .id = LIMINE_MODULE_REQUEST,
+    .revision = 0
+};
+
 __attribute__((used, section(".limine_requests_start")))
 static volatile LIMINE_REQUESTS_START_MARKER;
 
@@ -66,6 +113,80 @@ static void hcf(void) {
     }
 }
 
+#if DM_BOOT_STRIPE_CHUNK > 0
+/**
+ * Stripe all virtio disks into one device, for spreading load over them
+ * @return The striped device, or NULL if there are fewer than two disks
+ */
+static block_device_t *setup_boot_stripe(void) {
+    block_device_t *members[DM_MAX_MEMBERS];
+    uint32_t count = 0;
+
+    for (int i = 0; i < block_device_count() && count < DM_MAX_MEMBERS; i++) {
+        block_device_t *device = block_device_get(i);
+        if (strncmp(device->name, "vd", 2) == 0) {
+            members[count++] = device;
+        }
+    }
+
+    if (count < 2) {
+        return NULL;
+    }
+    return dm_create_striped("dm0", members, count, DM_BOOT_STRIPE_CHUNK);
+}
+#endif
+
+#if BLOCK_BENCH_QUEUE_DEPTH > 0
+/**
+ * Benchmark a device, streaming its request trace to the trace port if there is one
+ * @param device The device to benchmark
+ */
+static void bench_device(block_device_t *device) {
+    bool traced = virtio_console_trace_ready() && blk_trace_start(device, BLOCK_BENCH_TRACE_ENTRIES) == 0;
+
+    block_bench(device, BLOCK_BENCH_QUEUE_DEPTH, BLOCK_BENCH_IO_COUNT);
+
+    if (traced) {
+        blk_trace_event_t events[64];
+        uint32_t count;
+        while ((count = blk_trace_read(device, events, 64)) > 0) {
+            virtio_console_trace_write(events, count * sizeof(blk_trace_event_t));
+        }
+        virtio_console_flush();
+        blk_trace_stop(device);
+    }
+    blk_stat_print(device);
+}
+#endif
+
+/**
+ * Mount the first block device holding an ext4 filesystem as root, or else
+ * a directory shared by the host (virtio-fs first, then 9P)
+ */
+static void mount_root(void) {
+    struct vfs_node *root = NULL;
+
+    for (int i = 0; i < block_device_count(); i++) {
+        block_device_t *device = block_device_get(i);
+
+        if (ext4_mount(device, &root) == 0 && vfs_mount("/", root) == 0) {
+            kprintf("Mounted %s as root filesystem\n", device->name);
+            return;
+        }
+    }
+
+    if (virtiofs_mount(&root) == 0 && vfs_mount("/", root) == 0) {
+        kprintf("Mounted virtio-fs share as root filesystem\n");
+        return;
+    }
+    if (v9fs_mount(&root) == 0 && vfs_mount("/", root) == 0) {
+        kprintf("Mounted 9P share as root filesystem\n");
+        return;
+    }
+
+    kprintf("No root filesystem found\n");
+}
+
 /* Kernel entry point */
 void kmain(void) {
     /* Initialize I/O (includes serial) */
@@ -79,6 +200,20 @@ void kmain(void) {
     /* Initialize memory management */
     kmalloc_init();
 
+    /* Initialize physical and virtual memory management */
+    if (hhdm_request.response == NULL || memmap_request.response == NULL
+     || kernel_address_request.response == NULL) {
+        kerr("Bootloader did not provide the memory layout!\n");
+        hcf();
+    }
+    vmm_init(hhdm_request.response->offset,
+             kernel_address_request.response->physical_base,
+             kernel_address_request.response->virtual_base);
+    pmm_init(memmap_request.response);
+
+    /* Calibrate the clock source */
+    time_init();
+
     /* Initialize Virtual Filesystem */
     vfs_init();
 
@@ -117,6 +252,31 @@ void kmain(void) {
     idt_init();
     kprintf("done\n");
 
+    /* Initialize the local APIC for device interrupts */
+    lapic_init();
+
+    /* Register storage drivers; an initrd module comes first so it can be root */
+    ramdisk_register_driver(module_request.response);
+
+    /* Register bus and storage drivers (they may allocate interrupt vectors) */
+    pci_register_driver();
+
+    /* Log and trace ports come up first so driver messages reach them */
+    virtio_console_register_driver();
+    virtio_blk_register_driver();
+    nvme_register_driver();
+    ahci_register_driver();
+
+    /* Host shared directories */
+    virtiofs_register_driver();
+    v9fs_register_driver();
+
+    /* USB keyboards and mice */
+    xhci_register_driver();
+#if ZRAM_BOOT_SIZE_MB > 0
+    zram_create((uint64_t)ZRAM_BOOT_SIZE_MB * 1024 * 1024);
+#endif
+
     /* Ensure we got a framebuffer */
     kprintf("Checking framebuffer... ");
     if (framebuffer_request.response == NULL
@@ -134,10 +294,35 @@ void kmain(void) {
             (unsigned)framebuffer->height,
             (unsigned)framebuffer->bpp);
 
-    /* Clear the screen with dark blue */
-    kprintf("Clearing screen... ");
-    memset((void *)framebuffer->address, 0, framebuffer->pitch * framebuffer->height);
-    kprintf("done\n");
+    /* Clear the screen and show kernel output on it from here on */
+    fbcon_init(framebuffer);
+
+#if DM_BOOT_STRIPE_CHUNK > 0
+    /* Build the striped device before root is looked for, so it can hold root */
+    block_device_t *stripe = setup_boot_stripe();
+#endif
+
+    /* Mount the root filesystem */
+    mount_root();
+
+#if BLOCK_BENCH_QUEUE_DEPTH > 0
+    for (int i = 0; i < block_device_count(); i++) {
+        bench_device(block_device_get(i));
+    }
+#endif
+#if DM_BOOT_STRIPE_CHUNK > 0
+    if (stripe) {
+        dm_print_stats(stripe);
+    }
+#endif
+
+    fbcon_print_stats();
+    virtio_console_print_stats();
+    virtiofs_print_stats();
+    dcache_print_stats();
+    icache_print_stats();
+    page_cache_print_stats();
+    writeback_print_stats();
 
     /* Initialization complete */
     kprintf("\nFreeCore v%s initialization complete!\n", KERNEL_VERSION_STRING);
@@ -148,16 +333,31 @@ void kmain(void) {
             DEBUG_SERIAL_PORT == COM4_PORT ? 4 : 0);
     kprintf("PS/2 mouse is initialized. Move mouse to see debug output.\n");
     kprintf("Press any key to receive echo: ");
+    fbcon_flush();
+    virtio_console_flush();
 
     /* Echo received characters (simple terminal) */
     while (1) {
-        char c = serial_read_char(DEBUG_SERIAL_PORT);
-        serial_write_char(DEBUG_SERIAL_PORT, c);
+        if (serial_received(DEBUG_SERIAL_PORT)) {
+            char c = serial_read_char(DEBUG_SERIAL_PORT);
+            serial_write_char(DEBUG_SERIAL_PORT, c);
+
+            /* Add line feed after carriage return */
+            if (c == '\r') {
+                serial_write_char(DEBUG_SERIAL_PORT, '\n');
+            }
+        }
 
-        /* Add line feed after carriage return */
-        if (c == '\r') {
-            serial_write_char(DEBUG_SERIAL_PORT, '\n');
+        /* Characters typed on a USB keyboard */
+        int key = input_getchar();
+        if (key >= 0) {
+            kprintf("%c", key);
+            fbcon_flush();
+            virtio_console_flush();
         }
+
+        /* Write back dirty file pages that are due */
+        writeback_poll();
     }
 
     /* We should never get here */
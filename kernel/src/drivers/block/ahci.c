@@ -0,0 +1,814 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * AHCI SATA driver
+ *
+ * Each port is a single blk-mq hardware queue whose tags are the command
+ * slots; disks that support NCQ use them as queue tags as well. Commands
+ * dispatched together are issued with a single PxSACT/PxCI write and
+ * retire independently as the drive posts Set Device Bits FISes, so long
+ * reads overlap instead of paying one device round trip per command.
+ * Completions are polled from the port interrupt status.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/barrier.h>
+#include <drivers/driversys.h>
+#include <drivers/pci/pci.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/block/ahci.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/* Command timeout */
+#define AHCI_TIMEOUT_MS     5000
+
+static int ahci_probe_driver(device_driver_t *driver);
+static int ahci_remove_driver(device_driver_t *driver);
+
+static int ahci_read(block_device_t *device, uint64_t offset, size_t size, void *buffer);
+static int ahci_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer);
+static int ahci_ioctl(block_device_t *device, unsigned int cmd, void *arg);
+
+static int ahci_queue_rq(blk_mq_hw_ctx_t *hctx, request_t *rq, bool last);
+static void ahci_commit_rqs(blk_mq_hw_ctx_t *hctx);
+static uint32_t ahci_poll(blk_mq_hw_ctx_t *hctx);
+static int ahci_init_hctx(blk_mq_hw_ctx_t *hctx, void *driver_data, uint16_t index);
+
+/* Define the AHCI driver */
+static driver_ops_t ahci_driver_ops = {
+    .probe = ahci_probe_driver,
+    .remove = ahci_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t ahci_driver = {
+    .name = "ahci",
+    .device_class = DEVICE_CLASS_STORAGE,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &ahci_driver_ops,
+    .private_data = NULL
+};
+
+static block_device_ops_t ahci_ops = {
+    .read = ahci_read,
+    .write = ahci_write,
+    .ioctl = ahci_ioctl
+};
+
+static const blk_mq_ops_t ahci_mq_ops = {
+    .queue_rq = ahci_queue_rq,
+    .commit_rqs = ahci_commit_rqs,
+    .poll = ahci_poll,
+    .init_hctx = ahci_init_hctx
+};
+
+/* Attached disks */
+static ahci_port_t *ahci_disks[AHCI_MAX_DISKS];
+static int ahci_disk_count = 0;
+
+static inline uint32_t ahci_port_read(ahci_port_t *port, uint32_t reg) {
+    return port->regs[reg / 4];
+}
+
+static inline void ahci_port_write(ahci_port_t *port, uint32_t reg, uint32_t value) {
+    port->regs[reg / 4] = value;
+}
+
+static inline uint32_t ahci_hba_read(ahci_hba_t *hba, uint32_t reg) {
+    return *(volatile uint32_t *)(hba->regs + reg);
+}
+
+static inline void ahci_hba_write(ahci_hba_t *hba, uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)(hba->regs + reg) = value;
+}
+
+/**
+ * Wait until (register & mask) == value
+ * @return 0 on success, negative on timeout
+ */
+static int ahci_port_wait(ahci_port_t *port, uint32_t reg, uint32_t mask, uint32_t value,
+                          uint32_t timeout_ms) {
+    uint64_t deadline = time_now_ns() + (uint64_t)timeout_ms * 1000000ULL;
+    while ((ahci_port_read(port, reg) & mask) != value) {
+        if (time_now_ns() > deadline) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Stop the command list and FIS receive engines
+ */
+static int ahci_port_stop(ahci_port_t *port) {
+    uint32_t cmd = ahci_port_read(port, AHCI_PX_CMD);
+    ahci_port_write(port, AHCI_PX_CMD, cmd & ~AHCI_PX_CMD_ST);
+    if (ahci_port_wait(port, AHCI_PX_CMD, AHCI_PX_CMD_CR, 0, 500) < 0) {
+        return -1;
+    }
+
+    cmd = ahci_port_read(port, AHCI_PX_CMD);
+    ahci_port_write(port, AHCI_PX_CMD, cmd & ~AHCI_PX_CMD_FRE);
+    return ahci_port_wait(port, AHCI_PX_CMD, AHCI_PX_CMD_FR, 0, 500);
+}
+
+/**
+ * Start the FIS receive and command list engines
+ */
+static int ahci_port_start(ahci_port_t *port) {
+    /* A drive left busy by an error needs a command list override */
+    if (ahci_port_read(port, AHCI_PX_TFD) & (AHCI_PX_TFD_BSY | AHCI_PX_TFD_DRQ)) {
+        ahci_port_write(port, AHCI_PX_CMD, ahci_port_read(port, AHCI_PX_CMD) | AHCI_PX_CMD_CLO);
+        ahci_port_wait(port, AHCI_PX_CMD, AHCI_PX_CMD_CLO, 0, 500);
+    }
+
+    uint32_t cmd = ahci_port_read(port, AHCI_PX_CMD);
+    ahci_port_write(port, AHCI_PX_CMD, cmd | AHCI_PX_CMD_FRE);
+    ahci_port_write(port, AHCI_PX_CMD, cmd | AHCI_PX_CMD_FRE | AHCI_PX_CMD_ST);
+    return 0;
+}
+
+/**
+ * Fail every outstanding command and restart the port after an error
+ */
+static void ahci_port_recover(ahci_port_t *port) {
+    kerr("AHCI: %s: Port error, IS 0x%x TFD 0x%x SERR 0x%x\n", port->block.name,
+         ahci_port_read(port, AHCI_PX_IS), ahci_port_read(port, AHCI_PX_TFD),
+         ahci_port_read(port, AHCI_PX_SERR));
+
+    ahci_port_stop(port);
+
+    port->failed |= port->issued;
+    port->completed |= port->issued;
+    port->issued = 0;
+    port->unqueued &= port->pending;
+
+    ahci_port_write(port, AHCI_PX_SERR, 0xFFFFFFFF);
+    ahci_port_write(port, AHCI_PX_IS, 0xFFFFFFFF);
+    ahci_port_start(port);
+}
+
+/**
+ * Collect finished commands
+ *
+ * For queued commands the drive reports completion with Set Device Bits
+ * FISes, which the HBA applies to PxSACT; non-queued commands retire by
+ * clearing their PxCI bit.
+ * @return Bitmap of slots that finished in this call
+ */
+static uint32_t ahci_port_reap(ahci_port_t *port) {
+    uint32_t is = ahci_port_read(port, AHCI_PX_IS);
+    if (is) {
+        ahci_port_write(port, AHCI_PX_IS, is);
+    }
+
+    if (is & AHCI_PX_IS_ERROR) {
+        uint32_t failed = port->issued;
+        ahci_port_recover(port);
+        return failed;
+    }
+
+    uint32_t active = ahci_port_read(port, AHCI_PX_CI);
+    if (port->ncq) {
+        active |= ahci_port_read(port, AHCI_PX_SACT);
+    }
+
+    uint32_t done = port->issued & ~active;
+    port->issued &= ~done;
+    port->unqueued &= ~done;
+    port->completed |= done;
+    if (done) {
+        port->deadline_ns = time_now_ns() + AHCI_TIMEOUT_MS * 1000000ULL;
+    }
+    return done;
+}
+
+/**
+ * Describe a request's segments with PRDT entries, merging physically
+ * contiguous ones
+ * @return Number of entries used, or negative if the request needs too many
+ */
+static int ahci_build_prdt(ahci_cmd_table_t *table, request_t *rq) {
+    int count = 0;
+
+    for (bio_t *bio = rq->bio; bio; bio = bio->next) {
+        for (uint16_t i = 0; i < bio->vcnt; i++) {
+            uint64_t phys = virt_to_phys(bio_vec_addr(&bio->vecs[i]));
+            uint32_t len = bio->vecs[i].len;
+
+            /* Data base addresses must be word aligned */
+            if (phys & 1) {
+                return -1;
+            }
+
+            ahci_prd_t *last = count ? &table->prdt[count - 1] : NULL;
+            uint64_t last_end = last ? (((uint64_t)last->dbau << 32) | last->dba) + (last->dbc & 0x3FFFFF) + 1 : 0;
+            if (last && last_end == phys && (last->dbc & 0x3FFFFF) + 1 + len <= 0x400000) {
+                last->dbc += len;
+                continue;
+            }
+
+            if (count == AHCI_PRDT_ENTRIES) {
+                return -1;
+            }
+            table->prdt[count].dba = (uint32_t)phys;
+            table->prdt[count].dbau = (uint32_t)(phys >> 32);
+            table->prdt[count].reserved = 0;
+            table->prdt[count].dbc = len - 1;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Fill a slot's command header and FIS for a cache flush, which is never queued
+ */
+static void ahci_prepare_flush(ahci_port_t *port, int slot) {
+    ahci_cmd_header_t *header = &port->cmd_list[slot];
+    uint8_t *fis = port->tables[slot].cfis;
+
+    memset(fis, 0, 20);
+    fis[0] = AHCI_FIS_REG_H2D;
+    fis[1] = 0x80;  /* Command register update */
+    fis[2] = ATA_CMD_FLUSH_CACHE_EXT;
+    fis[7] = 0x40;  /* LBA mode */
+
+    header->flags = 5;  /* FIS length in dwords, no data */
+    header->prdtl = 0;
+    header->prdbc = 0;
+    port->unqueued |= 1u << slot;
+}
+
+/**
+ * Fill a slot's command header, FIS and range block for a TRIM, which is
+ * not queued either
+ */
+static void ahci_prepare_trim(ahci_port_t *port, int slot, request_t *rq) {
+    ahci_cmd_table_t *table = &port->tables[slot];
+    ahci_cmd_header_t *header = &port->cmd_list[slot];
+    uint64_t *ranges = (uint64_t *)(port->trim_ranges + slot * ATA_DSM_BLOCK_SIZE);
+    uint64_t phys = port->trim_ranges_phys + slot * ATA_DSM_BLOCK_SIZE;
+    uint64_t lba = rq->sector * BLOCK_SECTOR_SIZE / port->sector_size;
+    uint64_t count = (uint64_t)rq->nr_sectors * BLOCK_SECTOR_SIZE / port->sector_size;
+
+    /* Entries are a 48-bit LBA and a 16-bit length; max_discard_sectors keeps them in one block */
+    memset(ranges, 0, ATA_DSM_BLOCK_SIZE);
+    for (uint32_t i = 0; count > 0; i++) {
+        uint64_t n = count < ATA_DSM_RANGE_MAX ? count : ATA_DSM_RANGE_MAX;
+        ranges[i] = lba | (n << 48);
+        lba += n;
+        count -= n;
+    }
+
+    table->prdt[0].dba = (uint32_t)phys;
+    table->prdt[0].dbau = (uint32_t)(phys >> 32);
+    table->prdt[0].reserved = 0;
+    table->prdt[0].dbc = ATA_DSM_BLOCK_SIZE - 1;
+
+    uint8_t *fis = table->cfis;
+    memset(fis, 0, 20);
+    fis[0] = AHCI_FIS_REG_H2D;
+    fis[1] = 0x80;  /* Command register update */
+    fis[2] = ATA_CMD_DSM;
+    fis[3] = ATA_DSM_TRIM;
+    fis[7] = 0x40;  /* LBA mode */
+    fis[12] = 1;    /* Range blocks */
+
+    header->flags = 5 | AHCI_CMD_HEADER_WRITE;
+    header->prdtl = 1;
+    header->prdbc = 0;
+    port->unqueued |= 1u << slot;
+}
+
+/**
+ * Fill a slot's command header and FIS for a read or write
+ * @return 0 on success, negative on error
+ */
+static int ahci_prepare_rw(ahci_port_t *port, int slot, request_t *rq) {
+    ahci_cmd_table_t *table = &port->tables[slot];
+    ahci_cmd_header_t *header = &port->cmd_list[slot];
+    bool write = rq->op != BIO_OP_READ;
+    bool fua = write && (rq->op_flags & BIO_REQ_FUA);
+    uint64_t lba = rq->sector * BLOCK_SECTOR_SIZE / port->sector_size;
+    uint32_t count = (uint32_t)((uint64_t)rq->nr_sectors * BLOCK_SECTOR_SIZE / port->sector_size);
+
+    int prds = ahci_build_prdt(table, rq);
+    if (prds < 0) {
+        return -1;
+    }
+
+    uint8_t *fis = table->cfis;
+    memset(fis, 0, 20);
+    fis[0] = AHCI_FIS_REG_H2D;
+    fis[1] = 0x80;  /* Command register update */
+    fis[4] = (uint8_t)lba;
+    fis[5] = (uint8_t)(lba >> 8);
+    fis[6] = (uint8_t)(lba >> 16);
+    fis[7] = 0x40;  /* LBA mode */
+    fis[8] = (uint8_t)(lba >> 24);
+    fis[9] = (uint8_t)(lba >> 32);
+    fis[10] = (uint8_t)(lba >> 40);
+
+    if (port->ncq) {
+        /* FPDMA QUEUED: count in the features field, tag in the count field */
+        fis[2] = write ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA;
+        fis[3] = (uint8_t)count;
+        fis[11] = (uint8_t)(count >> 8);
+        fis[12] = (uint8_t)(slot << 3);
+        if (fua) {
+            fis[7] |= 0x80;
+        }
+    } else if (fua) {
+        fis[2] = ATA_CMD_WRITE_DMA_FUA_EXT;
+        fis[12] = (uint8_t)count;
+        fis[13] = (uint8_t)(count >> 8);
+    } else {
+        fis[2] = write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+        fis[12] = (uint8_t)count;
+        fis[13] = (uint8_t)(count >> 8);
+    }
+
+    header->flags = 5 | (write ? AHCI_CMD_HEADER_WRITE : 0);  /* FIS length in dwords */
+    header->prdtl = (uint16_t)prds;
+    header->prdbc = 0;
+    return 0;
+}
+
+/**
+ * Hand a set of prepared slots to the HBA with one register write each
+ */
+static void ahci_issue(ahci_port_t *port, uint32_t slots) {
+    if (!slots) {
+        return;
+    }
+
+    wmb();
+    if (port->ncq && (slots & ~port->unqueued)) {
+        ahci_port_write(port, AHCI_PX_SACT, slots & ~port->unqueued);
+    }
+    ahci_port_write(port, AHCI_PX_CI, slots);
+
+    port->issued |= slots;
+    port->commands += __builtin_popcount(slots);
+    port->deadline_ns = time_now_ns() + AHCI_TIMEOUT_MS * 1000000ULL;
+
+    uint32_t outstanding = __builtin_popcount(port->issued);
+    if (outstanding > port->max_outstanding) {
+        port->max_outstanding = outstanding;
+    }
+}
+
+/**
+ * Wait until every slot in a set has finished
+ * @return 0 if all succeeded, negative on failure or timeout
+ */
+static int ahci_wait(ahci_port_t *port, uint32_t slots) {
+    uint64_t deadline = time_now_ns() + AHCI_TIMEOUT_MS * 1000000ULL;
+
+    while ((port->completed & slots) != slots) {
+        ahci_port_reap(port);
+        if ((port->completed & slots) != slots && time_now_ns() > deadline) {
+            kerr("AHCI: %s: Command timeout\n", port->block.name);
+            ahci_port_recover(port);
+        }
+    }
+
+    return (port->failed & slots) ? -1 : 0;
+}
+
+/**
+ * Bind the port's hardware queue
+ */
+static int ahci_init_hctx(blk_mq_hw_ctx_t *hctx, void *driver_data, uint16_t index) {
+    (void)index;
+    hctx->driver_data = driver_data;
+    return 0;
+}
+
+/**
+ * Prepare one request in the command slot its tag names
+ * @param hctx Hardware queue
+ * @param rq Request
+ * @param last Issue every prepared slot after this one
+ * @return BLK_MQ_RQ_QUEUED, or negative on error
+ */
+static int ahci_queue_rq(blk_mq_hw_ctx_t *hctx, request_t *rq, bool last) {
+    ahci_port_t *port = (ahci_port_t *)hctx->driver_data;
+    int slot = rq->tag;
+
+    /* Queued and non-queued commands may not be outstanding together */
+    if (port->ncq) {
+        uint32_t busy = port->issued | port->pending;
+        bool unqueued = rq->op == BIO_OP_FLUSH || rq->op == BIO_OP_DISCARD;
+        if (unqueued ? busy != 0 : (port->unqueued & busy) != 0) {
+            return BLK_MQ_RQ_BUSY;
+        }
+    }
+
+    if (rq->op == BIO_OP_FLUSH) {
+        ahci_prepare_flush(port, slot);
+    } else if (rq->op == BIO_OP_DISCARD) {
+        ahci_prepare_trim(port, slot, rq);
+    } else if (ahci_prepare_rw(port, slot, rq) < 0) {
+        return -1;
+    }
+
+    port->pending |= 1u << slot;
+    if (last) {
+        ahci_issue(port, port->pending);
+        port->pending = 0;
+    }
+    return BLK_MQ_RQ_QUEUED;
+}
+
+/**
+ * Issue slots prepared without last
+ */
+static void ahci_commit_rqs(blk_mq_hw_ctx_t *hctx) {
+    ahci_port_t *port = (ahci_port_t *)hctx->driver_data;
+    ahci_issue(port, port->pending);
+    port->pending = 0;
+}
+
+/**
+ * Complete finished commands, recovering the port if one has timed out
+ */
+static uint32_t ahci_poll(blk_mq_hw_ctx_t *hctx) {
+    ahci_port_t *port = (ahci_port_t *)hctx->driver_data;
+    if (!port->issued && !port->completed) {
+        return 0;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    ahci_port_reap(port);
+    if (port->issued && time_now_ns() > port->deadline_ns) {
+        kerr("AHCI: %s: Command timeout\n", port->block.name);
+        ahci_port_recover(port);
+    }
+
+    uint32_t done = port->completed;
+    uint32_t failed = port->failed;
+    port->completed = 0;
+    port->failed = 0;
+
+    for (uint32_t bits = done; bits; bits &= bits - 1) {
+        int slot = __builtin_ctz(bits);
+        blk_mq_complete_request(blk_mq_tag_to_rq(hctx, (uint32_t)slot),
+                                (failed & (1u << slot)) ? -1 : 0);
+    }
+    cpu_irq_restore(flags);
+
+    return (uint32_t)__builtin_popcount(done);
+}
+
+static int ahci_read(block_device_t *device, uint64_t offset, size_t size, void *buffer) {
+    return bio_rw_bytes(device, BIO_OP_READ, offset, size, buffer);
+}
+
+static int ahci_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer) {
+    return bio_rw_bytes(device, BIO_OP_WRITE, offset, size, (void *)buffer);
+}
+
+/**
+ * Random read benchmark, reporting how many commands the port overlapped
+ */
+static int ahci_bench(ahci_port_t *port, block_bench_t *bench) {
+    uint32_t max_before = port->max_outstanding;
+    port->max_outstanding = 0;
+
+    int result = blk_mq_bench(port->block.queue, bench);
+    if (result == 0) {
+        kprintf("AHCI: %s: up to %u commands outstanding (%s)\n", port->block.name,
+                port->max_outstanding, port->ncq ? "NCQ" : "no NCQ");
+    }
+
+    if (max_before > port->max_outstanding) {
+        port->max_outstanding = max_before;
+    }
+    return result;
+}
+
+static int ahci_ioctl(block_device_t *device, unsigned int cmd, void *arg) {
+    if (!device) {
+        return -1;
+    }
+
+    ahci_port_t *port = (ahci_port_t *)device->private_data;
+    switch (cmd) {
+        case BLOCK_IOCTL_BENCH:
+            if (!arg) {
+                return -1;
+            }
+            return ahci_bench(port, (block_bench_t *)arg);
+        default:
+            return -1;
+    }
+}
+
+/**
+ * Run IDENTIFY DEVICE and read the disk's geometry and queueing support
+ * @return 0 on success, negative on error
+ */
+static int ahci_identify(ahci_port_t *port) {
+    uint64_t ident_phys;
+    uint16_t *ident = (uint16_t *)pmm_alloc_dma(1, &ident_phys);
+    if (!ident) {
+        return -1;
+    }
+
+    /* The block device is not registered yet, so every slot is free */
+    int slot = 0;
+    ahci_cmd_table_t *table = &port->tables[slot];
+    ahci_cmd_header_t *header = &port->cmd_list[slot];
+
+    memset(table->cfis, 0, sizeof(table->cfis));
+    table->cfis[0] = AHCI_FIS_REG_H2D;
+    table->cfis[1] = 0x80;
+    table->cfis[2] = ATA_CMD_IDENTIFY;
+    table->prdt[0].dba = (uint32_t)ident_phys;
+    table->prdt[0].dbau = (uint32_t)(ident_phys >> 32);
+    table->prdt[0].reserved = 0;
+    table->prdt[0].dbc = 511;
+    header->flags = 5;
+    header->prdtl = 1;
+    header->prdbc = 0;
+
+    /* Non-queued command, so the port must not be in NCQ mode yet */
+    bool ncq = port->ncq;
+    port->ncq = false;
+    ahci_issue(port, 1u << slot);
+    int result = ahci_wait(port, 1u << slot);
+    port->ncq = ncq;
+    port->completed = 0;
+    port->failed = 0;
+
+    if (result == 0) {
+        /* Words 83/100-103: LBA48 support and capacity */
+        if (ident[83] & (1 << 10)) {
+            port->sectors = (uint64_t)ident[100] | ((uint64_t)ident[101] << 16) |
+                            ((uint64_t)ident[102] << 32) | ((uint64_t)ident[103] << 48);
+        } else {
+            port->sectors = (uint64_t)ident[60] | ((uint64_t)ident[61] << 16);
+        }
+
+        /* Words 106/117-118: logical sector size */
+        port->sector_size = BLOCK_SECTOR_SIZE;
+        if ((ident[106] & 0xC000) == 0x4000 && (ident[106] & (1 << 12))) {
+            port->sector_size = (((uint32_t)ident[118] << 16) | ident[117]) * 2;
+        }
+
+        /* Words 75/76: queue depth and NCQ support */
+        port->ncq_depth = (ident[75] & 0x1F) + 1;
+        port->ncq = ncq && (ident[76] & (1 << 8));
+
+        /* Words 82-87: write cache enabled, WRITE DMA FUA EXT supported */
+        port->write_cache = (ident[85] & (1 << 5)) != 0;
+        port->fua = port->ncq || (ident[84] & (1 << 6));
+
+        /* Word 169: DSM TRIM supported */
+        port->trim = (ident[169] & 1) != 0;
+    }
+
+    pmm_free_dma(ident, 1);
+    return result;
+}
+
+/**
+ * Set up a port with an ATA disk attached
+ * @return 0 on success, negative on error
+ */
+static int ahci_port_attach(ahci_hba_t *hba, uint8_t index) {
+    if (ahci_disk_count >= AHCI_MAX_DISKS) {
+        return -1;
+    }
+
+    volatile uint32_t *regs = (volatile uint32_t *)(hba->regs + AHCI_PORT_BASE + index * AHCI_PORT_SIZE);
+    if ((regs[AHCI_PX_SSTS / 4] & 0xF) != AHCI_SSTS_DET_PRESENT ||
+        regs[AHCI_PX_SIG / 4] != AHCI_SIG_ATA) {
+        return -1;
+    }
+
+    ahci_port_t *port = (ahci_port_t *)kzalloc(sizeof(ahci_port_t));
+    if (!port) {
+        return -1;
+    }
+    port->hba = hba;
+    port->index = index;
+    port->regs = regs;
+    port->num_slots = hba->num_slots;
+    port->ncq = (hba->cap & AHCI_CAP_SNCQ) != 0;
+
+    if (ahci_port_stop(port) < 0) {
+        kerr("AHCI: Port %u did not stop\n", index);
+        kfree(port);
+        return -1;
+    }
+
+    /* Command list (1 KiB) and received FIS area (256 bytes) share a page */
+    uint8_t *base = (uint8_t *)pmm_alloc_dma(1, &port->cmd_list_phys);
+    port->tables = (ahci_cmd_table_t *)pmm_alloc_dma(AHCI_MAX_SLOTS, &port->tables_phys);
+    if (!base || !port->tables) {
+        kfree(port);
+        return -1;
+    }
+    port->cmd_list = (ahci_cmd_header_t *)base;
+    port->rfis = base + 1024;
+    port->rfis_phys = port->cmd_list_phys + 1024;
+
+    for (uint32_t slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        uint64_t phys = port->tables_phys + slot * sizeof(ahci_cmd_table_t);
+        port->cmd_list[slot].ctba = (uint32_t)phys;
+        port->cmd_list[slot].ctbau = (uint32_t)(phys >> 32);
+    }
+
+    ahci_port_write(port, AHCI_PX_CLB, (uint32_t)port->cmd_list_phys);
+    ahci_port_write(port, AHCI_PX_CLBU, (uint32_t)(port->cmd_list_phys >> 32));
+    ahci_port_write(port, AHCI_PX_FB, (uint32_t)port->rfis_phys);
+    ahci_port_write(port, AHCI_PX_FBU, (uint32_t)(port->rfis_phys >> 32));
+    ahci_port_write(port, AHCI_PX_SERR, 0xFFFFFFFF);
+    ahci_port_write(port, AHCI_PX_IS, 0xFFFFFFFF);
+    ahci_port_write(port, AHCI_PX_IE, 0);
+    ahci_port_start(port);
+
+    ksnprintf(port->block.name, sizeof(port->block.name), "sd%c", 'a' + ahci_disk_count);
+
+    if (ahci_identify(port) < 0 || port->sectors == 0) {
+        kerr("AHCI: Port %u: IDENTIFY failed\n", index);
+        ahci_port_stop(port);
+        return -1;
+    }
+
+    /* Tags beyond the drive's queue depth are never handed out */
+    if (port->ncq && port->ncq_depth < port->num_slots) {
+        port->num_slots = port->ncq_depth;
+    }
+
+    port->block.size = port->sectors * port->sector_size;
+    port->block.block_size = port->sector_size;
+    port->block.private_data = port;
+    port->block.ops = &ahci_ops;
+
+    /* One hardware queue per port, one tag per command slot */
+    port->tag_set.ops = &ahci_mq_ops;
+    port->tag_set.nr_hw_queues = 1;
+    port->tag_set.queue_depth = (uint16_t)port->num_slots;
+    port->tag_set.max_sectors = AHCI_MAX_TRANSFER / BLOCK_SECTOR_SIZE;
+    port->tag_set.max_segments = AHCI_PRDT_ENTRIES;
+    port->tag_set.logical_block_size = port->sector_size;
+    port->tag_set.driver_data = port;
+    if (port->trim) {
+        port->trim_ranges = (uint8_t *)pmm_alloc_dma(AHCI_MAX_SLOTS * ATA_DSM_BLOCK_SIZE / PAGE_SIZE,
+                                                     &port->trim_ranges_phys);
+        port->trim = port->trim_ranges != NULL;
+    }
+    if (port->trim) {
+        /* As many ranges as one range block holds */
+        port->tag_set.max_discard_sectors = (ATA_DSM_BLOCK_SIZE / sizeof(uint64_t)) * ATA_DSM_RANGE_MAX *
+                                            (port->sector_size / BLOCK_SECTOR_SIZE);
+    }
+    if (port->write_cache) {
+        port->tag_set.flags |= BLK_MQ_F_WRITE_CACHE;
+        if (port->fua) {
+            port->tag_set.flags |= BLK_MQ_F_FUA;
+        }
+    }
+    port->block.tag_set = &port->tag_set;
+
+    kprintf("AHCI: %s: port %u, %lu sectors of %u bytes, %u slots%s%s%s\n",
+            port->block.name, index, port->sectors, port->sector_size, port->num_slots,
+            port->ncq ? ", NCQ" : "", port->write_cache ? ", write cache" : "",
+            port->trim ? ", TRIM" : "");
+
+    ahci_disks[ahci_disk_count++] = port;
+    return block_device_register(&port->block);
+}
+
+/**
+ * Bring up one AHCI controller
+ */
+static int ahci_attach(pci_device_t *pci) {
+    ahci_hba_t *hba = (ahci_hba_t *)kzalloc(sizeof(ahci_hba_t));
+    if (!hba) {
+        return -1;
+    }
+    hba->pci = pci;
+
+    hba->regs = (volatile uint8_t *)pci_map_bar(pci, 5);
+    if (!hba->regs) {
+        kfree(hba);
+        return -1;
+    }
+    pci_enable_bus_master(pci);
+
+    /* Reset the HBA, then switch it to AHCI mode */
+    ahci_hba_write(hba, AHCI_HBA_GHC, ahci_hba_read(hba, AHCI_HBA_GHC) | AHCI_GHC_AE);
+    ahci_hba_write(hba, AHCI_HBA_GHC, ahci_hba_read(hba, AHCI_HBA_GHC) | AHCI_GHC_HR);
+    uint64_t deadline = time_now_ns() + 1000000000ULL;
+    while (ahci_hba_read(hba, AHCI_HBA_GHC) & AHCI_GHC_HR) {
+        if (time_now_ns() > deadline) {
+            kerr("AHCI: HBA reset timed out\n");
+            kfree(hba);
+            return -1;
+        }
+    }
+    ahci_hba_write(hba, AHCI_HBA_GHC, AHCI_GHC_AE);
+
+    hba->cap = ahci_hba_read(hba, AHCI_HBA_CAP);
+    hba->num_slots = ((hba->cap >> AHCI_CAP_NCS_SHIFT) & 0x1F) + 1;
+    uint32_t implemented = ahci_hba_read(hba, AHCI_HBA_PI);
+
+    /* Spin up ports on staggered spin-up HBAs, then give links time to come up */
+    for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+        if ((implemented & (1u << i)) && (hba->cap & AHCI_CAP_SSS)) {
+            volatile uint32_t *cmd = (volatile uint32_t *)(hba->regs + AHCI_PORT_BASE +
+                                                           i * AHCI_PORT_SIZE + AHCI_PX_CMD);
+            *cmd |= AHCI_PX_CMD_SUD;
+        }
+    }
+    time_delay_us(10000);
+
+    kprintf("AHCI: Controller %02x:%02x.%x, %u slots per port%s\n",
+            pci->bus, pci->slot, pci->func, hba->num_slots,
+            (hba->cap & AHCI_CAP_SNCQ) ? ", NCQ" : "");
+
+    for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+        if (implemented & (1u << i)) {
+            ahci_port_attach(hba, (uint8_t)i);
+        }
+    }
+
+    ahci_hba_write(hba, AHCI_HBA_IS, 0xFFFFFFFF);
+    return 0;
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int ahci_probe_driver(device_driver_t *driver) {
+    pci_device_t *pci;
+
+    for (int index = 0; (pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, index)) != NULL; index++) {
+        if (pci->prog_if != 0x01) {
+            continue;
+        }
+        if (ahci_attach(pci) < 0) {
+            kerr("AHCI: Failed to attach %02x:%02x.%x\n", pci->bus, pci->slot, pci->func);
+        }
+    }
+
+    if (ahci_disk_count == 0) {
+        kprintf("AHCI: No disks found\n");
+    }
+    driver->private_data = ahci_disks;
+    return 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int ahci_remove_driver(device_driver_t *driver) {
+    for (int i = 0; i < ahci_disk_count; i++) {
+        block_device_unregister(&ahci_disks[i]->block);
+        ahci_port_stop(ahci_disks[i]);
+    }
+    return 0;
+}
+
+/**
+ * Register the AHCI driver
+ */
+void ahci_register_driver(void) {
+    device_driver_register(&ahci_driver);
+}
\ No newline at end of file
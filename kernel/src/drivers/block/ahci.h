@@ -0,0 +1,191 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * AHCI SATA driver
+ */
+
+#ifndef _DRIVERS_BLOCK_AHCI_H
+#define _DRIVERS_BLOCK_AHCI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/block.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/pci/pci.h>
+
+/* Limits */
+#define AHCI_MAX_PORTS          32
+#define AHCI_MAX_SLOTS          32
+#define AHCI_MAX_DISKS          8
+
+/* PRDT entries per command table; header plus PRDT fill one page */
+#define AHCI_PRDT_ENTRIES       248
+
+/* Largest transfer per command */
+#define AHCI_MAX_TRANSFER       (128 * 1024)
+
+/* HBA registers */
+#define AHCI_HBA_CAP            0x00
+#define AHCI_HBA_GHC            0x04
+#define AHCI_HBA_IS             0x08
+#define AHCI_HBA_PI             0x0C
+#define AHCI_HBA_VS             0x10
+
+#define AHCI_CAP_NCS_SHIFT      8
+#define AHCI_CAP_SSS            (1u << 27)
+#define AHCI_CAP_SNCQ           (1u << 30)
+#define AHCI_CAP_S64A           (1u << 31)
+
+#define AHCI_GHC_HR             (1u << 0)
+#define AHCI_GHC_AE             (1u << 31)
+
+/* Port registers (offset from the port base) */
+#define AHCI_PORT_BASE          0x100
+#define AHCI_PORT_SIZE          0x80
+#define AHCI_PX_CLB             0x00
+#define AHCI_PX_CLBU            0x04
+#define AHCI_PX_FB              0x08
+#define AHCI_PX_FBU             0x0C
+#define AHCI_PX_IS              0x10
+#define AHCI_PX_IE              0x14
+#define AHCI_PX_CMD             0x18
+#define AHCI_PX_TFD             0x20
+#define AHCI_PX_SIG             0x24
+#define AHCI_PX_SSTS            0x28
+#define AHCI_PX_SERR            0x30
+#define AHCI_PX_SACT            0x34
+#define AHCI_PX_CI              0x38
+
+#define AHCI_PX_CMD_ST          (1u << 0)
+#define AHCI_PX_CMD_SUD         (1u << 1)
+#define AHCI_PX_CMD_CLO         (1u << 3)
+#define AHCI_PX_CMD_FRE         (1u << 4)
+#define AHCI_PX_CMD_FR          (1u << 14)
+#define AHCI_PX_CMD_CR          (1u << 15)
+
+#define AHCI_PX_IS_SDBS         (1u << 3)
+#define AHCI_PX_IS_ERROR        0x7D800010  /* TFES, HBFS, HBDS, IFS, INFS, OFS, IPMS, UFS */
+
+#define AHCI_PX_TFD_ERR         0x01
+#define AHCI_PX_TFD_DRQ         0x08
+#define AHCI_PX_TFD_BSY         0x80
+
+#define AHCI_SSTS_DET_PRESENT   3
+#define AHCI_SIG_ATA            0x00000101
+
+/* FIS types */
+#define AHCI_FIS_REG_H2D        0x27
+
+/* ATA commands */
+#define ATA_CMD_DSM             0x06
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+#define ATA_CMD_WRITE_DMA_FUA_EXT 0x3D
+#define ATA_CMD_READ_FPDMA      0x60
+#define ATA_CMD_WRITE_FPDMA     0x61
+#define ATA_CMD_FLUSH_CACHE_EXT 0xEA
+#define ATA_CMD_IDENTIFY        0xEC
+
+/* DATA SET MANAGEMENT: TRIM function, and the 512-byte range block it reads */
+#define ATA_DSM_TRIM            0x01
+#define ATA_DSM_BLOCK_SIZE      512
+#define ATA_DSM_RANGE_MAX       0xFFFF  /* Sectors per range entry */
+
+/* Command header (command list entry) */
+typedef struct ahci_cmd_header {
+    uint16_t flags;             /* CFL, A, W, P, R, B, C, PMP */
+    uint16_t prdtl;             /* PRDT entries */
+    volatile uint32_t prdbc;    /* Bytes transferred */
+    uint32_t ctba;              /* Command table base */
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} __attribute__((packed)) ahci_cmd_header_t;
+
+#define AHCI_CMD_HEADER_WRITE   (1u << 6)
+
+/* Physical region descriptor */
+typedef struct ahci_prd {
+    uint32_t dba;
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;               /* Byte count - 1, bit 31 interrupts on completion */
+} __attribute__((packed)) ahci_prd_t;
+
+/* Command table */
+typedef struct ahci_cmd_table {
+    uint8_t    cfis[64];
+    uint8_t    acmd[16];
+    uint8_t    reserved[48];
+    ahci_prd_t prdt[AHCI_PRDT_ENTRIES];
+} __attribute__((packed)) ahci_cmd_table_t;
+
+struct ahci_hba;
+
+/* SATA port with a disk attached */
+typedef struct ahci_port {
+    struct ahci_hba *hba;       /* Owning controller */
+    uint8_t  index;             /* Port number */
+    volatile uint32_t *regs;    /* Port registers */
+
+    ahci_cmd_header_t *cmd_list;  /* 32 command headers */
+    uint64_t cmd_list_phys;
+    uint8_t *rfis;              /* Received FIS area */
+    uint64_t rfis_phys;
+    ahci_cmd_table_t *tables;   /* One command table per slot */
+    uint64_t tables_phys;
+
+    uint32_t num_slots;         /* Usable command slots, the port's blk-mq tags */
+    uint32_t pending;           /* Bitmap of prepared slots not issued yet */
+    uint32_t issued;            /* Bitmap of slots owned by the HBA */
+    uint32_t completed;         /* Bitmap of finished slots not yet collected */
+    uint32_t failed;            /* Bitmap of finished slots that failed */
+    bool     ncq;               /* Native command queuing in use */
+    uint32_t ncq_depth;         /* Tags the drive accepts */
+    uint32_t unqueued;          /* Bitmap of slots holding a non-queued command */
+    bool     write_cache;       /* Drive has its volatile write cache enabled */
+    bool     fua;               /* Drive accepts FUA writes */
+    bool     trim;              /* Drive supports DSM TRIM */
+    uint8_t *trim_ranges;       /* One DSM range block per slot */
+    uint64_t trim_ranges_phys;
+    uint64_t deadline_ns;       /* Timeout unless a command completes first */
+
+    uint64_t sectors;           /* Capacity in logical sectors */
+    uint32_t sector_size;       /* Logical sector size */
+
+    /* Statistics */
+    uint64_t commands;
+    uint32_t max_outstanding;
+
+    blk_mq_tag_set_t tag_set;   /* Hardware queue description for blk-mq */
+    block_device_t block;       /* Registered block device */
+} ahci_port_t;
+
+/* AHCI controller */
+typedef struct ahci_hba {
+    pci_device_t *pci;          /* Underlying PCI function */
+    volatile uint8_t *regs;     /* ABAR */
+    uint32_t cap;               /* Capabilities */
+    uint32_t num_slots;         /* Command slots per port */
+} ahci_hba_t;
+
+/**
+ * Register the AHCI driver
+ */
+void ahci_register_driver(void);
+
+#endif /* _DRIVERS_BLOCK_AHCI_H */
\ No newline at end of file
@@ -0,0 +1,252 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Budget fair queueing I/O scheduler
+ *
+ * Every I/O context gets its own queue. The disk is given to one queue at
+ * a time, which is served in sector order until it has used its budget
+ * of sectors or runs dry. The next queue is chosen by virtual finish
+ * time, as in WF2Q+: a queue's finish time advances by the service it
+ * received divided by its weight, so over time each backlogged context
+ * receives throughput in proportion to its weight regardless of how many
+ * requests it keeps queued. Each queue also keeps its requests in arrival
+ * order with deadlines, so a seek-heavy sweep cannot starve one of them.
+ *
+ * There are no timers yet, so a queue that runs dry is expired at once
+ * instead of being given an idle window to issue its next request.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/time.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/block/elevator.h>
+#include <mm/kmalloc.h>
+
+/* Tunables */
+#define BFQ_MAX_QUEUES          32      /* Contexts per hardware queue; more share the last */
+#define BFQ_BUDGET              2048    /* Sectors a queue is served per turn (1 MiB) */
+#define BFQ_READ_EXPIRE_NS      (125ULL * 1000000ULL)
+#define BFQ_WRITE_EXPIRE_NS     (250ULL * 1000000ULL)
+#define BFQ_SERVICE_SHIFT       16      /* Fixed-point fraction bits of virtual time */
+
+/* Per-context queue */
+typedef struct bfq_queue {
+    io_context_t *ioc;          /* Owner, NULL while the slot is unused */
+    elv_list_t sort;            /* Queued requests by sector */
+    elv_list_t fifo;            /* Queued requests by arrival */
+    uint32_t queued;            /* Requests waiting */
+    uint32_t dispatched;        /* Requests with the driver */
+    uint64_t next_sector;       /* Where the previous dispatch ended */
+
+    bool     active;            /* Competing for service */
+    uint16_t weight;            /* Weight for the current turn */
+    uint64_t start;             /* Virtual start time of the turn */
+    uint64_t finish;            /* Virtual finish time if the budget is used up */
+    uint32_t service;           /* Sectors served this turn */
+
+    /* Statistics */
+    uint64_t sectors;           /* Sectors dispatched in total */
+} bfq_queue_t;
+
+typedef struct bfq_data {
+    bfq_queue_t queues[BFQ_MAX_QUEUES];
+    bfq_queue_t *in_service;    /* Queue that owns the disk */
+    uint64_t vtime;             /* System virtual time */
+    uint32_t weight_sum;        /* Weights of the active queues */
+    uint32_t queued;            /* Requests waiting across all queues */
+} bfq_data_t;
+
+/**
+ * Convert sectors of service into virtual time at a given weight
+ */
+static inline uint64_t bfq_delta(uint32_t sectors, uint32_t weight) {
+    return ((uint64_t)sectors << BFQ_SERVICE_SHIFT) / weight;
+}
+
+/**
+ * Find the queue of an I/O context, claiming an unused slot if it has none
+ */
+static bfq_queue_t *bfq_get_queue(bfq_data_t *bfqd, io_context_t *ioc) {
+    bfq_queue_t *unused = NULL;
+
+    for (int i = 0; i < BFQ_MAX_QUEUES; i++) {
+        bfq_queue_t *bfqq = &bfqd->queues[i];
+        if (bfqq->ioc == ioc) {
+            return bfqq;
+        }
+        if (!unused && !bfqq->queued && !bfqq->dispatched && !bfqq->active &&
+            bfqq != bfqd->in_service) {
+            unused = bfqq;
+        }
+    }
+
+    if (!unused) {
+        return &bfqd->queues[BFQ_MAX_QUEUES - 1];
+    }
+
+    memset(unused, 0, sizeof(*unused));
+    unused->ioc = ioc;
+    return unused;
+}
+
+/**
+ * Start a new turn for a queue that has requests
+ */
+static void bfq_activate(bfq_data_t *bfqd, bfq_queue_t *bfqq) {
+    /* Weight changes take effect from the next turn */
+    bfqq->weight = bfqq->ioc ? bfqq->ioc->weight : IOC_DEFAULT_WEIGHT;
+    bfqq->start = bfqq->finish > bfqd->vtime ? bfqq->finish : bfqd->vtime;
+    bfqq->finish = bfqq->start + bfq_delta(BFQ_BUDGET, bfqq->weight);
+    bfqq->service = 0;
+    bfqq->active = true;
+    bfqd->weight_sum += bfqq->weight;
+}
+
+/**
+ * End a queue's turn, charging it for the service it actually received
+ */
+static void bfq_expire(bfq_data_t *bfqd, bfq_queue_t *bfqq) {
+    bfqq->finish = bfqq->start + bfq_delta(bfqq->service, bfqq->weight);
+    bfqq->active = false;
+    bfqd->weight_sum -= bfqq->weight;
+
+    if (bfqq->queued) {
+        bfq_activate(bfqd, bfqq);
+    }
+}
+
+/**
+ * Pick the eligible active queue with the earliest virtual finish time
+ */
+static bfq_queue_t *bfq_select_queue(bfq_data_t *bfqd) {
+    bfq_queue_t *best = NULL;
+    uint64_t min_start = UINT64_MAX;
+
+    for (int i = 0; i < BFQ_MAX_QUEUES; i++) {
+        bfq_queue_t *bfqq = &bfqd->queues[i];
+        if (bfqq->active && bfqq->start < min_start) {
+            min_start = bfqq->start;
+        }
+    }
+    if (min_start == UINT64_MAX) {
+        return NULL;
+    }
+
+    /* Nobody is eligible yet: jump virtual time to the earliest start */
+    if (min_start > bfqd->vtime) {
+        bfqd->vtime = min_start;
+    }
+
+    for (int i = 0; i < BFQ_MAX_QUEUES; i++) {
+        bfq_queue_t *bfqq = &bfqd->queues[i];
+        if (bfqq->active && bfqq->start <= bfqd->vtime &&
+            (!best || bfqq->finish < best->finish)) {
+            best = bfqq;
+        }
+    }
+    return best;
+}
+
+static int bfq_init_hctx(blk_mq_hw_ctx_t *hctx) {
+    hctx->sched_data = kzalloc(sizeof(bfq_data_t));
+    return hctx->sched_data ? 0 : -1;
+}
+
+static void bfq_exit_hctx(blk_mq_hw_ctx_t *hctx) {
+    kfree(hctx->sched_data);
+}
+
+static void bfq_insert(blk_mq_hw_ctx_t *hctx, request_t *rq) {
+    bfq_data_t *bfqd = (bfq_data_t *)hctx->sched_data;
+    bfq_queue_t *bfqq = bfq_get_queue(bfqd, rq->ioc);
+
+    rq->elv_priv = bfqq;
+    rq->deadline_ns = time_now_ns() +
+                      (rq->op == BIO_OP_READ ? BFQ_READ_EXPIRE_NS : BFQ_WRITE_EXPIRE_NS);
+    elv_sort_add(&bfqq->sort, rq);
+    elv_fifo_add(&bfqq->fifo, rq);
+    bfqq->queued++;
+    bfqd->queued++;
+
+    if (!bfqq->active) {
+        bfq_activate(bfqd, bfqq);
+    }
+}
+
+static bool bfq_has_work(blk_mq_hw_ctx_t *hctx) {
+    return ((bfq_data_t *)hctx->sched_data)->queued != 0;
+}
+
+static request_t *bfq_dispatch(blk_mq_hw_ctx_t *hctx) {
+    bfq_data_t *bfqd = (bfq_data_t *)hctx->sched_data;
+    bfq_queue_t *bfqq = bfqd->in_service;
+
+    if (bfqq && (!bfqq->queued || bfqq->service >= BFQ_BUDGET)) {
+        bfq_expire(bfqd, bfqq);
+        bfqq = NULL;
+    }
+    if (!bfqq) {
+        bfqq = bfq_select_queue(bfqd);
+        bfqd->in_service = bfqq;
+        if (!bfqq) {
+            return NULL;
+        }
+    }
+
+    /* Continue the upward sweep unless the oldest request has waited too long */
+    request_t *rq = bfqq->fifo.head;
+    if (time_now_ns() < rq->deadline_ns) {
+        rq = elv_sort_find(&bfqq->sort, bfqq->next_sector);
+        if (!rq) {
+            rq = bfqq->sort.head;
+        }
+    }
+
+    elv_sort_del(&bfqq->sort, rq);
+    elv_fifo_del(&bfqq->fifo, rq);
+    bfqq->queued--;
+    bfqq->dispatched++;
+    bfqd->queued--;
+
+    bfqq->next_sector = rq->sector + rq->nr_sectors;
+    bfqq->service += rq->nr_sectors;
+    bfqq->sectors += rq->nr_sectors;
+    bfqd->vtime += bfq_delta(rq->nr_sectors, bfqd->weight_sum);
+    return rq;
+}
+
+static void bfq_completed(blk_mq_hw_ctx_t *hctx, request_t *rq) {
+    (void)hctx;
+    ((bfq_queue_t *)rq->elv_priv)->dispatched--;
+}
+
+const elevator_type_t bfq_elevator = {
+    .name = "bfq",
+    .ops = {
+        .init_hctx = bfq_init_hctx,
+        .exit_hctx = bfq_exit_hctx,
+        .insert = bfq_insert,
+        .dispatch = bfq_dispatch,
+        .has_work = bfq_has_work,
+        .completed = bfq_completed
+    }
+};
\ No newline at end of file
@@ -0,0 +1,464 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Block I/O descriptors
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/cpu.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+
+/* Zeroed pages written per request when a device cannot write zeroes itself */
+#define BIO_ZERO_PAGES      16
+
+/**
+ * Allocate a bio with room for a number of segments
+ * @param device Target device
+ * @param op Operation (BIO_OP_*)
+ * @param sector First 512-byte sector
+ * @param max_vecs Segment capacity
+ * @return The bio, or NULL on failure
+ */
+bio_t *bio_alloc(block_device_t *device, uint32_t op, uint64_t sector, uint16_t max_vecs) {
+    if (!device) {
+        return NULL;
+    }
+
+    /* Segments live right behind the bio, so one allocation covers both */
+    bio_t *bio = (bio_t *)kmalloc(sizeof(bio_t) + (size_t)max_vecs * sizeof(bio_vec_t));
+    if (!bio) {
+        return NULL;
+    }
+
+    memset(bio, 0, sizeof(bio_t));
+    bio->device = device;
+    bio->op = op;
+    bio->sector = sector;
+    bio->max_vecs = max_vecs;
+    bio->vecs = (bio_vec_t *)(bio + 1);
+    return bio;
+}
+
+/**
+ * Free a bio (the data pages belong to the caller)
+ * @param bio Bio to free
+ */
+void bio_free(bio_t *bio) {
+    kfree(bio);
+}
+
+/**
+ * Append a page segment to a bio
+ * @param bio Bio
+ * @param page Page-aligned kernel virtual address
+ * @param len Bytes to add
+ * @param offset Byte offset within the page
+ * @return Bytes added (len, or 0 if the bio is full)
+ */
+uint32_t bio_add_page(bio_t *bio, void *page, uint32_t len, uint32_t offset) {
+    if (!bio || len == 0 || offset + len > PAGE_SIZE) {
+        return 0;
+    }
+
+    /* Extend the last segment if this continues it within the same page */
+    if (bio->vcnt > 0) {
+        bio_vec_t *last = &bio->vecs[bio->vcnt - 1];
+        if (last->page == page && last->offset + last->len == offset) {
+            last->len += len;
+            bio->size += len;
+            return len;
+        }
+
+        /* Some devices can only map segments that meet at page boundaries */
+        request_queue_t *q = bio->device->queue;
+        if (q && q->virt_boundary &&
+            (((last->offset + last->len) & (PAGE_SIZE - 1)) != 0 || offset != 0)) {
+            return 0;
+        }
+    }
+
+    if (bio->vcnt >= bio->max_vecs) {
+        return 0;
+    }
+
+    bio_vec_t *vec = &bio->vecs[bio->vcnt++];
+    vec->page = page;
+    vec->offset = offset;
+    vec->len = len;
+    bio->size += len;
+    return len;
+}
+
+/**
+ * Append a virtually contiguous buffer to a bio, one segment per page
+ * @param bio Bio
+ * @param buffer Kernel virtual address
+ * @param size Bytes to add
+ * @return Bytes added (may be short if the bio runs out of segments)
+ */
+size_t bio_add_buffer(bio_t *bio, void *buffer, size_t size) {
+    uint8_t *data = (uint8_t *)buffer;
+    size_t added = 0;
+
+    while (added < size) {
+        uintptr_t addr = (uintptr_t)(data + added);
+        uint32_t offset = addr & (PAGE_SIZE - 1);
+        uint32_t chunk = PAGE_SIZE - offset;
+        if (chunk > size - added) {
+            chunk = size - added;
+        }
+
+        if (bio_add_page(bio, (void *)(addr - offset), chunk, offset) != chunk) {
+            break;
+        }
+        added += chunk;
+    }
+
+    return added;
+}
+
+/**
+ * Complete a bio; called by the block layer when its request finishes
+ * @param bio Bio
+ * @param status 0 on success, negative on error
+ */
+void bio_endio(bio_t *bio, int status) {
+    bio->status = status;
+    bio->flags |= BIO_DONE;
+    if (bio->end_io) {
+        bio->end_io(bio);
+    }
+}
+
+/**
+ * Append a buffer to a bio, trimmed to end on a logical block of its device
+ * @param bio Bio
+ * @param buffer Kernel virtual address
+ * @param size Bytes to add
+ * @return Bytes added (0 if not even one logical block fits)
+ */
+size_t bio_add_blocks(bio_t *bio, void *buffer, size_t size) {
+    size_t added = bio_add_buffer(bio, buffer, size);
+
+    /* A bio that ran out of segments must still end on a logical block */
+    request_queue_t *q = bio->device->queue;
+    uint32_t lbs = q ? q->logical_block_size : BLOCK_SECTOR_SIZE;
+    size_t excess = added % lbs;
+    while (excess) {
+        bio_vec_t *last = &bio->vecs[bio->vcnt - 1];
+        uint32_t trim = excess < last->len ? excess : last->len;
+        last->len -= trim;
+        bio->size -= trim;
+        added -= trim;
+        excess -= trim;
+        if (last->len == 0) {
+            bio->vcnt--;
+        }
+    }
+    return added;
+}
+
+/**
+ * Submit a bio; with a plug active it is batched until the plug finishes
+ * @param bio Bio with a sector-aligned size
+ * @return 0 on success, negative if the bio is invalid (it is then completed with an error)
+ */
+int bio_submit(bio_t *bio) {
+    if (!bio) {
+        return -1;
+    }
+
+    block_device_t *device = bio->device;
+    bio->flags &= ~BIO_DONE;
+    bio->flags |= BIO_SUBMITTED;
+    bio->status = 0;
+    bio->next = NULL;
+    if (!bio->ioc) {
+        bio->ioc = ioc_current();
+    }
+
+    request_queue_t *q = device->queue;
+    bool valid = q != NULL;
+    if (valid && bio->op == BIO_OP_FLUSH) {
+        valid = bio->size == 0;
+    } else if (valid) {
+        uint32_t lbs_sectors = q->logical_block_size / BLOCK_SECTOR_SIZE;
+        valid = bio->op <= BIO_OP_WRITE_ZEROES &&
+                bio->size != 0 && (bio->size % q->logical_block_size) == 0 &&
+                (bio->sector % lbs_sectors) == 0 &&
+                bio_end_sector(bio) <= device->size / BLOCK_SECTOR_SIZE;
+        if (valid && bio_op_dataless(bio->op)) {
+            valid = bio->vcnt == 0 && bio_sectors(bio) <= blk_queue_max_sectors(q, bio->op);
+        }
+    }
+    if (!valid) {
+        kerr("BIO: %s: Invalid bio at sector %lu, %u bytes\n",
+             device->name, bio->sector, bio->size);
+        bio_endio(bio, -1);
+        return -1;
+    }
+
+    blk_queue_submit_bio(q, bio);
+    return 0;
+}
+
+/**
+ * Check whether a bio has completed
+ */
+static bool bio_done(void *arg) {
+    return ((volatile bio_t *)arg)->flags & BIO_DONE;
+}
+
+/**
+ * Wait for a bio to complete, flushing the caller's plug first
+ * @param bio Submitted bio
+ * @return Completion status
+ */
+int bio_wait(bio_t *bio) {
+    if (!(bio->flags & BIO_DONE)) {
+        /* The bio may still be sitting in our own plug */
+        blk_flush_plug();
+    }
+
+    blk_wait_io(bio->device->queue, bio->op, bio->size, bio_done, bio);
+    return bio->status;
+}
+
+/**
+ * Read or write a buffer synchronously through the block layer
+ * @param device Target device
+ * @param op BIO_OP_READ or BIO_OP_WRITE
+ * @param sector First 512-byte sector
+ * @param buffer Kernel virtual address
+ * @param size Bytes, a multiple of the sector size
+ * @return 0 on success, negative on error
+ */
+int bio_rw_sync(block_device_t *device, uint32_t op, uint64_t sector, void *buffer, size_t size) {
+    uint8_t *data = (uint8_t *)buffer;
+    int result = 0;
+
+    while (size > 0 && result == 0) {
+        bio_t *bio = bio_alloc(device, op, sector, BIO_MAX_VECS);
+        if (!bio) {
+            return -1;
+        }
+
+        size_t added = bio_add_blocks(bio, data, size);
+        if (added == 0) {
+            bio_free(bio);
+            return -1;
+        }
+
+        bio_submit(bio);
+        result = bio_wait(bio);
+        bio_free(bio);
+
+        data += added;
+        sector += added / BLOCK_SECTOR_SIZE;
+        size -= added;
+    }
+
+    return result;
+}
+
+/**
+ * Flush a device's volatile write cache and wait for it
+ * @param device Target device
+ * @return 0 on success, negative on error
+ */
+int bio_flush_sync(block_device_t *device) {
+    bio_t *bio = bio_alloc(device, BIO_OP_FLUSH, 0, 0);
+    if (!bio) {
+        return -1;
+    }
+
+    bio_submit(bio);
+    int result = bio_wait(bio);
+    bio_free(bio);
+    return result;
+}
+
+/**
+ * Issue a discard or write zeroes over a sector range, in requests no larger
+ * than the device takes, and wait for all of them
+ * @return 0 on success, negative on error
+ */
+static int bio_dataless_sync(block_device_t *device, uint32_t op, uint64_t sector, uint64_t nr_sectors) {
+    request_queue_t *q = device->queue;
+    uint32_t lbs_sectors = q->logical_block_size / BLOCK_SECTOR_SIZE;
+    uint32_t max = blk_queue_max_sectors(q, op) / lbs_sectors * lbs_sectors;
+    if (max == 0) {
+        return -1;
+    }
+
+    bio_t *batch[BLK_PLUG_MAX_REQUESTS];
+    int result = 0;
+
+    while (nr_sectors > 0 && result == 0) {
+        uint32_t queued = 0;
+        blk_plug_t plug;
+        blk_start_plug(&plug);
+
+        while (nr_sectors > 0 && queued < BLK_PLUG_MAX_REQUESTS) {
+            uint32_t count = nr_sectors < max ? (uint32_t)nr_sectors : max;
+            bio_t *bio = bio_alloc(device, op, sector, 0);
+            if (!bio) {
+                result = -1;
+                break;
+            }
+
+            bio->size = count * BLOCK_SECTOR_SIZE;
+            bio_submit(bio);
+            batch[queued++] = bio;
+            sector += count;
+            nr_sectors -= count;
+        }
+
+        blk_finish_plug(&plug);
+
+        for (uint32_t i = 0; i < queued; i++) {
+            if (bio_wait(batch[i]) < 0) {
+                result = -1;
+            }
+            bio_free(batch[i]);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Discard a sector range and wait for it
+ * @param device Target device
+ * @param sector First sector
+ * @param nr_sectors Sectors to discard
+ * @return 0 on success, negative on error or if the device cannot discard
+ */
+int bio_discard_sync(block_device_t *device, uint64_t sector, uint64_t nr_sectors) {
+    if (!device || !device->queue || !device->queue->max_discard_sectors) {
+        return -1;
+    }
+
+    /* Only whole granules are unmapped; partial ones at either end are kept */
+    uint64_t granule = device->queue->discard_granularity / BLOCK_SECTOR_SIZE;
+    uint64_t start = (sector + granule - 1) / granule * granule;
+    uint64_t end = (sector + nr_sectors) / granule * granule;
+    if (end <= start) {
+        return 0;
+    }
+
+    return bio_dataless_sync(device, BIO_OP_DISCARD, start, end - start);
+}
+
+/**
+ * Zero a sector range and wait for it, writing zeroed pages if the device
+ * has no command for it
+ * @param device Target device
+ * @param sector First sector
+ * @param nr_sectors Sectors to zero
+ * @return 0 on success, negative on error
+ */
+int bio_write_zeroes_sync(block_device_t *device, uint64_t sector, uint64_t nr_sectors) {
+    if (!device || !device->queue) {
+        return -1;
+    }
+
+    if (device->queue->max_write_zeroes_sectors) {
+        return bio_dataless_sync(device, BIO_OP_WRITE_ZEROES, sector, nr_sectors);
+    }
+
+    uint64_t phys;
+    size_t pages = BIO_ZERO_PAGES;
+    void *zeroes = pmm_alloc_dma(pages, &phys);
+    if (!zeroes) {
+        return -1;
+    }
+
+    int result = 0;
+    uint64_t chunk = pages * PAGE_SIZE / BLOCK_SECTOR_SIZE;
+    while (nr_sectors > 0 && result == 0) {
+        uint64_t count = nr_sectors < chunk ? nr_sectors : chunk;
+        result = bio_rw_sync(device, BIO_OP_WRITE, sector, zeroes, count * BLOCK_SECTOR_SIZE);
+        sector += count;
+        nr_sectors -= count;
+    }
+
+    pmm_free_dma(zeroes, pages);
+    return result;
+}
+
+/**
+ * Read or write an arbitrary byte range through the block layer
+ *
+ * Aligned transfers go straight to bio_rw_sync; otherwise the covering
+ * logical blocks are bounced, and partial writes are read-modify-write.
+ * @param device Target device
+ * @param op BIO_OP_READ or BIO_OP_WRITE
+ * @param offset Byte offset
+ * @param size Bytes to transfer
+ * @param buffer Kernel virtual address
+ * @return 0 on success, negative on error
+ */
+int bio_rw_bytes(block_device_t *device, uint32_t op, uint64_t offset, size_t size, void *buffer) {
+    if (!device || !device->queue || !buffer) {
+        return -1;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    if (offset + size < offset || offset + size > device->size) {
+        return -1;
+    }
+
+    uint32_t lbs = device->queue->logical_block_size;
+    uint64_t start = offset - offset % lbs;
+    uint64_t end = offset + size;
+    if (end % lbs) {
+        end += lbs - end % lbs;
+    }
+
+    if (start == offset && end == offset + size) {
+        return bio_rw_sync(device, op, offset / BLOCK_SECTOR_SIZE, buffer, size);
+    }
+
+    uint8_t *bounce = (uint8_t *)kmalloc(end - start);
+    if (!bounce) {
+        return -1;
+    }
+
+    int result = bio_rw_sync(device, BIO_OP_READ, start / BLOCK_SECTOR_SIZE, bounce, end - start);
+    if (result == 0) {
+        if (op == BIO_OP_READ) {
+            memcpy(buffer, bounce + (offset - start), size);
+        } else {
+            memcpy(bounce + (offset - start), buffer, size);
+            result = bio_rw_sync(device, BIO_OP_WRITE, start / BLOCK_SECTOR_SIZE, bounce, end - start);
+        }
+    }
+
+    kfree(bounce);
+    return result;
+}
\ No newline at end of file
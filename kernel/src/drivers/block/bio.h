@@ -0,0 +1,236 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Block I/O descriptors
+ */
+
+#ifndef _DRIVERS_BLOCK_BIO_H
+#define _DRIVERS_BLOCK_BIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/block.h>
+
+/* Operations */
+#define BIO_OP_READ         0
+#define BIO_OP_WRITE        1
+#define BIO_OP_FLUSH        2   /* Flush the device's volatile write cache; carries no data */
+#define BIO_OP_DISCARD      3   /* Sectors are unused; their contents become undefined */
+#define BIO_OP_WRITE_ZEROES 4   /* Zero sectors without transferring data */
+
+/* Request flags (bio_t.op_flags) */
+#define BIO_REQ_PREFLUSH    (1U << 0)   /* Flush the write cache before writing */
+#define BIO_REQ_FUA         (1U << 1)   /* Complete only once the data is on stable media */
+
+/* State flags */
+#define BIO_DONE            (1U << 0)   /* Completed, status is valid */
+#define BIO_SUBMITTED       (1U << 1)   /* Handed to the block layer */
+
+/* Default segment capacity for bio_alloc callers that do not care */
+#define BIO_MAX_VECS        64
+
+struct block_device;
+struct io_context;
+
+/* One segment of a bio; never crosses a page boundary */
+typedef struct bio_vec {
+    void *page;                 /* Page-aligned kernel virtual address */
+    uint32_t offset;            /* Byte offset within the page */
+    uint32_t len;               /* Bytes in this segment */
+} bio_vec_t;
+
+/* A single block I/O: one contiguous sector range, scattered in memory */
+typedef struct bio {
+    struct block_device *device;    /* Target device */
+    uint32_t op;                    /* BIO_OP_* */
+    uint32_t op_flags;              /* BIO_REQ_* */
+    uint32_t flags;                 /* BIO_* state flags */
+    uint64_t sector;                /* First 512-byte sector */
+    uint32_t size;                  /* Total bytes */
+    uint16_t vcnt;                  /* Segments in use */
+    uint16_t max_vecs;              /* Segment capacity */
+    bio_vec_t *vecs;                /* Segments */
+    int status;                     /* 0 on success, negative on error */
+    void (*end_io)(struct bio *bio);/* Completion callback (may be NULL) */
+    void *private_data;             /* Owner data for end_io */
+    struct io_context *ioc;         /* Submitter; bio_submit fills in the current one */
+    struct bio *next;               /* Next bio in a request or plug list */
+} bio_t;
+
+/**
+ * Get the number of sectors a bio covers
+ */
+static inline uint32_t bio_sectors(const bio_t *bio) {
+    return bio->size / BLOCK_SECTOR_SIZE;
+}
+
+/**
+ * Get the sector following the last one a bio covers
+ */
+static inline uint64_t bio_end_sector(const bio_t *bio) {
+    return bio->sector + bio_sectors(bio);
+}
+
+/**
+ * Get a printable name for an operation
+ */
+static inline const char *bio_op_name(uint32_t op) {
+    switch (op) {
+        case BIO_OP_READ:  return "Read";
+        case BIO_OP_WRITE: return "Write";
+        case BIO_OP_FLUSH: return "Flush";
+        case BIO_OP_DISCARD: return "Discard";
+        case BIO_OP_WRITE_ZEROES: return "Write zeroes";
+        default:           return "Unknown";
+    }
+}
+
+/**
+ * Check whether an operation covers a sector range but carries no data
+ */
+static inline bool bio_op_dataless(uint32_t op) {
+    return op == BIO_OP_DISCARD || op == BIO_OP_WRITE_ZEROES;
+}
+
+/**
+ * Get the kernel virtual address of a segment
+ */
+static inline void *bio_vec_addr(const bio_vec_t *vec) {
+    return (uint8_t *)vec->page + vec->offset;
+}
+
+/**
+ * Allocate a bio with room for a number of segments
+ * @param device Target device
+ * @param op Operation (BIO_OP_*)
+ * @param sector First 512-byte sector
+ * @param max_vecs Segment capacity
+ * @return The bio, or NULL on failure
+ */
+bio_t *bio_alloc(struct block_device *device, uint32_t op, uint64_t sector, uint16_t max_vecs);
+
+/**
+ * Free a bio (the data pages belong to the caller)
+ * @param bio Bio to free
+ */
+void bio_free(bio_t *bio);
+
+/**
+ * Append a page segment to a bio
+ * @param bio Bio
+ * @param page Page-aligned kernel virtual address
+ * @param len Bytes to add
+ * @param offset Byte offset within the page
+ * @return Bytes added (len, or 0 if the bio is full)
+ */
+uint32_t bio_add_page(bio_t *bio, void *page, uint32_t len, uint32_t offset);
+
+/**
+ * Append a virtually contiguous buffer to a bio, one segment per page
+ * @param bio Bio
+ * @param buffer Kernel virtual address
+ * @param size Bytes to add
+ * @return Bytes added (may be short if the bio runs out of segments)
+ */
+size_t bio_add_buffer(bio_t *bio, void *buffer, size_t size);
+
+/**
+ * Append a buffer to a bio, trimmed to end on a logical block of its device
+ * @param bio Bio
+ * @param buffer Kernel virtual address
+ * @param size Bytes to add
+ * @return Bytes added (0 if not even one logical block fits)
+ */
+size_t bio_add_blocks(bio_t *bio, void *buffer, size_t size);
+
+/**
+ * Submit a bio; with a plug active it is batched until the plug finishes
+ * @param bio Bio with a sector-aligned size
+ * @return 0 on success, negative if the bio is invalid (it is then completed with an error)
+ */
+int bio_submit(bio_t *bio);
+
+/**
+ * Wait for a bio to complete, flushing the caller's plug first
+ * @param bio Submitted bio
+ * @return Completion status
+ */
+int bio_wait(bio_t *bio);
+
+/**
+ * Complete a bio; called by the block layer when its request finishes
+ * @param bio Bio
+ * @param status 0 on success, negative on error
+ */
+void bio_endio(bio_t *bio, int status);
+
+/**
+ * Read or write a buffer synchronously through the block layer
+ * @param device Target device
+ * @param op BIO_OP_READ or BIO_OP_WRITE
+ * @param sector First 512-byte sector
+ * @param buffer Kernel virtual address
+ * @param size Bytes, a multiple of the sector size
+ * @return 0 on success, negative on error
+ */
+int bio_rw_sync(struct block_device *device, uint32_t op, uint64_t sector, void *buffer, size_t size);
+
+/**
+ * Flush a device's volatile write cache and wait for it
+ *
+ * Writes that completed before the call are on stable media when it
+ * returns. Devices without a write cache return at once.
+ * @param device Target device
+ * @return 0 on success, negative on error
+ */
+int bio_flush_sync(struct block_device *device);
+
+/**
+ * Discard a sector range and wait for it
+ *
+ * The range is trimmed to the device's discard granularity and split into
+ * the largest requests the device takes.
+ * @param device Target device
+ * @param sector First sector
+ * @param nr_sectors Sectors to discard
+ * @return 0 on success, negative on error or if the device cannot discard
+ */
+int bio_discard_sync(struct block_device *device, uint64_t sector, uint64_t nr_sectors);
+
+/**
+ * Zero a sector range and wait for it, writing zeroed pages if the device
+ * has no command for it
+ * @param device Target device
+ * @param sector First sector
+ * @param nr_sectors Sectors to zero
+ * @return 0 on success, negative on error
+ */
+int bio_write_zeroes_sync(struct block_device *device, uint64_t sector, uint64_t nr_sectors);
+
+/**
+ * Read or write an arbitrary byte range through the block layer
+ * @param device Target device
+ * @param op BIO_OP_READ or BIO_OP_WRITE
+ * @param offset Byte offset
+ * @param size Bytes to transfer
+ * @param buffer Kernel virtual address
+ * @return 0 on success, negative on error
+ */
+int bio_rw_bytes(struct block_device *device, uint32_t op, uint64_t offset, size_t size, void *buffer);
+
+#endif /* _DRIVERS_BLOCK_BIO_H */
\ No newline at end of file
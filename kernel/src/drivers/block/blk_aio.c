@@ -0,0 +1,295 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Asynchronous block I/O
+ *
+ * An asynchronous I/O is split into bios that are submitted right away;
+ * the descriptor keeps a count of those still in flight and the last one
+ * to finish reports the result through the callback, wait queue and
+ * completion ring the caller asked for. Waiting is left to the caller,
+ * who can sleep or poll as the device is configured to.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/wait.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_aio.h>
+#include <mm/kmalloc.h>
+
+/* What a ring waiter is waiting for */
+typedef struct blk_cq_wait {
+    blk_cq_ring_t *ring;
+    uint32_t min;
+} blk_cq_wait_t;
+
+/**
+ * Report a finished I/O to everyone who asked
+ */
+static void blk_aio_finish(blk_aio_t *aio) {
+    aio->latency_ns = time_now_ns() - aio->submit_ns;
+
+    /* The callback may reuse the descriptor, so it runs last */
+    void (*complete)(blk_aio_t *aio) = aio->complete;
+    wait_queue_t *wait = aio->wait;
+    blk_cq_ring_t *ring = aio->ring;
+
+    if (ring) {
+        /* The slot was reserved at submission, so there is always room */
+        uint64_t flags = cpu_irq_save();
+        blk_cqe_t *cqe = &ring->entries[ring->tail & ring->mask];
+        cqe->user_data = aio->user_data;
+        cqe->status = aio->status;
+        cqe->bytes = (uint32_t)aio->size;
+        cqe->latency_ns = aio->latency_ns;
+        __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+        ring->inflight--;
+        cpu_irq_restore(flags);
+        wake_up(&ring->wait);
+    }
+
+    __atomic_store_n(&aio->done, true, __ATOMIC_RELEASE);
+    if (wait) {
+        wake_up(wait);
+    }
+    if (complete) {
+        complete(aio);
+    }
+}
+
+/**
+ * Drop one in-flight reference, finishing the I/O with the last
+ */
+static void blk_aio_put(blk_aio_t *aio) {
+    if (__atomic_sub_fetch(&aio->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        blk_aio_finish(aio);
+    }
+}
+
+/**
+ * Completion of one bio of an asynchronous I/O
+ */
+static void blk_aio_end_io(bio_t *bio) {
+    blk_aio_t *aio = (blk_aio_t *)bio->private_data;
+
+    if (bio->status < 0) {
+        aio->status = bio->status;
+    }
+    bio_free(bio);
+    blk_aio_put(aio);
+}
+
+/**
+ * Start an I/O and return without waiting for it
+ * @param aio Descriptor; must stay valid until it completes
+ * @return 0 if the I/O was started (failures are then reported on
+ *         completion), negative if it is invalid or the ring has no room
+ */
+int blk_aio_submit(blk_aio_t *aio) {
+    if (!aio || !aio->device || !aio->device->queue || !aio->buffer || aio->size == 0) {
+        return -1;
+    }
+    if (aio->op != BIO_OP_READ && aio->op != BIO_OP_WRITE) {
+        return -1;
+    }
+
+    block_device_t *device = aio->device;
+    request_queue_t *q = device->queue;
+    uint32_t lbs = q->logical_block_size;
+    if (aio->offset % lbs || aio->size % lbs || aio->size > UINT32_MAX ||
+        aio->offset + aio->size < aio->offset || aio->offset + aio->size > device->size) {
+        return -1;
+    }
+
+    blk_cq_ring_t *ring = aio->ring;
+    if (ring) {
+        uint64_t flags = cpu_irq_save();
+        if (ring->inflight + blk_cq_ring_ready(ring) > ring->mask) {
+            cpu_irq_restore(flags);
+            return -1;
+        }
+        if (ring->inflight == 0) {
+            ring->queue = q;
+        } else if (ring->queue != q) {
+            ring->queue = NULL;
+        }
+        ring->inflight++;
+        ring->last_op = aio->op;
+        ring->last_bytes = (uint32_t)aio->size;
+        cpu_irq_restore(flags);
+    }
+
+    aio->done = false;
+    aio->status = 0;
+    aio->latency_ns = 0;
+    aio->submit_ns = time_now_ns();
+
+    /* Hold a reference while submitting so early completions cannot finish the I/O */
+    aio->pending = 1;
+
+    uint8_t *data = (uint8_t *)aio->buffer;
+    uint64_t sector = aio->offset / BLOCK_SECTOR_SIZE;
+    size_t left = aio->size;
+    while (left > 0) {
+        bio_t *bio = bio_alloc(device, aio->op, sector, BIO_MAX_VECS);
+        size_t added = bio ? bio_add_blocks(bio, data, left) : 0;
+        if (added == 0) {
+            /* Whatever was submitted still completes; the I/O as a whole fails */
+            if (bio) {
+                bio_free(bio);
+            }
+            aio->status = -1;
+            break;
+        }
+
+        bio->end_io = blk_aio_end_io;
+        bio->private_data = aio;
+        __atomic_add_fetch(&aio->pending, 1, __ATOMIC_RELAXED);
+        bio_submit(bio);
+
+        data += added;
+        sector += added / BLOCK_SECTOR_SIZE;
+        left -= added;
+    }
+
+    blk_aio_put(aio);
+    return 0;
+}
+
+/**
+ * Check whether an asynchronous I/O has finished
+ */
+static bool blk_aio_done(void *arg) {
+    return __atomic_load_n(&((blk_aio_t *)arg)->done, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Wait for an I/O started with blk_aio_submit
+ * @param aio Submitted descriptor
+ * @return Completion status
+ */
+int blk_aio_wait(blk_aio_t *aio) {
+    if (!blk_aio_done(aio)) {
+        /* The bios may still be sitting in our own plug */
+        blk_flush_plug();
+    }
+
+    blk_wait_io(aio->device->queue, aio->op, (uint32_t)aio->size, blk_aio_done, aio);
+    return aio->status;
+}
+
+/**
+ * Set up a completion ring
+ * @param ring Ring to initialize
+ * @param entries Capacity, a power of two
+ * @return 0 on success, negative on error
+ */
+int blk_cq_ring_init(blk_cq_ring_t *ring, uint32_t entries) {
+    if (!ring || entries == 0 || (entries & (entries - 1))) {
+        return -1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->entries = (blk_cqe_t *)kmalloc((size_t)entries * sizeof(blk_cqe_t));
+    if (!ring->entries) {
+        return -1;
+    }
+    ring->mask = entries - 1;
+    wait_queue_init(&ring->wait);
+    return 0;
+}
+
+/**
+ * Release a completion ring; no I/O may be in flight against it
+ * @param ring Ring
+ */
+void blk_cq_ring_free(blk_cq_ring_t *ring) {
+    if (!ring) {
+        return;
+    }
+    if (ring->inflight) {
+        kerr("BLOCK: Freeing a completion ring with %u I/Os in flight\n", ring->inflight);
+    }
+    kfree(ring->entries);
+    ring->entries = NULL;
+}
+
+/**
+ * Take the oldest completion from a ring
+ * @param ring Ring
+ * @param cqe Output for the entry
+ * @return true if an entry was taken, false if the ring is empty
+ */
+bool blk_cq_ring_pop(blk_cq_ring_t *ring, blk_cqe_t *cqe) {
+    if (blk_cq_ring_ready(ring) == 0) {
+        return false;
+    }
+
+    *cqe = ring->entries[ring->head & ring->mask];
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Check whether a ring holds as many completions as its waiter wants
+ */
+static bool blk_cq_ring_has(void *arg) {
+    blk_cq_wait_t *w = (blk_cq_wait_t *)arg;
+    return blk_cq_ring_ready(w->ring) >= w->min;
+}
+
+/**
+ * Wait until a ring holds a number of completions
+ * @param ring Ring
+ * @param min Completions wanted; capped at what is ready or in flight
+ * @return Completions ready
+ */
+uint32_t blk_cq_ring_wait(blk_cq_ring_t *ring, uint32_t min) {
+    blk_cq_wait_t w = { .ring = ring, .min = min };
+    uint32_t limit = blk_cq_ring_ready(ring) + ring->inflight;
+    if (w.min > limit) {
+        w.min = limit;
+    }
+    if (blk_cq_ring_has(&w)) {
+        return blk_cq_ring_ready(ring);
+    }
+
+    blk_flush_plug();
+
+    if (ring->queue) {
+        blk_wait_io(ring->queue, ring->last_op, ring->last_bytes, blk_cq_ring_has, &w);
+    } else {
+        /* I/O is in flight on several devices; poll them all */
+        while (!blk_cq_ring_has(&w)) {
+            uint32_t reaped = 0;
+            for (int i = 0; i < block_device_count(); i++) {
+                reaped += blk_queue_poll(block_device_get(i)->queue);
+            }
+            if (reaped == 0) {
+                cpu_relax();
+            }
+        }
+    }
+    return blk_cq_ring_ready(ring);
+}
\ No newline at end of file
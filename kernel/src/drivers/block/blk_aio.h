@@ -0,0 +1,144 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Asynchronous block I/O
+ */
+
+#ifndef _DRIVERS_BLOCK_BLK_AIO_H
+#define _DRIVERS_BLOCK_BLK_AIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <kernel/wait.h>
+#include <drivers/block/block.h>
+
+struct request_queue;
+struct blk_aio;
+
+/* Completion queue entry */
+typedef struct blk_cqe {
+    uint64_t user_data;         /* Cookie of the finished I/O */
+    int32_t  status;            /* 0 on success, negative on error */
+    uint32_t bytes;             /* Size of the I/O */
+    uint64_t latency_ns;        /* Submission to completion */
+} blk_cqe_t;
+
+/*
+ * Completion ring. Finished I/O appends an entry at the tail and a single
+ * consumer takes them from the head. Every submission reserves its slot up
+ * front, so completions never find the ring full.
+ */
+typedef struct blk_cq_ring {
+    blk_cqe_t *entries;         /* Entry array */
+    uint32_t mask;              /* Entries - 1 */
+    volatile uint32_t head;     /* Next entry to consume */
+    volatile uint32_t tail;     /* Next entry to fill */
+    volatile uint32_t inflight; /* Slots reserved by submitted I/O */
+    wait_queue_t wait;          /* Woken when entries arrive */
+
+    /* Where the in-flight I/O went, so waiters know what to poll */
+    struct request_queue *queue;/* Queue of all in-flight I/O, NULL if mixed */
+    uint32_t last_op;           /* Most recent submission, for latency estimates */
+    uint32_t last_bytes;
+} blk_cq_ring_t;
+
+/* Asynchronous I/O descriptor; owned by the caller until completion */
+typedef struct blk_aio {
+    /* Filled in by the caller */
+    block_device_t *device;     /* Target device */
+    uint32_t op;                /* BIO_OP_READ or BIO_OP_WRITE */
+    uint64_t offset;            /* Byte offset, logical-block aligned */
+    void    *buffer;            /* Kernel virtual address */
+    size_t   size;              /* Bytes, a multiple of the logical block size */
+
+    /* Completion notification; any combination, or none to just wait */
+    void   (*complete)(struct blk_aio *aio); /* Callback, may run in interrupt context */
+    wait_queue_t *wait;         /* Woken on completion */
+    blk_cq_ring_t *ring;        /* Receives an entry on completion */
+    uint64_t user_data;         /* Copied into the ring entry */
+    void    *private_data;      /* Caller's data for the callback */
+
+    /* Result */
+    volatile bool done;         /* Completed, status is valid */
+    int      status;            /* 0 on success, negative on error */
+    uint64_t submit_ns;         /* When blk_aio_submit was called */
+    uint64_t latency_ns;        /* Submission to completion */
+
+    /* Block layer state */
+    uint32_t pending;           /* Bios in flight, plus one while submitting */
+} blk_aio_t;
+
+/**
+ * Start an I/O and return without waiting for it
+ *
+ * Completion is signalled through the callback, the wait queue and the
+ * ring the descriptor names. On devices that complete synchronously this
+ * happens before the call returns. With a plug active, the I/O is held
+ * until the plug is flushed.
+ * @param aio Descriptor; must stay valid until it completes
+ * @return 0 if the I/O was started (failures are then reported on
+ *         completion), negative if it is invalid or the ring has no room
+ */
+int blk_aio_submit(blk_aio_t *aio);
+
+/**
+ * Wait for an I/O started with blk_aio_submit, polling or sleeping as
+ * configured for its device
+ * @param aio Submitted descriptor
+ * @return Completion status
+ */
+int blk_aio_wait(blk_aio_t *aio);
+
+/**
+ * Set up a completion ring
+ * @param ring Ring to initialize
+ * @param entries Capacity, a power of two
+ * @return 0 on success, negative on error
+ */
+int blk_cq_ring_init(blk_cq_ring_t *ring, uint32_t entries);
+
+/**
+ * Release a completion ring; no I/O may be in flight against it
+ * @param ring Ring
+ */
+void blk_cq_ring_free(blk_cq_ring_t *ring);
+
+/**
+ * Get the number of completions waiting to be consumed
+ */
+static inline uint32_t blk_cq_ring_ready(const blk_cq_ring_t *ring) {
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - ring->head;
+}
+
+/**
+ * Take the oldest completion from a ring
+ * @param ring Ring
+ * @param cqe Output for the entry
+ * @return true if an entry was taken, false if the ring is empty
+ */
+bool blk_cq_ring_pop(blk_cq_ring_t *ring, blk_cqe_t *cqe);
+
+/**
+ * Wait until a ring holds a number of completions
+ * @param ring Ring
+ * @param min Completions wanted; capped at what is ready or in flight
+ * @return Completions ready
+ */
+uint32_t blk_cq_ring_wait(blk_cq_ring_t *ring, uint32_t min);
+
+#endif /* _DRIVERS_BLOCK_BLK_AIO_H */
\ No newline at end of file
@@ -0,0 +1,707 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Multi-queue block layer
+ *
+ * Every CPU stages requests on its own software queue, which feeds one of
+ * the device's hardware queues. Requests come from a preallocated pool per
+ * hardware queue, indexed by an internal tag. When one is sent to the
+ * driver it also takes a driver tag, which the driver uses directly as its
+ * command ID; with an I/O scheduler attached, requests wait in the
+ * scheduler instead of the software queues until a driver tag frees up.
+ * Completions are finished on the CPU that submitted the request: a
+ * completion that arrives elsewhere is queued on the submitter's software
+ * queue and picked up the next time it polls.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <lib/sbitmap.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/block/elevator.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+
+/* The software queue map of a hardware queue is one 64-bit word */
+_Static_assert(MAX_CPUS <= 64, "blk-mq ctx_map holds one bit per CPU");
+
+/**
+ * Set up the software and hardware queues of a request queue
+ * @param q Queue
+ * @param set Tag set describing the device
+ * @return 0 on success, negative on error
+ */
+int blk_mq_init_queue(request_queue_t *q, blk_mq_tag_set_t *set) {
+    if (!set->ops || !set->ops->queue_rq || set->nr_hw_queues == 0 || set->queue_depth == 0) {
+        return -1;
+    }
+
+    q->tag_set = set;
+    if (set->max_sectors) {
+        q->max_sectors = set->max_sectors;
+    }
+    if (set->max_segments) {
+        q->max_segments = set->max_segments;
+    }
+    if (set->logical_block_size) {
+        q->logical_block_size = set->logical_block_size;
+    }
+    q->virt_boundary = set->virt_boundary;
+    q->max_discard_sectors = set->max_discard_sectors < BLK_MAX_DATALESS_SECTORS ?
+                             set->max_discard_sectors : BLK_MAX_DATALESS_SECTORS;
+    q->max_write_zeroes_sectors = set->max_write_zeroes_sectors < BLK_MAX_DATALESS_SECTORS ?
+                                  set->max_write_zeroes_sectors : BLK_MAX_DATALESS_SECTORS;
+    q->discard_granularity = set->discard_granularity ? set->discard_granularity
+                                                      : q->logical_block_size;
+    q->write_cache = (set->flags & BLK_MQ_F_WRITE_CACHE) != 0;
+    q->fua = q->write_cache && (set->flags & BLK_MQ_F_FUA);
+
+    q->hctxs = (blk_mq_hw_ctx_t *)kzalloc(set->nr_hw_queues * sizeof(blk_mq_hw_ctx_t));
+    q->ctxs = (blk_mq_ctx_t *)kmalloc(MAX_CPUS * sizeof(blk_mq_ctx_t) + 63);
+    if (!q->hctxs || !q->ctxs) {
+        blk_mq_free_queue(q);
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < set->nr_hw_queues; i++) {
+        blk_mq_hw_ctx_t *hctx = &q->hctxs[i];
+        hctx->queue = q;
+        hctx->index = i;
+
+        hctx->nr_requests = set->queue_depth +
+                            (set->queue_depth < BLK_MQ_MAX_SCHED_EXTRA ? set->queue_depth
+                                                                       : BLK_MQ_MAX_SCHED_EXTRA);
+        hctx->rqs = (request_t *)kzalloc(hctx->nr_requests * sizeof(request_t));
+        hctx->tag_rqs = (request_t **)kzalloc(set->queue_depth * sizeof(request_t *));
+        if (!hctx->rqs || !hctx->tag_rqs ||
+            sbitmap_init(&hctx->tags, set->queue_depth) < 0 ||
+            sbitmap_init(&hctx->sched_tags, hctx->nr_requests) < 0) {
+            blk_mq_free_queue(q);
+            return -1;
+        }
+        for (uint32_t i = 0; i < hctx->nr_requests; i++) {
+            hctx->rqs[i].internal_tag = (int)i;
+            hctx->rqs[i].tag = -1;
+            hctx->rqs[i].hctx = hctx;
+            hctx->rqs[i].q = q;
+        }
+
+        if (set->ops->init_hctx && set->ops->init_hctx(hctx, set->driver_data, i) < 0) {
+            blk_mq_free_queue(q);
+            return -1;
+        }
+        q->nr_hw_queues++;
+    }
+
+    /* Spread CPUs over the hardware queues; with one queue per CPU each gets its own */
+    blk_mq_ctx_t *ctxs = (blk_mq_ctx_t *)(((uintptr_t)q->ctxs + 63) & ~(uintptr_t)63);
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        blk_mq_ctx_t *ctx = &ctxs[cpu];
+        memset(ctx, 0, sizeof(*ctx));
+        ctx->cpu = cpu;
+        ctx->hctx = &q->hctxs[cpu % q->nr_hw_queues];
+    }
+    q->ctxs_alloc = q->ctxs;
+    q->ctxs = ctxs;
+
+    kprintf("BLOCK: %s: %u hardware queue(s) of %u tags\n",
+            q->device->name, q->nr_hw_queues, set->queue_depth);
+
+    elevator_init_default(q);
+    return 0;
+}
+
+/**
+ * Release the multi-queue state of a request queue
+ * @param q Queue
+ */
+void blk_mq_free_queue(request_queue_t *q) {
+    elevator_exit(q);
+
+    if (q->hctxs) {
+        for (uint16_t i = 0; i < q->tag_set->nr_hw_queues; i++) {
+            if (q->hctxs[i].rqs) {
+                kfree(q->hctxs[i].rqs);
+            }
+            if (q->hctxs[i].tag_rqs) {
+                kfree(q->hctxs[i].tag_rqs);
+            }
+            sbitmap_free(&q->hctxs[i].tags);
+            sbitmap_free(&q->hctxs[i].sched_tags);
+        }
+        kfree(q->hctxs);
+    }
+    if (q->ctxs_alloc) {
+        kfree(q->ctxs_alloc);
+    } else if (q->ctxs) {
+        kfree(q->ctxs);
+    }
+
+    q->hctxs = NULL;
+    q->ctxs = NULL;
+    q->ctxs_alloc = NULL;
+    q->nr_hw_queues = 0;
+    q->tag_set = NULL;
+}
+
+/**
+ * Give a request a driver tag if it does not hold one yet
+ * @return true if the request has a driver tag
+ */
+static bool blk_mq_get_driver_tag(blk_mq_hw_ctx_t *hctx, request_t *rq) {
+    if (rq->tag >= 0) {
+        return true;
+    }
+
+    int tag = sbitmap_get(&hctx->tags);
+    if (tag < 0) {
+        return false;
+    }
+    rq->tag = tag;
+    hctx->tag_rqs[tag] = rq;
+    return true;
+}
+
+/**
+ * Release a request's driver tag, if it holds one
+ */
+static void blk_mq_put_driver_tag(blk_mq_hw_ctx_t *hctx, request_t *rq) {
+    if (rq->tag < 0) {
+        return;
+    }
+    hctx->tag_rqs[rq->tag] = NULL;
+    sbitmap_clear(&hctx->tags, (uint32_t)rq->tag);
+    rq->tag = -1;
+}
+
+/**
+ * Finish a request on the submitting CPU: release its tags, then end its bios
+ */
+static void blk_mq_end_request(request_t *rq, int status) {
+    blk_mq_hw_ctx_t *hctx = rq->hctx;
+    bio_t *bio = rq->bio;
+
+    if (status < 0) {
+        kerr("BLOCK: %s: %s of %u sectors at %lu failed\n", rq->q->device->name,
+             bio_op_name(rq->op), rq->nr_sectors, rq->sector);
+    }
+
+    /* The request may be reused as soon as it is released, so detach the bios first */
+    const elevator_type_t *e = rq->q->elevator;
+    if (e && e->ops.completed && rq->elv_priv) {
+        uint64_t flags = cpu_irq_save();
+        e->ops.completed(hctx, rq);
+        cpu_irq_restore(flags);
+    }
+    blk_stat_done(rq->q, rq, status);
+    if (rq->op == BIO_OP_READ || rq->op == BIO_OP_WRITE) {
+        blk_poll_stat_add(rq->q, rq->op, rq->nr_sectors * BLOCK_SECTOR_SIZE,
+                          time_now_ns() - rq->io_start_ns);
+    }
+    rq->bio = NULL;
+    rq->biotail = NULL;
+    hctx->completed++;
+    blk_mq_put_driver_tag(hctx, rq);
+    sbitmap_clear(&hctx->sched_tags, (uint32_t)rq->internal_tag);
+
+    while (bio) {
+        bio_t *next = bio->next;
+        bio_endio(bio, status);
+        bio = next;
+    }
+}
+
+/**
+ * Complete a request; runs on the submitting CPU, so completions from
+ * another CPU are queued there until it polls
+ * @param rq Request
+ * @param status 0 on success, negative on error
+ */
+void blk_mq_complete_request(request_t *rq, int status) {
+    blk_mq_ctx_t *ctx = rq->mq_ctx;
+
+    if (ctx->cpu != cpu_current_id()) {
+        /* Steer back to the submitter */
+        rq->status = status;
+        request_t *head = __atomic_load_n(&ctx->remote_done, __ATOMIC_RELAXED);
+        do {
+            rq->next = head;
+        } while (!__atomic_compare_exchange_n(&ctx->remote_done, &head, rq, false,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        return;
+    }
+
+    blk_mq_end_request(rq, status);
+}
+
+/**
+ * Finish completions other CPUs steered to this CPU's software queue
+ */
+static void blk_mq_run_remote_done(blk_mq_ctx_t *ctx) {
+    request_t *list = __atomic_exchange_n(&ctx->remote_done, NULL, __ATOMIC_ACQUIRE);
+
+    /* The list was pushed newest first; complete in arrival order */
+    request_t *ordered = NULL;
+    while (list) {
+        request_t *next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    while (ordered) {
+        request_t *next = ordered->next;
+        ctx->completed_remote++;
+        blk_mq_end_request(ordered, ordered->status);
+        ordered = next;
+    }
+}
+
+/**
+ * Check whether a hardware queue has requests waiting for the driver
+ */
+static inline bool blk_mq_hctx_has_pending(blk_mq_hw_ctx_t *hctx) {
+    const elevator_type_t *e = hctx->queue->elevator;
+    return hctx->dispatch || hctx->ctx_map || (e && e->ops.has_work(hctx));
+}
+
+/**
+ * Take the next request from the I/O scheduler, with a driver tag already held
+ * @return The request, or NULL if the scheduler holds back or no tag is free
+ */
+static request_t *blk_mq_sched_dispatch(blk_mq_hw_ctx_t *hctx) {
+    const elevator_type_t *e = hctx->queue->elevator;
+
+    /* Reserve the tag first so the scheduler never hands out work the driver cannot take */
+    int tag = sbitmap_get(&hctx->tags);
+    if (tag < 0) {
+        return NULL;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    request_t *rq = e->ops.dispatch(hctx);
+    cpu_irq_restore(flags);
+
+    if (!rq) {
+        sbitmap_clear(&hctx->tags, (uint32_t)tag);
+        return NULL;
+    }
+    rq->tag = tag;
+    hctx->tag_rqs[tag] = rq;
+    return rq;
+}
+
+/**
+ * Hand a hardware queue's pending requests to the driver: earlier rejects
+ * first, then the scheduler's picks or, without a scheduler, each CPU's
+ * staged requests in order
+ * @param hctx Hardware queue
+ */
+static void blk_mq_run_hw_queue(blk_mq_hw_ctx_t *hctx) {
+    request_queue_t *q = hctx->queue;
+    const blk_mq_ops_t *ops = q->tag_set->ops;
+    const elevator_type_t *e = q->elevator;
+
+    uint64_t flags = cpu_irq_save();
+    request_t *list = hctx->dispatch;
+    request_t **tail = &list;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    hctx->dispatch = NULL;
+
+    uint64_t map = hctx->ctx_map;
+    hctx->ctx_map = 0;
+    while (map) {
+        blk_mq_ctx_t *ctx = &q->ctxs[__builtin_ctzll(map)];
+        map &= map - 1;
+        if (ctx->list) {
+            *tail = ctx->list;
+            tail = &ctx->tail->next;
+            ctx->list = NULL;
+            ctx->tail = NULL;
+        }
+    }
+    cpu_irq_restore(flags);
+
+    uint32_t queued = 0;
+    bool committed = true;
+    for (;;) {
+        request_t *rq;
+        if (list) {
+            rq = list;
+            list = rq->next;
+            rq->next = NULL;
+            if (!blk_mq_get_driver_tag(hctx, rq)) {
+                rq->next = list;
+                list = rq;
+                break;
+            }
+        } else if (e) {
+            rq = blk_mq_sched_dispatch(hctx);
+            if (!rq) {
+                break;
+            }
+        } else {
+            break;
+        }
+
+        bool last = !list && !(e && e->ops.has_work(hctx));
+        rq->io_start_ns = time_now_ns();
+        blk_stat_issue(q, rq);
+        int result = ops->queue_rq(hctx, rq, last);
+        if (result == BLK_MQ_RQ_BUSY) {
+            rq->next = list;
+            list = rq;
+            break;
+        }
+
+        if (result < 0) {
+            blk_mq_complete_request(rq, result);
+            continue;
+        }
+        hctx->dispatched++;
+        queued++;
+        committed = last;
+    }
+
+    /* The last request queued did not ring the doorbell */
+    if (queued && !committed && ops->commit_rqs) {
+        ops->commit_rqs(hctx);
+    }
+
+    if (list) {
+        /* The driver is full: keep the rest, in order, for the next run */
+        hctx->busy++;
+
+        flags = cpu_irq_save();
+        request_t **end = &list;
+        while (*end) {
+            end = &(*end)->next;
+        }
+        *end = hctx->dispatch;
+        hctx->dispatch = list;
+        cpu_irq_restore(flags);
+    }
+}
+
+/**
+ * Hand staged requests to the driver for every hardware queue that has some
+ * @param q Queue
+ */
+void blk_mq_run_hw_queues(request_queue_t *q) {
+    for (uint16_t i = 0; i < q->nr_hw_queues; i++) {
+        blk_mq_hw_ctx_t *hctx = &q->hctxs[i];
+        if (blk_mq_hctx_has_pending(hctx)) {
+            blk_mq_run_hw_queue(hctx);
+        }
+    }
+}
+
+/**
+ * Reap completions on every hardware queue and restart stalled dispatch
+ * @param q Queue
+ * @return Number of completions reaped by the driver
+ */
+uint32_t blk_mq_poll(request_queue_t *q) {
+    const blk_mq_ops_t *ops = q->tag_set->ops;
+    uint32_t reaped = 0;
+
+    if (ops->poll) {
+        for (uint16_t i = 0; i < q->nr_hw_queues; i++) {
+            reaped += ops->poll(&q->hctxs[i]);
+        }
+    }
+
+    blk_mq_ctx_t *ctx = &q->ctxs[cpu_current_id()];
+    if (__atomic_load_n(&ctx->remote_done, __ATOMIC_RELAXED)) {
+        blk_mq_run_remote_done(ctx);
+    }
+
+    /* Freed tags may let rejected requests through now */
+    if (reaped) {
+        blk_mq_run_hw_queues(q);
+    }
+    return reaped;
+}
+
+/**
+ * Allocate a request from the current CPU's hardware queue and stage it on
+ * the CPU's software queue, or hand it to the I/O scheduler if there is one
+ * @param q Queue
+ * @param proto Request to copy; its bios move to the allocated request
+ */
+void blk_mq_insert_request(request_queue_t *q, request_t *proto) {
+    blk_mq_ctx_t *ctx = &q->ctxs[cpu_current_id()];
+    blk_mq_hw_ctx_t *hctx = ctx->hctx;
+
+    int internal_tag;
+    while ((internal_tag = sbitmap_get(&hctx->sched_tags)) < 0) {
+        /* Every request is taken: push pending work out and reap completions */
+        blk_mq_run_hw_queue(hctx);
+        if (blk_mq_poll(q) == 0) {
+            cpu_relax();
+        }
+    }
+
+    request_t *rq = &hctx->rqs[internal_tag];
+    rq->op = proto->op;
+    rq->op_flags = proto->op_flags;
+    rq->sector = proto->sector;
+    rq->nr_sectors = proto->nr_sectors;
+    rq->nr_segments = proto->nr_segments;
+    rq->bio = proto->bio;
+    rq->biotail = proto->biotail;
+    rq->ioc = proto->ioc;
+    rq->start_ns = proto->start_ns;
+    rq->elv_priv = NULL;
+    rq->next = NULL;
+    rq->tag = -1;
+    rq->mq_ctx = ctx;
+
+    uint64_t flags = cpu_irq_save();
+    const elevator_type_t *e = q->elevator;
+    if (e && rq->op != BIO_OP_FLUSH) {
+        e->ops.insert(hctx, rq);
+    } else {
+        /* Flushes skip the scheduler: they have no sector to sort by */
+        if (ctx->tail) {
+            ctx->tail->next = rq;
+        } else {
+            ctx->list = rq;
+        }
+        ctx->tail = rq;
+        hctx->ctx_map |= 1ULL << ctx->cpu;
+    }
+    ctx->queued++;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Wait until every request of a queue has completed
+ * @param q Queue
+ */
+void blk_mq_drain_queue(request_queue_t *q) {
+    for (;;) {
+        bool busy = false;
+        for (uint16_t i = 0; i < q->nr_hw_queues; i++) {
+            if (sbitmap_weight(&q->hctxs[i].sched_tags)) {
+                busy = true;
+                break;
+            }
+        }
+        if (!busy) {
+            return;
+        }
+
+        blk_mq_run_hw_queues(q);
+        if (blk_mq_poll(q) == 0) {
+            cpu_relax();
+        }
+    }
+}
+
+/* Benchmark bookkeeping for one in-flight read */
+typedef struct blk_mq_bench_slot {
+    bio_t *bio;
+    uint64_t submit_ns;
+    bool busy;
+    uint64_t *latency;          /* Shared latency sum */
+    uint32_t *completed;        /* Shared completion count */
+    uint32_t *errors;           /* Shared error count */
+} blk_mq_bench_slot_t;
+
+static void blk_mq_bench_end_io(bio_t *bio) {
+    blk_mq_bench_slot_t *slot = (blk_mq_bench_slot_t *)bio->private_data;
+    *slot->latency += time_now_ns() - slot->submit_ns;
+    (*slot->completed)++;
+    if (bio->status < 0) {
+        (*slot->errors)++;
+    }
+    slot->busy = false;
+}
+
+/**
+ * Random read benchmark that keeps requests in flight on every hardware queue
+ *
+ * Requests bypass the per-CPU mapping and the I/O scheduler and rotate
+ * over all hardware queues, as one submitter per queue would, with one
+ * doorbell per queue per round.
+ * @param q Queue
+ * @param bench Parameters and results
+ * @return 0 on success, negative on error
+ */
+int blk_mq_bench(request_queue_t *q, block_bench_t *bench) {
+    if (!q || !q->tag_set || bench->io_size == 0 || bench->io_size % q->logical_block_size ||
+        bench->io_size > q->max_sectors * BLOCK_SECTOR_SIZE || bench->io_size > PAGE_SIZE * 16) {
+        return -1;
+    }
+
+    uint32_t sectors = bench->io_size / BLOCK_SECTOR_SIZE;
+    uint64_t span = q->device->size / bench->io_size;
+    if (span == 0) {
+        return -1;
+    }
+
+    size_t pages = ((size_t)bench->queue_depth * bench->io_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t buffer_phys;
+    uint8_t *buffer = (uint8_t *)pmm_alloc_dma(pages, &buffer_phys);
+    blk_mq_bench_slot_t *slots = (blk_mq_bench_slot_t *)kzalloc(bench->queue_depth *
+                                                                sizeof(blk_mq_bench_slot_t));
+    if (!buffer || !slots) {
+        if (buffer) {
+            pmm_free_dma(buffer, pages);
+        }
+        if (slots) {
+            kfree(slots);
+        }
+        return -1;
+    }
+
+    uint64_t latency = 0;
+    uint32_t completed = 0;
+    uint32_t submitted = 0;
+    int result = 0;
+    bench->errors = 0;
+
+    for (uint32_t i = 0; i < bench->queue_depth; i++) {
+        slots[i].bio = bio_alloc(q->device, BIO_OP_READ, 0, bench->io_size / PAGE_SIZE + 2);
+        if (!slots[i].bio) {
+            result = -1;
+            break;
+        }
+        slots[i].bio->private_data = &slots[i];
+        slots[i].bio->end_io = blk_mq_bench_end_io;
+        slots[i].latency = &latency;
+        slots[i].completed = &completed;
+        slots[i].errors = &bench->errors;
+    }
+
+    const blk_mq_ops_t *ops = q->tag_set->ops;
+    blk_mq_ctx_t *ctx = &q->ctxs[cpu_current_id()];
+    uint64_t seed = time_now_ns() | 1;
+    uint16_t next_hctx = 0;
+
+    uint64_t start = time_now_ns();
+    while (result == 0 && completed < bench->io_count) {
+        uint16_t stalled = 0;
+        for (uint32_t i = 0; i < bench->queue_depth && submitted < bench->io_count &&
+                             stalled < q->nr_hw_queues; i++) {
+            blk_mq_bench_slot_t *slot = &slots[i];
+            if (slot->busy) {
+                continue;
+            }
+
+            blk_mq_hw_ctx_t *hctx = &q->hctxs[next_hctx];
+            next_hctx = (next_hctx + 1) % q->nr_hw_queues;
+            int internal_tag = sbitmap_get(&hctx->sched_tags);
+            if (internal_tag < 0) {
+                stalled++;
+                i--;
+                continue;
+            }
+            request_t *rq = &hctx->rqs[internal_tag];
+            rq->tag = -1;
+            if (!blk_mq_get_driver_tag(hctx, rq)) {
+                sbitmap_clear(&hctx->sched_tags, (uint32_t)internal_tag);
+                stalled++;
+                i--;
+                continue;
+            }
+            stalled = 0;
+
+            /* xorshift64 */
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+
+            bio_t *bio = slot->bio;
+            bio->sector = (seed % span) * sectors;
+            bio->size = 0;
+            bio->vcnt = 0;
+            bio->flags = BIO_SUBMITTED;
+            bio->next = NULL;
+            bio_add_buffer(bio, buffer + (size_t)i * bench->io_size, bench->io_size);
+
+            rq->op = BIO_OP_READ;
+            rq->sector = bio->sector;
+            rq->nr_sectors = sectors;
+            rq->nr_segments = bio->vcnt;
+            rq->bio = bio;
+            rq->biotail = bio;
+            rq->ioc = ioc_current();
+            rq->elv_priv = NULL;
+            rq->next = NULL;
+            rq->mq_ctx = ctx;
+
+            slot->busy = true;
+            slot->submit_ns = time_now_ns();
+            int queued = ops->queue_rq(hctx, rq, false);
+            if (queued == BLK_MQ_RQ_BUSY) {
+                rq->bio = NULL;
+                blk_mq_put_driver_tag(hctx, rq);
+                sbitmap_clear(&hctx->sched_tags, (uint32_t)internal_tag);
+                slot->busy = false;
+                stalled++;
+                i--;
+                continue;
+            }
+            if (queued < 0) {
+                blk_mq_complete_request(rq, queued);
+            } else {
+                hctx->dispatched++;
+            }
+            submitted++;
+        }
+
+        /* One doorbell per hardware queue per round; idle queues ignore it */
+        if (ops->commit_rqs) {
+            for (uint16_t i = 0; i < q->nr_hw_queues; i++) {
+                ops->commit_rqs(&q->hctxs[i]);
+            }
+        }
+
+        blk_mq_poll(q);
+    }
+
+    /* Drain anything still in flight after an allocation failure */
+    for (uint32_t i = 0; i < bench->queue_depth; i++) {
+        while (slots[i].busy) {
+            blk_mq_poll(q);
+        }
+    }
+    bench->elapsed_ns = time_now_ns() - start;
+
+    for (uint32_t i = 0; i < bench->queue_depth && slots[i].bio; i++) {
+        bio_free(slots[i].bio);
+    }
+    kfree(slots);
+    pmm_free_dma(buffer, pages);
+
+    bench->iops = bench->elapsed_ns ? (uint64_t)completed * 1000000000ULL / bench->elapsed_ns : 0;
+    bench->avg_latency_ns = completed ? latency / completed : 0;
+    return result;
+}
\ No newline at end of file
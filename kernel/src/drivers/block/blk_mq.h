@@ -0,0 +1,175 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Multi-queue block layer
+ */
+
+#ifndef _DRIVERS_BLOCK_BLK_MQ_H
+#define _DRIVERS_BLOCK_BLK_MQ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/sbitmap.h>
+#include <drivers/block/block.h>
+#include <drivers/block/blk_queue.h>
+
+/* queue_rq results; negative values fail the request */
+#define BLK_MQ_RQ_QUEUED        0   /* Accepted by the hardware queue */
+#define BLK_MQ_RQ_BUSY          1   /* No room right now, retry later */
+
+/* Tag set flags */
+#define BLK_MQ_F_NO_SCHED_BY_DEFAULT (1U << 0) /* Start without an I/O scheduler */
+#define BLK_MQ_F_IRQ_COMPLETION      (1U << 1) /* Completions raise interrupts, so waiters may sleep */
+#define BLK_MQ_F_WRITE_CACHE         (1U << 2) /* Volatile write cache: takes BIO_OP_FLUSH requests */
+#define BLK_MQ_F_FUA                 (1U << 3) /* Honours BIO_REQ_FUA on writes */
+
+/* Requests allocated beyond the driver's depth, so a scheduler has some to order */
+#define BLK_MQ_MAX_SCHED_EXTRA  128
+
+struct blk_mq_hw_ctx;
+
+/* Driver hooks for a multi-queue device */
+typedef struct blk_mq_ops {
+    /* Queue a request; ring the doorbell only when last is set */
+    int (*queue_rq)(struct blk_mq_hw_ctx *hctx, request_t *rq, bool last);
+    /* Ring the doorbell for requests queued without last (optional) */
+    void (*commit_rqs)(struct blk_mq_hw_ctx *hctx);
+    /* Reap completions without waiting for an interrupt (optional) */
+    uint32_t (*poll)(struct blk_mq_hw_ctx *hctx);
+    /* Bind a hardware context to driver state (optional) */
+    int (*init_hctx)(struct blk_mq_hw_ctx *hctx, void *driver_data, uint16_t index);
+} blk_mq_ops_t;
+
+/*
+ * Description of a multi-queue device, filled in by the driver and hung
+ * off block_device_t.tag_set before the device is registered
+ */
+typedef struct blk_mq_tag_set {
+    const blk_mq_ops_t *ops;    /* Driver hooks */
+    uint16_t nr_hw_queues;      /* Hardware submission queues */
+    uint16_t queue_depth;       /* Tags (in-flight requests) per hardware queue */
+    uint32_t max_sectors;       /* Largest request, 0 for the default */
+    uint16_t max_segments;      /* Most segments per request, 0 for the default */
+    uint32_t logical_block_size;/* Addressing granularity, 0 for 512 bytes */
+    bool     virt_boundary;     /* Segments may not leave gaps inside a page */
+    uint32_t max_discard_sectors;       /* Largest discard, 0 if unsupported */
+    uint32_t max_write_zeroes_sectors;  /* Largest write zeroes, 0 if unsupported */
+    uint32_t discard_granularity;       /* Bytes unmapped at a time, 0 for the block size */
+    uint32_t flags;             /* BLK_MQ_F_* */
+    void    *driver_data;       /* Passed to init_hctx */
+} blk_mq_tag_set_t;
+
+/* Hardware dispatch queue */
+typedef struct blk_mq_hw_ctx {
+    request_queue_t *queue;     /* Owning queue */
+    uint16_t index;             /* Hardware queue number */
+    void    *driver_data;       /* Set by init_hctx */
+
+    sbitmap_t tags;             /* Driver tags: requests the driver owns */
+    request_t **tag_rqs;        /* Request holding each driver tag */
+    sbitmap_t sched_tags;       /* Internal tags: requests staged, scheduled or in flight */
+    request_t *rqs;             /* Request pool, indexed by internal tag */
+    uint32_t nr_requests;       /* Size of the pool */
+    request_t *dispatch;        /* Requests the driver turned away, oldest first */
+    uint64_t ctx_map;           /* Software queues with staged requests, bit per CPU */
+    void    *sched_data;        /* I/O scheduler state */
+
+    /* Statistics */
+    uint64_t dispatched;        /* Requests accepted by the driver */
+    uint64_t completed;         /* Requests completed */
+    uint64_t busy;              /* Times the driver reported a full queue */
+} blk_mq_hw_ctx_t;
+
+/* Per-CPU software staging queue */
+typedef struct blk_mq_ctx {
+    uint32_t cpu;               /* Owning CPU */
+    blk_mq_hw_ctx_t *hctx;      /* Hardware queue this CPU feeds */
+    request_t *list;            /* Staged requests, oldest first */
+    request_t *tail;            /* Last staged request */
+    request_t *remote_done;     /* Completions steered here from other CPUs */
+
+    /* Statistics */
+    uint64_t queued;            /* Requests staged */
+    uint64_t completed_remote;  /* Completions that arrived on another CPU */
+} __attribute__((aligned(64))) blk_mq_ctx_t;
+
+/**
+ * Set up the software and hardware queues of a request queue
+ * @param q Queue
+ * @param set Tag set describing the device
+ * @return 0 on success, negative on error
+ */
+int blk_mq_init_queue(request_queue_t *q, blk_mq_tag_set_t *set);
+
+/**
+ * Release the multi-queue state of a request queue
+ * @param q Queue
+ */
+void blk_mq_free_queue(request_queue_t *q);
+
+/**
+ * Allocate a request from the current CPU's hardware queue and stage it on
+ * the CPU's software queue, or hand it to the I/O scheduler if there is one
+ * @param q Queue
+ * @param proto Request to copy; its bios move to the allocated request
+ */
+void blk_mq_insert_request(request_queue_t *q, request_t *proto);
+
+/**
+ * Hand staged requests to the driver for every hardware queue that has some
+ * @param q Queue
+ */
+void blk_mq_run_hw_queues(request_queue_t *q);
+
+/**
+ * Complete a request; runs on the submitting CPU, so completions from
+ * another CPU are queued there until it polls
+ * @param rq Request
+ * @param status 0 on success, negative on error
+ */
+void blk_mq_complete_request(request_t *rq, int status);
+
+/**
+ * Reap completions on every hardware queue and restart stalled dispatch
+ * @param q Queue
+ * @return Number of completions reaped by the driver
+ */
+uint32_t blk_mq_poll(request_queue_t *q);
+
+/**
+ * Wait until every request of a queue has completed
+ * @param q Queue
+ */
+void blk_mq_drain_queue(request_queue_t *q);
+
+/**
+ * Look up the request that owns a driver tag
+ */
+static inline request_t *blk_mq_tag_to_rq(blk_mq_hw_ctx_t *hctx, uint32_t tag) {
+    return hctx->tag_rqs[tag];
+}
+
+/**
+ * Random read benchmark that keeps requests in flight on every hardware queue
+ * @param q Queue
+ * @param bench Parameters and results
+ * @return 0 on success, negative on error
+ */
+int blk_mq_bench(request_queue_t *q, block_bench_t *bench);
+
+#endif /* _DRIVERS_BLOCK_BLK_MQ_H */
\ No newline at end of file
@@ -0,0 +1,811 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Block request queues and submission plugging
+ *
+ * Bios are turned into requests here. Unplugged submissions are dispatched
+ * immediately; plugged ones are merged with neighbouring bios while the
+ * plug is held, then sorted and dispatched as large requests. Drivers with
+ * a tag set get their requests through blk-mq; drivers that only provide
+ * the synchronous read/write operations are driven through a compatibility
+ * path that issues each request as a single transfer.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_mq.h>
+#include <mm/kmalloc.h>
+
+/* Steps of a bio's cache flush sequence */
+#define BLK_FLUSH_PRE       (1U << 0)   /* Flush before the data */
+#define BLK_FLUSH_DATA      (1U << 1)   /* Write the data */
+#define BLK_FLUSH_POST      (1U << 2)   /* Flush after the data, standing in for FUA */
+
+/*
+ * A bio working through its flush sequence. The bio's own completion is
+ * borrowed for the data step and handed back when the sequence ends.
+ */
+typedef struct blk_flush_seq {
+    bio_t   *bio;               /* Bio being sequenced */
+    void   (*end_io)(bio_t *bio); /* Owner's completion, restored at the end */
+    void    *private_data;
+    uint32_t steps;             /* BLK_FLUSH_* still to do */
+    int      status;            /* First failure */
+    struct blk_flush_seq *next; /* Next sequence waiting on the same flush */
+} blk_flush_seq_t;
+
+/* Active plug of each submitting context */
+static blk_plug_t *blk_plugs[MAX_CPUS];
+
+/* I/O context of each submitting context; the kernel's when unset */
+static io_context_t *blk_iocs[MAX_CPUS];
+static io_context_t kernel_ioc = { .id = 0, .weight = IOC_DEFAULT_WEIGHT };
+
+/**
+ * Create the request queue for a block device
+ * @param device Block device
+ * @return The queue, or NULL on failure
+ */
+request_queue_t *blk_queue_create(block_device_t *device) {
+    request_queue_t *q = (request_queue_t *)kzalloc(sizeof(request_queue_t));
+    if (!q) {
+        return NULL;
+    }
+
+    q->device = device;
+    q->max_sectors = BLK_DEFAULT_MAX_SECTORS;
+    q->max_segments = BLK_DEFAULT_MAX_SEGMENTS;
+    q->logical_block_size = BLOCK_SECTOR_SIZE;
+    q->io_poll_delay = BLK_POLL_CLASSIC;
+    q->iostat.since_ns = q->iostat.stamp_ns = time_now_ns();
+
+    if (device->tag_set && blk_mq_init_queue(q, device->tag_set) < 0) {
+        kfree(q);
+        return NULL;
+    }
+    return q;
+}
+
+/**
+ * Destroy a request queue
+ * @param q Queue
+ */
+void blk_queue_destroy(request_queue_t *q) {
+    if (!q) {
+        return;
+    }
+    if (q->tag_set) {
+        blk_mq_free_queue(q);
+    }
+    blk_trace_stop(q->device);
+    kfree(q);
+}
+
+/**
+ * Start a request from a single bio
+ */
+static void blk_rq_init(request_t *rq, request_queue_t *q, bio_t *bio) {
+    rq->q = q;
+    rq->op = bio->op;
+    rq->op_flags = bio->op_flags;
+    rq->sector = bio->sector;
+    rq->nr_sectors = bio_sectors(bio);
+    rq->nr_segments = bio->vcnt;
+    rq->bio = bio;
+    rq->biotail = bio;
+    rq->next = NULL;
+    rq->tag = -1;
+    rq->hctx = NULL;
+    rq->mq_ctx = NULL;
+    rq->ioc = bio->ioc;
+    rq->start_ns = time_now_ns();
+    rq->io_start_ns = 0;
+}
+
+/**
+ * Check whether a request has room for more sectors and segments
+ */
+static inline bool blk_rq_fits(request_queue_t *q, request_t *rq, uint32_t op, uint32_t op_flags,
+                               uint32_t sectors, uint32_t segments) {
+    return rq->op == op && rq->op_flags == op_flags && op != BIO_OP_FLUSH &&
+           rq->nr_sectors + sectors <= blk_queue_max_sectors(q, op) &&
+           rq->nr_segments + segments <= q->max_segments;
+}
+
+/**
+ * Check whether joining two bios would leave a gap the device cannot map
+ */
+static inline bool blk_bio_gap(request_queue_t *q, bio_t *prev, bio_t *next) {
+    if (!q->virt_boundary || prev->vcnt == 0 || next->vcnt == 0) {
+        return false;
+    }
+
+    bio_vec_t *last = &prev->vecs[prev->vcnt - 1];
+    return ((last->offset + last->len) & (PAGE_SIZE - 1)) != 0 || next->vecs[0].offset != 0;
+}
+
+/**
+ * Try to merge a bio into a plugged request
+ * @return true if the bio was merged
+ */
+static bool blk_plug_merge(blk_plug_t *plug, request_queue_t *q, bio_t *bio) {
+    for (request_t *rq = plug->list; rq; rq = rq->next) {
+        if (rq->q != q || !blk_rq_fits(q, rq, bio->op, bio->op_flags, bio_sectors(bio), bio->vcnt)) {
+            continue;
+        }
+
+        if (rq->sector + rq->nr_sectors == bio->sector && !blk_bio_gap(q, rq->biotail, bio)) {
+            rq->biotail->next = bio;
+            rq->biotail = bio;
+            rq->nr_sectors += bio_sectors(bio);
+            rq->nr_segments += bio->vcnt;
+            q->back_merges++;
+            blk_stat_merge(q, bio->op, bio->sector, bio_sectors(bio));
+            return true;
+        }
+
+        if (bio_end_sector(bio) == rq->sector && !blk_bio_gap(q, bio, rq->bio)) {
+            bio->next = rq->bio;
+            rq->bio = bio;
+            rq->sector = bio->sector;
+            rq->nr_sectors += bio_sectors(bio);
+            rq->nr_segments += bio->vcnt;
+            q->front_merges++;
+            blk_stat_merge(q, bio->op, bio->sector, bio_sectors(bio));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Count the virtually contiguous runs a request's segments form
+ */
+static uint32_t blk_rq_runs(request_t *rq) {
+    uint32_t runs = 0;
+    uint8_t *expected = NULL;
+
+    for (bio_t *bio = rq->bio; bio; bio = bio->next) {
+        for (uint16_t i = 0; i < bio->vcnt; i++) {
+            uint8_t *addr = (uint8_t *)bio_vec_addr(&bio->vecs[i]);
+            if (addr != expected) {
+                runs++;
+            }
+            expected = addr + bio->vecs[i].len;
+        }
+    }
+
+    return runs;
+}
+
+/**
+ * Issue one byte range through the driver's synchronous operations
+ */
+static int blk_compat_rw(block_device_t *device, uint32_t op, uint64_t offset,
+                         size_t size, void *buffer) {
+    if (op == BIO_OP_READ) {
+        return device->ops->read ? device->ops->read(device, offset, size, buffer) : -1;
+    }
+    return device->ops->write ? device->ops->write(device, offset, size, buffer) : -1;
+}
+
+/**
+ * Copy between a request's segments and a linear buffer
+ * @param rq Request
+ * @param buffer Linear buffer covering the whole request
+ * @param to_buffer true to gather segments into the buffer, false to scatter
+ */
+static void blk_rq_copy(request_t *rq, uint8_t *buffer, bool to_buffer) {
+    for (bio_t *bio = rq->bio; bio; bio = bio->next) {
+        for (uint16_t i = 0; i < bio->vcnt; i++) {
+            bio_vec_t *vec = &bio->vecs[i];
+            if (to_buffer) {
+                memcpy(buffer, bio_vec_addr(vec), vec->len);
+            } else {
+                memcpy(bio_vec_addr(vec), buffer, vec->len);
+            }
+            buffer += vec->len;
+        }
+    }
+}
+
+/**
+ * Execute a request on a driver that only has read/write operations
+ *
+ * A request whose segments are contiguous in memory is passed straight
+ * through. Otherwise the segments are gathered into a bounce buffer so
+ * the device still sees one transfer; if that cannot be allocated, each
+ * contiguous run is issued on its own.
+ */
+static int blk_compat_execute(request_t *rq) {
+    block_device_t *device = rq->q->device;
+    uint64_t offset = rq->sector * BLOCK_SECTOR_SIZE;
+    size_t size = (size_t)rq->nr_sectors * BLOCK_SECTOR_SIZE;
+
+    /* Synchronous drivers have finished writing by the time they return */
+    if (rq->op == BIO_OP_FLUSH) {
+        return 0;
+    }
+    if (bio_op_dataless(rq->op)) {
+        return -1;
+    }
+
+    if (blk_rq_runs(rq) == 1) {
+        return blk_compat_rw(device, rq->op, offset, size, bio_vec_addr(&rq->bio->vecs[0]));
+    }
+
+    uint8_t *bounce = size <= BLK_BOUNCE_MAX ? (uint8_t *)kmalloc(size) : NULL;
+    if (bounce) {
+        if (rq->op == BIO_OP_WRITE) {
+            blk_rq_copy(rq, bounce, true);
+        }
+        int result = blk_compat_rw(device, rq->op, offset, size, bounce);
+        if (result == 0 && rq->op == BIO_OP_READ) {
+            blk_rq_copy(rq, bounce, false);
+        }
+        kfree(bounce);
+        return result;
+    }
+
+    uint8_t *run = NULL;
+    size_t run_len = 0;
+    for (bio_t *bio = rq->bio; bio; bio = bio->next) {
+        for (uint16_t i = 0; i < bio->vcnt; i++) {
+            uint8_t *addr = (uint8_t *)bio_vec_addr(&bio->vecs[i]);
+            if (run && run + run_len == addr) {
+                run_len += bio->vecs[i].len;
+                continue;
+            }
+            if (run) {
+                if (blk_compat_rw(device, rq->op, offset, run_len, run) < 0) {
+                    return -1;
+                }
+                offset += run_len;
+            }
+            run = addr;
+            run_len = bio->vecs[i].len;
+        }
+    }
+
+    return blk_compat_rw(device, rq->op, offset, run_len, run);
+}
+
+/**
+ * Send a request to the device and complete its bios
+ */
+static void blk_queue_dispatch(request_t *rq) {
+    request_queue_t *q = rq->q;
+    q->requests++;
+    blk_stat_start(q, rq);
+
+    if (q->tag_set) {
+        blk_mq_insert_request(q, rq);
+        return;
+    }
+
+    rq->io_start_ns = time_now_ns();
+    blk_stat_issue(q, rq);
+    int status = blk_compat_execute(rq);
+    blk_stat_done(q, rq, status);
+    if (status < 0) {
+        kerr("BLOCK: %s: %s of %u sectors at %lu failed\n", q->device->name,
+             bio_op_name(rq->op), rq->nr_sectors, rq->sector);
+    }
+
+    /* end_io may free the bio, so step past it first */
+    bio_t *bio = rq->bio;
+    while (bio) {
+        bio_t *next = bio->next;
+        bio_endio(bio, status);
+        bio = next;
+    }
+}
+
+/**
+ * Send a bio to the device on its own, bypassing the plug
+ */
+static void blk_queue_issue(request_queue_t *q, bio_t *bio) {
+    request_t rq;
+    blk_rq_init(&rq, q, bio);
+    blk_queue_dispatch(&rq);
+    if (q->tag_set) {
+        blk_mq_run_hw_queues(q);
+    }
+}
+
+static void blk_flush_seq_step(request_queue_t *q, blk_flush_seq_t *seq);
+static void blk_flush_kick(request_queue_t *q);
+
+/**
+ * Finish the flush in flight: every sequence it covered moves on
+ */
+static void blk_flush_done(request_queue_t *q, int status) {
+    uint64_t flags = cpu_irq_save();
+    blk_flush_seq_t *list = q->flush_running;
+    q->flush_running = NULL;
+    q->flush_in_flight = false;
+    cpu_irq_restore(flags);
+
+    while (list) {
+        blk_flush_seq_t *next = list->next;
+        if (status < 0 && list->status == 0) {
+            list->status = status;
+        }
+        blk_flush_seq_step(q, list);
+        list = next;
+    }
+
+    blk_flush_kick(q);
+}
+
+/**
+ * Completion of a cache flush the block layer sent
+ */
+static void blk_flush_end_io(bio_t *bio) {
+    request_queue_t *q = (request_queue_t *)bio->private_data;
+    int status = bio->status;
+    bio_free(bio);
+    blk_flush_done(q, status);
+}
+
+/**
+ * Send one flush on behalf of every sequence waiting for one
+ *
+ * Sequences that arrive while a flush is in flight wait for the next one:
+ * the running flush may not cover writes that finished after it was sent.
+ */
+static void blk_flush_kick(request_queue_t *q) {
+    uint64_t flags = cpu_irq_save();
+    if (q->flush_in_flight || !q->flush_pending) {
+        cpu_irq_restore(flags);
+        return;
+    }
+    q->flush_running = q->flush_pending;
+    q->flush_pending = NULL;
+    q->flush_in_flight = true;
+    cpu_irq_restore(flags);
+
+    bio_t *bio = bio_alloc(q->device, BIO_OP_FLUSH, 0, 0);
+    if (!bio) {
+        blk_flush_done(q, -1);
+        return;
+    }
+
+    q->flushes++;
+    bio->end_io = blk_flush_end_io;
+    bio->private_data = q;
+    bio->ioc = ioc_current();
+    bio->flags |= BIO_SUBMITTED;
+    blk_queue_issue(q, bio);
+}
+
+/**
+ * Wait for the next cache flush
+ */
+static void blk_flush_enqueue(request_queue_t *q, blk_flush_seq_t *seq) {
+    uint64_t flags = cpu_irq_save();
+    if (q->flush_pending) {
+        q->flushes_shared++;
+    }
+    seq->next = q->flush_pending;
+    q->flush_pending = seq;
+    cpu_irq_restore(flags);
+
+    blk_flush_kick(q);
+}
+
+/**
+ * Completion of the data step: the bio is not done until its sequence is
+ */
+static void blk_flush_data_end_io(bio_t *bio) {
+    blk_flush_seq_t *seq = (blk_flush_seq_t *)bio->private_data;
+
+    bio->flags &= ~BIO_DONE;
+    if (bio->status < 0 && seq->status == 0) {
+        seq->status = bio->status;
+    }
+    blk_flush_seq_step(bio->device->queue, seq);
+}
+
+/**
+ * Run the next step of a flush sequence, or end the bio once none are left
+ */
+static void blk_flush_seq_step(request_queue_t *q, blk_flush_seq_t *seq) {
+    bio_t *bio = seq->bio;
+
+    if (seq->status == 0) {
+        if (seq->steps & BLK_FLUSH_PRE) {
+            seq->steps &= ~BLK_FLUSH_PRE;
+            blk_flush_enqueue(q, seq);
+            return;
+        }
+
+        if (seq->steps & BLK_FLUSH_DATA) {
+            seq->steps &= ~BLK_FLUSH_DATA;
+            bio->op_flags &= ~BIO_REQ_PREFLUSH;
+            if (!q->fua) {
+                bio->op_flags &= ~BIO_REQ_FUA;
+            }
+            bio->end_io = blk_flush_data_end_io;
+            bio->private_data = seq;
+            blk_queue_issue(q, bio);
+            return;
+        }
+
+        if (seq->steps & BLK_FLUSH_POST) {
+            seq->steps &= ~BLK_FLUSH_POST;
+            q->fua_emulated++;
+            blk_flush_enqueue(q, seq);
+            return;
+        }
+    }
+
+    int status = seq->status;
+    bio->end_io = seq->end_io;
+    bio->private_data = seq->private_data;
+    kfree(seq);
+    bio_endio(bio, status);
+}
+
+/**
+ * Take over a bio whose FLUSH, PREFLUSH or FUA semantics the device cannot
+ * provide by itself, and run it as a sequence of flushes and a plain write
+ * @return true if the bio was taken, false if it can be queued as it is
+ */
+static bool blk_flush_queue_bio(request_queue_t *q, bio_t *bio) {
+    if (bio->op == BIO_OP_READ || !q->write_cache) {
+        /* Nothing volatile to flush: writes are stable once they complete */
+        bio->op_flags &= ~(BIO_REQ_PREFLUSH | BIO_REQ_FUA);
+        if (bio->op == BIO_OP_FLUSH) {
+            bio_endio(bio, 0);
+            return true;
+        }
+        return false;
+    }
+
+    uint32_t steps = 0;
+    if (bio->op == BIO_OP_FLUSH || (bio->op_flags & BIO_REQ_PREFLUSH)) {
+        steps |= BLK_FLUSH_PRE;
+    }
+    if (bio->op != BIO_OP_FLUSH) {
+        steps |= BLK_FLUSH_DATA;
+    }
+    if ((bio->op_flags & BIO_REQ_FUA) && !q->fua) {
+        steps |= BLK_FLUSH_POST;
+    }
+    if (steps == BLK_FLUSH_DATA) {
+        /* A plain write, or FUA the device handles itself */
+        return false;
+    }
+
+    blk_flush_seq_t *seq = (blk_flush_seq_t *)kmalloc(sizeof(blk_flush_seq_t));
+    if (!seq) {
+        bio_endio(bio, -1);
+        return true;
+    }
+
+    seq->bio = bio;
+    seq->end_io = bio->end_io;
+    seq->private_data = bio->private_data;
+    seq->steps = steps;
+    seq->status = 0;
+    seq->next = NULL;
+    blk_flush_seq_step(q, seq);
+    return true;
+}
+
+/**
+ * Queue a bio, merging it into a plugged request where possible
+ * @param q Queue of the bio's device
+ * @param bio Validated bio
+ */
+void blk_queue_submit_bio(request_queue_t *q, bio_t *bio) {
+    blk_plug_t *plug = blk_plugs[cpu_current_id()];
+    q->bios++;
+
+    if (q->trace) {
+        blk_trace_add(q, BLK_TA_QUEUE, bio->op, bio->sector, bio_sectors(bio), 0);
+    }
+
+    /* Stacking drivers remap the bio, flush semantics included, themselves */
+    if (q->device->ops->submit_bio) {
+        q->device->ops->submit_bio(q->device, bio);
+        return;
+    }
+
+    if ((bio->op == BIO_OP_FLUSH || bio->op_flags) && blk_flush_queue_bio(q, bio)) {
+        return;
+    }
+
+    if (plug) {
+        if (blk_plug_merge(plug, q, bio)) {
+            return;
+        }
+
+        request_t *rq = (request_t *)kmalloc(sizeof(request_t));
+        if (rq) {
+            blk_rq_init(rq, q, bio);
+            rq->next = plug->list;
+            plug->list = rq;
+            if (++plug->count >= BLK_PLUG_MAX_REQUESTS) {
+                blk_flush_plug();
+            }
+            return;
+        }
+
+        /* Out of memory: keep ordering by flushing, then go direct */
+        blk_flush_plug();
+    }
+
+    blk_queue_issue(q, bio);
+}
+
+/**
+ * Reap completions for a queue whose driver can be polled
+ * @param q Queue
+ * @return Number of completions reaped
+ */
+uint32_t blk_queue_poll(request_queue_t *q) {
+    if (!q) {
+        return 0;
+    }
+    if (q->tag_set) {
+        return blk_mq_poll(q);
+    }
+    return q->device->ops->poll ? q->device->ops->poll(q->device) : 0;
+}
+
+/**
+ * Check whether a queue's device signals completions with interrupts
+ * @param q Queue
+ * @return true if waiters may sleep until the device interrupts
+ */
+bool blk_queue_irq_driven(request_queue_t *q) {
+    return q->tag_set && (q->tag_set->flags & BLK_MQ_F_IRQ_COMPLETION);
+}
+
+/**
+ * Get the latency bucket of a request: direction, then log2 of its size in pages
+ */
+static inline blk_poll_stat_t *blk_poll_stat_get(request_queue_t *q, uint32_t op, uint32_t bytes) {
+    uint32_t size = 0;
+    for (uint32_t pages = bytes / (2 * PAGE_SIZE); pages && size < BLK_POLL_STAT_SIZES - 1; pages >>= 1) {
+        size++;
+    }
+    return &q->poll_stat[(op == BIO_OP_READ ? 0 : BLK_POLL_STAT_SIZES) + size];
+}
+
+/**
+ * Record the latency of a finished request for hybrid polling
+ * @param q Queue
+ * @param op BIO_OP_*
+ * @param bytes Request size
+ * @param ns Time from dispatch to completion
+ */
+void blk_poll_stat_add(request_queue_t *q, uint32_t op, uint32_t bytes, uint64_t ns) {
+    blk_poll_stat_t *stat = blk_poll_stat_get(q, op, bytes);
+
+    if (stat->samples++ == 0) {
+        stat->mean_ns = ns;
+    } else {
+        stat->mean_ns = stat->mean_ns - stat->mean_ns / 8 + ns / 8;
+    }
+}
+
+/**
+ * Work out how long to sleep before polling for an I/O
+ * @return Nanoseconds to sleep, 0 to poll right away
+ */
+static uint64_t blk_poll_sleep_ns(request_queue_t *q, uint32_t op, uint32_t bytes) {
+    if (q->io_poll_delay > 0) {
+        return (uint64_t)q->io_poll_delay * 1000;
+    }
+    if (q->io_poll_delay == BLK_POLL_CLASSIC) {
+        return 0;
+    }
+
+    /*
+     * Hybrid: the first half of the typical latency is almost never enough
+     * to finish, so spend it asleep and only spin for the second half. An
+     * unusually fast completion costs at most the sleep, and a device that
+     * interrupts ends the sleep early anyway.
+     */
+    blk_poll_stat_t *stat = blk_poll_stat_get(q, op, bytes);
+    if (stat->samples < BLK_POLL_STAT_MIN_SAMPLES) {
+        return 0;
+    }
+    return stat->mean_ns / 2;
+}
+
+/**
+ * Wait for I/O on a queue to finish
+ * @param q Queue the I/O was submitted to
+ * @param op BIO_OP_* of the I/O, for the latency estimate
+ * @param bytes Size of the I/O, for the latency estimate
+ * @param done Returns true once the I/O has finished
+ * @param arg Argument for done
+ */
+void blk_wait_io(request_queue_t *q, uint32_t op, uint32_t bytes,
+                 bool (*done)(void *arg), void *arg) {
+    if (done(arg)) {
+        return;
+    }
+
+    if (blk_queue_irq_driven(q) && !q->io_poll) {
+        uint64_t flags = cpu_irq_save();
+        while (!done(arg)) {
+            /* Tags freed by earlier completions may let staged requests through */
+            blk_mq_run_hw_queues(q);
+            if (done(arg)) {
+                break;
+            }
+            q->irq_sleeps++;
+            cpu_wait_irq();
+            cpu_irq_save();
+        }
+        cpu_irq_restore(flags);
+        return;
+    }
+
+    uint64_t sleep_ns = blk_poll_sleep_ns(q, op, bytes);
+    if (sleep_ns) {
+        uint64_t flags = cpu_irq_save();
+        q->poll_sleeps++;
+        time_sleep_ns(sleep_ns);
+        cpu_irq_restore(flags);
+    }
+
+    while (!done(arg)) {
+        q->polls++;
+        if (blk_queue_poll(q)) {
+            q->poll_hits++;
+        } else {
+            cpu_relax();
+        }
+    }
+}
+
+/**
+ * Start batching submissions from the current context
+ * @param plug Plug, normally on the caller's stack
+ */
+void blk_start_plug(blk_plug_t *plug) {
+    plug->list = NULL;
+    plug->count = 0;
+
+    /* Nested plugs are folded into the outermost one */
+    uint32_t cpu = cpu_current_id();
+    if (!blk_plugs[cpu]) {
+        blk_plugs[cpu] = plug;
+    }
+}
+
+/**
+ * Dispatch the current context's plugged requests without ending the plug
+ */
+void blk_flush_plug(void) {
+    blk_plug_t *plug = blk_plugs[cpu_current_id()];
+    if (!plug || !plug->list) {
+        return;
+    }
+
+    request_t *list = plug->list;
+    plug->list = NULL;
+    plug->count = 0;
+
+    /* Sort by queue, then sector, so each device sees ascending requests */
+    request_t *sorted = NULL;
+    while (list) {
+        request_t *rq = list;
+        list = list->next;
+
+        request_t **link = &sorted;
+        while (*link && ((uintptr_t)(*link)->q < (uintptr_t)rq->q ||
+                         ((*link)->q == rq->q && (*link)->sector < rq->sector))) {
+            link = &(*link)->next;
+        }
+        rq->next = *link;
+        *link = rq;
+    }
+
+    /* Bios that arrived out of order may now sit in adjacent requests */
+    for (request_t *rq = sorted; rq && rq->next; ) {
+        request_t *next = rq->next;
+        if (next->q == rq->q && rq->sector + rq->nr_sectors == next->sector &&
+            blk_rq_fits(rq->q, rq, next->op, next->op_flags, next->nr_sectors, next->nr_segments) &&
+            !blk_bio_gap(rq->q, rq->biotail, next->bio)) {
+            rq->biotail->next = next->bio;
+            rq->biotail = next->biotail;
+            rq->nr_sectors += next->nr_sectors;
+            rq->nr_segments += next->nr_segments;
+            rq->next = next->next;
+            rq->q->request_merges++;
+            blk_stat_merge(rq->q, next->op, next->sector, next->nr_sectors);
+            kfree(next);
+        } else {
+            rq = next;
+        }
+    }
+
+    /* Stage each queue's requests, then kick its hardware queues once */
+    while (sorted) {
+        request_t *rq = sorted;
+        request_queue_t *q = rq->q;
+        sorted = sorted->next;
+        blk_queue_dispatch(rq);
+        kfree(rq);
+
+        if (q->tag_set && (!sorted || sorted->q != q)) {
+            blk_mq_run_hw_queues(q);
+        }
+    }
+}
+
+/**
+ * Dispatch everything batched since blk_start_plug
+ * @param plug Plug passed to blk_start_plug
+ */
+void blk_finish_plug(blk_plug_t *plug) {
+    uint32_t cpu = cpu_current_id();
+    if (blk_plugs[cpu] != plug) {
+        return;
+    }
+
+    blk_flush_plug();
+    blk_plugs[cpu] = NULL;
+}
+
+/**
+ * Make an I/O context current for the bios this CPU submits
+ * @param ioc Context, or NULL for the kernel's
+ */
+void ioc_set_current(io_context_t *ioc) {
+    blk_iocs[cpu_current_id()] = ioc;
+}
+
+/**
+ * Get the I/O context of the current submitter
+ * @return Current context, never NULL
+ */
+io_context_t *ioc_current(void) {
+    io_context_t *ioc = blk_iocs[cpu_current_id()];
+    return ioc ? ioc : &kernel_ioc;
+}
+
+/**
+ * Set the I/O weight of a context
+ * @param ioc Context
+ * @param weight Weight between IOC_MIN_WEIGHT and IOC_MAX_WEIGHT
+ * @return 0 on success, negative if the weight is out of range
+ */
+int ioc_set_weight(io_context_t *ioc, uint16_t weight) {
+    if (!ioc || weight < IOC_MIN_WEIGHT || weight > IOC_MAX_WEIGHT) {
+        return -1;
+    }
+    ioc->weight = weight;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,283 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Block request queues and submission plugging
+ */
+
+#ifndef _DRIVERS_BLOCK_BLK_QUEUE_H
+#define _DRIVERS_BLOCK_BLK_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_stat.h>
+
+/* Default request limits; drivers may lower or raise them after registering */
+#define BLK_DEFAULT_MAX_SECTORS     256     /* 128 KiB */
+#define BLK_DEFAULT_MAX_SEGMENTS    128
+
+/* Largest discard or write-zeroes bio: its byte size must fit bio_t.size */
+#define BLK_MAX_DATALESS_SECTORS    ((UINT32_MAX / BLOCK_SECTOR_SIZE) & ~7U)
+
+/* Largest request the compatibility path gathers through a bounce buffer */
+#define BLK_BOUNCE_MAX              (BLK_DEFAULT_MAX_SECTORS * BLOCK_SECTOR_SIZE)
+
+struct request_queue;
+struct blk_mq_hw_ctx;
+struct blk_mq_ctx;
+struct blk_mq_tag_set;
+struct elevator_type;
+struct blk_flush_seq;
+
+/* Completion polling modes (request_queue_t.io_poll_delay); positive values
+ * sleep that many microseconds before polling */
+#define BLK_POLL_CLASSIC            (-1)    /* Spin from the start */
+#define BLK_POLL_HYBRID             0       /* Sleep half the observed latency, then spin */
+
+/* Latency statistics: per direction, per power-of-two size from 4 KiB up */
+#define BLK_POLL_STAT_SIZES         8
+#define BLK_POLL_STAT_BUCKETS       (2 * BLK_POLL_STAT_SIZES)
+
+/* Samples a bucket needs before hybrid polling trusts its mean */
+#define BLK_POLL_STAT_MIN_SAMPLES   8
+
+/* Moving average of completion latency for one kind of request */
+typedef struct blk_poll_stat {
+    uint64_t mean_ns;           /* Weighted mean, the newest sample counting 1/8 */
+    uint64_t samples;           /* Samples taken */
+} blk_poll_stat_t;
+
+/* I/O weights for schedulers that share disk time */
+#define IOC_DEFAULT_WEIGHT          100
+#define IOC_MIN_WEIGHT              1
+#define IOC_MAX_WEIGHT              1000
+
+/*
+ * Identity of an I/O submitter, used by schedulers to share the disk
+ * between submitters. Like plugs, the current context is tracked per CPU
+ * until tasks exist to carry it.
+ */
+typedef struct io_context {
+    uint32_t id;                /* Submitter ID, 0 for the kernel */
+    uint16_t weight;            /* Share relative to other contexts */
+} io_context_t;
+
+/* A device request: one or more bios covering a contiguous sector range */
+typedef struct request {
+    struct request_queue *q;    /* Owning queue */
+    uint32_t op;                /* BIO_OP_* */
+    uint32_t op_flags;          /* BIO_REQ_* shared by all its bios */
+    uint64_t sector;            /* First sector */
+    uint32_t nr_sectors;        /* Sectors covered */
+    uint16_t nr_segments;       /* Segments across all bios */
+    bio_t *bio;                 /* First bio */
+    bio_t *biotail;             /* Last bio */
+    struct request *next;       /* Next request in a plug or staging list */
+
+    /* Multi-queue state */
+    int tag;                    /* Tag within the hardware queue, -1 if none */
+    struct blk_mq_hw_ctx *hctx; /* Hardware queue */
+    struct blk_mq_ctx *mq_ctx;  /* Software queue of the submitting CPU */
+    int status;                 /* Result while steered back to the submitter */
+    int internal_tag;           /* Index in the hardware queue's request pool */
+
+    /* I/O scheduler state */
+    io_context_t *ioc;          /* Submitter of the first bio */
+    uint64_t deadline_ns;       /* Expiry of the request's FIFO slot */
+    struct request *sort_prev;  /* Sector-sorted list */
+    struct request *sort_next;
+    struct request *fifo_prev;  /* Arrival-ordered list */
+    struct request *fifo_next;
+    void    *elv_priv;          /* Scheduler-private */
+
+    uint64_t start_ns;          /* When the first bio became a request */
+    uint64_t io_start_ns;       /* When the driver accepted the request */
+} request_t;
+
+/* Per-device request queue */
+typedef struct request_queue {
+    block_device_t *device;     /* Owning device */
+    uint32_t max_sectors;       /* Largest request in sectors */
+    uint16_t max_segments;      /* Most segments per request */
+    uint32_t logical_block_size;/* Requests are aligned to this many bytes */
+    bool     virt_boundary;     /* No gaps inside a page between segments */
+    bool     write_cache;       /* Device caches writes; FLUSH must reach it */
+    bool     fua;               /* Device honours FUA writes itself */
+    uint32_t max_discard_sectors;       /* Largest discard, 0 if unsupported */
+    uint32_t max_write_zeroes_sectors;  /* Largest write zeroes, 0 if unsupported */
+    uint32_t discard_granularity;       /* Bytes the device unmaps at a time */
+
+    /* Multi-queue state, used when the driver supplies a tag set */
+    struct blk_mq_tag_set *tag_set;
+    struct blk_mq_hw_ctx *hctxs;/* Hardware queues */
+    uint16_t nr_hw_queues;
+    struct blk_mq_ctx *ctxs;    /* Software queues, one per CPU */
+    void    *ctxs_alloc;        /* Allocation backing the software queues */
+    const struct elevator_type *elevator; /* I/O scheduler, NULL for none */
+
+    /* Completion waiting */
+    bool     io_poll;           /* Waiters poll even though the device interrupts */
+    int32_t  io_poll_delay;     /* BLK_POLL_* or a fixed sleep in microseconds */
+    blk_poll_stat_t poll_stat[BLK_POLL_STAT_BUCKETS];
+
+    /* Cache flush sequencing */
+    struct blk_flush_seq *flush_pending;  /* Waiting for the next flush */
+    struct blk_flush_seq *flush_running;  /* Covered by the flush in flight */
+    bool     flush_in_flight;
+
+    /* Statistics */
+    uint64_t bios;              /* Bios submitted */
+    uint64_t back_merges;       /* Bios appended to a request */
+    uint64_t front_merges;      /* Bios prepended to a request */
+    uint64_t request_merges;    /* Requests merged while unplugging */
+    uint64_t requests;          /* Requests dispatched */
+    uint64_t flushes;           /* Cache flushes sent to the device */
+    uint64_t flushes_shared;    /* Flush requests served by another's flush */
+    uint64_t fua_emulated;      /* FUA writes completed with a flush */
+    uint64_t poll_sleeps;       /* Sleeps before polling */
+    uint64_t polls;             /* Driver polls while waiting */
+    uint64_t poll_hits;         /* Polls that reaped a completion */
+    uint64_t irq_sleeps;        /* Halts waiting for a completion interrupt */
+
+    /* Accounting */
+    blk_iostat_t iostat;        /* Per-operation counters and latency histograms */
+    blk_trace_t *trace;         /* Event ring while tracing, NULL otherwise */
+} request_queue_t;
+
+/*
+ * Submission plug. While a plug is active, bios are collected and merged
+ * instead of dispatched, and go to the devices sorted by sector when the
+ * plug finishes. Plugs belong to the submitting context: until there is a
+ * scheduler, that is the CPU, and only the outermost plug is active.
+ */
+typedef struct blk_plug {
+    request_t *list;            /* Pending requests, most recent first */
+    uint32_t count;             /* Pending requests */
+} blk_plug_t;
+
+/* Requests held in a plug before it flushes itself */
+#define BLK_PLUG_MAX_REQUESTS       32
+
+/**
+ * Get the largest request of an operation a queue accepts, in sectors
+ */
+static inline uint32_t blk_queue_max_sectors(request_queue_t *q, uint32_t op) {
+    switch (op) {
+        case BIO_OP_DISCARD:      return q->max_discard_sectors;
+        case BIO_OP_WRITE_ZEROES: return q->max_write_zeroes_sectors;
+        default:                  return q->max_sectors;
+    }
+}
+
+/**
+ * Create the request queue for a block device
+ * @param device Block device
+ * @return The queue, or NULL on failure
+ */
+request_queue_t *blk_queue_create(block_device_t *device);
+
+/**
+ * Destroy a request queue
+ * @param q Queue
+ */
+void blk_queue_destroy(request_queue_t *q);
+
+/**
+ * Queue a bio, merging it into a plugged request where possible
+ * @param q Queue of the bio's device
+ * @param bio Validated bio
+ */
+void blk_queue_submit_bio(request_queue_t *q, bio_t *bio);
+
+/**
+ * Reap completions for a queue whose driver can be polled
+ * @param q Queue
+ * @return Number of completions reaped
+ */
+uint32_t blk_queue_poll(request_queue_t *q);
+
+/**
+ * Check whether a queue's device signals completions with interrupts
+ * @param q Queue
+ * @return true if waiters may sleep until the device interrupts
+ */
+bool blk_queue_irq_driven(request_queue_t *q);
+
+/**
+ * Record the latency of a finished request for hybrid polling
+ * @param q Queue
+ * @param op BIO_OP_*
+ * @param bytes Request size
+ * @param ns Time from dispatch to completion
+ */
+void blk_poll_stat_add(request_queue_t *q, uint32_t op, uint32_t bytes, uint64_t ns);
+
+/**
+ * Wait for I/O on a queue to finish
+ *
+ * Interrupt-driven devices are slept on unless io_poll is set; otherwise
+ * the driver is polled, after sleeping through the expected part of the
+ * latency if io_poll_delay asks for it.
+ * @param q Queue the I/O was submitted to
+ * @param op BIO_OP_* of the I/O, for the latency estimate
+ * @param bytes Size of the I/O, for the latency estimate
+ * @param done Returns true once the I/O has finished
+ * @param arg Argument for done
+ */
+void blk_wait_io(request_queue_t *q, uint32_t op, uint32_t bytes,
+                 bool (*done)(void *arg), void *arg);
+
+/**
+ * Start batching submissions from the current context
+ * @param plug Plug, normally on the caller's stack
+ */
+void blk_start_plug(blk_plug_t *plug);
+
+/**
+ * Dispatch everything batched since blk_start_plug
+ * @param plug Plug passed to blk_start_plug
+ */
+void blk_finish_plug(blk_plug_t *plug);
+
+/**
+ * Dispatch the current context's plugged requests without ending the plug
+ */
+void blk_flush_plug(void);
+
+/**
+ * Make an I/O context current for the bios this CPU submits
+ * @param ioc Context, or NULL for the kernel's
+ */
+void ioc_set_current(io_context_t *ioc);
+
+/**
+ * Get the I/O context of the current submitter
+ * @return Current context, never NULL
+ */
+io_context_t *ioc_current(void);
+
+/**
+ * Set the I/O weight of a context
+ * @param ioc Context
+ * @param weight Weight between IOC_MIN_WEIGHT and IOC_MAX_WEIGHT
+ * @return 0 on success, negative if the weight is out of range
+ */
+int ioc_set_weight(io_context_t *ioc, uint16_t weight);
+
+#endif /* _DRIVERS_BLOCK_BLK_QUEUE_H */
\ No newline at end of file
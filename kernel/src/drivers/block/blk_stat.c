@@ -0,0 +1,379 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/config.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_stat.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+
+/**
+ * Get the histogram bucket of a latency
+ */
+uint32_t blk_lat_bucket(uint64_t ns) {
+    if (ns < (1U << BLK_LAT_SUB_BITS)) {
+        return (uint32_t)ns;
+    }
+
+    uint32_t msb = 63 - __builtin_clzll(ns);
+    uint32_t sub = (uint32_t)(ns >> (msb - BLK_LAT_SUB_BITS)) & ((1U << BLK_LAT_SUB_BITS) - 1);
+    uint32_t bucket = ((msb - BLK_LAT_SUB_BITS + 1) << BLK_LAT_SUB_BITS) + sub;
+    return bucket < BLK_LAT_BUCKETS ? bucket : BLK_LAT_BUCKETS - 1;
+}
+
+/**
+ * Get the smallest latency a histogram bucket holds
+ */
+uint64_t blk_lat_bucket_floor(uint32_t bucket) {
+    if (bucket < (1U << BLK_LAT_SUB_BITS)) {
+        return bucket;
+    }
+
+    uint32_t group = bucket >> BLK_LAT_SUB_BITS;
+    uint64_t sub = bucket & ((1U << BLK_LAT_SUB_BITS) - 1);
+    return ((1ULL << BLK_LAT_SUB_BITS) + sub) << (group - 1);
+}
+
+/**
+ * Estimate a latency percentile from a histogram
+ * @param hist Histogram
+ * @param permille Percentile in tenths of a percent (500 for the median)
+ * @return Upper bound of the bucket holding the percentile, 0 if empty
+ */
+uint64_t blk_lat_percentile(const blk_lat_hist_t *hist, uint32_t permille) {
+    if (!hist || hist->count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (hist->count * permille + 999) / 1000;
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BLK_LAT_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            /* The top bucket is open-ended; the slowest sample bounds it */
+            uint64_t ceiling = i + 1 < BLK_LAT_BUCKETS ? blk_lat_bucket_floor(i + 1) - 1 : hist->max_ns;
+            return ceiling < hist->max_ns ? ceiling : hist->max_ns;
+        }
+    }
+    return hist->max_ns;
+}
+
+/**
+ * Charge the time since the last update to the busy and queue time counters
+ */
+static void blk_stat_update(blk_iostat_t *st, uint64_t now) {
+    uint32_t in_flight = 0;
+    for (uint32_t i = 0; i < BLK_STAT_OPS; i++) {
+        in_flight += st->op[i].in_flight;
+    }
+
+    if (in_flight && now > st->stamp_ns) {
+        st->busy_ns += now - st->stamp_ns;
+        st->queue_time_ns += (uint64_t)in_flight * (now - st->stamp_ns);
+    }
+    st->stamp_ns = now;
+}
+
+/**
+ * Record a trace event; only called while tracing is on
+ */
+void blk_trace_add(request_queue_t *q, uint8_t action, uint32_t op,
+                   uint64_t sector, uint32_t nr_sectors, int32_t status) {
+    uint64_t flags = cpu_irq_save();
+    blk_trace_t *trace = q->trace;
+    if (!trace) {
+        cpu_irq_restore(flags);
+        return;
+    }
+
+    if (trace->tail - trace->head > trace->mask) {
+        trace->dropped++;
+        cpu_irq_restore(flags);
+        return;
+    }
+
+    blk_trace_event_t *event = &trace->events[trace->tail & trace->mask];
+    event->time_ns = time_now_ns();
+    event->sector = sector;
+    event->nr_sectors = nr_sectors;
+    event->status = status;
+    event->action = action;
+    event->op = (uint8_t)op;
+    event->cpu = (uint16_t)cpu_current_id();
+    trace->tail++;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Account a request sent to the device's queue
+ */
+void blk_stat_start(request_queue_t *q, request_t *rq) {
+    if (rq->op >= BLK_STAT_OPS) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    blk_stat_update(&q->iostat, time_now_ns());
+    q->iostat.op[rq->op].in_flight++;
+    cpu_irq_restore(flags);
+
+    if (q->trace) {
+        blk_trace_add(q, BLK_TA_INSERT, rq->op, rq->sector, rq->nr_sectors, 0);
+    }
+}
+
+/**
+ * Account a request handed to the driver
+ */
+void blk_stat_issue(request_queue_t *q, request_t *rq) {
+    if (q->trace) {
+        blk_trace_add(q, BLK_TA_ISSUE, rq->op, rq->sector, rq->nr_sectors, 0);
+    }
+}
+
+/**
+ * Account a completed request
+ */
+void blk_stat_done(request_queue_t *q, request_t *rq, int status) {
+    if (rq->op >= BLK_STAT_OPS) {
+        return;
+    }
+
+    uint64_t now = time_now_ns();
+    uint64_t total = now > rq->start_ns ? now - rq->start_ns : 0;
+    uint64_t queued = rq->io_start_ns > rq->start_ns ? rq->io_start_ns - rq->start_ns : 0;
+
+    uint64_t flags = cpu_irq_save();
+    blk_iostat_t *st = &q->iostat;
+    blk_op_stat_t *op = &st->op[rq->op];
+
+    blk_stat_update(st, now);
+    if (op->in_flight) {
+        op->in_flight--;
+    }
+
+    op->ios++;
+    op->sectors += rq->nr_sectors;
+    op->total_ns += total;
+    op->queue_ns += queued;
+    if (status < 0) {
+        op->errors++;
+    }
+
+    op->latency.buckets[blk_lat_bucket(total)]++;
+    op->latency.count++;
+    if (total > op->latency.max_ns) {
+        op->latency.max_ns = total;
+    }
+    cpu_irq_restore(flags);
+
+    if (q->trace) {
+        blk_trace_add(q, BLK_TA_COMPLETE, rq->op, rq->sector, rq->nr_sectors, status);
+    }
+}
+
+/**
+ * Account a bio merged into an existing request
+ */
+void blk_stat_merge(request_queue_t *q, uint32_t op, uint64_t sector, uint32_t nr_sectors) {
+    if (op < BLK_STAT_OPS) {
+        q->iostat.op[op].merges++;
+    }
+
+    if (q->trace) {
+        blk_trace_add(q, BLK_TA_MERGE, op, sector, nr_sectors, 0);
+    }
+}
+
+/**
+ * Copy a device's I/O statistics, brought up to date
+ * @return 0 on success, negative if the device has no queue
+ */
+int blk_stat_get(block_device_t *device, blk_iostat_t *stats) {
+    if (!device || !device->queue || !stats) {
+        return -1;
+    }
+
+    request_queue_t *q = device->queue;
+    uint64_t flags = cpu_irq_save();
+    blk_stat_update(&q->iostat, time_now_ns());
+    memcpy(stats, &q->iostat, sizeof(blk_iostat_t));
+    cpu_irq_restore(flags);
+    return 0;
+}
+
+/**
+ * Clear a device's I/O statistics (requests in flight stay counted)
+ */
+void blk_stat_reset(block_device_t *device) {
+    if (!device || !device->queue) {
+        return;
+    }
+
+    blk_iostat_t *st = &device->queue->iostat;
+    uint32_t in_flight[BLK_STAT_OPS];
+    uint64_t now = time_now_ns();
+
+    uint64_t flags = cpu_irq_save();
+    for (uint32_t i = 0; i < BLK_STAT_OPS; i++) {
+        in_flight[i] = st->op[i].in_flight;
+    }
+    memset(st, 0, sizeof(blk_iostat_t));
+    for (uint32_t i = 0; i < BLK_STAT_OPS; i++) {
+        st->op[i].in_flight = in_flight[i];
+    }
+    st->stamp_ns = now;
+    st->since_ns = now;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Print a device's I/O statistics, iostat style
+ */
+void blk_stat_print(block_device_t *device) {
+    blk_iostat_t st;
+    if (blk_stat_get(device, &st) < 0) {
+        return;
+    }
+
+    uint64_t elapsed = st.stamp_ns - st.since_ns;
+    uint64_t ms = elapsed / 1000000;
+    if (ms == 0) {
+        ms = 1;
+    }
+
+    uint32_t in_flight = 0;
+    for (uint32_t i = 0; i < BLK_STAT_OPS; i++) {
+        in_flight += st.op[i].in_flight;
+    }
+
+    kprintf("BLOCK: %s: %lu ms, %u in flight, util %lu%%, avg queue depth %lu.%02lu\n",
+            device->name, ms, in_flight, st.busy_ns / 10000 / ms,
+            st.queue_time_ns / 1000000 / ms, (st.queue_time_ns / 10000 / ms) % 100);
+
+    for (uint32_t i = 0; i < BLK_STAT_OPS; i++) {
+        blk_op_stat_t *op = &st.op[i];
+        if (op->ios == 0) {
+            continue;
+        }
+
+        kprintf("BLOCK: %s: %s %lu ios/s %lu KiB/s, %lu ios %lu merges %lu sectors %lu errors\n",
+                device->name, bio_op_name(i), op->ios * 1000 / ms,
+                op->sectors * BLOCK_SECTOR_SIZE / 1024 * 1000 / ms,
+                op->ios, op->merges, op->sectors, op->errors);
+        kprintf("BLOCK: %s: %s await %lu us (queue %lu us), p50 %lu us, p99 %lu us, p99.9 %lu us, max %lu us\n",
+                device->name, bio_op_name(i), op->total_ns / op->ios / 1000,
+                op->queue_ns / op->ios / 1000,
+                blk_lat_percentile(&op->latency, 500) / 1000,
+                blk_lat_percentile(&op->latency, 990) / 1000,
+                blk_lat_percentile(&op->latency, 999) / 1000,
+                op->latency.max_ns / 1000);
+    }
+}
+
+/**
+ * Start recording request events of a device
+ * @param device Block device
+ * @param entries Ring size, rounded up to a power of two
+ * @return 0 on success, negative on error or if tracing is already on
+ */
+int blk_trace_start(block_device_t *device, uint32_t entries) {
+    if (!device || !device->queue || device->queue->trace || entries == 0 || entries > (1U << 24)) {
+        return -1;
+    }
+
+    uint32_t size = 1;
+    while (size < entries) {
+        size <<= 1;
+    }
+
+    blk_trace_t *trace = (blk_trace_t *)kzalloc(sizeof(blk_trace_t));
+    if (!trace) {
+        return -1;
+    }
+
+    uint64_t phys;
+    trace->pages = (uint32_t)(((uint64_t)size * sizeof(blk_trace_event_t) + PAGE_SIZE - 1) / PAGE_SIZE);
+    trace->events = (blk_trace_event_t *)pmm_alloc_dma(trace->pages, &phys);
+    if (!trace->events) {
+        kfree(trace);
+        return -1;
+    }
+    trace->mask = size - 1;
+
+    __atomic_store_n(&device->queue->trace, trace, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Stop recording and free the event ring
+ */
+void blk_trace_stop(block_device_t *device) {
+    if (!device || !device->queue) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    blk_trace_t *trace = device->queue->trace;
+    device->queue->trace = NULL;
+    cpu_irq_restore(flags);
+
+    if (trace) {
+        if (trace->dropped) {
+            kprintf("BLOCK: %s: trace dropped %lu events\n", device->name, trace->dropped);
+        }
+        pmm_free_dma(trace->events, trace->pages);
+        kfree(trace);
+    }
+}
+
+/**
+ * Take recorded events out of the ring, oldest first
+ * @param device Block device
+ * @param events Output array
+ * @param max Capacity of the array
+ * @return Number of events copied
+ */
+uint32_t blk_trace_read(block_device_t *device, blk_trace_event_t *events, uint32_t max) {
+    if (!device || !device->queue || !events) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    uint64_t flags = cpu_irq_save();
+    blk_trace_t *trace = device->queue->trace;
+    while (trace && count < max && trace->head != trace->tail) {
+        events[count++] = trace->events[trace->head & trace->mask];
+        trace->head++;
+    }
+    cpu_irq_restore(flags);
+    return count;
+}
\ No newline at end of file
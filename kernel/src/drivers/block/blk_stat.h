@@ -0,0 +1,181 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Block I/O accounting, latency histograms and tracing
+ */
+
+#ifndef _DRIVERS_BLOCK_BLK_STAT_H
+#define _DRIVERS_BLOCK_BLK_STAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/block.h>
+
+struct request_queue;
+struct request;
+
+/* Operations accounted separately, indexed by BIO_OP_* */
+#define BLK_STAT_OPS            5
+
+/*
+ * Latency histograms are log-linear: every power of two of nanoseconds is
+ * split into 2^BLK_LAT_SUB_BITS equal buckets, so a bucket is never more
+ * than a quarter wider than its lower bound. The last bucket starts around
+ * half an hour and takes everything slower.
+ */
+#define BLK_LAT_SUB_BITS        2
+#define BLK_LAT_BUCKETS         160
+
+typedef struct blk_lat_hist {
+    uint64_t buckets[BLK_LAT_BUCKETS];
+    uint64_t count;             /* Samples */
+    uint64_t max_ns;            /* Slowest sample */
+} blk_lat_hist_t;
+
+/* Counters of one operation */
+typedef struct blk_op_stat {
+    uint64_t ios;               /* Requests completed */
+    uint64_t merges;            /* Bios merged into another's request */
+    uint64_t sectors;           /* Sectors transferred */
+    uint64_t errors;            /* Requests that failed */
+    uint64_t total_ns;          /* Request start to completion, summed */
+    uint64_t queue_ns;          /* Request start to driver issue, summed */
+    uint32_t in_flight;         /* Requests dispatched and not yet completed */
+    blk_lat_hist_t latency;     /* Request start to completion */
+} blk_op_stat_t;
+
+/* Per-device I/O statistics, the equivalent of /proc/diskstats */
+typedef struct blk_iostat {
+    blk_op_stat_t op[BLK_STAT_OPS];
+    uint64_t busy_ns;           /* Time with at least one request in flight */
+    uint64_t queue_time_ns;     /* Time weighted by requests in flight */
+    uint64_t stamp_ns;          /* Last update of the two above */
+    uint64_t since_ns;          /* Start of the accounting period */
+} blk_iostat_t;
+
+/* Trace actions, as in blktrace */
+#define BLK_TA_QUEUE            'Q'     /* Bio submitted */
+#define BLK_TA_MERGE            'M'     /* Bio merged into a request */
+#define BLK_TA_INSERT           'I'     /* Request sent to the device's queue */
+#define BLK_TA_ISSUE            'D'     /* Request handed to the driver */
+#define BLK_TA_COMPLETE         'C'     /* Request completed */
+
+/* One trace event */
+typedef struct blk_trace_event {
+    uint64_t time_ns;           /* Timestamp */
+    uint64_t sector;            /* First sector */
+    uint32_t nr_sectors;        /* Sectors covered */
+    int32_t  status;            /* Completion status, 0 for other actions */
+    uint8_t  action;            /* BLK_TA_* */
+    uint8_t  op;                /* BIO_OP_* */
+    uint16_t cpu;               /* CPU the event happened on */
+} blk_trace_event_t;
+
+/* Trace ring of a queue; events are dropped while it is full */
+typedef struct blk_trace {
+    blk_trace_event_t *events;
+    uint32_t pages;             /* Size of the event allocation */
+    uint32_t mask;              /* Entries - 1 */
+    uint32_t head;              /* Next event to read */
+    uint32_t tail;              /* Next slot to write */
+    uint64_t dropped;           /* Events lost to a full ring */
+} blk_trace_t;
+
+/**
+ * Record a trace event; only called while tracing is on
+ */
+void blk_trace_add(struct request_queue *q, uint8_t action, uint32_t op,
+                   uint64_t sector, uint32_t nr_sectors, int32_t status);
+
+/**
+ * Account a request sent to the device's queue
+ */
+void blk_stat_start(struct request_queue *q, struct request *rq);
+
+/**
+ * Account a request handed to the driver
+ */
+void blk_stat_issue(struct request_queue *q, struct request *rq);
+
+/**
+ * Account a completed request
+ */
+void blk_stat_done(struct request_queue *q, struct request *rq, int status);
+
+/**
+ * Account a bio merged into an existing request
+ */
+void blk_stat_merge(struct request_queue *q, uint32_t op, uint64_t sector, uint32_t nr_sectors);
+
+/**
+ * Get the histogram bucket of a latency
+ */
+uint32_t blk_lat_bucket(uint64_t ns);
+
+/**
+ * Get the smallest latency a histogram bucket holds
+ */
+uint64_t blk_lat_bucket_floor(uint32_t bucket);
+
+/**
+ * Estimate a latency percentile from a histogram
+ * @param hist Histogram
+ * @param permille Percentile in tenths of a percent (500 for the median)
+ * @return Upper bound of the bucket holding the percentile, 0 if empty
+ */
+uint64_t blk_lat_percentile(const blk_lat_hist_t *hist, uint32_t permille);
+
+/**
+ * Copy a device's I/O statistics, brought up to date
+ * @return 0 on success, negative if the device has no queue
+ */
+int blk_stat_get(block_device_t *device, blk_iostat_t *stats);
+
+/**
+ * Clear a device's I/O statistics (requests in flight stay counted)
+ */
+void blk_stat_reset(block_device_t *device);
+
+/**
+ * Print a device's I/O statistics, iostat style
+ */
+void blk_stat_print(block_device_t *device);
+
+/**
+ * Start recording request events of a device
+ * @param device Block device
+ * @param entries Ring size, rounded up to a power of two
+ * @return 0 on success, negative on error or if tracing is already on
+ */
+int blk_trace_start(block_device_t *device, uint32_t entries);
+
+/**
+ * Stop recording and free the event ring
+ */
+void blk_trace_stop(block_device_t *device);
+
+/**
+ * Take recorded events out of the ring, oldest first
+ * @param device Block device
+ * @param events Output array
+ * @param max Capacity of the array
+ * @return Number of events copied
+ */
+uint32_t blk_trace_read(block_device_t *device, blk_trace_event_t *events, uint32_t max);
+
+#endif /* _DRIVERS_BLOCK_BLK_STAT_H */
\ No newline at end of file
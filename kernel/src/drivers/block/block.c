@@ -0,0 +1,207 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Block device registry
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <drivers/block/block.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/elevator.h>
+
+/* Registered block devices, in registration order */
+static block_device_t *block_devices[BLOCK_MAX_DEVICES];
+static int block_device_total = 0;
+
+/**
+ * Register a block device so filesystems can find it
+ * @param device Block device to register
+ * @return 0 on success, negative on error
+ */
+int block_device_register(block_device_t *device) {
+    if (!device || !device->ops) {
+        return -1;
+    }
+
+    if (block_device_find(device->name)) {
+        kerr("BLOCK: Device %s already registered\n", device->name);
+        return -1;
+    }
+
+    if (block_device_total >= BLOCK_MAX_DEVICES) {
+        kerr("BLOCK: Too many block devices\n");
+        return -1;
+    }
+
+    if (!device->queue) {
+        device->queue = blk_queue_create(device);
+        if (!device->queue) {
+            kerr("BLOCK: %s: Failed to create request queue\n", device->name);
+            return -1;
+        }
+    }
+
+    block_devices[block_device_total++] = device;
+    kprintf("BLOCK: %s: %lu MiB, %u-byte blocks\n",
+            device->name, device->size / (1024 * 1024), device->block_size);
+    return 0;
+}
+
+/**
+ * Unregister a block device
+ * @param device Block device to unregister
+ * @return 0 on success, negative on error
+ */
+int block_device_unregister(block_device_t *device) {
+    for (int i = 0; i < block_device_total; i++) {
+        if (block_devices[i] == device) {
+            for (int j = i; j < block_device_total - 1; j++) {
+                block_devices[j] = block_devices[j + 1];
+            }
+            block_devices[--block_device_total] = NULL;
+            blk_queue_destroy(device->queue);
+            device->queue = NULL;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Find a registered block device by name
+ * @param name Device name (e.g. "vda")
+ * @return The block device, or NULL if not found
+ */
+block_device_t *block_device_find(const char *name) {
+    if (!name) {
+        return NULL;
+    }
+
+    for (int i = 0; i < block_device_total; i++) {
+        if (strcmp(block_devices[i]->name, name) == 0) {
+            return block_devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Get a registered block device by index
+ * @param index Index in registration order
+ * @return The block device, or NULL if out of range
+ */
+block_device_t *block_device_get(int index) {
+    if (index < 0 || index >= block_device_total) {
+        return NULL;
+    }
+    return block_devices[index];
+}
+
+/**
+ * Get the number of registered block devices
+ */
+int block_device_count(void) {
+    return block_device_total;
+}
+
+/**
+ * Select the I/O scheduler of a device
+ * @param device Block device
+ * @param name Scheduler name ("none", "mq-deadline", "bfq")
+ * @return 0 on success, negative if the device or scheduler is unknown
+ */
+int block_set_scheduler(block_device_t *device, const char *name) {
+    if (!device || !device->queue) {
+        return -1;
+    }
+    return elevator_switch(device->queue, name);
+}
+
+/**
+ * Describe the I/O schedulers a device can use, the current one in brackets
+ * @param device Block device
+ * @param buffer Output buffer
+ * @param size Size of the buffer
+ * @return Length of the string written (0 if the device cannot be scheduled)
+ */
+size_t block_get_scheduler(block_device_t *device, char *buffer, size_t size) {
+    return elevator_list(device ? device->queue : NULL, buffer, size);
+}
+
+/**
+ * Choose how waiters for a device's I/O find out it finished
+ * @param device Block device
+ * @param poll Poll the device even if it interrupts
+ * @param delay BLK_POLL_CLASSIC, BLK_POLL_HYBRID or microseconds to sleep before polling
+ * @return 0 on success, negative if the device or delay is invalid
+ */
+int block_set_io_poll(block_device_t *device, bool poll, int32_t delay) {
+    if (!device || !device->queue || delay < BLK_POLL_CLASSIC) {
+        return -1;
+    }
+
+    request_queue_t *q = device->queue;
+    q->io_poll = poll;
+    q->io_poll_delay = delay;
+
+    kprintf("BLOCK: %s: Completions %s", device->name,
+            poll || !blk_queue_irq_driven(q) ? "polled" : "interrupt-driven");
+    if (delay == BLK_POLL_HYBRID) {
+        kprintf(", hybrid sleep\n");
+    } else if (delay > 0) {
+        kprintf(", %d us sleep\n", delay);
+    } else {
+        kprintf("\n");
+    }
+    return 0;
+}
+
+/**
+ * Run a random read benchmark on a device and print the result
+ * @param device Block device
+ * @param queue_depth Requests kept in flight
+ * @param io_count Total requests to issue
+ * @return 0 on success, negative on error or if the device cannot benchmark
+ */
+int block_bench(block_device_t *device, uint32_t queue_depth, uint32_t io_count) {
+    if (!device || !device->ops->ioctl || queue_depth == 0 || io_count == 0) {
+        return -1;
+    }
+
+    block_bench_t bench;
+    memset(&bench, 0, sizeof(bench));
+    bench.queue_depth = queue_depth;
+    bench.io_count = io_count;
+    bench.io_size = 4096;
+
+    int result = device->ops->ioctl(device, BLOCK_IOCTL_BENCH, &bench);
+    if (result < 0) {
+        kerr("BLOCK: %s: Benchmark failed\n", device->name);
+        return result;
+    }
+
+    kprintf("BLOCK: %s: %u x %u-byte random reads at QD %u: %lu IOPS, avg latency %lu us, %u errors\n",
+            device->name, bench.io_count, bench.io_size, bench.queue_depth,
+            bench.iops, bench.avg_latency_ns / 1000, bench.errors);
+    return 0;
+}
\ No newline at end of file
@@ -21,14 +21,46 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+
+/* Maximum number of registered block devices */
+#define BLOCK_MAX_DEVICES          16
+
+/* Logical sector size used for addressing */
+#define BLOCK_SECTOR_SIZE          512
+
+/* Generic ioctl commands */
+#define BLOCK_IOCTL_BENCH          0x0100  /* Random read benchmark (block_bench_t) */
+
+/* Benchmark parameters and results for BLOCK_IOCTL_BENCH */
+typedef struct block_bench {
+    uint32_t queue_depth;      /* Requests kept in flight */
+    uint32_t io_count;         /* Total requests to issue */
+    uint32_t io_size;          /* Bytes per request */
+    uint32_t errors;           /* Failed requests (output) */
+    uint64_t elapsed_ns;       /* Wall time (output) */
+    uint64_t iops;             /* Completed requests per second (output) */
+    uint64_t avg_latency_ns;   /* Mean submit-to-completion time (output) */
+} block_bench_t;
 
 struct block_device;
+struct request_queue;
+struct blk_mq_tag_set;
+struct bio;
 
 /* Block device operations */
 typedef struct block_device_ops {
     int (*read)(struct block_device *device, uint64_t offset, size_t size, void *buffer);
     int (*write)(struct block_device *device, uint64_t offset, size_t size, const void *buffer);
     int (*ioctl)(struct block_device *device, unsigned int cmd, void *arg);
+    /* Optional: direct pointer to memory-backed device contents, so callers
+     * such as the page cache can reference data instead of copying it */
+    int (*map)(struct block_device *device, uint64_t offset, size_t size, void **addr);
+    /* Optional: take bios directly instead of requests, for stacking
+     * drivers that remap bios onto other devices */
+    void (*submit_bio)(struct block_device *device, struct bio *bio);
+    /* Optional: reap completions for a device that takes bios directly */
+    uint32_t (*poll)(struct block_device *device);
 } block_device_ops_t;
 
 /* Block device structure */
@@ -38,6 +70,81 @@ typedef struct block_device {
     uint32_t block_size;       /* Block size in bytes */
     void *private_data;        /* Device-specific data */
     block_device_ops_t *ops;   /* Block device operations */
+    struct request_queue *queue; /* Request queue, created on registration */
+    struct blk_mq_tag_set *tag_set; /* Multi-queue drivers set this before registering */
 } block_device_t;
 
+/**
+ * Register a block device so filesystems can find it
+ * @param device Block device to register
+ * @return 0 on success, negative on error
+ */
+int block_device_register(block_device_t *device);
+
+/**
+ * Unregister a block device
+ * @param device Block device to unregister
+ * @return 0 on success, negative on error
+ */
+int block_device_unregister(block_device_t *device);
+
+/**
+ * Find a registered block device by name
+ * @param name Device name (e.g. "vda")
+ * @return The block device, or NULL if not found
+ */
+block_device_t *block_device_find(const char *name);
+
+/**
+ * Get a registered block device by index
+ * @param index Index in registration order
+ * @return The block device, or NULL if out of range
+ */
+block_device_t *block_device_get(int index);
+
+/**
+ * Get the number of registered block devices
+ */
+int block_device_count(void);
+
+/**
+ * Select the I/O scheduler of a device
+ * @param device Block device
+ * @param name Scheduler name ("none", "mq-deadline", "bfq")
+ * @return 0 on success, negative if the device or scheduler is unknown
+ */
+int block_set_scheduler(block_device_t *device, const char *name);
+
+/**
+ * Describe the I/O schedulers a device can use, the current one in brackets
+ * @param device Block device
+ * @param buffer Output buffer
+ * @param size Size of the buffer
+ * @return Length of the string written (0 if the device cannot be scheduled)
+ */
+size_t block_get_scheduler(block_device_t *device, char *buffer, size_t size);
+
+/**
+ * Choose how waiters for a device's I/O find out it finished
+ *
+ * Interrupt-driven devices are slept on by default; polling trades CPU time
+ * for latency. Polling waiters spin from the start (BLK_POLL_CLASSIC), sleep
+ * through half the device's observed latency first (BLK_POLL_HYBRID), or
+ * sleep a fixed number of microseconds first.
+ * @param device Block device
+ * @param poll Poll the device even if it interrupts
+ * @param delay BLK_POLL_CLASSIC, BLK_POLL_HYBRID or microseconds to sleep before polling
+ * @return 0 on success, negative if the device or delay is invalid
+ */
+int block_set_io_poll(block_device_t *device, bool poll, int32_t delay);
+
+/**
+ * Run a random read benchmark on a device and print the result
+ * @param device Block device
+ * @param queue_depth Requests kept in flight
+ * @param io_count Total requests to issue
+ * @return 0 on success, negative on error or if the device cannot benchmark
+ */
+int block_bench(block_device_t *device, uint32_t queue_depth, uint32_t io_count);
+
 #endif /* _DRIVERS_BLOCK_BLOCK_H */
\ No newline at end of file
@@ -0,0 +1,619 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/block_cache.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+
+static inline uint32_t block_cache_hash(uint64_t block) {
+    return (uint32_t)((block * 0x9E3779B97F4A7C15ULL) >> (64 - BLOCK_CACHE_HASH_BITS));
+}
+
+static inline uint64_t block_cache_sector(block_cache_t *cache, uint64_t block) {
+    return block * (cache->block_size / BLOCK_SECTOR_SIZE);
+}
+
+/**
+ * Find a block in the cache
+ * @return The buffer, or NULL if the block is not cached
+ */
+static block_buf_t *block_cache_lookup(block_cache_t *cache, uint64_t block) {
+    block_buf_t *buf = cache->hash[block_cache_hash(block)];
+
+    while (buf && buf->block != block) {
+        buf = buf->hash_next;
+    }
+    return buf;
+}
+
+static void block_cache_hash_remove(block_cache_t *cache, block_buf_t *buf) {
+    block_buf_t **link = &cache->hash[block_cache_hash(buf->block)];
+
+    while (*link && *link != buf) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = buf->hash_next;
+    }
+    buf->hash_next = NULL;
+}
+
+static void block_cache_lru_remove(block_cache_t *cache, block_buf_t *buf) {
+    if (buf->lru_prev) {
+        buf->lru_prev->lru_next = buf->lru_next;
+    } else {
+        cache->lru_head = buf->lru_next;
+    }
+    if (buf->lru_next) {
+        buf->lru_next->lru_prev = buf->lru_prev;
+    } else {
+        cache->lru_tail = buf->lru_prev;
+    }
+    buf->lru_prev = buf->lru_next = NULL;
+}
+
+/**
+ * Move a buffer to the front of the LRU list
+ */
+static void block_cache_touch(block_cache_t *cache, block_buf_t *buf) {
+    if (cache->lru_head == buf) {
+        return;
+    }
+
+    if (buf->lru_prev || buf->lru_next || cache->lru_tail == buf) {
+        block_cache_lru_remove(cache, buf);
+    }
+
+    buf->lru_next = cache->lru_head;
+    if (cache->lru_head) {
+        cache->lru_head->lru_prev = buf;
+    } else {
+        cache->lru_tail = buf;
+    }
+    cache->lru_head = buf;
+}
+
+static void block_cache_dirty_remove(block_cache_t *cache, block_buf_t *buf) {
+    if (buf->dirty_prev) {
+        buf->dirty_prev->dirty_next = buf->dirty_next;
+    } else {
+        cache->dirty_head = buf->dirty_next;
+    }
+    if (buf->dirty_next) {
+        buf->dirty_next->dirty_prev = buf->dirty_prev;
+    } else {
+        cache->dirty_tail = buf->dirty_prev;
+    }
+    buf->dirty_prev = buf->dirty_next = NULL;
+    cache->nr_dirty--;
+}
+
+/**
+ * Flush the device's write cache
+ * @return 0 on success, negative on error
+ */
+static int block_cache_flush(block_cache_t *cache) {
+    cache->flushes++;
+    if (bio_flush_sync(cache->device) < 0) {
+        kerr("BLOCK: %s: cache flush failed\n", cache->device->name);
+        return -1;
+    }
+
+    cache->unflushed = 0;
+    return 0;
+}
+
+/**
+ * Write back the oldest dirty epoch. Its buffers go out under one plug, so
+ * the block layer sorts and merges them, and are all waited for before the
+ * next epoch can start.
+ * @param cache Block cache
+ * @param op_flags BIO_REQ_* flags for every write of the epoch
+ * @return 0 on success, negative on error
+ */
+static int block_cache_write_epoch(block_cache_t *cache, uint32_t op_flags) {
+    block_buf_t *first = cache->dirty_head;
+    if (!first) {
+        return 0;
+    }
+
+    uint64_t epoch = first->epoch;
+
+    /* Writes of an older epoch must be stable before this one starts */
+    if (cache->unflushed && cache->unflushed_epoch < epoch && !(op_flags & BIO_REQ_PREFLUSH)) {
+        if (block_cache_flush(cache) < 0) {
+            return -1;
+        }
+    }
+
+    int result = 0;
+    blk_plug_t plug;
+    blk_start_plug(&plug);
+
+    for (block_buf_t *buf = first; buf && buf->epoch == epoch; buf = buf->dirty_next) {
+        bio_t *bio = bio_alloc(cache->device, BIO_OP_WRITE,
+                               block_cache_sector(cache, buf->block), cache->block_pages);
+        if (!bio) {
+            result = -1;
+            break;
+        }
+
+        bio->op_flags = op_flags;
+        bio_add_buffer(bio, buf->data, cache->block_size);
+        bio_submit(bio);
+        buf->bio = bio;
+    }
+
+    blk_finish_plug(&plug);
+
+    /* Written buffers leave the dirty list; failed ones stay for a retry */
+    uint32_t written = 0;
+    block_buf_t *buf = first;
+    while (buf && buf->bio) {
+        block_buf_t *next = buf->dirty_next;
+        bio_t *bio = buf->bio;
+        buf->bio = NULL;
+
+        if (bio_wait(bio) < 0) {
+            kerr("BLOCK: %s: write-back of block %lu failed\n", cache->device->name, buf->block);
+            result = -1;
+        } else {
+            buf->flags &= ~BLOCK_BUF_DIRTY;
+            block_cache_dirty_remove(cache, buf);
+            written++;
+        }
+
+        bio_free(bio);
+        buf = next;
+    }
+
+    cache->writebacks += written;
+    cache->batches++;
+
+    if (op_flags & BIO_REQ_PREFLUSH) {
+        cache->flushes++;
+    }
+
+    if (written > 0) {
+        if (!(op_flags & BIO_REQ_FUA)) {
+            cache->unflushed += written;
+            cache->unflushed_epoch = epoch;
+        } else if (result == 0 && (op_flags & BIO_REQ_PREFLUSH)) {
+            cache->unflushed = 0;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Find an idle clean buffer to reuse, writing back the oldest epoch if every
+ * idle buffer is dirty
+ * @return The buffer, unhashed and off the LRU list, or NULL if none is idle
+ */
+static block_buf_t *block_cache_reclaim(block_cache_t *cache) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (block_buf_t *buf = cache->lru_tail; buf; buf = buf->lru_prev) {
+            if (buf->refcount == 0 && !(buf->flags & BLOCK_BUF_DIRTY)) {
+                block_cache_hash_remove(cache, buf);
+                block_cache_lru_remove(cache, buf);
+                cache->evictions++;
+                return buf;
+            }
+        }
+
+        if (!cache->dirty_head || block_cache_write_epoch(cache, 0) < 0) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Get a buffer for a block that is not cached yet
+ * @return The hashed buffer with no data, or NULL on failure
+ */
+static block_buf_t *block_cache_alloc(block_cache_t *cache, uint64_t block) {
+    block_buf_t *buf = NULL;
+
+    if (cache->nr_buffers >= cache->max_buffers) {
+        buf = block_cache_reclaim(cache);
+    }
+
+    /* With every buffer in use the cache grows past its limit */
+    if (!buf) {
+        buf = (block_buf_t *)kmalloc(sizeof(block_buf_t));
+        if (!buf) {
+            return NULL;
+        }
+
+        uint64_t phys;
+        buf->data = pmm_alloc_dma(cache->block_pages, &phys);
+        if (!buf->data) {
+            kfree(buf);
+            return NULL;
+        }
+        cache->nr_buffers++;
+    }
+
+    void *data = buf->data;
+    memset(buf, 0, sizeof(block_buf_t));
+    buf->cache = cache;
+    buf->block = block;
+    buf->data = data;
+
+    uint32_t bucket = block_cache_hash(block);
+    buf->hash_next = cache->hash[bucket];
+    cache->hash[bucket] = buf;
+    block_cache_touch(cache, buf);
+    return buf;
+}
+
+/**
+ * Drop a clean, unused buffer from the cache and free it
+ */
+static void block_cache_free_buf(block_cache_t *cache, block_buf_t *buf) {
+    block_cache_hash_remove(cache, buf);
+    block_cache_lru_remove(cache, buf);
+    pmm_free_dma(buf->data, cache->block_pages);
+    kfree(buf);
+    cache->nr_buffers--;
+}
+
+/**
+ * Create a block cache
+ * @param device Cached device
+ * @param block_size Block size in bytes (a multiple of the sector size)
+ * @param max_buffers Buffers to keep before reclaiming (0 for the default)
+ * @return The cache, or NULL on failure
+ */
+block_cache_t *block_cache_create(block_device_t *device, uint32_t block_size, uint32_t max_buffers) {
+    if (!device || block_size == 0 || block_size % BLOCK_SECTOR_SIZE != 0) {
+        return NULL;
+    }
+
+    block_cache_t *cache = (block_cache_t *)kmalloc(sizeof(block_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    memset(cache, 0, sizeof(block_cache_t));
+    cache->device = device;
+    cache->block_size = block_size;
+    cache->block_pages = (block_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    cache->max_buffers = max_buffers ? max_buffers : BLOCK_CACHE_BUFFERS;
+    return cache;
+}
+
+/**
+ * Write back all dirty buffers and free the cache
+ */
+void block_cache_destroy(block_cache_t *cache) {
+    if (!cache) {
+        return;
+    }
+
+    if (block_cache_sync(cache) < 0) {
+        kerr("BLOCK: %s: %u dirty blocks lost\n", cache->device->name, cache->nr_dirty);
+    }
+
+    kprintf("BLOCK: %s: cache %lu hits, %lu misses, %lu blocks written in %lu batches, %lu flushes\n",
+            cache->device->name, cache->hits, cache->misses, cache->writebacks,
+            cache->batches, cache->flushes);
+
+    while (cache->lru_head) {
+        block_buf_t *buf = cache->lru_head;
+        block_cache_lru_remove(cache, buf);
+        pmm_free_dma(buf->data, cache->block_pages);
+        kfree(buf);
+    }
+
+    kfree(cache);
+}
+
+/**
+ * Get a buffer holding a block's contents, reading it if needed
+ * @return The buffer (release it with block_cache_put), or NULL on error
+ */
+block_buf_t *block_cache_get(block_cache_t *cache, uint64_t block) {
+    if (!cache) {
+        return NULL;
+    }
+
+    block_buf_t *buf = block_cache_lookup(cache, block);
+    if (buf && (buf->flags & BLOCK_BUF_UPTODATE)) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+        if (!buf) {
+            buf = block_cache_alloc(cache, block);
+            if (!buf) {
+                return NULL;
+            }
+        }
+    }
+
+    buf->refcount++;
+    block_cache_touch(cache, buf);
+
+    if (!(buf->flags & BLOCK_BUF_UPTODATE)) {
+        if (bio_rw_sync(cache->device, BIO_OP_READ, block_cache_sector(cache, block),
+                        buf->data, cache->block_size) < 0) {
+            kerr("BLOCK: %s: read of block %lu failed\n", cache->device->name, block);
+            if (--buf->refcount == 0) {
+                block_cache_free_buf(cache, buf);
+            }
+            return NULL;
+        }
+        buf->flags |= BLOCK_BUF_UPTODATE;
+    }
+
+    return buf;
+}
+
+/**
+ * Get a buffer for a block that is about to be overwritten without reading it
+ * @return The zeroed or cached buffer, or NULL on error
+ */
+block_buf_t *block_cache_get_blank(block_cache_t *cache, uint64_t block) {
+    if (!cache) {
+        return NULL;
+    }
+
+    block_buf_t *buf = block_cache_lookup(cache, block);
+    if (!buf) {
+        buf = block_cache_alloc(cache, block);
+        if (!buf) {
+            return NULL;
+        }
+    }
+
+    if (!(buf->flags & BLOCK_BUF_UPTODATE)) {
+        memset(buf->data, 0, cache->block_size);
+        buf->flags |= BLOCK_BUF_UPTODATE;
+    }
+
+    buf->refcount++;
+    block_cache_touch(cache, buf);
+    return buf;
+}
+
+/**
+ * Mark a buffer dirty; call this before modifying its data. A buffer still
+ * dirty from an earlier epoch is written back first so the barrier holds.
+ * @return 0 on success, negative on error
+ */
+int block_cache_dirty(block_cache_t *cache, block_buf_t *buf) {
+    if (!cache || !buf) {
+        return -1;
+    }
+
+    if (buf->flags & BLOCK_BUF_DIRTY) {
+        if (buf->epoch == cache->epoch) {
+            return 0;
+        }
+
+        /* The old contents are ordered before the barrier; they go out first */
+        cache->ordering_stalls++;
+        while (buf->flags & BLOCK_BUF_DIRTY) {
+            if (block_cache_write_epoch(cache, 0) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    buf->flags |= BLOCK_BUF_DIRTY | BLOCK_BUF_UPTODATE;
+    buf->epoch = cache->epoch;
+
+    /* Epochs only grow, so appending keeps the dirty list in epoch order */
+    buf->dirty_prev = cache->dirty_tail;
+    buf->dirty_next = NULL;
+    if (cache->dirty_tail) {
+        cache->dirty_tail->dirty_next = buf;
+    } else {
+        cache->dirty_head = buf;
+    }
+    cache->dirty_tail = buf;
+    cache->nr_dirty++;
+    return 0;
+}
+
+/**
+ * Release a buffer obtained from block_cache_get
+ */
+void block_cache_put(block_cache_t *cache, block_buf_t *buf) {
+    (void)cache;
+    if (buf && buf->refcount > 0) {
+        buf->refcount--;
+    }
+}
+
+static bool block_cache_cached(block_cache_t *cache, uint64_t block) {
+    block_buf_t *buf = block_cache_lookup(cache, block);
+    return buf && (buf->flags & BLOCK_BUF_UPTODATE);
+}
+
+/**
+ * Read consecutive blocks, copying cached ones and reading the rest directly
+ * @return 0 on success, negative on error
+ */
+int block_cache_read(block_cache_t *cache, uint64_t block, uint32_t count, void *buffer) {
+    if (!cache || !buffer) {
+        return -1;
+    }
+
+    uint8_t *dest = (uint8_t *)buffer;
+    uint32_t i = 0;
+
+    while (i < count) {
+        if (block_cache_copy(cache, block + i, 0, cache->block_size,
+                             dest + (size_t)i * cache->block_size) == 0) {
+            i++;
+            continue;
+        }
+
+        /* Runs of uncached blocks bypass the cache in one request */
+        uint32_t run = 1;
+        while (i + run < count && !block_cache_cached(cache, block + i + run)) {
+            run++;
+        }
+
+        cache->misses += run;
+        if (bio_rw_sync(cache->device, BIO_OP_READ, block_cache_sector(cache, block + i),
+                        dest + (size_t)i * cache->block_size,
+                        (size_t)run * cache->block_size) < 0) {
+            return -1;
+        }
+        i += run;
+    }
+
+    return 0;
+}
+
+/**
+ * Copy part of a block if it is cached
+ * @return 0 if the block was cached and copied, negative otherwise
+ */
+int block_cache_copy(block_cache_t *cache, uint64_t block, uint32_t offset, uint32_t size, void *buffer) {
+    if (!cache || !buffer || offset + size > cache->block_size) {
+        return -1;
+    }
+
+    block_buf_t *buf = block_cache_lookup(cache, block);
+    if (!buf || !(buf->flags & BLOCK_BUF_UPTODATE)) {
+        return -1;
+    }
+
+    memcpy(buffer, (uint8_t *)buf->data + offset, size);
+    cache->hits++;
+    block_cache_touch(cache, buf);
+    return 0;
+}
+
+/**
+ * Check whether a block is cached
+ * @return true if the cache holds the block
+ */
+bool block_cache_contains(block_cache_t *cache, uint64_t block) {
+    if (!cache) {
+        return false;
+    }
+    return block_cache_lookup(cache, block) != NULL;
+}
+
+/**
+ * Replace a whole block's contents in the cache
+ * @return 0 on success, negative on error
+ */
+int block_cache_write(block_cache_t *cache, uint64_t block, const void *buffer) {
+    if (!cache || !buffer) {
+        return -1;
+    }
+
+    block_buf_t *buf = block_cache_get_blank(cache, block);
+    if (!buf) {
+        return -1;
+    }
+
+    int result = block_cache_dirty(cache, buf);
+    if (result == 0) {
+        memcpy(buf->data, buffer, cache->block_size);
+    }
+
+    block_cache_put(cache, buf);
+    return result;
+}
+
+/**
+ * Order writes: buffers dirtied after the barrier reach the device only
+ * after everything dirtied before it is stable
+ */
+void block_cache_barrier(block_cache_t *cache) {
+    if (!cache) {
+        return;
+    }
+
+    /* An epoch with nothing in it needs no new one */
+    bool dirty = cache->dirty_tail && cache->dirty_tail->epoch == cache->epoch;
+    bool written = cache->unflushed && cache->unflushed_epoch == cache->epoch;
+    if (dirty || written) {
+        cache->epoch++;
+        cache->barriers++;
+    }
+}
+
+/**
+ * Write back all dirty buffers without waiting for the device's write cache
+ * @return 0 on success, negative on error
+ */
+int block_cache_writeback(block_cache_t *cache) {
+    if (!cache) {
+        return -1;
+    }
+
+    while (cache->dirty_head) {
+        if (block_cache_write_epoch(cache, 0) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Write back all dirty buffers and make them stable
+ * @return 0 on success, negative on error
+ */
+int block_cache_sync(block_cache_t *cache) {
+    if (!cache) {
+        return -1;
+    }
+
+    while (cache->dirty_head && cache->dirty_head->epoch != cache->dirty_tail->epoch) {
+        if (block_cache_write_epoch(cache, 0) < 0) {
+            return -1;
+        }
+    }
+
+    /*
+     * A lone block in the last epoch is written with FUA, carrying the flush
+     * of everything before it, instead of a write followed by a flush.
+     */
+    if (cache->dirty_head && cache->dirty_head == cache->dirty_tail) {
+        uint32_t op_flags = BIO_REQ_FUA;
+        if (cache->unflushed) {
+            op_flags |= BIO_REQ_PREFLUSH;
+        }
+        return block_cache_write_epoch(cache, op_flags);
+    }
+
+    if (block_cache_write_epoch(cache, 0) < 0) {
+        return -1;
+    }
+
+    return cache->unflushed ? block_cache_flush(cache) : 0;
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Write-back block buffer cache
+ */
+
+#ifndef _DRIVERS_BLOCK_BLOCK_CACHE_H
+#define _DRIVERS_BLOCK_BLOCK_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/block.h>
+
+/* Buffer state flags */
+#define BLOCK_BUF_UPTODATE      (1U << 0)   /* Data matches or supersedes the disk */
+#define BLOCK_BUF_DIRTY         (1U << 1)   /* Data must be written back */
+
+/* Hash buckets per cache */
+#define BLOCK_CACHE_HASH_BITS   8
+#define BLOCK_CACHE_HASH_SIZE   (1U << BLOCK_CACHE_HASH_BITS)
+
+struct block_cache;
+struct bio;
+
+/* One cached filesystem block */
+typedef struct block_buf {
+    struct block_cache *cache;      /* Owning cache */
+    uint64_t block;                 /* Block number */
+    void *data;                     /* Block contents (whole pages) */
+    uint32_t flags;                 /* BLOCK_BUF_* */
+    uint32_t refcount;              /* Users holding the buffer */
+    uint64_t epoch;                 /* Barrier epoch the buffer was dirtied in */
+    struct bio *bio;                /* Write-back in flight */
+    struct block_buf *hash_next;    /* Next buffer in the hash bucket */
+    struct block_buf *lru_prev;     /* LRU list, most recently used first */
+    struct block_buf *lru_next;
+    struct block_buf *dirty_prev;   /* Dirty list, oldest epoch first */
+    struct block_buf *dirty_next;
+} block_buf_t;
+
+/*
+ * Block cache of one device. Writes stay in memory until they are written
+ * back. Barriers split the dirty buffers into epochs: an epoch reaches the
+ * device, and is flushed out of its write cache, before any buffer of a
+ * later epoch is written.
+ */
+typedef struct block_cache {
+    block_device_t *device;         /* Cached device */
+    uint32_t block_size;            /* Block size in bytes */
+    uint32_t block_pages;           /* Pages backing one buffer */
+    uint32_t max_buffers;           /* Buffers kept before reclaiming */
+    uint32_t nr_buffers;            /* Buffers allocated */
+    uint32_t nr_dirty;              /* Buffers on the dirty list */
+    block_buf_t *hash[BLOCK_CACHE_HASH_SIZE];
+    block_buf_t *lru_head;          /* Most recently used */
+    block_buf_t *lru_tail;          /* Least recently used */
+    block_buf_t *dirty_head;        /* Oldest epoch */
+    block_buf_t *dirty_tail;        /* Newest epoch */
+    uint64_t epoch;                 /* Epoch new dirty buffers join */
+    uint32_t unflushed;             /* Blocks written since the last cache flush */
+    uint64_t unflushed_epoch;       /* Newest epoch among them */
+
+    /* Statistics */
+    uint64_t hits;                  /* Lookups served from the cache */
+    uint64_t misses;                /* Lookups that read the device */
+    uint64_t writebacks;            /* Buffers written back */
+    uint64_t batches;               /* Epochs written back */
+    uint64_t flushes;               /* Cache flushes issued */
+    uint64_t barriers;              /* Epochs started */
+    uint64_t ordering_stalls;       /* Buffers redirtied across a barrier */
+    uint64_t evictions;             /* Clean buffers reclaimed */
+} block_cache_t;
+
+/**
+ * Create a block cache
+ * @param device Cached device
+ * @param block_size Block size in bytes (a multiple of the sector size)
+ * @param max_buffers Buffers to keep before reclaiming (0 for the default)
+ * @return The cache, or NULL on failure
+ */
+block_cache_t *block_cache_create(block_device_t *device, uint32_t block_size, uint32_t max_buffers);
+
+/**
+ * Write back all dirty buffers and free the cache
+ */
+void block_cache_destroy(block_cache_t *cache);
+
+/**
+ * Get a buffer holding a block's contents, reading it if needed
+ * @return The buffer (release it with block_cache_put), or NULL on error
+ */
+block_buf_t *block_cache_get(block_cache_t *cache, uint64_t block);
+
+/**
+ * Get a buffer for a block that is about to be overwritten without reading it
+ * @return The zeroed or cached buffer, or NULL on error
+ */
+block_buf_t *block_cache_get_blank(block_cache_t *cache, uint64_t block);
+
+/**
+ * Mark a buffer dirty; call this before modifying its data. A buffer still
+ * dirty from an earlier epoch is written back first so the barrier holds.
+ * @return 0 on success, negative on error
+ */
+int block_cache_dirty(block_cache_t *cache, block_buf_t *buf);
+
+/**
+ * Release a buffer obtained from block_cache_get
+ */
+void block_cache_put(block_cache_t *cache, block_buf_t *buf);
+
+/**
+ * Read consecutive blocks, copying cached ones and reading the rest directly
+ * @return 0 on success, negative on error
+ */
+int block_cache_read(block_cache_t *cache, uint64_t block, uint32_t count, void *buffer);
+
+/**
+ * Copy part of a block if it is cached
+ * @return 0 if the block was cached and copied, negative otherwise
+ */
+int block_cache_copy(block_cache_t *cache, uint64_t block, uint32_t offset, uint32_t size, void *buffer);
+
+/**
+ * Check whether a block is cached
+ * @return true if the cache holds the block
+ */
+bool block_cache_contains(block_cache_t *cache, uint64_t block);
+
+/**
+ * Replace a whole block's contents in the cache
+ * @return 0 on success, negative on error
+ */
+int block_cache_write(block_cache_t *cache, uint64_t block, const void *buffer);
+
+/**
+ * Order writes: buffers dirtied after the barrier reach the device only
+ * after everything dirtied before it is stable
+ */
+void block_cache_barrier(block_cache_t *cache);
+
+/**
+ * Write back all dirty buffers without waiting for the device's write cache
+ * @return 0 on success, negative on error
+ */
+int block_cache_writeback(block_cache_t *cache);
+
+/**
+ * Write back all dirty buffers and make them stable
+ * @return 0 on success, negative on error
+ */
+int block_cache_sync(block_cache_t *cache);
+
+#endif /* _DRIVERS_BLOCK_BLOCK_CACHE_H */
\ No newline at end of file
@@ -0,0 +1,800 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Device mapper: block devices built from ranges of other block devices
+ *
+ * A mapped device takes bios directly instead of requests. Each bio is
+ * cut where it crosses from one member to the next (at member ends for
+ * linear devices, at chunk boundaries for striped ones) and every piece
+ * goes to its member as a bio of its own, all under one plug, so a large
+ * bio keeps every member busy at once and pieces that end up contiguous
+ * on a member merge there again. The original bio completes when its
+ * last piece does.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/time.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_stat.h>
+#include <drivers/block/dm.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+
+/* A bio being mapped; lives until every piece of it has completed */
+typedef struct dm_io {
+    dm_device_t *dm;            /* Mapped device */
+    bio_t *bio;                 /* Original bio */
+    uint32_t pending;           /* Pieces in flight, plus one while mapping */
+    int status;                 /* First error of any piece */
+    request_t rq;               /* Accounting on the mapped device's queue */
+} dm_io_t;
+
+/* One request slot of a benchmark run */
+typedef struct dm_bench_slot {
+    bio_t *bio;
+    uint64_t submit_ns;
+    bool busy;
+    uint64_t *latency;
+    uint32_t *completed;
+    uint32_t *errors;
+} dm_bench_slot_t;
+
+static void dm_submit_bio(block_device_t *device, bio_t *bio);
+static uint32_t dm_poll(block_device_t *device);
+static int dm_ioctl(block_device_t *device, unsigned int cmd, void *arg);
+
+static block_device_ops_t dm_ops = {
+    .read = NULL,
+    .write = NULL,
+    .ioctl = dm_ioctl,
+    .submit_bio = dm_submit_bio,
+    .poll = dm_poll
+};
+
+/* Mapped devices */
+static dm_device_t *dm_devices[DM_MAX_DEVICES];
+
+/**
+ * Map a sector of a mapped device to a member
+ * @param dm Mapped device
+ * @param sector Sector of the mapped device
+ * @param member Output for the member index
+ * @param member_sector Output for the sector on the member
+ * @return Sectors from there on that map contiguously to the same member
+ */
+static uint64_t dm_map_sector(dm_device_t *dm, uint64_t sector, uint32_t *member, uint64_t *member_sector) {
+    if (dm->target == DM_TARGET_STRIPED) {
+        uint64_t chunk = sector / dm->chunk_sectors;
+        uint32_t offset = sector % dm->chunk_sectors;
+        *member = chunk % dm->nr_members;
+        *member_sector = chunk / dm->nr_members * dm->chunk_sectors + offset;
+        return dm->chunk_sectors - offset;
+    }
+
+    for (uint32_t i = 0; i < dm->nr_members; i++) {
+        dm_member_t *m = &dm->members[i];
+        if (sector < m->start + m->sectors) {
+            *member = i;
+            *member_sector = sector - m->start;
+            return m->start + m->sectors - sector;
+        }
+    }
+
+    /* bio_submit keeps bios inside the device */
+    *member = dm->nr_members - 1;
+    *member_sector = 0;
+    return 0;
+}
+
+/**
+ * Drop a reference to a mapped bio, completing it with the last one
+ */
+static void dm_io_put(dm_io_t *io) {
+    if (__atomic_sub_fetch(&io->pending, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    bio_t *bio = io->bio;
+    int status = io->status;
+    blk_stat_done(io->dm->block.queue, &io->rq, status);
+    kfree(io);
+    bio_endio(bio, status);
+}
+
+/**
+ * Completion of a piece
+ */
+static void dm_clone_end_io(bio_t *clone) {
+    dm_io_t *io = (dm_io_t *)clone->private_data;
+
+    if (clone->status < 0) {
+        for (uint32_t i = 0; i < io->dm->nr_members; i++) {
+            if (io->dm->members[i].device == clone->device) {
+                io->dm->members[i].errors++;
+            }
+        }
+        if (io->status == 0) {
+            io->status = clone->status;
+        }
+    }
+
+    bio_free(clone);
+    dm_io_put(io);
+}
+
+/**
+ * Send a piece of a mapped bio to its member
+ */
+static void dm_issue(dm_io_t *io, dm_member_t *m, bio_t *clone) {
+    clone->op_flags = io->bio->op_flags & ~BIO_REQ_PREFLUSH;
+    clone->ioc = io->bio->ioc;
+    clone->end_io = dm_clone_end_io;
+    clone->private_data = io;
+
+    switch (clone->op) {
+        case BIO_OP_READ:
+            m->reads++;
+            m->read_sectors += bio_sectors(clone);
+            break;
+        case BIO_OP_WRITE:
+            m->writes++;
+            m->write_sectors += bio_sectors(clone);
+            break;
+        default:
+            m->others++;
+            break;
+    }
+
+    io->dm->clones++;
+    __atomic_add_fetch(&io->pending, 1, __ATOMIC_ACQ_REL);
+    bio_submit(clone);
+}
+
+/**
+ * Build a bio for a member from part of a mapped bio's segments
+ * @param m Member
+ * @param bio Mapped bio
+ * @param sector Sector on the member
+ * @param vec First segment of the part
+ * @param offset Byte offset of the part within that segment
+ * @param size Bytes in the part
+ * @return The piece, possibly shorter than size if the member's segment
+ *         limit cut it, or NULL on failure
+ */
+static bio_t *dm_clone_data(dm_member_t *m, bio_t *bio, uint64_t sector,
+                            uint16_t vec, uint32_t offset, uint32_t size) {
+    request_queue_t *q = m->device->queue;
+
+    /* Size the piece to the segments it spans */
+    uint32_t nr_vecs = 0;
+    uint32_t spanned = 0;
+    for (uint16_t i = vec; i < bio->vcnt && spanned < size; i++) {
+        spanned += bio->vecs[i].len - (i == vec ? offset : 0);
+        nr_vecs++;
+    }
+    if (nr_vecs > q->max_segments) {
+        nr_vecs = q->max_segments;
+    }
+
+    bio_t *clone = bio_alloc(m->device, bio->op, sector, nr_vecs);
+    if (!clone) {
+        return NULL;
+    }
+
+    uint32_t added = 0;
+    while (added < size && vec < bio->vcnt) {
+        bio_vec_t *v = &bio->vecs[vec];
+        uint32_t len = v->len - offset;
+        if (len > size - added) {
+            len = size - added;
+        }
+        if (bio_add_page(clone, v->page, len, v->offset + offset) != len) {
+            break;
+        }
+
+        added += len;
+        offset += len;
+        if (offset == v->len) {
+            vec++;
+            offset = 0;
+        }
+    }
+
+    /* A piece cut short by the segment limit must still end on a logical block */
+    uint32_t excess = clone->size % q->logical_block_size;
+    while (excess) {
+        bio_vec_t *last = &clone->vecs[clone->vcnt - 1];
+        uint32_t trim = excess < last->len ? excess : last->len;
+        last->len -= trim;
+        clone->size -= trim;
+        excess -= trim;
+        if (last->len == 0) {
+            clone->vcnt--;
+        }
+    }
+
+    if (clone->size == 0) {
+        bio_free(clone);
+        return NULL;
+    }
+    return clone;
+}
+
+/**
+ * Split a mapped bio that covers sectors into pieces and send them out
+ * @return 0 on success, negative if a piece could not be built
+ */
+static int dm_map_bio(dm_io_t *io) {
+    dm_device_t *dm = io->dm;
+    bio_t *bio = io->bio;
+    uint64_t sector = bio->sector;
+    uint32_t left = bio->size;
+    uint16_t vec = 0;
+    uint32_t offset = 0;
+    uint32_t pieces = 0;
+
+    blk_plug_t plug;
+    blk_start_plug(&plug);
+
+    while (left > 0) {
+        uint32_t index;
+        uint64_t member_sector;
+        uint64_t extent = dm_map_sector(dm, sector, &index, &member_sector);
+        dm_member_t *m = &dm->members[index];
+        request_queue_t *q = m->device->queue;
+
+        uint64_t size = extent * BLOCK_SECTOR_SIZE;
+        if (size > left) {
+            size = left;
+        }
+        uint64_t max = (uint64_t)blk_queue_max_sectors(q, bio->op) * BLOCK_SECTOR_SIZE;
+        max -= max % q->logical_block_size;
+        if (size > max) {
+            size = max;
+        }
+        if (size == 0) {
+            break;
+        }
+
+        bio_t *clone;
+        if (bio_op_dataless(bio->op)) {
+            clone = bio_alloc(m->device, bio->op, member_sector, 0);
+            if (clone) {
+                clone->size = (uint32_t)size;
+            }
+        } else {
+            clone = dm_clone_data(m, bio, member_sector, vec, offset, (uint32_t)size);
+        }
+        if (!clone) {
+            break;
+        }
+
+        /* Step past the part of the segments the piece took */
+        for (uint32_t skip = clone->size; skip > 0 && vec < bio->vcnt;) {
+            uint32_t rest = bio->vecs[vec].len - offset;
+            if (rest > skip) {
+                offset += skip;
+                break;
+            }
+            skip -= rest;
+            vec++;
+            offset = 0;
+        }
+
+        sector += bio_sectors(clone);
+        left -= clone->size;
+        pieces++;
+        dm_issue(io, m, clone);
+    }
+
+    blk_finish_plug(&plug);
+
+    if (pieces > 1) {
+        dm->splits++;
+    }
+    if (left > 0) {
+        kerr("DM: %s: Failed to map %s at sector %lu\n", dm->block.name,
+             bio_op_name(bio->op), sector);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Flush every member's write cache and wait for all of them
+ *
+ * This runs in the submitter's context before the data of a PREFLUSH write
+ * is mapped, so the data never has to be sent from a completion handler.
+ * @return 0 on success, negative if any member failed
+ */
+static int dm_preflush(dm_device_t *dm) {
+    bio_t *flushes[DM_MAX_MEMBERS];
+    int result = 0;
+
+    for (uint32_t i = 0; i < dm->nr_members; i++) {
+        flushes[i] = bio_alloc(dm->members[i].device, BIO_OP_FLUSH, 0, 0);
+        if (flushes[i]) {
+            dm->members[i].others++;
+            bio_submit(flushes[i]);
+        }
+    }
+
+    for (uint32_t i = 0; i < dm->nr_members; i++) {
+        if (!flushes[i] || bio_wait(flushes[i]) < 0) {
+            dm->members[i].errors++;
+            result = -1;
+        }
+        if (flushes[i]) {
+            bio_free(flushes[i]);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Take a bio submitted to a mapped device
+ */
+static void dm_submit_bio(block_device_t *device, bio_t *bio) {
+    dm_device_t *dm = (dm_device_t *)device->private_data;
+
+    dm_io_t *io = (dm_io_t *)kzalloc(sizeof(dm_io_t));
+    if (!io) {
+        bio_endio(bio, -1);
+        return;
+    }
+
+    io->dm = dm;
+    io->bio = bio;
+    io->pending = 1;
+    io->rq.q = device->queue;
+    io->rq.op = bio->op;
+    io->rq.sector = bio->sector;
+    io->rq.nr_sectors = bio_sectors(bio);
+    io->rq.start_ns = io->rq.io_start_ns = time_now_ns();
+    blk_stat_start(device->queue, &io->rq);
+    blk_stat_issue(device->queue, &io->rq);
+    dm->bios++;
+
+    if (bio->op == BIO_OP_FLUSH) {
+        for (uint32_t i = 0; i < dm->nr_members; i++) {
+            bio_t *flush = bio_alloc(dm->members[i].device, BIO_OP_FLUSH, 0, 0);
+            if (!flush) {
+                io->status = -1;
+                break;
+            }
+            dm_issue(io, &dm->members[i], flush);
+        }
+    } else if ((bio->op_flags & BIO_REQ_PREFLUSH) && dm_preflush(dm) < 0) {
+        io->status = -1;
+    } else if (dm_map_bio(io) < 0) {
+        io->status = -1;
+    }
+
+    dm_io_put(io);
+}
+
+/**
+ * Reap completions on every member
+ */
+static uint32_t dm_poll(block_device_t *device) {
+    dm_device_t *dm = (dm_device_t *)device->private_data;
+    uint32_t reaped = 0;
+
+    for (uint32_t i = 0; i < dm->nr_members; i++) {
+        reaped += blk_queue_poll(dm->members[i].device->queue);
+    }
+    return reaped;
+}
+
+/**
+ * Completion of a benchmark read
+ */
+static void dm_bench_end_io(bio_t *bio) {
+    dm_bench_slot_t *slot = (dm_bench_slot_t *)bio->private_data;
+    *slot->latency += time_now_ns() - slot->submit_ns;
+    (*slot->completed)++;
+    if (bio->status < 0) {
+        (*slot->errors)++;
+    }
+    slot->busy = false;
+}
+
+/**
+ * Run random reads through the mapping, keeping queue_depth bios in flight
+ */
+static int dm_bench(dm_device_t *dm, block_bench_t *bench) {
+    request_queue_t *q = dm->block.queue;
+    if (bench->io_size == 0 || bench->io_size % q->logical_block_size ||
+        bench->io_size > PAGE_SIZE * 16) {
+        return -1;
+    }
+
+    uint32_t sectors = bench->io_size / BLOCK_SECTOR_SIZE;
+    uint64_t span = dm->block.size / bench->io_size;
+    if (span == 0) {
+        return -1;
+    }
+
+    size_t pages = ((size_t)bench->queue_depth * bench->io_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t buffer_phys;
+    uint8_t *buffer = (uint8_t *)pmm_alloc_dma(pages, &buffer_phys);
+    dm_bench_slot_t *slots = (dm_bench_slot_t *)kzalloc(bench->queue_depth * sizeof(dm_bench_slot_t));
+    if (!buffer || !slots) {
+        if (buffer) {
+            pmm_free_dma(buffer, pages);
+        }
+        if (slots) {
+            kfree(slots);
+        }
+        return -1;
+    }
+
+    uint64_t latency = 0;
+    uint32_t completed = 0;
+    uint32_t submitted = 0;
+    int result = 0;
+    bench->errors = 0;
+
+    for (uint32_t i = 0; i < bench->queue_depth; i++) {
+        slots[i].bio = bio_alloc(&dm->block, BIO_OP_READ, 0, bench->io_size / PAGE_SIZE + 2);
+        if (!slots[i].bio) {
+            result = -1;
+            break;
+        }
+        slots[i].bio->private_data = &slots[i];
+        slots[i].bio->end_io = dm_bench_end_io;
+        slots[i].latency = &latency;
+        slots[i].completed = &completed;
+        slots[i].errors = &bench->errors;
+    }
+
+    uint64_t seed = time_now_ns() | 1;
+    uint64_t start = time_now_ns();
+    while (result == 0 && completed < bench->io_count) {
+        blk_plug_t plug;
+        blk_start_plug(&plug);
+        for (uint32_t i = 0; i < bench->queue_depth && submitted < bench->io_count; i++) {
+            dm_bench_slot_t *slot = &slots[i];
+            if (slot->busy) {
+                continue;
+            }
+
+            /* xorshift64 */
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+
+            bio_t *bio = slot->bio;
+            bio->sector = (seed % span) * sectors;
+            bio->size = 0;
+            bio->vcnt = 0;
+            bio_add_buffer(bio, buffer + (size_t)i * bench->io_size, bench->io_size);
+
+            slot->busy = true;
+            slot->submit_ns = time_now_ns();
+            bio_submit(bio);
+            submitted++;
+        }
+        blk_finish_plug(&plug);
+
+        dm_poll(&dm->block);
+    }
+
+    /* Drain anything still in flight after an allocation failure */
+    for (uint32_t i = 0; i < bench->queue_depth; i++) {
+        while (slots[i].busy) {
+            dm_poll(&dm->block);
+        }
+    }
+    bench->elapsed_ns = time_now_ns() - start;
+
+    for (uint32_t i = 0; i < bench->queue_depth && slots[i].bio; i++) {
+        bio_free(slots[i].bio);
+    }
+    kfree(slots);
+    pmm_free_dma(buffer, pages);
+
+    bench->iops = bench->elapsed_ns ? (uint64_t)completed * 1000000000ULL / bench->elapsed_ns : 0;
+    bench->avg_latency_ns = completed ? latency / completed : 0;
+    return result;
+}
+
+static int dm_ioctl(block_device_t *device, unsigned int cmd, void *arg) {
+    if (!device) {
+        return -1;
+    }
+
+    dm_device_t *dm = (dm_device_t *)device->private_data;
+    switch (cmd) {
+        case BLOCK_IOCTL_BENCH:
+            if (!arg) {
+                return -1;
+            }
+            return dm_bench(dm, (block_bench_t *)arg);
+        default:
+            return -1;
+    }
+}
+
+/**
+ * Allocate a mapped device over a set of members
+ * @return The device, or NULL if the members are unusable
+ */
+static dm_device_t *dm_alloc(const char *name, block_device_t **members, uint32_t count, uint32_t target) {
+    if (!name || !members || count == 0 || count > DM_MAX_MEMBERS) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!members[i] || !members[i]->queue) {
+            kerr("DM: %s: Member %u is not a registered block device\n", name, i);
+            return NULL;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (members[j] == members[i]) {
+                kerr("DM: %s: %s used twice\n", name, members[i]->name);
+                return NULL;
+            }
+        }
+    }
+
+    dm_device_t *dm = (dm_device_t *)kzalloc(sizeof(dm_device_t));
+    if (!dm) {
+        return NULL;
+    }
+
+    dm->target = target;
+    dm->nr_members = count;
+    for (uint32_t i = 0; i < count; i++) {
+        dm->members[i].device = members[i];
+    }
+    return dm;
+}
+
+/**
+ * Get the largest logical block size among a mapped device's members
+ */
+static uint32_t dm_logical_block_size(dm_device_t *dm) {
+    uint32_t lbs = BLOCK_SECTOR_SIZE;
+    for (uint32_t i = 0; i < dm->nr_members; i++) {
+        uint32_t member = dm->members[i].device->queue->logical_block_size;
+        if (member > lbs) {
+            lbs = member;
+        }
+    }
+    return lbs;
+}
+
+/**
+ * Register a mapped device and derive its queue limits from its members
+ * @return 0 on success, negative on error
+ */
+static int dm_register(dm_device_t *dm, const char *name, uint64_t sectors) {
+    int slot = -1;
+    for (int i = 0; i < DM_MAX_DEVICES; i++) {
+        if (!dm_devices[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        kerr("DM: %s: Too many mapped devices\n", name);
+        return -1;
+    }
+
+    uint32_t lbs = dm_logical_block_size(dm);
+    strncpy(dm->block.name, name, sizeof(dm->block.name) - 1);
+    dm->block.size = sectors * BLOCK_SECTOR_SIZE;
+    dm->block.block_size = lbs;
+    dm->block.private_data = dm;
+    dm->block.ops = &dm_ops;
+    if (block_device_register(&dm->block) < 0) {
+        return -1;
+    }
+
+    request_queue_t *q = dm->block.queue;
+    q->logical_block_size = lbs;
+    q->max_discard_sectors = BLK_MAX_DATALESS_SECTORS;
+    q->max_write_zeroes_sectors = BLK_MAX_DATALESS_SECTORS;
+    q->discard_granularity = lbs;
+
+    uint32_t max_sectors = UINT32_MAX;
+    uint32_t max_segments = UINT16_MAX;
+    for (uint32_t i = 0; i < dm->nr_members; i++) {
+        request_queue_t *mq = dm->members[i].device->queue;
+        if (mq->max_sectors < max_sectors) {
+            max_sectors = mq->max_sectors;
+        }
+        if (mq->max_segments < max_segments) {
+            max_segments = mq->max_segments;
+        }
+        q->virt_boundary |= mq->virt_boundary;
+        q->write_cache |= mq->write_cache;
+
+        /* Discards are only worth sending if every member takes them */
+        if (!mq->max_discard_sectors) {
+            q->max_discard_sectors = 0;
+        }
+        if (!mq->max_write_zeroes_sectors) {
+            q->max_write_zeroes_sectors = 0;
+        }
+        if (mq->discard_granularity > q->discard_granularity) {
+            q->discard_granularity = mq->discard_granularity;
+        }
+    }
+
+    /* Bios are split per member anyway; a full stripe keeps them all busy */
+    if (dm->target == DM_TARGET_STRIPED) {
+        uint64_t stripe = (uint64_t)dm->chunk_sectors * dm->nr_members;
+        max_sectors = stripe < BLK_MAX_DATALESS_SECTORS ? (uint32_t)stripe : BLK_MAX_DATALESS_SECTORS;
+        max_segments = (uint32_t)max_segments * dm->nr_members < UINT16_MAX ?
+                       max_segments * dm->nr_members : UINT16_MAX;
+    }
+    q->max_sectors = max_sectors;
+    q->max_segments = (uint16_t)max_segments;
+
+    dm_devices[slot] = dm;
+    return 0;
+}
+
+/**
+ * Create a device that concatenates its members
+ * @param name Name of the new device
+ * @param members Underlying devices, in order
+ * @param count Number of members
+ * @return The registered device, or NULL on failure
+ */
+block_device_t *dm_create_linear(const char *name, block_device_t **members, uint32_t count) {
+    dm_device_t *dm = dm_alloc(name, members, count, DM_TARGET_LINEAR);
+    if (!dm) {
+        return NULL;
+    }
+
+    /* Each member contributes whole logical blocks of the mapped device */
+    uint32_t lbs_sectors = dm_logical_block_size(dm) / BLOCK_SECTOR_SIZE;
+    uint64_t sectors = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        dm_member_t *m = &dm->members[i];
+        m->start = sectors;
+        m->sectors = m->device->size / BLOCK_SECTOR_SIZE / lbs_sectors * lbs_sectors;
+        sectors += m->sectors;
+    }
+
+    if (sectors == 0 || dm_register(dm, name, sectors) < 0) {
+        kfree(dm);
+        return NULL;
+    }
+
+    kprintf("DM: %s: linear over %u devices, %lu MiB\n",
+            name, count, dm->block.size / (1024 * 1024));
+    return &dm->block;
+}
+
+/**
+ * Create a device that stripes its members (RAID-0)
+ * @param name Name of the new device
+ * @param members Underlying devices
+ * @param count Number of members
+ * @param chunk_size Stripe chunk in bytes, a multiple of every member's
+ *                   logical block size (0 for DM_DEFAULT_CHUNK_SIZE)
+ * @return The registered device, or NULL on failure
+ */
+block_device_t *dm_create_striped(const char *name, block_device_t **members, uint32_t count,
+                                  uint32_t chunk_size) {
+    dm_device_t *dm = dm_alloc(name, members, count, DM_TARGET_STRIPED);
+    if (!dm) {
+        return NULL;
+    }
+
+    if (chunk_size == 0) {
+        chunk_size = DM_DEFAULT_CHUNK_SIZE;
+    }
+    if (chunk_size % dm_logical_block_size(dm)) {
+        kerr("DM: %s: Chunk size %u is not a multiple of the logical block size\n",
+             name, chunk_size);
+        kfree(dm);
+        return NULL;
+    }
+    dm->chunk_sectors = chunk_size / BLOCK_SECTOR_SIZE;
+
+    /* Every member holds as many whole chunks as the smallest one */
+    uint64_t chunks = UINT64_MAX;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t member = dm->members[i].device->size / chunk_size;
+        if (member < chunks) {
+            chunks = member;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        dm->members[i].sectors = chunks * dm->chunk_sectors;
+    }
+
+    uint64_t sectors = chunks * dm->chunk_sectors * count;
+    if (sectors == 0 || dm_register(dm, name, sectors) < 0) {
+        kfree(dm);
+        return NULL;
+    }
+
+    kprintf("DM: %s: striped over %u devices, %u KiB chunks, %lu MiB\n",
+            name, count, chunk_size / 1024, dm->block.size / (1024 * 1024));
+    return &dm->block;
+}
+
+/**
+ * Look up the mapped device behind a block device
+ */
+static int dm_find(block_device_t *device) {
+    for (int i = 0; i < DM_MAX_DEVICES; i++) {
+        if (dm_devices[i] && &dm_devices[i]->block == device) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Unregister and free a mapped device; it must have no I/O in flight
+ * @param device Device returned by dm_create_*
+ * @return 0 on success, negative if it is not a mapped device
+ */
+int dm_remove(block_device_t *device) {
+    int slot = dm_find(device);
+    if (slot < 0) {
+        return -1;
+    }
+
+    dm_device_t *dm = dm_devices[slot];
+    dm_devices[slot] = NULL;
+    block_device_unregister(&dm->block);
+    kfree(dm);
+    return 0;
+}
+
+/**
+ * Print how a mapped device spread its I/O over its members
+ * @param device Device returned by dm_create_*
+ */
+void dm_print_stats(block_device_t *device) {
+    int slot = dm_find(device);
+    if (slot < 0) {
+        return;
+    }
+
+    dm_device_t *dm = dm_devices[slot];
+    uint64_t reads = 0;
+    for (uint32_t i = 0; i < dm->nr_members; i++) {
+        reads += dm->members[i].reads;
+    }
+
+    kprintf("DM: %s: %lu bios, %lu split, %lu member bios\n",
+            device->name, dm->bios, dm->splits, dm->clones);
+    for (uint32_t i = 0; i < dm->nr_members; i++) {
+        dm_member_t *m = &dm->members[i];
+        kprintf("DM: %s: %s: %lu reads (%lu%%) %lu KiB, %lu writes %lu KiB, %lu other, %lu errors\n",
+                device->name, m->device->name, m->reads, reads ? m->reads * 100 / reads : 0,
+                m->read_sectors * BLOCK_SECTOR_SIZE / 1024, m->writes,
+                m->write_sectors * BLOCK_SECTOR_SIZE / 1024, m->others, m->errors);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Device mapper: block devices built from ranges of other block devices
+ */
+
+#ifndef _DRIVERS_BLOCK_DM_H
+#define _DRIVERS_BLOCK_DM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/block.h>
+
+/* Maximum number of mapped devices and members per device */
+#define DM_MAX_DEVICES      4
+#define DM_MAX_MEMBERS      8
+
+/* Targets */
+#define DM_TARGET_LINEAR    0   /* Members concatenated end to end */
+#define DM_TARGET_STRIPED   1   /* Chunks dealt round-robin across members (RAID-0) */
+
+/* Chunk size used when a striped device is created with 0 */
+#define DM_DEFAULT_CHUNK_SIZE   (64 * 1024)
+
+struct request_queue;
+
+/* Member device and how much of the load it took */
+typedef struct dm_member {
+    block_device_t *device;     /* Underlying device */
+    uint64_t start;             /* First mapped sector it backs (linear) */
+    uint64_t sectors;           /* Sectors it contributes */
+
+    /* Statistics */
+    uint64_t reads;             /* Read bios sent to it */
+    uint64_t writes;            /* Write bios sent to it */
+    uint64_t read_sectors;      /* Sectors read from it */
+    uint64_t write_sectors;     /* Sectors written to it */
+    uint64_t others;            /* Flush, discard and write-zeroes bios */
+    uint64_t errors;            /* Bios it failed */
+} dm_member_t;
+
+/* Mapped device */
+typedef struct dm_device {
+    uint32_t target;            /* DM_TARGET_* */
+    uint32_t chunk_sectors;     /* Stripe chunk in sectors (striped) */
+    uint32_t nr_members;        /* Members in use */
+    dm_member_t members[DM_MAX_MEMBERS];
+
+    /* Statistics */
+    uint64_t bios;              /* Bios mapped */
+    uint64_t splits;            /* Bios that needed more than one member bio */
+    uint64_t clones;            /* Member bios issued */
+
+    block_device_t block;       /* Registered block device */
+} dm_device_t;
+
+/**
+ * Create a device that concatenates its members
+ * @param name Name of the new device
+ * @param members Underlying devices, in order
+ * @param count Number of members
+ * @return The registered device, or NULL on failure
+ */
+block_device_t *dm_create_linear(const char *name, block_device_t **members, uint32_t count);
+
+/**
+ * Create a device that stripes its members (RAID-0)
+ *
+ * Chunk n of the device is stored on member n % count. Every member
+ * contributes as many whole chunks as the smallest one holds.
+ * @param name Name of the new device
+ * @param members Underlying devices
+ * @param count Number of members
+ * @param chunk_size Stripe chunk in bytes, a multiple of every member's
+ *                   logical block size (0 for DM_DEFAULT_CHUNK_SIZE)
+ * @return The registered device, or NULL on failure
+ */
+block_device_t *dm_create_striped(const char *name, block_device_t **members, uint32_t count,
+                                  uint32_t chunk_size);
+
+/**
+ * Unregister and free a mapped device; it must have no I/O in flight
+ * @param device Device returned by dm_create_*
+ * @return 0 on success, negative if it is not a mapped device
+ */
+int dm_remove(block_device_t *device);
+
+/**
+ * Print how a mapped device spread its I/O over its members
+ * @param device Device returned by dm_create_*
+ */
+void dm_print_stats(block_device_t *device);
+
+#endif /* _DRIVERS_BLOCK_DM_H */
\ No newline at end of file
@@ -0,0 +1,307 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Pluggable I/O schedulers
+ *
+ * A multi-queue request queue either dispatches requests in submission
+ * order ("none") or hands them to a scheduler, which decides what the
+ * driver sees next whenever a driver tag frees up. Single-queue devices
+ * start with mq-deadline, the ones that care most about seek order;
+ * multi-queue devices start with none. Any queue can be switched at run
+ * time: the queue is drained first, so a scheduler never sees requests
+ * it did not insert.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <drivers/block/block.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/block/elevator.h>
+
+/* Known scheduler types */
+static const elevator_type_t *elevator_types[ELEVATOR_MAX_TYPES] = {
+    &mq_deadline_elevator,
+    &bfq_elevator
+};
+static int elevator_type_count = 2;
+
+/**
+ * Register an additional scheduler type
+ * @param type Scheduler; must stay valid while registered
+ * @return 0 on success, negative if the name is taken or the table is full
+ */
+int elevator_register(const elevator_type_t *type) {
+    if (!type || !type->name || !type->ops.insert || !type->ops.dispatch || !type->ops.has_work) {
+        return -1;
+    }
+    if (elevator_find(type->name) || strcmp(type->name, "none") == 0) {
+        kerr("BLOCK: I/O scheduler %s already registered\n", type->name);
+        return -1;
+    }
+    if (elevator_type_count >= ELEVATOR_MAX_TYPES) {
+        return -1;
+    }
+
+    elevator_types[elevator_type_count++] = type;
+    return 0;
+}
+
+/**
+ * Find a scheduler type by name
+ * @param name Scheduler name (e.g. "mq-deadline")
+ * @return The type, or NULL if none is registered under that name
+ */
+const elevator_type_t *elevator_find(const char *name) {
+    if (!name) {
+        return NULL;
+    }
+
+    for (int i = 0; i < elevator_type_count; i++) {
+        if (strcmp(elevator_types[i]->name, name) == 0) {
+            return elevator_types[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Tear down the scheduler state of the first count hardware queues
+ */
+static void elevator_exit_hctxs(request_queue_t *q, const elevator_type_t *type, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        if (type->ops.exit_hctx) {
+            type->ops.exit_hctx(&q->hctxs[i]);
+        }
+        q->hctxs[i].sched_data = NULL;
+    }
+}
+
+/**
+ * Attach a scheduler to an idle queue
+ * @return 0 on success, negative if a hardware queue could not be set up
+ */
+static int elevator_attach(request_queue_t *q, const elevator_type_t *type) {
+    if (type->ops.init_hctx) {
+        for (uint16_t i = 0; i < q->nr_hw_queues; i++) {
+            if (type->ops.init_hctx(&q->hctxs[i]) < 0) {
+                elevator_exit_hctxs(q, type, i);
+                return -1;
+            }
+        }
+    }
+
+    q->elevator = type;
+    return 0;
+}
+
+/**
+ * Pick the scheduler a newly created multi-queue request queue starts with
+ * @param q Queue
+ */
+void elevator_init_default(request_queue_t *q) {
+    if (!q->tag_set || q->nr_hw_queues != 1 ||
+        (q->tag_set->flags & BLK_MQ_F_NO_SCHED_BY_DEFAULT)) {
+        return;
+    }
+
+    if (elevator_attach(q, &mq_deadline_elevator) == 0) {
+        kprintf("BLOCK: %s: I/O scheduler %s\n", q->device->name, mq_deadline_elevator.name);
+    }
+}
+
+/**
+ * Tear down a queue's scheduler; the queue must be idle
+ * @param q Queue
+ */
+void elevator_exit(request_queue_t *q) {
+    const elevator_type_t *type = q->elevator;
+    if (!type) {
+        return;
+    }
+
+    q->elevator = NULL;
+    elevator_exit_hctxs(q, type, q->nr_hw_queues);
+}
+
+/**
+ * Switch a queue to another scheduler, draining it first
+ * @param q Queue
+ * @param name Scheduler name, or "none" to dispatch in submission order
+ * @return 0 on success, negative on error
+ */
+int elevator_switch(request_queue_t *q, const char *name) {
+    /* Queues on the synchronous compatibility path never hold requests back */
+    if (!q || !q->tag_set || !name) {
+        return -1;
+    }
+
+    const elevator_type_t *type = NULL;
+    if (strcmp(name, "none") != 0) {
+        type = elevator_find(name);
+        if (!type) {
+            kerr("BLOCK: %s: Unknown I/O scheduler %s\n", q->device->name, name);
+            return -1;
+        }
+    }
+    if (type == q->elevator) {
+        return 0;
+    }
+
+    /* Our own plugged requests would otherwise arrive after the switch */
+    blk_flush_plug();
+    blk_mq_drain_queue(q);
+
+    elevator_exit(q);
+    if (type && elevator_attach(q, type) < 0) {
+        kerr("BLOCK: %s: Failed to start I/O scheduler %s\n", q->device->name, type->name);
+        return -1;
+    }
+
+    kprintf("BLOCK: %s: I/O scheduler %s\n", q->device->name, elevator_name(q));
+    return 0;
+}
+
+/**
+ * Get the name of a queue's scheduler
+ * @param q Queue
+ * @return Scheduler name, "none" if there is none
+ */
+const char *elevator_name(request_queue_t *q) {
+    return q && q->elevator ? q->elevator->name : "none";
+}
+
+/**
+ * Format the schedulers a queue can use, current one in brackets
+ * @param q Queue
+ * @param buffer Output buffer
+ * @param size Size of the buffer
+ * @return Length of the string written
+ */
+size_t elevator_list(request_queue_t *q, char *buffer, size_t size) {
+    if (!buffer || size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+    if (!q || !q->tag_set) {
+        return 0;
+    }
+
+    size_t len = 0;
+    for (int i = -1; i < elevator_type_count && len < size; i++) {
+        const elevator_type_t *type = i < 0 ? NULL : elevator_types[i];
+        const char *name = type ? type->name : "none";
+        const char *fmt = type == q->elevator ? "%s[%s]" : "%s%s";
+        int written = ksnprintf(buffer + len, size - len, fmt, len ? " " : "", name);
+        if (written < 0) {
+            break;
+        }
+        len += (size_t)written;
+    }
+
+    return len < size ? len : size - 1;
+}
+
+/**
+ * Insert a request into a list kept sorted by sector
+ */
+void elv_sort_add(elv_list_t *list, request_t *rq) {
+    /* Most requests arrive in ascending order, so search from the tail */
+    request_t *prev = list->tail;
+    while (prev && prev->sector > rq->sector) {
+        prev = prev->sort_prev;
+    }
+
+    rq->sort_prev = prev;
+    rq->sort_next = prev ? prev->sort_next : list->head;
+    if (rq->sort_next) {
+        rq->sort_next->sort_prev = rq;
+    } else {
+        list->tail = rq;
+    }
+    if (prev) {
+        prev->sort_next = rq;
+    } else {
+        list->head = rq;
+    }
+}
+
+/**
+ * Remove a request from a sector-sorted list
+ */
+void elv_sort_del(elv_list_t *list, request_t *rq) {
+    if (rq->sort_prev) {
+        rq->sort_prev->sort_next = rq->sort_next;
+    } else {
+        list->head = rq->sort_next;
+    }
+    if (rq->sort_next) {
+        rq->sort_next->sort_prev = rq->sort_prev;
+    } else {
+        list->tail = rq->sort_prev;
+    }
+    rq->sort_prev = NULL;
+    rq->sort_next = NULL;
+}
+
+/**
+ * Find the first request at or after a sector in a sorted list
+ * @return The request, or NULL if all lie before the sector
+ */
+request_t *elv_sort_find(elv_list_t *list, uint64_t sector) {
+    request_t *rq = list->head;
+    while (rq && rq->sector < sector) {
+        rq = rq->sort_next;
+    }
+    return rq;
+}
+
+/**
+ * Append a request to an arrival-ordered list
+ */
+void elv_fifo_add(elv_list_t *list, request_t *rq) {
+    rq->fifo_next = NULL;
+    rq->fifo_prev = list->tail;
+    if (list->tail) {
+        list->tail->fifo_next = rq;
+    } else {
+        list->head = rq;
+    }
+    list->tail = rq;
+}
+
+/**
+ * Remove a request from an arrival-ordered list
+ */
+void elv_fifo_del(elv_list_t *list, request_t *rq) {
+    if (rq->fifo_prev) {
+        rq->fifo_prev->fifo_next = rq->fifo_next;
+    } else {
+        list->head = rq->fifo_next;
+    }
+    if (rq->fifo_next) {
+        rq->fifo_next->fifo_prev = rq->fifo_prev;
+    } else {
+        list->tail = rq->fifo_prev;
+    }
+    rq->fifo_prev = NULL;
+    rq->fifo_next = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Pluggable I/O schedulers
+ */
+
+#ifndef _DRIVERS_BLOCK_ELEVATOR_H
+#define _DRIVERS_BLOCK_ELEVATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_mq.h>
+
+/* Registered scheduler types, including the built-in ones */
+#define ELEVATOR_MAX_TYPES      8
+
+/*
+ * Scheduler hooks. Each hardware queue gets its own instance in
+ * hctx->sched_data; the block layer calls the hooks with interrupts
+ * disabled, so instances need no locking of their own.
+ */
+typedef struct elevator_ops {
+    /* Allocate per-hardware-queue state into hctx->sched_data */
+    int (*init_hctx)(blk_mq_hw_ctx_t *hctx);
+    /* Release it; the queue is idle */
+    void (*exit_hctx)(blk_mq_hw_ctx_t *hctx);
+    /* Take ownership of a request that has no driver tag yet */
+    void (*insert)(blk_mq_hw_ctx_t *hctx, request_t *rq);
+    /* Pick the next request to send to the driver, or NULL to hold back */
+    request_t *(*dispatch)(blk_mq_hw_ctx_t *hctx);
+    /* Check whether dispatch has something to return */
+    bool (*has_work)(blk_mq_hw_ctx_t *hctx);
+    /* A request the scheduler tagged through elv_priv finished (optional) */
+    void (*completed)(blk_mq_hw_ctx_t *hctx, request_t *rq);
+} elevator_ops_t;
+
+/* A scheduler implementation */
+typedef struct elevator_type {
+    const char *name;           /* Name used to select it */
+    elevator_ops_t ops;
+} elevator_type_t;
+
+/* Built-in schedulers */
+extern const elevator_type_t mq_deadline_elevator;
+extern const elevator_type_t bfq_elevator;
+
+/**
+ * Register an additional scheduler type
+ * @param type Scheduler; must stay valid while registered
+ * @return 0 on success, negative if the name is taken or the table is full
+ */
+int elevator_register(const elevator_type_t *type);
+
+/**
+ * Find a scheduler type by name
+ * @param name Scheduler name (e.g. "mq-deadline")
+ * @return The type, or NULL if none is registered under that name
+ */
+const elevator_type_t *elevator_find(const char *name);
+
+/**
+ * Pick the scheduler a newly created multi-queue request queue starts with
+ * @param q Queue
+ */
+void elevator_init_default(request_queue_t *q);
+
+/**
+ * Switch a queue to another scheduler, draining it first
+ * @param q Queue
+ * @param name Scheduler name, or "none" to dispatch in submission order
+ * @return 0 on success, negative on error
+ */
+int elevator_switch(request_queue_t *q, const char *name);
+
+/**
+ * Tear down a queue's scheduler; the queue must be idle
+ * @param q Queue
+ */
+void elevator_exit(request_queue_t *q);
+
+/**
+ * Get the name of a queue's scheduler
+ * @param q Queue
+ * @return Scheduler name, "none" if there is none
+ */
+const char *elevator_name(request_queue_t *q);
+
+/**
+ * Format the schedulers a queue can use, current one in brackets
+ * @param q Queue
+ * @param buffer Output buffer
+ * @param size Size of the buffer
+ * @return Length of the string written
+ */
+size_t elevator_list(request_queue_t *q, char *buffer, size_t size);
+
+/* Request list helpers shared by the schedulers */
+typedef struct elv_list {
+    request_t *head;
+    request_t *tail;
+} elv_list_t;
+
+/**
+ * Insert a request into a list kept sorted by sector
+ */
+void elv_sort_add(elv_list_t *list, request_t *rq);
+
+/**
+ * Remove a request from a sector-sorted list
+ */
+void elv_sort_del(elv_list_t *list, request_t *rq);
+
+/**
+ * Find the first request at or after a sector in a sorted list
+ * @return The request, or NULL if all lie before the sector
+ */
+request_t *elv_sort_find(elv_list_t *list, uint64_t sector);
+
+/**
+ * Append a request to an arrival-ordered list
+ */
+void elv_fifo_add(elv_list_t *list, request_t *rq);
+
+/**
+ * Remove a request from an arrival-ordered list
+ */
+void elv_fifo_del(elv_list_t *list, request_t *rq);
+
+#endif /* _DRIVERS_BLOCK_ELEVATOR_H */
\ No newline at end of file
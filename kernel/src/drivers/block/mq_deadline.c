@@ -0,0 +1,148 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * mq-deadline I/O scheduler
+ *
+ * Reads and writes each sit in two lists: one sorted by sector and one in
+ * arrival order, with a deadline per request. Dispatch sweeps upwards
+ * through the sorted list in batches, preferring reads; writes get a turn
+ * after they have been passed over a few times, and whenever the oldest
+ * request of a direction expires the sweep restarts from it. Sorting keeps
+ * seeks short while the deadlines bound how long any request can starve.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/time.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/block/elevator.h>
+#include <mm/kmalloc.h>
+
+/* Tunables */
+#define DD_READ_EXPIRE_NS       (500ULL * 1000000ULL)   /* Read deadline */
+#define DD_WRITE_EXPIRE_NS      (5000ULL * 1000000ULL)  /* Write deadline */
+#define DD_WRITES_STARVED       2       /* Read batches a write may sit out */
+#define DD_FIFO_BATCH           16      /* Requests dispatched per sorted sweep */
+
+/* Directions; anything that is not a read is scheduled with the writes */
+#define DD_READ                 0
+#define DD_WRITE                1
+
+typedef struct dd_data {
+    elv_list_t sort[2];         /* Requests by sector */
+    elv_list_t fifo[2];         /* Requests by arrival, with deadlines */
+    request_t *next_rq[2];      /* Continuation of the current sweep */
+    uint32_t batching;          /* Requests dispatched in this sweep */
+    uint32_t starved;           /* Read sweeps started while writes waited */
+} dd_data_t;
+
+static inline int dd_dir(request_t *rq) {
+    return rq->op == BIO_OP_READ ? DD_READ : DD_WRITE;
+}
+
+static int dd_init_hctx(blk_mq_hw_ctx_t *hctx) {
+    hctx->sched_data = kzalloc(sizeof(dd_data_t));
+    return hctx->sched_data ? 0 : -1;
+}
+
+static void dd_exit_hctx(blk_mq_hw_ctx_t *hctx) {
+    kfree(hctx->sched_data);
+}
+
+static void dd_insert(blk_mq_hw_ctx_t *hctx, request_t *rq) {
+    dd_data_t *dd = (dd_data_t *)hctx->sched_data;
+    int dir = dd_dir(rq);
+
+    rq->deadline_ns = time_now_ns() + (dir == DD_READ ? DD_READ_EXPIRE_NS : DD_WRITE_EXPIRE_NS);
+    elv_sort_add(&dd->sort[dir], rq);
+    elv_fifo_add(&dd->fifo[dir], rq);
+}
+
+static bool dd_has_work(blk_mq_hw_ctx_t *hctx) {
+    dd_data_t *dd = (dd_data_t *)hctx->sched_data;
+    return dd->fifo[DD_READ].head || dd->fifo[DD_WRITE].head;
+}
+
+/**
+ * Check whether the oldest request of a direction is past its deadline
+ */
+static inline bool dd_fifo_expired(dd_data_t *dd, int dir) {
+    request_t *rq = dd->fifo[dir].head;
+    return rq && time_now_ns() >= rq->deadline_ns;
+}
+
+/**
+ * Take a request off both lists and continue the sweep after it
+ */
+static request_t *dd_move_request(dd_data_t *dd, request_t *rq) {
+    int dir = dd_dir(rq);
+
+    dd->next_rq[DD_READ] = NULL;
+    dd->next_rq[DD_WRITE] = NULL;
+    dd->next_rq[dir] = rq->sort_next;
+
+    elv_sort_del(&dd->sort[dir], rq);
+    elv_fifo_del(&dd->fifo[dir], rq);
+    dd->batching++;
+    return rq;
+}
+
+static request_t *dd_dispatch(blk_mq_hw_ctx_t *hctx) {
+    dd_data_t *dd = (dd_data_t *)hctx->sched_data;
+
+    /* Keep sweeping in the current direction until the batch is used up */
+    request_t *rq = dd->next_rq[DD_WRITE] ? dd->next_rq[DD_WRITE] : dd->next_rq[DD_READ];
+    if (rq && dd->batching < DD_FIFO_BATCH) {
+        return dd_move_request(dd, rq);
+    }
+
+    bool reads = dd->fifo[DD_READ].head != NULL;
+    bool writes = dd->fifo[DD_WRITE].head != NULL;
+    int dir;
+
+    if (reads && !(writes && dd->starved++ >= DD_WRITES_STARVED)) {
+        dir = DD_READ;
+    } else if (writes) {
+        dd->starved = 0;
+        dir = DD_WRITE;
+    } else {
+        return NULL;
+    }
+
+    /* Start a new sweep, from the oldest request if it has run out of time */
+    rq = dd->next_rq[dir];
+    if (!rq || dd_fifo_expired(dd, dir)) {
+        rq = dd->fifo[dir].head;
+    }
+    dd->batching = 0;
+    return dd_move_request(dd, rq);
+}
+
+const elevator_type_t mq_deadline_elevator = {
+    .name = "mq-deadline",
+    .ops = {
+        .init_hctx = dd_init_hctx,
+        .exit_hctx = dd_exit_hctx,
+        .insert = dd_insert,
+        .dispatch = dd_dispatch,
+        .has_work = dd_has_work
+    }
+};
\ No newline at end of file
@@ -0,0 +1,878 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * NVMe block device driver
+ *
+ * Every CPU owns a submission/completion queue pair with its own MSI-X
+ * vector, exposed to blk-mq as one hardware queue whose tags are the
+ * command IDs. Commands dispatched together are published with a single
+ * doorbell write; completions are reaped either from the queue's
+ * interrupt or by polling the completion queue.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/barrier.h>
+#include <arch/x86/include/idt.h>
+#include <arch/x86/include/lapic.h>
+#include <drivers/driversys.h>
+#include <drivers/pci/pci.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/block/nvme.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/* Admin command timeout */
+#define NVME_ADMIN_TIMEOUT_MS   5000
+
+static int nvme_probe_driver(device_driver_t *driver);
+static int nvme_remove_driver(device_driver_t *driver);
+
+static int nvme_read(block_device_t *device, uint64_t offset, size_t size, void *buffer);
+static int nvme_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer);
+static int nvme_ioctl(block_device_t *device, unsigned int cmd, void *arg);
+
+static int nvme_queue_rq(blk_mq_hw_ctx_t *hctx, request_t *rq, bool last);
+static void nvme_commit_rqs(blk_mq_hw_ctx_t *hctx);
+static uint32_t nvme_poll(blk_mq_hw_ctx_t *hctx);
+static int nvme_init_hctx(blk_mq_hw_ctx_t *hctx, void *driver_data, uint16_t index);
+
+/* Define the NVMe driver */
+static driver_ops_t nvme_driver_ops = {
+    .probe = nvme_probe_driver,
+    .remove = nvme_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t nvme_driver = {
+    .name = "nvme",
+    .device_class = DEVICE_CLASS_STORAGE,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &nvme_driver_ops,
+    .private_data = NULL
+};
+
+static block_device_ops_t nvme_ops = {
+    .read = nvme_read,
+    .write = nvme_write,
+    .ioctl = nvme_ioctl
+};
+
+static const blk_mq_ops_t nvme_mq_ops = {
+    .queue_rq = nvme_queue_rq,
+    .commit_rqs = nvme_commit_rqs,
+    .poll = nvme_poll,
+    .init_hctx = nvme_init_hctx
+};
+
+/* Driven controllers */
+static nvme_ctrl_t *nvme_controllers[NVME_MAX_CONTROLLERS];
+static int nvme_count = 0;
+
+static inline uint32_t nvme_read32(nvme_ctrl_t *ctrl, uint32_t reg) {
+    return *(volatile uint32_t *)(ctrl->regs + reg);
+}
+
+static inline void nvme_write32(nvme_ctrl_t *ctrl, uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)(ctrl->regs + reg) = value;
+}
+
+static inline uint64_t nvme_read64(nvme_ctrl_t *ctrl, uint32_t reg) {
+    return nvme_read32(ctrl, reg) | ((uint64_t)nvme_read32(ctrl, reg + 4) << 32);
+}
+
+static inline void nvme_write64(nvme_ctrl_t *ctrl, uint32_t reg, uint64_t value) {
+    nvme_write32(ctrl, reg, (uint32_t)value);
+    nvme_write32(ctrl, reg + 4, (uint32_t)(value >> 32));
+}
+
+/**
+ * Wait for CSTS.RDY to reach a value
+ * @return 0 on success, negative on timeout or controller fatal status
+ */
+static int nvme_wait_ready(nvme_ctrl_t *ctrl, bool ready) {
+    uint64_t deadline = time_now_ns() + (uint64_t)ctrl->timeout_ms * 1000000ULL;
+
+    for (;;) {
+        uint32_t csts = nvme_read32(ctrl, NVME_REG_CSTS);
+        if (csts & NVME_CSTS_CFS) {
+            return -1;
+        }
+        if (((csts & NVME_CSTS_RDY) != 0) == ready) {
+            return 0;
+        }
+        if (time_now_ns() > deadline) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * Allocate the memory of a queue pair
+ */
+static int nvme_queue_init(nvme_ctrl_t *ctrl, nvme_queue_t *q, uint16_t qid, uint16_t depth) {
+    memset(q, 0, sizeof(*q));
+    q->ctrl = ctrl;
+    q->qid = qid;
+    q->depth = depth;
+    q->cq_phase = 1;
+    q->vector = -1;
+
+    q->sq = (nvme_sqe_t *)pmm_alloc_dma((depth * sizeof(nvme_sqe_t) + PAGE_SIZE - 1) / PAGE_SIZE,
+                                        &q->sq_phys);
+    q->cq = (volatile nvme_cqe_t *)pmm_alloc_dma((depth * sizeof(nvme_cqe_t) + PAGE_SIZE - 1) / PAGE_SIZE,
+                                                 &q->cq_phys);
+    q->requests = (nvme_request_t *)kzalloc(depth * sizeof(nvme_request_t));
+    q->free_cids = (uint16_t *)kmalloc(depth * sizeof(uint16_t));
+    if (!q->sq || !q->cq || !q->requests || !q->free_cids) {
+        return -1;
+    }
+
+    /* One slot stays empty so a full queue can be told from an empty one */
+    for (uint16_t i = 0; i < depth - 1; i++) {
+        q->free_cids[q->free_count++] = depth - 2 - i;
+    }
+
+    q->sq_doorbell = (volatile uint32_t *)(ctrl->regs + NVME_REG_DOORBELL +
+                                           (2 * qid) * ctrl->doorbell_stride);
+    q->cq_doorbell = (volatile uint32_t *)(ctrl->regs + NVME_REG_DOORBELL +
+                                           (2 * qid + 1) * ctrl->doorbell_stride);
+    return 0;
+}
+
+static inline int nvme_get_cid(nvme_queue_t *q) {
+    if (q->free_count == 0) {
+        return -1;
+    }
+    return q->free_cids[--q->free_count];
+}
+
+static inline void nvme_put_cid(nvme_queue_t *q, uint16_t cid) {
+    q->free_cids[q->free_count++] = cid;
+}
+
+/**
+ * Copy a command into the submission queue without ringing the doorbell
+ */
+static void nvme_submit(nvme_queue_t *q, nvme_sqe_t *sqe, uint16_t cid) {
+    nvme_request_t *req = &q->requests[cid];
+    req->done = false;
+    req->status = 0;
+    req->result = 0;
+
+    sqe->cid = cid;
+    memcpy(&q->sq[q->sq_tail], sqe, sizeof(nvme_sqe_t));
+    q->sq_tail = (q->sq_tail + 1) % q->depth;
+    q->submitted++;
+}
+
+/**
+ * Publish all queued commands with one doorbell write
+ */
+static void nvme_commit(nvme_queue_t *q) {
+    if (q->sq_tail == q->sq_published) {
+        return;
+    }
+
+    wmb();
+    *q->sq_doorbell = q->sq_tail;
+    q->sq_published = q->sq_tail;
+    q->doorbells++;
+}
+
+/**
+ * Reap completions, updating the head doorbell once per batch
+ * @return Number of completions processed
+ */
+static uint32_t nvme_process_cq(nvme_queue_t *q) {
+    uint32_t count = 0;
+
+    for (;;) {
+        volatile nvme_cqe_t *cqe = &q->cq[q->cq_head];
+        uint16_t status = cqe->status;
+        if ((status & 1) != q->cq_phase) {
+            break;
+        }
+
+        /* Read the rest of the entry only after its phase tag */
+        rmb();
+
+        uint16_t cid = cqe->cid;
+        if (cid < q->depth) {
+            nvme_request_t *req = &q->requests[cid];
+            req->status = status >> 1;
+            req->result = cqe->result;
+            if (req->status) {
+                q->errors++;
+            }
+            if (q->hctx) {
+                /* I/O command IDs are blk-mq tags */
+                blk_mq_complete_request(blk_mq_tag_to_rq(q->hctx, cid), req->status ? -1 : 0);
+            } else {
+                req->done = true;
+            }
+        }
+
+        if (++q->cq_head == q->depth) {
+            q->cq_head = 0;
+            q->cq_phase ^= 1;
+        }
+        count++;
+    }
+
+    if (count) {
+        *q->cq_doorbell = q->cq_head;
+        q->completed += count;
+    }
+    return count;
+}
+
+/**
+ * Per-queue interrupt handler
+ */
+static void nvme_irq(uint8_t vector, void *data) {
+    nvme_queue_t *q = (nvme_queue_t *)data;
+    q->interrupts++;
+    nvme_process_cq(q);
+}
+
+/**
+ * Run an admin command synchronously
+ * @param ctrl Controller
+ * @param sqe Command
+ * @param result Output for the command-specific result (may be NULL)
+ * @return 0 on success, negative on error or timeout
+ */
+static int nvme_admin_cmd(nvme_ctrl_t *ctrl, nvme_sqe_t *sqe, uint32_t *result) {
+    nvme_queue_t *q = &ctrl->admin;
+    int cid = nvme_get_cid(q);
+    if (cid < 0) {
+        return -1;
+    }
+
+    nvme_request_t *req = &q->requests[cid];
+    nvme_submit(q, sqe, (uint16_t)cid);
+    nvme_commit(q);
+
+    uint64_t deadline = time_now_ns() + NVME_ADMIN_TIMEOUT_MS * 1000000ULL;
+    while (!req->done) {
+        nvme_process_cq(q);
+        if (!req->done && time_now_ns() > deadline) {
+            kerr("NVME: Admin command 0x%x timed out\n", sqe->opcode);
+            return -1;
+        }
+    }
+
+    nvme_put_cid(q, (uint16_t)cid);
+    if (req->status) {
+        kerr("NVME: Admin command 0x%x failed, status 0x%x\n", sqe->opcode, req->status);
+        return -1;
+    }
+    if (result) {
+        *result = req->result;
+    }
+    return 0;
+}
+
+/**
+ * Point a command at a request's segments, using an SGL when the controller
+ * takes one and a PRP list otherwise. Pages are used in place, without
+ * copying; in PRP mode the queue's virt_boundary limit guarantees every
+ * segment after the first starts a page and every one before the last
+ * ends one.
+ * @return 0 on success, negative on error
+ */
+static int nvme_map_rq(nvme_ctrl_t *ctrl, nvme_request_t *req, nvme_sqe_t *sqe, request_t *rq) {
+    bio_vec_t *first = &rq->bio->vecs[0];
+    uint64_t first_phys = virt_to_phys(bio_vec_addr(first));
+
+    if (rq->nr_segments == 1) {
+        /* Fits in one page: no list needed either way */
+        if (ctrl->sgl) {
+            nvme_sgl_desc_t desc = { .addr = first_phys, .length = first->len, .type = NVME_SGL_DATA_BLOCK };
+            sqe->flags |= NVME_CMD_FLAGS_SGL;
+            memcpy(&sqe->prp1, &desc, sizeof(desc));
+        } else {
+            sqe->prp1 = first_phys;
+            sqe->prp2 = 0;
+        }
+        return 0;
+    }
+
+    if (!req->list) {
+        req->list = pmm_alloc_dma(1, &req->list_phys);
+        if (!req->list) {
+            return -1;
+        }
+    }
+
+    if (ctrl->sgl) {
+        /* One data block descriptor per physically contiguous run */
+        nvme_sgl_desc_t *list = (nvme_sgl_desc_t *)req->list;
+        size_t max = PAGE_SIZE / sizeof(nvme_sgl_desc_t);
+        size_t count = 0;
+
+        for (bio_t *bio = rq->bio; bio; bio = bio->next) {
+            for (uint16_t i = 0; i < bio->vcnt; i++) {
+                uint64_t addr = virt_to_phys(bio_vec_addr(&bio->vecs[i]));
+                uint32_t len = bio->vecs[i].len;
+
+                if (count && list[count - 1].addr + list[count - 1].length == addr) {
+                    list[count - 1].length += len;
+                    continue;
+                }
+                if (count == max) {
+                    return -1;
+                }
+                memset(&list[count], 0, sizeof(nvme_sgl_desc_t));
+                list[count].addr = addr;
+                list[count].length = len;
+                list[count].type = NVME_SGL_DATA_BLOCK;
+                count++;
+            }
+        }
+
+        nvme_sgl_desc_t desc;
+        memset(&desc, 0, sizeof(desc));
+        if (count == 1) {
+            desc = list[0];
+        } else {
+            desc.addr = req->list_phys;
+            desc.length = (uint32_t)(count * sizeof(nvme_sgl_desc_t));
+            desc.type = NVME_SGL_LAST_SEGMENT;
+        }
+        sqe->flags |= NVME_CMD_FLAGS_SGL;
+        memcpy(&sqe->prp1, &desc, sizeof(desc));
+        return 0;
+    }
+
+    /* PRP: the first entry may be offset, each later segment is a page start */
+    uint64_t *list = (uint64_t *)req->list;
+    size_t max = PAGE_SIZE / sizeof(uint64_t);
+    size_t entries = 0;
+    bool skip = true;
+
+    for (bio_t *bio = rq->bio; bio; bio = bio->next) {
+        for (uint16_t i = 0; i < bio->vcnt; i++) {
+            if (skip) {
+                skip = false;
+                continue;
+            }
+            if (entries == max) {
+                return -1;
+            }
+            list[entries++] = virt_to_phys(bio_vec_addr(&bio->vecs[i]));
+        }
+    }
+
+    sqe->prp1 = first_phys;
+    sqe->prp2 = entries == 1 ? list[0] : req->list_phys;
+    return 0;
+}
+
+/**
+ * Build a read or write command
+ */
+static void nvme_build_rw(nvme_ctrl_t *ctrl, nvme_sqe_t *sqe, uint8_t opcode,
+                          uint64_t lba, uint32_t blocks) {
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->nsid = ctrl->nsid;
+    sqe->cdw10 = (uint32_t)lba;
+    sqe->cdw11 = (uint32_t)(lba >> 32);
+    sqe->cdw12 = blocks - 1;
+}
+
+/**
+ * Bind a hardware queue to its I/O queue pair
+ */
+static int nvme_init_hctx(blk_mq_hw_ctx_t *hctx, void *driver_data, uint16_t index) {
+    nvme_ctrl_t *ctrl = (nvme_ctrl_t *)driver_data;
+    if (index >= ctrl->num_queues) {
+        return -1;
+    }
+    ctrl->queues[index].hctx = hctx;
+    hctx->driver_data = &ctrl->queues[index];
+    return 0;
+}
+
+/**
+ * Queue one request on a submission queue, using its tag as the command ID
+ * @param hctx Hardware queue
+ * @param rq Request
+ * @param last Ring the doorbell after queueing
+ * @return BLK_MQ_RQ_QUEUED, or negative on error
+ */
+static int nvme_queue_rq(blk_mq_hw_ctx_t *hctx, request_t *rq, bool last) {
+    nvme_queue_t *q = (nvme_queue_t *)hctx->driver_data;
+    nvme_ctrl_t *ctrl = q->ctrl;
+    uint16_t cid = (uint16_t)rq->tag;
+
+    nvme_sqe_t sqe;
+    uint64_t lba = rq->sector * BLOCK_SECTOR_SIZE / ctrl->lba_size;
+    uint32_t blocks = (uint32_t)((uint64_t)rq->nr_sectors * BLOCK_SECTOR_SIZE / ctrl->lba_size);
+
+    if (rq->op == BIO_OP_FLUSH) {
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = NVME_CMD_FLUSH;
+        sqe.nsid = ctrl->nsid;
+    } else if (rq->op == BIO_OP_DISCARD) {
+        /* The range list lives in the command's list page */
+        nvme_request_t *req = &q->requests[cid];
+        if (!req->list && !(req->list = pmm_alloc_dma(1, &req->list_phys))) {
+            return -1;
+        }
+        nvme_dsm_range_t *range = (nvme_dsm_range_t *)req->list;
+        range->cattr = 0;
+        range->nlb = blocks;
+        range->slba = lba;
+
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = NVME_CMD_DSM;
+        sqe.nsid = ctrl->nsid;
+        sqe.prp1 = req->list_phys;
+        sqe.cdw10 = 0;  /* One range */
+        sqe.cdw11 = NVME_DSM_AD;
+    } else if (rq->op == BIO_OP_WRITE_ZEROES) {
+        nvme_build_rw(ctrl, &sqe, NVME_CMD_WRITE_ZEROES, lba, blocks);
+    } else {
+        nvme_build_rw(ctrl, &sqe, rq->op == BIO_OP_READ ? NVME_CMD_READ : NVME_CMD_WRITE,
+                      lba, blocks);
+        if (rq->op_flags & BIO_REQ_FUA) {
+            sqe.cdw12 |= NVME_RW_FUA;
+        }
+        if (nvme_map_rq(ctrl, &q->requests[cid], &sqe, rq) < 0) {
+            return -1;
+        }
+    }
+
+    /* Tags never exceed depth - 1, so the submission queue cannot overflow */
+    nvme_submit(q, &sqe, cid);
+    if (last) {
+        nvme_commit(q);
+    }
+    return BLK_MQ_RQ_QUEUED;
+}
+
+/**
+ * Ring the doorbell for commands queued without last
+ */
+static void nvme_commit_rqs(blk_mq_hw_ctx_t *hctx) {
+    nvme_commit((nvme_queue_t *)hctx->driver_data);
+}
+
+/**
+ * Reap a queue pair's completions
+ */
+static uint32_t nvme_poll(blk_mq_hw_ctx_t *hctx) {
+    nvme_queue_t *q = (nvme_queue_t *)hctx->driver_data;
+    uint64_t flags = cpu_irq_save();
+    uint32_t count = nvme_process_cq(q);
+    cpu_irq_restore(flags);
+    return count;
+}
+
+static int nvme_read(block_device_t *device, uint64_t offset, size_t size, void *buffer) {
+    return bio_rw_bytes(device, BIO_OP_READ, offset, size, buffer);
+}
+
+static int nvme_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer) {
+    return bio_rw_bytes(device, BIO_OP_WRITE, offset, size, (void *)buffer);
+}
+
+/**
+ * Random read benchmark over every queue pair, reporting doorbell writes
+ */
+static int nvme_bench(nvme_ctrl_t *ctrl, block_bench_t *bench) {
+    uint64_t base_doorbells = 0;
+    for (uint16_t i = 0; i < ctrl->num_queues; i++) {
+        base_doorbells += ctrl->queues[i].doorbells;
+    }
+
+    int result = blk_mq_bench(ctrl->block.queue, bench);
+    if (result < 0) {
+        return result;
+    }
+
+    uint64_t doorbells = 0;
+    for (uint16_t i = 0; i < ctrl->num_queues; i++) {
+        doorbells += ctrl->queues[i].doorbells;
+    }
+
+    kprintf("NVME: %s: %lu doorbells over %u queue pair(s), %s completions\n",
+            ctrl->block.name, doorbells - base_doorbells, ctrl->num_queues,
+            ctrl->polled ? "polled" : "interrupt-driven");
+    return 0;
+}
+
+static int nvme_ioctl(block_device_t *device, unsigned int cmd, void *arg) {
+    if (!device) {
+        return -1;
+    }
+
+    nvme_ctrl_t *ctrl = (nvme_ctrl_t *)device->private_data;
+    switch (cmd) {
+        case BLOCK_IOCTL_BENCH:
+            if (!arg) {
+                return -1;
+            }
+            return nvme_bench(ctrl, (block_bench_t *)arg);
+        default:
+            return -1;
+    }
+}
+
+/**
+ * Check that MSI-X completions actually arrive, reading block 0 on queue 0
+ * @return true if the interrupt was delivered
+ */
+static bool nvme_check_interrupts(nvme_ctrl_t *ctrl) {
+    nvme_queue_t *q = &ctrl->queues[0];
+    uint64_t page_phys;
+    void *page = pmm_alloc_dma(1, &page_phys);
+    if (!page) {
+        return false;
+    }
+
+    /* The block device is not registered yet, so no blk-mq tag is in use */
+    uint64_t flags = cpu_irq_save();
+    uint16_t cid = 0;
+    nvme_request_t *req = &q->requests[cid];
+
+    nvme_sqe_t sqe;
+    nvme_build_rw(ctrl, &sqe, NVME_CMD_READ, 0, 1);
+    sqe.prp1 = page_phys;
+    nvme_submit(q, &sqe, cid);
+    nvme_commit(q);
+
+    /* Give the interrupt 100 ms to show up */
+    uint64_t deadline = time_now_ns() + 100000000ULL;
+    cpu_irq_enable();
+    while (!req->done && time_now_ns() < deadline) {
+        /* Spin */
+    }
+    cpu_irq_save();
+
+    bool delivered = req->done;
+    deadline = time_now_ns() + NVME_ADMIN_TIMEOUT_MS * 1000000ULL;
+    while (!req->done && time_now_ns() < deadline) {
+        nvme_process_cq(q);
+    }
+
+    cpu_irq_restore(flags);
+    pmm_free_dma(page, 1);
+    return delivered;
+}
+
+/**
+ * Create the I/O queue pairs
+ */
+static int nvme_create_io_queues(nvme_ctrl_t *ctrl, uint16_t wanted, uint16_t depth) {
+    nvme_sqe_t sqe;
+    uint32_t result;
+
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = NVME_ADMIN_SET_FEATURES;
+    sqe.cdw10 = NVME_FEATURE_NUM_QUEUES;
+    sqe.cdw11 = (uint32_t)(wanted - 1) | ((uint32_t)(wanted - 1) << 16);
+    if (nvme_admin_cmd(ctrl, &sqe, &result) < 0) {
+        return -1;
+    }
+
+    uint16_t granted_sq = (result & 0xFFFF) + 1;
+    uint16_t granted_cq = (result >> 16) + 1;
+    uint16_t count = wanted;
+    if (count > granted_sq) {
+        count = granted_sq;
+    }
+    if (count > granted_cq) {
+        count = granted_cq;
+    }
+
+    ctrl->queues = (nvme_queue_t *)kzalloc(count * sizeof(nvme_queue_t));
+    if (!ctrl->queues) {
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        nvme_queue_t *q = &ctrl->queues[i];
+        uint16_t qid = i + 1;
+
+        if (nvme_queue_init(ctrl, q, qid, depth) < 0) {
+            return -1;
+        }
+
+        /* Queue i belongs to CPU i; only the boot CPU's APIC is known today */
+        uint32_t cq_flags = 1;
+        if (!ctrl->polled) {
+            int vector = idt_alloc_vector(nvme_irq, q);
+            if (vector < 0 || pci_msix_set_vector(ctrl->pci, qid, (uint8_t)vector, lapic_id()) < 0) {
+                return -1;
+            }
+            q->vector = vector;
+            cq_flags |= 2 | ((uint32_t)qid << 16);
+        }
+
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = NVME_ADMIN_CREATE_CQ;
+        sqe.prp1 = q->cq_phys;
+        sqe.cdw10 = qid | ((uint32_t)(depth - 1) << 16);
+        sqe.cdw11 = cq_flags;
+        if (nvme_admin_cmd(ctrl, &sqe, NULL) < 0) {
+            return -1;
+        }
+
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = NVME_ADMIN_CREATE_SQ;
+        sqe.prp1 = q->sq_phys;
+        sqe.cdw10 = qid | ((uint32_t)(depth - 1) << 16);
+        sqe.cdw11 = 1 | ((uint32_t)qid << 16);
+        if (nvme_admin_cmd(ctrl, &sqe, NULL) < 0) {
+            return -1;
+        }
+
+        ctrl->num_queues++;
+    }
+
+    return 0;
+}
+
+/**
+ * Bring up one NVMe controller
+ */
+static int nvme_attach(pci_device_t *pci) {
+    if (nvme_count >= NVME_MAX_CONTROLLERS) {
+        return -1;
+    }
+
+    nvme_ctrl_t *ctrl = (nvme_ctrl_t *)kzalloc(sizeof(nvme_ctrl_t));
+    if (!ctrl) {
+        return -1;
+    }
+    ctrl->pci = pci;
+
+    ctrl->regs = (volatile uint8_t *)pci_map_bar(pci, 0);
+    if (!ctrl->regs) {
+        kfree(ctrl);
+        return -1;
+    }
+    pci_enable_bus_master(pci);
+
+    uint64_t cap = nvme_read64(ctrl, NVME_REG_CAP);
+    uint32_t mqes = (uint32_t)(cap & 0xFFFF) + 1;
+    ctrl->doorbell_stride = 4u << ((cap >> 32) & 0xF);
+    ctrl->timeout_ms = (uint32_t)((cap >> 24) & 0xFF) * 500;
+    if (ctrl->timeout_ms == 0) {
+        ctrl->timeout_ms = 500;
+    }
+
+    /* Reset the controller */
+    nvme_write32(ctrl, NVME_REG_CC, nvme_read32(ctrl, NVME_REG_CC) & ~NVME_CC_ENABLE);
+    if (nvme_wait_ready(ctrl, false) < 0) {
+        kerr("NVME: Controller did not reset\n");
+        return -1;
+    }
+
+    uint16_t admin_depth = mqes < NVME_ADMIN_QUEUE_DEPTH ? mqes : NVME_ADMIN_QUEUE_DEPTH;
+    if (nvme_queue_init(ctrl, &ctrl->admin, 0, admin_depth) < 0) {
+        return -1;
+    }
+
+    nvme_write32(ctrl, NVME_REG_AQA, (admin_depth - 1) | ((uint32_t)(admin_depth - 1) << 16));
+    nvme_write64(ctrl, NVME_REG_ASQ, ctrl->admin.sq_phys);
+    nvme_write64(ctrl, NVME_REG_ACQ, ctrl->admin.cq_phys);
+
+    /* NVM command set, 4 KiB pages, round-robin arbitration */
+    nvme_write32(ctrl, NVME_REG_CC, NVME_CC_ENABLE | NVME_CC_IOSQES | NVME_CC_IOCQES);
+    if (nvme_wait_ready(ctrl, true) < 0) {
+        kerr("NVME: Controller did not become ready\n");
+        return -1;
+    }
+
+    /* Identify the controller and the first namespace */
+    uint64_t ident_phys;
+    uint8_t *ident = (uint8_t *)pmm_alloc_dma(1, &ident_phys);
+    if (!ident) {
+        return -1;
+    }
+
+    nvme_sqe_t sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = NVME_ADMIN_IDENTIFY;
+    sqe.prp1 = ident_phys;
+    sqe.cdw10 = NVME_IDENTIFY_CONTROLLER;
+    if (nvme_admin_cmd(ctrl, &sqe, NULL) < 0) {
+        pmm_free_dma(ident, 1);
+        return -1;
+    }
+
+    uint8_t mdts = ident[77];
+    uint32_t sgls = *(uint32_t *)(ident + 536);
+    uint32_t mpsmin = 1u << (12 + ((cap >> 48) & 0xF));
+
+    ctrl->sgl = (sgls & 0x3) != 0;
+    ctrl->vwc = (ident[525] & 1) != 0;
+    uint16_t oncs = *(uint16_t *)(ident + 520);
+    ctrl->dsm = (oncs & NVME_ONCS_DSM) != 0;
+    ctrl->write_zeroes = (oncs & NVME_ONCS_WRITE_ZEROES) != 0;
+    ctrl->max_transfer = NVME_MAX_TRANSFER_PAGES * PAGE_SIZE;
+    if (mdts && ((uint64_t)mpsmin << mdts) < ctrl->max_transfer) {
+        ctrl->max_transfer = mpsmin << mdts;
+    }
+
+    ctrl->nsid = 1;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = NVME_ADMIN_IDENTIFY;
+    sqe.nsid = ctrl->nsid;
+    sqe.prp1 = ident_phys;
+    sqe.cdw10 = NVME_IDENTIFY_NAMESPACE;
+    if (nvme_admin_cmd(ctrl, &sqe, NULL) < 0) {
+        pmm_free_dma(ident, 1);
+        return -1;
+    }
+
+    ctrl->lba_count = *(uint64_t *)ident;
+    uint8_t format = ident[26] & 0xF;
+    ctrl->lba_size = 1u << ident[128 + format * 4 + 2];
+    pmm_free_dma(ident, 1);
+
+    if (ctrl->lba_count == 0 || ctrl->lba_size < BLOCK_SECTOR_SIZE || ctrl->lba_size > PAGE_SIZE) {
+        kerr("NVME: Namespace %u is unusable\n", ctrl->nsid);
+        return -1;
+    }
+
+    /* One queue pair per CPU, each with its own MSI-X vector */
+    uint16_t wanted = MAX_CPUS;
+    ctrl->polled = true;
+#if !NVME_POLL_MODE
+    int vectors = pci_msix_enable(pci);
+    if (vectors > 1) {
+        ctrl->polled = false;
+        if (wanted > vectors - 1) {
+            wanted = vectors - 1;
+        }
+    }
+#endif
+
+    uint16_t depth = mqes < NVME_IO_QUEUE_DEPTH ? mqes : NVME_IO_QUEUE_DEPTH;
+    if (nvme_create_io_queues(ctrl, wanted, depth) < 0 || ctrl->num_queues == 0) {
+        kerr("NVME: Failed to create I/O queues\n");
+        return -1;
+    }
+
+    if (!ctrl->polled && !nvme_check_interrupts(ctrl)) {
+        kprintf("NVME: MSI-X interrupts not delivered, polling completions\n");
+        for (uint16_t i = 0; i < ctrl->num_queues; i++) {
+            idt_free_vector((uint8_t)ctrl->queues[i].vector);
+            ctrl->queues[i].vector = -1;
+        }
+        pci_msix_disable(pci);
+        ctrl->polled = true;
+    }
+
+    ksnprintf(ctrl->block.name, sizeof(ctrl->block.name), "nvme%dn%u", nvme_count, ctrl->nsid);
+    ctrl->block.size = ctrl->lba_count * ctrl->lba_size;
+    ctrl->block.block_size = ctrl->lba_size;
+    ctrl->block.private_data = ctrl;
+    ctrl->block.ops = &nvme_ops;
+
+    /* Each queue pair is a hardware queue; one SQ slot stays empty */
+    ctrl->tag_set.ops = &nvme_mq_ops;
+    ctrl->tag_set.nr_hw_queues = ctrl->num_queues;
+    ctrl->tag_set.queue_depth = depth - 1;
+    ctrl->tag_set.max_sectors = ctrl->max_transfer / BLOCK_SECTOR_SIZE;
+    ctrl->tag_set.max_segments = NVME_MAX_TRANSFER_PAGES + 1;
+    ctrl->tag_set.logical_block_size = ctrl->lba_size;
+    ctrl->tag_set.virt_boundary = !ctrl->sgl;
+    ctrl->tag_set.flags = BLK_MQ_F_NO_SCHED_BY_DEFAULT;
+    if (!ctrl->polled) {
+        ctrl->tag_set.flags |= BLK_MQ_F_IRQ_COMPLETION;
+    }
+    if (ctrl->vwc) {
+        ctrl->tag_set.flags |= BLK_MQ_F_WRITE_CACHE | BLK_MQ_F_FUA;
+    }
+    if (ctrl->dsm) {
+        /* One range per command; the block layer merges adjacent discards */
+        ctrl->tag_set.max_discard_sectors = BLK_MAX_DATALESS_SECTORS;
+    }
+    if (ctrl->write_zeroes) {
+        /* The block count is a 16-bit field */
+        ctrl->tag_set.max_write_zeroes_sectors = 0x10000 * (ctrl->lba_size / BLOCK_SECTOR_SIZE);
+    }
+    ctrl->tag_set.driver_data = ctrl;
+    ctrl->block.tag_set = &ctrl->tag_set;
+
+    kprintf("NVME: %s: %lu blocks of %u bytes, %u queue pair(s) of %u, %s, %s%s%s\n",
+            ctrl->block.name, ctrl->lba_count, ctrl->lba_size, ctrl->num_queues, depth,
+            ctrl->sgl ? "SGL" : "PRP", ctrl->polled ? "polled" : "MSI-X",
+            ctrl->vwc ? ", write cache" : "", ctrl->dsm ? ", deallocate" : "");
+
+    nvme_controllers[nvme_count++] = ctrl;
+    return block_device_register(&ctrl->block);
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int nvme_probe_driver(device_driver_t *driver) {
+    pci_device_t *pci;
+
+    for (int index = 0; (pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_NVME, index)) != NULL; index++) {
+        if (nvme_attach(pci) < 0) {
+            kerr("NVME: Failed to attach %02x:%02x.%x\n", pci->bus, pci->slot, pci->func);
+        }
+    }
+
+    if (nvme_count == 0) {
+        kprintf("NVME: No controllers found\n");
+    }
+    driver->private_data = nvme_controllers;
+    return 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int nvme_remove_driver(device_driver_t *driver) {
+    for (int i = 0; i < nvme_count; i++) {
+        nvme_ctrl_t *ctrl = nvme_controllers[i];
+        block_device_unregister(&ctrl->block);
+        nvme_write32(ctrl, NVME_REG_CC, nvme_read32(ctrl, NVME_REG_CC) & ~NVME_CC_ENABLE);
+    }
+    return 0;
+}
+
+/**
+ * Register the NVMe driver
+ */
+void nvme_register_driver(void) {
+    device_driver_register(&nvme_driver);
+}
\ No newline at end of file
@@ -0,0 +1,216 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * NVMe block device driver
+ */
+
+#ifndef _DRIVERS_BLOCK_NVME_H
+#define _DRIVERS_BLOCK_NVME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/block.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/pci/pci.h>
+
+/* Maximum number of controllers driven */
+#define NVME_MAX_CONTROLLERS    4
+
+/* Queue sizes */
+#define NVME_ADMIN_QUEUE_DEPTH  32
+#define NVME_IO_QUEUE_DEPTH     64
+
+/* Largest transfer per command, in pages (bounded by one PRP list page) */
+#define NVME_MAX_TRANSFER_PAGES 128
+
+/* Controller registers */
+#define NVME_REG_CAP            0x00
+#define NVME_REG_VS             0x08
+#define NVME_REG_INTMS          0x0C
+#define NVME_REG_INTMC          0x10
+#define NVME_REG_CC             0x14
+#define NVME_REG_CSTS           0x1C
+#define NVME_REG_AQA            0x24
+#define NVME_REG_ASQ            0x28
+#define NVME_REG_ACQ            0x30
+#define NVME_REG_DOORBELL       0x1000
+
+/* Controller configuration bits */
+#define NVME_CC_ENABLE          (1u << 0)
+#define NVME_CC_IOSQES          (6u << 16)
+#define NVME_CC_IOCQES          (4u << 20)
+
+/* Controller status bits */
+#define NVME_CSTS_RDY           (1u << 0)
+#define NVME_CSTS_CFS           (1u << 1)
+
+/* Admin command opcodes */
+#define NVME_ADMIN_CREATE_SQ    0x01
+#define NVME_ADMIN_CREATE_CQ    0x05
+#define NVME_ADMIN_IDENTIFY     0x06
+#define NVME_ADMIN_SET_FEATURES 0x09
+
+/* I/O command opcodes */
+#define NVME_CMD_FLUSH          0x00
+#define NVME_CMD_WRITE          0x01
+#define NVME_CMD_READ           0x02
+#define NVME_CMD_WRITE_ZEROES   0x08
+#define NVME_CMD_DSM            0x09
+
+/* Optional NVM command support (identify controller ONCS) */
+#define NVME_ONCS_DSM           (1u << 2)
+#define NVME_ONCS_WRITE_ZEROES  (1u << 3)
+
+/* Dataset management dword 11: deallocate the ranges */
+#define NVME_DSM_AD             (1u << 2)
+
+/* Read/write command dword 12: force unit access */
+#define NVME_RW_FUA             (1u << 30)
+
+/* Identify CNS values */
+#define NVME_IDENTIFY_NAMESPACE  0x00
+#define NVME_IDENTIFY_CONTROLLER 0x01
+
+/* Feature identifiers */
+#define NVME_FEATURE_NUM_QUEUES 0x07
+
+/* Command flags: data pointer is an SGL */
+#define NVME_CMD_FLAGS_SGL      0x40
+
+/* SGL descriptor types */
+#define NVME_SGL_DATA_BLOCK     0x00
+#define NVME_SGL_LAST_SEGMENT   0x30
+
+/* Submission queue entry */
+typedef struct nvme_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t cid;
+    uint32_t nsid;
+    uint64_t reserved;
+    uint64_t mptr;
+    uint64_t prp1;              /* PRP entry 1, or the first half of SGL1 */
+    uint64_t prp2;              /* PRP entry 2, or the second half of SGL1 */
+    uint32_t cdw10;
+    uint32_t cdw11;
+    uint32_t cdw12;
+    uint32_t cdw13;
+    uint32_t cdw14;
+    uint32_t cdw15;
+} __attribute__((packed)) nvme_sqe_t;
+
+/* Dataset management range */
+typedef struct nvme_dsm_range {
+    uint32_t cattr;             /* Context attributes */
+    uint32_t nlb;               /* Blocks in the range */
+    uint64_t slba;              /* First block */
+} __attribute__((packed)) nvme_dsm_range_t;
+
+/* Completion queue entry */
+typedef struct nvme_cqe {
+    uint32_t result;
+    uint32_t reserved;
+    uint16_t sq_head;
+    uint16_t sq_id;
+    uint16_t cid;
+    uint16_t status;            /* Bit 0 is the phase tag */
+} __attribute__((packed)) nvme_cqe_t;
+
+/* SGL descriptor */
+typedef struct nvme_sgl_desc {
+    uint64_t addr;
+    uint32_t length;
+    uint8_t  reserved[3];
+    uint8_t  type;
+} __attribute__((packed)) nvme_sgl_desc_t;
+
+/* Per-command state */
+typedef struct nvme_request {
+    volatile bool done;         /* Completion seen (admin and setup commands) */
+    uint16_t status;            /* Status field without the phase tag */
+    uint32_t result;            /* Command-specific result */
+    void    *list;              /* PRP list or SGL segment page */
+    uint64_t list_phys;         /* Physical address of the list page */
+} nvme_request_t;
+
+struct nvme_ctrl;
+
+/* Submission/completion queue pair */
+typedef struct nvme_queue {
+    struct nvme_ctrl *ctrl;     /* Owning controller */
+    uint16_t qid;               /* Queue ID (0 for admin) */
+    uint16_t depth;             /* Entries per queue */
+
+    nvme_sqe_t *sq;             /* Submission queue */
+    volatile nvme_cqe_t *cq;    /* Completion queue */
+    uint64_t sq_phys;
+    uint64_t cq_phys;
+    volatile uint32_t *sq_doorbell;
+    volatile uint32_t *cq_doorbell;
+
+    uint16_t sq_tail;           /* Next submission slot */
+    uint16_t sq_published;      /* Tail last written to the doorbell */
+    uint16_t cq_head;           /* Next completion entry */
+    uint8_t  cq_phase;          /* Expected phase tag */
+
+    nvme_request_t *requests;   /* Indexed by command ID */
+    uint16_t *free_cids;        /* Free command IDs for admin commands */
+    uint16_t free_count;
+    struct blk_mq_hw_ctx *hctx; /* Hardware queue; I/O command IDs are its tags */
+
+    int      vector;            /* Interrupt vector, or -1 when polled */
+
+    /* Statistics */
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t doorbells;         /* Submission doorbell writes */
+    uint64_t interrupts;
+} nvme_queue_t;
+
+/* NVMe controller with one namespace exposed as a block device */
+typedef struct nvme_ctrl {
+    pci_device_t *pci;          /* Underlying PCI function */
+    volatile uint8_t *regs;     /* Controller registers */
+    uint32_t doorbell_stride;   /* Bytes between doorbells */
+    uint32_t timeout_ms;        /* Ready timeout */
+
+    nvme_queue_t admin;         /* Admin queue pair */
+    nvme_queue_t *queues;       /* I/O queue pairs, one per CPU */
+    uint16_t num_queues;
+
+    uint32_t nsid;              /* Namespace exposed */
+    uint64_t lba_count;         /* Namespace size in blocks */
+    uint32_t lba_size;          /* Bytes per block */
+    uint32_t max_transfer;      /* Bytes per command */
+    bool     sgl;               /* Controller accepts SGLs */
+    bool     polled;            /* Completions are polled */
+    bool     vwc;               /* Volatile write cache present */
+    bool     dsm;               /* Dataset management (deallocate) supported */
+    bool     write_zeroes;      /* Write zeroes supported */
+
+    blk_mq_tag_set_t tag_set;   /* Hardware queue description for blk-mq */
+    block_device_t block;       /* Registered block device */
+} nvme_ctrl_t;
+
+/**
+ * Register the NVMe driver
+ */
+void nvme_register_driver(void);
+
+#endif /* _DRIVERS_BLOCK_NVME_H */
\ No newline at end of file
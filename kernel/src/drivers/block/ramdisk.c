@@ -0,0 +1,197 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * RAM-backed block devices from bootloader modules
+ *
+ * Each Limine module becomes a ramN block device. The module stays where
+ * the bootloader put it; ordinary reads copy out of it, while the map
+ * operation hands out pointers into it so the page cache can reference
+ * the image instead of duplicating it.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limine.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <drivers/driversys.h>
+#include <drivers/block/block.h>
+#include <drivers/block/ramdisk.h>
+
+static int ramdisk_probe_driver(device_driver_t *driver);
+static int ramdisk_remove_driver(device_driver_t *driver);
+
+static int ramdisk_read(block_device_t *device, uint64_t offset, size_t size, void *buffer);
+static int ramdisk_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer);
+static int ramdisk_ioctl(block_device_t *device, unsigned int cmd, void *arg);
+static int ramdisk_map(block_device_t *device, uint64_t offset, size_t size, void **addr);
+
+/* Define the ramdisk driver */
+static driver_ops_t ramdisk_driver_ops = {
+    .probe = ramdisk_probe_driver,
+    .remove = ramdisk_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t ramdisk_driver = {
+    .name = "ramdisk",
+    .device_class = DEVICE_CLASS_STORAGE,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &ramdisk_driver_ops,
+    .private_data = NULL
+};
+
+static block_device_ops_t ramdisk_ops = {
+    .read = ramdisk_read,
+    .write = ramdisk_write,
+    .ioctl = ramdisk_ioctl,
+    .map = ramdisk_map
+};
+
+/* Modules handed over by the bootloader */
+static struct limine_module_response *ramdisk_modules = NULL;
+
+/* Registered ramdisks */
+static ramdisk_t ramdisks[RAMDISK_MAX_DEVICES];
+static int ramdisk_count = 0;
+
+/**
+ * Check that a range lies within the ramdisk
+ */
+static inline int ramdisk_check(ramdisk_t *disk, uint64_t offset, size_t size) {
+    if (offset + size < offset || offset + size > disk->size) {
+        return -1;
+    }
+    return 0;
+}
+
+static int ramdisk_read(block_device_t *device, uint64_t offset, size_t size, void *buffer) {
+    if (!device || !buffer) {
+        return -1;
+    }
+
+    ramdisk_t *disk = (ramdisk_t *)device->private_data;
+    if (ramdisk_check(disk, offset, size) < 0) {
+        return -1;
+    }
+
+    memcpy(buffer, disk->base + offset, size);
+    return 0;
+}
+
+static int ramdisk_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer) {
+    if (!device || !buffer) {
+        return -1;
+    }
+
+    ramdisk_t *disk = (ramdisk_t *)device->private_data;
+    if (ramdisk_check(disk, offset, size) < 0) {
+        return -1;
+    }
+
+    memcpy(disk->base + offset, buffer, size);
+    return 0;
+}
+
+static int ramdisk_ioctl(block_device_t *device, unsigned int cmd, void *arg) {
+    return -1;
+}
+
+/**
+ * Return a pointer to the ramdisk contents at an offset
+ * @param device Block device
+ * @param offset Byte offset
+ * @param size Bytes the caller will access
+ * @param addr Output for the address
+ * @return 0 on success, negative if the range is outside the device
+ */
+static int ramdisk_map(block_device_t *device, uint64_t offset, size_t size, void **addr) {
+    if (!device || !addr) {
+        return -1;
+    }
+
+    ramdisk_t *disk = (ramdisk_t *)device->private_data;
+    if (ramdisk_check(disk, offset, size) < 0) {
+        return -1;
+    }
+
+    *addr = disk->base + offset;
+    return 0;
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int ramdisk_probe_driver(device_driver_t *driver) {
+    if (!ramdisk_modules) {
+        kprintf("RAMDISK: No modules loaded\n");
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < ramdisk_modules->module_count && ramdisk_count < RAMDISK_MAX_DEVICES; i++) {
+        struct limine_file *module = ramdisk_modules->modules[i];
+        if (!module || !module->address || module->size < BLOCK_SECTOR_SIZE) {
+            continue;
+        }
+
+        ramdisk_t *disk = &ramdisks[ramdisk_count];
+        disk->base = (uint8_t *)module->address;
+        disk->size = module->size & ~(uint64_t)(BLOCK_SECTOR_SIZE - 1);
+        disk->path = module->path;
+
+        ksnprintf(disk->block.name, sizeof(disk->block.name), "ram%d", ramdisk_count);
+        disk->block.size = disk->size;
+        disk->block.block_size = BLOCK_SECTOR_SIZE;
+        disk->block.private_data = disk;
+        disk->block.ops = &ramdisk_ops;
+
+        kprintf("RAMDISK: %s: %s, %lu KiB at %p\n", disk->block.name,
+                disk->path ? disk->path : "(unnamed)", disk->size / 1024, disk->base);
+
+        if (block_device_register(&disk->block) == 0) {
+            ramdisk_count++;
+        }
+    }
+
+    driver->private_data = ramdisks;
+    return 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int ramdisk_remove_driver(device_driver_t *driver) {
+    for (int i = 0; i < ramdisk_count; i++) {
+        block_device_unregister(&ramdisks[i].block);
+    }
+    ramdisk_count = 0;
+    return 0;
+}
+
+/**
+ * Register the ramdisk driver
+ * @param modules Limine module response (may be NULL)
+ */
+void ramdisk_register_driver(struct limine_module_response *modules) {
+    ramdisk_modules = modules;
+    device_driver_register(&ramdisk_driver);
+}
\ No newline at end of file
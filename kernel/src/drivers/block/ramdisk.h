@@ -0,0 +1,46 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * RAM-backed block devices from bootloader modules
+ */
+
+#ifndef _DRIVERS_BLOCK_RAMDISK_H
+#define _DRIVERS_BLOCK_RAMDISK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limine.h>
+#include <drivers/block/block.h>
+
+/* Maximum number of ramdisks */
+#define RAMDISK_MAX_DEVICES     8
+
+/* Ramdisk backed by a module the bootloader loaded */
+typedef struct ramdisk {
+    uint8_t *base;              /* Module contents (direct map) */
+    uint64_t size;              /* Module size in bytes */
+    const char *path;           /* Module path, for messages */
+    block_device_t block;       /* Registered block device */
+} ramdisk_t;
+
+/**
+ * Register the ramdisk driver
+ * @param modules Limine module response (may be NULL)
+ */
+void ramdisk_register_driver(struct limine_module_response *modules);
+
+#endif /* _DRIVERS_BLOCK_RAMDISK_H */
\ No newline at end of file
@@ -0,0 +1,478 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Virtio block device driver
+ *
+ * Every virtqueue is a blk-mq hardware queue, so each CPU submits on its
+ * own. Requests use one indirect descriptor so a full queue of
+ * multi-segment requests fits in the ring, and EVENT_IDX lets the device
+ * skip doorbells it does not need. Interrupts are not routed yet, so
+ * completions are polled with device interrupts suppressed.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <drivers/driversys.h>
+#include <drivers/pci/pci.h>
+#include <drivers/virtio/virtio.h>
+#include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/block/virtio_blk.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/* Upper bound on descriptors per virtqueue */
+#define VIRTIO_BLK_QUEUE_SIZE   256
+
+static int virtio_blk_probe_driver(device_driver_t *driver);
+static int virtio_blk_remove_driver(device_driver_t *driver);
+
+static int virtio_blk_read(block_device_t *device, uint64_t offset, size_t size, void *buffer);
+static int virtio_blk_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer);
+static int virtio_blk_ioctl(block_device_t *device, unsigned int cmd, void *arg);
+
+static int virtio_blk_queue_rq(blk_mq_hw_ctx_t *hctx, request_t *rq, bool last);
+static void virtio_blk_commit_rqs(blk_mq_hw_ctx_t *hctx);
+static uint32_t virtio_blk_poll(blk_mq_hw_ctx_t *hctx);
+static int virtio_blk_init_hctx(blk_mq_hw_ctx_t *hctx, void *driver_data, uint16_t index);
+
+/* Define the virtio block driver */
+static driver_ops_t virtio_blk_driver_ops = {
+    .probe = virtio_blk_probe_driver,
+    .remove = virtio_blk_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t virtio_blk_driver = {
+    .name = "virtio_blk",
+    .device_class = DEVICE_CLASS_STORAGE,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &virtio_blk_driver_ops,
+    .private_data = NULL
+};
+
+static block_device_ops_t virtio_blk_ops = {
+    .read = virtio_blk_read,
+    .write = virtio_blk_write,
+    .ioctl = virtio_blk_ioctl
+};
+
+static const blk_mq_ops_t virtio_blk_mq_ops = {
+    .queue_rq = virtio_blk_queue_rq,
+    .commit_rqs = virtio_blk_commit_rqs,
+    .poll = virtio_blk_poll,
+    .init_hctx = virtio_blk_init_hctx
+};
+
+/* Driven devices */
+static virtio_blk_t *virtio_blk_devices[VIRTIO_BLK_MAX_DEVICES];
+static int virtio_blk_count = 0;
+
+/**
+ * Bind a hardware queue to its virtqueue
+ */
+static int virtio_blk_init_hctx(blk_mq_hw_ctx_t *hctx, void *driver_data, uint16_t index) {
+    virtio_blk_t *blk = (virtio_blk_t *)driver_data;
+    if (index >= blk->num_queues) {
+        return -1;
+    }
+    hctx->driver_data = &blk->queues[index];
+    return 0;
+}
+
+/**
+ * Queue one request on a virtqueue; the tag selects the request slot
+ * @param hctx Hardware queue
+ * @param rq Request
+ * @param last Notify the device after queueing
+ * @return BLK_MQ_RQ_QUEUED, BLK_MQ_RQ_BUSY if the ring is full, negative on error
+ */
+static int virtio_blk_queue_rq(blk_mq_hw_ctx_t *hctx, request_t *rq, bool last) {
+    virtio_blk_queue_t *q = (virtio_blk_queue_t *)hctx->driver_data;
+    virtio_blk_t *blk = q->blk;
+    virtio_blk_slot_t *slot = &q->slots[rq->tag];
+    uint64_t slot_phys = q->slots_phys + (uint64_t)rq->tag * sizeof(virtio_blk_slot_t);
+
+    if (rq->op == BIO_OP_FLUSH) {
+        slot->hdr.type = VIRTIO_BLK_T_FLUSH;
+        slot->hdr.sector = 0;
+    } else if (bio_op_dataless(rq->op)) {
+        slot->hdr.type = rq->op == BIO_OP_DISCARD ? VIRTIO_BLK_T_DISCARD : VIRTIO_BLK_T_WRITE_ZEROES;
+        slot->hdr.sector = 0;
+        slot->range.sector = rq->sector;
+        slot->range.num_sectors = rq->nr_sectors;
+        slot->range.flags = 0;
+    } else {
+        slot->hdr.type = rq->op == BIO_OP_READ ? VIRTIO_BLK_T_IN : VIRTIO_BLK_T_OUT;
+        slot->hdr.sector = rq->sector;
+    }
+    slot->hdr.reserved = 0;
+    slot->status = 0xFF;
+
+    virtio_sg_t sg[VIRTQ_INDIRECT_MAX];
+    uint16_t count = 0;
+    bool device_writes = (rq->op == BIO_OP_READ);
+
+    sg[count].addr = slot_phys;
+    sg[count].len = sizeof(virtio_blk_outhdr_t);
+    sg[count].device_writes = false;
+    count++;
+
+    /* Data-less requests carry their range as the only device-readable payload */
+    if (bio_op_dataless(rq->op)) {
+        sg[count].addr = slot_phys + offsetof(virtio_blk_slot_t, range);
+        sg[count].len = sizeof(virtio_blk_discard_write_zeroes_t);
+        sg[count].device_writes = false;
+        count++;
+    }
+
+    /* One data segment per physically contiguous run of bio segments */
+    for (bio_t *bio = rq->bio; bio; bio = bio->next) {
+        for (uint16_t i = 0; i < bio->vcnt; i++) {
+            uint64_t phys = virt_to_phys(bio_vec_addr(&bio->vecs[i]));
+            uint32_t len = bio->vecs[i].len;
+            virtio_sg_t *prev = &sg[count - 1];
+
+            if (count > 1 && prev->addr + prev->len == phys && prev->len + len <= blk->size_max) {
+                prev->len += len;
+                continue;
+            }
+            if (count - 1 == blk->max_segments) {
+                return -1;
+            }
+            sg[count].addr = phys;
+            sg[count].len = len;
+            sg[count].device_writes = device_writes;
+            count++;
+        }
+    }
+
+    sg[count].addr = slot_phys + offsetof(virtio_blk_slot_t, status);
+    sg[count].len = 1;
+    sg[count].device_writes = true;
+    count++;
+
+    if (virtqueue_add(q->vq, sg, count, slot) < 0) {
+        return BLK_MQ_RQ_BUSY;
+    }
+
+    q->requests++;
+    if (last) {
+        virtqueue_kick(q->vq);
+    }
+    return BLK_MQ_RQ_QUEUED;
+}
+
+/**
+ * Notify the device of requests queued without last
+ */
+static void virtio_blk_commit_rqs(blk_mq_hw_ctx_t *hctx) {
+    virtio_blk_queue_t *q = (virtio_blk_queue_t *)hctx->driver_data;
+    virtqueue_kick(q->vq);
+}
+
+/**
+ * Collect completed requests from a queue
+ * @param hctx Hardware queue
+ * @return Number of requests completed
+ */
+static uint32_t virtio_blk_poll(blk_mq_hw_ctx_t *hctx) {
+    virtio_blk_queue_t *q = (virtio_blk_queue_t *)hctx->driver_data;
+    virtio_blk_slot_t *slot;
+    uint32_t done = 0;
+
+    while ((slot = (virtio_blk_slot_t *)virtqueue_get_buf(q->vq, NULL)) != NULL) {
+        blk_mq_complete_request(blk_mq_tag_to_rq(hctx, slot->index),
+                                slot->status == VIRTIO_BLK_S_OK ? 0 : -1);
+        done++;
+    }
+
+    q->completions += done;
+    return done;
+}
+
+static int virtio_blk_read(block_device_t *device, uint64_t offset, size_t size, void *buffer) {
+    return bio_rw_bytes(device, BIO_OP_READ, offset, size, buffer);
+}
+
+static int virtio_blk_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer) {
+    return bio_rw_bytes(device, BIO_OP_WRITE, offset, size, (void *)buffer);
+}
+
+/**
+ * Random read benchmark over every queue, reporting doorbell savings
+ */
+static int virtio_blk_bench(virtio_blk_t *blk, block_bench_t *bench) {
+    uint64_t kicks_before = 0;
+    uint64_t suppressed_before = 0;
+    for (uint16_t i = 0; i < blk->num_queues; i++) {
+        kicks_before += blk->queues[i].vq->notifications;
+        suppressed_before += blk->queues[i].vq->notifications_suppressed;
+    }
+
+    int result = blk_mq_bench(blk->block.queue, bench);
+    if (result < 0) {
+        return result;
+    }
+
+    uint64_t kicks = 0;
+    uint64_t suppressed = 0;
+    for (uint16_t i = 0; i < blk->num_queues; i++) {
+        kicks += blk->queues[i].vq->notifications;
+        suppressed += blk->queues[i].vq->notifications_suppressed;
+    }
+    kprintf("VIRTIO-BLK: %s: %lu doorbells, %lu suppressed over %u queue(s)\n",
+            blk->block.name, kicks - kicks_before, suppressed - suppressed_before,
+            blk->num_queues);
+    return 0;
+}
+
+static int virtio_blk_ioctl(block_device_t *device, unsigned int cmd, void *arg) {
+    if (!device) {
+        return -1;
+    }
+
+    virtio_blk_t *blk = (virtio_blk_t *)device->private_data;
+    switch (cmd) {
+        case BLOCK_IOCTL_BENCH:
+            if (!arg) {
+                return -1;
+            }
+            return virtio_blk_bench(blk, (block_bench_t *)arg);
+        default:
+            return -1;
+    }
+}
+
+/**
+ * Set up request queue state on top of a virtqueue
+ */
+static int virtio_blk_init_queue(virtio_blk_t *blk, virtio_blk_queue_t *q, uint16_t index) {
+    q->blk = blk;
+    q->vq = virtio_setup_queue(&blk->vdev, index, VIRTIO_BLK_QUEUE_SIZE);
+    if (!q->vq) {
+        return -1;
+    }
+
+    /* Completions are polled; keep the device from raising interrupts */
+    virtqueue_disable_cb(q->vq);
+
+    uint16_t slots = q->vq->size;
+    q->slot_pages = ((size_t)slots * sizeof(virtio_blk_slot_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+    q->slots = (virtio_blk_slot_t *)pmm_alloc_dma(q->slot_pages, &q->slots_phys);
+    if (!q->slots) {
+        return -1;
+    }
+
+    /* Slots are indexed by blk-mq tag */
+    for (uint16_t i = 0; i < slots; i++) {
+        q->slots[i].index = i;
+    }
+    return 0;
+}
+
+/**
+ * Free the queues set up so far when a device fails to attach
+ */
+static void virtio_blk_free_queues(virtio_blk_t *blk, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        virtio_blk_queue_t *q = &blk->queues[i];
+        if (q->slots) {
+            pmm_free_dma(q->slots, q->slot_pages);
+        }
+        virtio_free_queue(q->vq);
+    }
+    kfree(blk->queues);
+}
+
+/**
+ * Bring up one virtio block PCI function
+ */
+static int virtio_blk_attach(pci_device_t *pci) {
+    if (virtio_blk_count >= VIRTIO_BLK_MAX_DEVICES) {
+        return -1;
+    }
+
+    virtio_blk_t *blk = (virtio_blk_t *)kzalloc(sizeof(virtio_blk_t));
+    if (!blk) {
+        return -1;
+    }
+
+    if (virtio_pci_init(&blk->vdev, pci) < 0) {
+        kfree(blk);
+        return -1;
+    }
+
+    uint64_t wanted = (1ULL << VIRTIO_F_RING_INDIRECT_DESC) |
+                      (1ULL << VIRTIO_F_RING_EVENT_IDX) |
+                      (1ULL << VIRTIO_BLK_F_SIZE_MAX) |
+                      (1ULL << VIRTIO_BLK_F_SEG_MAX) |
+                      (1ULL << VIRTIO_BLK_F_BLK_SIZE) |
+                      (1ULL << VIRTIO_BLK_F_FLUSH) |
+                      (1ULL << VIRTIO_BLK_F_MQ) |
+                      (1ULL << VIRTIO_BLK_F_DISCARD) |
+                      (1ULL << VIRTIO_BLK_F_WRITE_ZEROES);
+    if (!blk->vdev.device_cfg || virtio_negotiate_features(&blk->vdev, wanted) < 0) {
+        virtio_fail(&blk->vdev);
+        kfree(blk);
+        return -1;
+    }
+
+    volatile virtio_blk_config_t *cfg = (volatile virtio_blk_config_t *)blk->vdev.device_cfg;
+    blk->capacity = cfg->capacity;
+
+    blk->size_max = 0xFFFFFFFF;
+    if (virtio_has_feature(&blk->vdev, VIRTIO_BLK_F_SIZE_MAX) && cfg->size_max) {
+        blk->size_max = cfg->size_max;
+    }
+
+    /* Header and status take two of the indirect table's entries */
+    blk->max_segments = 1;
+    if (virtio_has_feature(&blk->vdev, VIRTIO_BLK_F_SEG_MAX) && cfg->seg_max) {
+        blk->max_segments = cfg->seg_max < VIRTQ_INDIRECT_MAX - 2 ?
+                            (uint16_t)cfg->seg_max : VIRTQ_INDIRECT_MAX - 2;
+    }
+
+    /* One queue per CPU, up to what the device offers */
+    uint16_t queues = 1;
+    if (virtio_has_feature(&blk->vdev, VIRTIO_BLK_F_MQ) && cfg->num_queues) {
+        queues = cfg->num_queues;
+    }
+    if (queues > virtio_num_queues(&blk->vdev)) {
+        queues = virtio_num_queues(&blk->vdev);
+    }
+    if (queues > MAX_CPUS) {
+        queues = MAX_CPUS;
+    }
+    if (queues == 0) {
+        virtio_fail(&blk->vdev);
+        kfree(blk);
+        return -1;
+    }
+
+    blk->queues = (virtio_blk_queue_t *)kzalloc(queues * sizeof(virtio_blk_queue_t));
+    if (!blk->queues) {
+        virtio_fail(&blk->vdev);
+        kfree(blk);
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < queues; i++) {
+        if (virtio_blk_init_queue(blk, &blk->queues[i], i) < 0) {
+            kerr("VIRTIO-BLK: Failed to set up queue %u\n", i);
+            virtio_fail(&blk->vdev);
+            virtio_blk_free_queues(blk, i + 1);
+            kfree(blk);
+            return -1;
+        }
+    }
+    blk->num_queues = queues;
+
+    virtio_driver_ok(&blk->vdev);
+
+    /* Name devices vda, vdb, ... */
+    strcpy(blk->block.name, "vda");
+    blk->block.name[2] = 'a' + virtio_blk_count;
+    blk->block.size = blk->capacity * BLOCK_SECTOR_SIZE;
+    blk->block.block_size = BLOCK_SECTOR_SIZE;
+    if (virtio_has_feature(&blk->vdev, VIRTIO_BLK_F_BLK_SIZE) && cfg->blk_size >= BLOCK_SECTOR_SIZE) {
+        blk->block.block_size = cfg->blk_size;
+    }
+    blk->block.private_data = blk;
+    blk->block.ops = &virtio_blk_ops;
+
+    /* Expose every virtqueue as a hardware queue, one tag per ring slot */
+    blk->tag_set.ops = &virtio_blk_mq_ops;
+    blk->tag_set.nr_hw_queues = blk->num_queues;
+    blk->tag_set.queue_depth = blk->queues[0].vq->size;
+    blk->tag_set.max_segments = blk->max_segments;
+    blk->tag_set.driver_data = blk;
+    if (virtio_has_feature(&blk->vdev, VIRTIO_BLK_F_FLUSH)) {
+        /* No FUA in virtio: the block layer follows such writes with a flush */
+        blk->tag_set.flags |= BLK_MQ_F_WRITE_CACHE;
+    }
+    if (virtio_has_feature(&blk->vdev, VIRTIO_BLK_F_DISCARD) && cfg->max_discard_seg) {
+        blk->tag_set.max_discard_sectors = cfg->max_discard_sectors;
+        blk->tag_set.discard_granularity = cfg->discard_sector_alignment * BLOCK_SECTOR_SIZE;
+    }
+    if (virtio_has_feature(&blk->vdev, VIRTIO_BLK_F_WRITE_ZEROES) && cfg->max_write_zeroes_seg) {
+        blk->tag_set.max_write_zeroes_sectors = cfg->max_write_zeroes_sectors;
+    }
+    blk->block.tag_set = &blk->tag_set;
+
+    kprintf("VIRTIO-BLK: %s: %lu sectors, %u queue(s) of %u, %u segments%s%s%s%s\n",
+            blk->block.name, blk->capacity, blk->num_queues, blk->queues[0].vq->size,
+            blk->max_segments,
+            virtio_has_feature(&blk->vdev, VIRTIO_F_RING_INDIRECT_DESC) ? ", indirect" : "",
+            virtio_has_feature(&blk->vdev, VIRTIO_F_RING_EVENT_IDX) ? ", event-idx" : "",
+            virtio_has_feature(&blk->vdev, VIRTIO_BLK_F_FLUSH) ? ", write cache" : "",
+            blk->tag_set.max_discard_sectors ? ", discard" : "");
+
+    virtio_blk_devices[virtio_blk_count++] = blk;
+    return block_device_register(&blk->block);
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int virtio_blk_probe_driver(device_driver_t *driver) {
+    static const uint16_t ids[] = { VIRTIO_BLK_PCI_DEVICE, VIRTIO_BLK_PCI_TRANSITIONAL };
+
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        pci_device_t *pci;
+        for (int index = 0; (pci = pci_find_device(VIRTIO_PCI_VENDOR, ids[i], index)) != NULL; index++) {
+            if (virtio_blk_attach(pci) < 0) {
+                kerr("VIRTIO-BLK: Failed to attach %02x:%02x.%x\n", pci->bus, pci->slot, pci->func);
+            }
+        }
+    }
+
+    if (virtio_blk_count == 0) {
+        kprintf("VIRTIO-BLK: No devices found\n");
+    }
+    driver->private_data = virtio_blk_devices;
+    return 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int virtio_blk_remove_driver(device_driver_t *driver) {
+    for (int i = 0; i < virtio_blk_count; i++) {
+        block_device_unregister(&virtio_blk_devices[i]->block);
+        virtio_blk_devices[i]->vdev.common->device_status = 0;
+    }
+    return 0;
+}
+
+/**
+ * Register the virtio block driver
+ */
+void virtio_blk_register_driver(void) {
+    device_driver_register(&virtio_blk_driver);
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Virtio block device driver
+ */
+
+#ifndef _DRIVERS_BLOCK_VIRTIO_BLK_H
+#define _DRIVERS_BLOCK_VIRTIO_BLK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <drivers/block/block.h>
+#include <drivers/block/blk_mq.h>
+#include <drivers/virtio/virtio.h>
+
+/* PCI device IDs */
+#define VIRTIO_BLK_PCI_DEVICE           (VIRTIO_PCI_MODERN_BASE + 2)
+#define VIRTIO_BLK_PCI_TRANSITIONAL     0x1001
+
+/* Maximum number of block devices driven */
+#define VIRTIO_BLK_MAX_DEVICES          8
+
+/* Device feature bits */
+#define VIRTIO_BLK_F_SIZE_MAX           1
+#define VIRTIO_BLK_F_SEG_MAX            2
+#define VIRTIO_BLK_F_BLK_SIZE           6
+#define VIRTIO_BLK_F_FLUSH              9
+#define VIRTIO_BLK_F_MQ                 12
+#define VIRTIO_BLK_F_DISCARD            13
+#define VIRTIO_BLK_F_WRITE_ZEROES       14
+
+/* Request types */
+#define VIRTIO_BLK_T_IN                 0
+#define VIRTIO_BLK_T_OUT                1
+#define VIRTIO_BLK_T_FLUSH              4
+#define VIRTIO_BLK_T_DISCARD            11
+#define VIRTIO_BLK_T_WRITE_ZEROES       13
+
+/* Request status */
+#define VIRTIO_BLK_S_OK                 0
+#define VIRTIO_BLK_S_IOERR              1
+#define VIRTIO_BLK_S_UNSUPP             2
+
+/* Device configuration layout */
+typedef struct virtio_blk_config {
+    uint64_t capacity;          /* Size in 512-byte sectors */
+    uint32_t size_max;          /* Maximum segment size */
+    uint32_t seg_max;           /* Maximum segments per request */
+    uint16_t cylinders;
+    uint8_t  heads;
+    uint8_t  sectors;
+    uint32_t blk_size;          /* Optimal block size */
+    uint8_t  physical_block_exp;
+    uint8_t  alignment_offset;
+    uint16_t min_io_size;
+    uint32_t opt_io_size;
+    uint8_t  writeback;
+    uint8_t  unused0;
+    uint16_t num_queues;        /* Valid with VIRTIO_BLK_F_MQ */
+    uint32_t max_discard_sectors;       /* Valid with VIRTIO_BLK_F_DISCARD */
+    uint32_t max_discard_seg;
+    uint32_t discard_sector_alignment;
+    uint32_t max_write_zeroes_sectors;  /* Valid with VIRTIO_BLK_F_WRITE_ZEROES */
+    uint32_t max_write_zeroes_seg;
+    uint8_t  write_zeroes_may_unmap;
+    uint8_t  unused1[3];
+} __attribute__((packed)) virtio_blk_config_t;
+
+/* Request header read by the device */
+typedef struct virtio_blk_outhdr {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_outhdr_t;
+
+/* Sector range of a discard or write zeroes request */
+typedef struct virtio_blk_discard_write_zeroes {
+    uint64_t sector;
+    uint32_t num_sectors;
+    uint32_t flags;
+} __attribute__((packed)) virtio_blk_discard_write_zeroes_t;
+
+/* In-flight request slot, lives in DMA memory */
+typedef struct virtio_blk_slot {
+    virtio_blk_outhdr_t hdr;    /* Request header */
+    volatile uint8_t status;    /* Status written by the device */
+    uint8_t  reserved;
+    uint16_t index;             /* Slot index within the queue (the request tag) */
+    uint32_t pad;
+    virtio_blk_discard_write_zeroes_t range;    /* Payload of data-less requests */
+} virtio_blk_slot_t;
+
+struct virtio_blk;
+
+/* One request queue, backing one blk-mq hardware queue */
+typedef struct virtio_blk_queue {
+    struct virtio_blk *blk;     /* Owning device */
+    virtqueue_t *vq;            /* Underlying virtqueue */
+    virtio_blk_slot_t *slots;   /* Request slots, indexed by tag */
+    uint64_t slots_phys;        /* Physical address of the slots */
+    size_t   slot_pages;        /* Size of the slot allocation */
+    uint64_t requests;          /* Requests submitted */
+    uint64_t completions;       /* Requests completed */
+} virtio_blk_queue_t;
+
+/* Virtio block device */
+typedef struct virtio_blk {
+    virtio_device_t vdev;       /* Transport */
+    block_device_t block;       /* Registered block device */
+    blk_mq_tag_set_t tag_set;   /* Hardware queue description for blk-mq */
+    virtio_blk_queue_t *queues; /* Request queues */
+    uint16_t num_queues;        /* Number of request queues */
+    uint16_t max_segments;      /* Data segments per request */
+    uint32_t size_max;          /* Maximum bytes per segment */
+    uint64_t capacity;          /* Size in sectors */
+} virtio_blk_t;
+
+/**
+ * Register the virtio block driver
+ */
+void virtio_blk_register_driver(void);
+
+#endif /* _DRIVERS_BLOCK_VIRTIO_BLK_H */
\ No newline at end of file
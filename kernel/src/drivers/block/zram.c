@@ -0,0 +1,382 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Compressed RAM block devices
+ *
+ * A zram device keeps every page written to it LZ4-compressed in memory.
+ * Pages that are one word repeated (zeroes, most often) are not stored at
+ * all, only the word is; pages that do not shrink below ZS_MAX_ALLOC are
+ * kept as they are. Everything else goes into a zsmalloc pool that packs
+ * the compressed objects into shared slabs. The device's logical block is
+ * a page, so every transfer covers whole pages.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <lib/lz4.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/time.h>
+#include <drivers/block/block.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/zram.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+#include <mm/zsmalloc.h>
+
+static int zram_read(block_device_t *device, uint64_t offset, size_t size, void *buffer);
+static int zram_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer);
+static int zram_ioctl(block_device_t *device, unsigned int cmd, void *arg);
+
+static block_device_ops_t zram_ops = {
+    .read = zram_read,
+    .write = zram_write,
+    .ioctl = zram_ioctl
+};
+
+/* Created devices */
+static zram_t *zram_devices[ZRAM_MAX_DEVICES];
+
+/**
+ * Check whether a page is one 64-bit word repeated
+ * @param page Page contents
+ * @param value Output for the word
+ */
+static bool zram_page_same(const void *page, uint64_t *value) {
+    const uint64_t *words = (const uint64_t *)page;
+    uint64_t first = words[0];
+
+    for (size_t i = 1; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (words[i] != first) {
+            return false;
+        }
+    }
+    *value = first;
+    return true;
+}
+
+/**
+ * Release what a slot holds and make it read as zeroes
+ */
+static void zram_slot_free(zram_t *zram, zram_slot_t *slot) {
+    zram_stats_t *st = &zram->stats;
+
+    if (slot->flags & ZRAM_SAME) {
+        if (slot->value == 0) {
+            st->zero_pages--;
+        } else {
+            st->same_pages--;
+        }
+        st->pages_stored--;
+    } else if (slot->flags & ZRAM_HUGE) {
+        pmm_free_pages(virt_to_phys(slot->page), 1);
+        st->huge_pages--;
+        st->pages_stored--;
+    } else if (slot->handle) {
+        zs_free(&zram->pool, slot->handle);
+        st->compr_bytes -= slot->size;
+        st->pages_stored--;
+    }
+
+    slot->handle = 0;
+    slot->size = 0;
+    slot->flags = 0;
+}
+
+/**
+ * Read one page of the device
+ * @return 0 on success, negative if the stored object is corrupt
+ */
+static int zram_read_page(zram_t *zram, uint64_t index, void *page) {
+    zram_slot_t *slot = &zram->slots[index];
+    zram_stats_t *st = &zram->stats;
+    st->reads++;
+
+    if (slot->flags & ZRAM_SAME) {
+        uint64_t *words = (uint64_t *)page;
+        for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+            words[i] = slot->value;
+        }
+        return 0;
+    }
+    if (slot->flags & ZRAM_HUGE) {
+        memcpy(page, slot->page, PAGE_SIZE);
+        return 0;
+    }
+    if (!slot->handle) {
+        memset(page, 0, PAGE_SIZE);
+        return 0;
+    }
+
+    uint64_t start = time_now_ns();
+    int len = lz4_decompress(zs_map(slot->handle), slot->size, page, PAGE_SIZE);
+    st->decompress_ns += time_now_ns() - start;
+    st->decompressed++;
+
+    if (len != PAGE_SIZE) {
+        st->failed_reads++;
+        kerr("ZRAM: %s: Page %lu is corrupt\n", zram->block.name, index);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write one page of the device, replacing what the slot held
+ * @return 0 on success, negative if there is no memory to store it
+ */
+static int zram_write_page(zram_t *zram, uint64_t index, const void *page) {
+    zram_slot_t *slot = &zram->slots[index];
+    zram_stats_t *st = &zram->stats;
+    st->writes++;
+
+    uint64_t value;
+    if (zram_page_same(page, &value)) {
+        zram_slot_free(zram, slot);
+        slot->value = value;
+        slot->flags = ZRAM_SAME;
+        if (value == 0) {
+            st->zero_pages++;
+        } else {
+            st->same_pages++;
+        }
+        st->pages_stored++;
+        return 0;
+    }
+
+    uint64_t start = time_now_ns();
+    size_t len = lz4_compress(page, PAGE_SIZE, zram->buffer, ZS_MAX_ALLOC, zram->work);
+    st->compress_ns += time_now_ns() - start;
+    st->compressed++;
+
+    /* Store the new copy before dropping the old, so a failure loses nothing */
+    if (len == 0) {
+        uint64_t phys = pmm_alloc_pages(1);
+        if (!phys) {
+            st->failed_writes++;
+            return -1;
+        }
+        void *copy = phys_to_virt(phys);
+        memcpy(copy, page, PAGE_SIZE);
+
+        zram_slot_free(zram, slot);
+        slot->page = copy;
+        slot->flags = ZRAM_HUGE;
+        st->huge_pages++;
+        st->pages_stored++;
+        return 0;
+    }
+
+    uint64_t handle = zs_malloc(&zram->pool, len);
+    if (!handle) {
+        st->failed_writes++;
+        return -1;
+    }
+    memcpy(zs_map(handle), zram->buffer, len);
+
+    zram_slot_free(zram, slot);
+    slot->handle = handle;
+    slot->size = (uint16_t)len;
+    st->compr_bytes += len;
+    st->pages_stored++;
+    return 0;
+}
+
+/**
+ * Check that a transfer covers whole pages inside the device
+ */
+static inline int zram_check(zram_t *zram, uint64_t offset, size_t size) {
+    if ((offset | size) & (PAGE_SIZE - 1) || offset / PAGE_SIZE + size / PAGE_SIZE > zram->nr_pages) {
+        return -1;
+    }
+    return 0;
+}
+
+static int zram_read(block_device_t *device, uint64_t offset, size_t size, void *buffer) {
+    if (!device || !buffer) {
+        return -1;
+    }
+
+    zram_t *zram = (zram_t *)device->private_data;
+    if (zram_check(zram, offset, size) < 0) {
+        return -1;
+    }
+
+    uint8_t *data = (uint8_t *)buffer;
+    for (size_t done = 0; done < size; done += PAGE_SIZE) {
+        if (zram_read_page(zram, (offset + done) / PAGE_SIZE, data + done) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int zram_write(block_device_t *device, uint64_t offset, size_t size, const void *buffer) {
+    if (!device || !buffer) {
+        return -1;
+    }
+
+    zram_t *zram = (zram_t *)device->private_data;
+    if (zram_check(zram, offset, size) < 0) {
+        return -1;
+    }
+
+    const uint8_t *data = (const uint8_t *)buffer;
+    for (size_t done = 0; done < size; done += PAGE_SIZE) {
+        if (zram_write_page(zram, (offset + done) / PAGE_SIZE, data + done) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int zram_ioctl(block_device_t *device, unsigned int cmd, void *arg) {
+    return -1;
+}
+
+/**
+ * Create a compressed RAM disk; memory is only used for what is written
+ * @param size Device size in bytes (rounded down to whole pages)
+ * @return The registered device, or NULL on failure
+ */
+block_device_t *zram_create(uint64_t size) {
+    int slot = -1;
+    for (int i = 0; i < ZRAM_MAX_DEVICES; i++) {
+        if (!zram_devices[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0 || size < PAGE_SIZE) {
+        return NULL;
+    }
+
+    zram_t *zram = (zram_t *)kzalloc(sizeof(zram_t));
+    if (!zram) {
+        return NULL;
+    }
+
+    zram->nr_pages = size / PAGE_SIZE;
+    zram->slots = (zram_slot_t *)kzalloc(zram->nr_pages * sizeof(zram_slot_t));
+    zram->work = kmalloc(LZ4_WORK_SIZE);
+    zram->buffer = (uint8_t *)kmalloc(ZS_MAX_ALLOC);
+    if (!zram->slots || !zram->work || !zram->buffer) {
+        kfree(zram->slots);
+        kfree(zram->work);
+        kfree(zram->buffer);
+        kfree(zram);
+        return NULL;
+    }
+    zs_pool_init(&zram->pool);
+
+    ksnprintf(zram->block.name, sizeof(zram->block.name), "zram%d", slot);
+    zram->block.size = zram->nr_pages * PAGE_SIZE;
+    zram->block.block_size = PAGE_SIZE;
+    zram->block.private_data = zram;
+    zram->block.ops = &zram_ops;
+    if (block_device_register(&zram->block) < 0) {
+        kfree(zram->slots);
+        kfree(zram->work);
+        kfree(zram->buffer);
+        kfree(zram);
+        return NULL;
+    }
+
+    /* Whole pages only, so a write never has to decompress what it overwrites */
+    zram->block.queue->logical_block_size = PAGE_SIZE;
+
+    zram_devices[slot] = zram;
+    kprintf("ZRAM: %s: %lu MiB, LZ4\n", zram->block.name, zram->block.size / (1024 * 1024));
+    return &zram->block;
+}
+
+/**
+ * Look up the zram device behind a block device
+ */
+static int zram_find(block_device_t *device) {
+    for (int i = 0; i < ZRAM_MAX_DEVICES; i++) {
+        if (zram_devices[i] && &zram_devices[i]->block == device) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Free a compressed RAM disk and everything stored on it
+ * @param device Device returned by zram_create
+ * @return 0 on success, negative if it is not a zram device
+ */
+int zram_destroy(block_device_t *device) {
+    int slot = zram_find(device);
+    if (slot < 0) {
+        return -1;
+    }
+
+    zram_t *zram = zram_devices[slot];
+    zram_devices[slot] = NULL;
+    block_device_unregister(&zram->block);
+
+    for (uint64_t i = 0; i < zram->nr_pages; i++) {
+        if (zram->slots[i].flags & ZRAM_HUGE) {
+            pmm_free_pages(virt_to_phys(zram->slots[i].page), 1);
+        }
+    }
+    zs_pool_destroy(&zram->pool);
+    kfree(zram->slots);
+    kfree(zram->work);
+    kfree(zram->buffer);
+    kfree(zram);
+    return 0;
+}
+
+/**
+ * Print compression ratio, memory use and throughput of a zram device
+ * @param device Device returned by zram_create
+ */
+void zram_print_stats(block_device_t *device) {
+    int slot = zram_find(device);
+    if (slot < 0) {
+        return;
+    }
+
+    zram_t *zram = zram_devices[slot];
+    zram_stats_t *st = &zram->stats;
+
+    /* Pages that went through the compressor, and what they take now */
+    uint64_t compr_pages = st->pages_stored - st->zero_pages - st->same_pages - st->huge_pages;
+    uint64_t orig = (compr_pages + st->huge_pages) * PAGE_SIZE;
+    uint64_t stored = st->compr_bytes + st->huge_pages * PAGE_SIZE;
+    uint64_t used = (zram->pool.pages + st->huge_pages) * PAGE_SIZE;
+    uint64_t ratio = stored ? orig * 100 / stored : 0;
+
+    kprintf("ZRAM: %s: %lu pages stored (%lu zero, %lu same-filled, %lu incompressible)\n",
+            device->name, st->pages_stored, st->zero_pages, st->same_pages, st->huge_pages);
+    kprintf("ZRAM: %s: %lu KiB -> %lu KiB compressed, ratio %lu.%02lu, %lu KiB of memory used\n",
+            device->name, orig / 1024, stored / 1024, ratio / 100, ratio % 100, used / 1024);
+
+    uint64_t compress_mbs = st->compress_ns ?
+                            st->compressed * PAGE_SIZE * 1000 / st->compress_ns : 0;
+    uint64_t decompress_mbs = st->decompress_ns ?
+                              st->decompressed * PAGE_SIZE * 1000 / st->decompress_ns : 0;
+    kprintf("ZRAM: %s: %lu reads, %lu writes, compress %lu MB/s, decompress %lu MB/s, %lu failed\n",
+            device->name, st->reads, st->writes, compress_mbs, decompress_mbs,
+            st->failed_reads + st->failed_writes);
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Compressed RAM block devices
+ */
+
+#ifndef _DRIVERS_BLOCK_ZRAM_H
+#define _DRIVERS_BLOCK_ZRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/block/block.h>
+#include <mm/zsmalloc.h>
+
+/* Maximum number of zram devices */
+#define ZRAM_MAX_DEVICES    4
+
+/* Slot flags */
+#define ZRAM_SAME           (1U << 0)   /* Every word of the page holds value */
+#define ZRAM_HUGE           (1U << 1)   /* Did not compress; stored as a page of its own */
+
+/* Where one page of the device is stored; an empty slot reads as zeroes */
+typedef struct zram_slot {
+    union {
+        uint64_t handle;        /* zsmalloc object */
+        void *page;             /* Uncompressed copy (ZRAM_HUGE) */
+        uint64_t value;         /* Fill word (ZRAM_SAME) */
+    };
+    uint16_t size;              /* Compressed bytes */
+    uint16_t flags;             /* ZRAM_* */
+} zram_slot_t;
+
+/* Statistics */
+typedef struct zram_stats {
+    uint64_t reads;             /* Pages read */
+    uint64_t writes;            /* Pages written */
+    uint64_t pages_stored;      /* Pages holding data */
+    uint64_t zero_pages;        /* Stored pages that are all zeroes */
+    uint64_t same_pages;        /* Stored pages filled with another repeated word */
+    uint64_t huge_pages;        /* Stored pages that did not compress */
+    uint64_t compr_bytes;       /* Bytes of compressed data stored */
+    uint64_t failed_reads;      /* Corrupt objects found */
+    uint64_t failed_writes;     /* Writes that found no memory */
+    uint64_t compress_ns;       /* Time spent compressing */
+    uint64_t compressed;        /* Pages compressed */
+    uint64_t decompress_ns;     /* Time spent decompressing */
+    uint64_t decompressed;      /* Pages decompressed */
+} zram_stats_t;
+
+/* Compressed RAM disk */
+typedef struct zram {
+    uint64_t nr_pages;          /* Device size in pages */
+    zram_slot_t *slots;         /* One per page */
+    zs_pool_t pool;             /* Compressed objects */
+    void *work;                 /* Compressor scratch memory */
+    uint8_t *buffer;            /* Compression output */
+    zram_stats_t stats;
+    block_device_t block;       /* Registered block device */
+} zram_t;
+
+/**
+ * Create a compressed RAM disk; memory is only used for what is written
+ * @param size Device size in bytes (rounded down to whole pages)
+ * @return The registered device, or NULL on failure
+ */
+block_device_t *zram_create(uint64_t size);
+
+/**
+ * Free a compressed RAM disk and everything stored on it
+ * @param device Device returned by zram_create
+ * @return 0 on success, negative if it is not a zram device
+ */
+int zram_destroy(block_device_t *device);
+
+/**
+ * Print compression ratio, memory use and throughput of a zram device
+ * @param device Device returned by zram_create
+ */
+void zram_print_stats(block_device_t *device);
+
+#endif /* _DRIVERS_BLOCK_ZRAM_H */
\ No newline at end of file
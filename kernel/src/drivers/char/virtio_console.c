@@ -0,0 +1,553 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Virtio console driver
+ *
+ * The kernel log and binary trace dumps leave the guest through
+ * virtio-serial ports instead of the UART. With MULTIPORT the host names
+ * its ports; "freecore.log" receives the log and "freecore.trace" receives
+ * trace records, otherwise the first and second ports are used in that
+ * order. Each port transmits from a few page-list buffers handed to the
+ * device as scatter-gather chains, so a single notification moves up to
+ * VIRTIO_CONSOLE_TX_PAGES pages. Writes land in the buffer being filled
+ * and it is submitted immediately only when nothing else is in flight;
+ * otherwise data accumulates until the buffer fills or the previous one
+ * completes. Interrupts are not routed yet, so completions and control
+ * messages are polled with device interrupts suppressed.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/config.h>
+#include <drivers/driversys.h>
+#include <drivers/pci/pci.h>
+#include <drivers/virtio/virtio.h>
+#include <drivers/char/virtio_console.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+
+/* Upper bound on descriptors per virtqueue */
+#define VIRTIO_CONSOLE_QUEUE_SIZE       64
+
+/* Control queue indices */
+#define VIRTIO_CONSOLE_CTRL_RX_QUEUE    2
+#define VIRTIO_CONSOLE_CTRL_TX_QUEUE    3
+
+/* Port discovery ends after this long without a control message */
+#define VIRTIO_CONSOLE_QUIET_NS         (50ULL * 1000000ULL)
+#define VIRTIO_CONSOLE_DISCOVERY_NS     (500ULL * 1000000ULL)
+
+/* Time to wait for the host to return a buffer before dropping data */
+#define VIRTIO_CONSOLE_TX_TIMEOUT_NS    (100ULL * 1000000ULL)
+
+static int virtio_console_probe_driver(device_driver_t *driver);
+static int virtio_console_remove_driver(device_driver_t *driver);
+
+/* Define the virtio console driver */
+static driver_ops_t virtio_console_driver_ops = {
+    .probe = virtio_console_probe_driver,
+    .remove = virtio_console_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t virtio_console_driver = {
+    .name = "virtio_console",
+    .device_class = DEVICE_CLASS_UNKNOWN,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &virtio_console_driver_ops,
+    .private_data = NULL
+};
+
+/* Driven device; only the first one is used */
+static virtio_console_t *virtio_console = NULL;
+
+/**
+ * Get the transmit queue index of a port
+ */
+static uint16_t virtio_console_tx_queue(uint32_t id) {
+    return id == 0 ? 1 : (uint16_t)(2 * id + 3);
+}
+
+/**
+ * Return finished transmit buffers to their port
+ */
+static void virtio_console_reap(virtio_console_port_t *port) {
+    virtio_console_buffer_t *buf;
+
+    while ((buf = (virtio_console_buffer_t *)virtqueue_get_buf(port->tx, NULL)) != NULL) {
+        buf->in_flight = false;
+        buf->used = 0;
+        port->in_flight--;
+    }
+}
+
+/**
+ * Hand the buffer being filled to the device as one scatter-gather chain
+ */
+static void virtio_console_submit(virtio_console_port_t *port) {
+    virtio_console_buffer_t *buf = &port->buffers[port->fill];
+    virtio_sg_t sg[VIRTIO_CONSOLE_TX_PAGES];
+    uint16_t count = 0;
+
+    for (size_t done = 0; done < buf->used; done += PAGE_SIZE) {
+        sg[count].addr = buf->phys[count];
+        sg[count].len = (uint32_t)(buf->used - done < PAGE_SIZE ? buf->used - done : PAGE_SIZE);
+        sg[count].device_writes = false;
+        count++;
+    }
+
+    if (virtqueue_add(port->tx, sg, count, buf) < 0) {
+        return;
+    }
+    virtqueue_kick(port->tx);
+
+    buf->in_flight = true;
+    port->in_flight++;
+    port->submissions++;
+    port->bytes += buf->used;
+    port->fill = (port->fill + 1) % VIRTIO_CONSOLE_TX_BUFFERS;
+}
+
+/**
+ * Copy data to a port, waiting for the host when every buffer is in flight
+ * @return Bytes accepted
+ */
+static size_t virtio_console_write(virtio_console_port_t *port, const void *data, size_t len) {
+    const uint8_t *src = (const uint8_t *)data;
+    size_t done = 0;
+
+    uint64_t flags = cpu_irq_save();
+    virtio_console_reap(port);
+
+    while (done < len) {
+        virtio_console_buffer_t *buf = &port->buffers[port->fill];
+
+        if (buf->in_flight) {
+            uint64_t deadline = time_now_ns() + VIRTIO_CONSOLE_TX_TIMEOUT_NS;
+            while (buf->in_flight && time_now_ns() < deadline) {
+                cpu_relax();
+                virtio_console_reap(port);
+            }
+            if (buf->in_flight) {
+                port->dropped += len - done;
+                break;
+            }
+        }
+
+        size_t page = buf->used / PAGE_SIZE;
+        size_t offset = buf->used % PAGE_SIZE;
+        size_t chunk = len - done < PAGE_SIZE - offset ? len - done : PAGE_SIZE - offset;
+        memcpy(buf->pages[page] + offset, src + done, chunk);
+        buf->used += chunk;
+        done += chunk;
+
+        if (buf->used == (size_t)VIRTIO_CONSOLE_TX_PAGES * PAGE_SIZE) {
+            virtio_console_submit(port);
+        }
+    }
+
+    /* Start the device right away if it is idle, otherwise keep batching */
+    if (port->in_flight == 0 && port->buffers[port->fill].used) {
+        virtio_console_submit(port);
+    }
+
+    cpu_irq_restore(flags);
+    return done;
+}
+
+/**
+ * Send a control message and wait for the device to consume it
+ */
+static void virtio_console_send_control(virtio_console_t *con, uint32_t id, uint16_t event, uint16_t value) {
+    size_t offset = VIRTIO_CONSOLE_CTRL_BUFFERS * VIRTIO_CONSOLE_CTRL_BUFFER_SIZE;
+    virtio_console_control_t *msg = (virtio_console_control_t *)(con->ctrl_buf + offset);
+
+    msg->id = id;
+    msg->event = event;
+    msg->value = value;
+
+    virtio_sg_t sg = { con->ctrl_phys + offset, sizeof(*msg), false };
+    if (virtqueue_add(con->ctrl_tx, &sg, 1, msg) < 0) {
+        return;
+    }
+    virtqueue_kick(con->ctrl_tx);
+
+    uint64_t deadline = time_now_ns() + VIRTIO_CONSOLE_TX_TIMEOUT_NS;
+    while (!virtqueue_get_buf(con->ctrl_tx, NULL) && time_now_ns() < deadline) {
+        cpu_relax();
+    }
+}
+
+/**
+ * Decide what a port is used for once it has a name
+ */
+static void virtio_console_assign(virtio_console_t *con, virtio_console_port_t *port) {
+    virtio_console_port_t **role = NULL;
+
+    if (con->log == port || con->trace == port) {
+        return;
+    }
+    if (strcmp(port->name, VIRTIO_CONSOLE_LOG_NAME) == 0) {
+        role = &con->log;
+    } else if (strcmp(port->name, VIRTIO_CONSOLE_TRACE_NAME) == 0) {
+        role = &con->trace;
+    } else if (!con->log) {
+        role = &con->log;
+    } else if (!con->trace) {
+        role = &con->trace;
+    }
+    if (!role || *role) {
+        return;
+    }
+
+    if (!port->buffers) {
+        port->buffers = (virtio_console_buffer_t *)kzalloc(VIRTIO_CONSOLE_TX_BUFFERS * sizeof(virtio_console_buffer_t));
+        if (!port->buffers) {
+            return;
+        }
+        for (int i = 0; i < VIRTIO_CONSOLE_TX_BUFFERS; i++) {
+            for (int j = 0; j < VIRTIO_CONSOLE_TX_PAGES; j++) {
+                port->buffers[i].pages[j] = (uint8_t *)pmm_alloc_dma(1, &port->buffers[i].phys[j]);
+                if (!port->buffers[i].pages[j]) {
+                    kerr("VIRTIO-CONSOLE: Out of memory for port %u buffers\n", port->id);
+                    return;
+                }
+            }
+        }
+    }
+
+    *role = port;
+    if (con->multiport) {
+        virtio_console_send_control(con, port->id, VIRTIO_CONSOLE_PORT_OPEN, 1);
+    }
+}
+
+/**
+ * Handle one control message from the device
+ */
+static void virtio_console_control(virtio_console_t *con, const virtio_console_control_t *msg, uint32_t len) {
+    virtio_console_port_t *port = msg->id < con->nr_ports ? &con->ports[msg->id] : NULL;
+
+    switch (msg->event) {
+        case VIRTIO_CONSOLE_DEVICE_ADD:
+            /* Ports beyond the configured transmit queues are refused */
+            virtio_console_send_control(con, msg->id, VIRTIO_CONSOLE_PORT_READY, port ? 1 : 0);
+            if (port) {
+                port->added = true;
+            }
+            break;
+
+        case VIRTIO_CONSOLE_DEVICE_REMOVE:
+            if (port) {
+                port->added = false;
+                port->host_open = false;
+                if (con->log == port) {
+                    con->log = NULL;
+                }
+                if (con->trace == port) {
+                    con->trace = NULL;
+                }
+            }
+            break;
+
+        case VIRTIO_CONSOLE_PORT_NAME:
+            if (port && port->added) {
+                size_t name_len = len - sizeof(*msg);
+                if (name_len > sizeof(port->name) - 1) {
+                    name_len = sizeof(port->name) - 1;
+                }
+                memcpy(port->name, (const char *)(msg + 1), name_len);
+                port->name[name_len] = '\0';
+                virtio_console_assign(con, port);
+            }
+            break;
+
+        case VIRTIO_CONSOLE_CONSOLE_PORT:
+            if (port && port->added) {
+                virtio_console_assign(con, port);
+            }
+            break;
+
+        case VIRTIO_CONSOLE_PORT_OPEN:
+            if (port) {
+                port->host_open = msg->value != 0;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Handle pending control messages and repost their buffers
+ * @return Number of messages handled
+ */
+static uint32_t virtio_console_poll_control(virtio_console_t *con) {
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t handled = 0;
+
+    while ((buf = (uint8_t *)virtqueue_get_buf(con->ctrl_rx, &len)) != NULL) {
+        if (len >= sizeof(virtio_console_control_t) && len <= VIRTIO_CONSOLE_CTRL_BUFFER_SIZE) {
+            virtio_console_control(con, (const virtio_console_control_t *)buf, len);
+        }
+
+        virtio_sg_t sg = { con->ctrl_phys + (uint64_t)(buf - con->ctrl_buf), VIRTIO_CONSOLE_CTRL_BUFFER_SIZE, true };
+        virtqueue_add(con->ctrl_rx, &sg, 1, buf);
+        handled++;
+    }
+
+    if (handled) {
+        virtqueue_kick(con->ctrl_rx);
+    }
+    return handled;
+}
+
+/**
+ * Set up the control queues and post their receive buffers
+ */
+static int virtio_console_init_control(virtio_console_t *con) {
+    con->ctrl_rx = virtio_setup_queue(&con->vdev, VIRTIO_CONSOLE_CTRL_RX_QUEUE, VIRTIO_CONSOLE_QUEUE_SIZE);
+    con->ctrl_tx = virtio_setup_queue(&con->vdev, VIRTIO_CONSOLE_CTRL_TX_QUEUE, VIRTIO_CONSOLE_QUEUE_SIZE);
+    con->ctrl_buf = (uint8_t *)pmm_alloc_dma(1, &con->ctrl_phys);
+    if (!con->ctrl_rx || !con->ctrl_tx || !con->ctrl_buf) {
+        return -1;
+    }
+    virtqueue_disable_cb(con->ctrl_rx);
+    virtqueue_disable_cb(con->ctrl_tx);
+
+    for (int i = 0; i < VIRTIO_CONSOLE_CTRL_BUFFERS; i++) {
+        uint64_t offset = (uint64_t)i * VIRTIO_CONSOLE_CTRL_BUFFER_SIZE;
+        virtio_sg_t sg = { con->ctrl_phys + offset, VIRTIO_CONSOLE_CTRL_BUFFER_SIZE, true };
+        virtqueue_add(con->ctrl_rx, &sg, 1, con->ctrl_buf + offset);
+    }
+    virtqueue_kick(con->ctrl_rx);
+    return 0;
+}
+
+/**
+ * Bring up one virtio console PCI function
+ */
+static int virtio_console_attach(pci_device_t *pci) {
+    virtio_console_t *con = (virtio_console_t *)kzalloc(sizeof(virtio_console_t));
+    if (!con) {
+        return -1;
+    }
+
+    if (virtio_pci_init(&con->vdev, pci) < 0) {
+        kfree(con);
+        return -1;
+    }
+
+    uint64_t wanted = (1ULL << VIRTIO_F_RING_INDIRECT_DESC) |
+                      (1ULL << VIRTIO_F_RING_EVENT_IDX) |
+                      (1ULL << VIRTIO_CONSOLE_F_MULTIPORT);
+    if (virtio_negotiate_features(&con->vdev, wanted) < 0) {
+        virtio_fail(&con->vdev);
+        kfree(con);
+        return -1;
+    }
+
+    volatile virtio_console_config_t *cfg = (volatile virtio_console_config_t *)con->vdev.device_cfg;
+    con->multiport = cfg && virtio_has_feature(&con->vdev, VIRTIO_CONSOLE_F_MULTIPORT);
+    con->nr_ports = 1;
+    if (con->multiport) {
+        con->nr_ports = cfg->max_nr_ports < VIRTIO_CONSOLE_MAX_PORTS ? cfg->max_nr_ports : VIRTIO_CONSOLE_MAX_PORTS;
+    }
+
+    for (uint32_t id = 0; id < con->nr_ports; id++) {
+        virtio_console_port_t *port = &con->ports[id];
+        uint16_t index = virtio_console_tx_queue(id);
+
+        port->con = con;
+        port->id = id;
+        if (index >= virtio_num_queues(&con->vdev) ||
+            !(port->tx = virtio_setup_queue(&con->vdev, index, VIRTIO_CONSOLE_QUEUE_SIZE))) {
+            con->nr_ports = id;
+            break;
+        }
+        virtqueue_disable_cb(port->tx);
+    }
+
+    if (con->nr_ports == 0 || (con->multiport && virtio_console_init_control(con) < 0)) {
+        virtio_fail(&con->vdev);
+        kfree(con);
+        return -1;
+    }
+
+    virtio_driver_ok(&con->vdev);
+
+    if (con->multiport) {
+        /* Ports are announced over the control queue once the driver is ready */
+        virtio_console_send_control(con, 0, VIRTIO_CONSOLE_DEVICE_READY, 1);
+
+        uint64_t start = time_now_ns();
+        uint64_t quiet = start + VIRTIO_CONSOLE_QUIET_NS;
+        while (time_now_ns() < quiet && time_now_ns() < start + VIRTIO_CONSOLE_DISCOVERY_NS) {
+            if (virtio_console_poll_control(con)) {
+                quiet = time_now_ns() + VIRTIO_CONSOLE_QUIET_NS;
+            }
+            cpu_relax();
+        }
+    } else {
+        con->ports[0].added = true;
+        con->ports[0].host_open = true;
+        virtio_console_assign(con, &con->ports[0]);
+    }
+
+    kprintf("VIRTIO-CONSOLE: %u port(s)%s%s, log on %s, trace on %s\n",
+            con->nr_ports,
+            con->multiport ? ", multiport" : "",
+            virtio_has_feature(&con->vdev, VIRTIO_F_RING_INDIRECT_DESC) ? ", indirect" : "",
+            con->log ? (con->log->name[0] ? con->log->name : "port 0") : "none",
+            con->trace ? (con->trace->name[0] ? con->trace->name : "unnamed port") : "none");
+
+    virtio_console = con;
+    return 0;
+}
+
+/**
+ * Copy a string to the log port, if there is one
+ * @param str NUL-terminated string
+ */
+void virtio_console_log_write(const char *str) {
+    if (virtio_console && virtio_console->log) {
+        virtio_console_write(virtio_console->log, str, strlen(str));
+    }
+}
+
+/**
+ * Check whether a trace port is connected
+ */
+bool virtio_console_trace_ready(void) {
+    return virtio_console && virtio_console->trace;
+}
+
+/**
+ * Copy binary data to the trace port
+ * @param data Data
+ * @param len Length in bytes
+ * @return Bytes accepted (less than len if the host stopped reading)
+ */
+size_t virtio_console_trace_write(const void *data, size_t len) {
+    if (!virtio_console_trace_ready()) {
+        return 0;
+    }
+    return virtio_console_write(virtio_console->trace, data, len);
+}
+
+/**
+ * Send partly filled buffers and handle control messages
+ */
+void virtio_console_flush(void) {
+    virtio_console_t *con = virtio_console;
+    if (!con) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    if (con->multiport) {
+        virtio_console_poll_control(con);
+    }
+
+    virtio_console_port_t *ports[] = { con->log, con->trace };
+    for (size_t i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        virtio_console_port_t *port = ports[i];
+        if (!port) {
+            continue;
+        }
+        virtio_console_reap(port);
+        if (port->in_flight == 0 && port->buffers[port->fill].used) {
+            virtio_console_submit(port);
+        }
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Print per-port transfer statistics
+ */
+void virtio_console_print_stats(void) {
+    virtio_console_t *con = virtio_console;
+    if (!con) {
+        return;
+    }
+
+    for (uint32_t id = 0; id < con->nr_ports; id++) {
+        virtio_console_port_t *port = &con->ports[id];
+        if (port != con->log && port != con->trace) {
+            continue;
+        }
+        kprintf("VIRTIO-CONSOLE: port %u (%s): %lu bytes in %lu buffers, %lu dropped, %lu notifications\n",
+                id, port == con->log ? "log" : "trace", port->bytes, port->submissions,
+                port->dropped, port->tx->notifications);
+    }
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int virtio_console_probe_driver(device_driver_t *driver) {
+    static const uint16_t ids[] = { VIRTIO_CONSOLE_PCI_DEVICE, VIRTIO_CONSOLE_PCI_TRANSITIONAL };
+
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]) && !virtio_console; i++) {
+        pci_device_t *pci;
+        for (int index = 0; !virtio_console && (pci = pci_find_device(VIRTIO_PCI_VENDOR, ids[i], index)) != NULL; index++) {
+            if (virtio_console_attach(pci) < 0) {
+                kerr("VIRTIO-CONSOLE: Failed to attach %02x:%02x.%x\n", pci->bus, pci->slot, pci->func);
+            }
+        }
+    }
+
+    if (!virtio_console) {
+        kprintf("VIRTIO-CONSOLE: No devices found\n");
+    }
+    driver->private_data = virtio_console;
+    return 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int virtio_console_remove_driver(device_driver_t *driver) {
+    (void)driver;
+
+    if (virtio_console) {
+        virtio_console_flush();
+        virtio_console->vdev.common->device_status = 0;
+        virtio_console = NULL;
+    }
+    return 0;
+}
+
+/**
+ * Register the virtio console driver
+ */
+void virtio_console_register_driver(void) {
+    device_driver_register(&virtio_console_driver);
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Virtio console driver
+ */
+
+#ifndef _DRIVERS_CHAR_VIRTIO_CONSOLE_H
+#define _DRIVERS_CHAR_VIRTIO_CONSOLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/virtio/virtio.h>
+
+/* PCI device IDs */
+#define VIRTIO_CONSOLE_PCI_DEVICE       (VIRTIO_PCI_MODERN_BASE + 3)
+#define VIRTIO_CONSOLE_PCI_TRANSITIONAL 0x1003
+
+/* Device feature bits */
+#define VIRTIO_CONSOLE_F_SIZE           0
+#define VIRTIO_CONSOLE_F_MULTIPORT      1
+
+/* Control events */
+#define VIRTIO_CONSOLE_DEVICE_READY     0
+#define VIRTIO_CONSOLE_DEVICE_ADD       1
+#define VIRTIO_CONSOLE_DEVICE_REMOVE    2
+#define VIRTIO_CONSOLE_PORT_READY       3
+#define VIRTIO_CONSOLE_CONSOLE_PORT     4
+#define VIRTIO_CONSOLE_RESIZE           5
+#define VIRTIO_CONSOLE_PORT_OPEN        6
+#define VIRTIO_CONSOLE_PORT_NAME        7
+
+/* Ports whose transmit queues are set up */
+#define VIRTIO_CONSOLE_MAX_PORTS        4
+
+/* Transmit buffers per port, each a scatter-gather list of pages */
+#define VIRTIO_CONSOLE_TX_BUFFERS       4
+#define VIRTIO_CONSOLE_TX_PAGES         16
+
+/* Receive buffers for control messages */
+#define VIRTIO_CONSOLE_CTRL_BUFFERS     8
+#define VIRTIO_CONSOLE_CTRL_BUFFER_SIZE 128
+
+/* Names of the ports the kernel writes to */
+#define VIRTIO_CONSOLE_LOG_NAME         "freecore.log"
+#define VIRTIO_CONSOLE_TRACE_NAME       "freecore.trace"
+
+/* Device configuration layout */
+typedef struct virtio_console_config {
+    uint16_t cols;
+    uint16_t rows;
+    uint32_t max_nr_ports;
+    uint32_t emerg_wr;
+} __attribute__((packed)) virtio_console_config_t;
+
+/* Control message; a PORT_NAME message is followed by the name */
+typedef struct virtio_console_control {
+    uint32_t id;
+    uint16_t event;
+    uint16_t value;
+} __attribute__((packed)) virtio_console_control_t;
+
+/* Transmit buffer */
+typedef struct virtio_console_buffer {
+    uint8_t *pages[VIRTIO_CONSOLE_TX_PAGES];
+    uint64_t phys[VIRTIO_CONSOLE_TX_PAGES];
+    size_t used;                /* Bytes filled */
+    bool in_flight;             /* Owned by the device */
+} virtio_console_buffer_t;
+
+struct virtio_console;
+
+/* Port */
+typedef struct virtio_console_port {
+    struct virtio_console *con;
+    uint32_t id;
+    virtqueue_t *tx;            /* Transmit queue */
+    bool added;                 /* Announced by the device */
+    bool host_open;             /* Host side is connected */
+    char name[32];
+
+    virtio_console_buffer_t *buffers; /* VIRTIO_CONSOLE_TX_BUFFERS, once the port is used */
+    uint32_t fill;              /* Buffer being filled */
+    uint32_t in_flight;         /* Buffers owned by the device */
+
+    /* Statistics */
+    uint64_t bytes;             /* Bytes handed to the device */
+    uint64_t submissions;       /* Buffers handed to the device */
+    uint64_t dropped;           /* Bytes dropped because the host stopped reading */
+} virtio_console_port_t;
+
+/* Device */
+typedef struct virtio_console {
+    virtio_device_t vdev;
+    bool multiport;
+    uint32_t nr_ports;          /* Ports with transmit queues */
+    virtqueue_t *ctrl_rx;
+    virtqueue_t *ctrl_tx;
+    uint8_t *ctrl_buf;          /* Receive buffers, then one message being sent */
+    uint64_t ctrl_phys;
+    virtio_console_port_t ports[VIRTIO_CONSOLE_MAX_PORTS];
+    virtio_console_port_t *log; /* Port receiving the kernel log */
+    virtio_console_port_t *trace; /* Port receiving binary trace data */
+} virtio_console_t;
+
+/**
+ * Copy a string to the log port, if there is one
+ * @param str NUL-terminated string
+ */
+void virtio_console_log_write(const char *str);
+
+/**
+ * Check whether a trace port is connected
+ */
+bool virtio_console_trace_ready(void);
+
+/**
+ * Copy binary data to the trace port
+ * @param data Data
+ * @param len Length in bytes
+ * @return Bytes accepted (less than len if the host stopped reading)
+ */
+size_t virtio_console_trace_write(const void *data, size_t len);
+
+/**
+ * Send partly filled buffers and handle control messages
+ */
+void virtio_console_flush(void);
+
+/**
+ * Print per-port transfer statistics
+ */
+void virtio_console_print_stats(void);
+
+/**
+ * Register the virtio console driver
+ */
+void virtio_console_register_driver(void);
+
+#endif /* _DRIVERS_CHAR_VIRTIO_CONSOLE_H */
\ No newline at end of file
@@ -0,0 +1,134 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Input event queue
+ *
+ * Input drivers report from their interrupt handlers into two rings: one of
+ * raw key, button and movement events and one of typed characters, for
+ * readers that only want text. Each ring has a single producer running with
+ * interrupts disabled; readers disable interrupts while taking entries.
+ * When a ring is full new entries are dropped and counted.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <drivers/input/input.h>
+
+static input_event_t event_queue[INPUT_EVENT_QUEUE];
+static uint32_t event_head = 0;     /* Next slot written */
+static uint32_t event_tail = 0;     /* Next slot read */
+
+static char char_queue[INPUT_CHAR_QUEUE];
+static uint32_t char_head = 0;
+static uint32_t char_tail = 0;
+
+static input_stats_t input_stats;
+
+/**
+ * Queue an input event; safe to call from interrupt handlers
+ * @param type Event type
+ * @param code Key, button or axis
+ * @param value Key state or movement
+ */
+void input_report(uint16_t type, uint16_t code, int32_t value) {
+    uint64_t flags = cpu_irq_save();
+
+    if (event_head - event_tail == INPUT_EVENT_QUEUE) {
+        input_stats.dropped++;
+    } else {
+        input_event_t *event = &event_queue[event_head % INPUT_EVENT_QUEUE];
+        event->time_ns = time_now_ns();
+        event->type = type;
+        event->code = code;
+        event->value = value;
+        event_head++;
+        input_stats.events++;
+    }
+
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Mark the end of the events from one device report
+ */
+void input_sync(void) {
+    input_report(INPUT_EV_SYN, 0, 0);
+}
+
+/**
+ * Queue a character typed on a keyboard
+ * @param c Character
+ */
+void input_report_char(char c) {
+    uint64_t flags = cpu_irq_save();
+
+    if (char_head - char_tail == INPUT_CHAR_QUEUE) {
+        input_stats.dropped++;
+    } else {
+        char_queue[char_head++ % INPUT_CHAR_QUEUE] = c;
+        input_stats.chars++;
+    }
+
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Take queued events
+ * @param events Output array
+ * @param max Size of the array
+ * @return Number of events taken
+ */
+size_t input_read(input_event_t *events, size_t max) {
+    size_t count = 0;
+    uint64_t flags = cpu_irq_save();
+
+    while (count < max && event_tail != event_head) {
+        events[count++] = event_queue[event_tail++ % INPUT_EVENT_QUEUE];
+    }
+
+    cpu_irq_restore(flags);
+    return count;
+}
+
+/**
+ * Take a typed character
+ * @return The character, or -1 if none is queued
+ */
+int input_getchar(void) {
+    int c = -1;
+    uint64_t flags = cpu_irq_save();
+
+    if (char_tail != char_head) {
+        c = (unsigned char)char_queue[char_tail++ % INPUT_CHAR_QUEUE];
+    }
+
+    cpu_irq_restore(flags);
+    return c;
+}
+
+/**
+ * Get queue statistics
+ * @param stats Output
+ */
+void input_get_stats(input_stats_t *stats) {
+    uint64_t flags = cpu_irq_save();
+    *stats = input_stats;
+    cpu_irq_restore(flags);
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Input event queue
+ */
+
+#ifndef _DRIVERS_INPUT_INPUT_H
+#define _DRIVERS_INPUT_INPUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Queue sizes (powers of two) */
+#define INPUT_EVENT_QUEUE   256
+#define INPUT_CHAR_QUEUE    64
+
+/* Event types */
+#define INPUT_EV_SYN        0x00    /* End of a group of events from one report */
+#define INPUT_EV_KEY        0x01    /* Key or button; value 1 pressed, 0 released */
+#define INPUT_EV_REL        0x02    /* Relative axis movement */
+
+/* Relative axes */
+#define INPUT_REL_X         0x00
+#define INPUT_REL_Y         0x01
+#define INPUT_REL_WHEEL     0x08
+
+/* Mouse buttons; keyboard keys use their USB HID usage IDs, which are below */
+#define INPUT_BTN_LEFT      0x110
+#define INPUT_BTN_RIGHT     0x111
+#define INPUT_BTN_MIDDLE    0x112
+
+/* Input event */
+typedef struct input_event {
+    uint64_t time_ns;           /* When the event was reported */
+    uint16_t type;              /* INPUT_EV_* */
+    uint16_t code;              /* Key, button or axis */
+    int32_t value;              /* Key state or movement */
+} input_event_t;
+
+/* Queue statistics */
+typedef struct input_stats {
+    uint64_t events;            /* Events queued */
+    uint64_t chars;             /* Characters queued */
+    uint64_t dropped;           /* Events and characters lost to a full queue */
+} input_stats_t;
+
+/**
+ * Queue an input event; safe to call from interrupt handlers
+ * @param type Event type
+ * @param code Key, button or axis
+ * @param value Key state or movement
+ */
+void input_report(uint16_t type, uint16_t code, int32_t value);
+
+/**
+ * Mark the end of the events from one device report
+ */
+void input_sync(void);
+
+/**
+ * Queue a character typed on a keyboard
+ * @param c Character
+ */
+void input_report_char(char c);
+
+/**
+ * Take queued events
+ * @param events Output array
+ * @param max Size of the array
+ * @return Number of events taken
+ */
+size_t input_read(input_event_t *events, size_t max);
+
+/**
+ * Take a typed character
+ * @return The character, or -1 if none is queued
+ */
+int input_getchar(void);
+
+/**
+ * Get queue statistics
+ * @param stats Output
+ */
+void input_get_stats(input_stats_t *stats);
+
+#endif /* _DRIVERS_INPUT_INPUT_H */
\ No newline at end of file
@@ -0,0 +1,432 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * PCI bus enumeration and configuration space access
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <drivers/driversys.h>
+#include <drivers/pci/pci.h>
+#include <mm/vmm.h>
+
+/* Configuration mechanism #1 ports */
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+
+static int pci_probe_driver(device_driver_t *driver);
+static int pci_remove_driver(device_driver_t *driver);
+
+/* Define the PCI bus driver */
+static driver_ops_t pci_driver_ops = {
+    .probe = pci_probe_driver,
+    .remove = pci_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t pci_driver = {
+    .name = "pci",
+    .device_class = DEVICE_CLASS_PCI,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &pci_driver_ops,
+    .private_data = NULL
+};
+
+/* Enumerated functions */
+static pci_device_t pci_devices[PCI_MAX_DEVICES];
+static int pci_device_count = 0;
+
+#ifdef __x86_64__
+/* IO port functions */
+static inline void outl(uint16_t port, uint32_t val) {
+    asm volatile ("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    asm volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+#endif
+
+/**
+ * Read a dword from configuration space by address
+ */
+static uint32_t pci_read_raw(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+#ifdef __x86_64__
+    uint32_t address = (1u << 31) | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) |
+                       ((uint32_t)func << 8) | (offset & 0xFC);
+    outl(PCI_CONFIG_ADDRESS, address);
+    return inl(PCI_CONFIG_DATA);
+#else
+    return 0xFFFFFFFF;
+#endif
+}
+
+/**
+ * Write a dword to configuration space by address
+ */
+static void pci_write_raw(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value) {
+#ifdef __x86_64__
+    uint32_t address = (1u << 31) | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) |
+                       ((uint32_t)func << 8) | (offset & 0xFC);
+    outl(PCI_CONFIG_ADDRESS, address);
+    outl(PCI_CONFIG_DATA, value);
+#endif
+}
+
+uint32_t pci_config_read32(pci_device_t *dev, uint8_t offset) {
+    return pci_read_raw(dev->bus, dev->slot, dev->func, offset);
+}
+
+uint16_t pci_config_read16(pci_device_t *dev, uint8_t offset) {
+    return (pci_config_read32(dev, offset) >> ((offset & 2) * 8)) & 0xFFFF;
+}
+
+uint8_t pci_config_read8(pci_device_t *dev, uint8_t offset) {
+    return (pci_config_read32(dev, offset) >> ((offset & 3) * 8)) & 0xFF;
+}
+
+void pci_config_write32(pci_device_t *dev, uint8_t offset, uint32_t value) {
+    pci_write_raw(dev->bus, dev->slot, dev->func, offset, value);
+}
+
+void pci_config_write16(pci_device_t *dev, uint8_t offset, uint16_t value) {
+    uint32_t shift = (offset & 2) * 8;
+    uint32_t dword = pci_config_read32(dev, offset);
+    dword = (dword & ~(0xFFFFu << shift)) | ((uint32_t)value << shift);
+    pci_config_write32(dev, offset, dword);
+}
+
+void pci_config_write8(pci_device_t *dev, uint8_t offset, uint8_t value) {
+    uint32_t shift = (offset & 3) * 8;
+    uint32_t dword = pci_config_read32(dev, offset);
+    dword = (dword & ~(0xFFu << shift)) | ((uint32_t)value << shift);
+    pci_config_write32(dev, offset, dword);
+}
+
+/**
+ * Decode and size the BARs of a function
+ * @param dev PCI function
+ */
+static void pci_read_bars(pci_device_t *dev) {
+    uint16_t command = pci_config_read16(dev, PCI_COMMAND);
+
+    /* Disable decoding while the BARs are being sized */
+    pci_config_write16(dev, PCI_COMMAND, command & ~(PCI_COMMAND_IO | PCI_COMMAND_MEMORY));
+
+    for (int i = 0; i < 6; i++) {
+        uint8_t offset = PCI_BAR0 + i * 4;
+        uint32_t bar = pci_config_read32(dev, offset);
+
+        pci_config_write32(dev, offset, 0xFFFFFFFF);
+        uint32_t mask = pci_config_read32(dev, offset);
+        pci_config_write32(dev, offset, bar);
+
+        if (mask == 0 || mask == 0xFFFFFFFF) {
+            continue;
+        }
+
+        if (bar & 0x1) {
+            /* I/O port BAR */
+            dev->bar_is_io[i] = true;
+            dev->bar[i] = bar & ~0x3u;
+            dev->bar_size[i] = (~(mask & ~0x3u) + 1) & 0xFFFF;
+            continue;
+        }
+
+        uint64_t base = bar & ~0xFu;
+        uint64_t size_mask = 0xFFFFFFFF00000000ULL | (mask & ~0xFu);
+
+        /* 64-bit memory BAR spans two slots */
+        if (((bar >> 1) & 0x3) == 0x2 && i < 5) {
+            uint32_t bar_hi = pci_config_read32(dev, offset + 4);
+            pci_config_write32(dev, offset + 4, 0xFFFFFFFF);
+            uint32_t mask_hi = pci_config_read32(dev, offset + 4);
+            pci_config_write32(dev, offset + 4, bar_hi);
+
+            base |= (uint64_t)bar_hi << 32;
+            size_mask = ((uint64_t)mask_hi << 32) | (mask & ~0xFu);
+            dev->bar[i] = base;
+            dev->bar_size[i] = ~size_mask + 1;
+            i++;
+            continue;
+        }
+
+        dev->bar[i] = base;
+        dev->bar_size[i] = ~size_mask + 1;
+    }
+
+    pci_config_write16(dev, PCI_COMMAND, command);
+}
+
+/**
+ * Record a function found during the bus scan
+ */
+static void pci_add_function(uint8_t bus, uint8_t slot, uint8_t func) {
+    if (pci_device_count >= PCI_MAX_DEVICES) {
+        return;
+    }
+
+    pci_device_t *dev = &pci_devices[pci_device_count++];
+    memset(dev, 0, sizeof(*dev));
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+
+    uint32_t id = pci_config_read32(dev, PCI_VENDOR_ID);
+    dev->vendor_id = id & 0xFFFF;
+    dev->device_id = id >> 16;
+
+    uint32_t class_reg = pci_config_read32(dev, PCI_REVISION_ID);
+    dev->revision = class_reg & 0xFF;
+    dev->prog_if = (class_reg >> 8) & 0xFF;
+    dev->subclass = (class_reg >> 16) & 0xFF;
+    dev->class_code = (class_reg >> 24) & 0xFF;
+    dev->irq_line = pci_config_read8(dev, PCI_INTERRUPT_LINE);
+
+    /* Only type 0 headers carry six BARs */
+    if ((pci_config_read8(dev, PCI_HEADER_TYPE) & 0x7F) == 0) {
+        pci_read_bars(dev);
+    }
+
+    kprintf("PCI: %02x:%02x.%x %04x:%04x class %02x.%02x.%02x\n",
+            bus, slot, func, dev->vendor_id, dev->device_id,
+            dev->class_code, dev->subclass, dev->prog_if);
+}
+
+/**
+ * Enumerate the PCI bus
+ * @return Number of functions found, negative on error
+ */
+int pci_init(void) {
+    kprintf("PCI: Enumerating devices\n");
+
+    pci_device_count = 0;
+
+    for (uint16_t bus = 0; bus < 256; bus++) {
+        for (uint8_t slot = 0; slot < 32; slot++) {
+            uint32_t id = pci_read_raw(bus, slot, 0, PCI_VENDOR_ID);
+            if ((id & 0xFFFF) == 0xFFFF) {
+                continue;
+            }
+
+            uint8_t header = (pci_read_raw(bus, slot, 0, PCI_HEADER_TYPE) >> 16) & 0xFF;
+            uint8_t funcs = (header & 0x80) ? 8 : 1;
+
+            for (uint8_t func = 0; func < funcs; func++) {
+                id = pci_read_raw(bus, slot, func, PCI_VENDOR_ID);
+                if ((id & 0xFFFF) != 0xFFFF) {
+                    pci_add_function(bus, slot, func);
+                }
+            }
+        }
+    }
+
+    kprintf("PCI: Found %d functions\n", pci_device_count);
+    return pci_device_count;
+}
+
+/**
+ * Find a PCI function by vendor and device ID
+ * @param vendor_id Vendor ID to match
+ * @param device_id Device ID to match
+ * @param index Which match to return (0 for the first)
+ * @return The function, or NULL if not found
+ */
+pci_device_t *pci_find_device(uint16_t vendor_id, uint16_t device_id, int index) {
+    for (int i = 0; i < pci_device_count; i++) {
+        pci_device_t *dev = &pci_devices[i];
+        if (dev->vendor_id == vendor_id && dev->device_id == device_id && index-- == 0) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Find a PCI function by class code
+ * @param class_code Base class to match
+ * @param subclass Subclass to match
+ * @param index Which match to return (0 for the first)
+ * @return The function, or NULL if not found
+ */
+pci_device_t *pci_find_class(uint8_t class_code, uint8_t subclass, int index) {
+    for (int i = 0; i < pci_device_count; i++) {
+        pci_device_t *dev = &pci_devices[i];
+        if (dev->class_code == class_code && dev->subclass == subclass && index-- == 0) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Find a capability in the function's capability list
+ * @param dev PCI function
+ * @param cap_id Capability ID to look for
+ * @param start Offset of the capability to continue after (0 to start fresh)
+ * @return Configuration space offset of the capability, or 0 if not found
+ */
+uint8_t pci_find_capability(pci_device_t *dev, uint8_t cap_id, uint8_t start) {
+    if (!(pci_config_read16(dev, PCI_STATUS) & PCI_STATUS_CAP_LIST)) {
+        return 0;
+    }
+
+    uint8_t offset = start ? pci_config_read8(dev, start + 1)
+                           : pci_config_read8(dev, PCI_CAPABILITIES);
+
+    /* Bound the walk in case of a malformed (looping) list */
+    for (int guard = 0; offset && guard < 48; guard++) {
+        offset &= 0xFC;
+        if (pci_config_read8(dev, offset) == cap_id) {
+            return offset;
+        }
+        offset = pci_config_read8(dev, offset + 1);
+    }
+
+    return 0;
+}
+
+/**
+ * Enable memory decoding and bus mastering for a function
+ * @param dev PCI function
+ */
+void pci_enable_bus_master(pci_device_t *dev) {
+    uint16_t command = pci_config_read16(dev, PCI_COMMAND);
+    command |= PCI_COMMAND_MEMORY | PCI_COMMAND_BUS_MASTER;
+    pci_config_write16(dev, PCI_COMMAND, command);
+}
+
+/**
+ * Map a memory BAR into the kernel address space
+ * @param dev PCI function
+ * @param bar BAR index (0-5)
+ * @return Kernel virtual address of the BAR, or NULL on failure
+ */
+void *pci_map_bar(pci_device_t *dev, int bar) {
+    if (bar < 0 || bar > 5 || dev->bar_is_io[bar] || dev->bar[bar] == 0) {
+        return NULL;
+    }
+    return vmm_map_mmio(dev->bar[bar], dev->bar_size[bar]);
+}
+
+/**
+ * Enable MSI-X with every table entry masked
+ * @param dev PCI function
+ * @return Number of table entries, or negative if MSI-X is unavailable
+ */
+int pci_msix_enable(pci_device_t *dev) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_MSIX, 0);
+    if (!cap) {
+        return -1;
+    }
+
+    uint16_t control = pci_config_read16(dev, cap + PCI_MSIX_CONTROL);
+    uint32_t table = pci_config_read32(dev, cap + PCI_MSIX_TABLE);
+    uint16_t count = (control & PCI_MSIX_CONTROL_SIZE) + 1;
+
+    uint8_t *base = (uint8_t *)pci_map_bar(dev, table & 0x7);
+    if (!base) {
+        return -1;
+    }
+
+    dev->msix_cap = cap;
+    dev->msix_count = count;
+    dev->msix_table = (volatile uint32_t *)(base + (table & ~0x7u));
+
+    /* Mask everything while the function is being set up */
+    pci_config_write16(dev, cap + PCI_MSIX_CONTROL, control | PCI_MSIX_CONTROL_MASK);
+    for (uint16_t i = 0; i < count; i++) {
+        dev->msix_table[i * 4 + 3] |= PCI_MSIX_ENTRY_MASKED;
+    }
+
+    /* MSI-X replaces the legacy pin */
+    uint16_t command = pci_config_read16(dev, PCI_COMMAND);
+    pci_config_write16(dev, PCI_COMMAND, command | PCI_COMMAND_INTX_DISABLE);
+
+    control = (control | PCI_MSIX_CONTROL_ENABLE) & ~PCI_MSIX_CONTROL_MASK;
+    pci_config_write16(dev, cap + PCI_MSIX_CONTROL, control);
+    return count;
+}
+
+/**
+ * Route an MSI-X table entry to a local APIC vector and unmask it
+ * @param dev PCI function with MSI-X enabled
+ * @param entry Table entry index
+ * @param vector Interrupt vector
+ * @param apic_id Destination local APIC ID
+ * @return 0 on success, negative on error
+ */
+int pci_msix_set_vector(pci_device_t *dev, uint16_t entry, uint8_t vector, uint32_t apic_id) {
+    if (!dev->msix_table || entry >= dev->msix_count) {
+        return -1;
+    }
+
+    volatile uint32_t *slot = &dev->msix_table[entry * 4];
+    slot[3] |= PCI_MSIX_ENTRY_MASKED;
+    slot[0] = 0xFEE00000 | ((apic_id & 0xFF) << 12);
+    slot[1] = 0;
+    slot[2] = vector;
+    slot[3] &= ~PCI_MSIX_ENTRY_MASKED;
+    return 0;
+}
+
+/**
+ * Disable MSI-X for a function
+ * @param dev PCI function
+ */
+void pci_msix_disable(pci_device_t *dev) {
+    if (!dev->msix_cap) {
+        return;
+    }
+
+    uint16_t control = pci_config_read16(dev, dev->msix_cap + PCI_MSIX_CONTROL);
+    pci_config_write16(dev, dev->msix_cap + PCI_MSIX_CONTROL, control & ~PCI_MSIX_CONTROL_ENABLE);
+    dev->msix_table = NULL;
+    dev->msix_count = 0;
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int pci_probe_driver(device_driver_t *driver) {
+    return pci_init() < 0 ? -1 : 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int pci_remove_driver(device_driver_t *driver) {
+    pci_device_count = 0;
+    return 0;
+}
+
+/**
+ * Register the PCI bus driver
+ */
+void pci_register_driver(void) {
+    device_driver_register(&pci_driver);
+}
\ No newline at end of file
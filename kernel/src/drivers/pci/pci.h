@@ -0,0 +1,176 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DRIVERS_PCI_PCI_H
+#define _DRIVERS_PCI_PCI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Maximum number of PCI functions tracked */
+#define PCI_MAX_DEVICES     64
+
+/* Configuration space registers */
+#define PCI_VENDOR_ID       0x00
+#define PCI_DEVICE_ID       0x02
+#define PCI_COMMAND         0x04
+#define PCI_STATUS          0x06
+#define PCI_REVISION_ID     0x08
+#define PCI_PROG_IF         0x09
+#define PCI_SUBCLASS        0x0A
+#define PCI_CLASS_CODE      0x0B
+#define PCI_HEADER_TYPE     0x0E
+#define PCI_BAR0            0x10
+#define PCI_SUBSYSTEM_ID    0x2E
+#define PCI_CAPABILITIES    0x34
+#define PCI_INTERRUPT_LINE  0x3C
+
+/* Command register bits */
+#define PCI_COMMAND_IO          0x0001
+#define PCI_COMMAND_MEMORY      0x0002
+#define PCI_COMMAND_BUS_MASTER  0x0004
+#define PCI_COMMAND_INTX_DISABLE 0x0400
+
+/* Status register bits */
+#define PCI_STATUS_CAP_LIST     0x0010
+
+/* Capability IDs */
+#define PCI_CAP_ID_MSI      0x05
+#define PCI_CAP_ID_VENDOR   0x09
+#define PCI_CAP_ID_MSIX     0x11
+
+/* MSI-X capability layout */
+#define PCI_MSIX_CONTROL        0x02
+#define PCI_MSIX_TABLE          0x04
+#define PCI_MSIX_CONTROL_SIZE   0x07FF
+#define PCI_MSIX_CONTROL_MASK   0x4000
+#define PCI_MSIX_CONTROL_ENABLE 0x8000
+#define PCI_MSIX_ENTRY_SIZE     16
+#define PCI_MSIX_ENTRY_MASKED   0x1
+
+/* Device classes */
+#define PCI_CLASS_STORAGE       0x01
+#define PCI_SUBCLASS_SATA       0x06
+#define PCI_SUBCLASS_NVME       0x08
+#define PCI_CLASS_SERIAL_BUS    0x0C
+#define PCI_SUBCLASS_USB        0x03
+
+/* PCI function */
+typedef struct pci_device {
+    uint8_t  bus;               /* Bus number */
+    uint8_t  slot;              /* Device number */
+    uint8_t  func;              /* Function number */
+    uint16_t vendor_id;         /* Vendor ID */
+    uint16_t device_id;         /* Device ID */
+    uint8_t  class_code;        /* Base class */
+    uint8_t  subclass;          /* Subclass */
+    uint8_t  prog_if;           /* Programming interface */
+    uint8_t  revision;          /* Revision ID */
+    uint8_t  irq_line;          /* Legacy interrupt line */
+    uint64_t bar[6];            /* Decoded BAR base addresses */
+    uint64_t bar_size[6];       /* BAR sizes in bytes */
+    bool     bar_is_io[6];      /* Whether the BAR is an I/O port BAR */
+    uint8_t  msix_cap;          /* MSI-X capability offset (0 if absent) */
+    uint16_t msix_count;        /* MSI-X table entries */
+    volatile uint32_t *msix_table; /* Mapped MSI-X table */
+    void    *driver_data;       /* Owning driver's per-device data */
+} pci_device_t;
+
+/**
+ * Enumerate the PCI bus
+ * @return Number of functions found, negative on error
+ */
+int pci_init(void);
+
+/**
+ * Find a PCI function by vendor and device ID
+ * @param vendor_id Vendor ID to match
+ * @param device_id Device ID to match
+ * @param index Which match to return (0 for the first)
+ * @return The function, or NULL if not found
+ */
+pci_device_t *pci_find_device(uint16_t vendor_id, uint16_t device_id, int index);
+
+/**
+ * Find a PCI function by class code
+ * @param class_code Base class to match
+ * @param subclass Subclass to match
+ * @param index Which match to return (0 for the first)
+ * @return The function, or NULL if not found
+ */
+pci_device_t *pci_find_class(uint8_t class_code, uint8_t subclass, int index);
+
+/* Configuration space access */
+uint8_t pci_config_read8(pci_device_t *dev, uint8_t offset);
+uint16_t pci_config_read16(pci_device_t *dev, uint8_t offset);
+uint32_t pci_config_read32(pci_device_t *dev, uint8_t offset);
+void pci_config_write8(pci_device_t *dev, uint8_t offset, uint8_t value);
+void pci_config_write16(pci_device_t *dev, uint8_t offset, uint16_t value);
+void pci_config_write32(pci_device_t *dev, uint8_t offset, uint32_t value);
+
+/**
+ * Find a capability in the function's capability list
+ * @param dev PCI function
+ * @param cap_id Capability ID to look for
+ * @param start Offset of the capability to continue after (0 to start fresh)
+ * @return Configuration space offset of the capability, or 0 if not found
+ */
+uint8_t pci_find_capability(pci_device_t *dev, uint8_t cap_id, uint8_t start);
+
+/**
+ * Enable memory decoding and bus mastering for a function
+ * @param dev PCI function
+ */
+void pci_enable_bus_master(pci_device_t *dev);
+
+/**
+ * Map a memory BAR into the kernel address space
+ * @param dev PCI function
+ * @param bar BAR index (0-5)
+ * @return Kernel virtual address of the BAR, or NULL on failure
+ */
+void *pci_map_bar(pci_device_t *dev, int bar);
+
+/**
+ * Enable MSI-X with every table entry masked
+ * @param dev PCI function
+ * @return Number of table entries, or negative if MSI-X is unavailable
+ */
+int pci_msix_enable(pci_device_t *dev);
+
+/**
+ * Route an MSI-X table entry to a local APIC vector and unmask it
+ * @param dev PCI function with MSI-X enabled
+ * @param entry Table entry index
+ * @param vector Interrupt vector
+ * @param apic_id Destination local APIC ID
+ * @return 0 on success, negative on error
+ */
+int pci_msix_set_vector(pci_device_t *dev, uint16_t entry, uint8_t vector, uint32_t apic_id);
+
+/**
+ * Disable MSI-X for a function
+ * @param dev PCI function
+ */
+void pci_msix_disable(pci_device_t *dev);
+
+/* Register the PCI bus driver */
+void pci_register_driver(void);
+
+#endif /* _DRIVERS_PCI_PCI_H */
\ No newline at end of file
@@ -0,0 +1,141 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * USB definitions shared by host controller and class drivers
+ */
+
+#ifndef _DRIVERS_USB_USB_H
+#define _DRIVERS_USB_USB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Device speeds (xHCI port speed IDs) */
+#define USB_SPEED_FULL          1
+#define USB_SPEED_LOW           2
+#define USB_SPEED_HIGH          3
+#define USB_SPEED_SUPER         4
+
+/* bmRequestType */
+#define USB_DIR_OUT             0x00
+#define USB_DIR_IN              0x80
+#define USB_TYPE_STANDARD       0x00
+#define USB_TYPE_CLASS          0x20
+#define USB_RECIP_DEVICE        0x00
+#define USB_RECIP_INTERFACE     0x01
+
+/* Standard requests */
+#define USB_REQ_GET_DESCRIPTOR  0x06
+#define USB_REQ_SET_CONFIGURATION 0x09
+
+/* Descriptor types */
+#define USB_DESC_DEVICE         0x01
+#define USB_DESC_CONFIG         0x02
+#define USB_DESC_INTERFACE      0x04
+#define USB_DESC_ENDPOINT       0x05
+
+/* Interface classes */
+#define USB_CLASS_HID           0x03
+
+/* Endpoint attributes */
+#define USB_ENDPOINT_DIR_IN     0x80
+#define USB_ENDPOINT_NUMBER     0x0F
+#define USB_ENDPOINT_XFER_MASK  0x03
+#define USB_ENDPOINT_XFER_INT   0x03
+
+/* Setup packet */
+typedef struct usb_setup {
+    uint8_t  request_type;
+    uint8_t  request;
+    uint16_t value;
+    uint16_t index;
+    uint16_t length;
+} __attribute__((packed)) usb_setup_t;
+
+/* Device descriptor */
+typedef struct usb_device_desc {
+    uint8_t  length;
+    uint8_t  type;
+    uint16_t usb_version;
+    uint8_t  device_class;
+    uint8_t  device_subclass;
+    uint8_t  device_protocol;
+    uint8_t  max_packet_size0;
+    uint16_t vendor_id;
+    uint16_t product_id;
+    uint16_t device_version;
+    uint8_t  manufacturer;
+    uint8_t  product;
+    uint8_t  serial;
+    uint8_t  num_configs;
+} __attribute__((packed)) usb_device_desc_t;
+
+/* Configuration descriptor */
+typedef struct usb_config_desc {
+    uint8_t  length;
+    uint8_t  type;
+    uint16_t total_length;
+    uint8_t  num_interfaces;
+    uint8_t  config_value;
+    uint8_t  config_string;
+    uint8_t  attributes;
+    uint8_t  max_power;
+} __attribute__((packed)) usb_config_desc_t;
+
+/* Interface descriptor */
+typedef struct usb_interface_desc {
+    uint8_t  length;
+    uint8_t  type;
+    uint8_t  interface_number;
+    uint8_t  alternate_setting;
+    uint8_t  num_endpoints;
+    uint8_t  interface_class;
+    uint8_t  interface_subclass;
+    uint8_t  interface_protocol;
+    uint8_t  interface_string;
+} __attribute__((packed)) usb_interface_desc_t;
+
+/* Endpoint descriptor */
+typedef struct usb_endpoint_desc {
+    uint8_t  length;
+    uint8_t  type;
+    uint8_t  address;
+    uint8_t  attributes;
+    uint16_t max_packet_size;
+    uint8_t  interval;
+} __attribute__((packed)) usb_endpoint_desc_t;
+
+/* A device as seen by class drivers */
+typedef struct usb_device {
+    uint8_t speed;              /* USB_SPEED_* */
+    uint8_t port;               /* Root hub port, from 1 */
+    usb_device_desc_t desc;     /* Device descriptor */
+
+    /**
+     * Run a control transfer on endpoint 0
+     * @param dev Device
+     * @param setup Setup packet; its length is the data stage size
+     * @param data Data stage buffer (may be NULL without a data stage)
+     * @return 0 on success, negative on error
+     */
+    int (*control)(struct usb_device *dev, const usb_setup_t *setup, void *data);
+
+    void *hc_data;              /* Host controller's per-device data */
+} usb_device_t;
+
+#endif /* _DRIVERS_USB_USB_H */
\ No newline at end of file
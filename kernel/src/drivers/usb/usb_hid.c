@@ -0,0 +1,217 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * USB HID boot protocol keyboards and mice
+ *
+ * Boot protocol reports have a fixed layout, so no report descriptor is
+ * parsed. A keyboard report lists the modifier bits and up to six pressed
+ * keys; comparing it with the previous report gives the presses and
+ * releases. A mouse report carries the buttons and the movement since the
+ * last report. Both are turned into input events, and key presses that
+ * produce a character are also queued as text.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <drivers/input/input.h>
+#include <drivers/usb/usb.h>
+#include <drivers/usb/usb_hid.h>
+
+/* Characters for keyboard usages 0x04-0x38, without and with shift */
+static const char usb_hid_keymap[2][0x39] = {
+    {
+        0, 0, 0, 0,
+        'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
+        'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
+        '1', '2', '3', '4', '5', '6', '7', '8', '9', '0',
+        '\n', 0x1B, '\b', '\t', ' ', '-', '=', '[', ']', '\\', '#', ';', '\'',
+        '`', ',', '.', '/'
+    },
+    {
+        0, 0, 0, 0,
+        'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
+        'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
+        '!', '@', '#', '$', '%', '^', '&', '*', '(', ')',
+        '\n', 0x1B, '\b', '\t', ' ', '_', '+', '{', '}', '|', '~', ':', '"',
+        '~', '<', '>', '?'
+    }
+};
+
+/**
+ * Check whether a key usage appears in a keyboard report's key array
+ */
+static bool usb_hid_key_in(const uint8_t *report, uint8_t usage) {
+    for (int i = 2; i < USB_HID_BOOT_REPORT_SIZE; i++) {
+        if (report[i] == usage) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Handle a boot keyboard report
+ */
+static void usb_hid_keyboard(usb_hid_t *hid, const uint8_t *report) {
+    /* Too many keys down; the report says nothing about which */
+    if (report[2] == USB_HID_KEY_ERROR_ROLLOVER) {
+        return;
+    }
+
+    uint8_t modifiers = report[0];
+    uint8_t changed = modifiers ^ hid->last[0];
+    for (int bit = 0; bit < 8; bit++) {
+        if (changed & (1u << bit)) {
+            input_report(INPUT_EV_KEY, USB_HID_KEY_LEFT_CTRL + bit, (modifiers >> bit) & 1);
+        }
+    }
+
+    for (int i = 2; i < USB_HID_BOOT_REPORT_SIZE; i++) {
+        uint8_t usage = hid->last[i];
+        if (usage > USB_HID_KEY_ERROR_ROLLOVER && !usb_hid_key_in(report, usage)) {
+            input_report(INPUT_EV_KEY, usage, 0);
+        }
+    }
+
+    for (int i = 2; i < USB_HID_BOOT_REPORT_SIZE; i++) {
+        uint8_t usage = report[i];
+        if (usage <= USB_HID_KEY_ERROR_ROLLOVER || usb_hid_key_in(hid->last, usage)) {
+            continue;
+        }
+        input_report(INPUT_EV_KEY, usage, 1);
+
+        if (usage < sizeof(usb_hid_keymap[0])) {
+            char c = usb_hid_keymap[(modifiers & USB_HID_MOD_SHIFT) ? 1 : 0][usage];
+            if (c && (modifiers & USB_HID_MOD_CTRL) && c >= '@') {
+                c &= 0x1F;
+            }
+            if (c) {
+                input_report_char(c);
+            }
+        }
+    }
+
+    input_sync();
+}
+
+/**
+ * Handle a boot mouse report
+ */
+static void usb_hid_mouse(usb_hid_t *hid, const uint8_t *report, size_t len) {
+    static const uint16_t buttons[3] = { INPUT_BTN_LEFT, INPUT_BTN_RIGHT, INPUT_BTN_MIDDLE };
+
+    uint8_t changed = (report[0] ^ hid->last[0]) & 0x07;
+    for (int i = 0; i < 3; i++) {
+        if (changed & (1u << i)) {
+            input_report(INPUT_EV_KEY, buttons[i], (report[0] >> i) & 1);
+        }
+    }
+
+    if (len >= 3) {
+        if (report[1]) {
+            input_report(INPUT_EV_REL, INPUT_REL_X, (int8_t)report[1]);
+        }
+        if (report[2]) {
+            input_report(INPUT_EV_REL, INPUT_REL_Y, (int8_t)report[2]);
+        }
+    }
+    if (len >= 4 && report[3]) {
+        input_report(INPUT_EV_REL, INPUT_REL_WHEEL, (int8_t)report[3]);
+    }
+
+    input_sync();
+}
+
+/**
+ * Check whether an interface is a boot protocol keyboard or mouse
+ * @param intf Interface descriptor
+ * @return true if this driver handles it
+ */
+bool usb_hid_match(const usb_interface_desc_t *intf) {
+    return intf->interface_class == USB_CLASS_HID &&
+           intf->interface_subclass == USB_HID_SUBCLASS_BOOT &&
+           (intf->interface_protocol == USB_HID_PROTOCOL_KEYBOARD ||
+            intf->interface_protocol == USB_HID_PROTOCOL_MOUSE);
+}
+
+/**
+ * Switch an interface to the boot protocol and stop idle repeats
+ * @param hid HID state to set up
+ * @param dev Device
+ * @param intf Interface descriptor
+ * @return 0 on success, negative on error
+ */
+int usb_hid_init(usb_hid_t *hid, usb_device_t *dev, const usb_interface_desc_t *intf) {
+    memset(hid, 0, sizeof(*hid));
+    hid->dev = dev;
+    hid->interface = intf->interface_number;
+    hid->protocol = intf->interface_protocol;
+
+    usb_setup_t setup = {
+        .request_type = USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+        .request = USB_HID_REQ_SET_PROTOCOL,
+        .value = USB_HID_BOOT_PROTOCOL,
+        .index = hid->interface,
+        .length = 0
+    };
+    if (dev->control(dev, &setup, NULL) < 0) {
+        kerr("USB HID: Port %u: SET_PROTOCOL failed\n", dev->port);
+        return -1;
+    }
+
+    /* Report only on change; a held key must not produce a report every few ms */
+    setup.request = USB_HID_REQ_SET_IDLE;
+    setup.value = 0;
+    if (dev->control(dev, &setup, NULL) < 0) {
+        /* Optional for mice */
+        kprintf("USB HID: Port %u: SET_IDLE not supported\n", dev->port);
+    }
+
+    kprintf("USB HID: Port %u: boot %s\n", dev->port,
+            hid->protocol == USB_HID_PROTOCOL_KEYBOARD ? "keyboard" : "mouse");
+    return 0;
+}
+
+/**
+ * Turn a report from the interrupt endpoint into input events
+ * @param hid HID interface
+ * @param report Report data
+ * @param len Report length
+ */
+void usb_hid_report(usb_hid_t *hid, const uint8_t *report, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (len > USB_HID_BOOT_REPORT_SIZE) {
+        len = USB_HID_BOOT_REPORT_SIZE;
+    }
+
+    if (hid->protocol == USB_HID_PROTOCOL_KEYBOARD) {
+        if (len < USB_HID_BOOT_REPORT_SIZE) {
+            return;
+        }
+        usb_hid_keyboard(hid, report);
+    } else {
+        usb_hid_mouse(hid, report, len);
+    }
+
+    memcpy(hid->last, report, len);
+    hid->reports++;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * USB HID boot protocol keyboards and mice
+ */
+
+#ifndef _DRIVERS_USB_USB_HID_H
+#define _DRIVERS_USB_USB_HID_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/usb/usb.h>
+
+/* Interface subclass and protocols */
+#define USB_HID_SUBCLASS_BOOT       0x01
+#define USB_HID_PROTOCOL_KEYBOARD   0x01
+#define USB_HID_PROTOCOL_MOUSE      0x02
+
+/* Class requests */
+#define USB_HID_REQ_SET_IDLE        0x0A
+#define USB_HID_REQ_SET_PROTOCOL    0x0B
+
+/* SET_PROTOCOL values */
+#define USB_HID_BOOT_PROTOCOL       0
+
+/* Boot reports are at most this long */
+#define USB_HID_BOOT_REPORT_SIZE    8
+
+/* Keyboard usages */
+#define USB_HID_KEY_ERROR_ROLLOVER  0x01
+#define USB_HID_KEY_LEFT_CTRL       0xE0
+
+/* Keyboard modifier bits */
+#define USB_HID_MOD_CTRL            0x11
+#define USB_HID_MOD_SHIFT           0x22
+
+/* One HID interface */
+typedef struct usb_hid {
+    usb_device_t *dev;
+    uint8_t interface;          /* Interface number */
+    uint8_t protocol;           /* USB_HID_PROTOCOL_* */
+    uint8_t last[USB_HID_BOOT_REPORT_SIZE]; /* Previous report */
+    uint64_t reports;           /* Reports received */
+} usb_hid_t;
+
+/**
+ * Check whether an interface is a boot protocol keyboard or mouse
+ * @param intf Interface descriptor
+ * @return true if this driver handles it
+ */
+bool usb_hid_match(const usb_interface_desc_t *intf);
+
+/**
+ * Switch an interface to the boot protocol and stop idle repeats
+ * @param hid HID state to set up
+ * @param dev Device
+ * @param intf Interface descriptor
+ * @return 0 on success, negative on error
+ */
+int usb_hid_init(usb_hid_t *hid, usb_device_t *dev, const usb_interface_desc_t *intf);
+
+/**
+ * Turn a report from the interrupt endpoint into input events
+ * @param hid HID interface
+ * @param report Report data
+ * @param len Report length
+ */
+void usb_hid_report(usb_hid_t *hid, const uint8_t *report, size_t len);
+
+#endif /* _DRIVERS_USB_USB_HID_H */
\ No newline at end of file
@@ -0,0 +1,902 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * xHCI USB host controller driver
+ *
+ * Devices on the root hub ports are addressed at probe time and their first
+ * boot protocol HID interface is handed to the HID class driver. Each HID
+ * interrupt endpoint keeps XHCI_HID_TRANSFERS transfers queued, and every
+ * completed one is re-queued from the event handler, so reports are not lost
+ * while the event handler is not running.
+ *
+ * All events arrive on one event ring, signalled through MSI-X. The
+ * interrupter's moderation interval (XHCI_IMOD_US) bounds how often that
+ * interrupt can fire: reports completing within one interval are handled by
+ * a single interrupt, with one event ring dequeue update and one doorbell
+ * per endpoint for the re-queued transfers. Commands and control transfers
+ * are only issued while probing and wait by polling the event ring.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/barrier.h>
+#include <arch/x86/include/idt.h>
+#include <arch/x86/include/lapic.h>
+#include <drivers/driversys.h>
+#include <drivers/pci/pci.h>
+#include <drivers/usb/usb.h>
+#include <drivers/usb/usb_hid.h>
+#include <drivers/usb/xhci.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+
+/* Command and control transfer timeout */
+#define XHCI_TIMEOUT_MS         1000
+
+/* Spacing of the HID report buffers within their page */
+#define XHCI_REPORT_STRIDE      (PAGE_SIZE / XHCI_HID_TRANSFERS)
+
+static int xhci_probe_driver(device_driver_t *driver);
+static int xhci_remove_driver(device_driver_t *driver);
+
+/* Define the xHCI driver */
+static driver_ops_t xhci_driver_ops = {
+    .probe = xhci_probe_driver,
+    .remove = xhci_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t xhci_driver = {
+    .name = "xhci",
+    .device_class = DEVICE_CLASS_USB,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &xhci_driver_ops,
+    .private_data = NULL
+};
+
+/* Driven controllers */
+static xhci_ctrl_t *xhci_controllers[XHCI_MAX_CONTROLLERS];
+static int xhci_count = 0;
+
+static inline uint32_t xhci_read32(volatile uint8_t *base, uint32_t reg) {
+    return *(volatile uint32_t *)(base + reg);
+}
+
+static inline void xhci_write32(volatile uint8_t *base, uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)(base + reg) = value;
+}
+
+static inline void xhci_write64(volatile uint8_t *base, uint32_t reg, uint64_t value) {
+    xhci_write32(base, reg, (uint32_t)value);
+    xhci_write32(base, reg + 4, (uint32_t)(value >> 32));
+}
+
+/**
+ * Wait for register bits to reach a value
+ * @return 0 on success, negative on timeout
+ */
+static int xhci_wait_reg(volatile uint8_t *base, uint32_t reg, uint32_t mask, uint32_t value,
+                         uint32_t timeout_ms) {
+    uint64_t deadline = time_now_ns() + (uint64_t)timeout_ms * 1000000ULL;
+
+    while ((xhci_read32(base, reg) & mask) != value) {
+        if (time_now_ns() > deadline) {
+            return -1;
+        }
+        cpu_relax();
+    }
+    return 0;
+}
+
+/**
+ * Allocate an empty ring
+ * @return 0 on success, negative if out of memory
+ */
+static int xhci_ring_init(xhci_ring_t *ring) {
+    ring->trbs = (volatile xhci_trb_t *)pmm_alloc_dma(1, &ring->phys);
+    if (!ring->trbs) {
+        return -1;
+    }
+    ring->enqueue = 0;
+    ring->cycle = 1;
+    return 0;
+}
+
+/**
+ * Put a TRB on a ring, following the link TRB at its end
+ *
+ * The cycle bit is written last, which hands the TRB to the controller.
+ * Callers keep far fewer TRBs outstanding than the ring holds.
+ */
+static void xhci_ring_push(xhci_ring_t *ring, uint64_t param, uint32_t status, uint32_t control) {
+    volatile xhci_trb_t *trb = &ring->trbs[ring->enqueue];
+    trb->param = param;
+    trb->status = status;
+    wmb();
+    trb->control = control | ring->cycle;
+
+    if (++ring->enqueue == XHCI_RING_TRBS - 1) {
+        volatile xhci_trb_t *link = &ring->trbs[XHCI_RING_TRBS - 1];
+        link->param = ring->phys;
+        link->status = 0;
+        wmb();
+        link->control = XHCI_TRB_TYPE(XHCI_TRB_LINK) | XHCI_TRB_TOGGLE_CYCLE | ring->cycle;
+        ring->enqueue = 0;
+        ring->cycle ^= 1;
+    }
+}
+
+/**
+ * Get a context from a device or input context
+ * @param index Context index (input contexts start with the control context)
+ */
+static inline uint32_t *xhci_ctx(xhci_ctrl_t *ctrl, void *base, uint32_t index) {
+    return (uint32_t *)((uint8_t *)base + index * ctrl->ctx_size);
+}
+
+/**
+ * Handle a transfer event
+ * @param doorbells Slots whose HID endpoint got transfers re-queued
+ */
+static void xhci_transfer_event(xhci_ctrl_t *ctrl, uint64_t param, uint32_t status, uint32_t control,
+                                uint64_t *doorbells) {
+    uint8_t slot = control >> 24;
+    uint8_t dci = (control >> 16) & 0x1F;
+    uint8_t cc = status >> 24;
+
+    if (slot == 0 || slot > ctrl->max_slots || !ctrl->devices[slot]) {
+        return;
+    }
+    xhci_device_t *dev = ctrl->devices[slot];
+
+    if (dci == 1) {
+        dev->ctrl_cc = cc;
+        dev->ctrl_done = true;
+        return;
+    }
+
+    if (!dev->hid_active || dci != dev->hid_dci ||
+        param < dev->hid_ring.phys || param >= dev->hid_ring.phys + PAGE_SIZE) {
+        return;
+    }
+
+    /* The completed TRB still names its buffer */
+    uint64_t buffer_phys = dev->hid_ring.trbs[(param - dev->hid_ring.phys) / sizeof(xhci_trb_t)].param;
+    uint8_t *buffer = dev->reports + (buffer_phys - dev->reports_phys);
+
+    if (cc != XHCI_CC_SUCCESS && cc != XHCI_CC_SHORT_PACKET) {
+        kerr("XHCI: Port %u: interrupt transfer failed with code %u\n", dev->usb.port, cc);
+        dev->hid_active = false;
+        return;
+    }
+
+    uint32_t residual = status & 0xFFFFFF;
+    if (residual < dev->hid_packet) {
+        usb_hid_report(&dev->hid, buffer, dev->hid_packet - residual);
+        ctrl->reports++;
+    }
+
+    xhci_ring_push(&dev->hid_ring, buffer_phys, dev->hid_packet,
+                   XHCI_TRB_TYPE(XHCI_TRB_NORMAL) | XHCI_TRB_IOC);
+    *doorbells |= 1ULL << slot;
+}
+
+/**
+ * Handle every event on the event ring, updating the dequeue pointer once
+ * @return Number of events handled
+ */
+static uint32_t xhci_process_events(xhci_ctrl_t *ctrl) {
+    uint64_t doorbells = 0;
+    uint32_t count = 0;
+
+    for (;;) {
+        volatile xhci_trb_t *event = &ctrl->event_ring[ctrl->event_dequeue];
+        uint32_t control = event->control;
+        if ((control & XHCI_TRB_CYCLE) != ctrl->event_cycle) {
+            break;
+        }
+
+        /* Read the rest of the event only after its cycle bit */
+        rmb();
+        uint64_t param = event->param;
+        uint32_t status = event->status;
+
+        switch (XHCI_TRB_GET_TYPE(control)) {
+            case XHCI_TRB_TRANSFER_EVENT:
+                xhci_transfer_event(ctrl, param, status, control, &doorbells);
+                break;
+            case XHCI_TRB_COMMAND_EVENT:
+                ctrl->cmd_cc = status >> 24;
+                ctrl->cmd_slot = control >> 24;
+                ctrl->cmd_done = true;
+                break;
+            default:
+                /* Port changes after probing are not handled */
+                break;
+        }
+
+        if (++ctrl->event_dequeue == XHCI_RING_TRBS) {
+            ctrl->event_dequeue = 0;
+            ctrl->event_cycle ^= 1;
+        }
+        count++;
+    }
+
+    if (count) {
+        xhci_write64(ctrl->rt, XHCI_RT_ERDP,
+                     (ctrl->event_phys + ctrl->event_dequeue * sizeof(xhci_trb_t)) | XHCI_ERDP_EHB);
+        ctrl->events += count;
+    }
+
+    if (doorbells) {
+        wmb();
+        for (uint32_t slot = 1; slot <= ctrl->max_slots; slot++) {
+            if (doorbells & (1ULL << slot)) {
+                ctrl->db[slot] = ctrl->devices[slot]->hid_dci;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Interrupter 0 handler
+ */
+static void xhci_irq(uint8_t vector, void *data) {
+    xhci_ctrl_t *ctrl = (xhci_ctrl_t *)data;
+    ctrl->interrupts++;
+
+    xhci_write32(ctrl->op, XHCI_OP_USBSTS, XHCI_STS_EINT);
+    xhci_write32(ctrl->rt, XHCI_RT_IMAN, XHCI_IMAN_IE | XHCI_IMAN_IP);
+    xhci_process_events(ctrl);
+}
+
+/**
+ * Poll the event ring until a completion flag is set
+ * @return 0 on success, negative on timeout
+ */
+static int xhci_wait_event(xhci_ctrl_t *ctrl, volatile bool *done) {
+    uint64_t deadline = time_now_ns() + XHCI_TIMEOUT_MS * 1000000ULL;
+    uint64_t flags = cpu_irq_save();
+
+    while (!*done) {
+        xhci_process_events(ctrl);
+        if (time_now_ns() > deadline) {
+            cpu_irq_restore(flags);
+            return -1;
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return 0;
+}
+
+/**
+ * Run a command synchronously
+ * @return 0 on success, negative on error or timeout
+ */
+static int xhci_command(xhci_ctrl_t *ctrl, uint64_t param, uint32_t control) {
+    ctrl->cmd_done = false;
+    xhci_ring_push(&ctrl->cmd_ring, param, 0, control);
+    wmb();
+    ctrl->db[0] = 0;
+
+    if (xhci_wait_event(ctrl, &ctrl->cmd_done) < 0) {
+        kerr("XHCI: Command %u timed out\n", XHCI_TRB_GET_TYPE(control));
+        return -1;
+    }
+    if (ctrl->cmd_cc != XHCI_CC_SUCCESS) {
+        kerr("XHCI: Command %u failed with code %u\n", XHCI_TRB_GET_TYPE(control), ctrl->cmd_cc);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Run a control transfer on endpoint 0
+ * @param usb Device
+ * @param setup Setup packet; its length is the data stage size
+ * @param data Data stage buffer (may be NULL without a data stage)
+ * @return 0 on success, negative on error
+ */
+static int xhci_control(usb_device_t *usb, const usb_setup_t *setup, void *data) {
+    xhci_device_t *dev = (xhci_device_t *)usb->hc_data;
+    xhci_ctrl_t *ctrl = dev->ctrl;
+    bool in = (setup->request_type & USB_DIR_IN) != 0;
+    uint16_t length = setup->length;
+
+    if (length > PAGE_SIZE || (length && !data)) {
+        return -1;
+    }
+    if (length && !in) {
+        memcpy(ctrl->ctrl_buf, data, length);
+    }
+
+    uint64_t packet;
+    memcpy(&packet, setup, sizeof(packet));
+    uint32_t trt = length == 0 ? 0 : in ? XHCI_TRB_TRT_IN : XHCI_TRB_TRT_OUT;
+
+    dev->ctrl_done = false;
+    xhci_ring_push(&dev->ep0, packet, sizeof(usb_setup_t),
+                   XHCI_TRB_TYPE(XHCI_TRB_SETUP) | XHCI_TRB_IDT | trt);
+    if (length) {
+        xhci_ring_push(&dev->ep0, ctrl->ctrl_buf_phys, length,
+                       XHCI_TRB_TYPE(XHCI_TRB_DATA) | (in ? XHCI_TRB_DIR_IN : 0));
+    }
+    /* The status stage runs opposite to the data stage, IN without one */
+    xhci_ring_push(&dev->ep0, 0, 0, XHCI_TRB_TYPE(XHCI_TRB_STATUS) | XHCI_TRB_IOC |
+                   ((length && in) ? 0 : XHCI_TRB_DIR_IN));
+    wmb();
+    ctrl->db[dev->slot_id] = 1;
+
+    if (xhci_wait_event(ctrl, &dev->ctrl_done) < 0 || dev->ctrl_cc != XHCI_CC_SUCCESS) {
+        kerr("XHCI: Port %u: request 0x%x failed\n", usb->port, setup->request);
+        return -1;
+    }
+
+    if (length && in) {
+        memcpy(data, ctrl->ctrl_buf, length);
+    }
+    return 0;
+}
+
+/**
+ * Fill the slot context of a device's input context
+ * @param last_dci Highest endpoint context in use
+ */
+static void xhci_input_slot(xhci_ctrl_t *ctrl, xhci_device_t *dev, uint32_t last_dci) {
+    uint32_t *slot = xhci_ctx(ctrl, dev->in_ctx, 1);
+    slot[0] = ((uint32_t)dev->usb.speed << 20) | (last_dci << 27);
+    slot[1] = (uint32_t)dev->usb.port << 16;
+}
+
+/**
+ * Fill the endpoint 0 context of a device's input context
+ */
+static void xhci_input_ep0(xhci_ctrl_t *ctrl, xhci_device_t *dev, uint16_t max_packet) {
+    uint32_t *ep = xhci_ctx(ctrl, dev->in_ctx, 2);
+    ep[1] = (3u << 1) | (XHCI_EP_CONTROL << 3) | ((uint32_t)max_packet << 16);
+    ep[2] = (uint32_t)dev->ep0.phys | dev->ep0.cycle;
+    ep[3] = (uint32_t)(dev->ep0.phys >> 32);
+    ep[4] = 8;
+}
+
+/**
+ * Release a device and its slot's memory
+ */
+static void xhci_free_device(xhci_ctrl_t *ctrl, xhci_device_t *dev) {
+    if (dev->slot_id) {
+        ctrl->devices[dev->slot_id] = NULL;
+        ctrl->dcbaa[dev->slot_id] = 0;
+    }
+    if (dev->out_ctx) {
+        pmm_free_dma(dev->out_ctx, 1);
+    }
+    if (dev->in_ctx) {
+        pmm_free_dma(dev->in_ctx, 1);
+    }
+    if (dev->ep0.trbs) {
+        pmm_free_dma((void *)dev->ep0.trbs, 1);
+    }
+    if (dev->hid_ring.trbs) {
+        pmm_free_dma((void *)dev->hid_ring.trbs, 1);
+    }
+    if (dev->reports) {
+        pmm_free_dma(dev->reports, 1);
+    }
+    kfree(dev);
+}
+
+/**
+ * Enable a slot for the device on a port and give it an address
+ * @return The device, or NULL on failure
+ */
+static xhci_device_t *xhci_address_device(xhci_ctrl_t *ctrl, uint8_t port, uint8_t speed) {
+    if (xhci_command(ctrl, 0, XHCI_TRB_TYPE(XHCI_TRB_ENABLE_SLOT)) < 0) {
+        return NULL;
+    }
+    uint8_t slot_id = ctrl->cmd_slot;
+    if (slot_id == 0 || slot_id > ctrl->max_slots) {
+        return NULL;
+    }
+
+    xhci_device_t *dev = (xhci_device_t *)kzalloc(sizeof(xhci_device_t));
+    if (!dev) {
+        return NULL;
+    }
+    dev->ctrl = ctrl;
+    dev->usb.speed = speed;
+    dev->usb.port = port;
+    dev->usb.control = xhci_control;
+    dev->usb.hc_data = dev;
+
+    dev->out_ctx = pmm_alloc_dma(1, &dev->out_ctx_phys);
+    dev->in_ctx = pmm_alloc_dma(1, &dev->in_ctx_phys);
+    if (!dev->out_ctx || !dev->in_ctx || xhci_ring_init(&dev->ep0) < 0) {
+        xhci_free_device(ctrl, dev);
+        return NULL;
+    }
+
+    dev->slot_id = slot_id;
+    ctrl->dcbaa[slot_id] = dev->out_ctx_phys;
+    ctrl->devices[slot_id] = dev;
+
+    /* Full-speed devices may use more than 8; fixed up from the descriptor */
+    uint16_t max_packet = speed == USB_SPEED_SUPER ? 512 : speed == USB_SPEED_HIGH ? 64 : 8;
+
+    uint32_t *input = xhci_ctx(ctrl, dev->in_ctx, 0);
+    input[1] = (1u << 0) | (1u << 1);
+    xhci_input_slot(ctrl, dev, 1);
+    xhci_input_ep0(ctrl, dev, max_packet);
+
+    if (xhci_command(ctrl, dev->in_ctx_phys,
+                     XHCI_TRB_TYPE(XHCI_TRB_ADDRESS_DEVICE) | XHCI_TRB_SLOT(slot_id)) < 0) {
+        xhci_free_device(ctrl, dev);
+        return NULL;
+    }
+    return dev;
+}
+
+/**
+ * Convert an endpoint descriptor's bInterval to the xHCI interval exponent
+ */
+static uint32_t xhci_ep_interval(uint8_t speed, uint8_t interval) {
+    if (speed == USB_SPEED_HIGH || speed == USB_SPEED_SUPER) {
+        uint32_t exponent = interval ? interval - 1u : 0;
+        return exponent > 15 ? 15 : exponent;
+    }
+
+    /* Full and low speed count frames of 1 ms; xHCI wants 2^n * 125 us */
+    uint32_t microframes = (interval ? interval : 1u) * 8;
+    uint32_t exponent = 0;
+    while ((2u << exponent) <= microframes && exponent < 10) {
+        exponent++;
+    }
+    return exponent < 3 ? 3 : exponent;
+}
+
+/**
+ * Configure a HID interrupt IN endpoint
+ * @return 0 on success, negative on error
+ */
+static int xhci_configure_hid(xhci_ctrl_t *ctrl, xhci_device_t *dev, const usb_endpoint_desc_t *ep_desc) {
+    uint8_t number = ep_desc->address & USB_ENDPOINT_NUMBER;
+    uint16_t max_packet = ep_desc->max_packet_size & 0x7FF;
+    if (max_packet > XHCI_REPORT_STRIDE) {
+        max_packet = XHCI_REPORT_STRIDE;
+    }
+
+    dev->hid_dci = number * 2 + 1;
+    dev->hid_packet = max_packet;
+    dev->reports = (uint8_t *)pmm_alloc_dma(1, &dev->reports_phys);
+    if (!dev->reports || xhci_ring_init(&dev->hid_ring) < 0) {
+        return -1;
+    }
+
+    memset(dev->in_ctx, 0, PAGE_SIZE);
+    uint32_t *input = xhci_ctx(ctrl, dev->in_ctx, 0);
+    input[1] = (1u << 0) | (1u << dev->hid_dci);
+    xhci_input_slot(ctrl, dev, dev->hid_dci);
+
+    uint32_t *ep = xhci_ctx(ctrl, dev->in_ctx, 1 + dev->hid_dci);
+    ep[0] = xhci_ep_interval(dev->usb.speed, ep_desc->interval) << 16;
+    ep[1] = (3u << 1) | (XHCI_EP_INTERRUPT_IN << 3) | ((uint32_t)max_packet << 16);
+    ep[2] = (uint32_t)dev->hid_ring.phys | dev->hid_ring.cycle;
+    ep[3] = (uint32_t)(dev->hid_ring.phys >> 32);
+    ep[4] = max_packet | ((uint32_t)max_packet << 16);
+
+    return xhci_command(ctrl, dev->in_ctx_phys,
+                        XHCI_TRB_TYPE(XHCI_TRB_CONFIGURE_EP) | XHCI_TRB_SLOT(dev->slot_id));
+}
+
+/**
+ * Queue the transfers of a configured HID endpoint
+ */
+static void xhci_start_hid(xhci_ctrl_t *ctrl, xhci_device_t *dev) {
+    for (uint32_t i = 0; i < XHCI_HID_TRANSFERS; i++) {
+        xhci_ring_push(&dev->hid_ring, dev->reports_phys + i * XHCI_REPORT_STRIDE, dev->hid_packet,
+                       XHCI_TRB_TYPE(XHCI_TRB_NORMAL) | XHCI_TRB_IOC);
+    }
+
+    uint64_t flags = cpu_irq_save();
+    dev->hid_active = true;
+    wmb();
+    ctrl->db[dev->slot_id] = dev->hid_dci;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Address the device on a port and bind its boot HID interface
+ * @return 0 on success (also if the device has nothing to drive), negative on error
+ */
+static int xhci_enumerate(xhci_ctrl_t *ctrl, uint8_t port, uint8_t speed) {
+    xhci_device_t *dev = xhci_address_device(ctrl, port, speed);
+    if (!dev) {
+        return -1;
+    }
+    usb_device_t *usb = &dev->usb;
+
+    /* The first 8 bytes hold the real endpoint 0 packet size */
+    usb_setup_t setup = {
+        .request_type = USB_DIR_IN | USB_TYPE_STANDARD | USB_RECIP_DEVICE,
+        .request = USB_REQ_GET_DESCRIPTOR,
+        .value = USB_DESC_DEVICE << 8,
+        .index = 0,
+        .length = 8
+    };
+    if (xhci_control(usb, &setup, &usb->desc) < 0) {
+        goto fail;
+    }
+
+    if (speed == USB_SPEED_FULL && usb->desc.max_packet_size0 != 8) {
+        memset(dev->in_ctx, 0, PAGE_SIZE);
+        xhci_ctx(ctrl, dev->in_ctx, 0)[1] = 1u << 1;
+        xhci_input_ep0(ctrl, dev, usb->desc.max_packet_size0);
+        if (xhci_command(ctrl, dev->in_ctx_phys,
+                         XHCI_TRB_TYPE(XHCI_TRB_EVALUATE_CTX) | XHCI_TRB_SLOT(dev->slot_id)) < 0) {
+            goto fail;
+        }
+    }
+
+    setup.length = sizeof(usb_device_desc_t);
+    if (xhci_control(usb, &setup, &usb->desc) < 0) {
+        goto fail;
+    }
+
+    usb_config_desc_t header;
+    setup.value = USB_DESC_CONFIG << 8;
+    setup.length = sizeof(header);
+    if (xhci_control(usb, &setup, &header) < 0) {
+        goto fail;
+    }
+
+    uint16_t total = header.total_length < PAGE_SIZE ? header.total_length : PAGE_SIZE;
+    uint8_t *config = (uint8_t *)kmalloc(total);
+    if (!config) {
+        goto fail;
+    }
+    setup.length = total;
+    if (xhci_control(usb, &setup, config) < 0) {
+        kfree(config);
+        goto fail;
+    }
+
+    /* Find the first boot HID interface and its interrupt IN endpoint */
+    const usb_interface_desc_t *intf = NULL;
+    const usb_endpoint_desc_t *ep = NULL;
+    for (uint16_t offset = 0; offset + 2 <= total && config[offset] >= 2 && !ep;
+         offset += config[offset]) {
+        uint8_t type = config[offset + 1];
+        if (type == USB_DESC_INTERFACE && offset + sizeof(usb_interface_desc_t) <= total) {
+            const usb_interface_desc_t *candidate = (const usb_interface_desc_t *)&config[offset];
+            intf = (candidate->alternate_setting == 0 && usb_hid_match(candidate)) ? candidate : NULL;
+        } else if (type == USB_DESC_ENDPOINT && intf && offset + sizeof(usb_endpoint_desc_t) <= total) {
+            const usb_endpoint_desc_t *candidate = (const usb_endpoint_desc_t *)&config[offset];
+            if ((candidate->address & USB_ENDPOINT_DIR_IN) &&
+                (candidate->attributes & USB_ENDPOINT_XFER_MASK) == USB_ENDPOINT_XFER_INT) {
+                ep = candidate;
+            }
+        }
+    }
+
+    if (!ep) {
+        kprintf("XHCI: Port %u: device %04x:%04x has no boot HID interface\n",
+                port, usb->desc.vendor_id, usb->desc.product_id);
+        kfree(config);
+        return 0;
+    }
+
+    int result = xhci_configure_hid(ctrl, dev, ep);
+    if (result == 0) {
+        setup.request_type = USB_DIR_OUT | USB_TYPE_STANDARD | USB_RECIP_DEVICE;
+        setup.request = USB_REQ_SET_CONFIGURATION;
+        setup.value = header.config_value;
+        setup.length = 0;
+        result = xhci_control(usb, &setup, NULL);
+    }
+    if (result == 0) {
+        result = usb_hid_init(&dev->hid, usb, intf);
+    }
+    kfree(config);
+    if (result < 0) {
+        return -1;
+    }
+
+    xhci_start_hid(ctrl, dev);
+    return 0;
+
+fail:
+    xhci_free_device(ctrl, dev);
+    return -1;
+}
+
+/**
+ * Reset a port with a device attached, if the link is not already enabled
+ * @return The port speed, or negative if no usable device is there
+ */
+static int xhci_port_reset(xhci_ctrl_t *ctrl, uint8_t port) {
+    uint32_t reg = XHCI_OP_PORTSC(port);
+    uint32_t portsc = xhci_read32(ctrl->op, reg);
+
+    if (!(portsc & XHCI_PORTSC_CCS)) {
+        return -1;
+    }
+
+    /* USB 3 links enable themselves; USB 2 ports need a reset */
+    if (!(portsc & XHCI_PORTSC_PED)) {
+        xhci_write32(ctrl->op, reg, (portsc & ~(XHCI_PORTSC_PED | XHCI_PORTSC_CHANGES)) | XHCI_PORTSC_PR);
+        if (xhci_wait_reg(ctrl->op, reg, XHCI_PORTSC_PRC, XHCI_PORTSC_PRC, 500) < 0) {
+            kerr("XHCI: Port %u: reset timed out\n", port);
+            return -1;
+        }
+        /* Reset recovery */
+        time_delay_us(10000);
+    }
+
+    /* Acknowledge every change reported so far */
+    portsc = xhci_read32(ctrl->op, reg);
+    xhci_write32(ctrl->op, reg, (portsc & ~XHCI_PORTSC_PED) | (portsc & XHCI_PORTSC_CHANGES));
+
+    if (!(portsc & XHCI_PORTSC_PED)) {
+        return -1;
+    }
+    return XHCI_PORTSC_SPEED(portsc);
+}
+
+/**
+ * Take the controller over from the firmware
+ */
+static void xhci_take_ownership(xhci_ctrl_t *ctrl, uint32_t hccparams1) {
+    uint32_t offset = (hccparams1 >> 16) << 2;
+
+    while (offset) {
+        uint32_t cap = xhci_read32(ctrl->cap, offset);
+        if ((cap & 0xFF) == XHCI_EXT_CAP_LEGACY) {
+            if (cap & XHCI_LEGACY_BIOS_OWNED) {
+                xhci_write32(ctrl->cap, offset, cap | XHCI_LEGACY_OS_OWNED);
+                if (xhci_wait_reg(ctrl->cap, offset, XHCI_LEGACY_BIOS_OWNED, 0, 1000) < 0) {
+                    kerr("XHCI: Firmware did not release the controller\n");
+                }
+            }
+            return;
+        }
+
+        uint32_t next = (cap >> 8) & 0xFF;
+        offset = next ? offset + (next << 2) : 0;
+    }
+}
+
+/**
+ * Allocate the scratchpad buffers the controller asks for
+ * @return 0 on success, negative if out of memory
+ */
+static int xhci_setup_scratchpad(xhci_ctrl_t *ctrl) {
+    uint32_t hcsparams2 = xhci_read32(ctrl->cap, XHCI_CAP_HCSPARAMS2);
+    uint32_t count = (((hcsparams2 >> 21) & 0x1F) << 5) | ((hcsparams2 >> 27) & 0x1F);
+    if (count == 0) {
+        return 0;
+    }
+
+    /* At most 1023 entries of 8 bytes */
+    uint64_t array_phys;
+    uint64_t *array = (uint64_t *)pmm_alloc_dma(2, &array_phys);
+    if (!array) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t phys;
+        if (!pmm_alloc_dma(1, &phys)) {
+            return -1;
+        }
+        array[i] = phys;
+    }
+
+    ctrl->dcbaa[0] = array_phys;
+    return 0;
+}
+
+/**
+ * Set up the command ring, event ring and interrupter
+ * @return 0 on success, negative on error
+ */
+static int xhci_setup_rings(xhci_ctrl_t *ctrl) {
+    if (xhci_ring_init(&ctrl->cmd_ring) < 0) {
+        return -1;
+    }
+    xhci_write64(ctrl->op, XHCI_OP_CRCR, ctrl->cmd_ring.phys | ctrl->cmd_ring.cycle);
+
+    uint64_t erst_phys;
+    xhci_erst_entry_t *erst = (xhci_erst_entry_t *)pmm_alloc_dma(1, &erst_phys);
+    ctrl->event_ring = (volatile xhci_trb_t *)pmm_alloc_dma(1, &ctrl->event_phys);
+    ctrl->ctrl_buf = (uint8_t *)pmm_alloc_dma(1, &ctrl->ctrl_buf_phys);
+    if (!erst || !ctrl->event_ring || !ctrl->ctrl_buf) {
+        return -1;
+    }
+
+    erst[0].base = ctrl->event_phys;
+    erst[0].size = XHCI_RING_TRBS;
+    ctrl->event_dequeue = 0;
+    ctrl->event_cycle = 1;
+
+    xhci_write32(ctrl->rt, XHCI_RT_ERSTSZ, 1);
+    xhci_write64(ctrl->rt, XHCI_RT_ERDP, ctrl->event_phys);
+    xhci_write64(ctrl->rt, XHCI_RT_ERSTBA, erst_phys);
+
+    /* At most one interrupt per moderation interval, in 250 ns units */
+    uint32_t imod = XHCI_IMOD_US * 4;
+    xhci_write32(ctrl->rt, XHCI_RT_IMOD, imod > 0xFFFF ? 0xFFFF : imod);
+    return 0;
+}
+
+/**
+ * Bring up one xHCI controller and the devices on its ports
+ */
+static int xhci_attach(pci_device_t *pci) {
+    if (xhci_count >= XHCI_MAX_CONTROLLERS) {
+        return -1;
+    }
+
+    xhci_ctrl_t *ctrl = (xhci_ctrl_t *)kzalloc(sizeof(xhci_ctrl_t));
+    if (!ctrl) {
+        return -1;
+    }
+    ctrl->pci = pci;
+    ctrl->vector = -1;
+
+    ctrl->cap = (volatile uint8_t *)pci_map_bar(pci, 0);
+    if (!ctrl->cap) {
+        kfree(ctrl);
+        return -1;
+    }
+    pci_enable_bus_master(pci);
+
+    ctrl->op = ctrl->cap + (xhci_read32(ctrl->cap, XHCI_CAP_CAPLENGTH) & 0xFF);
+    ctrl->rt = ctrl->cap + (xhci_read32(ctrl->cap, XHCI_CAP_RTSOFF) & ~0x1Fu);
+    ctrl->db = (volatile uint32_t *)(ctrl->cap + (xhci_read32(ctrl->cap, XHCI_CAP_DBOFF) & ~0x3u));
+
+    uint32_t hcsparams1 = xhci_read32(ctrl->cap, XHCI_CAP_HCSPARAMS1);
+    uint32_t hccparams1 = xhci_read32(ctrl->cap, XHCI_CAP_HCCPARAMS1);
+    ctrl->max_slots = hcsparams1 & 0xFF;
+    if (ctrl->max_slots > XHCI_MAX_SLOTS) {
+        ctrl->max_slots = XHCI_MAX_SLOTS;
+    }
+    ctrl->max_ports = hcsparams1 >> 24;
+    ctrl->ctx_size = (hccparams1 & XHCI_HCC_CSZ) ? 64 : 32;
+
+    xhci_take_ownership(ctrl, hccparams1);
+
+    /* Halt and reset the controller */
+    xhci_write32(ctrl->op, XHCI_OP_USBCMD, xhci_read32(ctrl->op, XHCI_OP_USBCMD) & ~XHCI_CMD_RUN);
+    if (xhci_wait_reg(ctrl->op, XHCI_OP_USBSTS, XHCI_STS_HALTED, XHCI_STS_HALTED, XHCI_TIMEOUT_MS) < 0) {
+        kerr("XHCI: Controller did not halt\n");
+        return -1;
+    }
+    xhci_write32(ctrl->op, XHCI_OP_USBCMD, XHCI_CMD_RESET);
+    if (xhci_wait_reg(ctrl->op, XHCI_OP_USBCMD, XHCI_CMD_RESET, 0, XHCI_TIMEOUT_MS) < 0 ||
+        xhci_wait_reg(ctrl->op, XHCI_OP_USBSTS, XHCI_STS_CNR, 0, XHCI_TIMEOUT_MS) < 0) {
+        kerr("XHCI: Controller did not reset\n");
+        return -1;
+    }
+
+    xhci_write32(ctrl->op, XHCI_OP_CONFIG, ctrl->max_slots);
+
+    ctrl->dcbaa = (uint64_t *)pmm_alloc_dma(1, &ctrl->dcbaa_phys);
+    if (!ctrl->dcbaa || xhci_setup_scratchpad(ctrl) < 0 || xhci_setup_rings(ctrl) < 0) {
+        kerr("XHCI: Out of memory\n");
+        return -1;
+    }
+    xhci_write64(ctrl->op, XHCI_OP_DCBAAP, ctrl->dcbaa_phys);
+
+    /* One interrupter, one MSI-X vector */
+    if (pci_msix_enable(pci) < 1) {
+        kerr("XHCI: MSI-X is not available\n");
+        return -1;
+    }
+    int vector = idt_alloc_vector(xhci_irq, ctrl);
+    if (vector < 0 || pci_msix_set_vector(pci, 0, (uint8_t)vector, lapic_id()) < 0) {
+        pci_msix_disable(pci);
+        return -1;
+    }
+    ctrl->vector = vector;
+    xhci_write32(ctrl->rt, XHCI_RT_IMAN, XHCI_IMAN_IE | XHCI_IMAN_IP);
+
+    xhci_write32(ctrl->op, XHCI_OP_USBCMD, XHCI_CMD_RUN | XHCI_CMD_INTE);
+    if (xhci_wait_reg(ctrl->op, XHCI_OP_USBSTS, XHCI_STS_HALTED, 0, XHCI_TIMEOUT_MS) < 0) {
+        kerr("XHCI: Controller did not start\n");
+        return -1;
+    }
+
+    kprintf("XHCI: %02x:%02x.%x: %u ports, %u slots, %u-byte contexts, IMOD %u us\n",
+            pci->bus, pci->slot, pci->func, ctrl->max_ports, ctrl->max_slots,
+            ctrl->ctx_size, XHCI_IMOD_US);
+    xhci_controllers[xhci_count++] = ctrl;
+
+    for (uint32_t port = 1; port <= ctrl->max_ports; port++) {
+        int speed = xhci_port_reset(ctrl, (uint8_t)port);
+        if (speed > 0 && xhci_enumerate(ctrl, (uint8_t)port, (uint8_t)speed) < 0) {
+            kerr("XHCI: Port %u: enumeration failed\n", port);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Print interrupt and report counts, showing how well interrupts are moderated
+ */
+void xhci_print_stats(void) {
+    for (int i = 0; i < xhci_count; i++) {
+        xhci_ctrl_t *ctrl = xhci_controllers[i];
+        kprintf("XHCI: %d: %lu interrupts, %lu events, %lu HID reports\n",
+                i, ctrl->interrupts, ctrl->events, ctrl->reports);
+    }
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int xhci_probe_driver(device_driver_t *driver) {
+    pci_device_t *pci;
+
+    for (int index = 0; (pci = pci_find_class(PCI_CLASS_SERIAL_BUS, PCI_SUBCLASS_USB, index)) != NULL; index++) {
+        if (pci->prog_if != XHCI_PCI_PROG_IF) {
+            continue;
+        }
+        if (xhci_attach(pci) < 0) {
+            kerr("XHCI: Failed to attach %02x:%02x.%x\n", pci->bus, pci->slot, pci->func);
+        }
+    }
+
+    if (xhci_count == 0) {
+        kprintf("XHCI: No controllers found\n");
+    }
+    driver->private_data = xhci_controllers;
+    return 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int xhci_remove_driver(device_driver_t *driver) {
+    for (int i = 0; i < xhci_count; i++) {
+        xhci_ctrl_t *ctrl = xhci_controllers[i];
+        xhci_write32(ctrl->op, XHCI_OP_USBCMD, 0);
+        if (ctrl->vector >= 0) {
+            idt_free_vector((uint8_t)ctrl->vector);
+        }
+        pci_msix_disable(ctrl->pci);
+    }
+    return 0;
+}
+
+/**
+ * Register the xHCI driver
+ */
+void xhci_register_driver(void) {
+    device_driver_register(&xhci_driver);
+}
\ No newline at end of file
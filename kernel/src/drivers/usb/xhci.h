@@ -0,0 +1,231 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * xHCI USB host controller driver
+ */
+
+#ifndef _DRIVERS_USB_XHCI_H
+#define _DRIVERS_USB_XHCI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/pci/pci.h>
+#include <drivers/usb/usb.h>
+#include <drivers/usb/usb_hid.h>
+
+/* PCI programming interface of xHCI controllers */
+#define XHCI_PCI_PROG_IF        0x30
+
+/* Limits */
+#define XHCI_MAX_CONTROLLERS    2
+#define XHCI_MAX_SLOTS          32
+
+/* TRBs per ring; one page, the last entry links back to the first */
+#define XHCI_RING_TRBS          256
+
+/* Interrupt transfers kept queued on each HID endpoint */
+#define XHCI_HID_TRANSFERS      8
+
+/* Capability registers */
+#define XHCI_CAP_CAPLENGTH      0x00
+#define XHCI_CAP_HCSPARAMS1     0x04
+#define XHCI_CAP_HCSPARAMS2     0x08
+#define XHCI_CAP_HCCPARAMS1     0x10
+#define XHCI_CAP_DBOFF          0x14
+#define XHCI_CAP_RTSOFF         0x18
+
+/* HCCPARAMS1 bits */
+#define XHCI_HCC_CSZ            (1u << 2)   /* 64-byte contexts */
+
+/* Operational registers */
+#define XHCI_OP_USBCMD          0x00
+#define XHCI_OP_USBSTS          0x04
+#define XHCI_OP_CRCR            0x18
+#define XHCI_OP_DCBAAP          0x30
+#define XHCI_OP_CONFIG          0x38
+#define XHCI_OP_PORTSC(port)    (0x400 + ((port) - 1) * 0x10)
+
+/* USBCMD bits */
+#define XHCI_CMD_RUN            (1u << 0)
+#define XHCI_CMD_RESET          (1u << 1)
+#define XHCI_CMD_INTE           (1u << 2)
+
+/* USBSTS bits */
+#define XHCI_STS_HALTED         (1u << 0)
+#define XHCI_STS_EINT           (1u << 3)
+#define XHCI_STS_CNR            (1u << 11)
+
+/* PORTSC bits */
+#define XHCI_PORTSC_CCS         (1u << 0)
+#define XHCI_PORTSC_PED         (1u << 1)
+#define XHCI_PORTSC_PR          (1u << 4)
+#define XHCI_PORTSC_SPEED(x)    (((x) >> 10) & 0xF)
+#define XHCI_PORTSC_PRC         (1u << 21)
+#define XHCI_PORTSC_CHANGES     (0x7Fu << 17)
+
+/* Interrupter 0 registers, relative to the runtime registers */
+#define XHCI_RT_IMAN            0x20
+#define XHCI_RT_IMOD            0x24
+#define XHCI_RT_ERSTSZ          0x28
+#define XHCI_RT_ERSTBA          0x30
+#define XHCI_RT_ERDP            0x38
+
+/* IMAN bits */
+#define XHCI_IMAN_IP            (1u << 0)
+#define XHCI_IMAN_IE            (1u << 1)
+
+/* ERDP: event handler busy */
+#define XHCI_ERDP_EHB           (1ULL << 3)
+
+/* Extended capabilities */
+#define XHCI_EXT_CAP_LEGACY     1
+#define XHCI_LEGACY_BIOS_OWNED  (1u << 16)
+#define XHCI_LEGACY_OS_OWNED    (1u << 24)
+
+/* TRB control fields */
+#define XHCI_TRB_CYCLE          (1u << 0)
+#define XHCI_TRB_TOGGLE_CYCLE   (1u << 1)   /* Link TRBs */
+#define XHCI_TRB_ISP            (1u << 2)
+#define XHCI_TRB_IOC            (1u << 5)
+#define XHCI_TRB_IDT            (1u << 6)
+#define XHCI_TRB_TYPE(t)        ((uint32_t)(t) << 10)
+#define XHCI_TRB_GET_TYPE(c)    (((c) >> 10) & 0x3F)
+#define XHCI_TRB_SLOT(s)        ((uint32_t)(s) << 24)
+#define XHCI_TRB_DIR_IN         (1u << 16)  /* Data and status stages */
+#define XHCI_TRB_TRT_OUT        (2u << 16)  /* Setup stage transfer types */
+#define XHCI_TRB_TRT_IN         (3u << 16)
+
+/* TRB types */
+#define XHCI_TRB_NORMAL         1
+#define XHCI_TRB_SETUP          2
+#define XHCI_TRB_DATA           3
+#define XHCI_TRB_STATUS         4
+#define XHCI_TRB_LINK           6
+#define XHCI_TRB_ENABLE_SLOT    9
+#define XHCI_TRB_ADDRESS_DEVICE 11
+#define XHCI_TRB_CONFIGURE_EP   12
+#define XHCI_TRB_EVALUATE_CTX   13
+#define XHCI_TRB_TRANSFER_EVENT 32
+#define XHCI_TRB_COMMAND_EVENT  33
+#define XHCI_TRB_PORT_EVENT     34
+
+/* Completion codes */
+#define XHCI_CC_SUCCESS         1
+#define XHCI_CC_SHORT_PACKET    13
+
+/* Endpoint types */
+#define XHCI_EP_CONTROL         4
+#define XHCI_EP_INTERRUPT_IN    7
+
+/* Transfer request block */
+typedef struct xhci_trb {
+    uint64_t param;
+    uint32_t status;
+    uint32_t control;
+} __attribute__((packed)) xhci_trb_t;
+
+/* Event ring segment table entry */
+typedef struct xhci_erst_entry {
+    uint64_t base;
+    uint32_t size;
+    uint32_t reserved;
+} __attribute__((packed)) xhci_erst_entry_t;
+
+/* Producer side of a command or transfer ring */
+typedef struct xhci_ring {
+    volatile xhci_trb_t *trbs;
+    uint64_t phys;
+    uint32_t enqueue;           /* Next TRB written */
+    uint32_t cycle;             /* Producer cycle state */
+} xhci_ring_t;
+
+struct xhci_ctrl;
+
+/* One addressed device */
+typedef struct xhci_device {
+    usb_device_t usb;           /* What class drivers see */
+    struct xhci_ctrl *ctrl;
+    uint8_t slot_id;
+
+    void *out_ctx;              /* Device context (written by the controller) */
+    uint64_t out_ctx_phys;
+    void *in_ctx;               /* Input context for commands */
+    uint64_t in_ctx_phys;
+
+    xhci_ring_t ep0;            /* Default control endpoint */
+    volatile bool ctrl_done;    /* Control transfer completed */
+    uint8_t ctrl_cc;            /* Its completion code */
+
+    /* HID interrupt endpoint */
+    bool hid_active;
+    uint8_t hid_dci;            /* Device context index */
+    uint16_t hid_packet;        /* Max packet size */
+    xhci_ring_t hid_ring;
+    uint8_t *reports;           /* XHCI_HID_TRANSFERS report buffers */
+    uint64_t reports_phys;
+    usb_hid_t hid;
+} xhci_device_t;
+
+/* Controller */
+typedef struct xhci_ctrl {
+    pci_device_t *pci;
+    volatile uint8_t *cap;      /* Capability registers */
+    volatile uint8_t *op;       /* Operational registers */
+    volatile uint8_t *rt;       /* Runtime registers */
+    volatile uint32_t *db;      /* Doorbell array */
+
+    uint32_t max_slots;
+    uint32_t max_ports;
+    uint32_t ctx_size;          /* 32 or 64 bytes */
+
+    uint64_t *dcbaa;            /* Device context base address array */
+    uint64_t dcbaa_phys;
+
+    xhci_ring_t cmd_ring;
+    volatile bool cmd_done;     /* Command completion seen */
+    uint8_t cmd_cc;             /* Its completion code */
+    uint8_t cmd_slot;           /* Its slot ID */
+
+    volatile xhci_trb_t *event_ring;
+    uint64_t event_phys;
+    uint32_t event_dequeue;     /* Next event read */
+    uint32_t event_cycle;       /* Consumer cycle state */
+
+    uint8_t *ctrl_buf;          /* Bounce page for control transfer data */
+    uint64_t ctrl_buf_phys;
+
+    int vector;                 /* Interrupt vector */
+    xhci_device_t *devices[XHCI_MAX_SLOTS + 1];
+
+    /* Statistics */
+    uint64_t interrupts;
+    uint64_t events;
+    uint64_t reports;
+} xhci_ctrl_t;
+
+/**
+ * Print interrupt and report counts, showing how well interrupts are moderated
+ */
+void xhci_print_stats(void);
+
+/**
+ * Register the xHCI driver
+ */
+void xhci_register_driver(void);
+
+#endif /* _DRIVERS_USB_XHCI_H */
\ No newline at end of file
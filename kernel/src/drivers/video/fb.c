@@ -0,0 +1,267 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Double-buffered framebuffer
+ *
+ * Framebuffer memory is slow to write one pixel at a time and very slow to
+ * read, so everything is drawn into a shadow copy in ordinary cached memory
+ * and the framebuffer is only written when the shadow is flushed. Drawing
+ * records the rectangles it touched; a flush copies just those, a scanline
+ * at a time, with 64-bit non-temporal stores into a write-combining mapping
+ * so that the stores leave the CPU as full-line bursts.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limine.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/time.h>
+#include <drivers/video/fb.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/* The boot framebuffer */
+static fb_t boot_fb;
+
+/**
+ * Store 8 bytes bypassing the cache
+ */
+static inline void fb_movnti64(volatile void *dst, uint64_t value) {
+    asm volatile ("movnti %1, %0" : "=m"(*(volatile uint64_t *)dst) : "r"(value));
+}
+
+/**
+ * Store 4 bytes bypassing the cache
+ */
+static inline void fb_movnti32(volatile void *dst, uint32_t value) {
+    asm volatile ("movnti %1, %0" : "=m"(*(volatile uint32_t *)dst) : "r"(value));
+}
+
+/**
+ * Copy one scanline to the framebuffer with non-temporal stores
+ * @param dst Framebuffer address (2-byte aligned)
+ * @param src Shadow address
+ * @param len Bytes (a multiple of 2)
+ */
+static void fb_copy_line(volatile uint8_t *dst, const uint8_t *src, size_t len) {
+    /* Align the destination so the bulk is whole 8-byte stores */
+    if (((uintptr_t)dst & 2) && len >= 2) {
+        *(volatile uint16_t *)dst = *(const uint16_t *)src;
+        dst += 2;
+        src += 2;
+        len -= 2;
+    }
+    if (((uintptr_t)dst & 4) && len >= 4) {
+        fb_movnti32(dst, *(const uint32_t *)src);
+        dst += 4;
+        src += 4;
+        len -= 4;
+    }
+
+    while (len >= 32) {
+        const uint64_t *s = (const uint64_t *)src;
+        fb_movnti64(dst, s[0]);
+        fb_movnti64(dst + 8, s[1]);
+        fb_movnti64(dst + 16, s[2]);
+        fb_movnti64(dst + 24, s[3]);
+        dst += 32;
+        src += 32;
+        len -= 32;
+    }
+    while (len >= 8) {
+        fb_movnti64(dst, *(const uint64_t *)src);
+        dst += 8;
+        src += 8;
+        len -= 8;
+    }
+
+    if (len >= 4) {
+        fb_movnti32(dst, *(const uint32_t *)src);
+        dst += 4;
+        src += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        *(volatile uint16_t *)dst = *(const uint16_t *)src;
+    }
+}
+
+/**
+ * Check whether two rectangles overlap or touch
+ */
+static bool fb_rect_adjacent(const fb_rect_t *a, const fb_rect_t *b) {
+    return a->x <= b->x + b->width && b->x <= a->x + a->width &&
+           a->y <= b->y + b->height && b->y <= a->y + a->height;
+}
+
+/**
+ * Grow a rectangle to also cover another
+ */
+static void fb_rect_union(fb_rect_t *a, const fb_rect_t *b) {
+    uint32_t x1 = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+    uint32_t y1 = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+
+    a->x = a->x < b->x ? a->x : b->x;
+    a->y = a->y < b->y ? a->y : b->y;
+    a->width = x1 - a->x;
+    a->height = y1 - a->y;
+}
+
+/**
+ * Map a framebuffer write-combining, set up its shadow and clear both
+ * @param framebuffer Limine framebuffer
+ * @return The framebuffer, or NULL on failure
+ */
+fb_t *fb_init(struct limine_framebuffer *framebuffer) {
+    fb_t *fb = &boot_fb;
+
+    if (!framebuffer || framebuffer->bpp % 8 != 0 || framebuffer->bpp == 0) {
+        kerr("FB: Unsupported framebuffer format\n");
+        return NULL;
+    }
+
+    memset(fb, 0, sizeof(*fb));
+    fb->width = framebuffer->width;
+    fb->height = framebuffer->height;
+    fb->bytes_pp = framebuffer->bpp / 8;
+    fb->vram_pitch = framebuffer->pitch;
+
+    uint64_t vram_phys = virt_to_phys(framebuffer->address);
+    size_t vram_size = (size_t)fb->vram_pitch * fb->height;
+    fb->vram = (volatile uint8_t *)vmm_map_wc(vram_phys, vram_size);
+    if (!fb->vram) {
+        /* Keep the bootloader's mapping */
+        fb->vram = (volatile uint8_t *)framebuffer->address;
+    }
+
+    /* Shadow scanlines start on cache lines */
+    fb->pitch = (fb->width * fb->bytes_pp + 63) & ~63U;
+    fb->shadow_pages = ((size_t)fb->pitch * fb->height + PAGE_SIZE - 1) / PAGE_SIZE;
+    fb->shadow_phys = pmm_alloc_pages(fb->shadow_pages);
+    if (fb->shadow_phys) {
+        fb->shadow = (uint8_t *)phys_to_virt(fb->shadow_phys);
+        memset(fb->shadow, 0, fb->shadow_pages * PAGE_SIZE);
+    } else {
+        /* Draw straight into the framebuffer; flushes have nothing to do */
+        kerr("FB: No memory for a shadow buffer, drawing unbuffered\n");
+        fb->shadow = (uint8_t *)fb->vram;
+        fb->pitch = fb->vram_pitch;
+        fb->shadow_pages = 0;
+        for (uint32_t y = 0; y < fb->height; y++) {
+            memset(fb->shadow + (size_t)y * fb->pitch, 0, (size_t)fb->width * fb->bytes_pp);
+        }
+    }
+
+    fb_damage(fb, 0, 0, fb->width, fb->height);
+    fb_flush(fb);
+
+    kprintf("FB: %ux%u, %u bpp at 0x%lx, %s\n", fb->width, fb->height,
+            fb->bytes_pp * 8, vram_phys,
+            fb->shadow_phys ? "double-buffered" : "unbuffered");
+    return fb;
+}
+
+/**
+ * Record that a rectangle of the shadow has changed
+ * @param fb Framebuffer
+ * @param x Left edge in pixels
+ * @param y Top edge in pixels
+ * @param width Width in pixels
+ * @param height Height in pixels
+ */
+void fb_damage(fb_t *fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    if (!fb || !fb->shadow_phys || x >= fb->width || y >= fb->height) {
+        return;
+    }
+
+    fb_rect_t rect = {
+        .x = x,
+        .y = y,
+        .width = width < fb->width - x ? width : fb->width - x,
+        .height = height < fb->height - y ? height : fb->height - y
+    };
+
+    for (uint32_t i = 0; i < fb->damage_count; i++) {
+        if (fb_rect_adjacent(&fb->damage[i], &rect)) {
+            fb_rect_union(&fb->damage[i], &rect);
+            return;
+        }
+    }
+
+    if (fb->damage_count < FB_MAX_DAMAGE) {
+        fb->damage[fb->damage_count++] = rect;
+        return;
+    }
+
+    /* Out of slots: fold everything into one rectangle */
+    for (uint32_t i = 1; i < fb->damage_count; i++) {
+        fb_rect_union(&fb->damage[0], &fb->damage[i]);
+    }
+    fb_rect_union(&fb->damage[0], &rect);
+    fb->damage_count = 1;
+}
+
+/**
+ * Copy the damaged rectangles of the shadow to the framebuffer
+ * @param fb Framebuffer
+ */
+void fb_flush(fb_t *fb) {
+    if (!fb || fb->damage_count == 0) {
+        return;
+    }
+
+    uint64_t start = time_now_ns();
+    uint64_t bytes = 0;
+
+    for (uint32_t i = 0; i < fb->damage_count; i++) {
+        const fb_rect_t *rect = &fb->damage[i];
+        size_t offset = (size_t)rect->x * fb->bytes_pp;
+        size_t len = (size_t)rect->width * fb->bytes_pp;
+
+        for (uint32_t y = rect->y; y < rect->y + rect->height; y++) {
+            fb_copy_line(fb->vram + (size_t)y * fb->vram_pitch + offset,
+                         fb->shadow + (size_t)y * fb->pitch + offset, len);
+        }
+        bytes += len * rect->height;
+    }
+
+    /* Drain the write-combining buffers before anyone looks at the screen */
+    asm volatile ("sfence" : : : "memory");
+
+    fb->flushes++;
+    fb->rects += fb->damage_count;
+    fb->bytes += bytes;
+    fb->flush_ns += time_now_ns() - start;
+    fb->damage_count = 0;
+}
+
+/**
+ * Print flush statistics
+ * @param fb Framebuffer
+ */
+void fb_print_stats(fb_t *fb) {
+    if (!fb) {
+        return;
+    }
+
+    uint64_t mb_per_s = fb->flush_ns ? fb->bytes * 1000 / fb->flush_ns : 0;
+    kprintf("FB: %lu flushes, %lu rects, %lu KiB copied in %lu us (%lu MB/s)\n",
+            fb->flushes, fb->rects, fb->bytes / 1024, fb->flush_ns / 1000, mb_per_s);
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Double-buffered framebuffer
+ */
+
+#ifndef _DRIVERS_VIDEO_FB_H
+#define _DRIVERS_VIDEO_FB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limine.h>
+
+/* Damaged rectangles tracked between flushes; more are merged */
+#define FB_MAX_DAMAGE       8
+
+/* Rectangle in pixels */
+typedef struct fb_rect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} fb_rect_t;
+
+/* Framebuffer and its shadow */
+typedef struct fb {
+    volatile uint8_t *vram;     /* Write-combining mapping of the framebuffer */
+    uint32_t vram_pitch;        /* Bytes per scanline in the framebuffer */
+    uint8_t *shadow;            /* Cached copy that is drawn into */
+    uint32_t pitch;             /* Bytes per scanline in the shadow */
+    uint64_t shadow_phys;       /* Shadow pages, 0 if drawing goes to vram */
+    size_t shadow_pages;
+    uint32_t width;             /* Pixels */
+    uint32_t height;
+    uint32_t bytes_pp;          /* Bytes per pixel */
+
+    fb_rect_t damage[FB_MAX_DAMAGE];
+    uint32_t damage_count;
+
+    /* Statistics */
+    uint64_t flushes;           /* Flushes that copied anything */
+    uint64_t rects;             /* Rectangles copied */
+    uint64_t bytes;             /* Bytes copied to the framebuffer */
+    uint64_t flush_ns;          /* Time spent copying */
+} fb_t;
+
+/**
+ * Map a framebuffer write-combining, set up its shadow and clear both
+ * @param framebuffer Limine framebuffer
+ * @return The framebuffer, or NULL on failure
+ */
+fb_t *fb_init(struct limine_framebuffer *framebuffer);
+
+/**
+ * Record that a rectangle of the shadow has changed
+ * @param fb Framebuffer
+ * @param x Left edge in pixels
+ * @param y Top edge in pixels
+ * @param width Width in pixels
+ * @param height Height in pixels
+ */
+void fb_damage(fb_t *fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+/**
+ * Copy the damaged rectangles of the shadow to the framebuffer
+ * @param fb Framebuffer
+ */
+void fb_flush(fb_t *fb);
+
+/**
+ * Print flush statistics
+ * @param fb Framebuffer
+ */
+void fb_print_stats(fb_t *fb);
+
+#endif /* _DRIVERS_VIDEO_FB_H */
\ No newline at end of file
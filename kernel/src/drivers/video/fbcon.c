@@ -0,0 +1,363 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Framebuffer text console
+ *
+ * Text is kept in a shadow buffer and only reaches the framebuffer when the
+ * screen is brought up to date, at most every FBCON_REFRESH_NS, so a burst
+ * of log lines costs one redraw of the final screen instead of one per
+ * line. The shadow is a ring of rows: scrolling moves its origin instead of
+ * copying text, and no pixels are ever read or moved. An update
+ * compares each row of the shadow with the characters on screen and only
+ * redraws the cells that changed.
+ *
+ * Drawing works from a table holding, for every 8-pixel row pattern a glyph
+ * can have, a mask already expanded to the framebuffer's pixel size. A cell
+ * row is then (fg & mask) | (bg & ~mask) over a few 64-bit words, and a
+ * span of cells is drawn one scanline at a time into the framebuffer's
+ * shadow and reported as damage, so an update ends with one flush of the
+ * rectangles that changed.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limine.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <drivers/video/font.h>
+#include <drivers/video/fbcon.h>
+#include <mm/kmalloc.h>
+
+/* The console; fb is NULL until fbcon_init succeeds */
+static fbcon_t fbcon;
+
+/**
+ * Convert an 0xRRGGBB colour to a pixel value of the framebuffer's format
+ */
+static uint32_t fbcon_pixel(struct limine_framebuffer *framebuffer, uint32_t rgb) {
+    uint8_t r = (rgb >> 16) & 0xFF;
+    uint8_t g = (rgb >> 8) & 0xFF;
+    uint8_t b = rgb & 0xFF;
+
+    return ((uint32_t)(r >> (8 - framebuffer->red_mask_size)) << framebuffer->red_mask_shift) |
+           ((uint32_t)(g >> (8 - framebuffer->green_mask_size)) << framebuffer->green_mask_shift) |
+           ((uint32_t)(b >> (8 - framebuffer->blue_mask_size)) << framebuffer->blue_mask_shift);
+}
+
+/**
+ * Repeat a pixel value across 64 bits
+ */
+static uint64_t fbcon_replicate(uint32_t pixel, uint32_t bytes_pp) {
+    if (bytes_pp == 2) {
+        uint64_t p = pixel & 0xFFFF;
+        return p | (p << 16) | (p << 32) | (p << 48);
+    }
+    return (uint64_t)pixel | ((uint64_t)pixel << 32);
+}
+
+/**
+ * Expand every 8-bit glyph row pattern into a pixel mask
+ * @return 0 on success, negative if out of memory
+ */
+static int fbcon_build_masks(fbcon_t *con) {
+    con->mask_words = FBCON_CELL_WIDTH * con->bytes_pp / sizeof(uint32_t);
+    con->masks = (uint32_t *)kmalloc_aligned(256 * con->mask_words * sizeof(uint32_t), 64);
+    if (!con->masks) {
+        return -1;
+    }
+
+    for (uint32_t pattern = 0; pattern < 256; pattern++) {
+        uint32_t *mask = &con->masks[pattern * con->mask_words];
+        for (uint32_t w = 0; w < con->mask_words; w++) {
+            mask[w] = 0;
+        }
+
+        for (uint32_t x = 0; x < FBCON_CELL_WIDTH; x++) {
+            if (!(pattern & (1U << x))) {
+                continue;
+            }
+            if (con->bytes_pp == 4) {
+                mask[x] = 0xFFFFFFFF;
+            } else {
+                mask[x / 2] |= 0xFFFFU << ((x % 2) * 16);
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Get the ring row holding a screen row
+ */
+static inline uint8_t *fbcon_text_row(fbcon_t *con, uint32_t row) {
+    return &con->text[((con->top + row) % con->rows) * con->cols];
+}
+
+/**
+ * Draw the cells [first, last] of a screen row from the text
+ */
+static void fbcon_draw_span(fbcon_t *con, uint32_t row, uint32_t first, uint32_t last) {
+    const uint8_t *text = fbcon_text_row(con, row);
+    uint32_t cell_bytes = FBCON_CELL_WIDTH * con->bytes_pp;
+    uint8_t *line = con->pixels + (size_t)row * FBCON_CELL_HEIGHT * con->pitch +
+                             (size_t)first * cell_bytes;
+    bool wide = (con->pitch % sizeof(uint64_t)) == 0;
+
+    for (uint32_t y = 0; y < FBCON_CELL_HEIGHT; y++, line += con->pitch) {
+        uint32_t font_row = y * FONT_HEIGHT / FBCON_CELL_HEIGHT;
+
+        if (wide) {
+            uint64_t *dst = (uint64_t *)line;
+            for (uint32_t c = first; c <= last; c++) {
+                uint8_t ch = text[c] < FONT_GLYPHS ? text[c] : '?';
+                const uint64_t *mask = (const uint64_t *)
+                    &con->masks[font8x8[ch][font_row] * con->mask_words];
+                for (uint32_t w = 0; w < con->mask_words / 2; w++) {
+                    *dst++ = (con->fg & mask[w]) | (con->bg & ~mask[w]);
+                }
+            }
+        } else {
+            uint32_t *dst = (uint32_t *)line;
+            uint32_t fg = (uint32_t)con->fg;
+            uint32_t bg = (uint32_t)con->bg;
+            for (uint32_t c = first; c <= last; c++) {
+                uint8_t ch = text[c] < FONT_GLYPHS ? text[c] : '?';
+                const uint32_t *mask = &con->masks[font8x8[ch][font_row] * con->mask_words];
+                for (uint32_t w = 0; w < con->mask_words; w++) {
+                    *dst++ = (fg & mask[w]) | (bg & ~mask[w]);
+                }
+            }
+        }
+    }
+
+    fb_damage(con->fb, first * FBCON_CELL_WIDTH, row * FBCON_CELL_HEIGHT,
+              (last - first + 1) * FBCON_CELL_WIDTH, FBCON_CELL_HEIGHT);
+    memcpy(&con->screen[(size_t)row * con->cols + first], &text[first], last - first + 1);
+    con->cells_drawn += last - first + 1;
+}
+
+/**
+ * Bring the screen up to date with the text
+ */
+static void fbcon_draw(fbcon_t *con) {
+    for (uint32_t row = 0; row < con->rows; row++) {
+        if (!con->dirty[row]) {
+            continue;
+        }
+        con->dirty[row] = 0;
+
+        const uint8_t *text = fbcon_text_row(con, row);
+        const uint8_t *shown = &con->screen[(size_t)row * con->cols];
+        uint32_t col = 0;
+        while (col < con->cols) {
+            if (text[col] == shown[col]) {
+                col++;
+                continue;
+            }
+
+            /* Extend over short runs of unchanged cells; one span beats several */
+            uint32_t first = col;
+            uint32_t last = col;
+            for (col++; col < con->cols; col++) {
+                if (text[col] != shown[col]) {
+                    last = col;
+                } else if (col - last > 4) {
+                    break;
+                }
+            }
+            fbcon_draw_span(con, row, first, last);
+        }
+    }
+
+    fb_flush(con->fb);
+    con->draws++;
+    con->last_draw_ns = time_now_ns();
+}
+
+/**
+ * Move to a new line, scrolling the ring if the cursor is on the last row
+ */
+static void fbcon_newline(fbcon_t *con) {
+    con->cx = 0;
+    if (con->cy + 1 < con->rows) {
+        con->cy++;
+        return;
+    }
+
+    /* The old first row becomes the new last row; every screen row changes */
+    con->top = (con->top + 1) % con->rows;
+    memset(fbcon_text_row(con, con->rows - 1), ' ', con->cols);
+    memset(con->dirty, 1, con->rows);
+    con->scrolls++;
+}
+
+/**
+ * Put one character into the text
+ */
+static void fbcon_putc(fbcon_t *con, char c) {
+    switch (c) {
+        case '\n':
+            fbcon_newline(con);
+            return;
+        case '\r':
+            con->cx = 0;
+            return;
+        case '\b':
+            if (con->cx > 0) {
+                con->cx--;
+            }
+            return;
+        case '\t':
+            do {
+                fbcon_putc(con, ' ');
+            } while (con->cx % 8 != 0);
+            return;
+        default:
+            break;
+    }
+
+    if (con->cx >= con->cols) {
+        fbcon_newline(con);
+    }
+    fbcon_text_row(con, con->cy)[con->cx++] = (uint8_t)c;
+    con->dirty[con->cy] = 1;
+}
+
+/**
+ * Take over a framebuffer as the kernel console and clear it
+ * @param framebuffer Limine framebuffer (16 or 32 bits per pixel)
+ * @return 0 on success, negative if the framebuffer cannot be used
+ */
+int fbcon_init(struct limine_framebuffer *framebuffer) {
+    if (!framebuffer || (framebuffer->bpp != 16 && framebuffer->bpp != 32) ||
+        framebuffer->memory_model != LIMINE_FRAMEBUFFER_RGB) {
+        kerr("FBCON: Unsupported framebuffer format\n");
+        return -1;
+    }
+
+    fbcon_t con;
+    memset(&con, 0, sizeof(con));
+    con.width = framebuffer->width;
+    con.height = framebuffer->height;
+    con.bytes_pp = framebuffer->bpp / 8;
+    con.cols = con.width / FBCON_CELL_WIDTH;
+    con.rows = con.height / FBCON_CELL_HEIGHT;
+    if (con.cols == 0 || con.rows == 0) {
+        return -1;
+    }
+
+    con.fg = fbcon_replicate(fbcon_pixel(framebuffer, FBCON_DEFAULT_FG), con.bytes_pp);
+    con.bg = fbcon_replicate(fbcon_pixel(framebuffer, FBCON_DEFAULT_BG), con.bytes_pp);
+
+    size_t cells = (size_t)con.cols * con.rows;
+    con.text = (uint8_t *)kmalloc(cells);
+    con.screen = (uint8_t *)kmalloc(cells);
+    con.dirty = (uint8_t *)kzalloc(con.rows);
+    if (!con.text || !con.screen || !con.dirty || fbcon_build_masks(&con) < 0) {
+        kfree(con.text);
+        kfree(con.screen);
+        kfree(con.dirty);
+        kfree(con.masks);
+        kerr("FBCON: Out of memory\n");
+        return -1;
+    }
+    memset(con.text, ' ', cells);
+    memset(con.screen, ' ', cells);
+
+    con.fb = fb_init(framebuffer);
+    if (!con.fb) {
+        kfree(con.text);
+        kfree(con.screen);
+        kfree(con.dirty);
+        kfree(con.masks);
+        return -1;
+    }
+    con.pixels = con.fb->shadow;
+    con.pitch = con.fb->pitch;
+
+    /* Paint the background, including the margins outside the grid */
+    for (uint32_t y = 0; y < con.height; y++) {
+        uint32_t *line = (uint32_t *)(con.pixels + (size_t)y * con.pitch);
+        for (uint32_t x = 0; x < con.width * con.bytes_pp / sizeof(uint32_t); x++) {
+            line[x] = (uint32_t)con.bg;
+        }
+    }
+    fb_damage(con.fb, 0, 0, con.width, con.height);
+    uint64_t flags = cpu_irq_save();
+    fbcon = con;
+    cpu_irq_restore(flags);
+
+    kprintf("FBCON: %ux%u text console on %ux%u, %u bpp\n",
+            con.cols, con.rows, con.width, con.height, framebuffer->bpp);
+    return 0;
+}
+
+/**
+ * Check whether the console is up
+ */
+bool fbcon_active(void) {
+    return fbcon.fb != NULL;
+}
+
+/**
+ * Write a string to the console; it is drawn once FBCON_REFRESH_NS has
+ * passed since the last update, or at the next fbcon_flush
+ * @param str NUL-terminated string
+ */
+void fbcon_write(const char *str) {
+    if (!fbcon.fb || !str) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    for (size_t i = 0; str[i] != '\0'; i++) {
+        fbcon_putc(&fbcon, str[i]);
+    }
+    if (time_now_ns() - fbcon.last_draw_ns >= FBCON_REFRESH_NS) {
+        fbcon_draw(&fbcon);
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Draw everything written so far
+ */
+void fbcon_flush(void) {
+    if (!fbcon.fb) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    fbcon_draw(&fbcon);
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Print console and framebuffer flush statistics
+ */
+void fbcon_print_stats(void) {
+    if (!fbcon.fb) {
+        return;
+    }
+
+    kprintf("FBCON: %lu updates, %lu cells drawn, %lu lines scrolled\n",
+            fbcon.draws, fbcon.cells_drawn, fbcon.scrolls);
+    fb_print_stats(fbcon.fb);
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Framebuffer text console
+ */
+
+#ifndef _DRIVERS_VIDEO_FBCON_H
+#define _DRIVERS_VIDEO_FBCON_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limine.h>
+#include <drivers/video/fb.h>
+
+/* Character cell in pixels; font rows are drawn twice */
+#define FBCON_CELL_WIDTH    8
+#define FBCON_CELL_HEIGHT   16
+
+/* Output is drawn at most this often; text in between only updates the shadow */
+#define FBCON_REFRESH_NS    (16 * 1000 * 1000)
+
+/* Default colours (0xRRGGBB) */
+#define FBCON_DEFAULT_FG    0xAAAAAA
+#define FBCON_DEFAULT_BG    0x000000
+
+/* Console state */
+typedef struct fbcon {
+    fb_t *fb;                   /* Framebuffer */
+    uint8_t *pixels;            /* Its shadow, which cells are drawn into */
+    uint32_t width;             /* Pixels */
+    uint32_t height;
+    uint32_t pitch;             /* Bytes per shadow scanline */
+    uint32_t bytes_pp;          /* Bytes per pixel (2 or 4) */
+    uint32_t cols;              /* Text cells */
+    uint32_t rows;
+
+    uint64_t fg;                /* Foreground pixel, repeated across 64 bits */
+    uint64_t bg;                /* Background pixel, repeated across 64 bits */
+    uint32_t *masks;            /* Pixel mask of every 8-pixel glyph row pattern */
+    uint32_t mask_words;        /* 32-bit words per pattern */
+
+    uint8_t *text;              /* Text rows, a ring starting at row top */
+    uint32_t top;               /* Ring row shown on the first screen row */
+    uint8_t *screen;            /* Character drawn in each screen cell */
+    uint8_t *dirty;             /* Screen rows that may differ from the text */
+    uint32_t cx;                /* Cursor column */
+    uint32_t cy;                /* Cursor screen row */
+    uint64_t last_draw_ns;      /* When the screen was last brought up to date */
+
+    /* Statistics */
+    uint64_t scrolls;           /* Lines scrolled */
+    uint64_t draws;             /* Screen updates */
+    uint64_t cells_drawn;       /* Cells redrawn */
+} fbcon_t;
+
+/**
+ * Take over a framebuffer as the kernel console and clear it
+ * @param framebuffer Limine framebuffer (16 or 32 bits per pixel)
+ * @return 0 on success, negative if the framebuffer cannot be used
+ */
+int fbcon_init(struct limine_framebuffer *framebuffer);
+
+/**
+ * Check whether the console is up
+ */
+bool fbcon_active(void);
+
+/**
+ * Write a string to the console; it is drawn once FBCON_REFRESH_NS has
+ * passed since the last update, or at the next fbcon_flush
+ * @param str NUL-terminated string
+ */
+void fbcon_write(const char *str);
+
+/**
+ * Draw everything written so far
+ */
+void fbcon_flush(void);
+
+/**
+ * Print console and framebuffer flush statistics
+ */
+void fbcon_print_stats(void);
+
+#endif /* _DRIVERS_VIDEO_FBCON_H */
\ No newline at end of file
@@ -0,0 +1,39 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Built-in console font
+ */
+
+#ifndef _DRIVERS_VIDEO_FONT_H
+#define _DRIVERS_VIDEO_FONT_H
+
+#include <stdint.h>
+
+/* Glyph cell of the built-in font */
+#define FONT_WIDTH      8
+#define FONT_HEIGHT     8
+
+/* Characters the font covers, from 0; others have blank glyphs */
+#define FONT_GLYPHS     128
+
+/*
+ * 8x8 glyphs for ASCII, one byte per row from the top. Bit 0 of a row is
+ * its leftmost pixel.
+ */
+extern const uint8_t font8x8[FONT_GLYPHS][FONT_HEIGHT];
+
+#endif /* _DRIVERS_VIDEO_FONT_H */
\ No newline at end of file
@@ -0,0 +1,517 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Virtio 1.x PCI transport and split virtqueues
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <kernel/barrier.h>
+#include <drivers/pci/pci.h>
+#include <drivers/virtio/virtio.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/**
+ * Check whether a notification or interrupt threshold was crossed
+ * @param event Index the other side asked to be told about
+ * @param new_idx Index after the update
+ * @param old_idx Index before the update
+ * @return true if event lies in [old_idx, new_idx)
+ */
+static inline bool vring_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) {
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+/**
+ * Resolve a virtio capability to a mapped address
+ * @param pci PCI function
+ * @param cap Capability offset in configuration space
+ * @return Mapped address of the structure, or NULL on failure
+ */
+static volatile uint8_t *virtio_map_cap(pci_device_t *pci, uint8_t cap) {
+    uint8_t bar = pci_config_read8(pci, cap + 4);
+    uint32_t offset = pci_config_read32(pci, cap + 8);
+
+    if (bar > 5) {
+        return NULL;
+    }
+
+    uint8_t *base = (uint8_t *)pci_map_bar(pci, bar);
+    if (!base) {
+        return NULL;
+    }
+    return (volatile uint8_t *)(base + offset);
+}
+
+/**
+ * Initialize the modern PCI transport of a virtio device and reset it
+ * @param vdev Device structure to fill
+ * @param pci Underlying PCI function
+ * @return 0 on success, negative on error
+ */
+int virtio_pci_init(virtio_device_t *vdev, pci_device_t *pci) {
+    if (!vdev || !pci) {
+        return -1;
+    }
+
+    memset(vdev, 0, sizeof(*vdev));
+    vdev->pci = pci;
+
+    /* Walk the vendor-specific capabilities describing the transport */
+    uint8_t cap = pci_find_capability(pci, PCI_CAP_ID_VENDOR, 0);
+    while (cap) {
+        uint8_t cfg_type = pci_config_read8(pci, cap + 3);
+
+        switch (cfg_type) {
+            case VIRTIO_PCI_CAP_COMMON_CFG:
+                if (!vdev->common) {
+                    vdev->common = (volatile virtio_pci_common_cfg_t *)virtio_map_cap(pci, cap);
+                }
+                break;
+            case VIRTIO_PCI_CAP_NOTIFY_CFG:
+                if (!vdev->notify_base) {
+                    vdev->notify_base = virtio_map_cap(pci, cap);
+                    vdev->notify_multiplier = pci_config_read32(pci, cap + 16);
+                }
+                break;
+            case VIRTIO_PCI_CAP_ISR_CFG:
+                if (!vdev->isr) {
+                    vdev->isr = virtio_map_cap(pci, cap);
+                }
+                break;
+            case VIRTIO_PCI_CAP_DEVICE_CFG:
+                if (!vdev->device_cfg) {
+                    vdev->device_cfg = virtio_map_cap(pci, cap);
+                }
+                break;
+            default:
+                break;
+        }
+
+        cap = pci_find_capability(pci, PCI_CAP_ID_VENDOR, cap);
+    }
+
+    if (!vdev->common || !vdev->notify_base) {
+        kerr("VIRTIO: Device %04x:%04x has no modern interface\n",
+             pci->vendor_id, pci->device_id);
+        return -1;
+    }
+
+    pci_enable_bus_master(pci);
+
+    /* Reset the device and wait for the reset to complete */
+    vdev->common->device_status = 0;
+    while (vdev->common->device_status != 0) {
+        /* Spin */
+    }
+
+    vdev->common->device_status = VIRTIO_STATUS_ACKNOWLEDGE;
+    vdev->common->device_status |= VIRTIO_STATUS_DRIVER;
+
+    /* No configuration change interrupts */
+    vdev->common->config_msix_vector = VIRTIO_MSI_NO_VECTOR;
+
+    return 0;
+}
+
+/**
+ * Negotiate features with the device
+ * @param vdev Virtio device
+ * @param wanted Features the driver supports
+ * @return 0 on success, negative if the device rejected the feature set
+ */
+int virtio_negotiate_features(virtio_device_t *vdev, uint64_t wanted) {
+    volatile virtio_pci_common_cfg_t *cfg = vdev->common;
+
+    cfg->device_feature_select = 0;
+    uint64_t offered = cfg->device_feature;
+    cfg->device_feature_select = 1;
+    offered |= (uint64_t)cfg->device_feature << 32;
+
+    if (!((offered >> VIRTIO_F_VERSION_1) & 1)) {
+        kerr("VIRTIO: Device does not offer VIRTIO_F_VERSION_1\n");
+        return -1;
+    }
+
+    vdev->features = offered & (wanted | (1ULL << VIRTIO_F_VERSION_1));
+
+    cfg->driver_feature_select = 0;
+    cfg->driver_feature = (uint32_t)vdev->features;
+    cfg->driver_feature_select = 1;
+    cfg->driver_feature = (uint32_t)(vdev->features >> 32);
+
+    cfg->device_status |= VIRTIO_STATUS_FEATURES_OK;
+    if (!(cfg->device_status & VIRTIO_STATUS_FEATURES_OK)) {
+        kerr("VIRTIO: Device rejected feature set 0x%lx\n", vdev->features);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Get the number of virtqueues the device offers
+ */
+uint16_t virtio_num_queues(virtio_device_t *vdev) {
+    return vdev->common->num_queues;
+}
+
+/**
+ * Find a shared memory region exposed by the device
+ * @param vdev Virtio device
+ * @param id Region ID (device specific)
+ * @param phys Output for the physical base address
+ * @param len Output for the length in bytes
+ * @return 0 on success, negative if the device has no such region
+ */
+int virtio_get_shm_region(virtio_device_t *vdev, uint8_t id, uint64_t *phys, uint64_t *len) {
+    pci_device_t *pci = vdev->pci;
+
+    for (uint8_t cap = pci_find_capability(pci, PCI_CAP_ID_VENDOR, 0); cap;
+         cap = pci_find_capability(pci, PCI_CAP_ID_VENDOR, cap)) {
+        if (pci_config_read8(pci, cap + 3) != VIRTIO_PCI_CAP_SHARED_MEMORY_CFG ||
+            pci_config_read8(pci, cap + 5) != id) {
+            continue;
+        }
+
+        /* virtio_pci_cap64: 64-bit offset and length split across the capability */
+        uint8_t bar = pci_config_read8(pci, cap + 4);
+        uint64_t offset = pci_config_read32(pci, cap + 8) | ((uint64_t)pci_config_read32(pci, cap + 16) << 32);
+        uint64_t length = pci_config_read32(pci, cap + 12) | ((uint64_t)pci_config_read32(pci, cap + 20) << 32);
+
+        if (bar > 5 || pci->bar_is_io[bar] || pci->bar[bar] == 0 ||
+            offset + length > pci->bar_size[bar]) {
+            return -1;
+        }
+
+        *phys = pci->bar[bar] + offset;
+        *len = length;
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Set up a virtqueue
+ * @param vdev Virtio device
+ * @param index Queue index
+ * @param max_size Upper bound on the ring size (0 for the device maximum)
+ * @return The virtqueue, or NULL on failure
+ */
+virtqueue_t *virtio_setup_queue(virtio_device_t *vdev, uint16_t index, uint16_t max_size) {
+    volatile virtio_pci_common_cfg_t *cfg = vdev->common;
+
+    cfg->queue_select = index;
+    uint16_t size = cfg->queue_size;
+    if (size == 0) {
+        kerr("VIRTIO: Queue %u is not available\n", index);
+        return NULL;
+    }
+
+    /* Keep the ring a power of two no larger than requested */
+    if (max_size && size > max_size) {
+        size = max_size;
+    }
+    while (size & (size - 1)) {
+        size &= size - 1;
+    }
+
+    virtqueue_t *vq = (virtqueue_t *)kzalloc(sizeof(virtqueue_t));
+    if (!vq) {
+        return NULL;
+    }
+
+    vq->cookies = (void **)kzalloc(size * sizeof(void *));
+    if (!vq->cookies) {
+        kfree(vq);
+        return NULL;
+    }
+
+    /* Descriptor table, then the available ring, then the used ring */
+    size_t desc_bytes = 16 * (size_t)size;
+    size_t avail_bytes = 6 + 2 * (size_t)size;
+    size_t used_offset = (desc_bytes + avail_bytes + 3) & ~(size_t)3;
+    size_t used_bytes = 6 + 8 * (size_t)size;
+    vq->ring_pages = (used_offset + used_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    uint64_t ring_phys;
+    vq->ring_mem = pmm_alloc_dma(vq->ring_pages, &ring_phys);
+    if (!vq->ring_mem) {
+        kfree(vq->cookies);
+        kfree(vq);
+        return NULL;
+    }
+
+    uint8_t *ring = (uint8_t *)vq->ring_mem;
+    vq->vdev = vdev;
+    vq->index = index;
+    vq->size = size;
+    vq->desc = (volatile virtq_desc_t *)ring;
+    vq->avail = (volatile virtq_avail_t *)(ring + desc_bytes);
+    vq->used = (volatile virtq_used_t *)(ring + used_offset);
+    vq->used_event = (volatile uint16_t *)(ring + desc_bytes + 4 + 2 * (size_t)size);
+    vq->avail_event = (volatile uint16_t *)(ring + used_offset + 4 + 8 * (size_t)size);
+
+    /* Chain all descriptors into the free list */
+    for (uint16_t i = 0; i < size; i++) {
+        vq->desc[i].next = (i + 1) % size;
+    }
+    vq->free_head = 0;
+    vq->num_free = size;
+
+    /* One indirect table per ring slot, indexed by head descriptor */
+    if (virtio_has_feature(vdev, VIRTIO_F_RING_INDIRECT_DESC)) {
+        size_t bytes = (size_t)size * VIRTQ_INDIRECT_MAX * sizeof(virtq_desc_t);
+        vq->indirect = (virtq_desc_t *)pmm_alloc_dma((bytes + PAGE_SIZE - 1) / PAGE_SIZE,
+                                                     &vq->indirect_phys);
+    }
+
+    uint64_t desc_phys = ring_phys;
+    uint64_t avail_phys = ring_phys + desc_bytes;
+    uint64_t used_phys = ring_phys + used_offset;
+
+    cfg->queue_size = size;
+    cfg->queue_msix_vector = VIRTIO_MSI_NO_VECTOR;
+    cfg->queue_desc_lo = (uint32_t)desc_phys;
+    cfg->queue_desc_hi = (uint32_t)(desc_phys >> 32);
+    cfg->queue_driver_lo = (uint32_t)avail_phys;
+    cfg->queue_driver_hi = (uint32_t)(avail_phys >> 32);
+    cfg->queue_device_lo = (uint32_t)used_phys;
+    cfg->queue_device_hi = (uint32_t)(used_phys >> 32);
+
+    uint16_t notify_off = cfg->queue_notify_off;
+    vq->notify = (volatile uint16_t *)(vdev->notify_base +
+                                       (size_t)notify_off * vdev->notify_multiplier);
+
+    cfg->queue_enable = 1;
+    return vq;
+}
+
+/**
+ * Free a virtqueue the device never started using
+ * @param vq Virtqueue from virtio_setup_queue, of a device not yet set DRIVER_OK (may be NULL)
+ */
+void virtio_free_queue(virtqueue_t *vq) {
+    if (!vq) {
+        return;
+    }
+
+    if (vq->indirect) {
+        size_t bytes = (size_t)vq->size * VIRTQ_INDIRECT_MAX * sizeof(virtq_desc_t);
+        pmm_free_dma(vq->indirect, (bytes + PAGE_SIZE - 1) / PAGE_SIZE);
+    }
+    pmm_free_dma(vq->ring_mem, vq->ring_pages);
+    kfree(vq->cookies);
+    kfree(vq);
+}
+
+/**
+ * Tell the device the driver is ready
+ */
+void virtio_driver_ok(virtio_device_t *vdev) {
+    vdev->common->device_status |= VIRTIO_STATUS_DRIVER_OK;
+}
+
+/**
+ * Mark the device as failed
+ */
+void virtio_fail(virtio_device_t *vdev) {
+    if (vdev && vdev->common) {
+        vdev->common->device_status |= VIRTIO_STATUS_FAILED;
+    }
+}
+
+/**
+ * Add a buffer chain to a virtqueue (does not notify the device)
+ * @param vq Virtqueue
+ * @param sg Scatter-gather list, device-readable elements first
+ * @param count Number of elements
+ * @param cookie Value returned by virtqueue_get_buf on completion
+ * @return 0 on success, negative if the ring is full
+ */
+int virtqueue_add(virtqueue_t *vq, const virtio_sg_t *sg, uint16_t count, void *cookie) {
+    if (!vq || !sg || count == 0 || !cookie) {
+        return -1;
+    }
+
+    /* Multi-element chains take a single ring slot when indirect is available */
+    bool indirect = vq->indirect && count > 1 && count <= VIRTQ_INDIRECT_MAX;
+    uint16_t needed = indirect ? 1 : count;
+    if (vq->num_free < needed) {
+        return -1;
+    }
+
+    uint16_t head = vq->free_head;
+
+    if (indirect) {
+        virtq_desc_t *table = vq->indirect + (size_t)head * VIRTQ_INDIRECT_MAX;
+        for (uint16_t i = 0; i < count; i++) {
+            table[i].addr = sg[i].addr;
+            table[i].len = sg[i].len;
+            table[i].flags = (sg[i].device_writes ? VIRTQ_DESC_F_WRITE : 0) |
+                             (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0);
+            table[i].next = i + 1;
+        }
+
+        vq->desc[head].addr = vq->indirect_phys +
+                              (uint64_t)head * VIRTQ_INDIRECT_MAX * sizeof(virtq_desc_t);
+        vq->desc[head].len = count * sizeof(virtq_desc_t);
+        vq->desc[head].flags = VIRTQ_DESC_F_INDIRECT;
+        vq->free_head = vq->desc[head].next;
+    } else {
+        uint16_t idx = head;
+        for (uint16_t i = 0; i < count; i++) {
+            vq->desc[idx].addr = sg[i].addr;
+            vq->desc[idx].len = sg[i].len;
+            vq->desc[idx].flags = (sg[i].device_writes ? VIRTQ_DESC_F_WRITE : 0) |
+                                  (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0);
+            idx = vq->desc[idx].next;
+        }
+        vq->free_head = idx;
+    }
+
+    vq->num_free -= needed;
+    vq->cookies[head] = cookie;
+
+    vq->avail->ring[vq->avail_idx & (vq->size - 1)] = head;
+    vq->avail_idx++;
+    return 0;
+}
+
+/**
+ * Publish added buffers and notify the device if it asked for it
+ * @param vq Virtqueue
+ * @return true if the device was notified
+ */
+bool virtqueue_kick(virtqueue_t *vq) {
+    uint16_t old_idx = vq->kicked_idx;
+    uint16_t new_idx = vq->avail_idx;
+
+    if (old_idx == new_idx) {
+        return false;
+    }
+
+    /* Descriptors must be visible before the index that publishes them */
+    wmb();
+    vq->avail->idx = new_idx;
+    vq->kicked_idx = new_idx;
+
+    /* The index store must be visible before we sample the device's threshold */
+    mb();
+
+    bool need;
+    if (virtio_has_feature(vq->vdev, VIRTIO_F_RING_EVENT_IDX)) {
+        need = vring_need_event(*vq->avail_event, new_idx, old_idx);
+    } else {
+        need = !(vq->used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    }
+
+    if (!need) {
+        vq->notifications_suppressed++;
+        return false;
+    }
+
+    *vq->notify = vq->index;
+    vq->notifications++;
+    return true;
+}
+
+/**
+ * Get a completed buffer chain
+ * @param vq Virtqueue
+ * @param len Output for the number of bytes the device wrote
+ * @return The cookie passed to virtqueue_add, or NULL if nothing completed
+ */
+void *virtqueue_get_buf(virtqueue_t *vq, uint32_t *len) {
+    if (vq->last_used_idx == vq->used->idx) {
+        return NULL;
+    }
+
+    /* Read the entry only after observing the index */
+    rmb();
+
+    volatile virtq_used_elem_t *elem = &vq->used->ring[vq->last_used_idx & (vq->size - 1)];
+    uint16_t head = (uint16_t)elem->id;
+    if (len) {
+        *len = elem->len;
+    }
+    vq->last_used_idx++;
+
+    void *cookie = vq->cookies[head];
+    vq->cookies[head] = NULL;
+
+    /* Return the chain to the free list */
+    uint16_t idx = head;
+    uint16_t freed = 1;
+    while (vq->desc[idx].flags & VIRTQ_DESC_F_NEXT) {
+        idx = vq->desc[idx].next;
+        freed++;
+    }
+    vq->desc[idx].next = vq->free_head;
+    vq->free_head = head;
+    vq->num_free += freed;
+
+    return cookie;
+}
+
+/**
+ * Ask the device not to interrupt on completions
+ */
+void virtqueue_disable_cb(virtqueue_t *vq) {
+    vq->avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+    /* With event idx the flag is ignored; park the threshold a full wrap away */
+    if (virtio_has_feature(vq->vdev, VIRTIO_F_RING_EVENT_IDX)) {
+        *vq->used_event = vq->last_used_idx - 1;
+    }
+}
+
+/**
+ * Ask the device to interrupt on the next completion
+ * @return true if completions are already pending
+ */
+bool virtqueue_enable_cb(virtqueue_t *vq) {
+    vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    *vq->used_event = vq->last_used_idx;
+    mb();
+    return vq->last_used_idx != vq->used->idx;
+}
+
+/**
+ * Ask the device to interrupt only after most in-flight buffers complete
+ * @return true if completions are already pending
+ */
+bool virtqueue_enable_cb_delayed(virtqueue_t *vq) {
+    if (!virtio_has_feature(vq->vdev, VIRTIO_F_RING_EVENT_IDX)) {
+        return virtqueue_enable_cb(vq);
+    }
+
+    uint16_t in_flight = vq->avail_idx - vq->last_used_idx;
+    uint16_t threshold = (uint16_t)(in_flight * 3 / 4);
+
+    vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    *vq->used_event = vq->last_used_idx + threshold;
+    mb();
+    return (uint16_t)(vq->used->idx - vq->last_used_idx) > threshold;
+}
\ No newline at end of file
@@ -0,0 +1,276 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Virtio 1.x PCI transport and split virtqueues
+ */
+
+#ifndef _DRIVERS_VIRTIO_VIRTIO_H
+#define _DRIVERS_VIRTIO_VIRTIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/pci/pci.h>
+
+/* Virtio PCI vendor ID */
+#define VIRTIO_PCI_VENDOR           0x1AF4
+
+/* Modern device IDs are 0x1040 + virtio device type */
+#define VIRTIO_PCI_MODERN_BASE      0x1040
+
+/* Device status bits */
+#define VIRTIO_STATUS_ACKNOWLEDGE   0x01
+#define VIRTIO_STATUS_DRIVER        0x02
+#define VIRTIO_STATUS_DRIVER_OK     0x04
+#define VIRTIO_STATUS_FEATURES_OK   0x08
+#define VIRTIO_STATUS_NEEDS_RESET   0x40
+#define VIRTIO_STATUS_FAILED        0x80
+
+/* Transport feature bits */
+#define VIRTIO_F_RING_INDIRECT_DESC 28
+#define VIRTIO_F_RING_EVENT_IDX     29
+#define VIRTIO_F_VERSION_1          32
+
+/* PCI capability configuration types */
+#define VIRTIO_PCI_CAP_COMMON_CFG   1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG   2
+#define VIRTIO_PCI_CAP_ISR_CFG      3
+#define VIRTIO_PCI_CAP_DEVICE_CFG   4
+#define VIRTIO_PCI_CAP_SHARED_MEMORY_CFG 8
+
+/* MSI-X vector meaning "no interrupt" */
+#define VIRTIO_MSI_NO_VECTOR        0xFFFF
+
+/* Descriptor flags */
+#define VIRTQ_DESC_F_NEXT           1
+#define VIRTQ_DESC_F_WRITE          2
+#define VIRTQ_DESC_F_INDIRECT       4
+
+/* Ring flags */
+#define VIRTQ_AVAIL_F_NO_INTERRUPT  1
+#define VIRTQ_USED_F_NO_NOTIFY      1
+
+/* Largest indirect table we hand to a device per request */
+#define VIRTQ_INDIRECT_MAX          32
+
+/* Common configuration structure (virtio 1.x, 4.1.4.3) */
+typedef struct virtio_pci_common_cfg {
+    uint32_t device_feature_select;
+    uint32_t device_feature;
+    uint32_t driver_feature_select;
+    uint32_t driver_feature;
+    uint16_t config_msix_vector;
+    uint16_t num_queues;
+    uint8_t  device_status;
+    uint8_t  config_generation;
+    uint16_t queue_select;
+    uint16_t queue_size;
+    uint16_t queue_msix_vector;
+    uint16_t queue_enable;
+    uint16_t queue_notify_off;
+    uint32_t queue_desc_lo;
+    uint32_t queue_desc_hi;
+    uint32_t queue_driver_lo;
+    uint32_t queue_driver_hi;
+    uint32_t queue_device_lo;
+    uint32_t queue_device_hi;
+} __attribute__((packed)) virtio_pci_common_cfg_t;
+
+/* Split virtqueue descriptor */
+typedef struct virtq_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+/* Driver-owned available ring; used_event follows ring[size] */
+typedef struct virtq_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct virtq_used_elem {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem_t;
+
+/* Device-owned used ring; avail_event follows ring[size] */
+typedef struct virtq_used {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];
+} __attribute__((packed)) virtq_used_t;
+
+/* Scatter-gather element handed to virtqueue_add */
+typedef struct virtio_sg {
+    uint64_t addr;              /* Physical address */
+    uint32_t len;               /* Length in bytes */
+    bool     device_writes;     /* Device writes into this buffer */
+} virtio_sg_t;
+
+struct virtio_device;
+
+/* Split virtqueue */
+typedef struct virtqueue {
+    struct virtio_device *vdev;         /* Owning device */
+    uint16_t index;                     /* Queue index */
+    uint16_t size;                      /* Number of descriptors */
+
+    volatile virtq_desc_t *desc;        /* Descriptor table */
+    volatile virtq_avail_t *avail;      /* Available ring */
+    volatile virtq_used_t *used;        /* Used ring */
+    volatile uint16_t *used_event;      /* Driver's interrupt threshold */
+    volatile uint16_t *avail_event;     /* Device's notification threshold */
+    volatile uint16_t *notify;          /* Notification register */
+
+    uint16_t free_head;                 /* First free descriptor */
+    uint16_t num_free;                  /* Number of free descriptors */
+    uint16_t avail_idx;                 /* Shadow of avail->idx */
+    uint16_t kicked_idx;                /* avail->idx at the last notification */
+    uint16_t last_used_idx;             /* Next used entry to consume */
+    void   **cookies;                   /* Per-head caller cookies */
+
+    virtq_desc_t *indirect;             /* Per-head indirect tables */
+    uint64_t indirect_phys;             /* Physical address of the tables */
+
+    void    *ring_mem;                  /* Ring allocation */
+    size_t   ring_pages;                /* Size of the ring allocation */
+
+    /* Statistics */
+    uint64_t notifications;             /* Doorbell writes */
+    uint64_t notifications_suppressed;  /* Doorbells skipped thanks to event idx */
+} virtqueue_t;
+
+/* Virtio PCI device */
+typedef struct virtio_device {
+    pci_device_t *pci;                          /* Underlying PCI function */
+    volatile virtio_pci_common_cfg_t *common;   /* Common configuration */
+    volatile uint8_t *notify_base;              /* Notification area */
+    uint32_t notify_multiplier;                 /* Queue notify offset multiplier */
+    volatile uint8_t *isr;                      /* ISR status */
+    volatile uint8_t *device_cfg;               /* Device-specific configuration */
+    uint64_t features;                          /* Negotiated features */
+} virtio_device_t;
+
+/**
+ * Initialize the modern PCI transport of a virtio device and reset it
+ * @param vdev Device structure to fill
+ * @param pci Underlying PCI function
+ * @return 0 on success, negative on error
+ */
+int virtio_pci_init(virtio_device_t *vdev, pci_device_t *pci);
+
+/**
+ * Negotiate features with the device
+ * @param vdev Virtio device
+ * @param wanted Features the driver supports
+ * @return 0 on success, negative if the device rejected the feature set
+ */
+int virtio_negotiate_features(virtio_device_t *vdev, uint64_t wanted);
+
+/**
+ * Check whether a feature was negotiated
+ */
+static inline bool virtio_has_feature(virtio_device_t *vdev, unsigned int bit) {
+    return (vdev->features >> bit) & 1;
+}
+
+/**
+ * Get the number of virtqueues the device offers
+ */
+uint16_t virtio_num_queues(virtio_device_t *vdev);
+
+/**
+ * Find a shared memory region exposed by the device
+ * @param vdev Virtio device
+ * @param id Region ID (device specific)
+ * @param phys Output for the physical base address
+ * @param len Output for the length in bytes
+ * @return 0 on success, negative if the device has no such region
+ */
+int virtio_get_shm_region(virtio_device_t *vdev, uint8_t id, uint64_t *phys, uint64_t *len);
+
+/**
+ * Set up a virtqueue
+ * @param vdev Virtio device
+ * @param index Queue index
+ * @param max_size Upper bound on the ring size (0 for the device maximum)
+ * @return The virtqueue, or NULL on failure
+ */
+virtqueue_t *virtio_setup_queue(virtio_device_t *vdev, uint16_t index, uint16_t max_size);
+
+/**
+ * Free a virtqueue the device never started using
+ * @param vq Virtqueue from virtio_setup_queue, of a device not yet set DRIVER_OK (may be NULL)
+ */
+void virtio_free_queue(virtqueue_t *vq);
+
+/**
+ * Tell the device the driver is ready
+ */
+void virtio_driver_ok(virtio_device_t *vdev);
+
+/**
+ * Mark the device as failed
+ */
+void virtio_fail(virtio_device_t *vdev);
+
+/**
+ * Add a buffer chain to a virtqueue (does not notify the device)
+ * @param vq Virtqueue
+ * @param sg Scatter-gather list, device-readable elements first
+ * @param count Number of elements
+ * @param cookie Value returned by virtqueue_get_buf on completion
+ * @return 0 on success, negative if the ring is full
+ */
+int virtqueue_add(virtqueue_t *vq, const virtio_sg_t *sg, uint16_t count, void *cookie);
+
+/**
+ * Publish added buffers and notify the device if it asked for it
+ * @param vq Virtqueue
+ * @return true if the device was notified
+ */
+bool virtqueue_kick(virtqueue_t *vq);
+
+/**
+ * Get a completed buffer chain
+ * @param vq Virtqueue
+ * @param len Output for the number of bytes the device wrote
+ * @return The cookie passed to virtqueue_add, or NULL if nothing completed
+ */
+void *virtqueue_get_buf(virtqueue_t *vq, uint32_t *len);
+
+/**
+ * Ask the device not to interrupt on completions
+ */
+void virtqueue_disable_cb(virtqueue_t *vq);
+
+/**
+ * Ask the device to interrupt on the next completion
+ * @return true if completions are already pending
+ */
+bool virtqueue_enable_cb(virtqueue_t *vq);
+
+/**
+ * Ask the device to interrupt only after most in-flight buffers complete
+ * @return true if completions are already pending
+ */
+bool virtqueue_enable_cb_delayed(virtqueue_t *vq);
+
+#endif /* _DRIVERS_VIRTIO_VIRTIO_H */
\ No newline at end of file
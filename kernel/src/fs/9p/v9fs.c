@@ -0,0 +1,793 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 9P2000.L over virtio host shared directory client
+ *
+ * The fallback for hosts that export a directory with QEMU's built-in 9P
+ * server (-virtfs) instead of virtiofsd. Every VFS node holds a walked fid,
+ * and a clone of it is opened for reads, writes and directory listings,
+ * since an opened fid can no longer be walked from. Requests and replies
+ * are built in one buffer each, one request at a time, and completions
+ * are polled.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/config.h>
+#include <drivers/driversys.h>
+#include <drivers/pci/pci.h>
+#include <drivers/virtio/virtio.h>
+#include <fs/vfs.h>
+#include <fs/icache.h>
+#include <fs/9p/v9fs.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+
+/* Upper bound on descriptors per virtqueue */
+#define V9FS_QUEUE_SIZE         64
+
+/* A request not answered within this time marks the device dead */
+#define V9FS_TIMEOUT_NS         (5ULL * 1000000000ULL)
+
+/* Fid of the share root */
+#define V9FS_ROOT_FID           0
+
+/* Message being built or parsed */
+typedef struct p9_buf {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t pos;
+    bool error;                 /* Ran past the end */
+} p9_buf_t;
+
+/* Forward declarations */
+static int v9fs_open(struct vfs_node *node, int flags);
+static int v9fs_close(struct vfs_node *node);
+static size_t v9fs_read(struct vfs_node *node, uint64_t offset, size_t size, void *buffer);
+static size_t v9fs_write(struct vfs_node *node, uint64_t offset, size_t size, const void *buffer);
+static int v9fs_readdir(struct vfs_node *node, uint32_t index, struct vfs_dirent *dirent);
+static struct vfs_node* v9fs_finddir(struct vfs_node *node, const char *name);
+static int v9fs_stat(struct vfs_node *node, struct vfs_stat *stat);
+static void v9fs_evict(struct vfs_node *node);
+
+/* Filesystem operations structure */
+static vfs_node_ops_t v9fs_ops = {
+    .open = v9fs_open,
+    .close = v9fs_close,
+    .read = v9fs_read,
+    .write = v9fs_write,
+    .readdir = v9fs_readdir,
+    .finddir = v9fs_finddir,
+    .stat = v9fs_stat,
+    .evict = v9fs_evict
+};
+
+/* Driver hooks */
+static int v9fs_probe_driver(device_driver_t *driver);
+static int v9fs_remove_driver(device_driver_t *driver);
+
+/* Define the 9P driver */
+static driver_ops_t v9fs_driver_ops = {
+    .probe = v9fs_probe_driver,
+    .remove = v9fs_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t v9fs_driver = {
+    .name = "9p",
+    .device_class = DEVICE_CLASS_STORAGE,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &v9fs_driver_ops,
+    .private_data = NULL
+};
+
+/* Share found at boot; only the first one is used */
+static v9fs_t *v9fs_share = NULL;
+
+/**
+ * Append a little-endian integer to a message
+ */
+static void p9_put(p9_buf_t *b, uint64_t value, int bytes) {
+    if (b->pos + bytes > b->size) {
+        b->error = true;
+        return;
+    }
+    for (int i = 0; i < bytes; i++) {
+        b->data[b->pos++] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/**
+ * Append raw bytes to a message
+ */
+static void p9_put_bytes(p9_buf_t *b, const void *data, uint32_t len) {
+    if (b->pos + len > b->size) {
+        b->error = true;
+        return;
+    }
+    memcpy(b->data + b->pos, data, len);
+    b->pos += len;
+}
+
+/**
+ * Append a string (length-prefixed, no NUL) to a message
+ */
+static void p9_put_str(p9_buf_t *b, const char *str) {
+    uint32_t len = (uint32_t)strlen(str);
+    p9_put(b, len, 2);
+    p9_put_bytes(b, str, len);
+}
+
+/**
+ * Take a little-endian integer from a message
+ */
+static uint64_t p9_get(p9_buf_t *b, int bytes) {
+    uint64_t value = 0;
+    if (b->pos + bytes > b->size) {
+        b->error = true;
+        return 0;
+    }
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint64_t)b->data[b->pos++] << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * Take a qid from a message
+ */
+static void p9_get_qid(p9_buf_t *b, p9_qid_t *qid) {
+    qid->type = (uint8_t)p9_get(b, 1);
+    qid->version = (uint32_t)p9_get(b, 4);
+    qid->path = p9_get(b, 8);
+}
+
+/**
+ * Start building a request
+ */
+static p9_buf_t v9fs_begin(v9fs_t *fs, uint8_t type) {
+    p9_buf_t b = { fs->tx, fs->msize, 0, false };
+    p9_put(&b, 0, 4);
+    p9_put(&b, type, 1);
+    p9_put(&b, ++fs->tag_seq, 2);
+    return b;
+}
+
+/**
+ * Send a request and wait for its reply
+ * @param fs Share
+ * @param req Request built with v9fs_begin
+ * @param reply Output positioned after the reply header
+ * @return 0 on success, negative errno from Rlerror or -1 on failure
+ */
+static int v9fs_rpc(v9fs_t *fs, p9_buf_t *req, p9_buf_t *reply) {
+    if (fs->dead || req->error) {
+        return -1;
+    }
+
+    uint8_t type = req->data[4];
+    uint32_t size = req->pos;
+    req->pos = 0;
+    p9_put(req, size, 4);
+
+    virtio_sg_t sg[2] = {
+        { fs->tx_phys, size, false },
+        { fs->rx_phys, fs->msize, true }
+    };
+
+    uint64_t flags = cpu_irq_save();
+    if (virtqueue_add(fs->vq, sg, 2, fs) < 0) {
+        cpu_irq_restore(flags);
+        return -1;
+    }
+    virtqueue_kick(fs->vq);
+    fs->requests++;
+
+    uint32_t len = 0;
+    uint64_t deadline = time_now_ns() + V9FS_TIMEOUT_NS;
+    while (!virtqueue_get_buf(fs->vq, &len)) {
+        if (time_now_ns() >= deadline) {
+            /* The buffers stay with the device, so nothing may reuse them */
+            fs->dead = true;
+            cpu_irq_restore(flags);
+            kerr("9P: Request %u timed out, giving up on the device\n", type);
+            return -1;
+        }
+        cpu_relax();
+    }
+    cpu_irq_restore(flags);
+
+    *reply = (p9_buf_t){ fs->rx, len, 0, false };
+    uint32_t rsize = (uint32_t)p9_get(reply, 4);
+    uint8_t rtype = (uint8_t)p9_get(reply, 1);
+    uint16_t rtag = (uint16_t)p9_get(reply, 2);
+    if (reply->error || rsize > len || rtag != fs->tag_seq) {
+        return -1;
+    }
+    reply->size = rsize;
+
+    if (rtype == P9_RLERROR) {
+        return -(int)p9_get(reply, 4);
+    }
+    return rtype == type + 1 ? 0 : -1;
+}
+
+/**
+ * Release a fid
+ */
+static void v9fs_clunk(v9fs_t *fs, uint32_t fid) {
+    p9_buf_t req = v9fs_begin(fs, P9_TCLUNK), reply;
+    p9_put(&req, fid, 4);
+    v9fs_rpc(fs, &req, &reply);
+}
+
+/**
+ * Walk from a fid to a new fid
+ * @param name Name to walk to, or NULL to clone the fid
+ * @param qid Set to the identity of the file walked to, if not NULL
+ */
+static int v9fs_walk(v9fs_t *fs, uint32_t fid, uint32_t newfid, const char *name, p9_qid_t *qid) {
+    p9_buf_t req = v9fs_begin(fs, P9_TWALK), reply;
+    p9_put(&req, fid, 4);
+    p9_put(&req, newfid, 4);
+    p9_put(&req, name ? 1 : 0, 2);
+    if (name) {
+        p9_put_str(&req, name);
+    }
+
+    int result = v9fs_rpc(fs, &req, &reply);
+    if (result < 0) {
+        return result;
+    }
+
+    /* A partial walk creates no fid */
+    uint16_t nwqid = (uint16_t)p9_get(&reply, 2);
+    if (nwqid != (name ? 1 : 0)) {
+        return -1;
+    }
+    if (name && qid) {
+        p9_get_qid(&reply, qid);
+    }
+    return reply.error ? -1 : 0;
+}
+
+/**
+ * Fetch the attributes of a fid
+ */
+static int v9fs_getattr(v9fs_t *fs, uint32_t fid, struct vfs_stat *stat) {
+    p9_buf_t req = v9fs_begin(fs, P9_TGETATTR), reply;
+    p9_put(&req, fid, 4);
+    p9_put(&req, P9_GETATTR_BASIC, 8);
+
+    int result = v9fs_rpc(fs, &req, &reply);
+    if (result < 0) {
+        return result;
+    }
+
+    p9_qid_t qid;
+    p9_get(&reply, 8);                                  /* valid */
+    p9_get_qid(&reply, &qid);
+    stat->st_dev = 0;
+    stat->st_ino = (uint32_t)qid.path;
+    stat->st_mode = (uint16_t)p9_get(&reply, 4);
+    stat->st_uid = (uint32_t)p9_get(&reply, 4);
+    stat->st_gid = (uint32_t)p9_get(&reply, 4);
+    stat->st_nlink = (uint16_t)p9_get(&reply, 8);
+    stat->st_rdev = (uint32_t)p9_get(&reply, 8);
+    stat->st_size = p9_get(&reply, 8);
+    stat->st_blksize = (uint32_t)p9_get(&reply, 8);
+    stat->st_blocks = p9_get(&reply, 8);
+    stat->st_atime = (uint32_t)p9_get(&reply, 8);
+    p9_get(&reply, 8);
+    stat->st_mtime = (uint32_t)p9_get(&reply, 8);
+    p9_get(&reply, 8);
+    stat->st_ctime = (uint32_t)p9_get(&reply, 8);
+
+    return reply.error ? -1 : 0;
+}
+
+/**
+ * Convert a file mode to a VFS node type
+ */
+static uint32_t v9fs_vfs_type(uint32_t mode) {
+    if (S_ISDIR(mode)) {
+        return VFS_DIRECTORY;
+    } else if (S_ISLNK(mode)) {
+        return VFS_SYMLINK;
+    } else if (S_ISCHR(mode)) {
+        return VFS_CHARDEVICE;
+    } else if (S_ISBLK(mode)) {
+        return VFS_BLOCKDEVICE;
+    } else if (S_ISFIFO(mode)) {
+        return VFS_PIPE;
+    } else if (S_ISSOCK(mode)) {
+        return VFS_SOCKET;
+    }
+    return VFS_FILE;
+}
+
+/**
+ * Create a VFS node for a walked fid
+ * @return The node, or NULL on failure (the fid is clunked)
+ */
+static struct vfs_node *v9fs_create_vfs_node(v9fs_t *fs, uint32_t fid, const char *name) {
+    struct vfs_stat stat;
+    struct vfs_node *node = (struct vfs_node *)kzalloc(sizeof(struct vfs_node));
+    v9fs_inode_t *info = (v9fs_inode_t *)kzalloc(sizeof(v9fs_inode_t));
+
+    if (!node || !info || v9fs_getattr(fs, fid, &stat) < 0) {
+        kfree(node);
+        kfree(info);
+        v9fs_clunk(fs, fid);
+        return NULL;
+    }
+
+    info->fs = fs;
+    info->fid = fid;
+    info->open_fid = P9_NOFID;
+    info->mode = stat.st_mode;
+
+    strncpy(node->name, name, VFS_NAME_MAX);
+    node->type = v9fs_vfs_type(stat.st_mode);
+    node->permissions = stat.st_mode & 07777;
+    node->uid = stat.st_uid;
+    node->gid = stat.st_gid;
+    node->size = stat.st_size;
+    node->inode = stat.st_ino;
+    node->links = stat.st_nlink;
+    node->atime = stat.st_atime;
+    node->mtime = stat.st_mtime;
+    node->ctime = stat.st_ctime;
+    node->private_data = info;
+    node->ops = &v9fs_ops;
+    return node;
+}
+
+/**
+ * VFS open function
+ */
+static int v9fs_open(struct vfs_node *node, int flags) {
+    v9fs_inode_t *info = (v9fs_inode_t *)node->private_data;
+    v9fs_t *fs = info->fs;
+    uint32_t access = flags & (VFS_O_WRONLY | VFS_O_RDWR);
+
+    if (info->open_fid != P9_NOFID) {
+        /* A read-only fid is reopened when writing is asked for */
+        if (access == VFS_O_RDONLY || info->open_flags == VFS_O_RDWR || info->open_flags == access) {
+            return 0;
+        }
+        v9fs_close(node);
+        access = VFS_O_RDWR;
+    }
+
+    if (S_ISDIR(info->mode)) {
+        access = VFS_O_RDONLY;
+    }
+
+    uint32_t fid = fs->next_fid++;
+    int result = v9fs_walk(fs, info->fid, fid, NULL, NULL);
+    if (result < 0) {
+        return result;
+    }
+
+    p9_buf_t req = v9fs_begin(fs, P9_TLOPEN), reply;
+    p9_put(&req, fid, 4);
+    p9_put(&req, access, 4);
+    result = v9fs_rpc(fs, &req, &reply);
+    if (result < 0) {
+        v9fs_clunk(fs, fid);
+        return result;
+    }
+
+    p9_qid_t qid;
+    p9_get_qid(&reply, &qid);
+    info->iounit = (uint32_t)p9_get(&reply, 4);
+    if (info->iounit == 0 || info->iounit > fs->msize - P9_IOHDRSZ) {
+        info->iounit = fs->msize - P9_IOHDRSZ;
+    }
+
+    info->open_fid = fid;
+    info->open_flags = access;
+    info->dir_index = 0;
+    info->dir_offset = 0;
+    return 0;
+}
+
+/**
+ * VFS close function
+ */
+static int v9fs_close(struct vfs_node *node) {
+    v9fs_inode_t *info = (v9fs_inode_t *)node->private_data;
+    if (info->open_fid != P9_NOFID) {
+        v9fs_clunk(info->fs, info->open_fid);
+        info->open_fid = P9_NOFID;
+    }
+    return 0;
+}
+
+/**
+ * VFS read function
+ */
+static size_t v9fs_read(struct vfs_node *node, uint64_t offset, size_t size, void *buffer) {
+    if (!node || !buffer || !node->private_data) {
+        return 0;
+    }
+
+    v9fs_inode_t *info = (v9fs_inode_t *)node->private_data;
+    v9fs_t *fs = info->fs;
+    uint8_t *dst = (uint8_t *)buffer;
+    size_t done = 0;
+
+    if (info->open_fid == P9_NOFID && v9fs_open(node, VFS_O_RDONLY) < 0) {
+        return 0;
+    }
+
+    while (done < size) {
+        uint32_t chunk = size - done > info->iounit ? info->iounit : (uint32_t)(size - done);
+
+        p9_buf_t req = v9fs_begin(fs, P9_TREAD), reply;
+        p9_put(&req, info->open_fid, 4);
+        p9_put(&req, offset + done, 8);
+        p9_put(&req, chunk, 4);
+        if (v9fs_rpc(fs, &req, &reply) < 0) {
+            break;
+        }
+
+        uint32_t got = (uint32_t)p9_get(&reply, 4);
+        if (reply.error || got > chunk || reply.pos + got > reply.size) {
+            break;
+        }
+        memcpy(dst + done, reply.data + reply.pos, got);
+        fs->read_bytes += got;
+        done += got;
+        if (got < chunk) {
+            break;
+        }
+    }
+
+    return done;
+}
+
+/**
+ * VFS write function
+ */
+static size_t v9fs_write(struct vfs_node *node, uint64_t offset, size_t size, const void *buffer) {
+    if (!node || !buffer || !node->private_data) {
+        return 0;
+    }
+
+    v9fs_inode_t *info = (v9fs_inode_t *)node->private_data;
+    v9fs_t *fs = info->fs;
+    const uint8_t *src = (const uint8_t *)buffer;
+    size_t done = 0;
+
+    if (v9fs_open(node, VFS_O_RDWR) < 0) {
+        return 0;
+    }
+
+    while (done < size) {
+        uint32_t chunk = size - done > info->iounit ? info->iounit : (uint32_t)(size - done);
+
+        p9_buf_t req = v9fs_begin(fs, P9_TWRITE), reply;
+        p9_put(&req, info->open_fid, 4);
+        p9_put(&req, offset + done, 8);
+        p9_put(&req, chunk, 4);
+        p9_put_bytes(&req, src + done, chunk);
+        if (v9fs_rpc(fs, &req, &reply) < 0) {
+            break;
+        }
+
+        uint32_t written = (uint32_t)p9_get(&reply, 4);
+        if (reply.error || written == 0) {
+            break;
+        }
+        done += written;
+        if (written < chunk) {
+            break;
+        }
+    }
+
+    if (offset + done > node->size) {
+        node->size = offset + done;
+    }
+    return done;
+}
+
+/**
+ * VFS readdir function
+ */
+static int v9fs_readdir(struct vfs_node *node, uint32_t index, struct vfs_dirent *dirent) {
+    if (!node || !dirent || !node->private_data || (node->type & ~VFS_MOUNTPOINT) != VFS_DIRECTORY) {
+        return -1;
+    }
+
+    v9fs_inode_t *info = (v9fs_inode_t *)node->private_data;
+    v9fs_t *fs = info->fs;
+
+    if (info->open_fid == P9_NOFID && v9fs_open(node, VFS_O_RDONLY) < 0) {
+        return -1;
+    }
+
+    /* Continue from the last position when scanning forward, else restart */
+    if (index < info->dir_index) {
+        info->dir_index = 0;
+        info->dir_offset = 0;
+    }
+
+    for (;;) {
+        p9_buf_t req = v9fs_begin(fs, P9_TREADDIR), reply;
+        p9_put(&req, info->open_fid, 4);
+        p9_put(&req, info->dir_offset, 8);
+        p9_put(&req, info->iounit, 4);
+        if (v9fs_rpc(fs, &req, &reply) < 0) {
+            return -1;
+        }
+
+        uint32_t count = (uint32_t)p9_get(&reply, 4);
+        if (reply.error || count == 0 || reply.pos + count > reply.size) {
+            return -1;
+        }
+        reply.size = reply.pos + count;
+
+        while (reply.pos < reply.size) {
+            p9_qid_t qid;
+            p9_get_qid(&reply, &qid);
+            uint64_t next = p9_get(&reply, 8);
+            uint8_t type = (uint8_t)p9_get(&reply, 1);
+            uint16_t name_len = (uint16_t)p9_get(&reply, 2);
+            if (reply.error || reply.pos + name_len > reply.size) {
+                return -1;
+            }
+
+            if (info->dir_index == index) {
+                uint32_t len = name_len > VFS_NAME_MAX ? VFS_NAME_MAX : name_len;
+                memcpy(dirent->name, reply.data + reply.pos, len);
+                dirent->name[len] = '\0';
+                dirent->inode = (uint32_t)qid.path;
+                dirent->type = (uint8_t)v9fs_vfs_type((uint32_t)type << 12);
+                return 0;
+            }
+
+            reply.pos += name_len;
+            info->dir_index++;
+            info->dir_offset = next;
+        }
+    }
+}
+
+/**
+ * VFS finddir function
+ */
+static struct vfs_node* v9fs_finddir(struct vfs_node *node, const char *name) {
+    if (!node || !name || !node->private_data || (node->type & ~VFS_MOUNTPOINT) != VFS_DIRECTORY) {
+        return NULL;
+    }
+
+    v9fs_inode_t *info = (v9fs_inode_t *)node->private_data;
+    v9fs_t *fs = info->fs;
+    uint32_t fid = fs->next_fid++;
+    p9_qid_t qid;
+
+    if (strlen(name) > VFS_NAME_MAX || v9fs_walk(fs, info->fid, fid, name, &qid) < 0) {
+        return NULL;
+    }
+
+    /* Share the node if the file is already cached; the new fid is not needed */
+    struct vfs_node *found_node = vnode_lookup(fs, qid.path);
+    if (found_node) {
+        v9fs_clunk(fs, fid);
+        return found_node;
+    }
+
+    found_node = v9fs_create_vfs_node(fs, fid, name);
+    if (found_node) {
+        vnode_insert(found_node, fs, qid.path);
+    }
+    return found_node;
+}
+
+/**
+ * VFS evict function, called when the inode cache frees a node
+ */
+static void v9fs_evict(struct vfs_node *node) {
+    v9fs_inode_t *info = (v9fs_inode_t *)node->private_data;
+
+    if (info->open_fid != P9_NOFID) {
+        v9fs_clunk(info->fs, info->open_fid);
+    }
+    v9fs_clunk(info->fs, info->fid);
+    kfree(info);
+    node->private_data = NULL;
+}
+
+/**
+ * VFS stat function
+ */
+static int v9fs_stat(struct vfs_node *node, struct vfs_stat *stat) {
+    if (!node || !stat || !node->private_data) {
+        return -1;
+    }
+
+    v9fs_inode_t *info = (v9fs_inode_t *)node->private_data;
+    return v9fs_getattr(info->fs, info->fid, stat);
+}
+
+/**
+ * Agree on the protocol version and message size
+ */
+static int v9fs_version(v9fs_t *fs) {
+    p9_buf_t req = v9fs_begin(fs, P9_TVERSION), reply;
+    p9_put(&req, fs->msize, 4);
+    p9_put_str(&req, "9P2000.L");
+
+    if (v9fs_rpc(fs, &req, &reply) < 0) {
+        return -1;
+    }
+
+    uint32_t msize = (uint32_t)p9_get(&reply, 4);
+    uint16_t len = (uint16_t)p9_get(&reply, 2);
+    if (reply.error || len != 8 || reply.pos + len > reply.size ||
+        memcmp(reply.data + reply.pos, "9P2000.L", 8) != 0) {
+        kerr("9P: Server does not speak 9P2000.L\n");
+        return -1;
+    }
+
+    if (msize < fs->msize) {
+        fs->msize = msize;
+    }
+    return fs->msize > P9_IOHDRSZ ? 0 : -1;
+}
+
+/**
+ * Bring up one virtio 9P PCI function
+ */
+static int v9fs_attach(pci_device_t *pci) {
+    v9fs_t *fs = (v9fs_t *)kzalloc(sizeof(v9fs_t));
+    if (!fs) {
+        return -1;
+    }
+
+    if (virtio_pci_init(&fs->vdev, pci) < 0) {
+        kfree(fs);
+        return -1;
+    }
+
+    uint64_t wanted = (1ULL << VIRTIO_F_RING_INDIRECT_DESC) |
+                      (1ULL << VIRTIO_F_RING_EVENT_IDX) |
+                      (1ULL << V9FS_F_MOUNT_TAG);
+    if (virtio_negotiate_features(&fs->vdev, wanted) < 0) {
+        virtio_fail(&fs->vdev);
+        kfree(fs);
+        return -1;
+    }
+
+    /* Configuration: tag_len[2] followed by the tag */
+    if (fs->vdev.device_cfg && virtio_has_feature(&fs->vdev, V9FS_F_MOUNT_TAG)) {
+        volatile uint8_t *cfg = fs->vdev.device_cfg;
+        uint16_t len = cfg[0] | (cfg[1] << 8);
+        for (uint16_t i = 0; i < len && i < sizeof(fs->tag) - 1; i++) {
+            fs->tag[i] = cfg[2 + i];
+        }
+    }
+
+    fs->msize = V9FS_MSG_PAGES * PAGE_SIZE;
+    fs->next_fid = V9FS_ROOT_FID + 1;
+    fs->vq = virtio_setup_queue(&fs->vdev, 0, V9FS_QUEUE_SIZE);
+    fs->tx = (uint8_t *)pmm_alloc_dma(V9FS_MSG_PAGES, &fs->tx_phys);
+    fs->rx = (uint8_t *)pmm_alloc_dma(V9FS_MSG_PAGES, &fs->rx_phys);
+    if (!fs->vq || !fs->tx || !fs->rx) {
+        virtio_fail(&fs->vdev);
+        kfree(fs);
+        return -1;
+    }
+    virtqueue_disable_cb(fs->vq);
+
+    virtio_driver_ok(&fs->vdev);
+
+    if (v9fs_version(fs) < 0) {
+        virtio_fail(&fs->vdev);
+        kfree(fs);
+        return -1;
+    }
+
+    kprintf("9P: share \"%s\", msize %u\n", fs->tag, fs->msize);
+    v9fs_share = fs;
+    return 0;
+}
+
+/**
+ * Mount the first 9P share found at boot
+ * @param root_node Pointer to store the root node
+ * @return 0 on success, negative on error
+ */
+int v9fs_mount(struct vfs_node **root_node) {
+    v9fs_t *fs = v9fs_share;
+    if (!fs || !root_node) {
+        return -1;
+    }
+
+    p9_buf_t req = v9fs_begin(fs, P9_TATTACH), reply;
+    p9_put(&req, V9FS_ROOT_FID, 4);
+    p9_put(&req, P9_NOFID, 4);
+    p9_put_str(&req, "root");
+    p9_put_str(&req, "");
+    p9_put(&req, 0, 4);
+    if (v9fs_rpc(fs, &req, &reply) < 0) {
+        kerr("9P: Failed to attach to share \"%s\"\n", fs->tag);
+        return -1;
+    }
+
+    p9_qid_t qid;
+    p9_get_qid(&reply, &qid);
+
+    *root_node = v9fs_create_vfs_node(fs, V9FS_ROOT_FID, "/");
+    if (!*root_node) {
+        return -1;
+    }
+
+    fs->root_node = *root_node;
+    vnode_insert(*root_node, fs, qid.path);
+    kprintf("9P: Mounted share \"%s\"\n", fs->tag);
+    return 0;
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int v9fs_probe_driver(device_driver_t *driver) {
+    static const uint16_t ids[] = { V9FS_PCI_DEVICE, V9FS_PCI_TRANSITIONAL };
+
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]) && !v9fs_share; i++) {
+        pci_device_t *pci;
+        for (int index = 0; !v9fs_share && (pci = pci_find_device(VIRTIO_PCI_VENDOR, ids[i], index)) != NULL; index++) {
+            if (v9fs_attach(pci) < 0) {
+                kerr("9P: Failed to attach %02x:%02x.%x\n", pci->bus, pci->slot, pci->func);
+            }
+        }
+    }
+
+    driver->private_data = v9fs_share;
+    return 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int v9fs_remove_driver(device_driver_t *driver) {
+    if (v9fs_share) {
+        v9fs_share->vdev.common->device_status = 0;
+        v9fs_share = NULL;
+    }
+    return 0;
+}
+
+/**
+ * Register the 9P driver
+ */
+void v9fs_register_driver(void) {
+    device_driver_register(&v9fs_driver);
+}
\ No newline at end of file
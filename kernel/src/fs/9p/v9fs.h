@@ -0,0 +1,119 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 9P2000.L over virtio host shared directory client
+ */
+
+#ifndef _FS_9P_V9FS_H
+#define _FS_9P_V9FS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/virtio/virtio.h>
+#include <fs/vfs.h>
+
+/* PCI device IDs */
+#define V9FS_PCI_DEVICE         (VIRTIO_PCI_MODERN_BASE + 9)
+#define V9FS_PCI_TRANSITIONAL   0x1009
+
+/* Device feature bits */
+#define V9FS_F_MOUNT_TAG        0
+
+/* Message buffer size (msize), in pages */
+#define V9FS_MSG_PAGES          32
+
+/* Message types */
+#define P9_RLERROR              7
+#define P9_TLOPEN               12
+#define P9_TGETATTR             24
+#define P9_TREADDIR             40
+#define P9_TVERSION             100
+#define P9_TATTACH              104
+#define P9_TWALK                110
+#define P9_TREAD                116
+#define P9_TWRITE               118
+#define P9_TCLUNK               120
+
+/* Header size: size[4] type[1] tag[2] */
+#define P9_HDRSZ                7
+
+/* Room taken by the headers of Rread and Twrite */
+#define P9_IOHDRSZ              24
+
+#define P9_NOFID                0xFFFFFFFFU
+#define P9_NONUNAME             0xFFFFFFFFU
+
+/* Tgetattr request mask: everything in the basic stat */
+#define P9_GETATTR_BASIC        0x000007FFULL
+
+/* Server file identity */
+typedef struct p9_qid {
+    uint8_t  type;
+    uint32_t version;
+    uint64_t path;
+} p9_qid_t;
+
+/* Mounted share */
+typedef struct v9fs {
+    virtio_device_t vdev;
+    virtqueue_t *vq;
+    char tag[64];
+    bool dead;                  /* The device stopped answering */
+
+    uint8_t *tx;                /* Request being built */
+    uint64_t tx_phys;
+    uint8_t *rx;                /* Reply */
+    uint64_t rx_phys;
+    uint32_t msize;             /* Negotiated message size */
+    uint16_t tag_seq;
+    uint32_t next_fid;
+
+    /* Statistics */
+    uint64_t requests;
+    uint64_t read_bytes;
+
+    struct vfs_node *root_node;
+} v9fs_t;
+
+/* Per-node data */
+typedef struct v9fs_inode {
+    v9fs_t *fs;
+    uint32_t fid;               /* Walked, never opened; used for walks and getattr */
+    uint32_t open_fid;          /* Clone opened for I/O, P9_NOFID if none */
+    uint32_t open_flags;
+    uint32_t iounit;            /* Largest payload per read or write */
+    uint32_t mode;
+
+    /* Directory position of the last readdir */
+    uint32_t dir_index;
+    uint64_t dir_offset;
+} v9fs_inode_t;
+
+/**
+ * Mount the first 9P share found at boot
+ * @param root_node Pointer to store the root node
+ * @return 0 on success, negative on error
+ */
+int v9fs_mount(struct vfs_node **root_node);
+
+/**
+ * Register the 9P driver
+ */
+void v9fs_register_driver(void);
+
+#endif /* _FS_9P_V9FS_H */
\ No newline at end of file
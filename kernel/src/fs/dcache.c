@@ -0,0 +1,289 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Directory entry cache
+ *
+ * Remembers what finddir returned for a (directory, name) pair, including
+ * names that do not exist, so repeated path lookups never reach the
+ * filesystem. Entries are hashed on the parent node and the name hash and
+ * kept on an LRU list; the least recently used entry is evicted once
+ * DCACHE_MAX_ENTRIES are cached. The VFS drops entries whenever it
+ * changes a directory. Each entry holds a reference to its parent and its
+ * node, so cached names keep their inodes in the inode cache.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/config.h>
+#include <fs/vfs.h>
+#include <fs/dcache.h>
+#include <fs/icache.h>
+#include <mm/kmalloc.h>
+#include <mm/shrinker.h>
+
+static dentry_t *dcache_hash_table[DCACHE_HASH_SIZE];
+static dentry_t *dcache_lru_head = NULL;   /* Most recently used */
+static dentry_t *dcache_lru_tail = NULL;   /* Least recently used */
+static dcache_stats_t dcache_stats;
+
+static inline uint32_t dcache_bucket(struct vfs_node *parent, uint32_t hash) {
+    uint64_t key = (uint64_t)(uintptr_t)parent ^ ((uint64_t)hash << 32 | hash);
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - DCACHE_HASH_BITS));
+}
+
+static void dcache_hash_remove(dentry_t *dentry) {
+    dentry_t **link = &dcache_hash_table[dcache_bucket(dentry->parent, dentry->hash)];
+
+    while (*link && *link != dentry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = dentry->hash_next;
+    }
+    dentry->hash_next = NULL;
+}
+
+static void dcache_lru_remove(dentry_t *dentry) {
+    if (dentry->lru_prev) {
+        dentry->lru_prev->lru_next = dentry->lru_next;
+    } else {
+        dcache_lru_head = dentry->lru_next;
+    }
+    if (dentry->lru_next) {
+        dentry->lru_next->lru_prev = dentry->lru_prev;
+    } else {
+        dcache_lru_tail = dentry->lru_prev;
+    }
+    dentry->lru_prev = dentry->lru_next = NULL;
+}
+
+static void dcache_lru_push(dentry_t *dentry) {
+    dentry->lru_prev = NULL;
+    dentry->lru_next = dcache_lru_head;
+    if (dcache_lru_head) {
+        dcache_lru_head->lru_prev = dentry;
+    } else {
+        dcache_lru_tail = dentry;
+    }
+    dcache_lru_head = dentry;
+}
+
+/**
+ * Unlink and free an entry
+ */
+static void dcache_free(dentry_t *dentry) {
+    dcache_hash_remove(dentry);
+    dcache_lru_remove(dentry);
+    dcache_stats.entries--;
+    vnode_put(dentry->node);
+    vnode_put(dentry->parent);
+    kfree(dentry);
+}
+
+static size_t dcache_shrink_count(void) {
+    return dcache_stats.entries;
+}
+
+static size_t dcache_shrink_scan(size_t nr) {
+    size_t freed = 0;
+
+    uint64_t flags = cpu_irq_save();
+    while (freed < nr && dcache_lru_tail) {
+        dcache_free(dcache_lru_tail);
+        dcache_stats.evictions++;
+        freed++;
+    }
+    cpu_irq_restore(flags);
+
+    return freed;
+}
+
+static shrinker_t dcache_shrinker = {
+    .name = "dcache",
+    .count = dcache_shrink_count,
+    .scan = dcache_shrink_scan,
+};
+
+/**
+ * Initialize the dentry cache
+ */
+void dcache_init(void) {
+    memset(dcache_hash_table, 0, sizeof(dcache_hash_table));
+    memset(&dcache_stats, 0, sizeof(dcache_stats));
+    dcache_lru_head = dcache_lru_tail = NULL;
+
+    shrinker_register(&dcache_shrinker);
+}
+
+/**
+ * Hash a name
+ * @param name Name (need not be NUL-terminated)
+ * @param len Length of the name
+ * @return Hash of the name
+ */
+uint32_t dcache_hash(const char *name, size_t len) {
+    uint32_t hash = DCACHE_HASH_INIT;
+    for (size_t i = 0; i < len; i++) {
+        hash = dcache_hash_byte(hash, name[i]);
+    }
+    return hash;
+}
+
+/**
+ * Look a name up in the cache
+ * @param parent Directory
+ * @param name Name (need not be NUL-terminated)
+ * @param len Length of the name
+ * @param hash Hash of the name
+ * @return The entry (whose node is NULL for a negative entry), or NULL on a miss
+ */
+dentry_t *dcache_lookup(struct vfs_node *parent, const char *name, size_t len, uint32_t hash) {
+    uint64_t flags = cpu_irq_save();
+    dentry_t *dentry = dcache_hash_table[dcache_bucket(parent, hash)];
+
+    while (dentry && (dentry->parent != parent || dentry->hash != hash ||
+                      dentry->name_len != len || memcmp(dentry->name, name, len) != 0)) {
+        dentry = dentry->hash_next;
+    }
+
+    if (!dentry) {
+        dcache_stats.misses++;
+    } else {
+        if (dentry->node) {
+            dcache_stats.hits++;
+        } else {
+            dcache_stats.negative_hits++;
+        }
+        if (dcache_lru_head != dentry) {
+            dcache_lru_remove(dentry);
+            dcache_lru_push(dentry);
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return dentry;
+}
+
+/**
+ * Cache the result of a filesystem lookup, evicting the least recently used entry if full
+ * @param parent Directory
+ * @param name Name (need not be NUL-terminated)
+ * @param len Length of the name
+ * @param hash Hash of the name
+ * @param node Node found, or NULL to record that the name does not exist
+ * @return The entry, or NULL if it could not be allocated
+ */
+dentry_t *dcache_add(struct vfs_node *parent, const char *name, size_t len, uint32_t hash,
+                     struct vfs_node *node) {
+    if (len > VFS_NAME_MAX) {
+        return NULL;
+    }
+
+    dentry_t *dentry = (dentry_t *)kmalloc(sizeof(dentry_t) + len + 1);
+    if (!dentry) {
+        return NULL;
+    }
+
+    dentry->parent = vnode_get(parent);
+    dentry->node = vnode_get(node);
+    dentry->hash = hash;
+    dentry->name_len = (uint16_t)len;
+    memcpy(dentry->name, name, len);
+    dentry->name[len] = '\0';
+
+    uint64_t flags = cpu_irq_save();
+    if (dcache_stats.entries >= DCACHE_MAX_ENTRIES && dcache_lru_tail) {
+        dcache_free(dcache_lru_tail);
+        dcache_stats.evictions++;
+    }
+
+    uint32_t bucket = dcache_bucket(parent, hash);
+    dentry->hash_next = dcache_hash_table[bucket];
+    dcache_hash_table[bucket] = dentry;
+    dcache_lru_push(dentry);
+    dcache_stats.entries++;
+    cpu_irq_restore(flags);
+
+    return dentry;
+}
+
+/**
+ * Drop the entry for a name, after the directory changed
+ * @param parent Directory
+ * @param name NUL-terminated name
+ */
+void dcache_invalidate(struct vfs_node *parent, const char *name) {
+    size_t len = strlen(name);
+    uint32_t hash = dcache_hash(name, len);
+
+    uint64_t flags = cpu_irq_save();
+    dentry_t *dentry = dcache_hash_table[dcache_bucket(parent, hash)];
+    while (dentry) {
+        dentry_t *next = dentry->hash_next;
+        if (dentry->parent == parent && dentry->hash == hash &&
+            dentry->name_len == len && memcmp(dentry->name, name, len) == 0) {
+            dcache_free(dentry);
+            dcache_stats.invalidations++;
+        }
+        dentry = next;
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Drop every entry that refers to a node, as parent or target
+ * @param node Node going away
+ */
+void dcache_invalidate_node(struct vfs_node *node) {
+    uint64_t flags = cpu_irq_save();
+    dentry_t *dentry = dcache_lru_head;
+    while (dentry) {
+        dentry_t *next = dentry->lru_next;
+        if (dentry->parent == node || dentry->node == node) {
+            dcache_free(dentry);
+            dcache_stats.invalidations++;
+        }
+        dentry = next;
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Get a snapshot of the cache statistics
+ * @param stats Structure to fill
+ */
+void dcache_get_stats(dcache_stats_t *stats) {
+    uint64_t flags = cpu_irq_save();
+    *stats = dcache_stats;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Print cache statistics
+ */
+void dcache_print_stats(void) {
+    dcache_stats_t stats;
+    dcache_get_stats(&stats);
+
+    kprintf("DCACHE: %u entries, %lu hits, %lu negative hits, %lu misses, %lu evictions, %lu invalidations\n",
+            stats.entries, stats.hits, stats.negative_hits, stats.misses,
+            stats.evictions, stats.invalidations);
+}
\ No newline at end of file
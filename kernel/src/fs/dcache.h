@@ -0,0 +1,122 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Directory entry cache
+ */
+
+#ifndef _FS_DCACHE_H
+#define _FS_DCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+struct vfs_node;
+
+/* Hash table size (power of two) */
+#define DCACHE_HASH_BITS    10
+#define DCACHE_HASH_SIZE    (1U << DCACHE_HASH_BITS)
+
+/* FNV-1a, fed one name byte at a time so a path can be hashed while it is scanned */
+#define DCACHE_HASH_INIT    0x811C9DC5U
+
+static inline uint32_t dcache_hash_byte(uint32_t hash, char c) {
+    return (hash ^ (uint8_t)c) * 0x01000193U;
+}
+
+/* Cached result of looking a name up in a directory */
+typedef struct dentry {
+    struct vfs_node *parent;        /* Directory holding the name */
+    struct vfs_node *node;          /* Node the name refers to, NULL if it does not exist */
+    uint32_t hash;                  /* Name hash */
+    uint16_t name_len;
+    struct dentry *hash_next;       /* Next entry in the hash bucket */
+    struct dentry *lru_prev;        /* LRU list, most recently used first */
+    struct dentry *lru_next;
+    char name[];
+} dentry_t;
+
+/* Cache statistics */
+typedef struct dcache_stats {
+    uint64_t hits;                  /* Lookups answered with a node */
+    uint64_t negative_hits;         /* Lookups answered with "does not exist" */
+    uint64_t misses;                /* Lookups that went to the filesystem */
+    uint64_t evictions;
+    uint64_t invalidations;
+    uint32_t entries;
+} dcache_stats_t;
+
+/**
+ * Initialize the dentry cache
+ */
+void dcache_init(void);
+
+/**
+ * Hash a name
+ * @param name Name (need not be NUL-terminated)
+ * @param len Length of the name
+ * @return Hash of the name
+ */
+uint32_t dcache_hash(const char *name, size_t len);
+
+/**
+ * Look a name up in the cache
+ * @param parent Directory
+ * @param name Name (need not be NUL-terminated)
+ * @param len Length of the name
+ * @param hash Hash of the name
+ * @return The entry (whose node is NULL for a negative entry), or NULL on a miss
+ */
+dentry_t *dcache_lookup(struct vfs_node *parent, const char *name, size_t len, uint32_t hash);
+
+/**
+ * Cache the result of a filesystem lookup, evicting the least recently used entry if full
+ * @param parent Directory
+ * @param name Name (need not be NUL-terminated)
+ * @param len Length of the name
+ * @param hash Hash of the name
+ * @param node Node found, or NULL to record that the name does not exist
+ * @return The entry, or NULL if it could not be allocated
+ */
+dentry_t *dcache_add(struct vfs_node *parent, const char *name, size_t len, uint32_t hash,
+                     struct vfs_node *node);
+
+/**
+ * Drop the entry for a name, after the directory changed
+ * @param parent Directory
+ * @param name NUL-terminated name
+ */
+void dcache_invalidate(struct vfs_node *parent, const char *name);
+
+/**
+ * Drop every entry that refers to a node, as parent or target
+ * @param node Node going away
+ */
+void dcache_invalidate_node(struct vfs_node *node);
+
+/**
+ * Get a snapshot of the cache statistics
+ * @param stats Structure to fill
+ */
+void dcache_get_stats(dcache_stats_t *stats);
+
+/**
+ * Print cache statistics
+ */
+void dcache_print_stats(void);
+
+#endif /* _FS_DCACHE_H */
\ No newline at end of file
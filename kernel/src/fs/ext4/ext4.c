@@ -21,11 +21,23 @@
 #include <stdbool.h>
 #include <lib/minstd.h>
 #include <kernel/io.h>
+#include <kernel/config.h>
 #include <fs/ext4/ext4.h>
 #include <drivers/driversys.h>
 #include <fs/vfs.h>
+#include <fs/icache.h>
 #include <drivers/block/block.h>
+#include <drivers/block/bio.h>
+#include <drivers/block/blk_queue.h>
+#include <drivers/block/block_cache.h>
 #include <mm/kmalloc.h>
+#include <mm/page_cache.h>
+
+/* File blocks submitted under one plug by ext4_read_file_data and ext4_readpages */
+#define EXT4_READ_BATCH     32
+
+/* Discards kept in flight by ext4_trim */
+#define EXT4_TRIM_BATCH     32
 
 /* Forward declarations */
 static int ext4_open(struct vfs_node *node, int flags);
@@ -35,6 +47,11 @@ static size_t ext4_write(struct vfs_node *node, uint64_t offset, size_t size, co
 static int ext4_readdir(struct vfs_node *node, uint32_t index, struct vfs_dirent *dirent);
 static struct vfs_node* ext4_finddir(struct vfs_node *node, const char *name);
 static int ext4_stat(struct vfs_node *node, struct vfs_stat *stat);
+static int ext4_readpages(struct vfs_node *node, uint64_t index, uint32_t count, void **pages,
+                          page_io_t *io);
+static int ext4_writepages(struct vfs_node *node, uint64_t index, uint32_t count, void **pages);
+static void ext4_evict(struct vfs_node *node);
+static int ext4_bdi_flush(void *data);
 
 /* Filesystem operations structure */
 static vfs_node_ops_t ext4_ops = {
@@ -44,7 +61,10 @@ static vfs_node_ops_t ext4_ops = {
     .write = ext4_write,
     .readdir = ext4_readdir,
     .finddir = ext4_finddir,
-    .stat = ext4_stat
+    .stat = ext4_stat,
+    .readpages = ext4_readpages,
+    .writepages = ext4_writepages,
+    .evict = ext4_evict
 };
 
 /* Driver hooks */
@@ -75,15 +95,61 @@ static device_driver_t ext4_driver = {
  * @return 0 on success, negative on error
  */
 int ext4_read_block(ext4_fs_t *fs, uint64_t block_num, void *buffer) {
+    return ext4_read_blocks(fs, block_num, 1, buffer);
+}
+
+/**
+ * Read a run of consecutive blocks with a single block layer request
+ * @param fs The filesystem to read from
+ * @param block_num The first block number to read
+ * @param count Number of blocks to read
+ * @param buffer The buffer to read into
+ * @return 0 on success, negative on error
+ */
+int ext4_read_blocks(ext4_fs_t *fs, uint64_t block_num, uint32_t count, void *buffer) {
+    if (!fs || !buffer || !fs->device) {
+        return -1;
+    }
+
+    if (fs->cache) {
+        return block_cache_read(fs->cache, block_num, count, buffer);
+    }
+
+    uint64_t sector = block_num * (fs->block_size / BLOCK_SECTOR_SIZE);
+    return bio_rw_sync(fs->device, BIO_OP_READ, sector, buffer, (size_t)count * fs->block_size);
+}
+
+/**
+ * Write a block to the filesystem
+ * @param fs The filesystem to write to
+ * @param block_num The block number to write
+ * @param buffer The data to write
+ * @return 0 on success, negative on error
+ */
+int ext4_write_block(ext4_fs_t *fs, uint64_t block_num, const void *buffer) {
     if (!fs || !buffer || !fs->device) {
         return -1;
     }
 
-    uint64_t offset = block_num * fs->block_size;
-    size_t size = fs->block_size;
+    if (fs->cache) {
+        return block_cache_write(fs->cache, block_num, buffer);
+    }
+
+    uint64_t sector = block_num * (fs->block_size / BLOCK_SECTOR_SIZE);
+    return bio_rw_sync(fs->device, BIO_OP_WRITE, sector, (void *)buffer, fs->block_size);
+}
+
+/**
+ * Write back all cached blocks and make them stable on the device
+ * @param fs The filesystem
+ * @return 0 on success, negative on error
+ */
+int ext4_sync(ext4_fs_t *fs) {
+    if (!fs) {
+        return -1;
+    }
 
-    /* Read the block using the block device interface */
-    return fs->device->ops->read(fs->device, offset, size, buffer);
+    return fs->cache ? block_cache_sync(fs->cache) : 0;
 }
 
 /**
@@ -145,6 +211,54 @@ int ext4_read_inode(ext4_fs_t *fs, uint32_t inode_num, ext4_inode_t *inode) {
     return 0;
 }
 
+/**
+ * Write an inode back to the inode table
+ * @param fs The filesystem
+ * @param inode_num The inode number to write
+ * @param inode The inode data
+ * @return 0 on success, negative on error
+ */
+int ext4_write_inode(ext4_fs_t *fs, uint32_t inode_num, const ext4_inode_t *inode) {
+    if (!fs || !inode || inode_num < 1) {
+        return -1;
+    }
+
+    uint32_t group = (inode_num - 1) / fs->inodes_per_group;
+    if (group >= fs->groups_count) {
+        kerr("EXT4: Invalid inode number %u\n", inode_num);
+        return -1;
+    }
+
+    ext4_group_desc_t *gdesc = &fs->group_desc_table[group];
+    uint64_t inode_table_block = gdesc->bg_inode_table_lo |
+                               ((uint64_t)gdesc->bg_inode_table_hi << 32);
+    uint32_t index = (inode_num - 1) % fs->inodes_per_group;
+    uint64_t inode_block = inode_table_block +
+                           (index * fs->sb.s_inode_size) / fs->block_size;
+    uint32_t offset = (index * fs->sb.s_inode_size) % fs->block_size;
+
+    uint8_t *block_buffer = (uint8_t *)kmalloc(fs->block_size);
+    if (!block_buffer) {
+        kerr("EXT4: Failed to allocate memory for inode block\n");
+        return -1;
+    }
+
+    /* The block holds other inodes too, so patch ours into it */
+    int result = ext4_read_block(fs, inode_block, block_buffer);
+    if (result == 0) {
+        size_t size = fs->sb.s_inode_size < sizeof(ext4_inode_t) ? fs->sb.s_inode_size
+                                                                 : sizeof(ext4_inode_t);
+        memcpy(block_buffer + offset, inode, size);
+        result = ext4_write_block(fs, inode_block, block_buffer);
+    }
+    if (result < 0) {
+        kerr("EXT4: Failed to write inode %u\n", inode_num);
+    }
+
+    kfree(block_buffer);
+    return result;
+}
+
 /**
  * Read file data using extent-based addressing
  * @param fs The filesystem
@@ -161,7 +275,7 @@ int ext4_read_extent_block(ext4_fs_t *fs, ext4_inode_t *inode, uint64_t block_nu
     }
 
     /* Check if the inode is using extents (flag in i_flags) */
-    if (!(inode->i_flags & 0x80000)) { /* EXT4_EXTENTS_FL */
+    if (!(inode->i_flags & EXT4_EXTENTS_FL)) {
         kerr("EXT4: Inode is not using extents\n");
         return -1;
     }
@@ -288,90 +402,505 @@ int ext4_read_file_block(ext4_fs_t *fs, ext4_inode_t *inode, uint64_t block_num,
 }
 
 /**
- * Allocate a new block in the filesystem
+ * Allocate a run of consecutive blocks
+ *
+ * The run starts at the first free block at or after the goal in the
+ * goal's group, wrapping to the group's start and then to the other
+ * groups, and extends over free blocks up to max. The bitmap is
+ * written once per run.
+ *
  * @param fs The filesystem
- * @param group_hint Preferred block group to allocate from
- * @param block_num Output parameter for the allocated block number
+ * @param goal Block to allocate near, usually the one after the file's previous block
+ * @param max Number of blocks wanted
+ * @param first Output parameter for the first allocated block
+ * @param count Output parameter for the number of blocks allocated, at least 1
  * @return 0 on success, negative on error
  */
-int ext4_allocate_block(ext4_fs_t *fs, uint32_t group_hint, uint64_t *block_num) {
-    if (!fs || !block_num) {
+int ext4_allocate_blocks(ext4_fs_t *fs, uint64_t goal, uint32_t max, uint64_t *first, uint32_t *count) {
+    if (!fs || !first || !count || max == 0) {
         return -1;
     }
 
-    /* Start searching from the suggested group or from the beginning */
-    uint32_t start_group = (group_hint < fs->groups_count) ? group_hint : 0;
+    if (goal < fs->sb.s_first_data_block || goal >= fs->block_count) {
+        goal = fs->sb.s_first_data_block;
+    }
+    uint32_t goal_group = (goal - fs->sb.s_first_data_block) / fs->blocks_per_group;
+    uint32_t goal_bit = (goal - fs->sb.s_first_data_block) % fs->blocks_per_group;
+
+    /* A group's bitmap is one block */
+    uint32_t group_bits = fs->blocks_per_group < fs->block_size * 8 ?
+                          fs->blocks_per_group : fs->block_size * 8;
+
+    uint8_t *bitmap = NULL;
 
     for (uint32_t i = 0; i < fs->groups_count; i++) {
-        uint32_t current_group = (start_group + i) % fs->groups_count;
+        uint32_t current_group = (goal_group + i) % fs->groups_count;
         ext4_group_desc_t *gdesc = &fs->group_desc_table[current_group];
 
         /* Check if this group has free blocks */
-        uint16_t free_blocks_lo = gdesc->bg_free_blocks_count_lo;
-        uint16_t free_blocks_hi = gdesc->bg_free_blocks_count_hi;
-        uint32_t free_blocks = free_blocks_lo | ((uint32_t)free_blocks_hi << 16);
+        uint32_t free_blocks = gdesc->bg_free_blocks_count_lo |
+                               ((uint32_t)gdesc->bg_free_blocks_count_hi << 16);
+        if (free_blocks == 0) {
+            continue;
+        }
 
-        if (free_blocks > 0) {
-            /* Read the block bitmap */
-            uint8_t *bitmap = (uint8_t *)kmalloc(fs->block_size);
+        if (!bitmap) {
+            bitmap = (uint8_t *)kmalloc(fs->block_size);
             if (!bitmap) {
                 kerr("EXT4: Failed to allocate memory for block bitmap\n");
                 return -1;
             }
+        }
+
+        /* Calculate block bitmap location */
+        uint64_t bitmap_block = gdesc->bg_block_bitmap_lo |
+                                ((uint64_t)gdesc->bg_block_bitmap_hi << 32);
 
-            /* Calculate block bitmap location */
-            uint64_t bitmap_block = gdesc->bg_block_bitmap_lo |
-                                    ((uint64_t)gdesc->bg_block_bitmap_hi << 32);
+        int result = ext4_read_block(fs, bitmap_block, bitmap);
+        if (result < 0) {
+            kerr("EXT4: Failed to read block bitmap\n");
+            kfree(bitmap);
+            return result;
+        }
 
-            int result = ext4_read_block(fs, bitmap_block, bitmap);
-            if (result < 0) {
-                kerr("EXT4: Failed to read block bitmap\n");
-                kfree(bitmap);
-                return result;
+        /* The last group may be shorter than the others */
+        uint64_t group_start = (uint64_t)current_group * fs->blocks_per_group +
+                               fs->sb.s_first_data_block;
+        uint32_t bits = group_bits;
+        if (group_start + bits > fs->block_count) {
+            bits = fs->block_count - group_start;
+        }
+
+        /* Find a free bit, from the goal in its own group */
+        uint32_t from = (i == 0 && goal_bit < bits) ? goal_bit : 0;
+        uint32_t j = 0;
+        bool found = false;
+        for (uint32_t k = 0; k < bits; k++) {
+            j = (from + k) % bits;
+            if (!(bitmap[j / 8] & (1 << (j % 8)))) {
+                found = true;
+                break;
             }
+        }
+        if (!found) {
+            continue;
+        }
 
-            /* Find a free bit in the bitmap */
-            for (uint32_t j = 0; j < fs->block_size * 8; j++) {
-                uint32_t byte_idx = j / 8;
-                uint32_t bit_idx = j % 8;
-
-                if (!(bitmap[byte_idx] & (1 << bit_idx))) {
-                    /* Mark the block as used */
-                    bitmap[byte_idx] |= (1 << bit_idx);
-
-                    /* Write back the updated bitmap */
-                    result = fs->device->ops->write(fs->device,
-                                                   bitmap_block * fs->block_size,
-                                                   fs->block_size,
-                                                   bitmap);
-                    kfree(bitmap);
-
-                    if (result < 0) {
-                        kerr("EXT4: Failed to write updated block bitmap\n");
-                        return result;
-                    }
+        /* Extend the run over the free bits after it and mark them used */
+        uint32_t run = 0;
+        while (run < max && run < free_blocks && j + run < bits &&
+               !(bitmap[(j + run) / 8] & (1 << ((j + run) % 8)))) {
+            bitmap[(j + run) / 8] |= (1 << ((j + run) % 8));
+            run++;
+        }
 
-                    /* Update group descriptor free block count */
-                    free_blocks_lo--;
-                    gdesc->bg_free_blocks_count_lo = free_blocks_lo;
+        /* Write back the updated bitmap */
+        result = ext4_write_block(fs, bitmap_block, bitmap);
+        kfree(bitmap);
+        if (result < 0) {
+            kerr("EXT4: Failed to write updated block bitmap\n");
+            return result;
+        }
+
+        /* Update group descriptor free block count */
+        free_blocks -= run;
+        gdesc->bg_free_blocks_count_lo = free_blocks & 0xFFFF;
+        gdesc->bg_free_blocks_count_hi = free_blocks >> 16;
+        if (fs->free_blocks >= run) {
+            fs->free_blocks -= run;
+        }
 
-                    /* Calculate the actual block number */
-                    *block_num = bitmap_block - fs->sb.s_first_data_block + j + 1;
+        /* Bit j of a group's bitmap is the group's j-th block */
+        *first = group_start + j;
+        *count = run;
+        return 0;
+    }
 
-                    return 0;
+    kfree(bitmap);
+    kerr("EXT4: No free blocks available\n");
+    return -1;
+}
+
+/**
+ * Allocate a new block in the filesystem
+ * @param fs The filesystem
+ * @param group_hint Preferred block group to allocate from
+ * @param block_num Output parameter for the allocated block number
+ * @return 0 on success, negative on error
+ */
+int ext4_allocate_block(ext4_fs_t *fs, uint32_t group_hint, uint64_t *block_num) {
+    if (!fs || !block_num) {
+        return -1;
+    }
+
+    /* Start searching from the suggested group or from the beginning */
+    uint32_t start_group = (group_hint < fs->groups_count) ? group_hint : 0;
+    uint64_t goal = (uint64_t)start_group * fs->blocks_per_group + fs->sb.s_first_data_block;
+
+    uint32_t count;
+    return ext4_allocate_blocks(fs, goal, 1, block_num, &count);
+}
+
+/**
+ * Return a run of blocks to the free pool
+ * @param fs The filesystem
+ * @param first First block of the run, which lies within one group
+ * @param count Number of blocks
+ * @return 0 on success, negative on error
+ */
+static int ext4_free_blocks(ext4_fs_t *fs, uint64_t first, uint32_t count) {
+    uint32_t group = (first - fs->sb.s_first_data_block) / fs->blocks_per_group;
+    uint32_t bit = (first - fs->sb.s_first_data_block) % fs->blocks_per_group;
+    ext4_group_desc_t *gdesc = &fs->group_desc_table[group];
+
+    uint8_t *bitmap = (uint8_t *)kmalloc(fs->block_size);
+    if (!bitmap) {
+        kerr("EXT4: Failed to allocate memory for block bitmap\n");
+        return -1;
+    }
+
+    uint64_t bitmap_block = gdesc->bg_block_bitmap_lo |
+                            ((uint64_t)gdesc->bg_block_bitmap_hi << 32);
+
+    int result = ext4_read_block(fs, bitmap_block, bitmap);
+    if (result == 0) {
+        for (uint32_t j = bit; j < bit + count; j++) {
+            bitmap[j / 8] &= ~(1 << (j % 8));
+        }
+        result = ext4_write_block(fs, bitmap_block, bitmap);
+    }
+    kfree(bitmap);
+
+    if (result < 0) {
+        kerr("EXT4: Failed to free blocks %llu-%llu\n", first, first + count - 1);
+        return result;
+    }
+
+    uint32_t free_blocks = (gdesc->bg_free_blocks_count_lo |
+                            ((uint32_t)gdesc->bg_free_blocks_count_hi << 16)) + count;
+    gdesc->bg_free_blocks_count_lo = free_blocks & 0xFFFF;
+    gdesc->bg_free_blocks_count_hi = free_blocks >> 16;
+    fs->free_blocks += count;
+    return 0;
+}
+
+/* Discard requests in flight during ext4_trim */
+typedef struct ext4_trim_batch {
+    bio_t *bios[EXT4_TRIM_BATCH];
+    uint32_t count;
+    int result;
+    blk_plug_t plug;
+} ext4_trim_batch_t;
+
+/**
+ * Wait for a batch of discards and start a new plug for the next one
+ */
+static void ext4_trim_wait(ext4_trim_batch_t *batch, bool restart) {
+    blk_finish_plug(&batch->plug);
+
+    for (uint32_t i = 0; i < batch->count; i++) {
+        if (bio_wait(batch->bios[i]) < 0) {
+            batch->result = -1;
+        }
+        bio_free(batch->bios[i]);
+    }
+    batch->count = 0;
+
+    if (restart) {
+        blk_start_plug(&batch->plug);
+    }
+}
+
+/**
+ * Queue discards for a run of free blocks, split at the device's limit
+ */
+static void ext4_trim_run(ext4_fs_t *fs, ext4_trim_batch_t *batch, uint64_t block, uint64_t count) {
+    uint32_t spb = fs->block_size / BLOCK_SECTOR_SIZE;
+    uint32_t max = blk_queue_max_sectors(fs->device->queue, BIO_OP_DISCARD) / spb;
+
+    while (count > 0 && batch->result == 0 && max > 0) {
+        uint64_t n = count < max ? count : max;
+        bio_t *bio = bio_alloc(fs->device, BIO_OP_DISCARD, block * spb, 0);
+        if (!bio) {
+            batch->result = -1;
+            return;
+        }
+
+        bio->size = (uint32_t)(n * fs->block_size);
+        bio_submit(bio);
+        batch->bios[batch->count++] = bio;
+        if (batch->count == EXT4_TRIM_BATCH) {
+            ext4_trim_wait(batch, true);
+        }
+
+        block += n;
+        count -= n;
+    }
+}
+
+/**
+ * Discard free space, like FITRIM: walk the block bitmaps and discard every
+ * run of free blocks at least minlen long. Runs are discarded whole, and
+ * runs that meet across group boundaries merge in the plug.
+ * @param fs The filesystem
+ * @param start First byte of the range to trim
+ * @param len Bytes in the range
+ * @param minlen Shortest free run worth discarding, in bytes
+ * @param trimmed Output for the bytes discarded (may be NULL)
+ * @return 0 on success, negative on error or if the device cannot discard
+ */
+int ext4_trim(ext4_fs_t *fs, uint64_t start, uint64_t len, uint64_t minlen, uint64_t *trimmed) {
+    if (!fs || !fs->device->queue || !fs->device->queue->max_discard_sectors) {
+        return -1;
+    }
+
+    uint64_t first = start / fs->block_size;
+    uint64_t last = len / fs->block_size > fs->block_count - first ?
+                    fs->block_count : first + len / fs->block_size;
+    uint64_t min_blocks = (minlen + fs->block_size - 1) / fs->block_size;
+    if (min_blocks == 0) {
+        min_blocks = 1;
+    }
+    if (first < fs->sb.s_first_data_block) {
+        first = fs->sb.s_first_data_block;
+    }
+
+    uint8_t *bitmap = (uint8_t *)kmalloc(fs->block_size);
+    ext4_trim_batch_t *batch = (ext4_trim_batch_t *)kzalloc(sizeof(ext4_trim_batch_t));
+    if (!bitmap || !batch) {
+        kfree(bitmap);
+        kfree(batch);
+        return -1;
+    }
+
+    uint64_t discarded = 0;
+    blk_start_plug(&batch->plug);
+
+    for (uint32_t group = 0; group < fs->groups_count && batch->result == 0; group++) {
+        ext4_group_desc_t *gdesc = &fs->group_desc_table[group];
+        uint64_t group_start = (uint64_t)group * fs->blocks_per_group + fs->sb.s_first_data_block;
+        uint64_t group_end = group_start + fs->blocks_per_group;
+        if (group_end > fs->block_count) {
+            group_end = fs->block_count;
+        }
+
+        /* Groups outside the range, or whose bitmap was never written, are left alone */
+        if (group_end <= first || group_start >= last || (gdesc->bg_flags & EXT4_BG_BLOCK_UNINIT)) {
+            continue;
+        }
+
+        uint64_t bitmap_block = gdesc->bg_block_bitmap_lo | ((uint64_t)gdesc->bg_block_bitmap_hi << 32);
+        if (ext4_read_block(fs, bitmap_block, bitmap) < 0) {
+            kerr("EXT4: Failed to read block bitmap of group %u\n", group);
+            batch->result = -1;
+            break;
+        }
+
+        uint64_t run_start = 0;
+        uint64_t run_len = 0;
+        for (uint64_t block = group_start; block <= group_end; block++) {
+            uint64_t bit = block - group_start;
+            bool free = block < group_end && block >= first && block < last &&
+                        !(bitmap[bit / 8] & (1 << (bit % 8)));
+
+            if (free) {
+                if (run_len++ == 0) {
+                    run_start = block;
                 }
+                continue;
             }
 
-            kfree(bitmap);
+            if (run_len >= min_blocks) {
+                ext4_trim_run(fs, batch, run_start, run_len);
+                discarded += run_len;
+            }
+            run_len = 0;
         }
     }
 
-    kerr("EXT4: No free blocks available\n");
-    return -1;
+    ext4_trim_wait(batch, false);
+    int result = batch->result;
+    kfree(batch);
+    kfree(bitmap);
+
+    if (result == 0) {
+        kprintf("EXT4: Trimmed %llu blocks\n", discarded);
+    }
+    if (trimmed) {
+        *trimmed = result == 0 ? discarded * fs->block_size : 0;
+    }
+    return result;
+}
+
+/**
+ * Map consecutive file blocks to disk blocks, allocating a hole if asked
+ *
+ * Only an extent root held in the inode can grow: new blocks extend the
+ * extent before them when they follow it on disk, and otherwise take a
+ * free slot of the root. Deeper trees are mapped block by block and
+ * cannot grow.
+ *
+ * @param fs The filesystem
+ * @param inode The inode; its extents and block count change when blocks are allocated
+ * @param block First logical block
+ * @param max Number of blocks wanted
+ * @param create Allocate blocks if the first block is a hole
+ * @param phys Output parameter for the physical block of the first block
+ * @param count Output parameter for the number of consecutive blocks mapped, at most max
+ * @return 0 on success, negative on error or for a hole when not creating
+ */
+static int ext4_map_blocks(ext4_fs_t *fs, ext4_inode_t *inode, uint64_t block, uint32_t max,
+                           bool create, uint64_t *phys, uint32_t *count) {
+    ext4_extent_node_t *node = (ext4_extent_node_t *)&inode->i_block;
+
+    /* A file without blocks starts with an empty extent root */
+    if (node->header.eh_magic != EXT4_EXTENT_HEADER_MAGIC) {
+        if (!create) {
+            return -1;
+        }
+        memset(node, 0, sizeof(ext4_extent_node_t));
+        node->header.eh_magic = EXT4_EXTENT_HEADER_MAGIC;
+        node->header.eh_max = 4;
+        inode->i_flags |= EXT4_EXTENTS_FL;
+    }
+
+    if (node->header.eh_depth > 0) {
+        if (ext4_read_extent_block(fs, inode, block, phys) < 0) {
+            if (create) {
+                kerr("EXT4: Cannot add blocks to an extent tree of depth %u\n",
+                     node->header.eh_depth);
+            }
+            return -1;
+        }
+        *count = 1;
+        return 0;
+    }
+
+    /* Look the block up, noting the extents around it */
+    uint32_t entries = node->header.eh_entries;
+    uint64_t next_block = UINT64_MAX;
+    int prev = -1;
+
+    for (uint32_t i = 0; i < entries; i++) {
+        ext4_extent_t *ext = &node->extent[i];
+        uint64_t ext_start = ext->ee_start_lo | ((uint64_t)ext->ee_start_hi << 32);
+
+        if (block >= ext->ee_block && block < (uint64_t)ext->ee_block + ext->ee_len) {
+            uint64_t left = ext->ee_block + ext->ee_len - block;
+            *phys = ext_start + (block - ext->ee_block);
+            *count = left < max ? left : max;
+            return 0;
+        }
+
+        if (ext->ee_block < block) {
+            if (prev < 0 || ext->ee_block > node->extent[prev].ee_block) {
+                prev = i;
+            }
+        } else if (ext->ee_block < next_block) {
+            next_block = ext->ee_block;
+        }
+    }
+
+    if (!create) {
+        return -1;
+    }
+
+    /* Fill the hole at most up to the next extent */
+    if (block + max > next_block) {
+        max = next_block - block;
+    }
+    if (max > EXT4_EXT_MAX_LEN) {
+        max = EXT4_EXT_MAX_LEN;
+    }
+
+    /* Place the blocks where the previous extent would continue on disk */
+    uint64_t goal = 0;
+    bool adjacent = false;
+    if (prev >= 0) {
+        ext4_extent_t *ext = &node->extent[prev];
+        uint64_t ext_end = ext->ee_block + ext->ee_len;
+        goal = (ext->ee_start_lo | ((uint64_t)ext->ee_start_hi << 32)) + ext->ee_len +
+               (block - ext_end);
+        adjacent = ext_end == block && ext->ee_len < EXT4_EXT_MAX_LEN;
+        if (adjacent && max > EXT4_EXT_MAX_LEN - ext->ee_len) {
+            max = EXT4_EXT_MAX_LEN - ext->ee_len;
+        }
+    }
+
+    uint32_t slots = node->header.eh_max < 4 ? node->header.eh_max : 4;
+    if (!adjacent && entries >= slots) {
+        kerr("EXT4: Extent root is full, cannot map block %llu\n", block);
+        return -1;
+    }
+
+    uint64_t first;
+    uint32_t allocated;
+    int result = ext4_allocate_blocks(fs, goal, max, &first, &allocated);
+    if (result < 0) {
+        return result;
+    }
+
+    if (adjacent && first == goal) {
+        node->extent[prev].ee_len += allocated;
+    } else if (entries < slots) {
+        /* Keep the extents sorted by logical block */
+        uint32_t pos = 0;
+        while (pos < entries && node->extent[pos].ee_block < block) {
+            pos++;
+        }
+        memmove(&node->extent[pos + 1], &node->extent[pos],
+                (entries - pos) * sizeof(ext4_extent_t));
+
+        node->extent[pos].ee_block = block;
+        node->extent[pos].ee_len = allocated;
+        node->extent[pos].ee_start_lo = first & 0xFFFFFFFF;
+        node->extent[pos].ee_start_hi = (first >> 32) & 0xFFFF;
+        node->header.eh_entries++;
+    } else {
+        ext4_free_blocks(fs, first, allocated);
+        kerr("EXT4: Extent root is full, cannot map block %llu\n", block);
+        return -1;
+    }
+
+    /* The block count is in 512-byte sectors */
+    uint64_t sectors = inode->i_blocks_lo | ((uint64_t)inode->osd2.linux2.l_i_blocks_high << 32);
+    sectors += (uint64_t)allocated * (fs->block_size / 512);
+    inode->i_blocks_lo = sectors & 0xFFFFFFFF;
+    inode->osd2.linux2.l_i_blocks_high = (sectors >> 32) & 0xFFFF;
+
+    *phys = first;
+    *count = allocated;
+    return 0;
+}
+
+/**
+ * Read a file block that is about to be partly overwritten
+ * @param fs The filesystem
+ * @param inode The inode to read from
+ * @param block_num The logical block number to read
+ * @param buffer The buffer to read into
+ * @return 0 on success, negative on error
+ */
+static int ext4_read_old_block(ext4_fs_t *fs, ext4_inode_t *inode, uint64_t block_num, void *buffer) {
+    uint64_t file_size = inode->i_size_lo | ((uint64_t)inode->i_size_high << 32);
+    uint64_t phys_block;
+    uint32_t count;
+
+    /* Holes and blocks past the end of the file read as zeros */
+    if (block_num * fs->block_size >= file_size ||
+        ext4_map_blocks(fs, inode, block_num, 1, false, &phys_block, &count) < 0) {
+        memset(buffer, 0, fs->block_size);
+        return 0;
+    }
+
+    return ext4_read_block(fs, phys_block, buffer);
 }
 
 /**
  * Write data to an extent block
+ *
+ * A mapped block is overwritten in place; a hole gets a new block.
+ *
  * @param fs The filesystem
  * @param inode The inode to write to
  * @param block_num Logical block number to write
@@ -391,58 +920,29 @@ int ext4_write_extent_block(ext4_fs_t *fs, ext4_inode_t *inode,
         return -1;
     }
 
-    /* Allocate a new physical block */
     uint64_t phys_block;
-    int result = ext4_allocate_block(fs, 0, &phys_block);
+    uint32_t count;
+    int result = ext4_map_blocks(fs, inode, block_num, 1, true, &phys_block, &count);
     if (result < 0) {
-        kerr("EXT4: Failed to allocate block for writing\n");
+        kerr("EXT4: Failed to map block %llu for writing\n", block_num);
         return result;
     }
 
-    /* Write the data to the newly allocated block */
-    result = fs->device->ops->write(fs->device,
-                                    phys_block * fs->block_size,
-                                    fs->block_size,
-                                    buffer);
+    result = ext4_write_block(fs, phys_block, buffer);
     if (result < 0) {
         kerr("EXT4: Failed to write data block\n");
         return result;
     }
 
-    /* Update or create extent tree */
-    ext4_extent_node_t *node = (ext4_extent_node_t *)&inode->i_block;
-
-    /* If this is the first extent, create a new header */
-    if (node->header.eh_magic != EXT4_EXTENT_HEADER_MAGIC) {
-        node->header.eh_magic = EXT4_EXTENT_HEADER_MAGIC;
-        node->header.eh_entries = 1;
-        node->header.eh_max = 4;
-        node->header.eh_depth = 0;
-        node->header.eh_generation = 0;
-
-        node->extent[0].ee_block = block_num;
-        node->extent[0].ee_len = 1;
-        node->extent[0].ee_start_lo = phys_block & 0xFFFFFFFF;
-        node->extent[0].ee_start_hi = (phys_block >> 32) & 0xFFFF;
-    } else {
-        /* TODO: Implement more complex extent tree management for multiple blocks */
-        kerr("EXT4: Multi-block extent writing not fully implemented\n");
-        return -1;
-    }
-
-    /* Update inode size if necessary */
-    uint64_t file_size = inode->i_size_lo | ((uint64_t)inode->i_size_high << 32);
-    uint64_t block_offset = block_num * fs->block_size;
-    if (block_offset + fs->block_size > file_size) {
-        inode->i_size_lo = (block_offset + fs->block_size) & 0xFFFFFFFF;
-        inode->i_size_high = (block_offset + fs->block_size) >> 32;
-    }
-
     return 0;
 }
 
 /**
  * Write file data to an inode
+ *
+ * Whole blocks are written straight from the buffer, a mapped run at a
+ * time; only partial first and last blocks are read and merged.
+ *
  * @param fs The filesystem
  * @param inode The inode to write to
  * @param offset Offset within the file to write
@@ -462,64 +962,76 @@ int ext4_write_file_data(ext4_fs_t *fs, ext4_inode_t *inode,
         return -1;
     }
 
-    /* Allocate a buffer for writing blocks */
+    if (!(fs->sb.s_feature_incompat & EXT4_FEATURE_INCOMPAT_EXTENTS)) {
+        kerr("EXT4: Filesystem doesn't support extents\n");
+        return -1;
+    }
+
+    /* Allocate a buffer for partial blocks */
     uint8_t *block_buffer = (uint8_t *)kmalloc(fs->block_size);
     if (!block_buffer) {
         kerr("EXT4: Failed to allocate memory for write buffer\n");
         return -1;
     }
 
-    /* Calculate starting block and offset within block */
-    uint64_t start_block = offset / fs->block_size;
-    uint32_t start_offset = offset % fs->block_size;
-
-    /* Calculate total number of blocks to write */
-    uint64_t end_pos = offset + size;
-    uint64_t end_block = (end_pos - 1) / fs->block_size;
-    uint64_t num_blocks = end_block - start_block + 1;
-
-    /* Write blocks one by one */
     uint64_t bytes_written = 0;
     const uint8_t *src = (const uint8_t *)buffer;
-
-    for (uint64_t i = 0; i < num_blocks; i++) {
-        uint64_t current_block = start_block + i;
-
-        /* Read existing block data if not writing a full block */
-        int read_result = ext4_read_file_block(fs, inode, current_block, block_buffer);
-        if (read_result < 0) {
-            kerr("EXT4: Failed to read existing block data\n");
-            kfree(block_buffer);
-            return read_result;
+    int result = 0;
+
+    while (bytes_written < size && result == 0) {
+        uint64_t current_block = (offset + bytes_written) / fs->block_size;
+        uint32_t block_offset = (offset + bytes_written) % fs->block_size;
+        uint64_t left = size - bytes_written;
+
+        if (block_offset == 0 && left >= fs->block_size) {
+            uint64_t blocks = left / fs->block_size;
+            uint64_t phys_block;
+            uint32_t run = 0;
+
+            result = ext4_map_blocks(fs, inode, current_block,
+                                     blocks < EXT4_EXT_MAX_LEN ? blocks : EXT4_EXT_MAX_LEN,
+                                     true, &phys_block, &run);
+            for (uint32_t j = 0; j < run && result == 0; j++) {
+                result = ext4_write_block(fs, phys_block + j, src + bytes_written);
+                if (result == 0) {
+                    bytes_written += fs->block_size;
+                }
+            }
+            continue;
         }
 
-        /* Calculate how much data to write to this block */
-        uint32_t block_offset = (i == 0) ? start_offset : 0;
+        /* A partial block keeps the rest of its contents */
         uint32_t bytes_to_copy = fs->block_size - block_offset;
-
-        if (bytes_written + bytes_to_copy > size) {
-            bytes_to_copy = size - bytes_written;
+        if (bytes_to_copy > left) {
+            bytes_to_copy = left;
         }
 
-        /* Copy data into block buffer */
+        result = ext4_read_old_block(fs, inode, current_block, block_buffer);
+        if (result < 0) {
+            break;
+        }
         memcpy(block_buffer + block_offset, src + bytes_written, bytes_to_copy);
 
-        /* Write the block */
-        int write_result = ext4_write_extent_block(fs, inode, current_block, block_buffer);
-        if (write_result < 0) {
-            kerr("EXT4: Failed to write block\n");
-            kfree(block_buffer);
-            return write_result;
+        result = ext4_write_extent_block(fs, inode, current_block, block_buffer);
+        if (result == 0) {
+            bytes_written += bytes_to_copy;
         }
+    }
+
+    kfree(block_buffer);
 
-        bytes_written += bytes_to_copy;
+    if (result < 0) {
+        kerr("EXT4: Failed to write block\n");
+        return result;
+    }
 
-        if (bytes_written >= size) {
-            break;
-        }
+    /* Update inode size if necessary */
+    uint64_t file_size = inode->i_size_lo | ((uint64_t)inode->i_size_high << 32);
+    if (offset + bytes_written > file_size) {
+        inode->i_size_lo = (offset + bytes_written) & 0xFFFFFFFF;
+        inode->i_size_high = (offset + bytes_written) >> 32;
     }
 
-    kfree(block_buffer);
     return bytes_written;
 }
 
@@ -548,8 +1060,8 @@ int ext4_read_file_data(ext4_fs_t *fs, ext4_inode_t *inode, uint64_t offset, uin
         size = file_size - offset;
     }
 
-    /* Allocate a temporary buffer for reading blocks */
-    uint8_t *block_buffer = (uint8_t *)kmalloc(fs->block_size);
+    /* Bounce buffers for a partial first and last block */
+    uint8_t *block_buffer = (uint8_t *)kmalloc(fs->block_size * 2);
     if (!block_buffer) {
         kerr("EXT4: Failed to allocate memory for block buffer\n");
         return -1;
@@ -564,38 +1076,98 @@ int ext4_read_file_data(ext4_fs_t *fs, ext4_inode_t *inode, uint64_t offset, uin
     uint64_t end_block = (end_pos - 1) / fs->block_size;
     uint64_t num_blocks = end_block - start_block + 1;
 
-    /* Read blocks one by one */
-    uint64_t bytes_read = 0;
+    /*
+     * Submit blocks in batches under a plug: full blocks are read straight
+     * into the destination, and physically adjacent blocks are merged into
+     * large requests before they reach the device.
+     */
+    struct {
+        bio_t *bio;
+        uint8_t *bounce;        /* Partial block to copy out, or NULL */
+        uint32_t block_offset;
+        uint32_t bytes;
+        uint64_t dest_offset;
+    } batch[EXT4_READ_BATCH];
+
     uint8_t *dest = (uint8_t *)buffer;
+    uint64_t bytes_read = 0;
+    uint64_t i = 0;
+    int result = 0;
+
+    while (i < num_blocks && result == 0) {
+        uint32_t queued = 0;
+        blk_plug_t plug;
+        blk_start_plug(&plug);
+
+        for (; i < num_blocks && queued < EXT4_READ_BATCH; i++) {
+            uint64_t current_block = start_block + i;
+
+            /* Calculate how much data to copy from this block */
+            uint32_t block_offset = (i == 0) ? start_offset : 0;
+            uint32_t bytes_to_copy = fs->block_size - block_offset;
+            if (bytes_read + bytes_to_copy > size) {
+                bytes_to_copy = size - bytes_read;
+            }
 
-    for (uint64_t i = 0; i < num_blocks; i++) {
-        uint64_t current_block = start_block + i;
-        int result = ext4_read_file_block(fs, inode, current_block, block_buffer);
-        if (result < 0) {
-            kerr("EXT4: Failed to read file block %llu\n", current_block);
-            kfree(block_buffer);
-            return result;
-        }
+            /* Holes read as zeros */
+            uint64_t phys_block;
+            uint32_t mapped;
+            if (ext4_map_blocks(fs, inode, current_block, 1, false, &phys_block, &mapped) < 0) {
+                memset(dest + bytes_read, 0, bytes_to_copy);
+                bytes_read += bytes_to_copy;
+                continue;
+            }
 
-        /* Calculate how much data to copy from this block */
-        uint32_t block_offset = (i == 0) ? start_offset : 0;
-        uint32_t bytes_to_copy = fs->block_size - block_offset;
+            uint8_t *target = dest + bytes_read;
+            uint8_t *bounce = NULL;
+            if (bytes_to_copy != fs->block_size) {
+                bounce = block_buffer + (i == 0 ? 0 : fs->block_size);
+                target = bounce;
+            }
 
-        if (bytes_read + bytes_to_copy > size) {
-            bytes_to_copy = size - bytes_read;
+            /* Cached blocks may be newer than the disk */
+            if (block_cache_copy(fs->cache, phys_block, block_offset, bytes_to_copy,
+                                 dest + bytes_read) == 0) {
+                bytes_read += bytes_to_copy;
+                continue;
+            }
+
+            bio_t *bio = bio_alloc(fs->device, BIO_OP_READ,
+                                   phys_block * (fs->block_size / BLOCK_SECTOR_SIZE),
+                                   fs->block_size / PAGE_SIZE + 2);
+            if (!bio) {
+                result = -1;
+                break;
+            }
+            bio_add_buffer(bio, target, fs->block_size);
+            bio_submit(bio);
+
+            batch[queued].bio = bio;
+            batch[queued].bounce = bounce;
+            batch[queued].block_offset = block_offset;
+            batch[queued].bytes = bytes_to_copy;
+            batch[queued].dest_offset = bytes_read;
+            queued++;
+
+            bytes_read += bytes_to_copy;
         }
 
-        /* Copy data from block buffer to destination buffer */
-        memcpy(dest + bytes_read, block_buffer + block_offset, bytes_to_copy);
-        bytes_read += bytes_to_copy;
+        blk_finish_plug(&plug);
 
-        if (bytes_read >= size) {
-            break;
+        for (uint32_t j = 0; j < queued; j++) {
+            if (bio_wait(batch[j].bio) < 0) {
+                kerr("EXT4: Failed to read file block\n");
+                result = -1;
+            } else if (batch[j].bounce) {
+                memcpy(dest + batch[j].dest_offset,
+                       batch[j].bounce + batch[j].block_offset, batch[j].bytes);
+            }
+            bio_free(batch[j].bio);
         }
     }
 
     kfree(block_buffer);
-    return bytes_read;
+    return result < 0 ? result : (int)bytes_read;
 }
 
 /**
@@ -629,6 +1201,7 @@ static int ext4_create_vfs_node(ext4_fs_t *fs, uint32_t inode_num, struct vfs_no
     node->size = inode.i_size_lo | ((uint64_t)inode.i_size_high << 32);
     node->private_data = info;
     node->ops = &ext4_ops;
+    node->bdi = &fs->bdi;
 
     /* Set the node type based on the inode mode */
     if (S_ISDIR(inode.i_mode)) {
@@ -736,24 +1309,31 @@ int ext4_mount(block_device_t *device, struct vfs_node **root_node) {
         return -1;
     }
 
+    fs->cache = block_cache_create(device, fs->block_size, 0);
+    if (!fs->cache) {
+        kerr("EXT4: Failed to create block cache\n");
+        kfree(fs->group_desc_table);
+        kfree(fs);
+        return -1;
+    }
+
     /* Read the group descriptor table */
     uint64_t gdesc_start_block = fs->sb.s_first_data_block + 1; /* Superblock is at block 0 or 1 */
 
-    for (uint32_t i = 0; i < gdesc_blocks; i++) {
-        result = ext4_read_block(fs, gdesc_start_block + i,
-                               ((uint8_t *)fs->group_desc_table) + (i * fs->block_size));
-        if (result < 0) {
-            kerr("EXT4: Failed to read group descriptor block %u\n", gdesc_start_block + i);
-            kfree(fs->group_desc_table);
-            kfree(fs);
-            return result;
-        }
+    result = ext4_read_blocks(fs, gdesc_start_block, gdesc_blocks, fs->group_desc_table);
+    if (result < 0) {
+        kerr("EXT4: Failed to read group descriptor table at block %llu\n", gdesc_start_block);
+        block_cache_destroy(fs->cache);
+        kfree(fs->group_desc_table);
+        kfree(fs);
+        return result;
     }
 
     /* Create the root node */
     *root_node = (struct vfs_node *)kmalloc(sizeof(struct vfs_node));
     if (!*root_node) {
         kerr("EXT4: Failed to allocate memory for root node\n");
+        block_cache_destroy(fs->cache);
         kfree(fs->group_desc_table);
         kfree(fs);
         return -1;
@@ -763,6 +1343,7 @@ int ext4_mount(block_device_t *device, struct vfs_node **root_node) {
     if (result < 0) {
         kerr("EXT4: Failed to create root node\n");
         kfree(*root_node);
+        block_cache_destroy(fs->cache);
         kfree(fs->group_desc_table);
         kfree(fs);
         return result;
@@ -770,6 +1351,9 @@ int ext4_mount(block_device_t *device, struct vfs_node **root_node) {
 
     /* Store the root node in the filesystem structure */
     fs->root_node = *root_node;
+    vnode_insert(*root_node, fs, EXT4_ROOT_INO);
+
+    bdi_register(&fs->bdi, "ext4", ext4_bdi_flush, fs);
 
     kprintf("EXT4: Filesystem mounted successfully\n");
     return 0;
@@ -787,22 +1371,31 @@ void ext4_unmount(struct vfs_node *root_node) {
     ext4_inode_info_t *info = (ext4_inode_info_t *)root_node->private_data;
     ext4_fs_t *fs = info->fs;
 
-    if (fs) {
-        kprintf("EXT4: Unmounting filesystem\n");
+    if (!fs) {
+        kfree(info);
+        root_node->private_data = NULL;
+        return;
+    }
+
+    kprintf("EXT4: Unmounting filesystem\n");
 
-        /* Free filesystem resources */
-        if (fs->group_desc_table) {
-            kfree(fs->group_desc_table);
-        }
+    /* Dirty file pages go to the block cache first, and the dirty list lets go of its nodes */
+    bdi_unregister(&fs->bdi);
 
-        kfree(fs);
-    }
+    /*
+     * No node may point at fs once it is freed: cached nodes, the root
+     * among them, lose their pages and inode info here.
+     */
+    icache_evict_sb(fs);
+
+    /* Free filesystem resources; destroying the cache writes it back */
+    block_cache_destroy(fs->cache);
 
-    /* Free the inode info */
-    kfree(info);
+    if (fs->group_desc_table) {
+        kfree(fs->group_desc_table);
+    }
 
-    /* Clear the root node */
-    root_node->private_data = NULL;
+    kfree(fs);
 }
 
 /**
@@ -874,7 +1467,19 @@ static int ext4_find_dir_entry(ext4_fs_t *fs, ext4_inode_t *dir_inode, const cha
  * VFS open function
  */
 static int ext4_open(struct vfs_node *node, int flags) {
-    /* Nothing special to do here for now */
+    if (!node || !node->private_data) {
+        return -1;
+    }
+
+    ext4_inode_info_t *info = (ext4_inode_info_t *)node->private_data;
+
+    /* Buffered writes only reach ext4 at writeback, so refuse them here */
+    if ((flags & (VFS_O_WRONLY | VFS_O_RDWR | VFS_O_APPEND | VFS_O_CREAT | VFS_O_TRUNC)) &&
+        (info->fs->sb.s_feature_ro_compat & EXT4_FEATURE_RO_COMPAT_READONLY)) {
+        kerr("EXT4: Filesystem is mounted read-only\n");
+        return -1;
+    }
+
     return 0;
 }
 
@@ -911,7 +1516,262 @@ static size_t ext4_write(struct vfs_node *node, uint64_t offset, size_t size, co
     ext4_inode_info_t *info = (ext4_inode_info_t *)node->private_data;
     ext4_fs_t *fs = info->fs;
 
-    return ext4_write_file_data(fs, &info->raw_inode, offset, size, buffer);
+    int result = ext4_write_file_data(fs, &info->raw_inode, offset, size, buffer);
+
+    /*
+     * Ordered data: the blocks written above reach the disk before the
+     * inode whose extents point at them; one barrier per write, not per block.
+     */
+    if (result > 0) {
+        block_cache_barrier(fs->cache);
+        if (ext4_write_inode(fs, info->inode_num, &info->raw_inode) < 0) {
+            result = -1;
+        }
+    }
+
+    /* Reads through the page cache stop at the node's size */
+    node->size = info->raw_inode.i_size_lo | ((uint64_t)info->raw_inode.i_size_high << 32);
+    return result;
+}
+
+/**
+ * Find a file page in the memory of a memory-backed device
+ * @param addr Receives the address of the page's data
+ * @return 0 if the page can reference device memory, negative otherwise
+ */
+static int ext4_map_page(ext4_fs_t *fs, ext4_inode_t *inode, uint64_t index, uint64_t file_size,
+                         void **addr) {
+    block_device_t *device = fs->device;
+    if (!device->ops || !device->ops->map) {
+        return -1;
+    }
+
+    /* The part of a page past the end of the file has to read as zeros */
+    if ((index + 1) * PAGE_SIZE > file_size) {
+        return -1;
+    }
+
+    uint32_t blocks_per_page = PAGE_SIZE / fs->block_size;
+    uint64_t first_block = 0;
+
+    for (uint32_t b = 0; b < blocks_per_page; b++) {
+        /* Holes are left to the copy path, which zeroes them */
+        uint64_t phys_block;
+        uint32_t mapped;
+        if (ext4_map_blocks(fs, inode, index * blocks_per_page + b, 1, false,
+                            &phys_block, &mapped) < 0) {
+            return -1;
+        }
+        if (b == 0) {
+            first_block = phys_block;
+        } else if (phys_block != first_block + b) {
+            return -1;
+        }
+
+        /* Cached blocks may be newer than the device */
+        if (block_cache_contains(fs->cache, phys_block)) {
+            return -1;
+        }
+    }
+
+    return device->ops->map(device, first_block * fs->block_size, PAGE_SIZE, addr);
+}
+
+/**
+ * VFS readpages function
+ *
+ * Blocks are read straight into the page cache pages, under one plug so
+ * that adjacent blocks of consecutive pages merge into large requests.
+ * The reads are handed to the page cache, which waits for them. Pages
+ * of devices that can map their memory reference it instead.
+ */
+static int ext4_readpages(struct vfs_node *node, uint64_t index, uint32_t count, void **pages,
+                          page_io_t *io) {
+    if (!node || !pages || !io || !node->private_data) {
+        return -1;
+    }
+
+    ext4_inode_info_t *info = (ext4_inode_info_t *)node->private_data;
+    ext4_fs_t *fs = info->fs;
+    ext4_inode_t *inode = &info->raw_inode;
+    uint64_t file_size = inode->i_size_lo | ((uint64_t)inode->i_size_high << 32);
+
+    /* Blocks larger than a page are read through the bounce buffers of the byte path */
+    if (fs->block_size > PAGE_SIZE) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (ext4_read_file_data(fs, inode, (index + i) * PAGE_SIZE, PAGE_SIZE, pages[i]) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    uint32_t blocks_per_page = PAGE_SIZE / fs->block_size;
+    uint32_t queued = 0;
+    int result = 0;
+
+    blk_plug_t plug;
+    blk_start_plug(&plug);
+
+    for (uint32_t i = 0; i < count && result == 0; i++) {
+        void *addr;
+        if (ext4_map_page(fs, inode, index + i, file_size, &addr) == 0) {
+            page_io_map(io, i, addr);
+            continue;
+        }
+
+        for (uint32_t b = 0; b < blocks_per_page; b++) {
+            uint8_t *target = (uint8_t *)pages[i] + b * fs->block_size;
+            uint64_t file_block = (index + i) * blocks_per_page + b;
+
+            if (file_block * fs->block_size >= file_size) {
+                memset(target, 0, fs->block_size);
+                continue;
+            }
+
+            /* Holes, such as those left by writes past the end of the file, read as zeros */
+            uint64_t phys_block;
+            uint32_t mapped;
+            if (ext4_map_blocks(fs, inode, file_block, 1, false, &phys_block, &mapped) < 0) {
+                memset(target, 0, fs->block_size);
+                continue;
+            }
+
+            /* Cached blocks may be newer than the disk */
+            if (block_cache_copy(fs->cache, phys_block, 0, fs->block_size, target) == 0) {
+                continue;
+            }
+
+            bio_t *bio = bio_alloc(fs->device, BIO_OP_READ,
+                                   phys_block * (fs->block_size / BLOCK_SECTOR_SIZE), 2);
+            if (!bio) {
+                result = -1;
+                break;
+            }
+            bio_add_buffer(bio, target, fs->block_size);
+            bio_submit(bio);
+            page_io_add_bio(io, bio);
+
+            /* Keep the plug list short; the merged requests go out now */
+            if (++queued == EXT4_READ_BATCH) {
+                blk_finish_plug(&plug);
+                blk_start_plug(&plug);
+                queued = 0;
+            }
+        }
+    }
+
+    blk_finish_plug(&plug);
+    return result;
+}
+
+/**
+ * VFS writepages function
+ *
+ * Pages go into the block cache, which the flusher then writes out with
+ * ext4_bdi_flush as one batch. Blocks are mapped a run at a time, so the
+ * pages of a new file land on consecutive blocks, and are written whole
+ * straight from the pages. Only a block larger than a page that the pages
+ * cover partly is read first.
+ */
+static int ext4_writepages(struct vfs_node *node, uint64_t index, uint32_t count, void **pages) {
+    if (!node || !pages || !node->private_data) {
+        return -1;
+    }
+
+    ext4_inode_info_t *info = (ext4_inode_info_t *)node->private_data;
+    ext4_fs_t *fs = info->fs;
+    ext4_inode_t *inode = &info->raw_inode;
+
+    if (fs->sb.s_feature_ro_compat & EXT4_FEATURE_RO_COMPAT_READONLY) {
+        kerr("EXT4: Filesystem is mounted read-only\n");
+        return -1;
+    }
+
+    uint64_t start = index * PAGE_SIZE;
+    uint64_t pages_end = start + (uint64_t)count * PAGE_SIZE;
+    uint64_t end = pages_end < node->size ? pages_end : node->size;
+    if (end <= start) {
+        return 0;
+    }
+
+    uint32_t block_size = fs->block_size;
+    uint64_t block = start / block_size;
+    uint64_t last = (end - 1) / block_size;
+    int result = 0;
+
+    if (block_size <= PAGE_SIZE) {
+        /* Pages are zeroed past the end of the file, so blocks are written whole */
+        while (block <= last && result == 0) {
+            uint64_t want = last - block + 1;
+            uint64_t phys_block;
+            uint32_t run = 0;
+
+            result = ext4_map_blocks(fs, inode, block,
+                                     want < EXT4_EXT_MAX_LEN ? want : EXT4_EXT_MAX_LEN,
+                                     true, &phys_block, &run);
+            for (uint32_t j = 0; j < run && result == 0; j++, block++) {
+                uint64_t pos = block * block_size;
+                result = ext4_write_block(fs, phys_block + j,
+                                          (uint8_t *)pages[(pos - start) / PAGE_SIZE] +
+                                          pos % PAGE_SIZE);
+            }
+        }
+    } else {
+        uint8_t *block_buffer = (uint8_t *)kmalloc(block_size);
+        if (!block_buffer) {
+            kerr("EXT4: Failed to allocate memory for write buffer\n");
+            return -1;
+        }
+
+        for (; block <= last && result == 0; block++) {
+            uint64_t pos = block * block_size;
+            if (pos < start || pos + block_size > pages_end) {
+                result = ext4_read_old_block(fs, inode, block, block_buffer);
+            }
+
+            for (uint64_t p = pos < start ? start : pos;
+                 result == 0 && p < pos + block_size && p < pages_end; p += PAGE_SIZE) {
+                memcpy(block_buffer + (p - pos), pages[(p - start) / PAGE_SIZE], PAGE_SIZE);
+            }
+
+            if (result == 0) {
+                result = ext4_write_extent_block(fs, inode, block, block_buffer);
+            }
+        }
+
+        kfree(block_buffer);
+    }
+
+    if (result < 0) {
+        kerr("EXT4: Failed to write back pages %llu-%llu of inode %u\n",
+             index, index + count - 1, info->inode_num);
+        return result;
+    }
+
+    /*
+     * The size covers only the data written so far, so the inode never
+     * claims blocks of later pages that are not on the disk yet.
+     */
+    uint64_t disk_size = inode->i_size_lo | ((uint64_t)inode->i_size_high << 32);
+    if (end > disk_size) {
+        inode->i_size_lo = end & 0xFFFFFFFF;
+        inode->i_size_high = end >> 32;
+    }
+
+    /* Ordered data: the blocks reach the disk before the inode that points at them */
+    block_cache_barrier(fs->cache);
+    return ext4_write_inode(fs, info->inode_num, inode);
+}
+
+/**
+ * Push file data written back into the block cache on to the device
+ * @param data The filesystem
+ * @return 0 on success, negative on error
+ */
+static int ext4_bdi_flush(void *data) {
+    ext4_fs_t *fs = (ext4_fs_t *)data;
+    return block_cache_writeback(fs->cache);
 }
 
 /**
@@ -1036,8 +1896,14 @@ static struct vfs_node* ext4_finddir(struct vfs_node *node, const char *name) {
         return NULL;
     }
 
+    /* Share the node if the inode is already cached */
+    struct vfs_node *found_node = vnode_lookup(fs, inode_num);
+    if (found_node) {
+        return found_node;
+    }
+
     /* Create a new VFS node for the found inode */
-    struct vfs_node *found_node = (struct vfs_node *)kmalloc(sizeof(struct vfs_node));
+    found_node = (struct vfs_node *)kmalloc(sizeof(struct vfs_node));
     if (!found_node) {
         kerr("EXT4: Failed to allocate memory for node\n");
         return NULL;
@@ -1049,9 +1915,20 @@ static struct vfs_node* ext4_finddir(struct vfs_node *node, const char *name) {
         return NULL;
     }
 
+    vnode_insert(found_node, fs, inode_num);
     return found_node;
 }
 
+/**
+ * VFS evict function, called when the inode cache frees a node
+ */
+static void ext4_evict(struct vfs_node *node) {
+    if (node->private_data) {
+        kfree(node->private_data);
+        node->private_data = NULL;
+    }
+}
+
 /**
  * VFS stat function
  */
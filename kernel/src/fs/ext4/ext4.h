@@ -23,6 +23,7 @@
 #include <stdbool.h>
 #include <fs/vfs.h>
 #include <drivers/block/block.h>
+#include <mm/writeback.h>
 
 /* EXT4 magic number */
 #define EXT4_SUPER_MAGIC    0xEF53
@@ -84,6 +85,11 @@
 /* Custom write support feature flag */
 #define EXT4_FEATURE_WRITE_SUPPORT           0x00010000
 
+/* Block group flags */
+#define EXT4_BG_INODE_UNINIT 0x0001  /* Inode table and bitmap not initialized */
+#define EXT4_BG_BLOCK_UNINIT 0x0002  /* Block bitmap not initialized */
+#define EXT4_BG_INODE_ZEROED 0x0004  /* Inode table zeroed */
+
 /* File types in directory entries */
 #define EXT4_FT_UNKNOWN      0
 #define EXT4_FT_REG_FILE     1
@@ -98,6 +104,8 @@
 /* Extent-related definitions */
 #define EXT4_EXT_MAGIC       0xF30A
 #define EXT4_EXTENT_HEADER_MAGIC 0xF30A
+#define EXT4_EXTENTS_FL      0x80000  /* Inode uses extents */
+#define EXT4_EXT_MAX_LEN     32768    /* Longest initialized extent */
 
 /* Write error codes */
 typedef enum {
@@ -322,6 +330,9 @@ typedef struct ext4_fs {
 
     /* Optional write journal */
     void *write_journal;          /* Placeholder for write journaling */
+
+    struct block_cache *cache;    /* Write-back cache of metadata and data blocks */
+    backing_dev_t bdi;            /* Writeback of dirty file pages */
 } ext4_fs_t;
 
 /* In-memory inode information */
@@ -339,10 +350,15 @@ typedef struct ext4_inode_info {
 int ext4_init(void);
 int ext4_mount(block_device_t *device, struct vfs_node **root_node);
 void ext4_unmount(struct vfs_node *root_node);
+int ext4_sync(ext4_fs_t *fs);
+int ext4_trim(ext4_fs_t *fs, uint64_t start, uint64_t len, uint64_t minlen, uint64_t *trimmed);
 
 /* Read operations */
 int ext4_read_inode(ext4_fs_t *fs, uint32_t inode_num, ext4_inode_t *inode);
 int ext4_read_block(ext4_fs_t *fs, uint64_t block_num, void *buffer);
+int ext4_read_blocks(ext4_fs_t *fs, uint64_t block_num, uint32_t count, void *buffer);
+int ext4_write_block(ext4_fs_t *fs, uint64_t block_num, const void *buffer);
+int ext4_write_inode(ext4_fs_t *fs, uint32_t inode_num, const ext4_inode_t *inode);
 int ext4_read_extent_block(ext4_fs_t *fs, ext4_inode_t *inode,
                            uint64_t block_num, uint64_t *phys_block);
 int ext4_read_file_block(ext4_fs_t *fs, ext4_inode_t *inode,
@@ -352,6 +368,8 @@ int ext4_read_file_data(ext4_fs_t *fs, ext4_inode_t *inode,
 
 /* Write operations */
 int ext4_allocate_block(ext4_fs_t *fs, uint32_t group_hint, uint64_t *block_num);
+int ext4_allocate_blocks(ext4_fs_t *fs, uint64_t goal, uint32_t max,
+                         uint64_t *first, uint32_t *count);
 int ext4_write_extent_block(ext4_fs_t *fs, ext4_inode_t *inode,
                             uint64_t block_num, const void *buffer);
 int ext4_write_file_data(ext4_fs_t *fs, ext4_inode_t *inode,
@@ -0,0 +1,344 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Open files and file descriptor tables
+ *
+ * A file_t is what open() creates: the node, the open flags and the file
+ * position. Descriptors only point at it, so dup() shares the position
+ * with the original descriptor the way POSIX wants, and closing one of
+ * them leaves the file open for the others.
+ *
+ * Each table starts with FILES_INITIAL_FDS descriptors and doubles when
+ * full, up to FILES_MAX_FDS. Free descriptors are found with a two-level
+ * bitmap: open_fds has a bit per descriptor and full_fds a bit per
+ * open_fds word. The lowest free descriptor is two count-trailing-zeros
+ * away, whatever the table size up to 4096 descriptors, and one more
+ * word scanned per 4096 beyond that.
+ *
+ * Every context that opens files gets its own table. The kernel's table
+ * is current until a scheduler switches with files_set_current().
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <fs/vfs.h>
+#include <fs/file.h>
+#include <fs/icache.h>
+#include <mm/kmalloc.h>
+
+/* Descriptors a new table has room for */
+#define FILES_INITIAL_FDS   64
+
+/* Table used when no other has been switched to */
+static files_t *files_kernel = NULL;
+static files_t *files_active = NULL;
+
+/**
+ * Create an open file description
+ * @param node Opened node; the file takes over the caller's reference
+ * @param flags Open flags
+ * @return The file with one reference, or NULL if out of memory
+ */
+file_t *file_alloc(struct vfs_node *node, uint32_t flags) {
+    file_t *file = (file_t *)kzalloc(sizeof(file_t));
+    if (!file) {
+        return NULL;
+    }
+
+    file->node = node;
+    file->flags = flags;
+    file->position = 0;
+    file->refcount = 1;
+    return file;
+}
+
+/**
+ * Take a reference to an open file
+ * @param file File
+ * @return The file
+ */
+file_t *file_get(file_t *file) {
+    file->refcount++;
+    return file;
+}
+
+/**
+ * Drop a reference to an open file, closing the node with the last one
+ * @param file File
+ * @return 0 on success, or the node's close error
+ */
+int file_put(file_t *file) {
+    if (--file->refcount > 0) {
+        return 0;
+    }
+
+    struct vfs_node *node = file->node;
+    int result = 0;
+    if (node->ops && node->ops->close) {
+        result = node->ops->close(node);
+    }
+
+    vnode_put(node);
+    kfree(file);
+    return result < 0 ? result : 0;
+}
+
+/**
+ * Words of the second-level bitmap for a table size
+ */
+static inline uint32_t files_full_words(uint32_t max_fds) {
+    return (max_fds / 64 + 63) / 64;
+}
+
+/**
+ * Create an empty file descriptor table
+ * @return The table, or NULL if out of memory
+ */
+files_t *files_create(void) {
+    files_t *files = (files_t *)kzalloc(sizeof(files_t));
+    if (!files) {
+        return NULL;
+    }
+
+    files->max_fds = FILES_INITIAL_FDS;
+    files->fd = (file_t **)kzalloc(FILES_INITIAL_FDS * sizeof(file_t *));
+    files->open_fds = (uint64_t *)kzalloc(FILES_INITIAL_FDS / 64 * sizeof(uint64_t));
+    files->full_fds = (uint64_t *)kzalloc(files_full_words(FILES_INITIAL_FDS) * sizeof(uint64_t));
+    if (!files->fd || !files->open_fds || !files->full_fds) {
+        kfree(files->fd);
+        kfree(files->open_fds);
+        kfree(files->full_fds);
+        kfree(files);
+        return NULL;
+    }
+
+    return files;
+}
+
+/**
+ * Close every descriptor in a table and free it
+ * @param files Table
+ */
+void files_destroy(files_t *files) {
+    for (uint32_t fd = 0; fd < files->max_fds && files->count > 0; fd++) {
+        file_t *file = fd_remove(files, (int)fd);
+        if (file) {
+            file_put(file);
+        }
+    }
+
+    if (files_active == files) {
+        files_active = files_kernel;
+    }
+
+    kfree(files->fd);
+    kfree(files->open_fds);
+    kfree(files->full_fds);
+    kfree(files);
+}
+
+/**
+ * Create the kernel's own descriptor table and make it current
+ * @return 0 on success, negative on error
+ */
+int files_init(void) {
+    files_kernel = files_create();
+    if (!files_kernel) {
+        return -1;
+    }
+
+    files_active = files_kernel;
+    return 0;
+}
+
+/**
+ * Get the table of the running context
+ * @return The current table
+ */
+files_t *files_current(void) {
+    return files_active;
+}
+
+/**
+ * Switch the table the VFS descriptor calls use
+ * @param files Table
+ */
+void files_set_current(files_t *files) {
+    files_active = files;
+}
+
+/**
+ * Grow a table, doubling it until it has room for min_fds descriptors
+ * @return 0 on success, negative if that is past FILES_MAX_FDS or out of memory
+ */
+static int files_grow(files_t *files, uint32_t min_fds) {
+    uint32_t old_fds = files->max_fds;
+    uint32_t new_fds = old_fds;
+    while (new_fds < min_fds) {
+        new_fds *= 2;
+    }
+    if (new_fds > FILES_MAX_FDS) {
+        new_fds = FILES_MAX_FDS;
+    }
+    if (new_fds < min_fds) {
+        return -1;
+    }
+
+    uint32_t old_full = files_full_words(old_fds);
+    uint32_t new_full = files_full_words(new_fds);
+
+    file_t **fd = (file_t **)kzalloc(new_fds * sizeof(file_t *));
+    uint64_t *open_fds = (uint64_t *)kzalloc(new_fds / 64 * sizeof(uint64_t));
+    uint64_t *full_fds = (uint64_t *)kzalloc(new_full * sizeof(uint64_t));
+    if (!fd || !open_fds || !full_fds) {
+        kfree(fd);
+        kfree(open_fds);
+        kfree(full_fds);
+        return -1;
+    }
+
+    memcpy(fd, files->fd, old_fds * sizeof(file_t *));
+    memcpy(open_fds, files->open_fds, old_fds / 64 * sizeof(uint64_t));
+    memcpy(full_fds, files->full_fds, old_full * sizeof(uint64_t));
+
+    kfree(files->fd);
+    kfree(files->open_fds);
+    kfree(files->full_fds);
+    files->fd = fd;
+    files->open_fds = open_fds;
+    files->full_fds = full_fds;
+    files->max_fds = new_fds;
+    return 0;
+}
+
+/**
+ * Find the lowest free descriptor
+ * @return The descriptor, or -1 if the table is full
+ */
+static int fd_find_free(files_t *files) {
+    uint32_t words = files->max_fds / 64;
+
+    for (uint32_t i = 0; i < files_full_words(files->max_fds); i++) {
+        uint64_t full = files->full_fds[i];
+
+        /* Words past the end of the table count as full */
+        if (words - i * 64 < 64) {
+            full |= ~0ULL << (words - i * 64);
+        }
+        if (full != ~0ULL) {
+            uint32_t word = i * 64 + (uint32_t)__builtin_ctzll(~full);
+            return (int)(word * 64 + (uint32_t)__builtin_ctzll(~files->open_fds[word]));
+        }
+    }
+
+    return -1;
+}
+
+static void fd_set_bit(files_t *files, uint32_t fd) {
+    uint32_t word = fd / 64;
+
+    files->open_fds[word] |= 1ULL << (fd % 64);
+    if (files->open_fds[word] == ~0ULL) {
+        files->full_fds[word / 64] |= 1ULL << (word % 64);
+    }
+    files->count++;
+}
+
+static void fd_clear_bit(files_t *files, uint32_t fd) {
+    uint32_t word = fd / 64;
+
+    files->open_fds[word] &= ~(1ULL << (fd % 64));
+    files->full_fds[word / 64] &= ~(1ULL << (word % 64));
+    files->count--;
+}
+
+/**
+ * Install a file at the lowest free descriptor, growing the table if it is full
+ * @param files Table
+ * @param file File; the descriptor takes over the caller's reference
+ * @return The descriptor, or negative if the table cannot grow
+ */
+int fd_install(files_t *files, file_t *file) {
+    int fd = fd_find_free(files);
+    if (fd < 0) {
+        if (files_grow(files, files->max_fds + 1) < 0) {
+            return -1; /* No free file descriptors */
+        }
+        fd = fd_find_free(files);
+    }
+
+    files->fd[fd] = file;
+    fd_set_bit(files, (uint32_t)fd);
+    return fd;
+}
+
+/**
+ * Install a file at a given descriptor, which must be free
+ * @param files Table
+ * @param fd Descriptor
+ * @param file File; the descriptor takes over the caller's reference
+ * @return 0 on success, negative on error
+ */
+int fd_install_at(files_t *files, int fd, file_t *file) {
+    if (fd < 0 || fd >= FILES_MAX_FDS) {
+        return -1;
+    }
+    if ((uint32_t)fd >= files->max_fds && files_grow(files, (uint32_t)fd + 1) < 0) {
+        return -1;
+    }
+    if (files->fd[fd]) {
+        return -1;
+    }
+
+    files->fd[fd] = file;
+    fd_set_bit(files, (uint32_t)fd);
+    return 0;
+}
+
+/**
+ * Look a descriptor up
+ * @param files Table
+ * @param fd Descriptor
+ * @return The open file, or NULL if fd is not in use
+ */
+file_t *fd_get(files_t *files, int fd) {
+    if (!files || fd < 0 || (uint32_t)fd >= files->max_fds) {
+        return NULL;
+    }
+    return files->fd[fd];
+}
+
+/**
+ * Free a descriptor
+ * @param files Table
+ * @param fd Descriptor
+ * @return The file it referred to (whose reference passes to the caller), or NULL
+ */
+file_t *fd_remove(files_t *files, int fd) {
+    file_t *file = fd_get(files, fd);
+    if (!file) {
+        return NULL;
+    }
+
+    files->fd[fd] = NULL;
+    fd_clear_bit(files, (uint32_t)fd);
+    return file;
+}
\ No newline at end of file
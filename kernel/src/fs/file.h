@@ -0,0 +1,140 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Open files and file descriptor tables
+ */
+
+#ifndef _FS_FILE_H
+#define _FS_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct vfs_node;
+
+/* Read-ahead window of an open file, in pages */
+typedef struct file_ra_state {
+    uint64_t start;                 /* First page of the current window */
+    uint32_t size;                  /* Pages in the window, 0 if reads are not sequential */
+    uint32_t async_size;            /* Trailing pages whose first one starts the next window */
+    uint64_t next_index;            /* Page after the last one read */
+} file_ra_state_t;
+
+/* Open file description: what an open() created, shared by every fd duplicated from it */
+typedef struct file {
+    struct vfs_node *node;          /* Node opened, referenced */
+    uint32_t flags;                 /* Open flags */
+    uint64_t position;              /* Current file position */
+    file_ra_state_t ra;             /* Read-ahead state */
+    uint32_t refcount;              /* File descriptors pointing here */
+} file_t;
+
+/* File descriptor table */
+typedef struct files {
+    file_t **fd;                    /* Open file for each descriptor, NULL if free */
+    uint64_t *open_fds;             /* One bit per descriptor, set when in use */
+    uint64_t *full_fds;             /* One bit per open_fds word, set when all 64 are in use */
+    uint32_t max_fds;               /* Descriptors the table has room for (a multiple of 64) */
+    uint32_t count;                 /* Descriptors in use */
+} files_t;
+
+/**
+ * Create an open file description
+ * @param node Opened node; the file takes over the caller's reference
+ * @param flags Open flags
+ * @return The file with one reference, or NULL if out of memory
+ */
+file_t *file_alloc(struct vfs_node *node, uint32_t flags);
+
+/**
+ * Take a reference to an open file
+ * @param file File
+ * @return The file
+ */
+file_t *file_get(file_t *file);
+
+/**
+ * Drop a reference to an open file, closing the node with the last one
+ * @param file File
+ * @return 0 on success, or the node's close error
+ */
+int file_put(file_t *file);
+
+/**
+ * Create an empty file descriptor table
+ * @return The table, or NULL if out of memory
+ */
+files_t *files_create(void);
+
+/**
+ * Close every descriptor in a table and free it
+ * @param files Table
+ */
+void files_destroy(files_t *files);
+
+/**
+ * Create the kernel's own descriptor table and make it current
+ * @return 0 on success, negative on error
+ */
+int files_init(void);
+
+/**
+ * Get the table of the running context
+ * @return The current table
+ */
+files_t *files_current(void);
+
+/**
+ * Switch the table the VFS descriptor calls use
+ * @param files Table
+ */
+void files_set_current(files_t *files);
+
+/**
+ * Install a file at the lowest free descriptor, growing the table if it is full
+ * @param files Table
+ * @param file File; the descriptor takes over the caller's reference
+ * @return The descriptor, or negative if the table cannot grow
+ */
+int fd_install(files_t *files, file_t *file);
+
+/**
+ * Install a file at a given descriptor, which must be free
+ * @param files Table
+ * @param fd Descriptor
+ * @param file File; the descriptor takes over the caller's reference
+ * @return 0 on success, negative on error
+ */
+int fd_install_at(files_t *files, int fd, file_t *file);
+
+/**
+ * Look a descriptor up
+ * @param files Table
+ * @param fd Descriptor
+ * @return The open file, or NULL if fd is not in use
+ */
+file_t *fd_get(files_t *files, int fd);
+
+/**
+ * Free a descriptor
+ * @param files Table
+ * @param fd Descriptor
+ * @return The file it referred to (whose reference passes to the caller), or NULL
+ */
+file_t *fd_remove(files_t *files, int fd);
+
+#endif /* _FS_FILE_H */
\ No newline at end of file
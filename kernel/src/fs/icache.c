@@ -0,0 +1,312 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Inode cache
+ *
+ * Filesystems build one vfs_node per inode and hand it to the cache,
+ * keyed on the filesystem instance and inode number, so every lookup of
+ * the same inode shares a node instead of allocating a fresh one. Nodes
+ * are reference counted; once the last reference is dropped they move to
+ * an LRU of unused nodes, and are evicted from its tail when more than
+ * ICACHE_MAX_UNUSED pile up or when the allocators run out of memory.
+ * Nodes that were never inserted (filesystem roots built by hand, device
+ * nodes) are counted but never freed.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/config.h>
+#include <fs/vfs.h>
+#include <fs/icache.h>
+#include <mm/kmalloc.h>
+#include <mm/page_cache.h>
+#include <mm/shrinker.h>
+
+static struct vfs_node *icache_hash_table[ICACHE_HASH_SIZE];
+static struct vfs_node *icache_lru_head = NULL;   /* Most recently released */
+static struct vfs_node *icache_lru_tail = NULL;   /* Least recently released */
+static icache_stats_t icache_stats;
+
+static inline uint32_t icache_bucket(void *sb, uint64_t ino) {
+    uint64_t key = (uint64_t)(uintptr_t)sb ^ ino;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - ICACHE_HASH_BITS));
+}
+
+static void icache_hash_remove(struct vfs_node *node) {
+    struct vfs_node **link = &icache_hash_table[icache_bucket(node->sb, node->ino)];
+
+    while (*link && *link != node) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = node->hash_next;
+    }
+    node->hash_next = NULL;
+}
+
+static void icache_lru_remove(struct vfs_node *node) {
+    if (node->lru_prev) {
+        node->lru_prev->lru_next = node->lru_next;
+    } else {
+        icache_lru_head = node->lru_next;
+    }
+    if (node->lru_next) {
+        node->lru_next->lru_prev = node->lru_prev;
+    } else {
+        icache_lru_tail = node->lru_prev;
+    }
+    node->lru_prev = node->lru_next = NULL;
+    icache_stats.unused--;
+}
+
+static void icache_lru_push(struct vfs_node *node) {
+    node->lru_prev = NULL;
+    node->lru_next = icache_lru_head;
+    if (icache_lru_head) {
+        icache_lru_head->lru_prev = node;
+    } else {
+        icache_lru_tail = node;
+    }
+    icache_lru_head = node;
+    icache_stats.unused++;
+}
+
+/**
+ * Evict the least recently released unused node
+ * @return true if a node was evicted
+ */
+static bool icache_evict_one(void) {
+    uint64_t flags = cpu_irq_save();
+    struct vfs_node *node = icache_lru_tail;
+    if (!node) {
+        cpu_irq_restore(flags);
+        return false;
+    }
+
+    icache_lru_remove(node);
+    icache_hash_remove(node);
+    node->cached = false;
+    icache_stats.cached--;
+    icache_stats.evictions++;
+    cpu_irq_restore(flags);
+
+    /* Drop the node's file pages, then let the filesystem release its private data */
+    page_cache_evict_inode(node);
+    if (node->ops && node->ops->evict) {
+        node->ops->evict(node);
+    }
+    kfree(node);
+    return true;
+}
+
+static size_t icache_shrink_count(void) {
+    return icache_stats.unused;
+}
+
+static size_t icache_shrink_scan(size_t nr) {
+    size_t freed = 0;
+    while (freed < nr && icache_evict_one()) {
+        freed++;
+    }
+    return freed;
+}
+
+static shrinker_t icache_shrinker = {
+    .name = "icache",
+    .count = icache_shrink_count,
+    .scan = icache_shrink_scan,
+};
+
+/**
+ * Initialize the inode cache and register it with the reclaim path
+ */
+void icache_init(void) {
+    memset(icache_hash_table, 0, sizeof(icache_hash_table));
+    memset(&icache_stats, 0, sizeof(icache_stats));
+    icache_lru_head = icache_lru_tail = NULL;
+
+    shrinker_register(&icache_shrinker);
+}
+
+/**
+ * Find a cached node and take a reference to it
+ * @param sb Filesystem instance
+ * @param ino Inode number within that filesystem
+ * @return The node, or NULL if it is not cached
+ */
+struct vfs_node *vnode_lookup(void *sb, uint64_t ino) {
+    uint64_t flags = cpu_irq_save();
+    struct vfs_node *node = icache_hash_table[icache_bucket(sb, ino)];
+
+    while (node && (node->sb != sb || node->ino != ino)) {
+        node = node->hash_next;
+    }
+
+    if (!node) {
+        icache_stats.misses++;
+    } else {
+        icache_stats.hits++;
+        if (node->refcount++ == 0) {
+            icache_lru_remove(node);
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return node;
+}
+
+/**
+ * Add a freshly built node to the cache, holding one reference for the caller
+ * @param node Node, whose ops must provide evict
+ * @param sb Filesystem instance
+ * @param ino Inode number within that filesystem
+ */
+void vnode_insert(struct vfs_node *node, void *sb, uint64_t ino) {
+    node->sb = sb;
+    node->ino = ino;
+    node->refcount = 1;
+    node->cached = true;
+    node->lru_prev = node->lru_next = NULL;
+
+    uint64_t flags = cpu_irq_save();
+    uint32_t bucket = icache_bucket(sb, ino);
+    node->hash_next = icache_hash_table[bucket];
+    icache_hash_table[bucket] = node;
+    icache_stats.cached++;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Take a reference to a node
+ * @param node Node (may be NULL)
+ * @return The node
+ */
+struct vfs_node *vnode_get(struct vfs_node *node) {
+    if (!node) {
+        return NULL;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    if (node->refcount++ == 0 && node->cached) {
+        icache_lru_remove(node);
+    }
+    cpu_irq_restore(flags);
+    return node;
+}
+
+/**
+ * Drop a reference to a node; unused cached nodes are kept on an LRU until evicted
+ * @param node Node (may be NULL)
+ */
+void vnode_put(struct vfs_node *node) {
+    if (!node) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    if (node->refcount == 0) {
+        cpu_irq_restore(flags);
+        kerr("ICACHE: Reference count underflow on inode %lu\n", node->ino);
+        return;
+    }
+
+    bool over_limit = false;
+    if (--node->refcount == 0 && node->cached) {
+        icache_lru_push(node);
+        over_limit = icache_stats.unused > ICACHE_MAX_UNUSED;
+    }
+    cpu_irq_restore(flags);
+
+    if (over_limit) {
+        icache_evict_one();
+    }
+}
+
+/**
+ * Drop every cached node of a filesystem that is going away
+ *
+ * Unused nodes are evicted. Nodes still referenced are only taken out of
+ * the cache and lose their pages and private data, so they no longer
+ * reach the filesystem; like nodes that were never inserted, they are
+ * not freed.
+ *
+ * @param sb Filesystem instance
+ */
+void icache_evict_sb(void *sb) {
+    for (uint32_t i = 0; i < ICACHE_HASH_SIZE; i++) {
+        uint64_t flags = cpu_irq_save();
+        struct vfs_node **link = &icache_hash_table[i];
+
+        while (*link) {
+            struct vfs_node *node = *link;
+            if (node->sb != sb) {
+                link = &node->hash_next;
+                continue;
+            }
+
+            *link = node->hash_next;
+            node->hash_next = NULL;
+            bool unused = node->refcount == 0;
+            if (unused) {
+                icache_lru_remove(node);
+                icache_stats.evictions++;
+            }
+            node->cached = false;
+            icache_stats.cached--;
+            cpu_irq_restore(flags);
+
+            page_cache_evict_inode(node);
+            if (node->ops && node->ops->evict) {
+                node->ops->evict(node);
+            }
+            if (unused) {
+                kfree(node);
+            }
+
+            /* The bucket may have changed while interrupts were enabled */
+            flags = cpu_irq_save();
+            link = &icache_hash_table[i];
+        }
+
+        cpu_irq_restore(flags);
+    }
+}
+
+/**
+ * Get a snapshot of the cache statistics
+ * @param stats Structure to fill
+ */
+void icache_get_stats(icache_stats_t *stats) {
+    uint64_t flags = cpu_irq_save();
+    *stats = icache_stats;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Print cache statistics
+ */
+void icache_print_stats(void) {
+    icache_stats_t stats;
+    icache_get_stats(&stats);
+
+    kprintf("ICACHE: %u inodes (%u unused), %lu hits, %lu misses, %lu evictions\n",
+            stats.cached, stats.unused, stats.hits, stats.misses, stats.evictions);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Inode cache
+ */
+
+#ifndef _FS_ICACHE_H
+#define _FS_ICACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct vfs_node;
+
+/* Hash table size (power of two) */
+#define ICACHE_HASH_BITS    10
+#define ICACHE_HASH_SIZE    (1U << ICACHE_HASH_BITS)
+
+/* Cache statistics */
+typedef struct icache_stats {
+    uint64_t hits;                  /* Lookups that found the node cached */
+    uint64_t misses;                /* Lookups that left the filesystem to read the inode */
+    uint64_t evictions;
+    uint32_t cached;                /* Nodes in the cache */
+    uint32_t unused;                /* Cached nodes nobody holds a reference to */
+} icache_stats_t;
+
+/**
+ * Initialize the inode cache and register it with the reclaim path
+ */
+void icache_init(void);
+
+/**
+ * Find a cached node and take a reference to it
+ * @param sb Filesystem instance
+ * @param ino Inode number within that filesystem
+ * @return The node, or NULL if it is not cached
+ */
+struct vfs_node *vnode_lookup(void *sb, uint64_t ino);
+
+/**
+ * Add a freshly built node to the cache, holding one reference for the caller
+ * @param node Node, whose ops must provide evict
+ * @param sb Filesystem instance
+ * @param ino Inode number within that filesystem
+ */
+void vnode_insert(struct vfs_node *node, void *sb, uint64_t ino);
+
+/**
+ * Take a reference to a node
+ * @param node Node (may be NULL)
+ * @return The node
+ */
+struct vfs_node *vnode_get(struct vfs_node *node);
+
+/**
+ * Drop a reference to a node; unused cached nodes are kept on an LRU until evicted
+ * @param node Node (may be NULL)
+ */
+void vnode_put(struct vfs_node *node);
+
+/**
+ * Drop every cached node of a filesystem that is going away
+ * @param sb Filesystem instance
+ */
+void icache_evict_sb(void *sb);
+
+/**
+ * Get a snapshot of the cache statistics
+ * @param stats Structure to fill
+ */
+void icache_get_stats(icache_stats_t *stats);
+
+/**
+ * Print cache statistics
+ */
+void icache_print_stats(void);
+
+#endif /* _FS_ICACHE_H */
\ No newline at end of file
@@ -22,35 +22,29 @@
 #include <lib/minstd.h>
 #include <kernel/io.h>
 #include <fs/vfs.h>
+#include <fs/dcache.h>
+#include <fs/icache.h>
+#include <fs/file.h>
 #include <mm/kmalloc.h>
-
-/* Maximum number of open files */
-#define MAX_OPEN_FILES 256
+#include <mm/page_cache.h>
 
 /* Maximum number of mountpoints */
 #define MAX_MOUNTS 32
 
-/* Maximum path length */
+/* Maximum length of a mount point path */
 #define MAX_PATH_LENGTH 512
 
-/* File descriptor structure */
-typedef struct {
-    struct vfs_node *node;  /* VFS node this FD refers to */
-    uint32_t flags;         /* Open flags */
-    uint64_t position;      /* Current file position */
-    bool used;              /* Whether this FD is in use */
-} file_descriptor_t;
+/* Deepest directory nesting a path walk can step back out of with ".." */
+#define VFS_WALK_DEPTH 64
 
 /* Mount point structure */
 typedef struct {
-    char path[MAX_PATH_LENGTH];  /* Mount point path */
+    char path[MAX_PATH_LENGTH];  /* Mount point path, as given to vfs_mount */
     struct vfs_node *node;       /* Root node of mounted filesystem */
+    struct vfs_node *covered;    /* Directory the filesystem is mounted on */
     bool used;                   /* Whether this mount is in use */
 } mount_point_t;
 
-/* Global file descriptor table */
-static file_descriptor_t fd_table[MAX_OPEN_FILES];
-
 /* Global mount point table */
 static mount_point_t mount_table[MAX_MOUNTS];
 
@@ -64,171 +58,198 @@ static struct vfs_node *root_node = NULL;
 int vfs_init(void) {
     kprintf("VFS: Initializing virtual filesystem\n");
 
-    /* Clear file descriptor and mount tables */
-    memset(fd_table, 0, sizeof(fd_table));
+    /* Clear the mount table */
     memset(mount_table, 0, sizeof(mount_table));
 
+    /* Descriptors opened by the kernel itself */
+    if (files_init() < 0) {
+        kerr("VFS: Failed to create the file descriptor table\n");
+        return -1;
+    }
+
     /* Root node is initially NULL until root filesystem is mounted */
     root_node = NULL;
 
+    icache_init();
+    dcache_init();
+    page_cache_init();
+
     kprintf("VFS: Initialization complete\n");
     return 0;
 }
 
 /**
- * Normalize a path by removing unnecessary components
- * @param path The input path
- * @param normalized_path Buffer to store the normalized path
- * @return 0 on success, negative on error
+ * Look a name up in a directory, asking the filesystem only on a dentry cache miss
+ * @param dir Directory node with a finddir operation
+ * @param name Name (need not be NUL-terminated)
+ * @param len Length of the name, at most VFS_NAME_MAX
+ * @param hash Hash of the name
+ * @return The node with a reference held for the caller, or NULL if the name does not exist
  */
-static int vfs_normalize_path(const char *path, char *normalized_path) {
-    if (!path || !normalized_path) {
-        return -1;
-    }
-
-    /* Initialize normalized path buffer */
-    normalized_path[0] = '\0';
+static struct vfs_node *vfs_lookup_child(struct vfs_node *dir, const char *name, size_t len,
+                                         uint32_t hash) {
+    dentry_t *dentry = dcache_lookup(dir, name, len, hash);
+    if (dentry) {
+        return vnode_get(dentry->node);
+    }
+
+    /* Only finddir needs the name on its own */
+    char component[VFS_NAME_MAX + 1];
+    memcpy(component, name, len);
+    component[len] = '\0';
+
+    /* Misses are cached too, so a name that does not exist is looked for once */
+    struct vfs_node *node = dir->ops->finddir(dir, component);
+    dcache_add(dir, name, len, hash, node);
+    return node;
+}
 
-    /* Handle empty path */
-    if (path[0] == '\0') {
-        normalized_path[0] = '/';
-        normalized_path[1] = '\0';
-        return 0;
+/**
+ * Drop the references held by a path walk
+ * @param stack Directories walked through
+ * @param count Number of entries to release, from the bottom
+ */
+static void vfs_walk_release(struct vfs_node **stack, int count) {
+    for (int i = 0; i < count; i++) {
+        vnode_put(stack[i]);
     }
+}
 
-    /* Create a temporary copy of the path for tokenization */
-    char path_copy[MAX_PATH_LENGTH];
-    if (strlen(path) >= MAX_PATH_LENGTH) {
-        return -1; /* Path too long */
+/**
+ * Walk a path in one pass over the string
+ *
+ * Each component is hashed while it is scanned and looked up in place.
+ * "." is skipped and ".." steps back to the directory the walk came
+ * from, so neither needs the path rewritten first. Relative paths are
+ * taken from the root.
+ *
+ * @param path Path to walk
+ * @param name If not NULL, the final component is not looked up but
+ *             returned here (not NUL-terminated) and its directory is returned
+ * @param name_len Set to the length of the final component
+ * @return The node reached, with a reference held for the caller, or NULL on error
+ */
+static struct vfs_node *vfs_walk(const char *path, const char **name, size_t *name_len) {
+    if (!path || root_node == NULL) {
+        return NULL;
     }
-    strcpy(path_copy, path);
 
-    /* Tokenize the path and process each component */
-    char *token;
-    char *rest = path_copy;
-    bool absolute = (path[0] == '/');
+    /* Directories walked through, each holding a reference, so ".." can step back */
+    struct vfs_node *stack[VFS_WALK_DEPTH];
+    int depth = 0;
+    stack[0] = vnode_get(root_node);
+
+    const char *last = NULL;
 
-    /* Start with root for absolute paths */
-    if (absolute) {
-        normalized_path[0] = '/';
-        normalized_path[1] = '\0';
+    const char *p = path;
+    while (*p == '/') {
+        p++;
     }
 
-    /* Process each path component */
-    while ((token = strtok_r(rest, "/", &rest)) != NULL) {
-        /* Skip empty components and '.' */
-        if (token[0] == '\0' || (token[0] == '.' && token[1] == '\0')) {
-            continue;
+    while (*p != '\0') {
+        /* Scan and hash one component */
+        const char *component = p;
+        uint32_t hash = DCACHE_HASH_INIT;
+        while (*p != '\0' && *p != '/') {
+            hash = dcache_hash_byte(hash, *p);
+            p++;
         }
+        size_t len = (size_t)(p - component);
 
-        /* Handle '..' (go up one directory) */
-        if (token[0] == '.' && token[1] == '.' && token[2] == '\0') {
-            /* Remove last component from normalized path */
-            char *last_slash = strrchr(normalized_path, '/');
-            if (last_slash != NULL) {
-                /* Don't go above root directory */
-                if (last_slash == normalized_path) {
-                    last_slash[1] = '\0'; /* Keep root slash */
-                } else {
-                    last_slash[0] = '\0'; /* Remove slash and everything after */
-                }
-            }
-            continue;
+        while (*p == '/') {
+            p++;
         }
 
-        /* Add component to normalized path */
-        size_t current_len = strlen(normalized_path);
-        if (current_len > 0 && normalized_path[current_len - 1] != '/') {
-            if (current_len + 1 + strlen(token) >= MAX_PATH_LENGTH) {
-                return -1; /* Path too long */
+        if (len == 1 && component[0] == '.') {
+            continue;
+        }
+        if (len == 2 && component[0] == '.' && component[1] == '.') {
+            /* Never above the root */
+            if (depth > 0) {
+                vnode_put(stack[depth--]);
             }
-            strcat(normalized_path, "/");
+            continue;
         }
 
-        if (strlen(normalized_path) + strlen(token) >= MAX_PATH_LENGTH) {
-            return -1; /* Path too long */
+        if (len > VFS_NAME_MAX) {
+            vfs_walk_release(stack, depth + 1);
+            return NULL; /* Name too long */
         }
-        strcat(normalized_path, token);
-    }
 
-    /* Handle case where normalized_path is empty */
-    if (normalized_path[0] == '\0') {
-        if (absolute) {
-            normalized_path[0] = '/';
-            normalized_path[1] = '\0';
-        } else {
-            normalized_path[0] = '.';
-            normalized_path[1] = '\0';
+        /* The caller wants the final component's directory */
+        if (name && *p == '\0') {
+            last = component;
+            *name_len = len;
+            break;
         }
-    }
-
-    return 0;
-}
-
-/**
- * Find the VFS node corresponding to a path
- * @param path The path to look up
- * @return The VFS node, or NULL if not found
- */
-struct vfs_node* vfs_lookup(const char *path) {
-    if (!path || root_node == NULL) {
-        return NULL;
-    }
-
-    /* Normalize the path */
-    char normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(path, normalized_path) < 0) {
-        return NULL;
-    }
-
-    /* Handle root path */
-    if (strcmp(normalized_path, "/") == 0) {
-        return root_node;
-    }
 
-    /* Skip leading slash */
-    const char *current_path = normalized_path;
-    if (current_path[0] == '/') {
-        current_path++;
-    }
-
-    /* Start from root node */
-    struct vfs_node *current_node = root_node;
-
-    /* Tokenize the path and traverse the directory structure */
-    char path_copy[MAX_PATH_LENGTH];
-    strcpy(path_copy, current_path);
-
-    char *token;
-    char *rest = path_copy;
+        struct vfs_node *dir = stack[depth];
 
-    while ((token = strtok_r(rest, "/", &rest)) != NULL) {
-        /* Check if current node is a directory */
-        if (current_node->type != VFS_DIRECTORY) {
-            return NULL; /* Not a directory */
-        }
-
-        /* Check if node has finddir operation */
-        if (!current_node->ops || !current_node->ops->finddir) {
-            return NULL; /* Cannot traverse */
+        /* Check if current node is a directory that can be traversed */
+        if (dir->type != VFS_DIRECTORY || !dir->ops || !dir->ops->finddir ||
+            depth + 1 == VFS_WALK_DEPTH) {
+            vfs_walk_release(stack, depth + 1);
+            return NULL;
         }
 
         /* Find the next node */
-        struct vfs_node *next_node = current_node->ops->finddir(current_node, token);
+        struct vfs_node *next_node = vfs_lookup_child(dir, component, len, hash);
         if (!next_node) {
+            vfs_walk_release(stack, depth + 1);
             return NULL; /* Node not found */
         }
 
         /* Check for mount point */
         if (next_node->mount_point) {
-            next_node = next_node->mount_point;
+            struct vfs_node *mounted = vnode_get(next_node->mount_point);
+            vnode_put(next_node);
+            next_node = mounted;
         }
 
-        /* Update current node */
-        current_node = next_node;
+        stack[++depth] = next_node;
+    }
+
+    if (name) {
+        /* A path ending in "." or ".." has no final name to create or remove */
+        if (!last) {
+            vfs_walk_release(stack, depth + 1);
+            return NULL;
+        }
+        *name = last;
+    }
+
+    /* Only the node reached keeps its reference */
+    vfs_walk_release(stack, depth);
+    return stack[depth];
+}
+
+/**
+ * Find the VFS node corresponding to a path
+ * @param path The path to look up
+ * @return The VFS node, or NULL if not found; the caller releases it with vnode_put
+ */
+struct vfs_node* vfs_lookup(const char *path) {
+    return vfs_walk(path, NULL, NULL);
+}
+
+/**
+ * Find the directory holding the final component of a path
+ * @param path The path to look up
+ * @param basename Buffer of VFS_NAME_MAX + 1 bytes to store the final component in
+ * @return The directory node, or NULL if not found; the caller releases it with vnode_put
+ */
+static struct vfs_node *vfs_lookup_parent(const char *path, char *basename) {
+    const char *name;
+    size_t len;
+
+    struct vfs_node *parent = vfs_walk(path, &name, &len);
+    if (!parent) {
+        return NULL;
     }
 
-    return current_node;
+    memcpy(basename, name, len);
+    basename[len] = '\0';
+    return parent;
 }
 
 /**
@@ -253,20 +274,19 @@ int vfs_mount(const char *path, struct vfs_node *node) {
         return -1;
     }
 
-    /* Normalize the path */
-    char normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(path, normalized_path) < 0) {
+    if (strlen(path) >= MAX_PATH_LENGTH) {
         return -1;
     }
 
     /* Find mount point */
-    struct vfs_node *mount_point = vfs_lookup(normalized_path);
+    struct vfs_node *mount_point = vfs_lookup(path);
     if (!mount_point) {
         return -1; /* Mount point not found */
     }
 
     /* Mount point must be a directory */
     if (mount_point->type != VFS_DIRECTORY) {
+        vnode_put(mount_point);
         return -1;
     }
 
@@ -279,19 +299,21 @@ int vfs_mount(const char *path, struct vfs_node *node) {
     }
 
     if (i == MAX_MOUNTS) {
+        vnode_put(mount_point);
         return -1; /* No free slots */
     }
 
     /* Set up the mount entry */
-    strcpy(mount_table[i].path, normalized_path);
+    strcpy(mount_table[i].path, path);
     mount_table[i].node = node;
+    mount_table[i].covered = mount_point;
     mount_table[i].used = true;
 
-    /* Link mount point to mounted node */
+    /* Link mount point to mounted node; the mount keeps the lookup's reference */
     mount_point->mount_point = node;
     mount_point->type |= VFS_MOUNTPOINT;
 
-    kprintf("VFS: Mounted filesystem at %s\n", normalized_path);
+    kprintf("VFS: Mounted filesystem at %s\n", path);
     return 0;
 }
 
@@ -306,38 +328,35 @@ int vfs_unmount(const char *path) {
         return -1;
     }
 
-    /* Normalize the path */
-    char normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(path, normalized_path) < 0) {
+    /* Lookups cross mount points, so the path leads to the mounted root */
+    struct vfs_node *mounted = vfs_lookup(path);
+    if (!mounted) {
         return -1;
     }
 
     /* Find the mount entry */
     int i;
     for (i = 0; i < MAX_MOUNTS; i++) {
-        if (mount_table[i].used && strcmp(mount_table[i].path, normalized_path) == 0) {
+        if (mount_table[i].used && mount_table[i].node == mounted) {
             break;
         }
     }
+    vnode_put(mounted);
 
     if (i == MAX_MOUNTS) {
         return -1; /* Mount point not found */
     }
 
-    /* Find the mount point node */
-    struct vfs_node *mount_point = vfs_lookup(normalized_path);
-    if (!mount_point) {
-        return -1;
-    }
-
-    /* Unlink mount point */
+    /* Unlink mount point and drop the reference the mount held */
+    struct vfs_node *mount_point = mount_table[i].covered;
     mount_point->mount_point = NULL;
     mount_point->type &= ~VFS_MOUNTPOINT;
+    vnode_put(mount_point);
 
     /* Clear the mount entry */
     mount_table[i].used = false;
 
-    kprintf("VFS: Unmounted filesystem from %s\n", normalized_path);
+    kprintf("VFS: Unmounted filesystem from %s\n", mount_table[i].path);
     return 0;
 }
 
@@ -356,35 +375,33 @@ int vfs_open(const char *path, int flags) {
 
     /* Check if the node has an open operation */
     if (!node->ops || !node->ops->open) {
+        vnode_put(node);
         return -1; /* Cannot open */
     }
 
     /* Call the node's open operation */
     int result = node->ops->open(node, flags);
     if (result < 0) {
+        vnode_put(node);
         return result;
     }
 
-    /* Find a free file descriptor */
-    int fd;
-    for (fd = 0; fd < MAX_OPEN_FILES; fd++) {
-        if (!fd_table[fd].used) {
-            break;
-        }
-    }
-
-    if (fd == MAX_OPEN_FILES) {
+    /* Set up the open file; it keeps the lookup's reference */
+    file_t *file = file_alloc(node, flags);
+    if (!file) {
         if (node->ops->close) {
             node->ops->close(node);
         }
-        return -1; /* No free file descriptors */
+        vnode_put(node);
+        return -1;
     }
 
-    /* Set up the file descriptor */
-    fd_table[fd].node = node;
-    fd_table[fd].flags = flags;
-    fd_table[fd].position = 0;
-    fd_table[fd].used = true;
+    /* Give it the lowest free file descriptor */
+    int fd = fd_install(files_current(), file);
+    if (fd < 0) {
+        file_put(file);
+        return -1; /* No free file descriptors */
+    }
 
     return fd;
 }
@@ -392,28 +409,68 @@ int vfs_open(const char *path, int flags) {
 /**
  * Close a file descriptor
  * @param fd The file descriptor to close
- * @return 0 on success, negative on error
+ * @return 0 on success, negative on error or if buffered data of the file was lost
  */
 int vfs_close(int fd) {
-    /* Check file descriptor */
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].used) {
+    /* Free the file descriptor */
+    file_t *file = fd_remove(files_current(), fd);
+    if (!file) {
         return -1;
     }
 
-    struct vfs_node *node = fd_table[fd].node;
+    /* Report buffered data that failed to reach the disk */
+    int error = page_cache_writeback_error(file->node);
 
-    /* Call the node's close operation if available */
-    if (node->ops && node->ops->close) {
-        int result = node->ops->close(node);
-        if (result < 0) {
-            return result;
-        }
+    /* The node is closed once no other descriptor shares the open file */
+    int result = file_put(file);
+    return error < 0 ? error : result;
+}
+
+/**
+ * Duplicate a file descriptor
+ * @param fd The file descriptor to duplicate
+ * @return The lowest free file descriptor, sharing fd's open file, or negative on error
+ */
+int vfs_dup(int fd) {
+    files_t *files = files_current();
+    file_t *file = fd_get(files, fd);
+    if (!file) {
+        return -1;
     }
 
-    /* Free the file descriptor */
-    fd_table[fd].used = false;
+    int new_fd = fd_install(files, file_get(file));
+    if (new_fd < 0) {
+        file_put(file);
+    }
+    return new_fd;
+}
 
-    return 0;
+/**
+ * Duplicate a file descriptor onto a given descriptor, closing what that referred to
+ * @param fd The file descriptor to duplicate
+ * @param new_fd The file descriptor to make refer to fd's open file
+ * @return new_fd on success, negative on error
+ */
+int vfs_dup2(int fd, int new_fd) {
+    files_t *files = files_current();
+    file_t *file = fd_get(files, fd);
+    if (!file) {
+        return -1;
+    }
+    if (fd == new_fd) {
+        return new_fd;
+    }
+
+    file_t *old = fd_remove(files, new_fd);
+    if (old) {
+        file_put(old);
+    }
+
+    if (fd_install_at(files, new_fd, file_get(file)) < 0) {
+        file_put(file);
+        return -1;
+    }
+    return new_fd;
 }
 
 /**
@@ -425,22 +482,28 @@ int vfs_close(int fd) {
  */
 size_t vfs_read(int fd, void *buffer, size_t size) {
     /* Check file descriptor */
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].used) {
+    file_t *file = fd_get(files_current(), fd);
+    if (!file) {
         return -1;
     }
 
-    struct vfs_node *node = fd_table[fd].node;
+    struct vfs_node *node = file->node;
 
     /* Check if node has read operation */
     if (!node->ops || !node->ops->read) {
         return -1;
     }
 
-    /* Call the node's read operation */
-    size_t bytes_read = node->ops->read(node, fd_table[fd].position, size, buffer);
+    /* Regular files whose filesystem can fill pages are read through the page cache */
+    size_t bytes_read;
+    if (node->type == VFS_FILE && node->ops->readpages) {
+        bytes_read = page_cache_read(node, &file->ra, file->position, size, buffer);
+    } else {
+        bytes_read = node->ops->read(node, file->position, size, buffer);
+    }
 
     /* Update file position */
-    fd_table[fd].position += bytes_read;
+    file->position += bytes_read;
 
     return bytes_read;
 }
@@ -454,22 +517,44 @@ size_t vfs_read(int fd, void *buffer, size_t size) {
  */
 size_t vfs_write(int fd, const void *buffer, size_t size) {
     /* Check file descriptor */
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].used) {
+    file_t *file = fd_get(files_current(), fd);
+    if (!file) {
         return -1;
     }
 
-    struct vfs_node *node = fd_table[fd].node;
+    struct vfs_node *node = file->node;
 
     /* Check if node has write operation */
     if (!node->ops || !node->ops->write) {
         return -1;
     }
 
-    /* Call the node's write operation */
-    size_t bytes_written = node->ops->write(node, fd_table[fd].position, size, buffer);
+    /* Files opened read-only can't be written, or dirty their pages */
+    if (!(file->flags & (VFS_O_WRONLY | VFS_O_RDWR))) {
+        return -1;
+    }
+
+    size_t bytes_written;
+    if (node->type == VFS_FILE && node->ops->writepages && node->bdi) {
+        /* Earlier data that failed to reach the disk fails the next write */
+        if (page_cache_writeback_error(node) < 0) {
+            return -1;
+        }
+
+        /* Buffered: the data stays in the page cache until the flusher writes it back */
+        bytes_written = page_cache_write(node, file->position, size, buffer);
+    } else {
+        bytes_written = node->ops->write(node, file->position, size, buffer);
+        if (bytes_written > size) {
+            return bytes_written;
+        }
+
+        /* Keep cached pages in step with what was written */
+        page_cache_update(node, file->position, bytes_written, buffer);
+    }
 
     /* Update file position */
-    fd_table[fd].position += bytes_written;
+    file->position += bytes_written;
 
     return bytes_written;
 }
@@ -483,11 +568,12 @@ size_t vfs_write(int fd, const void *buffer, size_t size) {
  */
 uint64_t vfs_lseek(int fd, int64_t offset, int whence) {
     /* Check file descriptor */
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].used) {
+    file_t *file = fd_get(files_current(), fd);
+    if (!file) {
         return -1;
     }
 
-    struct vfs_node *node = fd_table[fd].node;
+    struct vfs_node *node = file->node;
     uint64_t new_position;
 
     /* Calculate new position based on whence */
@@ -496,7 +582,7 @@ uint64_t vfs_lseek(int fd, int64_t offset, int whence) {
             new_position = offset;
             break;
         case SEEK_CUR:
-            new_position = fd_table[fd].position + offset;
+            new_position = file->position + offset;
             break;
         case SEEK_END:
             new_position = node->size + offset;
@@ -506,12 +592,12 @@ uint64_t vfs_lseek(int fd, int64_t offset, int whence) {
     }
 
     /* Check bounds */
-    if (new_position > node->size && !(fd_table[fd].flags & VFS_O_WRONLY || fd_table[fd].flags & VFS_O_RDWR)) {
+    if (new_position > node->size && !(file->flags & VFS_O_WRONLY || file->flags & VFS_O_RDWR)) {
         return -1; /* Cannot seek past end in read-only mode */
     }
 
     /* Update position */
-    fd_table[fd].position = new_position;
+    file->position = new_position;
 
     return new_position;
 }
@@ -532,16 +618,20 @@ int vfs_readdir(const char *path, uint32_t index, struct vfs_dirent *dirent) {
 
     /* Check if node is a directory */
     if (node->type != VFS_DIRECTORY) {
+        vnode_put(node);
         return -1; /* Not a directory */
     }
 
     /* Check if node has readdir operation */
     if (!node->ops || !node->ops->readdir) {
+        vnode_put(node);
         return -1;
     }
 
     /* Call the node's readdir operation */
-    return node->ops->readdir(node, index, dirent);
+    int result = node->ops->readdir(node, index, dirent);
+    vnode_put(node);
+    return result;
 }
 
 /**
@@ -559,11 +649,14 @@ int vfs_stat(const char *path, struct vfs_stat *stat) {
 
     /* Check if node has stat operation */
     if (!node->ops || !node->ops->stat) {
+        vnode_put(node);
         return -1;
     }
 
     /* Call the node's stat operation */
-    return node->ops->stat(node, stat);
+    int result = node->ops->stat(node, stat);
+    vnode_put(node);
+    return result;
 }
 
 /**
@@ -574,11 +667,12 @@ int vfs_stat(const char *path, struct vfs_stat *stat) {
  */
 int vfs_fstat(int fd, struct vfs_stat *stat) {
     /* Check file descriptor */
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].used) {
+    file_t *file = fd_get(files_current(), fd);
+    if (!file) {
         return -1;
     }
 
-    struct vfs_node *node = fd_table[fd].node;
+    struct vfs_node *node = file->node;
 
     /* Check if node has stat operation */
     if (!node->ops || !node->ops->stat) {
@@ -596,49 +690,32 @@ int vfs_fstat(int fd, struct vfs_stat *stat) {
  * @return 0 on success, negative on error
  */
 int vfs_mkdir(const char *path, uint16_t mode) {
-    /* Get parent directory path and basename */
-    char parent_path[MAX_PATH_LENGTH];
+    /* Find the parent directory node and the name within it */
     char basename[VFS_NAME_MAX + 1];
-
-    /* Normalize the path */
-    char normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(path, normalized_path) < 0) {
-        return -1;
-    }
-
-    /* Extract parent path and basename */
-    char *last_slash = strrchr(normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(parent_path, ".");
-        strcpy(basename, normalized_path);
-    } else {
-        if (last_slash == normalized_path) {
-            strcpy(parent_path, "/");
-        } else {
-            strncpy(parent_path, normalized_path, last_slash - normalized_path);
-            parent_path[last_slash - normalized_path] = '\0';
-        }
-        strcpy(basename, last_slash + 1);
-    }
-
-    /* Find the parent directory node */
-    struct vfs_node *parent = vfs_lookup(parent_path);
+    struct vfs_node *parent = vfs_lookup_parent(path, basename);
     if (!parent) {
         return -1; /* Parent directory not found */
     }
 
     /* Check if parent is a directory */
     if (parent->type != VFS_DIRECTORY) {
+        vnode_put(parent);
         return -1; /* Not a directory */
     }
 
     /* Check if parent has mkdir operation */
     if (!parent->ops || !parent->ops->mkdir) {
+        vnode_put(parent);
         return -1;
     }
 
     /* Call the parent's mkdir operation */
-    return parent->ops->mkdir(parent, basename, mode);
+    int result = parent->ops->mkdir(parent, basename, mode);
+
+    /* Whatever was cached for the name no longer holds */
+    dcache_invalidate(parent, basename);
+    vnode_put(parent);
+    return result;
 }
 
 /**
@@ -647,49 +724,32 @@ int vfs_mkdir(const char *path, uint16_t mode) {
  * @return 0 on success, negative on error
  */
 int vfs_rmdir(const char *path) {
-    /* Get parent directory path and basename */
-    char parent_path[MAX_PATH_LENGTH];
+    /* Find the parent directory node and the name within it */
     char basename[VFS_NAME_MAX + 1];
-
-    /* Normalize the path */
-    char normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(path, normalized_path) < 0) {
-        return -1;
-    }
-
-    /* Extract parent path and basename */
-    char *last_slash = strrchr(normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(parent_path, ".");
-        strcpy(basename, normalized_path);
-    } else {
-        if (last_slash == normalized_path) {
-            strcpy(parent_path, "/");
-        } else {
-            strncpy(parent_path, normalized_path, last_slash - normalized_path);
-            parent_path[last_slash - normalized_path] = '\0';
-        }
-        strcpy(basename, last_slash + 1);
-    }
-
-    /* Find the parent directory node */
-    struct vfs_node *parent = vfs_lookup(parent_path);
+    struct vfs_node *parent = vfs_lookup_parent(path, basename);
     if (!parent) {
         return -1; /* Parent directory not found */
     }
 
     /* Check if parent is a directory */
     if (parent->type != VFS_DIRECTORY) {
+        vnode_put(parent);
         return -1; /* Not a directory */
     }
 
     /* Check if parent has rmdir operation */
     if (!parent->ops || !parent->ops->rmdir) {
+        vnode_put(parent);
         return -1;
     }
 
     /* Call the parent's rmdir operation */
-    return parent->ops->rmdir(parent, basename);
+    int result = parent->ops->rmdir(parent, basename);
+
+    /* Whatever was cached for the name no longer holds */
+    dcache_invalidate(parent, basename);
+    vnode_put(parent);
+    return result;
 }
 
 /**
@@ -699,49 +759,32 @@ int vfs_rmdir(const char *path) {
  * @return 0 on success, negative on error
  */
 int vfs_create(const char *path, uint16_t mode) {
-    /* Get parent directory path and basename */
-    char parent_path[MAX_PATH_LENGTH];
+    /* Find the parent directory node and the name within it */
     char basename[VFS_NAME_MAX + 1];
-
-    /* Normalize the path */
-    char normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(path, normalized_path) < 0) {
-        return -1;
-    }
-
-    /* Extract parent path and basename */
-    char *last_slash = strrchr(normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(parent_path, ".");
-        strcpy(basename, normalized_path);
-    } else {
-        if (last_slash == normalized_path) {
-            strcpy(parent_path, "/");
-        } else {
-            strncpy(parent_path, normalized_path, last_slash - normalized_path);
-            parent_path[last_slash - normalized_path] = '\0';
-        }
-        strcpy(basename, last_slash + 1);
-    }
-
-    /* Find the parent directory node */
-    struct vfs_node *parent = vfs_lookup(parent_path);
+    struct vfs_node *parent = vfs_lookup_parent(path, basename);
     if (!parent) {
         return -1; /* Parent directory not found */
     }
 
     /* Check if parent is a directory */
     if (parent->type != VFS_DIRECTORY) {
+        vnode_put(parent);
         return -1; /* Not a directory */
     }
 
     /* Check if parent has create operation */
     if (!parent->ops || !parent->ops->create) {
+        vnode_put(parent);
         return -1;
     }
 
     /* Call the parent's create operation */
-    return parent->ops->create(parent, basename, mode);
+    int result = parent->ops->create(parent, basename, mode);
+
+    /* Whatever was cached for the name no longer holds */
+    dcache_invalidate(parent, basename);
+    vnode_put(parent);
+    return result;
 }
 
 /**
@@ -750,49 +793,32 @@ int vfs_create(const char *path, uint16_t mode) {
  * @return 0 on success, negative on error
  */
 int vfs_unlink(const char *path) {
-    /* Get parent directory path and basename */
-    char parent_path[MAX_PATH_LENGTH];
+    /* Find the parent directory node and the name within it */
     char basename[VFS_NAME_MAX + 1];
-
-    /* Normalize the path */
-    char normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(path, normalized_path) < 0) {
-        return -1;
-    }
-
-    /* Extract parent path and basename */
-    char *last_slash = strrchr(normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(parent_path, ".");
-        strcpy(basename, normalized_path);
-    } else {
-        if (last_slash == normalized_path) {
-            strcpy(parent_path, "/");
-        } else {
-            strncpy(parent_path, normalized_path, last_slash - normalized_path);
-            parent_path[last_slash - normalized_path] = '\0';
-        }
-        strcpy(basename, last_slash + 1);
-    }
-
-    /* Find the parent directory node */
-    struct vfs_node *parent = vfs_lookup(parent_path);
+    struct vfs_node *parent = vfs_lookup_parent(path, basename);
     if (!parent) {
         return -1; /* Parent directory not found */
     }
 
     /* Check if parent is a directory */
     if (parent->type != VFS_DIRECTORY) {
+        vnode_put(parent);
         return -1; /* Not a directory */
     }
 
     /* Check if parent has unlink operation */
     if (!parent->ops || !parent->ops->unlink) {
+        vnode_put(parent);
         return -1;
     }
 
     /* Call the parent's unlink operation */
-    return parent->ops->unlink(parent, basename);
+    int result = parent->ops->unlink(parent, basename);
+
+    /* Whatever was cached for the name no longer holds */
+    dcache_invalidate(parent, basename);
+    vnode_put(parent);
+    return result;
 }
 
 /**
@@ -802,59 +828,21 @@ int vfs_unlink(const char *path) {
  * @return 0 on success, negative on error
  */
 int vfs_rename(const char *oldpath, const char *newpath) {
-    /* Get parent directory paths and basenames */
-    char old_parent_path[MAX_PATH_LENGTH];
+    /* Find the parent directory nodes and the names within them */
     char old_basename[VFS_NAME_MAX + 1];
-    char new_parent_path[MAX_PATH_LENGTH];
     char new_basename[VFS_NAME_MAX + 1];
-
-    /* Normalize the paths */
-    char old_normalized_path[MAX_PATH_LENGTH];
-    char new_normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(oldpath, old_normalized_path) < 0 ||
-        vfs_normalize_path(newpath, new_normalized_path) < 0) {
-        return -1;
-    }
-
-    /* Extract old parent path and basename */
-    char *last_slash = strrchr(old_normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(old_parent_path, ".");
-        strcpy(old_basename, old_normalized_path);
-    } else {
-        if (last_slash == old_normalized_path) {
-            strcpy(old_parent_path, "/");
-        } else {
-            strncpy(old_parent_path, old_normalized_path, last_slash - old_normalized_path);
-            old_parent_path[last_slash - old_normalized_path] = '\0';
-        }
-        strcpy(old_basename, last_slash + 1);
-    }
-
-    /* Extract new parent path and basename */
-    last_slash = strrchr(new_normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(new_parent_path, ".");
-        strcpy(new_basename, new_normalized_path);
-    } else {
-        if (last_slash == new_normalized_path) {
-            strcpy(new_parent_path, "/");
-        } else {
-            strncpy(new_parent_path, new_normalized_path, last_slash - new_normalized_path);
-            new_parent_path[last_slash - new_normalized_path] = '\0';
-        }
-        strcpy(new_basename, last_slash + 1);
-    }
-
-    /* Find the parent directory nodes */
-    struct vfs_node *old_parent = vfs_lookup(old_parent_path);
-    struct vfs_node *new_parent = vfs_lookup(new_parent_path);
+    struct vfs_node *old_parent = vfs_lookup_parent(oldpath, old_basename);
+    struct vfs_node *new_parent = vfs_lookup_parent(newpath, new_basename);
     if (!old_parent || !new_parent) {
+        vnode_put(new_parent);
+        vnode_put(old_parent);
         return -1; /* Parent directory not found */
     }
 
     /* Check if parents are directories */
     if (old_parent->type != VFS_DIRECTORY || new_parent->type != VFS_DIRECTORY) {
+        vnode_put(new_parent);
+        vnode_put(old_parent);
         return -1; /* Not a directory */
     }
 
@@ -862,15 +850,26 @@ int vfs_rename(const char *oldpath, const char *newpath) {
     if (old_parent == new_parent) {
         /* Check if parent has rename operation */
         if (!old_parent->ops || !old_parent->ops->rename) {
+            vnode_put(new_parent);
+            vnode_put(old_parent);
             return -1;
         }
 
         /* Call the parent's rename operation */
-        return old_parent->ops->rename(old_parent, old_basename, new_basename);
+        int result = old_parent->ops->rename(old_parent, old_basename, new_basename);
+
+        /* Whatever was cached for either name no longer holds */
+        dcache_invalidate(old_parent, old_basename);
+        dcache_invalidate(old_parent, new_basename);
+        vnode_put(new_parent);
+        vnode_put(old_parent);
+        return result;
     } else {
         /* Special case for rename across directories */
         /* This involves creating a new file and deleting the old one */
         /* Not fully implemented in this skeleton */
+        vnode_put(new_parent);
+        vnode_put(old_parent);
         return -1;
     }
 }
@@ -882,79 +881,50 @@ int vfs_rename(const char *oldpath, const char *newpath) {
  * @return 0 on success, negative on error
  */
 int vfs_link(const char *oldpath, const char *newpath) {
-    /* Get parent directory paths and basenames */
-    char old_parent_path[MAX_PATH_LENGTH];
-    char old_basename[VFS_NAME_MAX + 1];
-    char new_parent_path[MAX_PATH_LENGTH];
+    /* Get the basename for the new link */
     char new_basename[VFS_NAME_MAX + 1];
 
-    /* Normalize the paths */
-    char old_normalized_path[MAX_PATH_LENGTH];
-    char new_normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(oldpath, old_normalized_path) < 0 ||
-        vfs_normalize_path(newpath, new_normalized_path) < 0) {
-        return -1;
-    }
-
-    /* Extract old parent path and basename */
-    char *last_slash = strrchr(old_normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(old_parent_path, ".");
-        strcpy(old_basename, old_normalized_path);
-    } else {
-        if (last_slash == old_normalized_path) {
-            strcpy(old_parent_path, "/");
-        } else {
-            strncpy(old_parent_path, old_normalized_path, last_slash - old_normalized_path);
-            old_parent_path[last_slash - old_normalized_path] = '\0';
-        }
-        strcpy(old_basename, last_slash + 1);
-    }
-
-    /* Extract new parent path and basename */
-    last_slash = strrchr(new_normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(new_parent_path, ".");
-        strcpy(new_basename, new_normalized_path);
-    } else {
-        if (last_slash == new_normalized_path) {
-            strcpy(new_parent_path, "/");
-        } else {
-            strncpy(new_parent_path, new_normalized_path, last_slash - new_normalized_path);
-            new_parent_path[last_slash - new_normalized_path] = '\0';
-        }
-        strcpy(new_basename, last_slash + 1);
-    }
-
     /* Find the target file */
-    struct vfs_node *target = vfs_lookup(old_normalized_path);
+    struct vfs_node *target = vfs_lookup(oldpath);
     if (!target) {
         return -1; /* Target file not found */
     }
 
     /* Cannot link directories */
     if (target->type == VFS_DIRECTORY) {
+        vnode_put(target);
         return -1;
     }
 
     /* Find the new parent directory */
-    struct vfs_node *new_parent = vfs_lookup(new_parent_path);
+    struct vfs_node *new_parent = vfs_lookup_parent(newpath, new_basename);
     if (!new_parent) {
+        vnode_put(target);
         return -1; /* New parent directory not found */
     }
 
     /* Check if new parent is a directory */
     if (new_parent->type != VFS_DIRECTORY) {
+        vnode_put(new_parent);
+        vnode_put(target);
         return -1; /* Not a directory */
     }
 
     /* Check if new parent has link operation */
     if (!new_parent->ops || !new_parent->ops->link) {
+        vnode_put(new_parent);
+        vnode_put(target);
         return -1;
     }
 
     /* Call the new parent's link operation */
-    return new_parent->ops->link(new_parent, old_normalized_path, new_basename);
+    int result = new_parent->ops->link(new_parent, oldpath, new_basename);
+
+    /* Whatever was cached for the name no longer holds */
+    dcache_invalidate(new_parent, new_basename);
+    vnode_put(new_parent);
+    vnode_put(target);
+    return result;
 }
 
 /**
@@ -964,49 +934,32 @@ int vfs_link(const char *oldpath, const char *newpath) {
  * @return 0 on success, negative on error
  */
 int vfs_symlink(const char *target, const char *linkpath) {
-    /* Get parent directory path and basename for the new link */
-    char parent_path[MAX_PATH_LENGTH];
+    /* Find the parent directory node and the name within it */
     char basename[VFS_NAME_MAX + 1];
-
-    /* Normalize the link path */
-    char normalized_path[MAX_PATH_LENGTH];
-    if (vfs_normalize_path(linkpath, normalized_path) < 0) {
-        return -1;
-    }
-
-    /* Extract parent path and basename */
-    char *last_slash = strrchr(normalized_path, '/');
-    if (last_slash == NULL) {
-        strcpy(parent_path, ".");
-        strcpy(basename, normalized_path);
-    } else {
-        if (last_slash == normalized_path) {
-            strcpy(parent_path, "/");
-        } else {
-            strncpy(parent_path, normalized_path, last_slash - normalized_path);
-            parent_path[last_slash - normalized_path] = '\0';
-        }
-        strcpy(basename, last_slash + 1);
-    }
-
-    /* Find the parent directory node */
-    struct vfs_node *parent = vfs_lookup(parent_path);
+    struct vfs_node *parent = vfs_lookup_parent(linkpath, basename);
     if (!parent) {
         return -1; /* Parent directory not found */
     }
 
     /* Check if parent is a directory */
     if (parent->type != VFS_DIRECTORY) {
+        vnode_put(parent);
         return -1; /* Not a directory */
     }
 
     /* Check if parent has symlink operation */
     if (!parent->ops || !parent->ops->symlink) {
+        vnode_put(parent);
         return -1;
     }
 
     /* Call the parent's symlink operation */
-    return parent->ops->symlink(parent, target, basename);
+    int result = parent->ops->symlink(parent, target, basename);
+
+    /* Whatever was cached for the name no longer holds */
+    dcache_invalidate(parent, basename);
+    vnode_put(parent);
+    return result;
 }
 
 /**
@@ -1025,16 +978,20 @@ int vfs_readlink(const char *path, char *buffer, size_t size) {
 
     /* Check if node is a symlink */
     if (node->type != VFS_SYMLINK) {
+        vnode_put(node);
         return -1; /* Not a symlink */
     }
 
     /* Check if node has readlink operation */
     if (!node->ops || !node->ops->readlink) {
+        vnode_put(node);
         return -1;
     }
 
     /* Call the node's readlink operation */
-    return node->ops->readlink(node, buffer, size);
+    int result = node->ops->readlink(node, buffer, size);
+    vnode_put(node);
+    return result;
 }
 
 /**
@@ -1052,11 +1009,14 @@ int vfs_chmod(const char *path, uint16_t mode) {
 
     /* Check if node has chmod operation */
     if (!node->ops || !node->ops->chmod) {
+        vnode_put(node);
         return -1;
     }
 
     /* Call the node's chmod operation */
-    return node->ops->chmod(node, mode);
+    int result = node->ops->chmod(node, mode);
+    vnode_put(node);
+    return result;
 }
 
 /**
@@ -1075,11 +1035,14 @@ int vfs_chown(const char *path, uint32_t uid, uint32_t gid) {
 
     /* Check if node has chown operation */
     if (!node->ops || !node->ops->chown) {
+        vnode_put(node);
         return -1;
     }
 
     /* Call the node's chown operation */
-    return node->ops->chown(node, uid, gid);
+    int result = node->ops->chown(node, uid, gid);
+    vnode_put(node);
+    return result;
 }
 
 /**
@@ -1097,16 +1060,23 @@ int vfs_truncate(const char *path, uint64_t size) {
 
     /* Check if node is a regular file */
     if (node->type != VFS_FILE) {
+        vnode_put(node);
         return -1; /* Not a file */
     }
 
     /* Check if node has truncate operation */
     if (!node->ops || !node->ops->truncate) {
+        vnode_put(node);
         return -1;
     }
 
     /* Call the node's truncate operation */
-    return node->ops->truncate(node, size);
+    int result = node->ops->truncate(node, size);
+    if (result == 0) {
+        page_cache_truncate(node, size);
+    }
+    vnode_put(node);
+    return result;
 }
 
 /**
@@ -1117,11 +1087,12 @@ int vfs_truncate(const char *path, uint64_t size) {
  */
 int vfs_ftruncate(int fd, uint64_t size) {
     /* Check file descriptor */
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !fd_table[fd].used) {
+    file_t *file = fd_get(files_current(), fd);
+    if (!file) {
         return -1;
     }
 
-    struct vfs_node *node = fd_table[fd].node;
+    struct vfs_node *node = file->node;
 
     /* Check if node is a regular file */
     if (node->type != VFS_FILE) {
@@ -1134,5 +1105,9 @@ int vfs_ftruncate(int fd, uint64_t size) {
     }
 
     /* Call the node's truncate operation */
-    return node->ops->truncate(node, size);
+    int result = node->ops->truncate(node, size);
+    if (result == 0) {
+        page_cache_truncate(node, size);
+    }
+    return result;
 }
\ No newline at end of file
@@ -21,6 +21,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <lib/radix_tree.h>
 
 /* File system node types */
 #define VFS_FILE        0x01
@@ -86,6 +87,8 @@
 struct vfs_node;
 struct vfs_dirent;
 struct vfs_stat;
+struct page_io;
+struct backing_dev;
 
 /* Function pointer types for VFS operations */
 typedef int          (*vfs_open_t)(struct vfs_node*, int flags);
@@ -105,6 +108,10 @@ typedef int          (*vfs_readlink_t)(struct vfs_node*, char* buffer, size_t si
 typedef int          (*vfs_chmod_t)(struct vfs_node*, uint16_t mode);
 typedef int          (*vfs_chown_t)(struct vfs_node*, uint32_t uid, uint32_t gid);
 typedef int          (*vfs_truncate_t)(struct vfs_node*, uint64_t size);
+typedef int          (*vfs_readpages_t)(struct vfs_node*, uint64_t index, uint32_t count, void** pages,
+                                        struct page_io* io);
+typedef int          (*vfs_writepages_t)(struct vfs_node*, uint64_t index, uint32_t count, void** pages);
+typedef void         (*vfs_evict_t)(struct vfs_node*);
 
 /* VFS node operations */
 typedef struct vfs_node_ops {
@@ -126,6 +133,9 @@ typedef struct vfs_node_ops {
     vfs_chmod_t    chmod;
     vfs_chown_t    chown;
     vfs_truncate_t truncate;
+    vfs_readpages_t readpages;     /* Start filling consecutive pages of a regular file (page_io_add_bio, page_io_map) */
+    vfs_writepages_t writepages;   /* Write back consecutive dirty pages (needs readpages and a bdi) */
+    vfs_evict_t    evict;          /* Free private data when the inode cache drops the node */
 } vfs_node_ops_t;
 
 /* VFS node structure */
@@ -144,6 +154,23 @@ typedef struct vfs_node {
     void*    private_data;           /* Filesystem-specific data */
     struct vfs_node* mount_point;    /* If this is a mountpoint, points to the mounted node */
     vfs_node_ops_t*  ops;            /* Operations for this node */
+
+    /* Inode cache state (fs/icache.c) */
+    void*    sb;                     /* Filesystem instance the node belongs to */
+    uint64_t ino;                    /* Inode number within that filesystem */
+    uint32_t refcount;               /* References held by lookups, open files and dentries */
+    uint32_t cached;                 /* Whether the node is in the inode cache */
+    struct vfs_node* hash_next;      /* Next node in the hash bucket */
+    struct vfs_node* lru_prev;       /* Unused list, most recently released first */
+    struct vfs_node* lru_next;
+
+    radix_tree_t pages;              /* Cached file pages (mm/page_cache.c) */
+    struct backing_dev* bdi;         /* Where dirty pages are written back; NULL writes through */
+    uint32_t nr_dirty;               /* Dirty pages */
+    int wb_error;                    /* A write-back failed since the last report */
+    uint64_t dirtied_when;           /* When the node was queued for writeback, in ns */
+    struct vfs_node* dirty_prev;     /* Dirty list of the backing device (mm/writeback.c) */
+    struct vfs_node* dirty_next;
 } vfs_node_t;
 
 /* Directory entry structure */
@@ -176,9 +203,11 @@ int vfs_init(void);
 /* VFS core functions */
 int vfs_mount(const char* path, struct vfs_node* node);
 int vfs_unmount(const char* path);
-struct vfs_node* vfs_lookup(const char* path);
+struct vfs_node* vfs_lookup(const char* path);  /* Release the result with vnode_put */
 int vfs_open(const char* path, int flags);
 int vfs_close(int fd);
+int vfs_dup(int fd);
+int vfs_dup2(int fd, int new_fd);
 size_t vfs_read(int fd, void* buffer, size_t size);
 size_t vfs_write(int fd, const void* buffer, size_t size);
 int vfs_stat(const char* path, struct vfs_stat* stat);
@@ -0,0 +1,221 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * FUSE wire protocol, the subset spoken over virtio-fs
+ */
+
+#ifndef _FS_VIRTIOFS_FUSE_H
+#define _FS_VIRTIOFS_FUSE_H
+
+#include <stdint.h>
+
+/* Protocol version the client speaks */
+#define FUSE_KERNEL_VERSION         7
+#define FUSE_KERNEL_MINOR_VERSION   31
+
+/* Node ID of the root directory */
+#define FUSE_ROOT_ID                1
+
+/* Opcodes */
+#define FUSE_LOOKUP                 1
+#define FUSE_FORGET                 2
+#define FUSE_GETATTR                3
+#define FUSE_OPEN                   14
+#define FUSE_READ                   15
+#define FUSE_WRITE                  16
+#define FUSE_RELEASE                18
+#define FUSE_INIT                   26
+#define FUSE_OPENDIR                27
+#define FUSE_READDIR                28
+#define FUSE_RELEASEDIR             29
+#define FUSE_SETUPMAPPING           48
+#define FUSE_REMOVEMAPPING          49
+
+/* FUSE_INIT flags */
+#define FUSE_ASYNC_READ             (1U << 0)
+#define FUSE_BIG_WRITES             (1U << 5)
+#define FUSE_MAX_PAGES              (1U << 22)
+#define FUSE_MAP_ALIGNMENT          (1U << 26)
+
+/* FUSE_SETUPMAPPING flags */
+#define FUSE_SETUPMAPPING_FLAG_WRITE (1ULL << 0)
+#define FUSE_SETUPMAPPING_FLAG_READ  (1ULL << 1)
+
+/* Request header */
+typedef struct fuse_in_header {
+    uint32_t len;               /* Length of the whole request */
+    uint32_t opcode;
+    uint64_t unique;            /* Matches the reply to the request */
+    uint64_t nodeid;            /* Node the request is about */
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t pid;
+    uint16_t total_extlen;
+    uint16_t padding;
+} __attribute__((packed)) fuse_in_header_t;
+
+/* Reply header */
+typedef struct fuse_out_header {
+    uint32_t len;               /* Length of the whole reply */
+    int32_t  error;             /* Negative errno, or 0 */
+    uint64_t unique;
+} __attribute__((packed)) fuse_out_header_t;
+
+/* File attributes */
+typedef struct fuse_attr {
+    uint64_t ino;
+    uint64_t size;
+    uint64_t blocks;
+    uint64_t atime;
+    uint64_t mtime;
+    uint64_t ctime;
+    uint32_t atimensec;
+    uint32_t mtimensec;
+    uint32_t ctimensec;
+    uint32_t mode;
+    uint32_t nlink;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t rdev;
+    uint32_t blksize;
+    uint32_t flags;
+} __attribute__((packed)) fuse_attr_t;
+
+typedef struct fuse_init_in {
+    uint32_t major;
+    uint32_t minor;
+    uint32_t max_readahead;
+    uint32_t flags;
+} __attribute__((packed)) fuse_init_in_t;
+
+typedef struct fuse_init_out {
+    uint32_t major;
+    uint32_t minor;
+    uint32_t max_readahead;
+    uint32_t flags;
+    uint16_t max_background;
+    uint16_t congestion_threshold;
+    uint32_t max_write;
+    uint32_t time_gran;
+    uint16_t max_pages;
+    uint16_t map_alignment;     /* log2 of the required mapping alignment */
+    uint32_t flags2;
+    uint32_t unused[7];
+} __attribute__((packed)) fuse_init_out_t;
+
+typedef struct fuse_entry_out {
+    uint64_t nodeid;
+    uint64_t generation;
+    uint64_t entry_valid;
+    uint64_t attr_valid;
+    uint32_t entry_valid_nsec;
+    uint32_t attr_valid_nsec;
+    fuse_attr_t attr;
+} __attribute__((packed)) fuse_entry_out_t;
+
+typedef struct fuse_forget_in {
+    uint64_t nlookup;
+} __attribute__((packed)) fuse_forget_in_t;
+
+typedef struct fuse_getattr_in {
+    uint32_t getattr_flags;
+    uint32_t dummy;
+    uint64_t fh;
+} __attribute__((packed)) fuse_getattr_in_t;
+
+typedef struct fuse_attr_out {
+    uint64_t attr_valid;
+    uint32_t attr_valid_nsec;
+    uint32_t dummy;
+    fuse_attr_t attr;
+} __attribute__((packed)) fuse_attr_out_t;
+
+typedef struct fuse_open_in {
+    uint32_t flags;             /* O_* flags */
+    uint32_t open_flags;
+} __attribute__((packed)) fuse_open_in_t;
+
+typedef struct fuse_open_out {
+    uint64_t fh;
+    uint32_t open_flags;
+    uint32_t padding;
+} __attribute__((packed)) fuse_open_out_t;
+
+typedef struct fuse_release_in {
+    uint64_t fh;
+    uint32_t flags;
+    uint32_t release_flags;
+    uint64_t lock_owner;
+} __attribute__((packed)) fuse_release_in_t;
+
+/* Used for FUSE_READ and FUSE_READDIR */
+typedef struct fuse_read_in {
+    uint64_t fh;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t read_flags;
+    uint64_t lock_owner;
+    uint32_t flags;
+    uint32_t padding;
+} __attribute__((packed)) fuse_read_in_t;
+
+typedef struct fuse_write_in {
+    uint64_t fh;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t write_flags;
+    uint64_t lock_owner;
+    uint32_t flags;
+    uint32_t padding;
+} __attribute__((packed)) fuse_write_in_t;
+
+typedef struct fuse_write_out {
+    uint32_t size;
+    uint32_t padding;
+} __attribute__((packed)) fuse_write_out_t;
+
+/* FUSE_READDIR reply entry, padded to 8 bytes */
+typedef struct fuse_dirent {
+    uint64_t ino;
+    uint64_t off;               /* Offset of the next entry */
+    uint32_t namelen;
+    uint32_t type;              /* DT_* type */
+    char name[];
+} __attribute__((packed)) fuse_dirent_t;
+
+#define FUSE_DIRENT_SIZE(namelen) \
+    ((sizeof(fuse_dirent_t) + (namelen) + 7) & ~7UL)
+
+/* Map part of a file into the DAX window */
+typedef struct fuse_setupmapping_in {
+    uint64_t fh;
+    uint64_t foffset;           /* Offset in the file */
+    uint64_t len;
+    uint64_t flags;             /* FUSE_SETUPMAPPING_FLAG_* */
+    uint64_t moffset;           /* Offset in the window */
+} __attribute__((packed)) fuse_setupmapping_in_t;
+
+typedef struct fuse_removemapping_in {
+    uint32_t count;             /* Number of fuse_removemapping_one_t that follow */
+} __attribute__((packed)) fuse_removemapping_in_t;
+
+typedef struct fuse_removemapping_one {
+    uint64_t moffset;
+    uint64_t len;
+} __attribute__((packed)) fuse_removemapping_one_t;
+
+#endif /* _FS_VIRTIOFS_FUSE_H */
\ No newline at end of file
@@ -0,0 +1,810 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Virtio-fs host shared directory client
+ *
+ * Files shared by virtiofsd are reached with FUSE requests carried over a
+ * virtio queue, so a host directory can be the root filesystem without an
+ * image being built. When the device has a DAX window, regular file reads
+ * map VIRTIOFS_DAX_CHUNK pieces of the file into it with
+ * FUSE_SETUPMAPPING and copy straight out of the host page cache; the
+ * least recently used chunk is remapped when the window is full. Other
+ * reads and all writes go through a payload buffer in FUSE_READ and
+ * FUSE_WRITE requests. Requests are synchronous and completions are polled.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/config.h>
+#include <drivers/driversys.h>
+#include <drivers/pci/pci.h>
+#include <drivers/virtio/virtio.h>
+#include <fs/vfs.h>
+#include <fs/icache.h>
+#include <fs/virtiofs/fuse.h>
+#include <fs/virtiofs/virtiofs.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/* Upper bound on descriptors per virtqueue */
+#define VIRTIOFS_QUEUE_SIZE     64
+
+/* A request not answered within this time marks the device dead */
+#define VIRTIOFS_TIMEOUT_NS     (5ULL * 1000000000ULL)
+
+/* Forward declarations */
+static int virtiofs_open(struct vfs_node *node, int flags);
+static int virtiofs_close(struct vfs_node *node);
+static size_t virtiofs_read(struct vfs_node *node, uint64_t offset, size_t size, void *buffer);
+static size_t virtiofs_write(struct vfs_node *node, uint64_t offset, size_t size, const void *buffer);
+static int virtiofs_readdir(struct vfs_node *node, uint32_t index, struct vfs_dirent *dirent);
+static struct vfs_node* virtiofs_finddir(struct vfs_node *node, const char *name);
+static int virtiofs_stat(struct vfs_node *node, struct vfs_stat *stat);
+static void virtiofs_evict(struct vfs_node *node);
+
+/* Filesystem operations structure */
+static vfs_node_ops_t virtiofs_ops = {
+    .open = virtiofs_open,
+    .close = virtiofs_close,
+    .read = virtiofs_read,
+    .write = virtiofs_write,
+    .readdir = virtiofs_readdir,
+    .finddir = virtiofs_finddir,
+    .stat = virtiofs_stat,
+    .evict = virtiofs_evict
+};
+
+/* Driver hooks */
+static int virtiofs_probe_driver(device_driver_t *driver);
+static int virtiofs_remove_driver(device_driver_t *driver);
+
+/* Define the virtio-fs driver */
+static driver_ops_t virtiofs_driver_ops = {
+    .probe = virtiofs_probe_driver,
+    .remove = virtiofs_remove_driver,
+    .suspend = NULL,
+    .resume = NULL
+};
+
+static device_driver_t virtiofs_driver = {
+    .name = "virtiofs",
+    .device_class = DEVICE_CLASS_STORAGE,
+    .state = DRIVER_STATE_UNLOADED,
+    .ops = &virtiofs_driver_ops,
+    .private_data = NULL
+};
+
+/* Share found at boot; only the first one is used */
+static virtiofs_t *virtiofs_share = NULL;
+
+/**
+ * Send a request and wait for its reply
+ *
+ * Fixed arguments travel in the header pages; a payload, written by the
+ * caller before the call or by the device during it, lives in fs->data.
+ * @param fs Share
+ * @param opcode FUSE opcode
+ * @param nodeid Node the request is about
+ * @param in Fixed input arguments
+ * @param in_len Length of in
+ * @param in_data_len Length of the payload in fs->data sent to the device
+ * @param out Buffer for fixed output arguments
+ * @param out_len Length of out
+ * @param out_data_len Room in fs->data for a payload from the device
+ * @param data_len Output for the payload length received (may be NULL)
+ * @return 0 on success, negative errno from the server or -1 on failure
+ */
+static int virtiofs_call(virtiofs_t *fs, uint32_t opcode, uint64_t nodeid,
+                         const void *in, uint32_t in_len, uint32_t in_data_len,
+                         void *out, uint32_t out_len, uint32_t out_data_len,
+                         uint32_t *data_len) {
+    fuse_in_header_t *ih = (fuse_in_header_t *)fs->in_buf;
+    fuse_out_header_t *oh = (fuse_out_header_t *)fs->out_buf;
+    virtio_sg_t sg[4];
+    uint16_t count = 0;
+
+    if (fs->dead || in_len > PAGE_SIZE - sizeof(*ih) || out_len > PAGE_SIZE - sizeof(*oh)) {
+        return -1;
+    }
+
+    uint64_t flags = cpu_irq_save();
+
+    memset(ih, 0, sizeof(*ih));
+    ih->len = sizeof(*ih) + in_len + in_data_len;
+    ih->opcode = opcode;
+    ih->unique = ++fs->unique;
+    ih->nodeid = nodeid;
+    if (in_len) {
+        memcpy(ih + 1, in, in_len);
+    }
+    memset(oh, 0, sizeof(*oh));
+
+    sg[count++] = (virtio_sg_t){ fs->in_phys, sizeof(*ih) + in_len, false };
+    if (in_data_len) {
+        sg[count++] = (virtio_sg_t){ fs->data_phys, in_data_len, false };
+    }
+    sg[count++] = (virtio_sg_t){ fs->out_phys, sizeof(*oh) + out_len, true };
+    if (out_data_len) {
+        sg[count++] = (virtio_sg_t){ fs->data_phys, out_data_len, true };
+    }
+
+    if (virtqueue_add(fs->request, sg, count, fs) < 0) {
+        cpu_irq_restore(flags);
+        return -1;
+    }
+    virtqueue_kick(fs->request);
+    fs->requests++;
+
+    uint32_t len = 0;
+    uint64_t deadline = time_now_ns() + VIRTIOFS_TIMEOUT_NS;
+    while (!virtqueue_get_buf(fs->request, &len)) {
+        if (time_now_ns() >= deadline) {
+            /* The buffers stay with the device, so nothing may reuse them */
+            fs->dead = true;
+            cpu_irq_restore(flags);
+            kerr("VIRTIO-FS: Request %u timed out, giving up on the device\n", opcode);
+            return -1;
+        }
+        cpu_relax();
+    }
+    cpu_irq_restore(flags);
+
+    if (len < sizeof(*oh) || oh->unique != ih->unique) {
+        return -1;
+    }
+    if (oh->error) {
+        return oh->error;
+    }
+
+    if (out_len) {
+        memcpy(out, oh + 1, out_len);
+    }
+    if (data_len) {
+        *data_len = len > sizeof(*oh) + out_len ? len - sizeof(*oh) - out_len : 0;
+    }
+    return 0;
+}
+
+/**
+ * Convert a file mode to a VFS node type
+ */
+static uint32_t virtiofs_vfs_type(uint32_t mode) {
+    if (S_ISDIR(mode)) {
+        return VFS_DIRECTORY;
+    } else if (S_ISLNK(mode)) {
+        return VFS_SYMLINK;
+    } else if (S_ISCHR(mode)) {
+        return VFS_CHARDEVICE;
+    } else if (S_ISBLK(mode)) {
+        return VFS_BLOCKDEVICE;
+    } else if (S_ISFIFO(mode)) {
+        return VFS_PIPE;
+    } else if (S_ISSOCK(mode)) {
+        return VFS_SOCKET;
+    }
+    return VFS_FILE;
+}
+
+/**
+ * Copy server attributes into a VFS node
+ */
+static void virtiofs_set_attr(struct vfs_node *node, const fuse_attr_t *attr) {
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+
+    info->attr = *attr;
+    node->type = virtiofs_vfs_type(attr->mode) | (node->type & VFS_MOUNTPOINT);
+    node->permissions = attr->mode & 07777;
+    node->uid = attr->uid;
+    node->gid = attr->gid;
+    node->size = attr->size;
+    node->inode = (uint32_t)attr->ino;
+    node->links = attr->nlink;
+    node->atime = (uint32_t)attr->atime;
+    node->mtime = (uint32_t)attr->mtime;
+    node->ctime = (uint32_t)attr->ctime;
+}
+
+/**
+ * Create a VFS node for a server node
+ * @return The node, or NULL on failure
+ */
+static struct vfs_node *virtiofs_create_vfs_node(virtiofs_t *fs, uint64_t nodeid,
+                                                 const fuse_attr_t *attr, const char *name) {
+    struct vfs_node *node = (struct vfs_node *)kzalloc(sizeof(struct vfs_node));
+    virtiofs_inode_t *info = (virtiofs_inode_t *)kzalloc(sizeof(virtiofs_inode_t));
+    if (!node || !info) {
+        kfree(node);
+        kfree(info);
+        return NULL;
+    }
+
+    info->fs = fs;
+    info->nodeid = nodeid;
+    strncpy(node->name, name, VFS_NAME_MAX);
+    node->private_data = info;
+    node->ops = &virtiofs_ops;
+    virtiofs_set_attr(node, attr);
+    return node;
+}
+
+/**
+ * Refresh a node's attributes from the server
+ */
+static int virtiofs_getattr(struct vfs_node *node) {
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+    fuse_getattr_in_t in = { 0 };
+    fuse_attr_out_t out;
+
+    int result = virtiofs_call(info->fs, FUSE_GETATTR, info->nodeid, &in, sizeof(in), 0,
+                               &out, sizeof(out), 0, NULL);
+    if (result < 0) {
+        return result;
+    }
+    virtiofs_set_attr(node, &out.attr);
+    return 0;
+}
+
+/**
+ * VFS open function
+ */
+static int virtiofs_open(struct vfs_node *node, int flags) {
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+    uint32_t access = flags & (VFS_O_WRONLY | VFS_O_RDWR);
+
+    if (info->open) {
+        /* A read-only handle is reopened when writing is asked for */
+        if (access == VFS_O_RDONLY || info->open_flags == VFS_O_RDWR || info->open_flags == access) {
+            return 0;
+        }
+        virtiofs_close(node);
+        access = VFS_O_RDWR;
+    }
+
+    bool dir = (node->type & ~VFS_MOUNTPOINT) == VFS_DIRECTORY;
+    fuse_open_in_t in = { .flags = dir ? VFS_O_RDONLY : access, .open_flags = 0 };
+    fuse_open_out_t out;
+
+    int result = virtiofs_call(info->fs, dir ? FUSE_OPENDIR : FUSE_OPEN, info->nodeid,
+                               &in, sizeof(in), 0, &out, sizeof(out), 0, NULL);
+    if (result < 0) {
+        return result;
+    }
+
+    info->fh = out.fh;
+    info->open = true;
+    info->open_flags = in.flags;
+    info->dir_index = 0;
+    info->dir_offset = 0;
+
+    /* DAX reads stop at the size seen here */
+    return dir ? 0 : virtiofs_getattr(node);
+}
+
+/**
+ * VFS close function
+ */
+static int virtiofs_close(struct vfs_node *node) {
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+    if (!info->open) {
+        return 0;
+    }
+
+    bool dir = (node->type & ~VFS_MOUNTPOINT) == VFS_DIRECTORY;
+    fuse_release_in_t in = { .fh = info->fh, .flags = info->open_flags };
+
+    info->open = false;
+    return virtiofs_call(info->fs, dir ? FUSE_RELEASEDIR : FUSE_RELEASE, info->nodeid,
+                         &in, sizeof(in), 0, NULL, 0, 0, NULL);
+}
+
+/**
+ * Find the window chunk mapping a file piece, mapping it if needed
+ * @param fs Share
+ * @param info Open regular file
+ * @param foffset Chunk-aligned file offset
+ * @return Chunk index, or negative on failure
+ */
+static int virtiofs_dax_chunk(virtiofs_t *fs, virtiofs_inode_t *info, uint64_t foffset) {
+    uint32_t victim = 0;
+
+    for (uint32_t i = 0; i < fs->nr_chunks; i++) {
+        virtiofs_dax_chunk_t *chunk = &fs->chunks[i];
+        if (chunk->nodeid == info->nodeid && chunk->foffset == foffset) {
+            chunk->last_used = ++fs->dax_clock;
+            return (int)i;
+        }
+        if (chunk->last_used < fs->chunks[victim].last_used) {
+            victim = i;
+        }
+    }
+
+    /* Mapping over a chunk replaces what it held, so eviction needs no REMOVEMAPPING */
+    virtiofs_dax_chunk_t *chunk = &fs->chunks[victim];
+    fuse_setupmapping_in_t in = {
+        .fh = info->fh,
+        .foffset = foffset,
+        .len = VIRTIOFS_DAX_CHUNK,
+        .flags = FUSE_SETUPMAPPING_FLAG_READ,
+        .moffset = (uint64_t)victim * VIRTIOFS_DAX_CHUNK
+    };
+
+    chunk->nodeid = 0;
+    if (virtiofs_call(fs, FUSE_SETUPMAPPING, info->nodeid, &in, sizeof(in), 0, NULL, 0, 0, NULL) < 0) {
+        return -1;
+    }
+    fs->dax_mappings++;
+
+    if (!chunk->mapped) {
+        if (!vmm_map_cached(fs->dax_phys + in.moffset, VIRTIOFS_DAX_CHUNK)) {
+            return -1;
+        }
+        chunk->mapped = true;
+    }
+
+    chunk->nodeid = info->nodeid;
+    chunk->foffset = foffset;
+    chunk->last_used = ++fs->dax_clock;
+    return (int)victim;
+}
+
+/**
+ * Read an open regular file through the DAX window
+ * @return Bytes read; fewer than asked if the window could not map the rest
+ */
+static size_t virtiofs_dax_read(virtiofs_t *fs, virtiofs_inode_t *info, uint64_t offset,
+                                size_t size, uint8_t *buffer) {
+    size_t done = 0;
+
+    while (done < size) {
+        uint64_t pos = offset + done;
+        uint64_t foffset = pos & ~(VIRTIOFS_DAX_CHUNK - 1);
+        int index = virtiofs_dax_chunk(fs, info, foffset);
+        if (index < 0) {
+            break;
+        }
+
+        uint64_t in_chunk = pos - foffset;
+        size_t len = size - done;
+        if (len > VIRTIOFS_DAX_CHUNK - in_chunk) {
+            len = VIRTIOFS_DAX_CHUNK - in_chunk;
+        }
+
+        memcpy(buffer + done, fs->dax + (uint64_t)index * VIRTIOFS_DAX_CHUNK + in_chunk, len);
+        done += len;
+    }
+
+    fs->dax_bytes += done;
+    return done;
+}
+
+/**
+ * VFS read function
+ */
+static size_t virtiofs_read(struct vfs_node *node, uint64_t offset, size_t size, void *buffer) {
+    if (!node || !buffer || !node->private_data) {
+        return 0;
+    }
+
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+    virtiofs_t *fs = info->fs;
+    uint8_t *dst = (uint8_t *)buffer;
+    size_t done = 0;
+
+    if (!info->open && virtiofs_open(node, VFS_O_RDONLY) < 0) {
+        return 0;
+    }
+
+    if (fs->nr_chunks && node->type == VFS_FILE) {
+        /* Mapped pages past the end of the file would fault on the host */
+        if (offset >= info->attr.size) {
+            return 0;
+        }
+        if (size > info->attr.size - offset) {
+            size = info->attr.size - offset;
+        }
+        done = virtiofs_dax_read(fs, info, offset, size, dst);
+    }
+
+    while (done < size) {
+        size_t chunk = size - done;
+        if (chunk > fs->max_read) {
+            chunk = fs->max_read;
+        }
+
+        fuse_read_in_t in = { .fh = info->fh, .offset = offset + done, .size = (uint32_t)chunk };
+        uint32_t got = 0;
+        if (virtiofs_call(fs, FUSE_READ, info->nodeid, &in, sizeof(in), 0,
+                          NULL, 0, (uint32_t)chunk, &got) < 0) {
+            break;
+        }
+        if (got > chunk) {
+            got = (uint32_t)chunk;
+        }
+
+        memcpy(dst + done, fs->data, got);
+        fs->read_bytes += got;
+        done += got;
+        if (got < chunk) {
+            break;
+        }
+    }
+
+    return done;
+}
+
+/**
+ * VFS write function
+ */
+static size_t virtiofs_write(struct vfs_node *node, uint64_t offset, size_t size, const void *buffer) {
+    if (!node || !buffer || !node->private_data) {
+        return 0;
+    }
+
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+    virtiofs_t *fs = info->fs;
+    const uint8_t *src = (const uint8_t *)buffer;
+    size_t done = 0;
+
+    if (virtiofs_open(node, VFS_O_RDWR) < 0) {
+        return 0;
+    }
+
+    while (done < size) {
+        size_t chunk = size - done;
+        if (chunk > fs->max_write) {
+            chunk = fs->max_write;
+        }
+
+        memcpy(fs->data, src + done, chunk);
+        fuse_write_in_t in = { .fh = info->fh, .offset = offset + done, .size = (uint32_t)chunk };
+        fuse_write_out_t out;
+        if (virtiofs_call(fs, FUSE_WRITE, info->nodeid, &in, sizeof(in), (uint32_t)chunk,
+                          &out, sizeof(out), 0, NULL) < 0 || out.size == 0) {
+            break;
+        }
+
+        done += out.size;
+        if (out.size < chunk) {
+            break;
+        }
+    }
+
+    if (offset + done > info->attr.size) {
+        info->attr.size = offset + done;
+        node->size = info->attr.size;
+    }
+    return done;
+}
+
+/**
+ * VFS readdir function
+ */
+static int virtiofs_readdir(struct vfs_node *node, uint32_t index, struct vfs_dirent *dirent) {
+    if (!node || !dirent || !node->private_data || (node->type & ~VFS_MOUNTPOINT) != VFS_DIRECTORY) {
+        return -1;
+    }
+
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+    virtiofs_t *fs = info->fs;
+
+    if (!info->open && virtiofs_open(node, VFS_O_RDONLY) < 0) {
+        return -1;
+    }
+
+    /* Continue from the last position when scanning forward, else restart */
+    if (index < info->dir_index) {
+        info->dir_index = 0;
+        info->dir_offset = 0;
+    }
+
+    for (;;) {
+        fuse_read_in_t in = { .fh = info->fh, .offset = info->dir_offset, .size = PAGE_SIZE };
+        uint32_t got = 0;
+        if (virtiofs_call(fs, FUSE_READDIR, info->nodeid, &in, sizeof(in), 0,
+                          NULL, 0, PAGE_SIZE, &got) < 0 || got == 0) {
+            return -1;
+        }
+
+        for (uint32_t pos = 0; pos + sizeof(fuse_dirent_t) <= got; ) {
+            fuse_dirent_t *entry = (fuse_dirent_t *)(fs->data + pos);
+            uint32_t entry_size = FUSE_DIRENT_SIZE(entry->namelen);
+            if (entry->namelen == 0 || pos + entry_size > got) {
+                break;
+            }
+
+            if (info->dir_index == index) {
+                uint32_t name_len = entry->namelen > VFS_NAME_MAX ? VFS_NAME_MAX : entry->namelen;
+                memcpy(dirent->name, entry->name, name_len);
+                dirent->name[name_len] = '\0';
+                dirent->inode = (uint32_t)entry->ino;
+                dirent->type = (uint8_t)virtiofs_vfs_type(entry->type << 12);
+                return 0;
+            }
+
+            info->dir_index++;
+            info->dir_offset = entry->off;
+            pos += entry_size;
+        }
+    }
+}
+
+/**
+ * VFS finddir function
+ */
+static struct vfs_node* virtiofs_finddir(struct vfs_node *node, const char *name) {
+    if (!node || !name || !node->private_data || (node->type & ~VFS_MOUNTPOINT) != VFS_DIRECTORY) {
+        return NULL;
+    }
+
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+    size_t len = strlen(name);
+    if (len > VFS_NAME_MAX) {
+        return NULL;
+    }
+
+    fuse_entry_out_t out;
+    if (virtiofs_call(info->fs, FUSE_LOOKUP, info->nodeid, name, (uint32_t)len + 1, 0,
+                      &out, sizeof(out), 0, NULL) < 0 || out.nodeid == 0) {
+        return NULL;
+    }
+
+    /* Share the node if it is already cached, taking the fresher attributes */
+    struct vfs_node *found_node = vnode_lookup(info->fs, out.nodeid);
+    if (found_node) {
+        virtiofs_set_attr(found_node, &out.attr);
+        return found_node;
+    }
+
+    found_node = virtiofs_create_vfs_node(info->fs, out.nodeid, &out.attr, name);
+    if (found_node) {
+        vnode_insert(found_node, info->fs, out.nodeid);
+    }
+    return found_node;
+}
+
+/**
+ * VFS evict function, called when the inode cache frees a node
+ *
+ * No FUSE_FORGET is sent: it has no reply, and the server drops its
+ * lookup counts when the session ends.
+ */
+static void virtiofs_evict(struct vfs_node *node) {
+    kfree(node->private_data);
+    node->private_data = NULL;
+}
+
+/**
+ * VFS stat function
+ */
+static int virtiofs_stat(struct vfs_node *node, struct vfs_stat *stat) {
+    if (!node || !stat || !node->private_data) {
+        return -1;
+    }
+
+    int result = virtiofs_getattr(node);
+    if (result < 0) {
+        return result;
+    }
+
+    virtiofs_inode_t *info = (virtiofs_inode_t *)node->private_data;
+    fuse_attr_t *attr = &info->attr;
+
+    stat->st_dev = 0;
+    stat->st_ino = (uint32_t)attr->ino;
+    stat->st_mode = (uint16_t)attr->mode;
+    stat->st_nlink = (uint16_t)attr->nlink;
+    stat->st_uid = attr->uid;
+    stat->st_gid = attr->gid;
+    stat->st_rdev = attr->rdev;
+    stat->st_size = attr->size;
+    stat->st_blksize = attr->blksize;
+    stat->st_blocks = attr->blocks;
+    stat->st_atime = (uint32_t)attr->atime;
+    stat->st_mtime = (uint32_t)attr->mtime;
+    stat->st_ctime = (uint32_t)attr->ctime;
+
+    return 0;
+}
+
+/**
+ * Start a FUSE session and size the DAX window
+ */
+static int virtiofs_init_session(virtiofs_t *fs) {
+    uint64_t shm_phys = 0, shm_len = 0;
+    bool has_window = virtio_get_shm_region(&fs->vdev, VIRTIOFS_SHM_CACHE, &shm_phys, &shm_len) == 0 &&
+                      shm_len >= VIRTIOFS_DAX_CHUNK;
+
+    fuse_init_in_t in = {
+        .major = FUSE_KERNEL_VERSION,
+        .minor = FUSE_KERNEL_MINOR_VERSION,
+        .max_readahead = VIRTIOFS_MAX_PAGES * PAGE_SIZE,
+        .flags = FUSE_BIG_WRITES | FUSE_MAX_PAGES | (has_window ? FUSE_MAP_ALIGNMENT : 0)
+    };
+    fuse_init_out_t out;
+    memset(&out, 0, sizeof(out));
+
+    int result = virtiofs_call(fs, FUSE_INIT, 0, &in, sizeof(in), 0, &out, sizeof(out), 0, NULL);
+    if (result < 0 || out.major != FUSE_KERNEL_VERSION) {
+        kerr("VIRTIO-FS: FUSE_INIT failed (%d)\n", result);
+        return -1;
+    }
+
+    fs->max_read = VIRTIOFS_MAX_PAGES * PAGE_SIZE;
+    fs->max_write = out.max_write;
+    if (fs->max_write == 0 || fs->max_write > fs->max_read) {
+        fs->max_write = fs->max_read;
+    }
+
+    /* Chunks must be aligned as strictly as the server maps */
+    if (has_window && (out.flags & FUSE_MAP_ALIGNMENT) &&
+        out.map_alignment < 64 && (1ULL << out.map_alignment) <= VIRTIOFS_DAX_CHUNK) {
+        fs->dax_phys = shm_phys;
+        fs->dax_len = shm_len;
+        fs->dax = (uint8_t *)phys_to_virt(shm_phys);
+        fs->nr_chunks = shm_len / VIRTIOFS_DAX_CHUNK > VIRTIOFS_DAX_MAX_CHUNKS ?
+                        VIRTIOFS_DAX_MAX_CHUNKS : (uint32_t)(shm_len / VIRTIOFS_DAX_CHUNK);
+        fs->chunks = (virtiofs_dax_chunk_t *)kzalloc(fs->nr_chunks * sizeof(virtiofs_dax_chunk_t));
+        if (!fs->chunks) {
+            fs->nr_chunks = 0;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Bring up one virtio-fs PCI function
+ */
+static int virtiofs_attach(pci_device_t *pci) {
+    virtiofs_t *fs = (virtiofs_t *)kzalloc(sizeof(virtiofs_t));
+    if (!fs) {
+        return -1;
+    }
+
+    if (virtio_pci_init(&fs->vdev, pci) < 0) {
+        kfree(fs);
+        return -1;
+    }
+
+    uint64_t wanted = (1ULL << VIRTIO_F_RING_INDIRECT_DESC) |
+                      (1ULL << VIRTIO_F_RING_EVENT_IDX);
+    if (!fs->vdev.device_cfg || virtio_negotiate_features(&fs->vdev, wanted) < 0) {
+        virtio_fail(&fs->vdev);
+        kfree(fs);
+        return -1;
+    }
+
+    volatile virtiofs_config_t *cfg = (volatile virtiofs_config_t *)fs->vdev.device_cfg;
+    for (int i = 0; i < 36 && cfg->tag[i]; i++) {
+        fs->tag[i] = cfg->tag[i];
+    }
+
+    fs->request = virtio_setup_queue(&fs->vdev, VIRTIOFS_REQUEST_QUEUE, VIRTIOFS_QUEUE_SIZE);
+    fs->in_buf = (uint8_t *)pmm_alloc_dma(1, &fs->in_phys);
+    fs->out_buf = (uint8_t *)pmm_alloc_dma(1, &fs->out_phys);
+    fs->data = (uint8_t *)pmm_alloc_dma(VIRTIOFS_MAX_PAGES, &fs->data_phys);
+    if (!fs->request || !fs->in_buf || !fs->out_buf || !fs->data) {
+        virtio_fail(&fs->vdev);
+        kfree(fs);
+        return -1;
+    }
+    virtqueue_disable_cb(fs->request);
+
+    virtio_driver_ok(&fs->vdev);
+
+    if (virtiofs_init_session(fs) < 0) {
+        virtio_fail(&fs->vdev);
+        kfree(fs);
+        return -1;
+    }
+
+    if (fs->nr_chunks) {
+        kprintf("VIRTIO-FS: share \"%s\", DAX window %lu MiB (%u chunks in use)\n",
+                fs->tag, fs->dax_len >> 20, fs->nr_chunks);
+    } else {
+        kprintf("VIRTIO-FS: share \"%s\", no DAX window\n", fs->tag);
+    }
+
+    virtiofs_share = fs;
+    return 0;
+}
+
+/**
+ * Mount the first virtio-fs share found at boot
+ * @param root_node Pointer to store the root node
+ * @return 0 on success, negative on error
+ */
+int virtiofs_mount(struct vfs_node **root_node) {
+    virtiofs_t *fs = virtiofs_share;
+    if (!fs || !root_node) {
+        return -1;
+    }
+
+    fuse_getattr_in_t in = { 0 };
+    fuse_attr_out_t out;
+    if (virtiofs_call(fs, FUSE_GETATTR, FUSE_ROOT_ID, &in, sizeof(in), 0, &out, sizeof(out), 0, NULL) < 0) {
+        kerr("VIRTIO-FS: Failed to get root attributes\n");
+        return -1;
+    }
+
+    *root_node = virtiofs_create_vfs_node(fs, FUSE_ROOT_ID, &out.attr, "/");
+    if (!*root_node) {
+        return -1;
+    }
+
+    fs->root_node = *root_node;
+    vnode_insert(*root_node, fs, FUSE_ROOT_ID);
+    kprintf("VIRTIO-FS: Mounted share \"%s\"\n", fs->tag);
+    return 0;
+}
+
+/**
+ * Print request and DAX window statistics
+ */
+void virtiofs_print_stats(void) {
+    virtiofs_t *fs = virtiofs_share;
+    if (!fs) {
+        return;
+    }
+
+    kprintf("VIRTIO-FS: %lu requests, %lu KiB via FUSE_READ, %lu KiB via DAX, %lu mappings\n",
+            fs->requests, fs->read_bytes / 1024, fs->dax_bytes / 1024, fs->dax_mappings);
+}
+
+/**
+ * Probe function for driver registration
+ * @param driver The driver being probed
+ * @return 0 on success, negative on error
+ */
+static int virtiofs_probe_driver(device_driver_t *driver) {
+    pci_device_t *pci;
+
+    for (int index = 0; !virtiofs_share && (pci = pci_find_device(VIRTIO_PCI_VENDOR, VIRTIOFS_PCI_DEVICE, index)) != NULL; index++) {
+        if (virtiofs_attach(pci) < 0) {
+            kerr("VIRTIO-FS: Failed to attach %02x:%02x.%x\n", pci->bus, pci->slot, pci->func);
+        }
+    }
+
+    driver->private_data = virtiofs_share;
+    return 0;
+}
+
+/**
+ * Remove function for driver unregistration
+ * @param driver The driver being removed
+ * @return 0 on success, negative on error
+ */
+static int virtiofs_remove_driver(device_driver_t *driver) {
+    if (virtiofs_share) {
+        virtiofs_share->vdev.common->device_status = 0;
+        virtiofs_share = NULL;
+    }
+    return 0;
+}
+
+/**
+ * Register the virtio-fs driver
+ */
+void virtiofs_register_driver(void) {
+    device_driver_register(&virtiofs_driver);
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Virtio-fs host shared directory client
+ */
+
+#ifndef _FS_VIRTIOFS_VIRTIOFS_H
+#define _FS_VIRTIOFS_VIRTIOFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <drivers/virtio/virtio.h>
+#include <fs/vfs.h>
+#include <fs/virtiofs/fuse.h>
+
+/* PCI device ID (virtio-fs has no transitional ID) */
+#define VIRTIOFS_PCI_DEVICE         (VIRTIO_PCI_MODERN_BASE + 26)
+
+/* Shared memory region holding the DAX window */
+#define VIRTIOFS_SHM_CACHE          0
+
+/* Queue indices; request queues follow the high-priority queue */
+#define VIRTIOFS_HIPRIO_QUEUE       0
+#define VIRTIOFS_REQUEST_QUEUE      1
+
+/* Largest read or write payload carried in one request */
+#define VIRTIOFS_MAX_PAGES          32
+
+/* DAX window chunk; each chunk maps one aligned piece of one file */
+#define VIRTIOFS_DAX_CHUNK          (2ULL * 1024 * 1024)
+
+/* Upper bound on DAX chunks tracked */
+#define VIRTIOFS_DAX_MAX_CHUNKS     1024
+
+/* Device configuration layout */
+typedef struct virtiofs_config {
+    char     tag[36];           /* Name of the share, not NUL-terminated if 36 long */
+    uint32_t num_request_queues;
+    uint32_t notify_buf_size;
+} __attribute__((packed)) virtiofs_config_t;
+
+/* DAX window chunk */
+typedef struct virtiofs_dax_chunk {
+    uint64_t nodeid;            /* Mapped file, 0 if the chunk is free */
+    uint64_t foffset;           /* File offset mapped at the chunk start */
+    uint64_t last_used;         /* Access stamp for eviction */
+    bool mapped;                /* Window pages are in the kernel page tables */
+} virtiofs_dax_chunk_t;
+
+/* Mounted share */
+typedef struct virtiofs {
+    virtio_device_t vdev;
+    virtqueue_t *request;       /* First request queue; nodes are never forgotten, so the
+                                   high-priority queue is left unused */
+    bool dead;                  /* The device stopped answering */
+    char tag[37];
+
+    /* Request staging: headers and arguments, then the payload */
+    uint8_t *in_buf;
+    uint64_t in_phys;
+    uint8_t *out_buf;
+    uint64_t out_phys;
+    uint8_t *data;
+    uint64_t data_phys;
+    uint64_t unique;
+
+    uint32_t max_write;         /* Negotiated write payload limit */
+    uint32_t max_read;          /* Read payload limit */
+
+    /* DAX window, if the device has one */
+    uint64_t dax_phys;
+    uint64_t dax_len;
+    uint8_t *dax;
+    virtiofs_dax_chunk_t *chunks;
+    uint32_t nr_chunks;
+    uint64_t dax_clock;
+
+    /* Statistics */
+    uint64_t requests;          /* Requests sent */
+    uint64_t read_bytes;        /* Bytes read through FUSE_READ */
+    uint64_t dax_bytes;         /* Bytes read straight from the window */
+    uint64_t dax_mappings;      /* FUSE_SETUPMAPPING requests */
+
+    struct vfs_node *root_node;
+} virtiofs_t;
+
+/* Per-node data */
+typedef struct virtiofs_inode {
+    virtiofs_t *fs;
+    uint64_t nodeid;
+    uint64_t fh;                /* Open handle, valid if open is set */
+    bool open;
+    uint32_t open_flags;        /* Access mode the handle was opened with */
+    fuse_attr_t attr;
+
+    /* Directory position of the last readdir, so scans continue where they left off */
+    uint32_t dir_index;
+    uint64_t dir_offset;
+} virtiofs_inode_t;
+
+/**
+ * Mount the first virtio-fs share found at boot
+ * @param root_node Pointer to store the root node
+ * @return 0 on success, negative on error
+ */
+int virtiofs_mount(struct vfs_node **root_node);
+
+/**
+ * Print request and DAX window statistics
+ */
+void virtiofs_print_stats(void);
+
+/**
+ * Register the virtio-fs driver
+ */
+void virtiofs_register_driver(void);
+
+#endif /* _FS_VIRTIOFS_VIRTIOFS_H */
\ No newline at end of file
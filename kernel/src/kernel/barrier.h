@@ -0,0 +1,36 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _KERNEL_BARRIER_H
+#define _KERNEL_BARRIER_H
+
+/* Compiler-only barrier */
+#define barrier() asm volatile ("" : : : "memory")
+
+/* Memory barriers for ordering accesses shared with devices */
+#ifdef __x86_64__
+#define mb()  asm volatile ("mfence" : : : "memory")
+#define rmb() asm volatile ("lfence" : : : "memory")
+#define wmb() asm volatile ("sfence" : : : "memory")
+#else
+#define mb()  __sync_synchronize()
+#define rmb() __sync_synchronize()
+#define wmb() __sync_synchronize()
+#endif
+
+#endif /* _KERNEL_BARRIER_H */
@@ -39,4 +39,51 @@
 /* Maximum number of CPUs supported */
 #define MAX_CPUS                64
 
+/* Poll NVMe completions instead of using MSI-X interrupts */
+#define NVME_POLL_MODE          0
+
+/* Boot-time block device benchmark (queue depth 0 disables it) */
+#define BLOCK_BENCH_QUEUE_DEPTH 0
+#define BLOCK_BENCH_IO_COUNT    10000
+
+/* Benchmark trace events sent to a virtio console trace port, per device */
+#define BLOCK_BENCH_TRACE_ENTRIES 65536
+
+/* Buffers a block cache keeps before it starts reclaiming */
+#define BLOCK_CACHE_BUFFERS     1024
+
+/* Directory entries the dentry cache keeps before evicting */
+#define DCACHE_MAX_ENTRIES      4096
+
+/* Unreferenced inodes the inode cache keeps before evicting */
+#define ICACHE_MAX_UNUSED       1024
+
+/* Largest file descriptor table (a multiple of 64) */
+#define FILES_MAX_FDS           65536
+
+/* File pages the page cache keeps before reclaiming (4 KiB each) */
+#define PAGE_CACHE_MAX_PAGES    16384
+
+/* Largest read-ahead window of a sequential reader, in pages */
+#define READAHEAD_MAX_PAGES     128
+
+/* Dirty share of PAGE_CACHE_MAX_PAGES that starts background writeback, and that throttles writers (percent) */
+#define DIRTY_BACKGROUND_RATIO  10
+#define DIRTY_RATIO             20
+
+/* Age at which dirty pages are written back, and how often each flusher checks (ms) */
+#define DIRTY_EXPIRE_MS         3000
+#define DIRTY_WRITEBACK_MS      500
+
+/* Compressed RAM disk created at boot, in MiB (0 disables it) */
+#define ZRAM_BOOT_SIZE_MB       0
+
+/* Stripe every virtio disk into dm0 at boot with this chunk size in bytes
+ * (0 disables it) */
+#define DM_BOOT_STRIPE_CHUNK    0
+
+/* xHCI interrupt moderation: at most one interrupt per this many microseconds
+ * (up to 16383) */
+#define XHCI_IMOD_US            4000
+
 #endif /* _KERNEL_CONFIG_H */
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _KERNEL_CPU_H
+#define _KERNEL_CPU_H
+
+#include <stdint.h>
+#include <kernel/config.h>
+
+/*
+ * Per-CPU helpers. Application processors are not brought up yet, so the
+ * kernel runs on the bootstrap processor only. Code that keeps per-CPU
+ * state should still index it through these helpers so it scales once
+ * SMP bring-up lands.
+ */
+
+/**
+ * Get the number of CPUs the kernel is running on
+ * @return Number of online CPUs
+ */
+static inline uint32_t cpu_count(void) {
+    return 1;
+}
+
+/**
+ * Get the index of the current CPU
+ * @return CPU index in the range [0, cpu_count())
+ */
+static inline uint32_t cpu_current_id(void) {
+    return 0;
+}
+
+/**
+ * Hint to the CPU that this is a spin-wait loop
+ */
+static inline void cpu_relax(void) {
+#ifdef __x86_64__
+    asm volatile ("pause" : : : "memory");
+#endif
+}
+
+/* RFLAGS interrupt enable bit */
+#define CPU_FLAGS_IF    0x200
+
+/**
+ * Disable interrupts on the current CPU
+ * @return Previous flags, for cpu_irq_restore
+ */
+static inline uint64_t cpu_irq_save(void) {
+    uint64_t flags = 0;
+#ifdef __x86_64__
+    asm volatile ("pushfq; popq %0; cli" : "=r"(flags) : : "memory");
+#endif
+    return flags;
+}
+
+/**
+ * Restore the interrupt state saved by cpu_irq_save
+ * @param flags Value returned by cpu_irq_save
+ */
+static inline void cpu_irq_restore(uint64_t flags) {
+#ifdef __x86_64__
+    if (flags & CPU_FLAGS_IF) {
+        asm volatile ("sti" : : : "memory");
+    }
+#endif
+}
+
+/**
+ * Enable interrupts on the current CPU
+ */
+static inline void cpu_irq_enable(void) {
+#ifdef __x86_64__
+    asm volatile ("sti" : : : "memory");
+#endif
+}
+
+/**
+ * Enable interrupts and sleep until the next one arrives
+ *
+ * Call with interrupts disabled after checking the wake-up condition; the
+ * instruction pair closes the window in which the interrupt could be missed.
+ */
+static inline void cpu_wait_irq(void) {
+#ifdef __x86_64__
+    asm volatile ("sti; hlt" : : : "memory");
+#endif
+}
+
+#endif /* _KERNEL_CPU_H */
\ No newline at end of file
@@ -26,6 +26,8 @@
 #ifdef __x86_64__
 #include <arch/x86/include/serial.h>
 #endif
+#include <drivers/video/fbcon.h>
+#include <drivers/char/virtio_console.h>
 
 /* Flag indicating if I/O subsystem is initialized */
 static bool io_initialized = false;
@@ -74,6 +76,10 @@ static void kputs(const char *str) {
     for (size_t i = 0; str[i] != '\0'; i++) {
         kputchar(str[i]);
     }
+
+    /* The framebuffer console takes whole strings so it can batch drawing */
+    fbcon_write(str);
+    virtio_console_log_write(str);
 }
 
 /**
@@ -0,0 +1,149 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <kernel/io.h>
+#include <kernel/time.h>
+#include <kernel/cpu.h>
+#ifdef __x86_64__
+#include <arch/x86/include/lapic.h>
+#endif
+
+/* PIT input clock and the calibration window we measure against */
+#define PIT_FREQUENCY_HZ    1193182
+#define CALIBRATION_MS      10
+
+/* TSC ticks to nanoseconds as a 32.32 fixed-point multiplier */
+static uint64_t tsc_ns_mult = 0;
+static uint64_t tsc_hz = 0;
+
+#ifdef __x86_64__
+/* IO port functions */
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#endif
+
+/**
+ * Calibrate the kernel clock source
+ * @return 0 on success, negative on error
+ */
+int time_init(void) {
+#ifdef __x86_64__
+    uint16_t count = PIT_FREQUENCY_HZ / (1000 / CALIBRATION_MS);
+
+    /* Enable the channel 2 gate with the speaker output disabled */
+    uint8_t port61 = (inb(0x61) & ~0x02) | 0x01;
+    outb(0x61, port61);
+
+    /* Channel 2, lobyte/hibyte access, mode 0 (interrupt on terminal count) */
+    outb(0x43, 0xB0);
+    outb(0x42, count & 0xFF);
+    outb(0x42, count >> 8);
+
+    /* Restart the count by pulsing the gate */
+    outb(0x61, port61 & ~0x01);
+    outb(0x61, port61 | 0x01);
+
+    uint64_t start = rdtsc();
+    while (!(inb(0x61) & 0x20)) {
+        /* Wait for the terminal count */
+    }
+    uint64_t end = rdtsc();
+
+    tsc_hz = (end - start) * (1000 / CALIBRATION_MS);
+    if (tsc_hz == 0) {
+        kerr("TIME: TSC calibration failed\n");
+        return -1;
+    }
+
+    tsc_ns_mult = (1000000000ULL << 32) / tsc_hz;
+
+    kprintf("TIME: TSC running at %lu MHz\n", tsc_hz / 1000000);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Get a monotonic timestamp
+ * @return Nanoseconds since an arbitrary point at boot
+ */
+uint64_t time_now_ns(void) {
+#ifdef __x86_64__
+    return (uint64_t)(((unsigned __int128)rdtsc() * tsc_ns_mult) >> 32);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Busy-wait for a number of microseconds
+ * @param us Microseconds to wait
+ */
+void time_delay_us(uint32_t us) {
+    if (tsc_ns_mult == 0) {
+        /* Not calibrated yet, fall back to a rough spin */
+        for (volatile uint64_t i = 0; i < (uint64_t)us * 1000; i++);
+        return;
+    }
+
+    uint64_t deadline = time_now_ns() + (uint64_t)us * 1000;
+    while (time_now_ns() < deadline) {
+#ifdef __x86_64__
+        asm volatile ("pause");
+#endif
+    }
+}
+
+
+/**
+ * Sleep for up to a number of nanoseconds, waking early on any interrupt
+ * @param ns Nanoseconds to sleep at most
+ */
+void time_sleep_ns(uint64_t ns) {
+#ifdef __x86_64__
+    if (lapic_timer_oneshot(ns) == 0) {
+        cpu_wait_irq();
+        cpu_irq_save();
+        lapic_timer_cancel();
+        return;
+    }
+#endif
+
+    /* No timer to wake us: spin out the interval instead */
+    uint64_t deadline = time_now_ns() + ns;
+    while (time_now_ns() < deadline) {
+        cpu_relax();
+    }
+}
\ No newline at end of file
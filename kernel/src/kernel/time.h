@@ -0,0 +1,52 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _KERNEL_TIME_H
+#define _KERNEL_TIME_H
+
+#include <stdint.h>
+
+/**
+ * Calibrate the kernel clock source
+ * @return 0 on success, negative on error
+ */
+int time_init(void);
+
+/**
+ * Get a monotonic timestamp
+ * @return Nanoseconds since an arbitrary point at boot
+ */
+uint64_t time_now_ns(void);
+
+/**
+ * Busy-wait for a number of microseconds
+ * @param us Microseconds to wait
+ */
+void time_delay_us(uint32_t us);
+
+/**
+ * Sleep for up to a number of nanoseconds, waking early on any interrupt
+ *
+ * Without a scheduler, sleeping halts the CPU until a one-shot timer or a
+ * device interrupt fires. Call with interrupts disabled; they are disabled
+ * again on return.
+ * @param ns Nanoseconds to sleep at most
+ */
+void time_sleep_ns(uint64_t ns);
+
+#endif /* _KERNEL_TIME_H */
@@ -0,0 +1,66 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _KERNEL_WAIT_H
+#define _KERNEL_WAIT_H
+
+#include <stdint.h>
+#include <kernel/cpu.h>
+
+/*
+ * Wait queues. There is no scheduler yet, so a waiter cannot be parked
+ * and switched away from: sleeping halts the CPU until the next interrupt,
+ * and the wake-up only has to make the condition visible. The counter lets
+ * callers tell whether anything happened since they last looked.
+ */
+typedef struct wait_queue {
+    volatile uint64_t wakeups;  /* Bumped by every wake_up */
+} wait_queue_t;
+
+/**
+ * Initialize a wait queue
+ */
+static inline void wait_queue_init(wait_queue_t *wq) {
+    wq->wakeups = 0;
+}
+
+/**
+ * Wake everyone waiting on a queue; safe from interrupt context
+ */
+static inline void wake_up(wait_queue_t *wq) {
+    __atomic_add_fetch(&wq->wakeups, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Sleep until cond holds. The condition is re-checked with interrupts
+ * disabled before every halt, so a wake-up from an interrupt handler
+ * cannot be missed. Only events signalled from interrupt context can end
+ * the wait; polled work must use a polling wait instead.
+ */
+#define wait_event(wq, cond)                                \
+    do {                                                    \
+        (void)(wq);                                         \
+        uint64_t __wait_flags = cpu_irq_save();             \
+        while (!(cond)) {                                   \
+            cpu_wait_irq();                                 \
+            cpu_irq_save();                                 \
+        }                                                   \
+        cpu_irq_restore(__wait_flags);                      \
+    } while (0)
+
+#endif /* _KERNEL_WAIT_H */
\ No newline at end of file
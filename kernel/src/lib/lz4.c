@@ -0,0 +1,247 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * LZ4 block compression
+ *
+ * Produces and reads the standard LZ4 block format: a series of sequences,
+ * each a run of literals followed by a match of at least four bytes at an
+ * offset of up to 64 KiB back. The compressor is the greedy single-pass
+ * one: a hash of the next four bytes looks up the last position they were
+ * seen at, and a verified hit becomes a match.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <lib/minstd.h>
+#include <lib/lz4.h>
+
+/* Format limits */
+#define LZ4_MIN_MATCH       4       /* Shortest match */
+#define LZ4_LAST_LITERALS   5       /* The block ends with at least this many literals */
+#define LZ4_MF_LIMIT        12      /* The last match starts at least this far from the end */
+#define LZ4_MAX_OFFSET      65535   /* Farthest a match can reach back */
+#define LZ4_RUN_MASK        15      /* Length nibble meaning "more length bytes follow" */
+
+static inline uint32_t lz4_read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/**
+ * Write the bytes that extend a length beyond its token nibble
+ */
+static uint8_t *lz4_put_length(uint8_t *op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/**
+ * Write a run of literals and, if match_len is non-zero, the match after it
+ * @return The new output position, or NULL if the sequence does not fit
+ */
+static uint8_t *lz4_put_sequence(uint8_t *op, uint8_t *oend, const uint8_t *literals, size_t lit_len,
+                                 uint16_t offset, size_t match_len) {
+    size_t needed = 1 + lit_len + lit_len / 255 + 1;
+    if (match_len) {
+        needed += 2 + (match_len - LZ4_MIN_MATCH) / 255 + 1;
+    }
+    if (needed > (size_t)(oend - op)) {
+        return NULL;
+    }
+
+    uint8_t *token = op++;
+    *token = (uint8_t)((lit_len >= LZ4_RUN_MASK ? LZ4_RUN_MASK : lit_len) << 4);
+    if (lit_len >= LZ4_RUN_MASK) {
+        op = lz4_put_length(op, lit_len - LZ4_RUN_MASK);
+    }
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if (match_len) {
+        size_t len = match_len - LZ4_MIN_MATCH;
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        *token |= (uint8_t)(len >= LZ4_RUN_MASK ? LZ4_RUN_MASK : len);
+        if (len >= LZ4_RUN_MASK) {
+            op = lz4_put_length(op, len - LZ4_RUN_MASK);
+        }
+    }
+    return op;
+}
+
+/**
+ * Compress a buffer into an LZ4 block
+ * @param src Input
+ * @param src_len Input size in bytes
+ * @param dst Output
+ * @param dst_cap Output capacity in bytes
+ * @param work LZ4_WORK_SIZE bytes of scratch memory
+ * @return Compressed size, or 0 if the block does not fit in dst_cap
+ */
+size_t lz4_compress(const void *src, size_t src_len, void *dst, size_t dst_cap, void *work) {
+    const uint8_t *base = (const uint8_t *)src;
+    const uint8_t *iend = base + src_len;
+    const uint8_t *anchor = base;
+    uint8_t *op = (uint8_t *)dst;
+    uint8_t *oend = op + dst_cap;
+    uint32_t *table = (uint32_t *)work;
+
+    if (src_len > LZ4_MF_LIMIT) {
+        const uint8_t *mflimit = iend - LZ4_MF_LIMIT;
+        const uint8_t *matchlimit = iend - LZ4_LAST_LITERALS;
+        const uint8_t *ip = base + 1;
+
+        /* Every slot points at the start; lookups verify what they find */
+        memset(table, 0, LZ4_WORK_SIZE);
+
+        while (ip <= mflimit) {
+            uint32_t sequence = lz4_read32(ip);
+            uint32_t h = lz4_hash(sequence);
+            const uint8_t *ref = base + table[h];
+            table[h] = (uint32_t)(ip - base);
+
+            if (ip - ref > LZ4_MAX_OFFSET || lz4_read32(ref) != sequence) {
+                ip++;
+                continue;
+            }
+
+            /* Grow the match backwards over pending literals, then forwards */
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uint8_t *end = ip + LZ4_MIN_MATCH;
+            const uint8_t *ref_end = ref + LZ4_MIN_MATCH;
+            while (end < matchlimit && *end == *ref_end) {
+                end++;
+                ref_end++;
+            }
+
+            op = lz4_put_sequence(op, oend, anchor, ip - anchor, (uint16_t)(ip - ref), end - ip);
+            if (!op) {
+                return 0;
+            }
+
+            /* Remember a position inside the match to find the next one sooner */
+            if (end - 2 > ip) {
+                table[lz4_hash(lz4_read32(end - 2))] = (uint32_t)(end - 2 - base);
+            }
+            ip = anchor = end;
+        }
+    }
+
+    op = lz4_put_sequence(op, oend, anchor, iend - anchor, 0, 0);
+    if (!op) {
+        return 0;
+    }
+    return op - (uint8_t *)dst;
+}
+
+/**
+ * Read the bytes that extend a length beyond its token nibble
+ * @return The full length, or (size_t)-1 if the input ends first
+ */
+static size_t lz4_get_length(const uint8_t **ip, const uint8_t *iend, size_t len) {
+    uint8_t byte;
+    do {
+        if (*ip >= iend) {
+            return (size_t)-1;
+        }
+        byte = *(*ip)++;
+        len += byte;
+    } while (byte == 255);
+    return len;
+}
+
+/**
+ * Decompress an LZ4 block
+ * @param src Compressed block
+ * @param src_len Compressed size in bytes
+ * @param dst Output
+ * @param dst_cap Output capacity in bytes
+ * @return Decompressed size, or negative if the block is malformed or too large
+ */
+int lz4_decompress(const void *src, size_t src_len, void *dst, size_t dst_cap) {
+    const uint8_t *ip = (const uint8_t *)src;
+    const uint8_t *iend = ip + src_len;
+    uint8_t *start = (uint8_t *)dst;
+    uint8_t *op = start;
+    uint8_t *oend = op + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == LZ4_RUN_MASK) {
+            lit_len = lz4_get_length(&ip, iend, lit_len);
+        }
+        if (lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op)) {
+            return -1;
+        }
+        memcpy(op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+
+        /* The last sequence has literals only */
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - start)) {
+            return -1;
+        }
+
+        size_t match_len = token & LZ4_RUN_MASK;
+        if (match_len == LZ4_RUN_MASK) {
+            match_len = lz4_get_length(&ip, iend, match_len);
+            if (match_len == (size_t)-1) {
+                return -1;
+            }
+        }
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > (size_t)(oend - op)) {
+            return -1;
+        }
+
+        /* A match may overlap the bytes it produces, repeating a pattern */
+        const uint8_t *ref = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+            op += match_len;
+        } else {
+            for (size_t i = 0; i < match_len; i++) {
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return (int)(op - start);
+}
\ No newline at end of file
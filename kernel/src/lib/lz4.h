@@ -0,0 +1,57 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * LZ4 block compression
+ */
+
+#ifndef _LZ4_H
+#define _LZ4_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Hash table of the compressor: 2^LZ4_HASH_LOG positions */
+#define LZ4_HASH_LOG        12
+
+/* Scratch memory lz4_compress needs */
+#define LZ4_WORK_SIZE       ((1U << LZ4_HASH_LOG) * sizeof(uint32_t))
+
+/* Largest output lz4_compress can produce for an input of n bytes */
+#define LZ4_COMPRESS_BOUND(n)   ((n) + (n) / 255 + 16)
+
+/**
+ * Compress a buffer into an LZ4 block
+ * @param src Input
+ * @param src_len Input size in bytes
+ * @param dst Output
+ * @param dst_cap Output capacity in bytes
+ * @param work LZ4_WORK_SIZE bytes of scratch memory
+ * @return Compressed size, or 0 if the block does not fit in dst_cap
+ */
+size_t lz4_compress(const void *src, size_t src_len, void *dst, size_t dst_cap, void *work);
+
+/**
+ * Decompress an LZ4 block
+ * @param src Compressed block
+ * @param src_len Compressed size in bytes
+ * @param dst Output
+ * @param dst_cap Output capacity in bytes
+ * @return Decompressed size, or negative if the block is malformed or too large
+ */
+int lz4_decompress(const void *src, size_t src_len, void *dst, size_t dst_cap);
+
+#endif /* _LZ4_H */
\ No newline at end of file
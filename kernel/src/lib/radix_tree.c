@@ -0,0 +1,233 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Radix tree
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <lib/radix_tree.h>
+#include <mm/kmalloc.h>
+
+#define radix_load(p)       __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define radix_store(p, v)   __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/**
+ * Largest index a node at a given level can reach
+ */
+static inline uint64_t radix_tree_maxindex(uint32_t shift) {
+    if (shift + RADIX_TREE_MAP_SHIFT >= 64) {
+        return ~0ULL;
+    }
+    return (1ULL << (shift + RADIX_TREE_MAP_SHIFT)) - 1;
+}
+
+static radix_tree_node_t *radix_tree_node_alloc(uint32_t shift) {
+    radix_tree_node_t *node = (radix_tree_node_t *)kzalloc(sizeof(radix_tree_node_t));
+    if (node) {
+        node->shift = shift;
+    }
+    return node;
+}
+
+static void radix_tree_node_free(radix_tree_node_t *node) {
+    if (node->shift > 0) {
+        for (uint32_t i = 0; i < RADIX_TREE_MAP_SIZE; i++) {
+            if (node->slots[i]) {
+                radix_tree_node_free((radix_tree_node_t *)node->slots[i]);
+            }
+        }
+    }
+    kfree(node);
+}
+
+/**
+ * Initialize an empty tree
+ * @param tree Tree
+ */
+void radix_tree_init(radix_tree_t *tree) {
+    tree->root = NULL;
+}
+
+/**
+ * Free every node of a tree; the items are left to the caller
+ * @param tree Tree, which nobody may be reading
+ */
+void radix_tree_destroy(radix_tree_t *tree) {
+    if (tree->root) {
+        radix_tree_node_free(tree->root);
+        tree->root = NULL;
+    }
+}
+
+/**
+ * Find the item at an index
+ * @param tree Tree
+ * @param index Index
+ * @return The item, or NULL if there is none
+ */
+void *radix_tree_lookup(radix_tree_t *tree, uint64_t index) {
+    radix_tree_node_t *node = radix_load(tree->root);
+    if (!node || index > radix_tree_maxindex(node->shift)) {
+        return NULL;
+    }
+
+    for (;;) {
+        void *slot = radix_load(node->slots[(index >> node->shift) & RADIX_TREE_MAP_MASK]);
+        if (!slot || node->shift == 0) {
+            return slot;
+        }
+        node = (radix_tree_node_t *)slot;
+    }
+}
+
+/**
+ * Insert an item
+ * @param tree Tree
+ * @param index Index, which must be empty
+ * @param item Item (not NULL)
+ * @return 0 on success, negative if the index is taken or out of memory
+ */
+int radix_tree_insert(radix_tree_t *tree, uint64_t index, void *item) {
+    if (!item) {
+        return -1;
+    }
+
+    if (!tree->root) {
+        uint32_t shift = 0;
+        while (index > radix_tree_maxindex(shift)) {
+            shift += RADIX_TREE_MAP_SHIFT;
+        }
+        radix_tree_node_t *root = radix_tree_node_alloc(shift);
+        if (!root) {
+            return -1;
+        }
+        radix_store(tree->root, root);
+    }
+
+    /* Grow upwards until the root covers the index; the old root becomes slot 0 */
+    while (index > radix_tree_maxindex(tree->root->shift)) {
+        radix_tree_node_t *root = radix_tree_node_alloc(tree->root->shift + RADIX_TREE_MAP_SHIFT);
+        if (!root) {
+            return -1;
+        }
+        root->slots[0] = tree->root;
+        root->count = 1;
+        radix_store(tree->root, root);
+    }
+
+    /* Walk down, filling in missing levels */
+    radix_tree_node_t *node = tree->root;
+    while (node->shift > 0) {
+        uint32_t offset = (index >> node->shift) & RADIX_TREE_MAP_MASK;
+        radix_tree_node_t *child = (radix_tree_node_t *)node->slots[offset];
+        if (!child) {
+            child = radix_tree_node_alloc(node->shift - RADIX_TREE_MAP_SHIFT);
+            if (!child) {
+                return -1;
+            }
+            radix_store(node->slots[offset], (void *)child);
+            node->count++;
+        }
+        node = child;
+    }
+
+    uint32_t offset = index & RADIX_TREE_MAP_MASK;
+    if (node->slots[offset]) {
+        return -1; /* Index already in use */
+    }
+    radix_store(node->slots[offset], item);
+    node->count++;
+    return 0;
+}
+
+/**
+ * Remove the item at an index
+ * @param tree Tree
+ * @param index Index
+ * @return The item removed, or NULL if there was none
+ */
+void *radix_tree_delete(radix_tree_t *tree, uint64_t index) {
+    radix_tree_node_t *node = tree->root;
+    if (!node || index > radix_tree_maxindex(node->shift)) {
+        return NULL;
+    }
+
+    while (node->shift > 0) {
+        node = (radix_tree_node_t *)node->slots[(index >> node->shift) & RADIX_TREE_MAP_MASK];
+        if (!node) {
+            return NULL;
+        }
+    }
+
+    /* Emptied nodes stay until the tree is destroyed, so lookups never see one freed */
+    uint32_t offset = index & RADIX_TREE_MAP_MASK;
+    void *item = node->slots[offset];
+    if (item) {
+        radix_store(node->slots[offset], NULL);
+        node->count--;
+    }
+    return item;
+}
+
+/**
+ * Collect items from a subtree in index order
+ * @param base Index of the subtree's first slot
+ */
+static uint32_t radix_tree_gang_node(radix_tree_node_t *node, uint64_t base, void **results,
+                                     uint64_t first, uint32_t max) {
+    uint32_t found = 0;
+
+    for (uint32_t i = 0; i < RADIX_TREE_MAP_SIZE && found < max; i++) {
+        uint64_t start = base + ((uint64_t)i << node->shift);
+        uint64_t end = start + ((1ULL << node->shift) - 1);
+        if (end < first) {
+            continue;
+        }
+
+        void *slot = radix_load(node->slots[i]);
+        if (!slot) {
+            continue;
+        }
+        if (node->shift == 0) {
+            results[found++] = slot;
+        } else {
+            found += radix_tree_gang_node((radix_tree_node_t *)slot, start, results + found,
+                                         first, max - found);
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Collect items in index order
+ * @param tree Tree
+ * @param results Array to fill
+ * @param first Lowest index to return
+ * @param max Size of the results array
+ * @return Number of items stored
+ */
+uint32_t radix_tree_gang_lookup(radix_tree_t *tree, void **results, uint64_t first, uint32_t max) {
+    radix_tree_node_t *node = radix_load(tree->root);
+    if (!node || max == 0 || first > radix_tree_maxindex(node->shift)) {
+        return 0;
+    }
+    return radix_tree_gang_node(node, 0, results, first, max);
+}
\ No newline at end of file
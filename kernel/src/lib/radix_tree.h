@@ -0,0 +1,98 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Radix tree
+ */
+
+#ifndef _RADIX_TREE_H
+#define _RADIX_TREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Maps 64-bit indices to pointers through nodes of 64 slots, six index
+ * bits per level; the tree grows taller only as far as the largest index
+ * needs. Slots and the root are published with release stores and read
+ * with acquire loads, and nodes are only freed by radix_tree_destroy, so
+ * radix_tree_lookup needs no lock even while another CPU inserts or
+ * deletes. Writers must be serialized by the caller.
+ *
+ * A zeroed radix_tree_t is an empty tree.
+ */
+#define RADIX_TREE_MAP_SHIFT    6
+#define RADIX_TREE_MAP_SIZE     (1U << RADIX_TREE_MAP_SHIFT)
+#define RADIX_TREE_MAP_MASK     (RADIX_TREE_MAP_SIZE - 1)
+
+typedef struct radix_tree_node {
+    uint32_t shift;                         /* Index bits below this level */
+    uint32_t count;                         /* Slots in use */
+    void *slots[RADIX_TREE_MAP_SIZE];       /* Items at the bottom level, nodes above it */
+} radix_tree_node_t;
+
+typedef struct radix_tree {
+    radix_tree_node_t *root;
+} radix_tree_t;
+
+/**
+ * Initialize an empty tree
+ * @param tree Tree
+ */
+void radix_tree_init(radix_tree_t *tree);
+
+/**
+ * Free every node of a tree; the items are left to the caller
+ * @param tree Tree, which nobody may be reading
+ */
+void radix_tree_destroy(radix_tree_t *tree);
+
+/**
+ * Find the item at an index
+ * @param tree Tree
+ * @param index Index
+ * @return The item, or NULL if there is none
+ */
+void *radix_tree_lookup(radix_tree_t *tree, uint64_t index);
+
+/**
+ * Insert an item
+ * @param tree Tree
+ * @param index Index, which must be empty
+ * @param item Item (not NULL)
+ * @return 0 on success, negative if the index is taken or out of memory
+ */
+int radix_tree_insert(radix_tree_t *tree, uint64_t index, void *item);
+
+/**
+ * Remove the item at an index
+ * @param tree Tree
+ * @param index Index
+ * @return The item removed, or NULL if there was none
+ */
+void *radix_tree_delete(radix_tree_t *tree, uint64_t index);
+
+/**
+ * Collect items in index order
+ * @param tree Tree
+ * @param results Array to fill
+ * @param first Lowest index to return
+ * @param max Size of the results array
+ * @return Number of items stored
+ */
+uint32_t radix_tree_gang_lookup(radix_tree_t *tree, void **results, uint64_t first, uint32_t max);
+
+#endif /* _RADIX_TREE_H */
\ No newline at end of file
@@ -0,0 +1,171 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Scalable bitmap allocator
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <lib/sbitmap.h>
+#include <kernel/config.h>
+#include <kernel/cpu.h>
+#include <mm/kmalloc.h>
+
+/**
+ * Initialize a bitmap
+ * @param sb Bitmap
+ * @param depth Number of bits
+ * @return 0 on success, negative on error
+ */
+int sbitmap_init(sbitmap_t *sb, uint32_t depth) {
+    if (!sb || depth == 0) {
+        return -1;
+    }
+
+    /* Spread small maps over at least four words, never below 8 bits each */
+    uint32_t shift = 6;
+    while (shift > 3 && (depth >> shift) < 4) {
+        shift--;
+    }
+
+    sb->depth = depth;
+    sb->shift = shift;
+    sb->map_nr = (depth + (1U << shift) - 1) >> shift;
+    sb->map_alloc = kmalloc(sb->map_nr * sizeof(sbitmap_word_t) + 63);
+    sb->map = (sbitmap_word_t *)(((uintptr_t)sb->map_alloc + 63) & ~(uintptr_t)63);
+    sb->alloc_hint = (uint32_t *)kzalloc(MAX_CPUS * sizeof(uint32_t));
+    if (!sb->map_alloc || !sb->alloc_hint) {
+        sbitmap_free(sb);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < sb->map_nr; i++) {
+        uint32_t left = depth - (i << shift);
+        sb->map[i].word = 0;
+        sb->map[i].depth = left < (1U << shift) ? left : (1U << shift);
+    }
+
+    /* Start each CPU in a different word */
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        sb->alloc_hint[cpu] = ((cpu % sb->map_nr) << shift) % depth;
+    }
+    return 0;
+}
+
+/**
+ * Release a bitmap's memory
+ * @param sb Bitmap
+ */
+void sbitmap_free(sbitmap_t *sb) {
+    if (sb->map_alloc) {
+        kfree(sb->map_alloc);
+    }
+    if (sb->alloc_hint) {
+        kfree(sb->alloc_hint);
+    }
+    sb->map = NULL;
+    sb->map_alloc = NULL;
+    sb->alloc_hint = NULL;
+}
+
+/**
+ * Take a clear bit from one word, at or after a hint
+ * @return Bit index within the word, or -1 if the word is full
+ */
+static int sbitmap_get_word(sbitmap_word_t *map, uint32_t hint) {
+    uint64_t full = map->depth == 64 ? ~0ULL : (1ULL << map->depth) - 1;
+    uint64_t word = __atomic_load_n(&map->word, __ATOMIC_RELAXED);
+
+    for (;;) {
+        uint64_t free = ~word & full;
+        if (!free) {
+            return -1;
+        }
+
+        /* Prefer bits above the hint, then wrap around */
+        uint64_t above = free & (~0ULL << hint);
+        int bit = __builtin_ctzll(above ? above : free);
+
+        if (__atomic_compare_exchange_n(&map->word, &word, word | (1ULL << bit), false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return bit;
+        }
+    }
+}
+
+/**
+ * Allocate a free bit, starting from the current CPU's hint
+ * @param sb Bitmap
+ * @return Bit number, or -1 if all bits are taken
+ */
+int sbitmap_get(sbitmap_t *sb) {
+    uint32_t cpu = cpu_current_id();
+    uint32_t hint = sb->alloc_hint[cpu];
+    if (hint >= sb->depth) {
+        hint = 0;
+    }
+
+    uint32_t index = hint >> sb->shift;
+    uint32_t offset = hint & ((1U << sb->shift) - 1);
+
+    for (uint32_t i = 0; i < sb->map_nr; i++) {
+        int bit = sbitmap_get_word(&sb->map[index], offset);
+        if (bit >= 0) {
+            uint32_t nr = (index << sb->shift) + (uint32_t)bit;
+
+            /* Next search starts just past this bit, keeping allocations sequential */
+            sb->alloc_hint[cpu] = nr + 1 < sb->depth ? nr + 1 : 0;
+            return (int)nr;
+        }
+
+        offset = 0;
+        if (++index >= sb->map_nr) {
+            index = 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Release a bit
+ * @param sb Bitmap
+ * @param bit Bit returned by sbitmap_get
+ */
+void sbitmap_clear(sbitmap_t *sb, uint32_t bit) {
+    if (bit >= sb->depth) {
+        return;
+    }
+
+    sbitmap_word_t *map = &sb->map[bit >> sb->shift];
+    __atomic_fetch_and(&map->word, ~(1ULL << (bit & ((1U << sb->shift) - 1))), __ATOMIC_RELEASE);
+}
+
+/**
+ * Count allocated bits
+ * @param sb Bitmap
+ * @return Number of bits currently set
+ */
+uint32_t sbitmap_weight(sbitmap_t *sb) {
+    uint32_t weight = 0;
+    for (uint32_t i = 0; i < sb->map_nr; i++) {
+        weight += (uint32_t)__builtin_popcountll(__atomic_load_n(&sb->map[i].word, __ATOMIC_RELAXED));
+    }
+    return weight;
+}
\ No newline at end of file
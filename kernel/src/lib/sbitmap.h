@@ -0,0 +1,82 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Scalable bitmap allocator
+ */
+
+#ifndef _SBITMAP_H
+#define _SBITMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * A bitmap split into words that each hold only a few bits, so CPUs that
+ * allocate concurrently touch different cache lines. Each CPU remembers
+ * where its last allocation landed and starts searching there; bits are
+ * taken and released with atomic operations, without a lock.
+ */
+typedef struct sbitmap_word {
+    uint64_t word;                      /* Allocated bits */
+    uint64_t depth;                     /* Usable bits in this word */
+} __attribute__((aligned(64))) sbitmap_word_t;
+
+typedef struct sbitmap {
+    uint32_t depth;                     /* Total bits */
+    uint32_t shift;                     /* log2(bits per word) */
+    uint32_t map_nr;                    /* Number of words */
+    sbitmap_word_t *map;                /* Words, cache-line aligned */
+    void *map_alloc;                    /* Allocation backing the words */
+    uint32_t *alloc_hint;               /* Per-CPU next bit to try */
+} sbitmap_t;
+
+/**
+ * Initialize a bitmap
+ * @param sb Bitmap
+ * @param depth Number of bits
+ * @return 0 on success, negative on error
+ */
+int sbitmap_init(sbitmap_t *sb, uint32_t depth);
+
+/**
+ * Release a bitmap's memory
+ * @param sb Bitmap
+ */
+void sbitmap_free(sbitmap_t *sb);
+
+/**
+ * Allocate a free bit, starting from the current CPU's hint
+ * @param sb Bitmap
+ * @return Bit number, or -1 if all bits are taken
+ */
+int sbitmap_get(sbitmap_t *sb);
+
+/**
+ * Release a bit
+ * @param sb Bitmap
+ * @param bit Bit returned by sbitmap_get
+ */
+void sbitmap_clear(sbitmap_t *sb, uint32_t bit);
+
+/**
+ * Count allocated bits
+ * @param sb Bitmap
+ * @return Number of bits currently set
+ */
+uint32_t sbitmap_weight(sbitmap_t *sb);
+
+#endif /* _SBITMAP_H */
\ No newline at end of file
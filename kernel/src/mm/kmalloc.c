@@ -22,6 +22,7 @@
 #include <lib/minstd.h>
 #include <kernel/io.h>
 #include <mm/kmalloc.h>
+#include <mm/shrinker.h>
 
 /* Size of the kernel heap (4 MB) */
 #define KERNEL_HEAP_SIZE (4 * 1024 * 1024)
@@ -145,6 +146,9 @@ void *kmalloc(size_t size) {
 
     /* Find a free block */
     alloc_header_t *block = find_free_block(total_size);
+    if (!block && shrink_caches(SHRINK_BATCH) > 0) {
+        block = find_free_block(total_size);
+    }
     if (!block) {
         kerr("MM: Failed to allocate %zu bytes (out of memory)\n", size);
         return NULL;
@@ -173,6 +177,92 @@ void *kzalloc(size_t size) {
     return ptr;
 }
 
+/**
+ * Find a free block that can hold an allocation with its data aligned
+ * @param size Size needed (including header)
+ * @param align Alignment of the data
+ * @param lead Bytes to split off the front of the block, as a free block of their own (output)
+ * @return Pointer to free block, or NULL if none found
+ */
+static alloc_header_t *find_aligned_block(size_t size, size_t align, size_t *lead) {
+    alloc_header_t *current = (alloc_header_t *)kernel_heap;
+    alloc_header_t *heap_end = (alloc_header_t *)(kernel_heap + KERNEL_HEAP_SIZE);
+
+    while ((uintptr_t)current < (uintptr_t)heap_end) {
+        if (current->magic != ALLOC_MAGIC) {
+            kerr("MM: Corrupted heap detected at 0x%p\n", current);
+            return NULL;
+        }
+
+        if (!current->used) {
+            uintptr_t data = (uintptr_t)current + sizeof(alloc_header_t);
+            size_t gap = ((data + align - 1) & ~(align - 1)) - data;
+
+            /* The bytes in front must be big enough to stay a free block */
+            while (gap && gap < MIN_ALLOC_SIZE) {
+                gap += align;
+            }
+
+            if (current->size >= gap + size) {
+                *lead = gap;
+                return current;
+            }
+        }
+
+        current = (alloc_header_t *)((uintptr_t)current + current->size);
+    }
+
+    return NULL;
+}
+
+/**
+ * Allocate memory from the kernel heap with a specific alignment
+ * @param size Size of the memory block to allocate in bytes
+ * @param align Alignment requirement (must be a power of 2)
+ * @return Pointer to the allocated memory, or NULL on failure
+ */
+void *kmalloc_aligned(size_t size, size_t align) {
+    /* Every allocation is already 16-byte aligned */
+    if (align <= 16) {
+        return kmalloc(size);
+    }
+    if (size == 0 || (align & (align - 1))) {
+        return NULL;
+    }
+
+    if (!heap_initialized) {
+        kmalloc_init();
+    }
+
+    size = (size + 15) & ~15;
+    size_t total_size = size + sizeof(alloc_header_t);
+
+    size_t lead;
+    alloc_header_t *block = find_aligned_block(total_size, align, &lead);
+    if (!block && shrink_caches(SHRINK_BATCH) > 0) {
+        block = find_aligned_block(total_size, align, &lead);
+    }
+    if (!block) {
+        kerr("MM: Failed to allocate %zu bytes aligned to %zu (out of memory)\n", size, align);
+        return NULL;
+    }
+
+    /* Leave the bytes in front of the aligned block free */
+    if (lead) {
+        alloc_header_t *aligned = (alloc_header_t *)((uintptr_t)block + lead);
+        aligned->size = block->size - lead;
+        aligned->magic = ALLOC_MAGIC;
+        aligned->used = false;
+        block->size = lead;
+        block = aligned;
+    }
+
+    split_block(block, total_size);
+    heap_used += block->size;
+
+    return (void *)((uintptr_t)block + sizeof(alloc_header_t));
+}
+
 /**
  * Validate a block header
  * @param header Block header to validate
@@ -0,0 +1,980 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Page cache
+ *
+ * File data is cached in 4 KiB pages, indexed per inode by a radix tree
+ * in the vfs_node, so reading a file a second time costs no device I/O.
+ * Missing pages are filled by the filesystem's readpages operation, up
+ * to PAGE_CACHE_READ_BATCH consecutive pages per call so the block layer
+ * can merge the reads. A page is LOCKED while it is filled, and becomes
+ * UPTODATE once the fill succeeds. The filesystem only submits the reads;
+ * a fill is completed when a reader needs one of its pages, or when all
+ * of its reads have finished.
+ *
+ * Each open file keeps a read-ahead window. A miss by a sequential reader
+ * reads a window past the request, and a miss by a random reader reads
+ * only the request. The first page of the window's trailing async_size
+ * pages is flagged READAHEAD; reaching it submits the next window, twice
+ * as large up to READAHEAD_MAX_PAGES, while the reader is still copying
+ * out the current one, so the device always has reads queued.
+ *
+ * Writes to files on a backing device are buffered: they only copy into
+ * the pages and mark them DIRTY, and mm/writeback.c writes the pages back
+ * later through the filesystem's writepages.
+ *
+ * Memory-backed devices can hand out their own memory for a page through
+ * page_io_map(), so the page references the device image and nothing is
+ * read or copied. Such a page is MAPPED, and gets a private copy the first
+ * time it is written.
+ *
+ * Pages are kept on an LRU list. Clean,
+ * unused pages are reclaimed from its tail when more than
+ * PAGE_CACHE_MAX_PAGES are cached or when memory runs out.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <lib/radix_tree.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/config.h>
+#include <fs/vfs.h>
+#include <fs/file.h>
+#include <drivers/block/bio.h>
+#include <mm/page_cache.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/shrinker.h>
+#include <mm/writeback.h>
+
+static cache_page_t *page_lru_head = NULL;     /* Most recently used */
+static cache_page_t *page_lru_tail = NULL;     /* Least recently used */
+static page_cache_stats_t page_cache_stats;
+static page_io_t *page_io_inflight = NULL;      /* Fills not completed yet */
+
+/* Fill argument for no read-ahead marker */
+#define PAGE_CACHE_NO_MARKER    ((uint64_t)-1)
+
+static void page_lru_remove(cache_page_t *page) {
+    if (page->lru_prev) {
+        page->lru_prev->lru_next = page->lru_next;
+    } else {
+        page_lru_head = page->lru_next;
+    }
+    if (page->lru_next) {
+        page->lru_next->lru_prev = page->lru_prev;
+    } else {
+        page_lru_tail = page->lru_prev;
+    }
+    page->lru_prev = page->lru_next = NULL;
+}
+
+static void page_lru_push(cache_page_t *page) {
+    page->lru_prev = NULL;
+    page->lru_next = page_lru_head;
+    if (page_lru_head) {
+        page_lru_head->lru_prev = page;
+    } else {
+        page_lru_tail = page;
+    }
+    page_lru_head = page;
+}
+
+/**
+ * Mark a page dirty; called with interrupts disabled
+ * @return true if it is the first dirty page of its file
+ */
+static bool page_cache_account_dirty(cache_page_t *page) {
+    if (page->flags & PAGE_CACHE_DIRTY) {
+        return false;
+    }
+
+    page->flags = (page->flags & ~PAGE_CACHE_ERROR) | PAGE_CACHE_DIRTY;
+    page_cache_stats.dirty++;
+    return page->node->nr_dirty++ == 0;
+}
+
+/**
+ * Mark a page clean; called with interrupts disabled
+ */
+static void page_cache_account_clean(cache_page_t *page) {
+    if (page->flags & PAGE_CACHE_DIRTY) {
+        page->flags &= ~PAGE_CACHE_DIRTY;
+        page_cache_stats.dirty--;
+        page->node->nr_dirty--;
+    }
+}
+
+/**
+ * Unlink and free a page; called with interrupts disabled
+ */
+static void page_cache_free(cache_page_t *page) {
+    page_cache_account_clean(page);
+    radix_tree_delete(&page->node->pages, page->index);
+    page_lru_remove(page);
+    page_cache_stats.pages--;
+    if (page->flags & PAGE_CACHE_MAPPED) {
+        page_cache_stats.mapped--;
+    } else {
+        pmm_free_dma(page->data, 1);
+    }
+    kfree(page);
+}
+
+/**
+ * Give a page that references device memory a private copy before it is modified
+ * @return 0 on success, -1 if out of memory
+ */
+static int page_cache_unshare(cache_page_t *page) {
+    if (!(page->flags & PAGE_CACHE_MAPPED)) {
+        return 0;
+    }
+
+    uint64_t phys;
+    void *data = pmm_alloc_dma(1, &phys);
+    if (!data) {
+        return -1;
+    }
+    memcpy(data, page->data, PAGE_SIZE);
+
+    uint64_t flags = cpu_irq_save();
+    page->data = data;
+    page->flags &= ~PAGE_CACHE_MAPPED;
+    page_cache_stats.mapped--;
+    cpu_irq_restore(flags);
+    return 0;
+}
+
+/**
+ * Whether a page can be dropped without losing data or pulling it from under a user
+ */
+static inline bool page_cache_reclaimable(cache_page_t *page) {
+    return page->refcount == 0 && !(page->flags & (PAGE_CACHE_LOCKED | PAGE_CACHE_DIRTY));
+}
+
+/**
+ * Free the least recently used page that can be reclaimed
+ * @return true if a page was freed
+ */
+static bool page_cache_evict_one(void) {
+    uint64_t flags = cpu_irq_save();
+
+    for (cache_page_t *page = page_lru_tail; page; page = page->lru_prev) {
+        if (page_cache_reclaimable(page)) {
+            page_cache_free(page);
+            page_cache_stats.evictions++;
+            cpu_irq_restore(flags);
+            return true;
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return false;
+}
+
+static size_t page_cache_shrink_count(void) {
+    return page_cache_stats.pages;
+}
+
+static size_t page_cache_shrink_scan(size_t nr) {
+    size_t freed = 0;
+    while (freed < nr && page_cache_evict_one()) {
+        freed++;
+    }
+    return freed;
+}
+
+static shrinker_t page_cache_shrinker = {
+    .name = "page_cache",
+    .count = page_cache_shrink_count,
+    .scan = page_cache_shrink_scan,
+};
+
+/**
+ * Initialize the page cache and register it with the reclaim path
+ */
+void page_cache_init(void) {
+    memset(&page_cache_stats, 0, sizeof(page_cache_stats));
+    page_lru_head = page_lru_tail = NULL;
+
+    shrinker_register(&page_cache_shrinker);
+}
+
+/**
+ * Find a cached page and take a reference to it
+ * @param node File
+ * @param index Page index
+ * @return The page, or NULL if it is not cached
+ */
+cache_page_t *page_cache_find(struct vfs_node *node, uint64_t index) {
+    uint64_t flags = cpu_irq_save();
+
+    cache_page_t *page = (cache_page_t *)radix_tree_lookup(&node->pages, index);
+    if (page) {
+        page->refcount++;
+        if (page_lru_head != page) {
+            page_lru_remove(page);
+            page_lru_push(page);
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return page;
+}
+
+/**
+ * Drop a reference taken by page_cache_find
+ * @param page Page (may be NULL)
+ */
+void page_cache_release(cache_page_t *page) {
+    if (!page) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    page->refcount--;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Add a page to the cache, locked and with a reference for the caller
+ * @return The page, or NULL if out of memory or the index was taken meanwhile
+ */
+static cache_page_t *page_cache_add(struct vfs_node *node, uint64_t index) {
+    if (page_cache_stats.pages >= PAGE_CACHE_MAX_PAGES) {
+        page_cache_evict_one();
+    }
+
+    cache_page_t *page = (cache_page_t *)kzalloc(sizeof(cache_page_t));
+    if (!page) {
+        return NULL;
+    }
+
+    uint64_t phys;
+    page->data = pmm_alloc_dma(1, &phys);
+    if (!page->data) {
+        kfree(page);
+        return NULL;
+    }
+
+    page->node = node;
+    page->index = index;
+    page->flags = PAGE_CACHE_LOCKED;
+    page->refcount = 1;
+
+    uint64_t flags = cpu_irq_save();
+    if (radix_tree_insert(&node->pages, index, page) < 0) {
+        cpu_irq_restore(flags);
+        pmm_free_dma(page->data, 1);
+        kfree(page);
+        return NULL;
+    }
+    page_lru_push(page);
+    page_cache_stats.pages++;
+    cpu_irq_restore(flags);
+
+    return page;
+}
+
+/**
+ * Hand a submitted bio to a fill; the page cache waits for it and frees it
+ * @param io Fill passed to readpages
+ * @param bio Submitted read into one of the fill's pages
+ */
+void page_io_add_bio(page_io_t *io, bio_t *bio) {
+    if (io->nr_bios == io->max_bios) {
+        uint32_t max = io->max_bios ? io->max_bios * 2 : 16;
+        bio_t **bios = (bio_t **)krealloc(io->bios, max * sizeof(bio_t *));
+        if (!bios) {
+            /* No room to track it, so wait for it now */
+            if (bio_wait(bio) < 0) {
+                io->error = -1;
+            }
+            bio_free(bio);
+            return;
+        }
+        io->bios = bios;
+        io->max_bios = max;
+    }
+
+    io->bios[io->nr_bios++] = bio;
+}
+
+/**
+ * Serve a page of a fill straight from device memory instead of reading it
+ * @param io Fill passed to readpages
+ * @param i Page of the fill
+ * @param addr PAGE_SIZE bytes of file data, all before the end of the file, that stay
+ *             valid while the device exists
+ */
+void page_io_map(page_io_t *io, uint32_t i, void *addr) {
+    cache_page_t *page = io->pages[i];
+
+    uint64_t flags = cpu_irq_save();
+    if (page->flags & PAGE_CACHE_MAPPED) {
+        page_cache_stats.mapped--;
+    } else {
+        pmm_free_dma(page->data, 1);
+    }
+    page->data = addr;
+    page->flags |= PAGE_CACHE_MAPPED;
+    page_cache_stats.mapped++;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Check whether every read of a fill has finished
+ */
+static bool page_io_done(page_io_t *io) {
+    for (uint32_t i = 0; i < io->nr_bios; i++) {
+        if (!(io->bios[i]->flags & BIO_DONE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Wait for the reads of a fill, then unlock its pages
+ * @param io Fill, freed on return
+ */
+static void page_io_complete(page_io_t *io) {
+    uint64_t flags = cpu_irq_save();
+    for (page_io_t **link = &page_io_inflight; *link; link = &(*link)->next) {
+        if (*link == io) {
+            *link = io->next;
+            break;
+        }
+    }
+    cpu_irq_restore(flags);
+
+    for (uint32_t i = 0; i < io->nr_bios; i++) {
+        if (bio_wait(io->bios[i]) < 0) {
+            io->error = -1;
+        }
+        bio_free(io->bios[i]);
+    }
+
+    for (uint32_t i = 0; i < io->count; i++) {
+        cache_page_t *page = io->pages[i];
+        uint64_t start = page->index * PAGE_SIZE;
+        uint64_t file_size = page->node->size;
+
+        /* Whatever the last block held past the end of the file reads as zeroes */
+        if (!io->error && file_size < start + PAGE_SIZE && !(page->flags & PAGE_CACHE_MAPPED)) {
+            uint64_t valid = file_size > start ? file_size - start : 0;
+            memset((uint8_t *)page->data + valid, 0, PAGE_SIZE - valid);
+        }
+
+        uint32_t state = io->error ? PAGE_CACHE_ERROR : PAGE_CACHE_UPTODATE;
+        page->io = NULL;
+        page->flags = (page->flags & ~PAGE_CACHE_LOCKED) | state;
+        page_cache_release(page);
+    }
+
+    kfree(io->bios);
+    kfree(io);
+}
+
+/**
+ * Complete the fills whose reads have all finished, so their pages can be reclaimed
+ */
+static void page_io_reap(void) {
+    page_io_t *io = page_io_inflight;
+    while (io) {
+        page_io_t *next = io->next;
+        if (page_io_done(io)) {
+            page_io_complete(io);
+        }
+        io = next;
+    }
+}
+
+/**
+ * Wait until a page is no longer being filled
+ */
+static void page_cache_wait(cache_page_t *page) {
+    if ((page->flags & PAGE_CACHE_LOCKED) && page->io) {
+        page_cache_stats.waits++;
+        page_io_complete(page->io);
+    }
+}
+
+/**
+ * Start filling the run of missing pages at an index with one readpages call
+ * @param node File
+ * @param index First page of the run, which is not cached
+ * @param last Last page wanted
+ * @param marker Page to flag READAHEAD if the run reaches it
+ * @param wait Complete the fill before returning
+ * @return Pages in the fill, or negative on error
+ */
+static int page_cache_fill(struct vfs_node *node, uint64_t index, uint64_t last,
+                           uint64_t marker, bool wait) {
+    page_io_t *io = (page_io_t *)kzalloc(sizeof(page_io_t));
+    if (!io) {
+        return -1;
+    }
+
+    void *buffers[PAGE_CACHE_READ_BATCH];
+    while (index + io->count <= last && io->count < PAGE_CACHE_READ_BATCH) {
+        uint64_t at = index + io->count;
+        cache_page_t *page = page_cache_find(node, at);
+        if (page) {
+            /* A page that is cached or being filled ends the run; a failed one is retried */
+            if (page->flags & (PAGE_CACHE_UPTODATE | PAGE_CACHE_LOCKED)) {
+                page_cache_release(page);
+                break;
+            }
+            /* Reads must not land in device memory */
+            if (page_cache_unshare(page) < 0) {
+                page_cache_release(page);
+                break;
+            }
+            page->flags = (page->flags & ~PAGE_CACHE_ERROR) | PAGE_CACHE_LOCKED;
+        } else {
+            page = page_cache_add(node, at);
+            if (!page) {
+                break;
+            }
+        }
+
+        if (at == marker) {
+            page->flags |= PAGE_CACHE_READAHEAD;
+        }
+        page->io = io;
+        io->pages[io->count] = page;
+        buffers[io->count] = page->data;
+        io->count++;
+    }
+
+    int count = io->count;
+    if (count == 0) {
+        kfree(io);
+        return -1;
+    }
+
+    page_cache_stats.fills++;
+    if (node->ops->readpages(node, index, count, buffers, io) < 0) {
+        io->error = -1;
+    }
+
+    if (wait || io->error) {
+        page_io_complete(io);
+    } else {
+        page_cache_stats.readahead += count;
+        uint64_t flags = cpu_irq_save();
+        io->next = page_io_inflight;
+        page_io_inflight = io;
+        cpu_irq_restore(flags);
+    }
+
+    return count;
+}
+
+/**
+ * Start reading the pages of a window that are not cached yet
+ * @param node File
+ * @param start First page
+ * @param nr Pages in the window
+ * @param marker Page to flag READAHEAD
+ */
+static void page_cache_readahead(struct vfs_node *node, uint64_t start, uint64_t nr,
+                                 uint64_t marker) {
+    uint64_t end = (node->size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (start + nr < end) {
+        end = start + nr;
+    }
+
+    uint64_t index = start;
+    while (index < end) {
+        cache_page_t *page = page_cache_find(node, index);
+        if (page) {
+            page_cache_release(page);
+            index++;
+            continue;
+        }
+
+        int count = page_cache_fill(node, index, end - 1, marker, false);
+        if (count < 0) {
+            break;
+        }
+        index += count;
+    }
+}
+
+/**
+ * Size of the first window of a sequential stream: a few times the request, within the cap
+ */
+static uint32_t ra_init_size(uint64_t req) {
+    uint32_t size = 1;
+    while (size < req && size < READAHEAD_MAX_PAGES) {
+        size <<= 1;
+    }
+    size *= size <= READAHEAD_MAX_PAGES / 16 ? 4 : 2;
+    return size < READAHEAD_MAX_PAGES ? size : READAHEAD_MAX_PAGES;
+}
+
+/**
+ * Size of the window after one the reader kept up with
+ */
+static uint32_t ra_next_size(uint32_t size) {
+    return size * 2 < READAHEAD_MAX_PAGES ? size * 2 : READAHEAD_MAX_PAGES;
+}
+
+/**
+ * Read-ahead on a miss: a sequential reader gets a larger window past the request,
+ * a random one only the pages it asked for
+ * @param node File
+ * @param ra Read-ahead state
+ * @param index Page missed
+ * @param req Pages left in the request
+ */
+static void page_cache_sync_readahead(struct vfs_node *node, file_ra_state_t *ra,
+                                      uint64_t index, uint64_t req) {
+    /* Reading on from the last page read, or that page again */
+    bool sequential = index == ra->next_index || index + 1 == ra->next_index;
+
+    ra->start = index;
+    if (!sequential) {
+        ra->size = 0;
+        ra->async_size = 0;
+        page_cache_readahead(node, index, req, PAGE_CACHE_NO_MARKER);
+        return;
+    }
+
+    ra->size = ra->size ? ra_next_size(ra->size) : ra_init_size(req);
+    if (ra->size < req) {
+        ra->size = req < READAHEAD_MAX_PAGES ? req : READAHEAD_MAX_PAGES;
+    }
+    ra->async_size = ra->size > req ? ra->size - req : 0;
+
+    /* A large request reads past the window; read-ahead resumes from its marker */
+    uint64_t nr = req > ra->size ? req : ra->size;
+    page_cache_readahead(node, index, nr, ra->start + ra->size - ra->async_size);
+}
+
+/**
+ * Read-ahead on reaching a marker: start the next window before the reader needs it
+ * @param node File
+ * @param ra Read-ahead state
+ * @param index Page that carried the marker
+ */
+static void page_cache_async_readahead(struct vfs_node *node, file_ra_state_t *ra,
+                                       uint64_t index) {
+    if (ra->size && index == ra->start + ra->size - ra->async_size) {
+        /* Our own marker: the next window follows this one */
+        ra->start += ra->size;
+        ra->size = ra_next_size(ra->size);
+    } else {
+        /* Another reader's marker, or state lost to a seek: start over behind it */
+        ra->start = index + 1;
+        ra->size = ra_init_size(1);
+    }
+
+    ra->async_size = ra->size;
+    page_cache_readahead(node, ra->start, ra->size, ra->start);
+}
+
+/**
+ * Read from a file through the cache, filling missing pages with the filesystem's readpages
+ * @param node File with a readpages operation
+ * @param ra Read-ahead state of the open file
+ * @param offset Byte offset
+ * @param size Bytes to read
+ * @param buffer Destination
+ * @return Bytes read (short at end of file or on error)
+ */
+size_t page_cache_read(struct vfs_node *node, file_ra_state_t *ra, uint64_t offset,
+                       size_t size, void *buffer) {
+    if (offset >= node->size) {
+        return 0; /* EOF */
+    }
+    if (size > node->size - offset) {
+        size = node->size - offset;
+    }
+
+    page_io_reap();
+
+    uint8_t *dest = (uint8_t *)buffer;
+    uint64_t last = (offset + size - 1) / PAGE_SIZE;
+    size_t done = 0;
+
+    while (done < size) {
+        uint64_t pos = offset + done;
+        uint64_t index = pos / PAGE_SIZE;
+
+        cache_page_t *page = page_cache_find(node, index);
+        if (!page) {
+            page_cache_stats.misses++;
+            page_cache_sync_readahead(node, ra, index, last - index + 1);
+            page = page_cache_find(node, index);
+        } else if (page->flags & PAGE_CACHE_UPTODATE) {
+            page_cache_stats.hits++;
+        }
+
+        if (page && (page->flags & PAGE_CACHE_READAHEAD)) {
+            page->flags &= ~PAGE_CACHE_READAHEAD;
+            page_cache_async_readahead(node, ra, index);
+        }
+        if (page) {
+            page_cache_wait(page);
+        }
+
+        /* A fill that failed or could not start is retried for this page alone */
+        if (!page || !(page->flags & PAGE_CACHE_UPTODATE)) {
+            page_cache_release(page);
+            page_cache_fill(node, index, index, PAGE_CACHE_NO_MARKER, true);
+            page = page_cache_find(node, index);
+            if (!page || !(page->flags & PAGE_CACHE_UPTODATE)) {
+                page_cache_release(page);
+                break;
+            }
+        }
+
+        uint32_t page_offset = pos % PAGE_SIZE;
+        size_t bytes = PAGE_SIZE - page_offset;
+        if (bytes > size - done) {
+            bytes = size - done;
+        }
+
+        memcpy(dest + done, (uint8_t *)page->data + page_offset, bytes);
+        page_cache_release(page);
+        ra->next_index = index + 1;
+        done += bytes;
+    }
+
+    return done;
+}
+
+/**
+ * Copy data just written to a file into the pages that cache it
+ * @param node File
+ * @param offset Byte offset written
+ * @param size Bytes written
+ * @param buffer Data written
+ */
+void page_cache_update(struct vfs_node *node, uint64_t offset, size_t size, const void *buffer) {
+    const uint8_t *src = (const uint8_t *)buffer;
+    size_t done = 0;
+
+    while (done < size) {
+        uint64_t pos = offset + done;
+        uint32_t page_offset = pos % PAGE_SIZE;
+        size_t bytes = PAGE_SIZE - page_offset;
+        if (bytes > size - done) {
+            bytes = size - done;
+        }
+
+        /* Pages that are not cached are read from the file when next needed */
+        cache_page_t *page = page_cache_find(node, pos / PAGE_SIZE);
+        if (page) {
+            page_cache_wait(page);
+        }
+        if (page && (page->flags & PAGE_CACHE_UPTODATE)) {
+            if (page_cache_unshare(page) == 0) {
+                memcpy((uint8_t *)page->data + page_offset, src + done, bytes);
+            } else {
+                /* Stale data must not stay cached; drop the page once it is unused */
+                page->flags &= ~PAGE_CACHE_UPTODATE;
+            }
+        }
+        page_cache_release(page);
+
+        done += bytes;
+    }
+}
+
+/**
+ * Write into a file's pages and leave them for writeback
+ *
+ * The writer is throttled with balance_dirty_pages() after every
+ * PAGE_CACHE_WRITE_BATCH pages, so one large write can't dirty the cache
+ * far past the dirty limit.
+ *
+ * @param node File with readpages and writepages operations and a backing device
+ * @param offset Byte offset
+ * @param size Bytes to write
+ * @param buffer Data
+ * @return Bytes written (short if out of memory or a page could not be read)
+ */
+size_t page_cache_write(struct vfs_node *node, uint64_t offset, size_t size, const void *buffer) {
+    const uint8_t *src = (const uint8_t *)buffer;
+    size_t done = 0;
+    uint32_t batch = 0;
+
+    page_io_reap();
+
+    while (done < size) {
+        uint64_t pos = offset + done;
+        uint64_t index = pos / PAGE_SIZE;
+        uint32_t page_offset = pos % PAGE_SIZE;
+        size_t bytes = PAGE_SIZE - page_offset;
+        if (bytes > size - done) {
+            bytes = size - done;
+        }
+
+        cache_page_t *page = page_cache_find(node, index);
+        if (page) {
+            page_cache_wait(page);
+        }
+
+        if (!page || !(page->flags & PAGE_CACHE_UPTODATE)) {
+            if (bytes < PAGE_SIZE && index * PAGE_SIZE < node->size) {
+                /* The rest of the page holds file data, so read it in first */
+                page_cache_release(page);
+                page_cache_fill(node, index, index, PAGE_CACHE_NO_MARKER, true);
+                page = page_cache_find(node, index);
+                if (!page || !(page->flags & PAGE_CACHE_UPTODATE)) {
+                    page_cache_release(page);
+                    break;
+                }
+            } else {
+                /* Past the end of the file, or about to be overwritten whole */
+                if (!page) {
+                    page = page_cache_add(node, index);
+                    if (!page) {
+                        break;
+                    }
+                }
+                if (bytes < PAGE_SIZE) {
+                    memset(page->data, 0, PAGE_SIZE);
+                }
+                page->flags = (page->flags & ~(PAGE_CACHE_LOCKED | PAGE_CACHE_ERROR)) |
+                              PAGE_CACHE_UPTODATE;
+            }
+        }
+
+        if (page_cache_unshare(page) < 0) {
+            page_cache_release(page);
+            break;
+        }
+        memcpy((uint8_t *)page->data + page_offset, src + done, bytes);
+
+        uint64_t flags = cpu_irq_save();
+        bool first = page_cache_account_dirty(page);
+        cpu_irq_restore(flags);
+        if (first) {
+            writeback_inode_dirty(node);
+        }
+
+        page_cache_release(page);
+        done += bytes;
+
+        /* Writeback stops at the node's size, so grow it before throttling */
+        if (offset + done > node->size) {
+            node->size = offset + done;
+        }
+
+        if (++batch == PAGE_CACHE_WRITE_BATCH) {
+            balance_dirty_pages(node->bdi);
+            batch = 0;
+        }
+    }
+
+    if (batch) {
+        balance_dirty_pages(node->bdi);
+    }
+
+    return done;
+}
+
+/**
+ * Write back dirty pages of a file, in runs of consecutive pages
+ *
+ * Pages that writepages fails on are not retried: they are marked clean
+ * with PAGE_CACHE_ERROR, keeping their data, and the failure is recorded
+ * on the file for page_cache_writeback_error(). Otherwise a file that
+ * can't be written would stay dirty, and requeued, forever.
+ *
+ * @param node File with a writepages operation
+ * @param nr Pages to write at most
+ * @return Pages written, or negative if writepages failed for all of them
+ */
+int64_t page_cache_writeback_inode(struct vfs_node *node, uint64_t nr) {
+    cache_page_t *found[PAGE_CACHE_WRITE_BATCH];
+    cache_page_t *run[PAGE_CACHE_WRITE_BATCH];
+    void *buffers[PAGE_CACHE_WRITE_BATCH];
+    uint64_t index = 0;
+    int64_t written = 0;
+    uint64_t failed = 0;
+
+    while ((uint64_t)(written + failed) < nr && node->nr_dirty) {
+        uint32_t count = 0;
+        uint64_t limit = nr - written - failed;
+
+        /* Collect the next run of dirty pages, and lock them against reclaim and truncation */
+        uint64_t flags = cpu_irq_save();
+        uint32_t n = radix_tree_gang_lookup(&node->pages, (void **)found, index,
+                                            PAGE_CACHE_WRITE_BATCH);
+        for (uint32_t i = 0; i < n && count < limit; i++) {
+            cache_page_t *page = found[i];
+            index = page->index + 1;
+
+            bool writable = (page->flags & PAGE_CACHE_DIRTY) && !(page->flags & PAGE_CACHE_LOCKED);
+            if (count && (!writable || page->index != run[count - 1]->index + 1)) {
+                index = page->index;
+                break;
+            }
+            if (!writable) {
+                continue;
+            }
+
+            page->flags |= PAGE_CACHE_LOCKED;
+            page->refcount++;
+            run[count] = page;
+            buffers[count] = page->data;
+            count++;
+        }
+        cpu_irq_restore(flags);
+
+        if (n == 0) {
+            break;
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        int result = node->ops->writepages(node, run[0]->index, count, buffers);
+
+        flags = cpu_irq_save();
+        for (uint32_t i = 0; i < count; i++) {
+            page_cache_account_clean(run[i]);
+            if (result < 0) {
+                run[i]->flags |= PAGE_CACHE_ERROR;
+            }
+            run[i]->flags &= ~PAGE_CACHE_LOCKED;
+            run[i]->refcount--;
+        }
+        if (result < 0) {
+            node->wb_error = -1;
+            page_cache_stats.wb_errors += count;
+        }
+        cpu_irq_restore(flags);
+
+        if (result < 0) {
+            kerr("PAGECACHE: Failed to write back %u pages at page %lu\n", count, run[0]->index);
+            failed += count;
+        } else {
+            written += count;
+        }
+    }
+
+    if (node->nr_dirty == 0) {
+        writeback_inode_clean(node);
+    }
+    return (written == 0 && failed) ? -1 : written;
+}
+
+/**
+ * Report and clear a write-back failure of a file
+ * @param node File
+ * @return 0, or negative if dirty pages were lost since the last call
+ */
+int page_cache_writeback_error(struct vfs_node *node) {
+    uint64_t flags = cpu_irq_save();
+    int error = node->wb_error;
+    node->wb_error = 0;
+    cpu_irq_restore(flags);
+    return error;
+}
+
+/**
+ * Count the dirty pages in the cache
+ */
+uint32_t page_cache_dirty_count(void) {
+    return page_cache_stats.dirty;
+}
+
+/**
+ * Drop cached pages past a new end of file
+ * @param node File
+ * @param size New file size
+ */
+void page_cache_truncate(struct vfs_node *node, uint64_t size) {
+    uint64_t first = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    cache_page_t *pages[16];
+    uint32_t found;
+
+    /* Let fills in flight finish before their pages go away */
+    page_io_t *io = page_io_inflight;
+    while (io) {
+        page_io_t *next = io->next;
+        if (io->pages[0]->node == node) {
+            page_io_complete(io);
+        }
+        io = next;
+    }
+
+    /* The partial last page keeps its data up to the new size only */
+    if (size % PAGE_SIZE) {
+        cache_page_t *page = page_cache_find(node, size / PAGE_SIZE);
+        if (page) {
+            if (page_cache_unshare(page) == 0) {
+                memset((uint8_t *)page->data + size % PAGE_SIZE, 0, PAGE_SIZE - size % PAGE_SIZE);
+            }
+            page_cache_release(page);
+        }
+    }
+
+    uint64_t flags = cpu_irq_save();
+    while ((found = radix_tree_gang_lookup(&node->pages, (void **)pages, first, 16)) > 0) {
+        for (uint32_t i = 0; i < found; i++) {
+            first = pages[i]->index + 1;
+            page_cache_free(pages[i]);
+        }
+    }
+    cpu_irq_restore(flags);
+
+    if (node->nr_dirty == 0) {
+        writeback_inode_clean(node);
+    }
+}
+
+/**
+ * Drop every cached page of a file, before the node is freed
+ * @param node File
+ */
+void page_cache_evict_inode(struct vfs_node *node) {
+    page_cache_truncate(node, 0);
+    radix_tree_destroy(&node->pages);
+}
+
+/**
+ * Get a snapshot of the cache statistics
+ * @param stats Structure to fill
+ */
+void page_cache_get_stats(page_cache_stats_t *stats) {
+    uint64_t flags = cpu_irq_save();
+    *stats = page_cache_stats;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Print cache statistics
+ */
+void page_cache_print_stats(void) {
+    page_cache_stats_t stats;
+    page_cache_get_stats(&stats);
+
+    kprintf("PAGECACHE: %u pages (%u dirty, %u mapped), %lu hits, %lu misses, %lu fills, %lu read ahead, %lu waits, %lu evictions, %lu write-back errors\n",
+            stats.pages, stats.dirty, stats.mapped, stats.hits, stats.misses, stats.fills, stats.readahead, stats.waits,
+            stats.evictions, stats.wb_errors);
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Page cache
+ */
+
+#ifndef _MM_PAGE_CACHE_H
+#define _MM_PAGE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct vfs_node;
+struct file_ra_state;
+struct bio;
+
+/* Page state */
+#define PAGE_CACHE_UPTODATE     0x01    /* Holds the file's data */
+#define PAGE_CACHE_DIRTY        0x02    /* Newer than the file on disk */
+#define PAGE_CACHE_LOCKED       0x04    /* Being filled or written back */
+#define PAGE_CACHE_ERROR        0x08    /* The last fill or write-back failed */
+#define PAGE_CACHE_READAHEAD    0x10    /* Reaching it starts the next read-ahead window */
+#define PAGE_CACHE_MAPPED       0x20    /* Data is device memory, shared until the page is written */
+
+/* Pages filled with one readpages call */
+#define PAGE_CACHE_READ_BATCH   32
+
+/* Pages written back with one writepages call */
+#define PAGE_CACHE_WRITE_BATCH  32
+
+/* A cached 4 KiB page of a file */
+typedef struct cache_page {
+    struct vfs_node *node;          /* File the page belongs to */
+    uint64_t index;                 /* Offset in the file, in pages */
+    void *data;                     /* PAGE_SIZE bytes */
+    volatile uint32_t flags;        /* PAGE_CACHE_* */
+    uint32_t refcount;              /* Users that stop the page from being reclaimed */
+    struct page_io *io;             /* Fill in flight while LOCKED */
+    struct cache_page *lru_prev;    /* LRU list, most recently used first */
+    struct cache_page *lru_next;
+} cache_page_t;
+
+/* Pages being filled by one readpages call */
+typedef struct page_io {
+    cache_page_t *pages[PAGE_CACHE_READ_BATCH];
+    uint32_t count;
+    struct bio **bios;              /* Reads the filesystem submitted for the pages */
+    uint32_t nr_bios;
+    uint32_t max_bios;
+    int error;                      /* Set if any part of the fill failed */
+    struct page_io *next;           /* In-flight list */
+} page_io_t;
+
+/* Cache statistics */
+typedef struct page_cache_stats {
+    uint64_t hits;                  /* Pages read from the cache */
+    uint64_t misses;                /* Pages a read found missing */
+    uint64_t fills;                 /* readpages calls */
+    uint64_t readahead;             /* Pages read ahead of the reader */
+    uint64_t waits;                 /* Reads that caught up with read-ahead in flight */
+    uint64_t evictions;
+    uint64_t wb_errors;             /* Dirty pages lost to failed writeback */
+    uint32_t pages;                 /* Pages cached */
+    uint32_t dirty;                 /* Pages waiting for writeback */
+    uint32_t mapped;                /* Pages referencing device memory instead of a copy */
+} page_cache_stats_t;
+
+/**
+ * Initialize the page cache and register it with the reclaim path
+ */
+void page_cache_init(void);
+
+/**
+ * Find a cached page and take a reference to it
+ * @param node File
+ * @param index Page index
+ * @return The page, or NULL if it is not cached
+ */
+cache_page_t *page_cache_find(struct vfs_node *node, uint64_t index);
+
+/**
+ * Drop a reference taken by page_cache_find
+ * @param page Page (may be NULL)
+ */
+void page_cache_release(cache_page_t *page);
+
+/**
+ * Hand a submitted bio to a fill; the page cache waits for it and frees it
+ * @param io Fill passed to readpages
+ * @param bio Submitted read into one of the fill's pages
+ */
+void page_io_add_bio(page_io_t *io, struct bio *bio);
+
+/**
+ * Serve a page of a fill straight from device memory instead of reading it
+ * @param io Fill passed to readpages
+ * @param i Page of the fill
+ * @param addr PAGE_SIZE bytes of file data, all before the end of the file, that stay
+ *             valid while the device exists
+ */
+void page_io_map(page_io_t *io, uint32_t i, void *addr);
+
+/**
+ * Read from a file through the cache, filling missing pages with the filesystem's readpages
+ * @param node File with a readpages operation
+ * @param ra Read-ahead state of the open file
+ * @param offset Byte offset
+ * @param size Bytes to read
+ * @param buffer Destination
+ * @return Bytes read (short at end of file or on error)
+ */
+size_t page_cache_read(struct vfs_node *node, struct file_ra_state *ra, uint64_t offset,
+                       size_t size, void *buffer);
+
+/**
+ * Copy data just written to a file into the pages that cache it
+ * @param node File
+ * @param offset Byte offset written
+ * @param size Bytes written
+ * @param buffer Data written
+ */
+void page_cache_update(struct vfs_node *node, uint64_t offset, size_t size, const void *buffer);
+
+/**
+ * Write into a file's pages and leave them for writeback
+ *
+ * The writer is throttled with balance_dirty_pages() after every
+ * PAGE_CACHE_WRITE_BATCH pages, so one large write can't dirty the cache
+ * far past the dirty limit.
+ *
+ * @param node File with readpages and writepages operations and a backing device
+ * @param offset Byte offset
+ * @param size Bytes to write
+ * @param buffer Data
+ * @return Bytes written (short if out of memory or a page could not be read)
+ */
+size_t page_cache_write(struct vfs_node *node, uint64_t offset, size_t size, const void *buffer);
+
+/**
+ * Write back dirty pages of a file, in runs of consecutive pages
+ * @param node File with a writepages operation
+ * @param nr Pages to write at most
+ * @return Pages written, or negative if writepages failed for all of them
+ */
+int64_t page_cache_writeback_inode(struct vfs_node *node, uint64_t nr);
+
+/**
+ * Report and clear a write-back failure of a file
+ * @param node File
+ * @return 0, or negative if dirty pages were lost since the last call
+ */
+int page_cache_writeback_error(struct vfs_node *node);
+
+/**
+ * Count the dirty pages in the cache
+ */
+uint32_t page_cache_dirty_count(void);
+
+/**
+ * Drop cached pages past a new end of file
+ * @param node File
+ * @param size New file size
+ */
+void page_cache_truncate(struct vfs_node *node, uint64_t size);
+
+/**
+ * Drop every cached page of a file, before the node is freed
+ * @param node File
+ */
+void page_cache_evict_inode(struct vfs_node *node);
+
+/**
+ * Get a snapshot of the cache statistics
+ * @param stats Structure to fill
+ */
+void page_cache_get_stats(page_cache_stats_t *stats);
+
+/**
+ * Print cache statistics
+ */
+void page_cache_print_stats(void);
+
+#endif /* _MM_PAGE_CACHE_H */
\ No newline at end of file
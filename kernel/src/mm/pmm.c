@@ -0,0 +1,273 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+#include <mm/shrinker.h>
+
+/* One bit per physical page, set when the page is in use */
+static uint8_t *page_bitmap = NULL;
+static size_t page_bitmap_size = 0;
+
+/* Number of pages covered by the bitmap */
+static size_t highest_page = 0;
+
+/* Page counters */
+static size_t total_pages = 0;
+static size_t used_pages = 0;
+
+/* Where the next search for a free page starts */
+static size_t search_hint = 0;
+
+static bool pmm_initialized = false;
+
+static inline bool page_test(size_t page) {
+    return page_bitmap[page / 8] & (1 << (page % 8));
+}
+
+static inline void page_set(size_t page) {
+    page_bitmap[page / 8] |= (1 << (page % 8));
+}
+
+static inline void page_clear(size_t page) {
+    page_bitmap[page / 8] &= ~(1 << (page % 8));
+}
+
+/**
+ * Initialize the physical page allocator from the bootloader memory map
+ * @param memmap Limine memory map response
+ * @return 0 on success, negative on error
+ */
+int pmm_init(struct limine_memmap_response *memmap) {
+    if (pmm_initialized) {
+        return 0;
+    }
+
+    if (!memmap || memmap->entry_count == 0) {
+        kerr("PMM: No memory map available\n");
+        return -1;
+    }
+
+    kprintf("PMM: Initializing physical memory manager\n");
+
+    /* Find the highest usable address to size the bitmap */
+    uint64_t highest_addr = 0;
+    for (uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry *entry = memmap->entries[i];
+        if (entry->type != LIMINE_MEMMAP_USABLE) {
+            continue;
+        }
+        if (entry->base + entry->length > highest_addr) {
+            highest_addr = entry->base + entry->length;
+        }
+    }
+
+    highest_page = highest_addr / PAGE_SIZE;
+    page_bitmap_size = (highest_page + 7) / 8;
+
+    /* Place the bitmap in the first usable region large enough to hold it */
+    for (uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry *entry = memmap->entries[i];
+        if (entry->type == LIMINE_MEMMAP_USABLE && entry->length >= page_bitmap_size) {
+            page_bitmap = (uint8_t *)phys_to_virt(entry->base);
+            break;
+        }
+    }
+
+    if (!page_bitmap) {
+        kerr("PMM: No region large enough for the page bitmap\n");
+        return -1;
+    }
+
+    /* Everything starts out reserved; usable regions are then released */
+    memset(page_bitmap, 0xFF, page_bitmap_size);
+
+    for (uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry *entry = memmap->entries[i];
+        if (entry->type != LIMINE_MEMMAP_USABLE) {
+            continue;
+        }
+
+        uint64_t first = (entry->base + PAGE_SIZE - 1) / PAGE_SIZE;
+        uint64_t last = (entry->base + entry->length) / PAGE_SIZE;
+        for (uint64_t page = first; page < last; page++) {
+            page_clear(page);
+            total_pages++;
+        }
+    }
+
+    /* Reserve the pages holding the bitmap itself */
+    uint64_t bitmap_phys = virt_to_phys(page_bitmap);
+    size_t bitmap_pages = (page_bitmap_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    for (size_t page = 0; page < bitmap_pages; page++) {
+        page_set(bitmap_phys / PAGE_SIZE + page);
+    }
+    used_pages = bitmap_pages;
+
+    /* Never hand out the zero page, 0 is our failure value */
+    if (!page_test(0)) {
+        page_set(0);
+        used_pages++;
+    }
+
+    pmm_initialized = true;
+
+    kprintf("PMM: %lu MiB usable, %lu pages free\n",
+            (uint64_t)(total_pages * PAGE_SIZE) / (1024 * 1024),
+            (uint64_t)(total_pages - used_pages));
+    return 0;
+}
+
+/**
+ * Find and claim a run of free pages
+ * @param count Number of pages
+ * @param first Set to the first page of the run
+ * @return true if a run was found
+ */
+static bool pmm_claim_run(size_t count, size_t *first) {
+    /* Two passes: from the hint to the end, then from the start */
+    for (int pass = 0; pass < 2; pass++) {
+        size_t start = (pass == 0) ? search_hint : 0;
+        size_t run = 0;
+
+        for (size_t page = start; page < highest_page; page++) {
+            if (page_test(page)) {
+                run = 0;
+                continue;
+            }
+
+            if (++run == count) {
+                *first = page + 1 - count;
+                for (size_t i = *first; i <= page; i++) {
+                    page_set(i);
+                }
+                used_pages += count;
+                search_hint = page + 1;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Allocate physically contiguous pages
+ * @param count Number of 4 KiB pages to allocate
+ * @return Physical address of the first page, or 0 on failure
+ */
+uint64_t pmm_alloc_pages(size_t count) {
+    if (!pmm_initialized || count == 0) {
+        return 0;
+    }
+
+    size_t first;
+    if (pmm_claim_run(count, &first) ||
+        (shrink_caches(SHRINK_BATCH) > 0 && pmm_claim_run(count, &first))) {
+        return (uint64_t)first * PAGE_SIZE;
+    }
+
+    kerr("PMM: Out of physical memory (%lu pages requested)\n", (uint64_t)count);
+    return 0;
+}
+
+/**
+ * Free physically contiguous pages
+ * @param phys Physical address returned by pmm_alloc_pages
+ * @param count Number of pages to free
+ */
+void pmm_free_pages(uint64_t phys, size_t count) {
+    if (!pmm_initialized || phys == 0) {
+        return;
+    }
+
+    size_t first = phys / PAGE_SIZE;
+    for (size_t page = first; page < first + count && page < highest_page; page++) {
+        if (!page_test(page)) {
+            kerr("PMM: Double free of page 0x%lx\n", (uint64_t)page * PAGE_SIZE);
+            continue;
+        }
+        page_clear(page);
+        used_pages--;
+    }
+
+    if (first < search_hint) {
+        search_hint = first;
+    }
+}
+
+/**
+ * Allocate zeroed, physically contiguous pages for device DMA
+ * @param count Number of 4 KiB pages to allocate
+ * @param phys Output for the physical address of the first page
+ * @return Kernel virtual address of the pages, or NULL on failure
+ */
+void *pmm_alloc_dma(size_t count, uint64_t *phys) {
+    uint64_t addr = pmm_alloc_pages(count);
+    if (!addr) {
+        return NULL;
+    }
+
+    void *virt = phys_to_virt(addr);
+    memset(virt, 0, count * PAGE_SIZE);
+
+    if (phys) {
+        *phys = addr;
+    }
+    return virt;
+}
+
+/**
+ * Free pages allocated with pmm_alloc_dma
+ * @param virt Kernel virtual address returned by pmm_alloc_dma
+ * @param count Number of pages to free
+ */
+void pmm_free_dma(void *virt, size_t count) {
+    if (!virt) {
+        return;
+    }
+    pmm_free_pages(virt_to_phys(virt), count);
+}
+
+/**
+ * Get statistics about physical memory
+ * @param total Total number of managed pages (output)
+ * @param free Number of free pages (output)
+ * @return 0 on success, negative on error
+ */
+int pmm_stats(size_t *total, size_t *free) {
+    if (!pmm_initialized) {
+        return -1;
+    }
+
+    if (total) {
+        *total = total_pages;
+    }
+
+    if (free) {
+        *free = total_pages - used_pages;
+    }
+
+    return 0;
+}
\ No newline at end of file
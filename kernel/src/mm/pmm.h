@@ -0,0 +1,70 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_PMM_H
+#define _MM_PMM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limine.h>
+
+/**
+ * Initialize the physical page allocator from the bootloader memory map
+ * @param memmap Limine memory map response
+ * @return 0 on success, negative on error
+ */
+int pmm_init(struct limine_memmap_response *memmap);
+
+/**
+ * Allocate physically contiguous pages
+ * @param count Number of 4 KiB pages to allocate
+ * @return Physical address of the first page, or 0 on failure
+ */
+uint64_t pmm_alloc_pages(size_t count);
+
+/**
+ * Free physically contiguous pages
+ * @param phys Physical address returned by pmm_alloc_pages
+ * @param count Number of pages to free
+ */
+void pmm_free_pages(uint64_t phys, size_t count);
+
+/**
+ * Allocate zeroed, physically contiguous pages for device DMA
+ * @param count Number of 4 KiB pages to allocate
+ * @param phys Output for the physical address of the first page
+ * @return Kernel virtual address of the pages, or NULL on failure
+ */
+void *pmm_alloc_dma(size_t count, uint64_t *phys);
+
+/**
+ * Free pages allocated with pmm_alloc_dma
+ * @param virt Kernel virtual address returned by pmm_alloc_dma
+ * @param count Number of pages to free
+ */
+void pmm_free_dma(void *virt, size_t count);
+
+/**
+ * Get statistics about physical memory
+ * @param total Total number of managed pages (output)
+ * @param free Number of free pages (output)
+ * @return 0 on success, negative on error
+ */
+int pmm_stats(size_t *total, size_t *free);
+
+#endif /* _MM_PMM_H */
\ No newline at end of file
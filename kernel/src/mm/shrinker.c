@@ -0,0 +1,69 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Cache shrinkers
+ *
+ * Caches that hold on to memory only as long as nobody else needs it
+ * register a shrinker here. When the heap or the physical allocator runs
+ * dry, it calls shrink_caches() and retries once before failing.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <kernel/cpu.h>
+#include <mm/shrinker.h>
+
+static shrinker_t *shrinker_list = NULL;
+static bool shrinking = false;
+
+/**
+ * Register a cache with the reclaim path
+ * @param shrinker Shrinker (must stay valid while registered)
+ */
+void shrinker_register(shrinker_t *shrinker) {
+    uint64_t flags = cpu_irq_save();
+    shrinker->next = shrinker_list;
+    shrinker_list = shrinker;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Ask every registered cache to free objects
+ * @param nr Objects to ask of each cache
+ * @return Total number of objects freed
+ */
+size_t shrink_caches(size_t nr) {
+    /* A shrinker that allocates must not re-enter reclaim */
+    uint64_t flags = cpu_irq_save();
+    if (shrinking) {
+        cpu_irq_restore(flags);
+        return 0;
+    }
+    shrinking = true;
+    cpu_irq_restore(flags);
+
+    size_t freed = 0;
+    for (shrinker_t *shrinker = shrinker_list; shrinker; shrinker = shrinker->next) {
+        if (shrinker->count() > 0) {
+            freed += shrinker->scan(nr);
+        }
+    }
+
+    shrinking = false;
+    return freed;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Cache shrinkers
+ */
+
+#ifndef _MM_SHRINKER_H
+#define _MM_SHRINKER_H
+
+#include <stddef.h>
+
+/* Objects asked of each shrinker per reclaim pass */
+#define SHRINK_BATCH 128
+
+/* A cache that can give memory back when an allocation fails */
+typedef struct shrinker {
+    const char *name;
+    size_t (*count)(void);          /* Objects that could be freed right now */
+    size_t (*scan)(size_t nr);      /* Free up to nr objects, returning how many were freed */
+    struct shrinker *next;
+} shrinker_t;
+
+/**
+ * Register a cache with the reclaim path
+ * @param shrinker Shrinker (must stay valid while registered)
+ */
+void shrinker_register(shrinker_t *shrinker);
+
+/**
+ * Ask every registered cache to free objects
+ * @param nr Objects to ask of each cache
+ * @return Total number of objects freed
+ */
+size_t shrink_caches(size_t nr);
+
+#endif /* _MM_SHRINKER_H */
\ No newline at end of file
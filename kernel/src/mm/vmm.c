@@ -0,0 +1,349 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/config.h>
+#include <mm/vmm.h>
+#include <mm/pmm.h>
+
+/* Page attribute table; entry 5 (PAT=1, PCD=0, PWT=1) is made write-combining */
+#define IA32_PAT_MSR        0x277
+#define PAT_TYPE_WC         0x01ULL
+#define PAT_WC_ENTRY        5
+
+/* Bootloader-provided address layout */
+static uint64_t hhdm_base = 0;
+static uint64_t kernel_phys_base = 0;
+static uint64_t kernel_virt_base = 0;
+
+/**
+ * Initialize address translation from the bootloader-provided layout
+ * @param hhdm_offset Virtual offset of the higher-half direct map
+ * @param kernel_phys Physical base address of the kernel image
+ * @param kernel_virt Virtual base address of the kernel image
+ * @return 0 on success, negative on error
+ */
+int vmm_init(uint64_t hhdm_offset, uint64_t kernel_phys, uint64_t kernel_virt) {
+    if (hhdm_offset == 0 || kernel_virt == 0) {
+        kerr("VMM: Invalid address layout\n");
+        return -1;
+    }
+
+    hhdm_base = hhdm_offset;
+    kernel_phys_base = kernel_phys;
+    kernel_virt_base = kernel_virt;
+
+    kprintf("VMM: HHDM at 0x%lx, kernel 0x%lx -> 0x%lx\n",
+            hhdm_base, kernel_virt_base, kernel_phys_base);
+    return 0;
+}
+
+/**
+ * Translate a physical address to its direct-map virtual address
+ * @param phys Physical address
+ * @return Kernel virtual address
+ */
+void *phys_to_virt(uint64_t phys) {
+    return (void *)(phys + hhdm_base);
+}
+
+/**
+ * Translate a kernel virtual address (direct map or kernel image) to physical
+ * @param virt Kernel virtual address
+ * @return Physical address
+ */
+uint64_t virt_to_phys(const void *virt) {
+    uint64_t addr = (uint64_t)virt;
+
+    /* The kernel image (and with it the static heap) sits above the HHDM */
+    if (addr >= kernel_virt_base) {
+        return addr - kernel_virt_base + kernel_phys_base;
+    }
+
+    return addr - hhdm_base;
+}
+
+#ifdef __x86_64__
+static inline uint64_t read_cr3(void) {
+    uint64_t value;
+    asm volatile ("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr3(uint64_t value) {
+    asm volatile ("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+static inline void invlpg(uint64_t addr) {
+    asm volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline void wbinvd(void) {
+    asm volatile ("wbinvd" : : : "memory");
+}
+
+/**
+ * Get the next-level table for an entry, allocating it if needed
+ * @param table Current table
+ * @param index Entry index within the table
+ * @return Next-level table, or NULL if it cannot be created or is a huge page
+ */
+static uint64_t *vmm_next_table(uint64_t *table, size_t index) {
+    uint64_t entry = table[index];
+
+    if (entry & VMM_PTE_PRESENT) {
+        /* Already covered by a large page; nothing below to walk */
+        if (entry & VMM_PTE_HUGE) {
+            return NULL;
+        }
+        return (uint64_t *)phys_to_virt(entry & VMM_PTE_ADDR_MASK);
+    }
+
+    uint64_t phys = pmm_alloc_pages(1);
+    if (!phys) {
+        return NULL;
+    }
+
+    uint64_t *next = (uint64_t *)phys_to_virt(phys);
+    memset(next, 0, PAGE_SIZE);
+    table[index] = phys | VMM_PTE_PRESENT | VMM_PTE_WRITABLE;
+    return next;
+}
+
+/**
+ * Map a single 4 KiB page with the given flags
+ * @param virt Virtual address
+ * @param phys Physical address
+ * @param flags Page table entry flags
+ * @return 0 on success, 1 if a large page already covers it, negative on error
+ */
+static int vmm_map_page(uint64_t virt, uint64_t phys, uint64_t flags) {
+    uint64_t *pml4 = (uint64_t *)phys_to_virt(read_cr3() & VMM_PTE_ADDR_MASK);
+    size_t indices[3] = {
+        (virt >> 39) & 0x1FF,
+        (virt >> 30) & 0x1FF,
+        (virt >> 21) & 0x1FF
+    };
+
+    uint64_t *table = pml4;
+    for (int level = 0; level < 3; level++) {
+        uint64_t entry = table[indices[level]];
+        if ((entry & VMM_PTE_PRESENT) && (entry & VMM_PTE_HUGE)) {
+            return 1;
+        }
+
+        table = vmm_next_table(table, indices[level]);
+        if (!table) {
+            return -1;
+        }
+    }
+
+    table[(virt >> 12) & 0x1FF] = (phys & VMM_PTE_ADDR_MASK) | flags;
+    invlpg(virt);
+    return 0;
+}
+
+/**
+ * Make PAT entry PAT_WC_ENTRY write-combining, once
+ *
+ * Firmware leaves it write-through; Limine already uses it for WC, in which
+ * case nothing changes.
+ */
+static void vmm_pat_init(void) {
+    static bool pat_ready = false;
+    if (pat_ready) {
+        return;
+    }
+    pat_ready = true;
+
+    uint64_t pat = rdmsr(IA32_PAT_MSR);
+    uint64_t shift = PAT_WC_ENTRY * 8;
+    if (((pat >> shift) & 0xFF) == PAT_TYPE_WC) {
+        return;
+    }
+
+    /* No line may be cached under the old type of a mapping that changes */
+    wbinvd();
+    wrmsr(IA32_PAT_MSR, (pat & ~(0xFFULL << shift)) | (PAT_TYPE_WC << shift));
+    write_cr3(read_cr3());
+    wbinvd();
+}
+
+/**
+ * Map the page at a direct-map address write-combining
+ *
+ * A 4 KiB entry is (re)written. A large page that the bootloader already
+ * mapped is switched to write-combining only if it lies entirely inside the
+ * range, since the rest of it may be ordinary memory.
+ * @param virt Virtual address
+ * @param phys Physical address
+ * @param end End of the range being mapped (physical)
+ * @param mapped Output for the number of bytes covered by the entry
+ * @return 0 on success, 1 if a large page was left as it is, negative on error
+ */
+static int vmm_map_wc_page(uint64_t virt, uint64_t phys, uint64_t end, uint64_t *mapped) {
+    uint64_t *table = (uint64_t *)phys_to_virt(read_cr3() & VMM_PTE_ADDR_MASK);
+    static const uint64_t level_size[3] = { 0, 1ULL << 30, 1ULL << 21 };
+
+    for (int level = 0; level < 3; level++) {
+        size_t index = (virt >> (39 - level * 9)) & 0x1FF;
+        uint64_t entry = table[index];
+
+        if ((entry & VMM_PTE_PRESENT) && (entry & VMM_PTE_HUGE)) {
+            uint64_t size = level_size[level];
+            uint64_t base = phys & ~(size - 1);
+            *mapped = base + size - phys;
+            if (base != phys || base + size > end) {
+                return 1;
+            }
+
+            entry &= ~(VMM_PTE_PCD | VMM_PTE_HUGE_PAT);
+            table[index] = entry | VMM_PTE_PWT | VMM_PTE_HUGE_PAT;
+            invlpg(virt);
+            return 0;
+        }
+
+        table = vmm_next_table(table, index);
+        if (!table) {
+            return -1;
+        }
+    }
+
+    *mapped = PAGE_SIZE;
+    table[(virt >> 12) & 0x1FF] = (phys & VMM_PTE_ADDR_MASK) | VMM_PTE_PRESENT |
+                                  VMM_PTE_WRITABLE | VMM_PTE_NX |
+                                  VMM_PTE_PAT | VMM_PTE_PWT;
+    invlpg(virt);
+    return 0;
+}
+#endif
+
+/**
+ * Map a device memory range uncached into the direct map
+ * @param phys Physical base address of the range
+ * @param size Size of the range in bytes
+ * @return Kernel virtual address of the mapping, or NULL on failure
+ */
+void *vmm_map_mmio(uint64_t phys, size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+#ifdef __x86_64__
+    uint64_t start = phys & ~((uint64_t)PAGE_SIZE - 1);
+    uint64_t end = (phys + size + PAGE_SIZE - 1) & ~((uint64_t)PAGE_SIZE - 1);
+
+    for (uint64_t addr = start; addr < end; addr += PAGE_SIZE) {
+        int result = vmm_map_page(addr + hhdm_base, addr,
+                                  VMM_PTE_PRESENT | VMM_PTE_WRITABLE |
+                                  VMM_PTE_PCD | VMM_PTE_PWT | VMM_PTE_NX);
+        if (result < 0) {
+            kerr("VMM: Failed to map MMIO page 0x%lx\n", addr);
+            return NULL;
+        }
+    }
+#endif
+
+    return phys_to_virt(phys);
+}
+
+/**
+ * Map a memory range write-combining into the direct map, for framebuffers
+ * @param phys Physical base address of the range
+ * @param size Size of the range in bytes
+ * @return Kernel virtual address of the mapping, or NULL on failure
+ */
+void *vmm_map_wc(uint64_t phys, size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+#ifdef __x86_64__
+    uint64_t start = phys & ~((uint64_t)PAGE_SIZE - 1);
+    uint64_t end = (phys + size + PAGE_SIZE - 1) & ~((uint64_t)PAGE_SIZE - 1);
+    uint64_t skipped = 0;
+
+    vmm_pat_init();
+
+    for (uint64_t addr = start; addr < end; ) {
+        uint64_t mapped = PAGE_SIZE;
+        int result = vmm_map_wc_page(addr + hhdm_base, addr, end, &mapped);
+        if (result < 0) {
+            kerr("VMM: Failed to map WC page 0x%lx\n", addr);
+            return NULL;
+        }
+        if (result > 0) {
+            skipped += mapped;
+        }
+        addr += mapped;
+    }
+
+    /* Lines cached through the old mapping must not be written back over WC data */
+    wbinvd();
+
+    if (skipped) {
+        kprintf("VMM: %lu KiB at 0x%lx kept their caching (shared large page)\n",
+                skipped / 1024, start);
+    }
+#endif
+
+    return phys_to_virt(phys);
+}
+
+/**
+ * Map a device memory range write-back into the direct map, for windows the
+ * device backs with ordinary memory
+ * @param phys Physical base address of the range
+ * @param size Size of the range in bytes
+ * @return Kernel virtual address of the mapping, or NULL on failure
+ */
+void *vmm_map_cached(uint64_t phys, size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+#ifdef __x86_64__
+    uint64_t start = phys & ~((uint64_t)PAGE_SIZE - 1);
+    uint64_t end = (phys + size + PAGE_SIZE - 1) & ~((uint64_t)PAGE_SIZE - 1);
+
+    for (uint64_t addr = start; addr < end; addr += PAGE_SIZE) {
+        int result = vmm_map_page(addr + hhdm_base, addr,
+                                  VMM_PTE_PRESENT | VMM_PTE_WRITABLE | VMM_PTE_NX);
+        if (result < 0) {
+            kerr("VMM: Failed to map page 0x%lx\n", addr);
+            return NULL;
+        }
+    }
+#endif
+
+    return phys_to_virt(phys);
+}
\ No newline at end of file
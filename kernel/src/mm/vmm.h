@@ -0,0 +1,85 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_VMM_H
+#define _MM_VMM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Page table entry flags (x86_64) */
+#define VMM_PTE_PRESENT     (1ULL << 0)
+#define VMM_PTE_WRITABLE    (1ULL << 1)
+#define VMM_PTE_USER        (1ULL << 2)
+#define VMM_PTE_PWT         (1ULL << 3)
+#define VMM_PTE_PCD         (1ULL << 4)
+#define VMM_PTE_HUGE        (1ULL << 7)
+#define VMM_PTE_PAT         (1ULL << 7)  /* PAT bit in 4 KiB entries */
+#define VMM_PTE_HUGE_PAT    (1ULL << 12) /* PAT bit in 2 MiB and 1 GiB entries */
+#define VMM_PTE_NX          (1ULL << 63)
+#define VMM_PTE_ADDR_MASK   0x000FFFFFFFFFF000ULL
+
+/**
+ * Initialize address translation from the bootloader-provided layout
+ * @param hhdm_offset Virtual offset of the higher-half direct map
+ * @param kernel_phys Physical base address of the kernel image
+ * @param kernel_virt Virtual base address of the kernel image
+ * @return 0 on success, negative on error
+ */
+int vmm_init(uint64_t hhdm_offset, uint64_t kernel_phys, uint64_t kernel_virt);
+
+/**
+ * Translate a physical address to its direct-map virtual address
+ * @param phys Physical address
+ * @return Kernel virtual address
+ */
+void *phys_to_virt(uint64_t phys);
+
+/**
+ * Translate a kernel virtual address (direct map or kernel image) to physical
+ * @param virt Kernel virtual address
+ * @return Physical address
+ */
+uint64_t virt_to_phys(const void *virt);
+
+/**
+ * Map a device memory range uncached into the direct map
+ * @param phys Physical base address of the range
+ * @param size Size of the range in bytes
+ * @return Kernel virtual address of the mapping, or NULL on failure
+ */
+void *vmm_map_mmio(uint64_t phys, size_t size);
+
+/**
+ * Map a memory range write-combining into the direct map, for framebuffers
+ * @param phys Physical base address of the range
+ * @param size Size of the range in bytes
+ * @return Kernel virtual address of the mapping, or NULL on failure
+ */
+void *vmm_map_wc(uint64_t phys, size_t size);
+
+/**
+ * Map a device memory range write-back into the direct map, for windows the
+ * device backs with ordinary memory
+ * @param phys Physical base address of the range
+ * @param size Size of the range in bytes
+ * @return Kernel virtual address of the mapping, or NULL on failure
+ */
+void *vmm_map_cached(uint64_t phys, size_t size);
+
+#endif /* _MM_VMM_H */
\ No newline at end of file
@@ -0,0 +1,333 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Dirty page writeback
+ *
+ * Buffered writes leave dirty pages in the page cache. Each backing device
+ * keeps a list of the inodes that have dirty pages, oldest first, and has
+ * a flusher that writes them back through the filesystem's writepages in
+ * runs of consecutive pages, then calls the device's flush so the block
+ * layer sorts and merges the whole batch. There are no kernel threads, so
+ * the flushers run from the idle loop through writeback_poll(). Each one
+ * looks every DIRTY_WRITEBACK_MS. It writes back when more than
+ * DIRTY_BACKGROUND_RATIO percent of the page cache is dirty, and it writes
+ * back inodes that have been dirty for longer than DIRTY_EXPIRE_MS. A
+ * writer that pushes the cache past DIRTY_RATIO percent dirty is
+ * throttled. It does the writeback itself, down to the background
+ * threshold, before its write returns.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/io.h>
+#include <kernel/cpu.h>
+#include <kernel/time.h>
+#include <kernel/config.h>
+#include <fs/vfs.h>
+#include <fs/icache.h>
+#include <mm/page_cache.h>
+#include <mm/writeback.h>
+
+#define NS_PER_MS 1000000ULL
+
+static backing_dev_t *bdi_list = NULL;
+static writeback_stats_t writeback_stats;
+
+static inline uint32_t dirty_background_pages(void) {
+    return (uint32_t)((uint64_t)PAGE_CACHE_MAX_PAGES * DIRTY_BACKGROUND_RATIO / 100);
+}
+
+static inline uint32_t dirty_limit_pages(void) {
+    return (uint32_t)((uint64_t)PAGE_CACHE_MAX_PAGES * DIRTY_RATIO / 100);
+}
+
+static bool writeback_inode_queued(struct vfs_node *node) {
+    return node->dirty_prev || node->bdi->dirty_head == node;
+}
+
+/**
+ * Append an inode to its device's dirty list; called with interrupts disabled
+ */
+static void writeback_queue(struct vfs_node *node) {
+    backing_dev_t *bdi = node->bdi;
+
+    node->dirty_prev = bdi->dirty_tail;
+    node->dirty_next = NULL;
+    if (bdi->dirty_tail) {
+        bdi->dirty_tail->dirty_next = node;
+    } else {
+        bdi->dirty_head = node;
+    }
+    bdi->dirty_tail = node;
+    bdi->nr_dirty_inodes++;
+}
+
+/**
+ * Unlink an inode from its device's dirty list; called with interrupts disabled
+ */
+static void writeback_dequeue(struct vfs_node *node) {
+    backing_dev_t *bdi = node->bdi;
+
+    if (node->dirty_prev) {
+        node->dirty_prev->dirty_next = node->dirty_next;
+    } else {
+        bdi->dirty_head = node->dirty_next;
+    }
+    if (node->dirty_next) {
+        node->dirty_next->dirty_prev = node->dirty_prev;
+    } else {
+        bdi->dirty_tail = node->dirty_prev;
+    }
+    node->dirty_prev = node->dirty_next = NULL;
+    bdi->nr_dirty_inodes--;
+}
+
+/**
+ * Register a backing device and start flushing it
+ * @param bdi Device (must stay valid until unregistered)
+ * @param name Name for messages
+ * @param flush Called after a flusher run wrote pages, to push them to the device
+ * @param data Argument for flush
+ */
+void bdi_register(backing_dev_t *bdi, const char *name, int (*flush)(void *data), void *data) {
+    memset(bdi, 0, sizeof(backing_dev_t));
+    bdi->name = name;
+    bdi->flush = flush;
+    bdi->data = data;
+    bdi->last_run = time_now_ns();
+
+    uint64_t flags = cpu_irq_save();
+    bdi->next = bdi_list;
+    bdi_list = bdi;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Queue a file for writeback when its first page is dirtied
+ * @param node File with a backing device
+ */
+void writeback_inode_dirty(struct vfs_node *node) {
+    if (!node->bdi) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    if (writeback_inode_queued(node)) {
+        cpu_irq_restore(flags);
+        return;
+    }
+
+    /* The list keeps the node, and its dirty pages, from being evicted */
+    vnode_get(node);
+    node->dirtied_when = time_now_ns();
+    writeback_queue(node);
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Take a file off its device's dirty list once it has no dirty pages left
+ * @param node File
+ */
+void writeback_inode_clean(struct vfs_node *node) {
+    if (!node->bdi) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    if (node->nr_dirty || !writeback_inode_queued(node)) {
+        cpu_irq_restore(flags);
+        return;
+    }
+    writeback_dequeue(node);
+    cpu_irq_restore(flags);
+
+    vnode_put(node);
+}
+
+/**
+ * Write back the dirty inodes of a device, oldest first
+ * @param bdi Device
+ * @param nr Pages to write at most
+ * @param dirtied_before Only write inodes dirtied before this time (ns), or 0 for all
+ * @return Pages written
+ */
+static uint64_t bdi_writeback(backing_dev_t *bdi, uint64_t nr, uint64_t dirtied_before) {
+    uint64_t written = 0;
+    uint32_t budget = bdi->nr_dirty_inodes;
+
+    struct vfs_node *node = bdi->dirty_head;
+    while (node && budget-- && written < nr) {
+        if (dirtied_before && node->dirtied_when >= dirtied_before) {
+            break;
+        }
+
+        /* Writing back the last page takes the node off the list and drops its reference */
+        struct vfs_node *next = node->dirty_next;
+        vnode_get(node);
+
+        int64_t result = page_cache_writeback_inode(node, nr - written);
+        if (result > 0) {
+            written += result;
+        }
+
+        /* Whatever is left waits its turn behind the other inodes */
+        uint64_t flags = cpu_irq_save();
+        if (node->nr_dirty && writeback_inode_queued(node) && node != bdi->dirty_tail) {
+            writeback_dequeue(node);
+            node->dirtied_when = time_now_ns();
+            writeback_queue(node);
+        }
+        cpu_irq_restore(flags);
+
+        vnode_put(node);
+        node = next;
+    }
+
+    if (written) {
+        if (bdi->flush && bdi->flush(bdi->data) < 0) {
+            kerr("WRITEBACK: Failed to flush %s\n", bdi->name);
+        }
+        bdi->written += written;
+        writeback_stats.written += written;
+    }
+
+    return written;
+}
+
+/**
+ * Write back everything dirty on a backing device and stop flushing it
+ *
+ * Files that still can't be written are dropped from the dirty list, so
+ * no reference to them outlives the device.
+ *
+ * @param bdi Device
+ */
+void bdi_unregister(backing_dev_t *bdi) {
+    /* Files whose writeback fails leave the list too, so keep going while it shrinks */
+    while (bdi->dirty_head) {
+        uint32_t queued = bdi->nr_dirty_inodes;
+        if (bdi_writeback(bdi, UINT64_MAX, 0) == 0 && bdi->nr_dirty_inodes == queued) {
+            break;
+        }
+    }
+    if (bdi->dirty_head) {
+        kerr("WRITEBACK: %u inodes on %s could not be written back\n",
+             bdi->nr_dirty_inodes, bdi->name);
+    }
+
+    while (bdi->dirty_head) {
+        uint64_t flags = cpu_irq_save();
+        struct vfs_node *node = bdi->dirty_head;
+        writeback_dequeue(node);
+        cpu_irq_restore(flags);
+        vnode_put(node);
+    }
+
+    uint64_t flags = cpu_irq_save();
+    for (backing_dev_t **link = &bdi_list; *link; link = &(*link)->next) {
+        if (*link == bdi) {
+            *link = bdi->next;
+            break;
+        }
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Write back on every device until no more than a target number of pages are dirty
+ * @param first Device to start with
+ * @param target Dirty pages to get down to
+ */
+static void writeback_to(backing_dev_t *first, uint32_t target) {
+    uint32_t dirty = page_cache_dirty_count();
+    if (dirty > target) {
+        bdi_writeback(first, dirty - target, 0);
+    }
+
+    /* Then the other devices, in case the dirty pages are theirs */
+    for (backing_dev_t *bdi = bdi_list; bdi; bdi = bdi->next) {
+        dirty = page_cache_dirty_count();
+        if (dirty <= target) {
+            return;
+        }
+        if (bdi != first) {
+            bdi_writeback(bdi, dirty - target, 0);
+        }
+    }
+}
+
+/**
+ * Throttle a writer: past the dirty limit it writes back until the cache is under the background threshold
+ * @param bdi Device just written to
+ */
+void balance_dirty_pages(backing_dev_t *bdi) {
+    if (page_cache_dirty_count() <= dirty_limit_pages()) {
+        return;
+    }
+
+    writeback_stats.throttled++;
+    writeback_to(bdi, dirty_background_pages());
+}
+
+/**
+ * Run the flushers that are due; called from the idle loop
+ */
+void writeback_poll(void) {
+    uint64_t now = time_now_ns();
+    uint64_t expire = (uint64_t)DIRTY_EXPIRE_MS * NS_PER_MS;
+
+    for (backing_dev_t *bdi = bdi_list; bdi; bdi = bdi->next) {
+        if (!bdi->dirty_head || now - bdi->last_run < (uint64_t)DIRTY_WRITEBACK_MS * NS_PER_MS) {
+            continue;
+        }
+        bdi->last_run = now;
+
+        uint32_t dirty = page_cache_dirty_count();
+        if (dirty > dirty_background_pages()) {
+            writeback_stats.background++;
+            bdi_writeback(bdi, dirty - dirty_background_pages(), 0);
+        }
+
+        if (now > expire && bdi->dirty_head && bdi->dirty_head->dirtied_when < now - expire) {
+            writeback_stats.expired++;
+            bdi_writeback(bdi, UINT64_MAX, now - expire);
+        }
+    }
+}
+
+/**
+ * Get a snapshot of the writeback statistics
+ * @param stats Structure to fill
+ */
+void writeback_get_stats(writeback_stats_t *stats) {
+    uint64_t flags = cpu_irq_save();
+    *stats = writeback_stats;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * Print writeback statistics
+ */
+void writeback_print_stats(void) {
+    writeback_stats_t stats;
+    writeback_get_stats(&stats);
+
+    kprintf("WRITEBACK: %lu pages written, %lu background runs, %lu expiry runs, %lu throttled writes\n",
+            stats.written, stats.background, stats.expired, stats.throttled);
+}
\ No newline at end of file
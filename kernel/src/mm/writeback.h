@@ -0,0 +1,102 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Dirty page writeback
+ */
+
+#ifndef _MM_WRITEBACK_H
+#define _MM_WRITEBACK_H
+
+#include <stdint.h>
+
+struct vfs_node;
+
+/* A device that dirty file pages are written back to, with its own flusher */
+typedef struct backing_dev {
+    const char *name;
+    int (*flush)(void *data);       /* Push what writepages handed the filesystem on to the device */
+    void *data;                     /* Argument for flush */
+    struct vfs_node *dirty_head;    /* Inodes with dirty pages, oldest first */
+    struct vfs_node *dirty_tail;
+    uint32_t nr_dirty_inodes;
+    uint64_t last_run;              /* When the flusher last looked, in ns */
+    uint64_t written;               /* Pages written back */
+    struct backing_dev *next;
+} backing_dev_t;
+
+/* Writeback statistics */
+typedef struct writeback_stats {
+    uint64_t written;               /* Pages written back */
+    uint64_t background;            /* Flusher runs over the background threshold */
+    uint64_t expired;               /* Flusher runs for inodes dirty too long */
+    uint64_t throttled;             /* Writes that had to write back before returning */
+} writeback_stats_t;
+
+/**
+ * Register a backing device and start flushing it
+ * @param bdi Device (must stay valid until unregistered)
+ * @param name Name for messages
+ * @param flush Called after a flusher run wrote pages, to push them to the device
+ * @param data Argument for flush
+ */
+void bdi_register(backing_dev_t *bdi, const char *name, int (*flush)(void *data), void *data);
+
+/**
+ * Write back everything dirty on a backing device and stop flushing it
+ *
+ * Files that still can't be written are dropped from the dirty list, so
+ * no reference to them outlives the device.
+ *
+ * @param bdi Device
+ */
+void bdi_unregister(backing_dev_t *bdi);
+
+/**
+ * Queue a file for writeback when its first page is dirtied
+ * @param node File with a backing device
+ */
+void writeback_inode_dirty(struct vfs_node *node);
+
+/**
+ * Take a file off its device's dirty list once it has no dirty pages left
+ * @param node File
+ */
+void writeback_inode_clean(struct vfs_node *node);
+
+/**
+ * Throttle a writer: past the dirty limit it writes back until the cache is under the background threshold
+ * @param bdi Device just written to
+ */
+void balance_dirty_pages(backing_dev_t *bdi);
+
+/**
+ * Run the flushers that are due; called from the idle loop
+ */
+void writeback_poll(void);
+
+/**
+ * Get a snapshot of the writeback statistics
+ * @param stats Structure to fill
+ */
+void writeback_get_stats(writeback_stats_t *stats);
+
+/**
+ * Print writeback statistics
+ */
+void writeback_print_stats(void);
+
+#endif /* _MM_WRITEBACK_H */
\ No newline at end of file
@@ -0,0 +1,239 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Compressed object allocator
+ *
+ * Compressed pages come in every size, and giving each one a heap block or
+ * a page of its own wastes much of what compression saved. Instead, sizes
+ * are rounded to ZS_SIZE_STEP and every size class carves slabs of a few
+ * physically contiguous pages into equal objects, packed back to back so
+ * objects may straddle page boundaries. Each class picks the slab size
+ * that leaves the least space over. A handle is the slab's address with
+ * the object index in its low bits, as slabs are page aligned.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <lib/minstd.h>
+#include <kernel/config.h>
+#include <mm/zsmalloc.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+/* End of a slab's free list */
+#define ZS_NONE             0xFFFF
+
+/* Slab header, at the start of the slab's first page */
+typedef struct zs_slab {
+    zs_class_t *cls;            /* Owning class */
+    struct zs_slab *prev;       /* Neighbours in the class's partial or full list */
+    struct zs_slab *next;
+    uint16_t inuse;             /* Objects allocated */
+    uint16_t free;              /* First free object, ZS_NONE if none */
+} zs_slab_t;
+
+/* Space the header takes before the first object */
+#define ZS_SLAB_HEADER      ((sizeof(zs_slab_t) + ZS_SIZE_STEP - 1) & ~(size_t)(ZS_SIZE_STEP - 1))
+
+static inline uint8_t *zs_slab_object(zs_slab_t *slab, uint32_t index) {
+    return (uint8_t *)slab + ZS_SLAB_HEADER + (size_t)index * slab->cls->size;
+}
+
+static void zs_list_add(zs_slab_t **list, zs_slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+static void zs_list_del(zs_slab_t **list, zs_slab_t *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+/**
+ * Initialize an empty pool
+ * @param pool Pool
+ */
+void zs_pool_init(zs_pool_t *pool) {
+    memset(pool, 0, sizeof(zs_pool_t));
+
+    for (uint32_t i = 0; i < ZS_NR_CLASSES; i++) {
+        zs_class_t *cls = &pool->classes[i];
+        cls->size = (i + 1) * ZS_SIZE_STEP;
+
+        /* Pick the slab size that wastes the smallest share of itself */
+        size_t best_waste = PAGE_SIZE;
+        for (uint16_t pages = 1; pages <= ZS_MAX_SLAB_PAGES; pages++) {
+            size_t usable = (size_t)pages * PAGE_SIZE - ZS_SLAB_HEADER;
+            size_t waste = (usable % cls->size) * PAGE_SIZE / ((size_t)pages * PAGE_SIZE);
+            if (usable / cls->size > 0 && waste < best_waste) {
+                best_waste = waste;
+                cls->slab_pages = pages;
+                cls->slab_objects = (uint16_t)(usable / cls->size);
+            }
+        }
+    }
+}
+
+/**
+ * Give a slab's pages back
+ */
+static void zs_slab_free(zs_pool_t *pool, zs_slab_t *slab) {
+    zs_class_t *cls = slab->cls;
+    cls->slabs--;
+    pool->pages -= cls->slab_pages;
+    pmm_free_pages(virt_to_phys(slab), cls->slab_pages);
+}
+
+/**
+ * Free every slab of a pool; handles into it become invalid
+ * @param pool Pool
+ */
+void zs_pool_destroy(zs_pool_t *pool) {
+    for (uint32_t i = 0; i < ZS_NR_CLASSES; i++) {
+        zs_class_t *cls = &pool->classes[i];
+        zs_slab_t *lists[2] = { cls->partial, cls->full };
+        for (int l = 0; l < 2; l++) {
+            zs_slab_t *slab = lists[l];
+            while (slab) {
+                zs_slab_t *next = slab->next;
+                zs_slab_free(pool, slab);
+                slab = next;
+            }
+        }
+        cls->partial = cls->full = NULL;
+        cls->objects = 0;
+    }
+}
+
+/**
+ * Allocate a slab for a class and thread its objects onto its free list
+ * @return The slab, or NULL if out of memory
+ */
+static zs_slab_t *zs_slab_alloc(zs_pool_t *pool, zs_class_t *cls) {
+    uint64_t phys = pmm_alloc_pages(cls->slab_pages);
+    if (!phys) {
+        return NULL;
+    }
+
+    zs_slab_t *slab = (zs_slab_t *)phys_to_virt(phys);
+    slab->cls = cls;
+    slab->inuse = 0;
+    slab->free = 0;
+    for (uint16_t i = 0; i < cls->slab_objects; i++) {
+        uint16_t next = i + 1 < cls->slab_objects ? i + 1 : ZS_NONE;
+        memcpy(zs_slab_object(slab, i), &next, sizeof(next));
+    }
+
+    cls->slabs++;
+    pool->pages += cls->slab_pages;
+    return slab;
+}
+
+/**
+ * Allocate an object
+ * @param pool Pool
+ * @param size Bytes, at most ZS_MAX_ALLOC
+ * @return Handle of the object, or 0 on failure
+ */
+uint64_t zs_malloc(zs_pool_t *pool, size_t size) {
+    if (size == 0 || size > ZS_MAX_ALLOC) {
+        return 0;
+    }
+
+    zs_class_t *cls = &pool->classes[(size - 1) / ZS_SIZE_STEP];
+    zs_slab_t *slab = cls->partial;
+    if (!slab) {
+        slab = zs_slab_alloc(pool, cls);
+        if (!slab) {
+            return 0;
+        }
+        zs_list_add(&cls->partial, slab);
+    }
+
+    uint16_t index = slab->free;
+    memcpy(&slab->free, zs_slab_object(slab, index), sizeof(slab->free));
+    slab->inuse++;
+    cls->objects++;
+
+    if (slab->free == ZS_NONE) {
+        zs_list_del(&cls->partial, slab);
+        zs_list_add(&cls->full, slab);
+    }
+
+    return (uint64_t)(uintptr_t)slab | index;
+}
+
+/**
+ * Split a handle into its slab and object index
+ */
+static inline zs_slab_t *zs_handle_slab(uint64_t handle, uint16_t *index) {
+    *index = (uint16_t)(handle & (PAGE_SIZE - 1));
+    return (zs_slab_t *)(uintptr_t)(handle & ~(uint64_t)(PAGE_SIZE - 1));
+}
+
+/**
+ * Free an object
+ * @param pool Pool
+ * @param handle Handle from zs_malloc
+ */
+void zs_free(zs_pool_t *pool, uint64_t handle) {
+    if (!handle) {
+        return;
+    }
+
+    uint16_t index;
+    zs_slab_t *slab = zs_handle_slab(handle, &index);
+    zs_class_t *cls = slab->cls;
+
+    if (slab->free == ZS_NONE) {
+        zs_list_del(&cls->full, slab);
+        zs_list_add(&cls->partial, slab);
+    }
+
+    memcpy(zs_slab_object(slab, index), &slab->free, sizeof(slab->free));
+    slab->free = index;
+    slab->inuse--;
+    cls->objects--;
+
+    /* Empty slabs go straight back; compressed data churns too much to cache them */
+    if (slab->inuse == 0) {
+        zs_list_del(&cls->partial, slab);
+        zs_slab_free(pool, slab);
+    }
+}
+
+/**
+ * Get the address of an object
+ * @param handle Handle from zs_malloc
+ * @return Kernel virtual address of the object
+ */
+void *zs_map(uint64_t handle) {
+    uint16_t index;
+    zs_slab_t *slab = zs_handle_slab(handle, &index);
+    return zs_slab_object(slab, index);
+}
\ No newline at end of file
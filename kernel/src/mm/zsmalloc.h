@@ -0,0 +1,91 @@
+/*
+ * FreeCore - A free operating system kernel
+ * Copyright (C) 2025 FreeCore Development Team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Compressed object allocator
+ */
+
+#ifndef _MM_ZSMALLOC_H
+#define _MM_ZSMALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Object sizes are rounded up to a multiple of this */
+#define ZS_SIZE_STEP        32
+
+/* Largest object; callers store anything bigger in a page of its own */
+#define ZS_MAX_ALLOC        3072
+
+#define ZS_NR_CLASSES       (ZS_MAX_ALLOC / ZS_SIZE_STEP)
+
+/* Most pages a slab spans */
+#define ZS_MAX_SLAB_PAGES   4
+
+struct zs_slab;
+
+/* Slabs holding objects of one size */
+typedef struct zs_class {
+    uint32_t size;              /* Object size */
+    uint16_t slab_pages;        /* Pages per slab */
+    uint16_t slab_objects;      /* Objects per slab */
+    struct zs_slab *partial;    /* Slabs with free objects */
+    struct zs_slab *full;       /* Slabs without */
+    uint64_t slabs;             /* Slabs allocated */
+    uint64_t objects;           /* Objects in use */
+} zs_class_t;
+
+/* Allocator instance */
+typedef struct zs_pool {
+    zs_class_t classes[ZS_NR_CLASSES];
+    uint64_t pages;             /* Pages held by all slabs */
+} zs_pool_t;
+
+/**
+ * Initialize an empty pool
+ * @param pool Pool
+ */
+void zs_pool_init(zs_pool_t *pool);
+
+/**
+ * Free every slab of a pool; handles into it become invalid
+ * @param pool Pool
+ */
+void zs_pool_destroy(zs_pool_t *pool);
+
+/**
+ * Allocate an object
+ * @param pool Pool
+ * @param size Bytes, at most ZS_MAX_ALLOC
+ * @return Handle of the object, or 0 on failure
+ */
+uint64_t zs_malloc(zs_pool_t *pool, size_t size);
+
+/**
+ * Free an object
+ * @param pool Pool
+ * @param handle Handle from zs_malloc
+ */
+void zs_free(zs_pool_t *pool, uint64_t handle);
+
+/**
+ * Get the address of an object
+ * @param handle Handle from zs_malloc
+ * @return Kernel virtual address of the object
+ */
+void *zs_map(uint64_t handle);
+
+#endif /* _MM_ZSMALLOC_H */
\ No newline at end of file